@@ -1,4 +1,5 @@
-/* Sequence and profile caches, used by the hmmpgmd daemon.
+/* Sequence and profile caches, used by the hmmpgmd daemon, and by
+ * jackhmmer to keep its targets in memory across iterations.
  */
 #include "p7_config.h"
 
@@ -18,6 +19,8 @@
 #include "cachedb.h"
 #include "hmmpgmd.h"
 
+static void seq_view(const P7_SEQCACHE *cache, uint32_t i, ESL_SQ *sq);
+
 
 /* sort routines */
 static int
@@ -272,6 +275,127 @@ p7_seqcache_Open(char *seqfile, P7_SEQCACHE **ret_cache, char *errbuf)
   return eslEMEM;
 }
 
+
+/* Function:  p7_seqcache_Load()
+ * Synopsis:  Load all the sequences of an open sequence file.
+ *
+ * Purpose:   Read the sequences of <sqfp>, open in digital mode with
+ *            alphabet <abc>, into a new cache, in the order they come
+ *            in the file. Unlike <p7_seqcache_Open()>, the file can be
+ *            of any format, and needn't be rewindable; the cache keeps
+ *            each sequence's name, accession and description, and it
+ *            has no sub-databases.
+ *
+ *            Read the cached sequences back as views, with
+ *            <p7_seqcache_Read()> and <p7_seqcache_ReadBlock()>.
+ *
+ * Returns:   <eslOK> on success, and <*ret_cache> is the new cache.
+ *            <eslEFORMAT> on a parse error, and <errbuf> says why.
+ *            <eslERANGE> if the file holds more sequences than a cache
+ *            can index.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_seqcache_Load(ESL_SQFILE *sqfp, const ESL_ALPHABET *abc, P7_SEQCACHE **ret_cache, char *errbuf)
+{
+  P7_SEQCACHE  *cache    = NULL;
+  ESL_SQ       *sq       = NULL;
+  char         *hdr_ptr;
+  ESL_DSQ      *res_ptr;
+  uint64_t      res_used = 0;
+  uint64_t      hdr_used = 0;
+  uint32_t      nalloc   = 0;
+  uint32_t      i;
+  size_t        nlen, alen, dlen;
+  int           status;
+
+  if (errbuf) errbuf[0] = '\0';
+
+  ESL_ALLOC(cache, sizeof(P7_SEQCACHE));
+  memset(cache, 0, sizeof(P7_SEQCACHE));
+  if ((status = esl_strdup(sqfp->filename, -1, &cache->name)) != eslOK) goto ERROR;
+  if ((cache->abc = esl_alphabet_Create(abc->type))          == NULL)  { status = eslEMEM; goto ERROR; }
+  if ((sq         = esl_sq_CreateDigital(abc))                == NULL)  { status = eslEMEM; goto ERROR; }
+
+  cache->res_size = 1024 * 1024;
+  cache->hdr_size = 100 * 1024;
+  ESL_ALLOC(cache->residue_mem, cache->res_size);
+  ESL_ALLOC(cache->header_mem,  cache->hdr_size);
+
+  /* As in p7_seqcache_Open(), each dsq[0..n] follows the one before,
+   * so that the next sequence's dsq[0] is this one's dsq[n+1]
+   * sentinel; a final sentinel closes the last. The memory may move
+   * as it grows, so the pointers are set at the end.
+   */
+  while ((status = esl_sqio_Read(sqfp, sq)) == eslOK)
+    {
+      if (cache->count == UINT32_MAX) ESL_XFAIL(eslERANGE, errbuf, "too many sequences in %s to cache", sqfp->filename);
+
+      if (cache->count == nalloc)
+	{
+	  nalloc = (nalloc > UINT32_MAX / 2 ? UINT32_MAX : (nalloc ? nalloc * 2 : 1024));
+	  ESL_REALLOC(cache->list, sizeof(HMMER_SEQ) * nalloc);
+	}
+
+      while (res_used + sq->n + 2 > cache->res_size)
+	{
+	  cache->res_size *= 2;
+	  ESL_REALLOC(cache->residue_mem, cache->res_size);
+	}
+
+      nlen = strlen(sq->name) + 1;
+      alen = strlen(sq->acc)  + 1;
+      dlen = strlen(sq->desc) + 1;
+      while (hdr_used + nlen + alen + dlen > cache->hdr_size)
+	{
+	  cache->hdr_size *= 2;
+	  ESL_REALLOC(cache->header_mem, cache->hdr_size);
+	}
+
+      memcpy((ESL_DSQ *) cache->residue_mem + res_used, sq->dsq, sq->n + 1);
+      res_used += sq->n + 1;
+
+      memcpy(cache->header_mem + hdr_used, sq->name, nlen);  hdr_used += nlen;
+      memcpy(cache->header_mem + hdr_used, sq->acc,  alen);  hdr_used += alen;
+      memcpy(cache->header_mem + hdr_used, sq->desc, dlen);  hdr_used += dlen;
+
+      memset(&(cache->list[cache->count]), 0, sizeof(HMMER_SEQ));
+      cache->list[cache->count].n   = sq->n;
+      cache->list[cache->count].idx = cache->count;
+      cache->count++;
+
+      esl_sq_Reuse(sq);
+    }
+  if      (status == eslEFORMAT) ESL_XFAIL(eslEFORMAT, errbuf, "Parse failed (sequence file %s):\n%s", sqfp->filename, esl_sqfile_GetErrorBuf(sqfp));
+  else if (status != eslEOF)     goto ERROR;
+
+  /* copy the final sentinel character */
+  ((ESL_DSQ *) cache->residue_mem)[res_used++] = eslDSQ_SENTINEL;
+
+  hdr_ptr = cache->header_mem;
+  res_ptr = cache->residue_mem;
+  for (i = 0; i < cache->count; i++)
+    {
+      cache->list[i].dsq  = res_ptr;  res_ptr += cache->list[i].n + 1;
+      cache->list[i].name = hdr_ptr;  hdr_ptr += strlen(hdr_ptr) + 1;
+      cache->list[i].acc  = hdr_ptr;  hdr_ptr += strlen(hdr_ptr) + 1;
+      cache->list[i].desc = hdr_ptr;  hdr_ptr += strlen(hdr_ptr) + 1;
+    }
+  cache->K = cache->count;
+
+  esl_sq_Destroy(sq);
+  *ret_cache = cache;
+  return eslOK;
+
+ ERROR:
+  if (sq)    esl_sq_Destroy(sq);
+  if (cache) p7_seqcache_Close(cache);
+  *ret_cache = NULL;
+  return status;
+}
+
+
 void
 p7_seqcache_Close(P7_SEQCACHE *cache)
 {
@@ -294,6 +418,79 @@ p7_seqcache_Close(P7_SEQCACHE *cache)
 }
 
 
+/* Function:  p7_seqcache_Read()
+ * Synopsis:  Read the next sequence of a cache.
+ *
+ * Purpose:   Point the view <sq> at sequence <*next> of <cache>, and
+ *            bump <*next>; start <*next> at 0 to read the cache from
+ *            the beginning. <sq> is a read-only view, created with
+ *            <p7_seqdb_CreateSeq()>: its <dsq>, <name>, <acc> and
+ *            <desc> point into the cache. Its <idx> is the sequence's
+ *            index in the cache.
+ *
+ * Returns:   <eslOK> on success; <eslEOF> if there are no more
+ *            sequences.
+ */
+int
+p7_seqcache_Read(const P7_SEQCACHE *cache, uint32_t *next, ESL_SQ *sq)
+{
+  if (*next >= cache->count) return eslEOF;
+  seq_view(cache, (*next)++, sq);
+  return eslOK;
+}
+
+/* Function:  p7_seqcache_ReadBlock()
+ * Synopsis:  Read the next block of sequences of a cache.
+ *
+ * Purpose:   Point the views of <block>, created with
+ *            <p7_seqdb_CreateBlock()>, at the sequences of <cache>
+ *            starting at <*next>: as many as it holds, or up to
+ *            <max_sequences> if that isn't -1. Bump <*next> past them.
+ *
+ * Returns:   <eslOK> on success; <eslEOF> if there are no more
+ *            sequences, and <block->count> is 0.
+ */
+int
+p7_seqcache_ReadBlock(const P7_SEQCACHE *cache, uint32_t *next, ESL_SQ_BLOCK *block, int max_sequences)
+{
+  int64_t n = ESL_MIN((int64_t) block->listSize, (int64_t) cache->count - (int64_t) *next);
+  int     i;
+
+  if (max_sequences >= 0) n = ESL_MIN(n, max_sequences);
+  if (n < 0)              n = 0;
+
+  block->count        = n;
+  block->first_seqidx = *next;
+  block->complete     = TRUE;
+  for (i = 0; i < n; i++)
+    seq_view(cache, (*next)++, block->list + i);
+  return (n > 0 ? eslOK : eslEOF);
+}
+
+/* seq_view()
+ * Point <sq> at sequence <i> of <cache>. Caches from
+ * p7_seqcache_Open() have no accessions, and may lack descriptions.
+ */
+static void
+seq_view(const P7_SEQCACHE *cache, uint32_t i, ESL_SQ *sq)
+{
+  const HMMER_SEQ *s = cache->list + i;
+
+  sq->name   = s->name;
+  sq->acc    = (s->acc  ? s->acc  : (char *) "");
+  sq->desc   = (s->desc ? s->desc : (char *) "");
+  sq->source = (char *) "";
+  sq->dsq    = s->dsq;
+  sq->n      = s->n;
+  sq->start  = 1;
+  sq->end    = s->n;
+  sq->C      = 0;
+  sq->W      = s->n;
+  sq->L      = s->n;
+  sq->idx    = i;
+}
+
+
 
 
 /*****************************************************************
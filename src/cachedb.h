@@ -8,6 +8,7 @@ typedef struct {
   int64_t  idx;	                   /* ctr for this seq                      */
   uint64_t db_key;                 /* flag for included databases           */
   char    *desc;                   /* description                           */
+  char    *acc;                    /* accession; NULL in hmmpgmd caches     */
 } HMMER_SEQ;
 
 typedef struct {
@@ -36,7 +37,11 @@ typedef struct {
 
 
 extern int    p7_seqcache_Open(char *seqfile, P7_SEQCACHE **ret_cache, char *errbuf);
+extern int    p7_seqcache_Load(ESL_SQFILE *sqfp, const ESL_ALPHABET *abc, P7_SEQCACHE **ret_cache, char *errbuf);
 extern void   p7_seqcache_Close(P7_SEQCACHE *cache);
 
+extern int    p7_seqcache_Read     (const P7_SEQCACHE *cache, uint32_t *next, ESL_SQ *sq);
+extern int    p7_seqcache_ReadBlock(const P7_SEQCACHE *cache, uint32_t *next, ESL_SQ_BLOCK *block, int max_sequences);
+
 #endif /*P7_CACHEDB_INCLUDED*/
 
@@ -489,6 +489,8 @@ int main(int argc, char *argv[])
         pli->n_past_bias = stats->n_past_bias;
         pli->n_past_vit  = stats->n_past_vit;
         pli->n_past_fwd  = stats->n_past_fwd;
+        memcpy(pli->stage_ns,    stats->stage_ns,    sizeof(uint64_t) * p7_PLI_NSTAGES);
+        memcpy(pli->stage_cells, stats->stage_cells, sizeof(uint64_t) * p7_PLI_NSTAGES);
 
         pli->Z           = stats->Z;
         pli->domZ        = stats->domZ;
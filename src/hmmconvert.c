@@ -13,6 +13,10 @@
 #include "esl_getopts.h"
 
 #include "hmmer.h"
+#ifdef HMMER_THREADS
+#include "esl_threads.h"
+#include "p7_hmmreader.h"
+#endif
 
 static ESL_OPTIONS options[] = {
   /* name           type      default  env  range     toggles      reqs   incomp  help   docgroup*/
@@ -21,6 +25,9 @@ static ESL_OPTIONS options[] = {
   { "-b",        eslARG_NONE,   FALSE, NULL, NULL, "-a,-b,-2",      NULL,    NULL, "binary: output models in HMMER3 binary format",                    0 },
   { "-2",        eslARG_NONE,   FALSE, NULL, NULL, "-a,-b,-2",      NULL,    NULL, "HMMER2: output backward compatible HMMER2 ASCII format (ls mode)", 0 },
   { "--outfmt",  eslARG_STRING, NULL,  NULL, NULL,      NULL,       NULL,    "-2", "choose output legacy 3.x file formats by name, such as '3/a'",     0 },
+#ifdef HMMER_THREADS
+  { "--cpu",     eslARG_INT,  p7_NCPU,"HMMER_NCPU","n>=0",NULL,     NULL,    NULL, "number of parallel CPU workers parsing <hmmfile>",                 0 },
+#endif
   {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
 static char usage[]  = "[-options] <hmmfile>";
@@ -40,6 +47,10 @@ main(int argc, char **argv)
   int            fmtcode = -1;	/* -1 = write the current default format */
   int            status;
   char           errbuf[eslERRBUFSIZE];
+#ifdef HMMER_THREADS
+  P7_HMMREADER  *rdr     = NULL;
+  int            ncpus;
+#endif
 
   if (outfmt != NULL) {
     if      (strcmp(outfmt, "3/a") == 0) fmtcode = p7_HMMFILE_3a;
@@ -56,8 +67,28 @@ main(int argc, char **argv)
   else if (status == eslEFORMAT)   p7_Fail("File format problem in trying to open HMM file %s.\n%s\n",                hmmfile, errbuf);
   else if (status != eslOK)        p7_Fail("Unexpected error %d in opening HMM file %s.\n%s\n",                       status, hmmfile, errbuf);  
 
-  while ((status = p7_hmmfile_Read(hfp, &abc, &hmm)) == eslOK)
+  /* With threads, parse the models in parallel if the file can be split;
+   * else (stdin, .gz, --cpu 0) read them one at a time.
+   */
+#ifdef HMMER_THREADS
+  ncpus = ESL_MIN( esl_opt_GetInteger(go, "--cpu"), esl_threads_GetCPUCount());
+  if (ncpus > 0)
     {
+      status = p7_hmmreader_Open(hfp, &abc, ncpus, p7_HMMREADER_HMMS, 0, &rdr);
+      if      (status == eslEFORMAT) p7_Fail("bad file format in HMM file %s", hmmfile);
+      else if (status != eslOK && status != eslEINCOMPAT && status != eslEOF) p7_Fail("Unexpected error %d in opening parallel reader for %s", status, hmmfile);
+    }
+#endif
+
+  for (;;)
+    {
+#ifdef HMMER_THREADS
+      if (rdr) status = p7_hmmreader_Read(rdr, &hmm, NULL);
+      else
+#endif
+      status = p7_hmmfile_Read(hfp, &abc, &hmm);
+      if (status != eslOK) break;
+
       if      (esl_opt_GetBoolean(go, "-a") == TRUE) p7_hmmfile_WriteASCII (ofp, fmtcode, hmm);
       else if (esl_opt_GetBoolean(go, "-b") == TRUE) p7_hmmfile_WriteBinary(ofp, fmtcode, hmm);
       else if (esl_opt_GetBoolean(go, "-2") == TRUE) p7_h2io_WriteASCII    (ofp, hmm);
@@ -68,6 +99,9 @@ main(int argc, char **argv)
   else if (status == eslEINCOMPAT) p7_Fail("HMM file %s contains different alphabets",   hmmfile);
   else if (status != eslEOF)       p7_Fail("Unexpected error in reading HMMs from %s",   hmmfile);
 
+#ifdef HMMER_THREADS
+  p7_hmmreader_Close(rdr);
+#endif
   p7_hmmfile_Close(hfp);
   esl_alphabet_Destroy(abc);
   esl_getopts_Destroy(go);
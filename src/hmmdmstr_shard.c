@@ -714,6 +714,8 @@ init_results(SEARCH_RESULTS *results)
   results->stats.n_past_bias = 0;
   results->stats.n_past_vit  = 0;
   results->stats.n_past_fwd  = 0;
+  memset(results->stats.stage_ns,    0, sizeof(uint64_t) * p7_PLI_NSTAGES);
+  memset(results->stats.stage_cells, 0, sizeof(uint64_t) * p7_PLI_NSTAGES);
   results->stats.Z           = 0;
 
   results->hits              = NULL;
@@ -729,6 +731,7 @@ gather_results(QUEUE_DATA_SHARD *query, WORKERSIDE_ARGS *comm, SEARCH_RESULTS *r
 {
   int cnt;
   int n;
+  int s;
 
   WORKER_DATA        *worker;
 
@@ -754,6 +757,11 @@ gather_results(QUEUE_DATA_SHARD *query, WORKERSIDE_ARGS *comm, SEARCH_RESULTS *r
       results->stats.n_past_bias  += worker->stats.n_past_bias;
       results->stats.n_past_vit   += worker->stats.n_past_vit;
       results->stats.n_past_fwd   += worker->stats.n_past_fwd;
+      for (s = 0; s < p7_PLI_NSTAGES; s++)
+        {
+          results->stats.stage_ns[s]    += worker->stats.stage_ns[s];
+          results->stats.stage_cells[s] += worker->stats.stage_cells[s];
+        }
 
       results->stats.Z_setby       = worker->stats.Z_setby;
       results->stats.domZ_setby    = worker->stats.domZ_setby;
@@ -853,12 +861,16 @@ forward_results(QUEUE_DATA_SHARD *query, SEARCH_RESULTS *results)
     th.is_sorted_by_seqidx  = 0;
       
     pli = p7_pipeline_Create(query->opts, 100, 100, FALSE, mode);
+    if (esl_opt_IsOn(query->opts, "--topn")) p7_pli_SetTopN(pli, esl_opt_GetInteger(query->opts, "--topn"));
+      
     pli->nmodels     = results->stats.nmodels;
     pli->nseqs       = results->stats.nseqs;
     pli->n_past_msv  = results->stats.n_past_msv;
     pli->n_past_bias = results->stats.n_past_bias;
     pli->n_past_vit  = results->stats.n_past_vit;
     pli->n_past_fwd  = results->stats.n_past_fwd;
+    memcpy(pli->stage_ns,    results->stats.stage_ns,    sizeof(uint64_t) * p7_PLI_NSTAGES);
+    memcpy(pli->stage_cells, results->stats.stage_cells, sizeof(uint64_t) * p7_PLI_NSTAGES);
 
     pli->Z           = results->stats.Z;
     pli->domZ        = results->stats.domZ;
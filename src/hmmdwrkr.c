@@ -605,6 +605,8 @@ search_thread(void *arg)
   /* Create processing pipeline and hit list */
   th  = p7_tophits_Create(); 
   pli = p7_pipeline_Create(info->opts, om->M, 100, FALSE, p7_SEARCH_SEQS);
+  pli->do_lazy_ad = TRUE;	/* only send the master displays of domains it might report */
+  if (esl_opt_IsOn(info->opts, "--topn")) p7_pli_SetTopN(pli, esl_opt_GetInteger(info->opts, "--topn"));
   p7_pli_NewModel(pli, om, bg);
 
   if (pli->Z_setby == p7_ZSETBY_NTARGETS) pli->Z = info->db_Z;
@@ -656,6 +658,9 @@ search_thread(void *arg)
     }
   }
 
+  /* the master thresholds the merged hits; make displays for any domain it might report */
+  if (p7_tophits_MakeDisplays(th, pli, om, TRUE) != eslOK) p7_Fail("Failed to make alignment displays\n");
+
   /* make available the pipeline objects to the main thread */
   info->th = th;
   info->pli = pli;
@@ -706,6 +711,7 @@ scan_thread(void *arg)
   /* Create processing pipeline and hit list */
   th  = p7_tophits_Create(); 
   pli = p7_pipeline_Create(info->opts, 100, 100, FALSE, p7_SCAN_MODELS);
+  if (esl_opt_IsOn(info->opts, "--topn")) p7_pli_SetTopN(pli, esl_opt_GetInteger(info->opts, "--topn"));
 
   p7_pli_NewSeq(pli, info->seq);
 
@@ -798,6 +804,8 @@ send_results(int fd, ESL_STOPWATCH *w, P7_TOPHITS *th, P7_PIPELINE *pli){
   stats.n_past_bias = pli->n_past_bias;
   stats.n_past_vit  = pli->n_past_vit;
   stats.n_past_fwd  = pli->n_past_fwd;
+  memcpy(stats.stage_ns,    pli->stage_ns,    sizeof(uint64_t) * p7_PLI_NSTAGES);
+  memcpy(stats.stage_cells, pli->stage_cells, sizeof(uint64_t) * p7_PLI_NSTAGES);
 
   stats.Z           = pli->Z;
   stats.domZ        = pli->domZ;
@@ -54,6 +54,8 @@
 #include "esl_scorematrix.h"    /* ESL_SCOREMATRIX       */
 #include "esl_stopwatch.h"      /* ESL_STOPWATCH         */
 
+#include "p7_gbands.h"		/* P7_GBANDS             */
+
 
 
 /* Search modes. */
@@ -427,6 +429,12 @@ typedef struct p7_hmmfile_s {
   FILE         *ffp;		/* MSV part of the optimized profile */
   FILE         *pfp;		/* rest of the optimized profile     */
 
+  /* ... and after p7_hmmfile_MapPressed(), point them into these instead: */
+  char         *fmap;		/* <ffp> file, mapped read-only; or NULL  */
+  char         *pmap;		/* <pfp> file, mapped read-only; or NULL  */
+  off_t         fmapsize;
+  off_t         pmapsize;
+
 #ifdef HMMER_THREADS
   int              syncRead;
   pthread_mutex_t  readMutex;
@@ -605,6 +613,26 @@ typedef struct p7_alidisplay_s {
   char *mem;			/* memory used for the char data above  */
 } P7_ALIDISPLAY;
 
+/* Structure: P7_ALITRACE
+ *
+ * Compact form of one domain's alignment, first to last M state,
+ * kept in place of a P7_ALIDISPLAY until it's known whether the
+ * domain will be reported; p7_alitrace_Display() makes the display.
+ * For an alignment of N columns with R residues, requires 2N + R +
+ * 50 bytes, in one allocation.
+ */
+typedef struct p7_alitrace_s {
+  int      N;			/* number of alignment columns (M,D,I)  */
+  int      hmmfrom;		/* start position on HMM (1..M)         */
+  int64_t  sqfrom;		/* start position on sequence (1..L)    */
+  int64_t  sqto;		/* end position on sequence   (1..L)    */
+  int64_t  L;			/* length of sequence                   */
+  char    *st;			/* [0..N-1] state of each column        */
+  char    *pp;			/* [0..N-1] encoded post probs; or NULL */
+  ESL_DSQ *rsq;			/* [1..R] residues of the M,I columns, with sentinels */
+  char    *mem;			/* memory used for the arrays above     */
+} P7_ALITRACE;
+
 
 /*****************************************************************
  * 10. P7_DOMAINDEF: reusably managing workflow in defining domains
@@ -623,7 +651,8 @@ typedef struct p7_dom_s {
   int            is_reported;	 /* TRUE if domain meets reporting thresholds                                  */
   int            is_included;	 /* TRUE if domain meets inclusion thresholds                                  */
   float         *scores_per_pos; /* only used by `nhmmer --aliscoresout`; score in BITS that each pos in ali contributes to viterbi score */
-  P7_ALIDISPLAY *ad;
+  P7_ALIDISPLAY *ad;		 /* alignment display; or NULL, not made (yet)                                 */
+  P7_ALITRACE   *atr;		 /* compact alignment, if <ad> is deferred; or NULL                            */
 } P7_DOMAIN;
 
 /* Structure: P7_DOMAINDEF
@@ -671,6 +700,9 @@ typedef struct p7_domaindef_s {
   float  min_posterior;	/* 0.25 means a cluster must have >= 25% posterior prob in the sample to be reported            */
   float  min_endpointp;	/* 0.02 means choose widest endpoint with post prob of at least 2%                              */
 
+  /* Memory limit on the DP matrices for one region or envelope */
+  double ramlimit;	/* in MB; bigger full Fwd/Bck matrices are replaced by checkpointed ones (SSE only)           */
+
   /* storage of the results; domain locations, scores, alignments          */
   P7_DOMAIN *dcl;
   int        ndom;	 /* number of domains defined, in the end.         */
@@ -683,6 +715,11 @@ typedef struct p7_domaindef_s {
   int    noverlaps;	/* number of envelopes defined in ensemble clustering that overlap w/ prev envelope */
   int    nenvelopes;	/* number of envelopes handed over for domain definition, null2, alignment, and scoring. */
 
+  /* Alignment display timing, for P7_PIPELINE's stage accounting; not reset by Reuse() */
+  uint64_t ad_ns;	/* wall time making alignment displays, nanosec */
+  uint64_t ad_cells;	/* total length of the alignment displays made   */
+
+  int    do_lazy_ad;	/* TRUE to keep a P7_ALITRACE, not an alidisplay */
 } P7_DOMAINDEF;
 
 
@@ -1176,6 +1213,20 @@ enum p7_pipemodes_e { p7_SEARCH_SEQS = 0, p7_SCAN_MODELS = 1 };
 enum p7_zsetby_e    { p7_ZSETBY_NTARGETS = 0, p7_ZSETBY_OPTION = 1, p7_ZSETBY_FILEINFO = 2 };
 enum p7_complementarity_e { p7_NOCOMPLEMENT    = 0, p7_COMPLEMENT   = 1 };
 
+/* Stages of the pipeline that are timed, indexing P7_PIPELINE's stage_ns[], stage_cells[] */
+enum p7_pli_stage_e { p7_PLI_MSV = 0, p7_PLI_BIAS = 1, p7_PLI_VIT = 2, p7_PLI_FWD = 3, p7_PLI_BCK = 4, p7_PLI_DOMAIN = 5, p7_PLI_ALIDISPLAY = 6 };
+#define p7_PLI_NSTAGES 7
+
+/* Deferred domain definition (p7_pli_SetDeferred()): off, or which of the two passes */
+enum p7_pli_defer_e { p7_DEFER_OFF = 0, p7_DEFER_RECORD = 1, p7_DEFER_ANNOTATE = 2 };
+
+/* A target that passed the Forward filter in the recording pass */
+typedef struct p7_pli_deferred_s {
+  int64_t idx;			/* target's index in the database, sq->idx  */
+  float   fwdsc;		/* its Forward score (nats)                 */
+  float   nullsc;		/* its null model score (nats)              */
+} P7_PLI_DEFERRED;
+
 typedef struct p7_pipeline_s {
   /* Dynamic programming matrices                                           */
   P7_OMX     *oxf;		/* one-row Forward matrix, accel pipe       */
@@ -1183,10 +1234,38 @@ typedef struct p7_pipeline_s {
   P7_OMX     *fwd;		/* full Fwd matrix for domain envelopes     */
   P7_OMX     *bck;		/* full Bck matrix for domain envelopes     */
 
+  /* MSV scores for a block of targets, p7_pli_MSVBlock(), p7_Pipeline_Block() and p7_Pipeline_ScanBlock() */
+  float      *blk_usc;		/* [0..n-1] MSV filter score of each target */
+  int64_t    *blk_key;		/* [0..n-1] length<<32 | index; or index    */
+  const ESL_DSQ **blk_dsq;	/* [0..n-1] short targets, sorted by length */
+  int        *blk_L;		/* [0..n-1] their lengths                   */
+  float      *blk_sc;		/* [0..n-1] their scores                    */
+  int         blk_nalloc;	/* current allocation of the blk_* arrays   */
+
+  /* Banded Forward/Backward parsing of long targets, p7_ForwardBanded()    */
+  P7_GBANDS  *bnd;		/* row bands for the current target         */
+  P7_OMX     *bfx;		/* banded Forward parsing matrix           */
+  int         do_banded;	/* TRUE to try banded parsing on long targs */
+  double      band_minLM;	/* only for targets with M*L at least this  */
+  float       band_endp;	/* E/(N+J+C) threshold for a candidate end  */
+  double      band_tol;		/* max prob mass the bands may leave out    */
+
+  /* Top-N mode: report only the best <topn> targets (p7_pli_SetTopN())    */
+  int         topn;		/* 0, or max # of targets to report         */
+  double     *topn_key;		/* min-heap of the best hits' sortkeys      */
+  int         topn_n;		/* # of keys in the heap, 0..topn           */
+
+  /* Deferred domain definition: a recording pass, then an annotating one  */
+  enum p7_pli_defer_e defer;	/* p7_DEFER_OFF | _RECORD | _ANNOTATE       */
+  P7_PLI_DEFERRED *dfr;		/* recorded targets; or selected, by idx    */
+  int64_t     ndfr;		/* # of targets in <dfr>                    */
+  int64_t     dfr_nalloc;	/* current allocation; 0 if <dfr> is shared */
+
   /* Domain postprocessing                                                  */
   ESL_RANDOMNESS *r;		/* random number generator                  */
   int             do_reseeding; /* TRUE: reseed for reproducible results    */
   int  do_alignment_score_calc; /* used only by nhmmer --aliscoresout       */
+  int             do_lazy_ad;	/* TRUE: displays made by p7_tophits_MakeDisplays() */
   P7_DOMAINDEF   *ddef;		/* domain definition workflow               */
 
   /* Reporting threshold settings                                           */
@@ -1232,12 +1311,20 @@ typedef struct p7_pipeline_s {
   uint64_t      n_past_bias;	/* # comparisons that pass bias filter      */
   uint64_t      n_past_vit;	/* # comparisons that pass ViterbiFilter()  */
   uint64_t      n_past_fwd;	/* # comparisons that pass ForwardFilter()  */
+  uint64_t      n_banded;	/* # comparisons parsed with banded Fwd/Bck */
+  uint64_t      n_band_fallback;/* # where the bands lost too much; full    */
+  double        band_maxerr;	/* largest prob mass left out by the bands  */
+  uint64_t      n_topn_skipped;	/* # past Fwd that couldn't make the top N  */
+  uint64_t      n_deferred;	/* # past Fwd recorded for a second pass    */
+  uint64_t      n_dfr_selected;	/* # of those that could still be reported  */
   uint64_t      n_output;	    /* # alignments that make it to the final output (used for nhmmer) */
   uint64_t      pos_past_msv;	/* # positions that pass MSVFilter()  (used for nhmmer) */
   uint64_t      pos_past_bias;	/* # positions that pass bias filter  (used for nhmmer) */
   uint64_t      pos_past_vit;	/* # positions that pass ViterbiFilter()  (used for nhmmer) */
   uint64_t      pos_past_fwd;	/* # positions that pass ForwardFilter()  (used for nhmmer) */
   uint64_t      pos_output;	    /* # positions that make it to the final output (used for nhmmer) */
+  uint64_t      stage_ns[p7_PLI_NSTAGES];    /* wall time spent in each stage, nanosec    */
+  uint64_t      stage_cells[p7_PLI_NSTAGES]; /* DP cells (bias: residues) in each stage   */
 
   enum p7_pipemodes_e mode;    	/* p7_SCAN_MODELS | p7_SEARCH_SEQS          */
   int           long_targets;   /* TRUE if the target sequences are expected to be very long (e.g. dna chromosome search in nhmmer) */
@@ -1485,6 +1572,9 @@ extern int            p7_translated_alidisplay_Print(FILE *fp, P7_ALIDISPLAY *ad
 extern int            p7_nontranslated_alidisplay_Print(FILE *fp, P7_ALIDISPLAY *ad, int min_aliwidth, int linewidth, int show_accessions);
 
 extern int            p7_alidisplay_Backconvert(const P7_ALIDISPLAY *ad, const ESL_ALPHABET *abc, ESL_SQ **ret_sq, P7_TRACE **ret_tr);
+extern P7_ALITRACE   *p7_alitrace_Create(const P7_TRACE *tr, int which, const ESL_SQ *sq);
+extern P7_ALIDISPLAY *p7_alitrace_Display(const P7_ALITRACE *atr, const P7_OPROFILE *om, const char *sqname, const char *sqacc, const char *sqdesc);
+extern void           p7_alitrace_Destroy(P7_ALITRACE *atr);
 extern int            p7_alidisplay_Sample(ESL_RANDOMNESS *rng, int N, P7_ALIDISPLAY **ret_ad);
 extern int            p7_alidisplay_Dump(FILE *fp, const P7_ALIDISPLAY *ad);
 extern int            p7_alidisplay_Compare(const P7_ALIDISPLAY *ad1, const P7_ALIDISPLAY *ad2);
@@ -1601,6 +1691,7 @@ extern void p7_hmmfile_Close(P7_HMMFILE *hfp);
 #ifdef HMMER_THREADS
 extern int  p7_hmmfile_CreateLock(P7_HMMFILE *hfp);
 #endif
+extern int  p7_hmmfile_MapPressed(P7_HMMFILE *hfp);
 extern int  p7_hmmfile_WriteBinary(FILE *fp, int format, P7_HMM *hmm);
 extern int  p7_hmmfile_WriteASCII (FILE *fp, int format, P7_HMM *hmm);
 extern int  p7_hmmfile_WriteToString (char **s, int format, P7_HMM *hmm);
@@ -1634,6 +1725,10 @@ extern P7_PIPELINE *p7_pipeline_Create(const ESL_GETOPTS *go, int M_hint, int L_
 extern int          p7_pipeline_Reuse  (P7_PIPELINE *pli);
 extern void         p7_pipeline_Destroy(P7_PIPELINE *pli);
 extern int          p7_pipeline_Merge  (P7_PIPELINE *p1, P7_PIPELINE *p2);
+extern int          p7_pli_SetTopN     (P7_PIPELINE *pli, int topn);
+extern int          p7_pli_SetDeferred (P7_PIPELINE *pli);
+extern int          p7_pli_DeferredSelect(P7_PIPELINE *pli, const P7_OPROFILE *om);
+extern int          p7_pli_DeferredShare (P7_PIPELINE *pli, const P7_PIPELINE *src);
 
 extern int p7_pli_ExtendAndMergeWindows (P7_OPROFILE *om, const P7_SCOREDATA *msvdata, P7_HMM_WINDOWLIST *windowlist, float pct_overlap);
 extern int p7_pli_TargetReportable  (P7_PIPELINE *pli, float score,     double lnP);
@@ -1644,7 +1739,11 @@ extern int p7_pli_DomainIncludable  (P7_PIPELINE *pli, float dom_score, double l
 extern int p7_pli_NewModel          (P7_PIPELINE *pli, const P7_OPROFILE *om, P7_BG *bg);
 extern int p7_pli_NewModelThresholds(P7_PIPELINE *pli, const P7_OPROFILE *om);
 extern int p7_pli_NewSeq            (P7_PIPELINE *pli, const ESL_SQ *sq);
+extern int p7_pli_MSVBlock          (P7_PIPELINE *pli, P7_OPROFILE *om, const ESL_SQ *sq, int nseq);
 extern int p7_Pipeline              (P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *th);
+extern int p7_Pipeline_FromMSV      (P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *th, float usc);
+extern int p7_Pipeline_Block        (P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, int nseq, P7_TOPHITS *th);
+extern int p7_Pipeline_ScanBlock    (P7_PIPELINE *pli, P7_OPROFILE **oml, int nmodels, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *th);
 extern int p7_Pipeline_LongTarget   (P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCOREDATA *data,
                                      P7_BG *bg, P7_TOPHITS *hitlist, int64_t seqidx,
                                      const ESL_SQ *sq, int complementarity,
@@ -1653,7 +1752,10 @@ extern int p7_Pipeline_LongTarget   (P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCORE
 
 
 
+extern uint64_t p7_pli_Clock(void);
 extern int p7_pli_Statistics(FILE *ofp, P7_PIPELINE *pli, ESL_STOPWATCH *w);
+extern int p7_pli_StageStatistics(FILE *ofp, P7_PIPELINE *pli);
+extern int p7_pli_WriteStageTable(FILE *ofp, char *qname, P7_PIPELINE *pli, int show_header);
 
 
 /* p7_prior.c */
@@ -1718,6 +1820,7 @@ extern void        p7_tophits_Destroy(P7_TOPHITS *h);
 extern int p7_tophits_ComputeNhmmerEvalues(P7_TOPHITS *th, double N, int W);
 extern int p7_tophits_RemoveDuplicates(P7_TOPHITS *th, int using_bit_cutoffs);
 extern int p7_tophits_Threshold(P7_TOPHITS *th, P7_PIPELINE *pli);
+extern int p7_tophits_MakeDisplays(P7_TOPHITS *th, P7_PIPELINE *pli, const P7_OPROFILE *om, int maybe_reported);
 extern int p7_tophits_CompareRanking(P7_TOPHITS *th, ESL_KEYHASH *kh, int *opt_nnew);
 extern int p7_tophits_Targets(FILE *ofp, P7_TOPHITS *th, P7_PIPELINE *pli, int textw);
 extern int p7_tophits_Domains(FILE *ofp, P7_TOPHITS *th, P7_PIPELINE *pli, int textw);
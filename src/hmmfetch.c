@@ -15,6 +15,10 @@
 #include "esl_ssi.h"
 
 #include "hmmer.h"
+#ifdef HMMER_THREADS
+#include "esl_threads.h"
+#include "p7_hmmreader.h"
+#endif
 
 static char banner[] = "retrieve profile HMM(s) from a file";
 static char usage1[] = "[options] <hmmfile> <key>         (retrieves HMM named <key>)";
@@ -55,12 +59,18 @@ static ESL_OPTIONS options[] = {
   { "-o",       eslARG_OUTFILE,FALSE,NULL, NULL, NULL, NULL,"-O,--index",   "output HMM to file <f> instead of stdout",          0 },
   { "-O",       eslARG_NONE,  FALSE, NULL, NULL, NULL, NULL,"-o,-f,--index","output HMM to file named <key>",                    0 },
   { "--index",  eslARG_NONE,  FALSE, NULL, NULL, NULL, NULL, NULL,          "index the <hmmfile>, creating <hmmfile>.ssi",       0 },
+#ifdef HMMER_THREADS
+  { "--cpu",    eslARG_INT, p7_NCPU,"HMMER_NCPU","n>=0",NULL,NULL,NULL,     "number of parallel CPU workers parsing <hmmfile>",  0 },
+#endif
   { 0,0,0,0,0,0,0,0,0,0 },
 };
 
 static void create_ssi_index(ESL_GETOPTS *go, P7_HMMFILE *hfp);
 static void multifetch(ESL_GETOPTS *go, FILE *ofp, char *keyfile, P7_HMMFILE *hfp);
 static void onefetch(ESL_GETOPTS *go, FILE *ofp, char *key, P7_HMMFILE *hfp);
+#ifdef HMMER_THREADS
+static P7_HMMREADER *open_reader(ESL_GETOPTS *go, P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc);
+#endif
 
 int
 main(int argc, char **argv)
@@ -165,6 +175,9 @@ create_ssi_index(ESL_GETOPTS *go, P7_HMMFILE *hfp)
   char         *ssifile = NULL;
   uint16_t      fh;
   int           status;
+#ifdef HMMER_THREADS
+  P7_HMMREADER *rdr     = NULL;
+#endif
 
   if (esl_sprintf(&ssifile, "%s.ssi", hfp->fname) != eslOK) p7_Die("esl_sprintf() failed");
 
@@ -178,10 +191,20 @@ create_ssi_index(ESL_GETOPTS *go, P7_HMMFILE *hfp)
 
   printf("Working...    "); 
   fflush(stdout);
-  
-  while ((status = p7_hmmfile_Read(hfp, &abc, &hmm)) != eslEOF)
+
+#ifdef HMMER_THREADS
+  rdr = open_reader(go, hfp, &abc);
+#endif
+  for (;;)
     {
-      if      (status == eslEOD)       p7_Fail("read failed, HMM file %s may be truncated?", hfp->fname);
+#ifdef HMMER_THREADS
+      if (rdr) status = p7_hmmreader_Read(rdr, &hmm, NULL);
+      else
+#endif
+      status = p7_hmmfile_Read(hfp, &abc, &hmm);
+
+      if      (status == eslEOF)       break;
+      else if (status == eslEOD)       p7_Fail("read failed, HMM file %s may be truncated?", hfp->fname);
       else if (status == eslEFORMAT)   p7_Fail("bad file format in HMM file %s",             hfp->fname);
       else if (status == eslEINCOMPAT) p7_Fail("HMM file %s contains different alphabets",   hfp->fname);
       else if (status != eslOK)        p7_Fail("Unexpected error in reading HMMs from %s",   hfp->fname);
@@ -209,6 +232,9 @@ create_ssi_index(ESL_GETOPTS *go, P7_HMMFILE *hfp)
     printf("Indexed %d HMMs (%ld names).\n", nhmm, (long) ns->nprimary);
   printf("SSI index written to file %s\n", ssifile);
 
+#ifdef HMMER_THREADS
+  p7_hmmreader_Close(rdr);
+#endif
   free(ssifile);
   esl_alphabet_Destroy(abc);
   esl_newssi_Close(ns);
@@ -241,6 +267,9 @@ multifetch(ESL_GETOPTS *go, FILE *ofp, char *keyfile, P7_HMMFILE *hfp)
   int             keylen;
   int             keyidx;
   int             status;
+#ifdef HMMER_THREADS
+  P7_HMMREADER   *rdr    = NULL;
+#endif
   
   if (esl_fileparser_Open(keyfile, NULL, &efp) != eslOK)  p7_Fail("Failed to open key file %s\n", keyfile);
   esl_fileparser_SetCommentChar(efp, '#');
@@ -258,9 +287,19 @@ multifetch(ESL_GETOPTS *go, FILE *ofp, char *keyfile, P7_HMMFILE *hfp)
 
   if (hfp->ssi == NULL) 
     {
-      while ((status = p7_hmmfile_Read(hfp, &abc, &hmm)) != eslEOF)
+#ifdef HMMER_THREADS
+      rdr = open_reader(go, hfp, &abc);
+#endif
+      for (;;)
 	{
-	  if      (status == eslEOD)       p7_Fail("read failed, HMM file %s may be truncated?", hfp->fname);
+#ifdef HMMER_THREADS
+	  if (rdr) status = p7_hmmreader_Read(rdr, &hmm, NULL);
+	  else
+#endif
+	  status = p7_hmmfile_Read(hfp, &abc, &hmm);
+
+	  if      (status == eslEOF)       break;
+	  else if (status == eslEOD)       p7_Fail("read failed, HMM file %s may be truncated?", hfp->fname);
 	  else if (status == eslEFORMAT)   p7_Fail("bad file format in HMM file %s",             hfp->fname);
 	  else if (status == eslEINCOMPAT) p7_Fail("HMM file %s contains different alphabets",   hfp->fname);
 	  else if (status != eslOK)        p7_Fail("Unexpected error in reading HMMs from %s",   hfp->fname);
@@ -276,6 +315,9 @@ multifetch(ESL_GETOPTS *go, FILE *ofp, char *keyfile, P7_HMMFILE *hfp)
 	}
     }
   
+#ifdef HMMER_THREADS
+  p7_hmmreader_Close(rdr);
+#endif
   if (ofp != stdout) printf("\nRetrieved %d HMMs.\n", nhmm);
   if (abc != NULL) esl_alphabet_Destroy(abc);
   esl_keyhash_Destroy(keys);
@@ -327,3 +369,27 @@ onefetch(ESL_GETOPTS *go, FILE *ofp, char *key, P7_HMMFILE *hfp)
 
   esl_alphabet_Destroy(abc);
 }
+
+
+#ifdef HMMER_THREADS
+/* open_reader():
+ * With --cpu workers, start parsing all of <hfp> in parallel, for
+ * the modes that read the whole file. Return NULL if there are no
+ * workers or the file can't be split; then it's read the usual way.
+ */
+static P7_HMMREADER *
+open_reader(ESL_GETOPTS *go, P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc)
+{
+  P7_HMMREADER *rdr   = NULL;
+  int           ncpus = ESL_MIN( esl_opt_GetInteger(go, "--cpu"), esl_threads_GetCPUCount());
+  int           status;
+
+  if (ncpus > 0)
+    {
+      status = p7_hmmreader_Open(hfp, byp_abc, ncpus, p7_HMMREADER_HMMS, 0, &rdr);
+      if      (status == eslEFORMAT) p7_Fail("bad file format in HMM file %s", hfp->fname);
+      else if (status != eslOK && status != eslEINCOMPAT && status != eslEOF) p7_Fail("Unexpected error %d in opening parallel reader for %s", status, hfp->fname);
+    }
+  return rdr;
+}
+#endif /*HMMER_THREADS*/
@@ -26,6 +26,8 @@ typedef struct {
   uint64_t   n_past_bias;     	/* # comparisons that pass bias filter      */
   uint64_t   n_past_vit;      	/* # comparisons that pass ViterbiFilter()  */
   uint64_t   n_past_fwd;      	/* # comparisons that pass ForwardFilter()  */
+  uint64_t   stage_ns[p7_PLI_NSTAGES];    /* wall time in each pipeline stage, ns */
+  uint64_t   stage_cells[p7_PLI_NSTAGES]; /* DP cells in each pipeline stage      */
 
   uint64_t   nhits;           	/* number of hits in list now               */
   uint64_t   nreported;       	/* number of hits that are reportable       */
@@ -94,7 +96,7 @@ typedef struct {
 } HMMD_COMMAND;
 
 #define HMMD_SEARCH_STATUS_SERIAL_SIZE sizeof(uint32_t) + sizeof(uint64_t)
-#define HMMD_SEARCH_STATS_SERIAL_BASE (5 * sizeof(double)) + (9 * sizeof(uint64_t)) + 2
+#define HMMD_SEARCH_STATS_SERIAL_BASE (5 * sizeof(double)) + ((9 + 2 * p7_PLI_NSTAGES) * sizeof(uint64_t)) + 2
 // The 2 is two enums at one byte/enum as we serialize them
 #define MSG_SIZE(x) (sizeof(HMMD_HEADER) + ((HMMD_HEADER *)(x))->length)
 
@@ -608,6 +608,8 @@ void hmmpgmd2msa_utest(int ntrials, char *hmmfile){
     stats.n_past_bias = pli->n_past_bias;
     stats.n_past_vit = pli->n_past_vit;
     stats.n_past_fwd = pli->n_past_fwd;
+    memcpy(stats.stage_ns,    pli->stage_ns,    sizeof(uint64_t) * p7_PLI_NSTAGES);
+    memcpy(stats.stage_cells, pli->stage_cells, sizeof(uint64_t) * p7_PLI_NSTAGES);
     stats.nhits = hitlist->N;
     stats.nreported = hitlist->nreported;
     stats.nincluded = hitlist->nreported;
@@ -5,23 +5,34 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "easel.h"
 #include "esl_alphabet.h"
 #include "esl_getopts.h"
+#include "esl_ssi.h"
+
+#ifdef HMMER_THREADS
+#include "esl_threads.h"
+#endif
 
 #include "hmmer.h"
+#include "p7_scheduler.h"
 
 static ESL_OPTIONS options[] = {
   /* name           type      default  env  range     toggles      reqs   incomp  help   docgroup*/
   { "-h",        eslARG_NONE,   FALSE, NULL, NULL,      NULL,      NULL,    NULL, "show brief help on version and usage",          0 },
-  { "-f",        eslARG_NONE,   FALSE, NULL, NULL,      NULL,      NULL,    NULL, "force: overwrite any previous pressed files",   0 },
+  { "-f",        eslARG_NONE,   FALSE, NULL, NULL,      NULL,      NULL,"--append", "force: overwrite any previous pressed files",   0 },
+  { "--append",  eslARG_NONE,   FALSE, NULL, NULL,      NULL,      NULL,    "-f", "press only models added since the last press",  0 },
+#ifdef HMMER_THREADS
+  { "--cpu",     eslARG_INT, p7_NCPU,"HMMER_NCPU","n>=0",NULL,     NULL,    NULL, "number of parallel CPU workers for multithreads", 0 },
+#endif
   {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
 static char usage[]  = "[-options] <hmmfile>";
 static char banner[] = "prepare an HMM database for faster hmmscan searches";
 
-/* hmmpress creates four output files. 
+/* hmmpress creates four output files.
  * Bundling their info into a structure streamlines creation and cleanup.
  */
 struct dbfiles {
@@ -29,15 +40,47 @@ struct dbfiles {
   char       *ffile;    // .h3f file: binary vectorized profiles, MSV filter part only
   char       *pfile;    // .h3p file: binary vectorized profiles, remainder (excluding MSV filter part)
   char       *ssifile;  // .h3i file: SSI index for retrieval from .h3m
+  char       *tmpfile;  // with --append, the new SSI index is built here, then renamed to <ssifile>
 
   FILE       *mfp;
   FILE       *ffp;
   FILE       *pfp;
   ESL_NEWSSI *nssi;
+
+  int         do_append; // TRUE if new models are added at the end of existing files...
+  off_t       msize;     // ... which were this long before; on failure, they're cut back
+  off_t       fsize;
+  off_t       psize;
 };
-  
+
+/* Models are read in blocks. The profiles of a block are converted
+ * by the workers, in any order; then the master writes the block's
+ * models and profiles, in order.
+ */
+#define BLOCK_SIZE 256
+
+typedef struct {
+  P7_HMM      **hmm;    /* [0..count-1] models read from <hmmfile>      */
+  P7_OPROFILE **om;     /* [0..count-1] their profiles, once converted  */
+  int           count;
+} PRESS_BLOCK;
+
+typedef struct {
+  P7_BG        *bg;     /* null model for configuring profiles          */
+#ifdef HMMER_THREADS
+  P7_SCHEDULER *sched;
+#endif
+} WORKER_INFO;
+
 static struct dbfiles *open_dbfiles (ESL_GETOPTS *go, char *basename);
 static void            close_dbfiles(struct dbfiles *dbf, int status);
+static int             pressed_keys (char *hmmfile, P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, ESL_NEWSSI *nssi, uint16_t fh, int *ret_nold, char *errbuf);
+static int             convert_model(P7_HMM *hmm, P7_BG *bg, P7_OPROFILE **ret_om);
+
+#ifdef HMMER_THREADS
+static int  thread_loop   (ESL_THREADS *obj, P7_SCHEDULER *sched, WORKER_INFO *info, int ncpus, PRESS_BLOCK *blk);
+static void convert_thread(void *arg);
+#endif
 
 int
 main(int argc, char **argv)
@@ -47,22 +90,32 @@ main(int argc, char **argv)
   char           *hmmfile = esl_opt_GetArg(go, 1);
   P7_HMMFILE     *hfp     = NULL;
   P7_HMM         *hmm     = NULL;
-  P7_BG          *bg      = NULL;
-  P7_PROFILE     *gm      = NULL;
   P7_OPROFILE    *om      = NULL;
+  PRESS_BLOCK    *blk     = NULL;
+  WORKER_INFO    *info    = NULL;
   struct dbfiles *dbf     = NULL;
   uint16_t        fh      = 0;
   int             nmodel  = 0;
+  int             nold    = 0;
   uint64_t        totM    = 0;
+  uint64_t        nprimary, nsecondary;
+  int             ncpus   = 0;
+  int             infocnt = 0;
+  int             i;
+  int             rstatus;
   int             status;
   char            errbuf[eslERRBUFSIZE];
+#ifdef HMMER_THREADS
+  ESL_THREADS    *threadObj = NULL;
+  P7_SCHEDULER   *sched     = NULL;
+#endif
 
   if (strcmp(hmmfile, "-") == 0) p7_Fail("Can't use - for <hmmfile> argument: can't index standard input\n");
 
   status = p7_hmmfile_OpenENoDB(hmmfile, NULL, &hfp, errbuf);
   if      (status == eslENOTFOUND) p7_Fail("File existence/permissions problem in trying to open HMM file %s.\n%s\n", hmmfile, errbuf);
   else if (status == eslEFORMAT)   p7_Fail("File format problem in trying to open HMM file %s.\n%s\n",                hmmfile, errbuf);
-  else if (status != eslOK)        p7_Fail("Unexpected error %d in opening HMM file %s.\n%s\n",                       status, hmmfile, errbuf);  
+  else if (status != eslOK)        p7_Fail("Unexpected error %d in opening HMM file %s.\n%s\n",                       status, hmmfile, errbuf);
 
   if (hfp->do_stdin || hfp->do_gzip) p7_Fail("HMM file %s must be a normal file, not gzipped or a stdin pipe", hmmfile);
 
@@ -71,64 +124,138 @@ main(int argc, char **argv)
   if (( status = esl_newssi_AddFile(dbf->nssi, hfp->fname, 0, &fh)) != eslOK) /* 0 = format code (HMMs don't have any yet) */
      ESL_XFAIL(status, errbuf, "Failed to add HMM file %s to new SSI index\n", hfp->fname);
 
-  printf("Working...    "); 
+  /* With --append, the models that are already pressed keep their
+   * place in the files; we index them again, and skip past them.
+   */
+  if (dbf->do_append && (status = pressed_keys(hmmfile, hfp, &abc, dbf->nssi, fh, &nold, errbuf)) != eslOK) goto ERROR;
+
+  printf("Working...    ");
   fflush(stdout);
 
-  while ((status = p7_hmmfile_Read(hfp, &abc, &hmm)) == eslOK)
+  if ((blk = malloc(sizeof(PRESS_BLOCK))) == NULL) ESL_XFAIL(eslEMEM, errbuf, "malloc() failed");
+  blk->hmm   = NULL;
+  blk->om    = NULL;
+  blk->count = 0;
+  ESL_ALLOC(blk->hmm, sizeof(P7_HMM *)      * BLOCK_SIZE);
+  ESL_ALLOC(blk->om,  sizeof(P7_OPROFILE *) * BLOCK_SIZE);
+  for (i = 0; i < BLOCK_SIZE; i++) { blk->hmm[i] = NULL; blk->om[i] = NULL; }
+
+#ifdef HMMER_THREADS
+  ncpus = ESL_MIN( esl_opt_GetInteger(go, "--cpu"), esl_threads_GetCPUCount());
+  if (ncpus > 0)
     {
-      if (hmm->name == NULL) ESL_XFAIL(eslEINVAL, errbuf, "Every HMM must have a name to be indexed. Failed to find name of HMM #%d\n", nmodel+1); 
-
-      if (nmodel == 0) { 	/* first time initialization, now that alphabet known */
-	bg = p7_bg_Create(abc);
-	p7_bg_SetLength(bg, 400);
-      }
-
-      nmodel++;
-      totM += hmm->M;
-
-      gm = p7_profile_Create(hmm->M, abc);
-      p7_ProfileConfig(hmm, bg, gm, 400, p7_LOCAL);
-      om = p7_oprofile_Create(gm->M, abc);
-      p7_oprofile_Convert(gm, om);
-      
-      if ((om->offs[p7_MOFFSET] = ftello(dbf->mfp)) == -1) ESL_XFAIL(eslESYS, errbuf, "Failed to ftello() current disk position of HMM db file");
-      if ((om->offs[p7_FOFFSET] = ftello(dbf->ffp)) == -1) ESL_XFAIL(eslESYS, errbuf, "Failed to ftello() current disk position of MSV db file");   
-      if ((om->offs[p7_POFFSET] = ftello(dbf->pfp)) == -1) ESL_XFAIL(eslESYS, errbuf, "Failed to ftello() current disk position of profile db file"); 
-
-      if ((status = esl_newssi_AddKey(dbf->nssi, hmm->name, fh, om->offs[p7_MOFFSET], 0, 0)) != eslOK) ESL_XFAIL(status, errbuf, "Failed to add key %s to SSI index", hmm->name); 
-      if (hmm->acc) {
-	if ((status = esl_newssi_AddAlias(dbf->nssi, hmm->acc, hmm->name))                   != eslOK) ESL_XFAIL(status, errbuf, "Failed to add secondary key %s to SSI index", hmm->acc); 
-      }
-
-      p7_hmmfile_WriteBinary(dbf->mfp, -1, hmm);
-      p7_oprofile_Write(dbf->ffp, dbf->pfp, om);
+      threadObj = esl_threads_Create(&convert_thread);
+      sched     = p7_scheduler_Create(ncpus);
+      if (threadObj == NULL || sched == NULL)        ESL_XFAIL(eslEMEM, errbuf, "Failed to create worker threads");
+      if (p7_scheduler_Add(sched, blk) != eslOK)     ESL_XFAIL(eslEMEM, errbuf, "Failed to add block to scheduler");
+    }
+#endif
+  infocnt = (ncpus == 0) ? 1 : ncpus;
+  ESL_ALLOC(info, sizeof(WORKER_INFO) * infocnt);
+  for (i = 0; i < infocnt; i++)
+    {
+      info[i].bg = NULL;
+#ifdef HMMER_THREADS
+      info[i].sched = sched;
+#endif
+    }
 
-      p7_profile_Destroy(gm);
-      p7_oprofile_Destroy(om);
-      p7_hmm_Destroy(hmm);
+  /* Main loop: read a block of models; convert their profiles, in
+   * parallel if we can; write them, in the order they were read.
+   */
+  rstatus = eslOK;
+  while (rstatus == eslOK)
+    {
+      for (blk->count = 0; blk->count < BLOCK_SIZE; blk->count++)
+	if ((rstatus = p7_hmmfile_Read(hfp, &abc, &(blk->hmm[blk->count]))) != eslOK) break;
+      if (rstatus != eslOK && rstatus != eslEOF) break;
+      if (blk->count == 0) break;
+
+      for (i = 0; i < blk->count; i++)
+	if (blk->hmm[i]->name == NULL) ESL_XFAIL(eslEINVAL, errbuf, "Every HMM must have a name to be indexed. Failed to find name of HMM #%d\n", nold+nmodel+i+1);
+
+      if (info[0].bg == NULL) 	/* first time initialization, now that alphabet known */
+	for (i = 0; i < infocnt; i++) {
+	  info[i].bg = p7_bg_Create(abc);
+	  p7_bg_SetLength(info[i].bg, 400);
+	}
+
+#ifdef HMMER_THREADS
+      if (ncpus > 0) { if ((status = thread_loop(threadObj, sched, info, ncpus, blk)) != eslOK) ESL_XFAIL(status, errbuf, "Threaded profile conversion failed"); }
+      else
+#endif
+	for (i = 0; i < blk->count; i++)
+	  if ((status = convert_model(blk->hmm[i], info[0].bg, &(blk->om[i]))) != eslOK) ESL_XFAIL(status, errbuf, "Failed to convert HMM %s to a profile", blk->hmm[i]->name);
+
+      for (i = 0; i < blk->count; i++)
+	{
+	  hmm = blk->hmm[i];
+	  om  = blk->om[i];
+	  nmodel++;
+	  totM += hmm->M;
+
+	  if ((om->offs[p7_MOFFSET] = ftello(dbf->mfp)) == -1) ESL_XFAIL(eslESYS, errbuf, "Failed to ftello() current disk position of HMM db file");
+	  if ((om->offs[p7_FOFFSET] = ftello(dbf->ffp)) == -1) ESL_XFAIL(eslESYS, errbuf, "Failed to ftello() current disk position of MSV db file");
+	  if ((om->offs[p7_POFFSET] = ftello(dbf->pfp)) == -1) ESL_XFAIL(eslESYS, errbuf, "Failed to ftello() current disk position of profile db file");
+
+	  /* The data offset is the model's place in <hmmfile>, which --append needs to find where to resume */
+	  if ((status = esl_newssi_AddKey(dbf->nssi, hmm->name, fh, om->offs[p7_MOFFSET], hmm->offset, 0)) != eslOK) ESL_XFAIL(status, errbuf, "Failed to add key %s to SSI index", hmm->name);
+	  if (hmm->acc) {
+	    if ((status = esl_newssi_AddAlias(dbf->nssi, hmm->acc, hmm->name))                          != eslOK) ESL_XFAIL(status, errbuf, "Failed to add secondary key %s to SSI index", hmm->acc);
+	  }
+
+	  if ((status = p7_hmmfile_WriteBinary(dbf->mfp, -1, hmm))   != eslOK) ESL_XFAIL(status, errbuf, "Failed to write HMM %s to %s",     hmm->name, dbf->mfile);
+	  if ((status = p7_oprofile_Write(dbf->ffp, dbf->pfp, om))  != eslOK) ESL_XFAIL(status, errbuf, "Failed to write profile %s to %s", hmm->name, dbf->pfile);
+
+	  p7_oprofile_Destroy(om);  blk->om[i]  = NULL;
+	  p7_hmm_Destroy(hmm);      blk->hmm[i] = NULL;
+	}
     }
-  if      (status == eslEFORMAT)   ESL_XFAIL(status, errbuf, "bad file format in HMM file %s",             hmmfile); 
-  else if (status == eslEINCOMPAT) ESL_XFAIL(status, errbuf, "HMM file %s contains different alphabets",   hmmfile); 
-  else if (status != eslEOF)       ESL_XFAIL(status, errbuf, "Unexpected error in reading HMMs from %s",   hmmfile); 
+  if      (rstatus == eslEFORMAT)   ESL_XFAIL(rstatus, errbuf, "bad file format in HMM file %s",             hmmfile);
+  else if (rstatus == eslEINCOMPAT) ESL_XFAIL(rstatus, errbuf, "HMM file %s contains different alphabets",   hmmfile);
+  else if (rstatus != eslEOF)       ESL_XFAIL(rstatus, errbuf, "Unexpected error in reading HMMs from %s",   hmmfile);
 
   status = esl_newssi_Write(dbf->nssi);
-  if      (status == eslEDUP)     ESL_XFAIL(status, errbuf, "SSI index construction failed:\n  %s", dbf->nssi->errbuf);        
-  else if (status == eslERANGE)   ESL_XFAIL(status, errbuf, "SSI index file size exceeds maximum allowed by your filesystem"); 
-  else if (status == eslESYS)     ESL_XFAIL(status, errbuf, "SSI index sort failed:\n  %s", dbf->nssi->errbuf);    
-  else if (status != eslOK)       ESL_XFAIL(status, errbuf, "SSI indexing failed:\n  %s", dbf->nssi->errbuf);                 
-  
+  if      (status == eslEDUP)     ESL_XFAIL(status, errbuf, "SSI index construction failed:\n  %s", dbf->nssi->errbuf);
+  else if (status == eslERANGE)   ESL_XFAIL(status, errbuf, "SSI index file size exceeds maximum allowed by your filesystem");
+  else if (status == eslESYS)     ESL_XFAIL(status, errbuf, "SSI index sort failed:\n  %s", dbf->nssi->errbuf);
+  else if (status != eslOK)       ESL_XFAIL(status, errbuf, "SSI indexing failed:\n  %s", dbf->nssi->errbuf);
+  nprimary   = dbf->nssi->nprimary;
+  nsecondary = dbf->nssi->nsecondary;
+
+  /* With --append, the new index now replaces the old one */
+  if (dbf->do_append)
+    {
+      esl_newssi_Close(dbf->nssi);
+      dbf->nssi = NULL;
+      if (rename(dbf->tmpfile, dbf->ssifile) != 0) ESL_XFAIL(eslESYS, errbuf, "Failed to replace SSI index %s with %s", dbf->ssifile, dbf->tmpfile);
+    }
+
   printf("done.\n");
-  if (dbf->nssi->nsecondary > 0) 
-    printf("Pressed and indexed %d HMMs (%ld names and %ld accessions).\n", nmodel, (long) dbf->nssi->nprimary, (long) dbf->nssi->nsecondary);
-  else 
-    printf("Pressed and indexed %d HMMs (%ld names).\n", nmodel, (long) dbf->nssi->nprimary);
+  if (dbf->do_append)
+    printf("Appended %d HMMs to the %d already pressed.\n", nmodel, nold);
+  if (nsecondary > 0)
+    printf("Pressed and indexed %d HMMs (%ld names and %ld accessions).\n", nold+nmodel, (long) nprimary, (long) nsecondary);
+  else
+    printf("Pressed and indexed %d HMMs (%ld names).\n", nold+nmodel, (long) nprimary);
   printf("Models pressed into binary file:   %s\n", dbf->mfile);
   printf("SSI index for binary model file:   %s\n", dbf->ssifile);
   printf("Profiles (MSV part) pressed into:  %s\n", dbf->ffile);
   printf("Profiles (remainder) pressed into: %s\n", dbf->pfile);
 
   close_dbfiles(dbf, eslOK);
-  p7_bg_Destroy(bg);
+#ifdef HMMER_THREADS
+  if (ncpus > 0)
+    {
+      p7_scheduler_Destroy(sched);
+      esl_threads_Destroy(threadObj);
+    }
+#endif
+  for (i = 0; i < infocnt; i++) p7_bg_Destroy(info[i].bg);
+  free(info);
+  free(blk->hmm);
+  free(blk->om);
+  free(blk);
   p7_hmmfile_Close(hfp);
   esl_alphabet_Destroy(abc);
   esl_getopts_Destroy(go);
@@ -137,7 +264,6 @@ main(int argc, char **argv)
  ERROR:
   fprintf(stderr, "%s\n", errbuf);
   close_dbfiles(dbf, status);
-  p7_bg_Destroy(bg);
   p7_hmmfile_Close(hfp);
   esl_alphabet_Destroy(abc);
   esl_getopts_Destroy(go);
@@ -150,37 +276,67 @@ open_dbfiles(ESL_GETOPTS *go, char *basename)
 {
   struct dbfiles *dbf             = NULL;
   int             allow_overwrite = esl_opt_GetBoolean(go, "-f");
+  int             do_append       = esl_opt_GetBoolean(go, "--append");
   char            errbuf[eslERRBUFSIZE];
   int             status;
 
   if ( ( dbf = malloc(sizeof(struct dbfiles))) == NULL)   p7_Die("malloc() failed");
-  dbf->mfile   = NULL;
-  dbf->ffile   = NULL;
-  dbf->pfile   = NULL;
-  dbf->ssifile = NULL;
-  dbf->mfp     = NULL;
-  dbf->ffp     = NULL;
-  dbf->pfp     = NULL;
-  dbf->nssi    = NULL;
+  dbf->mfile     = NULL;
+  dbf->ffile     = NULL;
+  dbf->pfile     = NULL;
+  dbf->ssifile   = NULL;
+  dbf->tmpfile   = NULL;
+  dbf->mfp       = NULL;
+  dbf->ffp       = NULL;
+  dbf->pfp       = NULL;
+  dbf->nssi      = NULL;
+  dbf->do_append = FALSE;
+  dbf->msize     = 0;
+  dbf->fsize     = 0;
+  dbf->psize     = 0;
 
   if ( (status = esl_sprintf(&(dbf->ssifile), "%s.h3i", basename)) != eslOK) ESL_XFAIL(status, errbuf, "esl_sprintf() failed");
   if ( (status = esl_sprintf(&(dbf->mfile),   "%s.h3m", basename)) != eslOK) ESL_XFAIL(status, errbuf, "esl_sprintf() failed");
   if ( (status = esl_sprintf(&(dbf->ffile),   "%s.h3f", basename)) != eslOK) ESL_XFAIL(status, errbuf, "esl_sprintf() failed");
   if ( (status = esl_sprintf(&(dbf->pfile),   "%s.h3p", basename)) != eslOK) ESL_XFAIL(status, errbuf, "esl_sprintf() failed");
 
+  if (do_append)
+    {
+      if (! esl_FileExists(dbf->ssifile)) ESL_XFAIL(eslENOTFOUND, errbuf, "SSI index file %s not found;\nCan't --append to a database that hasn't been pressed",        dbf->ssifile);
+      if (! esl_FileExists(dbf->mfile))   ESL_XFAIL(eslENOTFOUND, errbuf, "Binary HMM file %s not found;\nCan't --append to a database that hasn't been pressed",       dbf->mfile);
+      if (! esl_FileExists(dbf->ffile))   ESL_XFAIL(eslENOTFOUND, errbuf, "Binary MSV filter file %s not found;\nCan't --append to a database that hasn't been pressed", dbf->ffile);
+      if (! esl_FileExists(dbf->pfile))   ESL_XFAIL(eslENOTFOUND, errbuf, "Binary profile file %s not found;\nCan't --append to a database that hasn't been pressed",    dbf->pfile);
+
+      /* The old index stays in place until the new one is complete */
+      if ( (status = esl_sprintf(&(dbf->tmpfile), "%s.h3i.tmp", basename)) != eslOK) ESL_XFAIL(status, errbuf, "esl_sprintf() failed");
+      status = esl_newssi_Open(dbf->tmpfile, TRUE, &(dbf->nssi));
+      if      (status == eslENOTFOUND)   ESL_XFAIL(status, errbuf, "failed to open SSI index %s", dbf->tmpfile);
+      else if (status != eslOK)          ESL_XFAIL(status, errbuf, "failed to create a new SSI index");
+
+      if ((dbf->mfp = fopen(dbf->mfile, "r+b")) == NULL)  ESL_XFAIL(eslEWRITE, errbuf, "Failed to open binary HMM file %s for appending",        dbf->mfile);
+      if ((dbf->ffp = fopen(dbf->ffile, "r+b")) == NULL)  ESL_XFAIL(eslEWRITE, errbuf, "Failed to open binary MSV filter file %s for appending", dbf->ffile);
+      if ((dbf->pfp = fopen(dbf->pfile, "r+b")) == NULL)  ESL_XFAIL(eslEWRITE, errbuf, "Failed to open binary profile file %s for appending",    dbf->pfile);
+      dbf->do_append = TRUE;
+
+      if (fseeko(dbf->mfp, 0, SEEK_END) != 0 || (dbf->msize = ftello(dbf->mfp)) == -1) ESL_XFAIL(eslESYS, errbuf, "Failed to find end of %s", dbf->mfile);
+      if (fseeko(dbf->ffp, 0, SEEK_END) != 0 || (dbf->fsize = ftello(dbf->ffp)) == -1) ESL_XFAIL(eslESYS, errbuf, "Failed to find end of %s", dbf->ffile);
+      if (fseeko(dbf->pfp, 0, SEEK_END) != 0 || (dbf->psize = ftello(dbf->pfp)) == -1) ESL_XFAIL(eslESYS, errbuf, "Failed to find end of %s", dbf->pfile);
+      return dbf;
+    }
+
   if (! allow_overwrite && esl_FileExists(dbf->ssifile)) ESL_XFAIL(eslEOVERWRITE, errbuf, "SSI index file %s already exists;\nDelete old hmmpress indices first",        dbf->ssifile);
-  if (! allow_overwrite && esl_FileExists(dbf->mfile))   ESL_XFAIL(eslEOVERWRITE, errbuf, "Binary HMM file %s already exists;\nDelete old hmmpress indices first",       dbf->mfile);   
-  if (! allow_overwrite && esl_FileExists(dbf->ffile))   ESL_XFAIL(eslEOVERWRITE, errbuf, "Binary MSV filter file %s already exists\nDelete old hmmpress indices first", dbf->ffile);   
-  if (! allow_overwrite && esl_FileExists(dbf->pfile))   ESL_XFAIL(eslEOVERWRITE, errbuf, "Binary profile file %s already exists\nDelete old hmmpress indices first",    dbf->pfile);   
+  if (! allow_overwrite && esl_FileExists(dbf->mfile))   ESL_XFAIL(eslEOVERWRITE, errbuf, "Binary HMM file %s already exists;\nDelete old hmmpress indices first",       dbf->mfile);
+  if (! allow_overwrite && esl_FileExists(dbf->ffile))   ESL_XFAIL(eslEOVERWRITE, errbuf, "Binary MSV filter file %s already exists\nDelete old hmmpress indices first", dbf->ffile);
+  if (! allow_overwrite && esl_FileExists(dbf->pfile))   ESL_XFAIL(eslEOVERWRITE, errbuf, "Binary profile file %s already exists\nDelete old hmmpress indices first",    dbf->pfile);
 
   status = esl_newssi_Open(dbf->ssifile, allow_overwrite, &(dbf->nssi));
-  if      (status == eslENOTFOUND)   ESL_XFAIL(status, errbuf, "failed to open SSI index %s", dbf->ssifile); 
-  else if (status == eslEOVERWRITE)  ESL_XFAIL(status, errbuf, "SSI index file %s already exists;\nDelete old hmmpress indices first", basename);  
+  if      (status == eslENOTFOUND)   ESL_XFAIL(status, errbuf, "failed to open SSI index %s", dbf->ssifile);
+  else if (status == eslEOVERWRITE)  ESL_XFAIL(status, errbuf, "SSI index file %s already exists;\nDelete old hmmpress indices first", basename);
   else if (status != eslOK)          ESL_XFAIL(status, errbuf, "failed to create a new SSI index");
 
   if ((dbf->mfp = fopen(dbf->mfile, "wb")) == NULL)  ESL_XFAIL(eslEWRITE, errbuf, "Failed to open binary HMM file %s for writing",        dbf->mfile);
-  if ((dbf->ffp = fopen(dbf->ffile, "wb")) == NULL)  ESL_XFAIL(eslEWRITE, errbuf, "Failed to open binary MSV filter file %s for writing", dbf->ffile); 
-  if ((dbf->pfp = fopen(dbf->pfile, "wb")) == NULL)  ESL_XFAIL(eslEWRITE, errbuf, "Failed to open binary profile file %s for writing",    dbf->pfile); 
+  if ((dbf->ffp = fopen(dbf->ffile, "wb")) == NULL)  ESL_XFAIL(eslEWRITE, errbuf, "Failed to open binary MSV filter file %s for writing", dbf->ffile);
+  if ((dbf->pfp = fopen(dbf->pfile, "wb")) == NULL)  ESL_XFAIL(eslEWRITE, errbuf, "Failed to open binary profile file %s for writing",    dbf->pfile);
 
   return dbf;
 
@@ -191,21 +347,35 @@ open_dbfiles(ESL_GETOPTS *go, char *basename)
 }
 
 /* If status != eslOK, then in addition to free'ing memory, also
- * remove the four output files.
+ * remove the four output files; or, with --append, cut them back to
+ * what they were, leaving the old index in place.
  */
 static void
 close_dbfiles(struct dbfiles *dbf, int status)
 {
   if (dbf)
     {
+      /* With --append, a failure leaves the files as we found them */
+      if (dbf->do_append && status != eslOK)
+	{
+	  if (dbf->mfp) { fflush(dbf->mfp); if (ftruncate(fileno(dbf->mfp), dbf->msize) != 0) fprintf(stderr, "failed to restore %s; press it again\n", dbf->mfile); }
+	  if (dbf->ffp) { fflush(dbf->ffp); if (ftruncate(fileno(dbf->ffp), dbf->fsize) != 0) fprintf(stderr, "failed to restore %s; press it again\n", dbf->ffile); }
+	  if (dbf->pfp) { fflush(dbf->pfp); if (ftruncate(fileno(dbf->pfp), dbf->psize) != 0) fprintf(stderr, "failed to restore %s; press it again\n", dbf->pfile); }
+	}
+
       /* Close the output files first */
       if (dbf->mfp)     fclose(dbf->mfp);
       if (dbf->ffp)     fclose(dbf->ffp);
       if (dbf->pfp)     fclose(dbf->pfp);
       if (dbf->nssi)    esl_newssi_Close(dbf->nssi);
 
+      /* With --append, the old index stays; drop the new one, unless main() already renamed it. */
+      if (dbf->do_append)
+	{
+	  if (esl_FileExists(dbf->tmpfile)) remove(dbf->tmpfile);
+	}
       /* Then remove them, if status isn't OK. esl_newssi_Write() takes care of the ssifile. */
-      if (status != eslOK) 
+      else if (status != eslOK)
         {
           if (esl_FileExists(dbf->mfile))   remove(dbf->mfile);
           if (esl_FileExists(dbf->ffile))   remove(dbf->ffile);
@@ -216,9 +386,183 @@ close_dbfiles(struct dbfiles *dbf, int status)
       if (dbf->mfile)   free(dbf->mfile);
       if (dbf->ffile)   free(dbf->ffile);
       if (dbf->pfile)   free(dbf->pfile);
-      if (dbf->ssifile) free(dbf->ssifile);  
+      if (dbf->ssifile) free(dbf->ssifile);
+      if (dbf->tmpfile) free(dbf->tmpfile);
       free(dbf);
     }
 
 }
 
+
+/* pressed_keys()
+ *
+ * For --append: add the keys of the models already pressed from
+ * <hmmfile> to the new SSI index <nssi>, with the offsets they had,
+ * and return how many there are in <*ret_nold>. Then check that the
+ * last of them is where the old index says it is in <hmmfile>, and
+ * leave <hfp> positioned just after it, on the first new model.
+ *
+ * The pressed profiles are mapped, where we can, so this reads
+ * little more than the names and accessions.
+ *
+ * Returns <eslOK> on success. On any failure, <errbuf> says why.
+ */
+static int
+pressed_keys(char *hmmfile, P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, ESL_NEWSSI *nssi, uint16_t fh, int *ret_nold, char *errbuf)
+{
+  P7_HMMFILE  *dbfp     = NULL;
+  P7_OPROFILE *om       = NULL;
+  P7_HMM      *hmm      = NULL;
+  char        *lastname = NULL;
+  int          lastM    = 0;
+  off_t        lastoff  = 0;
+  off_t        roff, doff;
+  int64_t      L;
+  uint16_t     ofh;
+  int          nold     = 0;
+  int          aligned  = TRUE;
+  int          status;
+
+  status = p7_hmmfile_OpenE(hmmfile, NULL, &dbfp, errbuf);
+  if (status != eslOK)    goto ERROR;
+  if (! dbfp->is_pressed) ESL_XFAIL(eslENOTFOUND, errbuf, "Failed to open the pressed files of %s", hmmfile);
+  if ((status = p7_hmmfile_MapPressed(dbfp)) != eslOK) ESL_XFAIL(status, errbuf, "Failed to map the pressed files of %s:\n%s", hmmfile, dbfp->errbuf);
+#if defined (eslENABLE_SSE)
+  aligned = p7_oprofile_IsAligned(dbfp);
+#endif
+
+  while ((status = p7_oprofile_ReadMSV(dbfp, byp_abc, &om)) == eslOK)
+    {
+      if ((status = p7_oprofile_ReadRest(dbfp, om)) != eslOK)                         ESL_XFAIL(eslEFORMAT, errbuf, "bad format, pressed files of %s:\n%s", hmmfile, dbfp->errbuf);
+      if (esl_ssi_FindName(dbfp->ssi, om->name, &ofh, &roff, &doff, &L) != eslOK)      ESL_XFAIL(eslEFORMAT, errbuf, "Pressed model %s isn't in the SSI index of %s", om->name, hmmfile);
+      if ((status = esl_newssi_AddKey(nssi, om->name, fh, om->offs[p7_MOFFSET], doff, 0)) != eslOK) ESL_XFAIL(status, errbuf, "Failed to add key %s to SSI index", om->name);
+      if (om->acc) {
+	if ((status = esl_newssi_AddAlias(nssi, om->acc, om->name))                      != eslOK) ESL_XFAIL(status, errbuf, "Failed to add secondary key %s to SSI index", om->acc);
+      }
+
+      if (lastname) free(lastname);
+      if ((status = esl_strdup(om->name, -1, &lastname)) != eslOK) goto ERROR;
+      lastM   = om->M;
+      lastoff = doff;
+      nold++;
+
+      p7_oprofile_Destroy(om);
+      om = NULL;
+    }
+  if      (status == eslEFORMAT)   ESL_XFAIL(status, errbuf, "bad format, pressed files of %s:\n%s",           hmmfile, dbfp->errbuf);
+  else if (status == eslEINCOMPAT) ESL_XFAIL(status, errbuf, "pressed files of %s contain different alphabets", hmmfile);
+  else if (status != eslEOF)       ESL_XFAIL(status, errbuf, "Unexpected error in reading pressed files of %s", hmmfile);
+  /* New models are pressed in the current format, which can't follow an older one in the same files */
+  if (nold > 0 && ! aligned)       ESL_XFAIL(eslEINCOMPAT, errbuf, "Pressed files of %s are in an older format;\nPress it again without --append", hmmfile);
+  p7_hmmfile_Close(dbfp);
+  dbfp = NULL;
+
+  /* Models are appended to <hmmfile>, so the last model pressed has
+   * to be where it was. Indices from an older hmmpress didn't save
+   * where it was, and fail this check.
+   */
+  if (nold > 0)
+    {
+      if ((status = p7_hmmfile_Position(hfp, lastoff)) != eslOK) ESL_XFAIL(status, errbuf, "Failed to position HMM file %s", hmmfile);
+      status = p7_hmmfile_Read(hfp, byp_abc, &hmm);
+      if (status != eslOK || hmm->name == NULL || strcmp(hmm->name, lastname) != 0 || hmm->M != lastM)
+	ESL_XFAIL(eslEINCOMPAT, errbuf, "Pressed files don't match the first %d models of %s;\nPress it again without --append", nold, hmmfile);
+      p7_hmm_Destroy(hmm);
+    }
+
+  free(lastname);
+  *ret_nold = nold;
+  return eslOK;
+
+ ERROR:
+  if (hmm)      p7_hmm_Destroy(hmm);
+  if (om)       p7_oprofile_Destroy(om);
+  if (dbfp)     p7_hmmfile_Close(dbfp);
+  if (lastname) free(lastname);
+  *ret_nold = 0;
+  return status;
+}
+
+
+/* convert_model()
+ * Configure <hmm> as a local profile, using null model <bg>, and
+ * convert it to the optimized profile returned in <*ret_om>.
+ */
+static int
+convert_model(P7_HMM *hmm, P7_BG *bg, P7_OPROFILE **ret_om)
+{
+  P7_PROFILE  *gm = NULL;
+  P7_OPROFILE *om = NULL;
+  int          status;
+
+  if ((gm = p7_profile_Create(hmm->M, hmm->abc)) == NULL) { status = eslEMEM; goto ERROR; }
+  if ((om = p7_oprofile_Create(hmm->M, hmm->abc)) == NULL) { status = eslEMEM; goto ERROR; }
+  if ((status = p7_ProfileConfig(hmm, bg, gm, 400, p7_LOCAL)) != eslOK) goto ERROR;
+  if ((status = p7_oprofile_Convert(gm, om))                   != eslOK) goto ERROR;
+
+  p7_profile_Destroy(gm);
+  *ret_om = om;
+  return eslOK;
+
+ ERROR:
+  if (gm) p7_profile_Destroy(gm);
+  if (om) p7_oprofile_Destroy(om);
+  *ret_om = NULL;
+  return status;
+}
+
+
+#ifdef HMMER_THREADS
+/* thread_loop()
+ * Have the <ncpus> workers convert the profiles of block <blk>, and
+ * wait until they're done.
+ */
+static int
+thread_loop(ESL_THREADS *obj, P7_SCHEDULER *sched, WORKER_INFO *info, int ncpus, PRESS_BLOCK *blk)
+{
+  void *empty;
+  int   i;
+  int   status;
+
+  for (i = 0; i < ncpus; i++) esl_threads_AddThread(obj, &info[i]);
+  esl_threads_WaitForStart(obj);
+
+  if ((status = p7_scheduler_ReaderUpdate(sched, NULL, 0, &empty))         != eslOK) return status;
+  if ((status = p7_scheduler_ReaderUpdate(sched, blk, blk->count, NULL))  != eslOK) return status;
+  if ((status = p7_scheduler_ReaderFinish(sched))                          != eslOK) return status;
+
+  esl_threads_WaitForFinish(obj);
+  return p7_scheduler_Reset(sched);
+}
+
+static void
+convert_thread(void *arg)
+{
+  int             i;
+  int             status;
+  int             workeridx;
+  WORKER_INFO    *info;
+  ESL_THREADS    *obj;
+  PRESS_BLOCK    *blk;
+  P7_SCHED_RANGE  r;
+
+  impl_Init();
+
+  obj = (ESL_THREADS *) arg;
+  esl_threads_Started(obj, &workeridx);
+
+  info = (WORKER_INFO *) esl_threads_GetData(obj, workeridx);
+
+  r.blk = NULL;
+  while ((status = p7_scheduler_WorkerUpdate(info->sched, workeridx, &r)) == eslOK)
+    {
+      blk = (PRESS_BLOCK *) r.blk;
+      for (i = r.lo; i < r.hi; i++)
+	if (convert_model(blk->hmm[i], info->bg, &(blk->om[i])) != eslOK) esl_fatal("Failed to convert HMM %s to a profile", blk->hmm[i]->name);
+    }
+  if (status != eslEOD) esl_fatal("Scheduler worker failed");
+
+  esl_threads_Finished(obj, workeridx);
+  return;
+}
+#endif /*HMMER_THREADS*/
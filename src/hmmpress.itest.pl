@@ -51,8 +51,66 @@ if ($? != 0)                                     { die "hmmpress -f failed to pr
 if ($output !~ /Pressed and indexed (\d+) HMMs/) { die "unexpected hmmpress -f output"; }
 if ($1 != $nmodels)                              { die "unexpected number of models after hmmpress -f"; }
 
+# Press the first half of the models, then --append the rest.
+# The pressed files must be the same as pressing them all at once.
+#
+foreach $sfx ("h3m", "h3i", "h3f", "h3p") { rename("$tmppfx.hmm.$sfx", "$tmppfx.save.$sfx") || die "failed to save .$sfx file"; }
+
+open(HMMFILE, "$tmppfx.hmm") || die "failed to open $tmppfx.hmm";
+@lines = <HMMFILE>;
+close HMMFILE;
+open(HALF, ">$tmppfx.hmm") || die "failed to write first half of $tmppfx.hmm";
+$n = 0;
+foreach $line (@lines) {
+    last if $n >= int($nmodels / 2);
+    print HALF $line;
+    if ($line =~ /^\/\//) { $n++; }
+}
+close HALF;
+
+$output = `$hmmpress $tmppfx.hmm 2>&1`;
+if ($? != 0)                                     { die "failed to press first half of $minifam"; }
+
+open(FULL, ">$tmppfx.hmm") || die "failed to rewrite $tmppfx.hmm";
+print FULL @lines;
+close FULL;
+
+$output = `$hmmpress --append $tmppfx.hmm 2>&1`;
+if ($? != 0)                                     { die "hmmpress --append failed"; }
+if ($output !~ /Appended (\d+) HMMs to the (\d+) already pressed/) { die "unexpected hmmpress --append output"; }
+if ($1 + $2 != $nmodels || $2 != int($nmodels/2)) { die "unexpected number of models after hmmpress --append"; }
+foreach $sfx ("h3m", "h3i", "h3f", "h3p") {
+    system("cmp -s $tmppfx.hmm.$sfx $tmppfx.save.$sfx");
+    if ($? != 0) { die "appended .$sfx file differs from pressing all at once"; }
+}
+
+# Appending again, with nothing new, is a no-op.
+$output = `$hmmpress --append $tmppfx.hmm 2>&1`;
+if ($? != 0)                                     { die "second hmmpress --append failed"; }
+if ($output !~ /Appended 0 HMMs/)                { die "second hmmpress --append should have appended nothing"; }
+
+# --append and -f don't go together.
+$output = `$hmmpress -f --append $tmppfx.hmm 2>&1`;
+if ( ($? >> 8) != 1)                             { die "expected exit code 1 from hmmpress -f --append"; }
+
+# The number of worker threads doesn't change the pressed files.
+# (--cpu only exists in a threaded build.)
+$output = `$hmmpress -h 2>&1`;
+if ($output =~ /--cpu/) 
+{
+    foreach $ncpu (0, 3) {
+	$output = `$hmmpress -f --cpu $ncpu $tmppfx.hmm 2>&1`;
+	if ($? != 0) { die "hmmpress --cpu $ncpu failed"; }
+	foreach $sfx ("h3m", "h3i", "h3f", "h3p") {
+	    system("cmp -s $tmppfx.hmm.$sfx $tmppfx.save.$sfx");
+	    if ($? != 0) { die ".$sfx file pressed with --cpu $ncpu differs"; }
+	}
+    }
+}
+
 print "ok\n";
 unlink <$tmppfx.hmm*>;
+unlink <$tmppfx.save.*>;
 exit 0;
 
 
@@ -26,19 +26,22 @@
 #ifdef HMMER_THREADS
 #include <unistd.h>
 #include "esl_threads.h"
-#include "esl_workqueue.h"
 #endif
 
 #include "hmmer.h"
+#include "p7_hmmcache.h"
+#include "p7_scheduler.h"
 
 typedef struct {
 #ifdef HMMER_THREADS
-  ESL_WORK_QUEUE   *queue;
+  P7_SCHEDULER     *sched;
 #endif
-  ESL_SQ           *qsq;
+  int               nq;          /* number of queries in this pass          */
+  ESL_SQ          **qsq;         /* queries [0..nq-1]                       */
   P7_BG            *bg;	         /* null model                              */
-  P7_PIPELINE      *pli;         /* work pipeline                           */
-  P7_TOPHITS       *th;          /* top hit results                         */
+  P7_PIPELINE     **pli;         /* work pipelines, one per query           */
+  P7_TOPHITS      **th;          /* top hit results, one per query          */
+  int               cached;      /* TRUE if the profiles belong to a P7_HMMCACHE */
 } WORKER_INFO;
 
 #define REPOPTS     "-E,-T,--cut_ga,--cut_nc,--cut_tc"
@@ -49,7 +52,7 @@ typedef struct {
 
 #if defined (HMMER_THREADS) && defined (HMMER_MPI)
 #define CPUOPTS     "--mpi"
-#define MPIOPTS     "--cpu"
+#define MPIOPTS     "--cpu,--cache,--qblock"
 #else
 #define CPUOPTS     NULL
 #define MPIOPTS     NULL
@@ -63,6 +66,7 @@ static ESL_OPTIONS options[] = {
   { "--tblout",     eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save parseable table of per-sequence hits to file <f>",         2 },
   { "--domtblout",  eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save parseable table of per-domain hits to file <f>",           2 },
   { "--pfamtblout", eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save table of hits and domains to file, in Pfam format <f>",    2 },
+  { "--stagetblout",eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save table of time and work in each pipeline stage to file <f>", 2 },
   { "--acc",        eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "prefer accessions over names in output",                        2 },
   { "--noali",      eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "don't output alignments, so output is smaller",                 2 },
   { "--notextw",    eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL, "--textw",        "unlimit ASCII text output line width",                          2 },
@@ -93,6 +97,8 @@ static ESL_OPTIONS options[] = {
   { "--domZ",       eslARG_REAL,   FALSE, NULL, "x>0",   NULL,  NULL,  NULL,            "set # of significant seqs, for domain E-value calculation",    12 },
   { "--seed",       eslARG_INT,    "42",  NULL, "n>=0",  NULL,  NULL,  NULL,            "set RNG seed to <n> (if 0: one-time arbitrary seed)",          12 },
   { "--qformat",    eslARG_STRING,  NULL, NULL, NULL,    NULL,  NULL,  NULL,            "assert input <seqfile> is in format <s>: no autodetection",    12 },
+  { "--cache",      eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "load <hmmdb> into memory once, for all queries",               12 },
+  { "--qblock",     eslARG_INT,    "16",  NULL, "n>0",   NULL,  NULL,  NULL,            "compare <n> queries at a time to each block of profiles",      12 },
 #ifdef HMMER_THREADS
   { "--cpu",        eslARG_INT, p7_NCPU,"HMMER_NCPU","n>=0",NULL,  NULL,  CPUOPTS,      "number of parallel CPU workers to use for multithreads",       12 },
 #endif
@@ -122,12 +128,12 @@ static char usage[]  = "[-options] <hmmdb> <seqfile>";
 static char banner[] = "search sequence(s) against a profile database";
 
 static int  serial_master(ESL_GETOPTS *go, struct cfg_s *cfg);
-static int  serial_loop  (WORKER_INFO *info, P7_HMMFILE *hfp);
+static int  serial_loop  (WORKER_INFO *info, P7_HMMFILE *hfp, P7_HMMCACHE *hcache);
 
 #ifdef HMMER_THREADS
 #define BLOCK_SIZE 1000
 
-static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, P7_HMMFILE *hfp);
+static int  thread_loop(ESL_THREADS *obj, P7_SCHEDULER *sched, P7_HMMFILE *hfp, P7_HMMCACHE *hcache);
 static void pipeline_thread(void *arg);
 #endif
 
@@ -216,6 +222,7 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *hmmfile, char *seqfile)
   if (esl_opt_IsUsed(go, "--tblout")    && fprintf(ofp, "# per-seq hits tabular output:     %s\n",            esl_opt_GetString(go, "--tblout"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domtblout") && fprintf(ofp, "# per-dom hits tabular output:     %s\n",            esl_opt_GetString(go, "--domtblout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--pfamtblout")&& fprintf(ofp, "# pfam-style tabular hit output:   %s\n",            esl_opt_GetString(go, "--pfamtblout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--stagetblout")&& fprintf(ofp, "# pipeline stage table output:    %s\n",            esl_opt_GetString(go, "--stagetblout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--acc")       && fprintf(ofp, "# prefer accessions over names:    yes\n")                                                 < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--noali")     && fprintf(ofp, "# show alignments in output:       no\n")                                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--notextw")   && fprintf(ofp, "# max ASCII text line length:      unlimited\n")                                           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -244,6 +251,8 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *hmmfile, char *seqfile)
     else if (                                  fprintf(ofp, "# random number seed set to:       %d\n",        esl_opt_GetInteger(go, "--seed"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   }
   if (esl_opt_IsUsed(go, "--qformat")   && fprintf(ofp, "# input seqfile format asserted:   %s\n",            esl_opt_GetString(go, "--qformat"))   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--cache")     && fprintf(ofp, "# profiles held in memory:         yes\n")                                                 < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--qblock")    && fprintf(ofp, "# queries per pass over profiles:  %d\n",            esl_opt_GetInteger(go, "--qblock"))   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #ifdef HMMER_THREADS
   if (esl_opt_IsUsed(go, "--cpu")       && fprintf(ofp, "# number of worker threads:        %d\n",            esl_opt_GetInteger(go, "--cpu"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");  
 #endif
@@ -321,19 +330,23 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   FILE            *tblfp    = NULL;		 /* output stream for tabular per-seq (--tblout)    */
   FILE            *domtblfp = NULL;	  	 /* output stream for tabular per-seq (--domtblout) */
   FILE            *pfamtblfp= NULL;              /* output stream for pfam tabular output (--pfamtblout)    */
+  FILE            *stagetblfp= NULL;             /* output stream for per-stage timing table (--stagetblout) */
   int              seqfmt   = eslSQFILE_UNKNOWN; /* format of seqfile                               */
   ESL_SQFILE      *sqfp     = NULL;              /* open seqfile                                    */
   P7_HMMFILE      *hfp      = NULL;		 /* open HMM database file                          */
+  P7_HMMCACHE     *hcache   = NULL;              /* ... or HMM database held in memory (--cache)    */
   ESL_ALPHABET    *abc      = NULL;              /* sequence alphabet                               */
   P7_OPROFILE     *om       = NULL;		 /* target profile                                  */
   ESL_STOPWATCH   *w        = NULL;              /* timing                                          */
-  ESL_SQ          *qsq      = NULL;		 /* query sequence                                  */
+  ESL_SQ         **qsq      = NULL;		 /* query sequences of one pass [0..qblock-1]       */
+  int              qblock   = esl_opt_GetInteger(go, "--qblock"); /* queries per pass over the models */
+  int              nq;
   int              nquery   = 0;
   int              textw;
   int              status   = eslOK;
   int              hstatus  = eslOK;
   int              sstatus  = eslOK;
-  int              i;
+  int              i, q;
 
   int              ncpus    = 0;
 
@@ -342,7 +355,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #ifdef HMMER_THREADS
   P7_OM_BLOCK     *block    = NULL;
   ESL_THREADS     *threadObj= NULL;
-  ESL_WORK_QUEUE  *queue    = NULL;
+  P7_SCHEDULER    *sched    = NULL;
 #endif
   char             errbuf[eslERRBUFSIZE];
 
@@ -371,6 +384,20 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   p7_oprofile_Destroy(om);
   p7_hmmfile_Close(hfp);
+  hfp = NULL;
+
+  /* With --cache, read all the profiles once, here. Each pass then
+   * compares a block of queries to every profile in memory. Without
+   * it, each pass streams <hmmdb> once for its block of queries.
+   */
+  if (esl_opt_GetBoolean(go, "--cache"))
+    {
+      status = p7_hmmcache_Open(cfg->hmmfile, &hcache, errbuf);
+      if      (status == eslENOTFOUND) p7_Fail("Failed to read %s\n  %s\n",                  cfg->hmmfile, errbuf);
+      else if (status == eslEFORMAT)   p7_Fail("bad format, binary auxfiles, %s:\n%s",       cfg->hmmfile, errbuf);
+      else if (status == eslEINCOMPAT) p7_Fail("HMM file %s contains different alphabets",   cfg->hmmfile);
+      else if (status != eslOK)        p7_Fail("Failed to cache %s: error code %d\n",        cfg->hmmfile, status);
+    }
 
   /* Open the query sequence database */
   status = esl_sqfile_OpenDigital(abc, cfg->seqfile, seqfmt, NULL, &sqfp);
@@ -378,13 +405,15 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   else if (status == eslEFORMAT)   p7_Fail("Sequence file %s is empty or misformatted\n",        cfg->seqfile);
   else if (status == eslEINVAL)    p7_Fail("Can't autodetect format of a stdin or .gz seqfile");
   else if (status != eslOK)        p7_Fail("Unexpected error %d opening sequence file %s\n", status, cfg->seqfile);
-  qsq = esl_sq_CreateDigital(abc);
+  ESL_ALLOC(qsq, sizeof(ESL_SQ *) * qblock);
+  for (q = 0; q < qblock; q++) qsq[q] = esl_sq_CreateDigital(abc);
 
   /* Open the results output files */
   if (esl_opt_IsOn(go, "-o"))          { if ((ofp      = fopen(esl_opt_GetString(go, "-o"),          "w")) == NULL)  esl_fatal("Failed to open output file %s for writing\n",                 esl_opt_GetString(go, "-o")); }
   if (esl_opt_IsOn(go, "--tblout"))    { if ((tblfp    = fopen(esl_opt_GetString(go, "--tblout"),    "w")) == NULL)  esl_fatal("Failed to open tabular per-seq output file %s for writing\n", esl_opt_GetString(go, "--tblout")); }
   if (esl_opt_IsOn(go, "--domtblout")) { if ((domtblfp = fopen(esl_opt_GetString(go, "--domtblout"), "w")) == NULL)  esl_fatal("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblout")); }
   if (esl_opt_IsOn(go, "--pfamtblout")){ if ((pfamtblfp = fopen(esl_opt_GetString(go, "--pfamtblout"), "w")) == NULL)  esl_fatal("Failed to open pfam-style tabular output file %s for writing\n", esl_opt_GetString(go, "--pfamtblout")); }
+  if (esl_opt_IsOn(go, "--stagetblout")){ if ((stagetblfp = fopen(esl_opt_GetString(go, "--stagetblout"), "w")) == NULL)  esl_fatal("Failed to open pipeline stage table output file %s for writing\n", esl_opt_GetString(go, "--stagetblout")); }
 
   output_header(ofp, go, cfg->hmmfile, cfg->seqfile);
 
@@ -394,7 +423,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (ncpus > 0)
     {
       threadObj = esl_threads_Create(&pipeline_thread);
-      queue = esl_workqueue_Create(ncpus * 2);
+      sched     = p7_scheduler_Create(ncpus);
     }
 #endif
 
@@ -403,9 +432,14 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   for (i = 0; i < infocnt; ++i)
     {
-      info[i].bg    = p7_bg_Create(abc);
+      info[i].nq     = 0;
+      info[i].bg     = p7_bg_Create(abc);
+      info[i].cached = (hcache != NULL);
+      ESL_ALLOC(info[i].qsq, sizeof(ESL_SQ *)      * qblock);
+      ESL_ALLOC(info[i].pli, sizeof(P7_PIPELINE *) * qblock);
+      ESL_ALLOC(info[i].th,  sizeof(P7_TOPHITS *)  * qblock);
 #ifdef HMMER_THREADS
-      info[i].queue = queue;
+      info[i].sched = sched;
 #endif
     }
 
@@ -415,43 +449,58 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       block = p7_oprofile_CreateBlock(BLOCK_SIZE);
       if (block == NULL)    esl_fatal("Failed to allocate sequence block");
 
-      status = esl_workqueue_Init(queue, block);
-      if (status != eslOK)  esl_fatal("Failed to add block to work queue");
+      status = p7_scheduler_Add(sched, block);
+      if (status != eslOK)  esl_fatal("Failed to add block to scheduler");
     }
 #endif
 
-  /* Outside loop: over each query sequence in <seqfile>. */
-  while ((sstatus = esl_sqio_Read(sqfp, qsq)) == eslOK)
+  /* Outside loop: over blocks of <qblock> query sequences in <seqfile>,
+   * searched together. Each block of profiles read from <hmmdb> (or
+   * <hcache>) is compared to every query in the block in turn, so
+   * <hmmdb> is read once per <qblock> queries, not once per query.
+   * Each query keeps its own pipeline and hit list.
+   */
+  while (1)
     {
-      nquery++;
+      for (nq = 0; nq < qblock; nq++)
+	if ((sstatus = esl_sqio_Read(sqfp, qsq[nq])) != eslOK) break;
+      if (nq == 0) break;
+
       esl_stopwatch_Start(w);	                          
 
-      /* Open the target profile database */
-      status = p7_hmmfile_OpenE(cfg->hmmfile, p7_HMMDBENV, &hfp, NULL);
-      if (status != eslOK)        p7_Fail("Unexpected error %d in opening hmm file %s.\n",           status, cfg->hmmfile);  
+      if (hcache == NULL)
+	{
+	  /* Open the target profile database */
+	  status = p7_hmmfile_OpenE(cfg->hmmfile, p7_HMMDBENV, &hfp, NULL);
+	  if (status != eslOK)        p7_Fail("Unexpected error %d in opening hmm file %s.\n",           status, cfg->hmmfile);  
+
+	  /* Profiles point into the mapped .h3f/.h3p, instead of each being read and copied */
+	  status = p7_hmmfile_MapPressed(hfp);
+	  if (status != eslOK)        p7_Fail("Failed to map pressed hmm file %s:\n%s\n",                cfg->hmmfile, hfp->errbuf);
   
 #ifdef HMMER_THREADS
-      /* if we are threaded, create a lock to prevent multiple readers */
-      if (ncpus > 0)
-	{
-	  status = p7_hmmfile_CreateLock(hfp);
-	  if (status != eslOK) p7_Fail("Unexpected error %d creating lock\n", status);
-	}
+	  /* if we are threaded, create a lock to prevent multiple readers */
+	  if (ncpus > 0)
+	    {
+	      status = p7_hmmfile_CreateLock(hfp);
+	      if (status != eslOK) p7_Fail("Unexpected error %d creating lock\n", status);
+	    }
 #endif
-
-      if (fprintf(ofp, "Query:       %s  [L=%ld]\n", qsq->name, (long) qsq->n) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      if (qsq->acc[0]  != 0 && fprintf(ofp, "Accession:   %s\n", qsq->acc)     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      if (qsq->desc[0] != 0 && fprintf(ofp, "Description: %s\n", qsq->desc)    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	}
 
       for (i = 0; i < infocnt; ++i)
 	{
-	  /* Create processing pipeline and hit list */
-	  info[i].th  = p7_tophits_Create(); 
-	  info[i].pli = p7_pipeline_Create(go, 100, 100, FALSE, p7_SCAN_MODELS); /* M_hint = 100, L_hint = 100 are just dummies for now */
-	  info[i].pli->hfp = hfp;  /* for two-stage input, pipeline needs <hfp> */
+	  info[i].nq = nq;
+	  for (q = 0; q < nq; q++)
+	    {
+	      /* Create processing pipeline and hit list */
+	      info[i].th[q]  = p7_tophits_Create(); 
+	      info[i].pli[q] = p7_pipeline_Create(go, 100, 100, FALSE, p7_SCAN_MODELS); /* M_hint = 100, L_hint = 100 are just dummies for now */
+	      info[i].pli[q]->hfp = hfp;  /* for two-stage input, pipeline needs <hfp>; cached profiles are complete */
 
-	  p7_pli_NewSeq(info[i].pli, qsq);
-	  info[i].qsq = qsq;
+	      p7_pli_NewSeq(info[i].pli[q], qsq[q]);
+	      info[i].qsq[q] = qsq[q];
+	    }
 
 #ifdef HMMER_THREADS
 	  if (ncpus > 0) esl_threads_AddThread(threadObj, &info[i]);
@@ -459,10 +508,10 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 	}
 
 #ifdef HMMER_THREADS
-      if (ncpus > 0)  hstatus = thread_loop(threadObj, queue, hfp);
-      else	      hstatus = serial_loop(info, hfp);
+      if (ncpus > 0)  hstatus = thread_loop(threadObj, sched, hfp, hcache);
+      else	      hstatus = serial_loop(info, hfp, hcache);
 #else
-      hstatus = serial_loop(info, hfp);
+      hstatus = serial_loop(info, hfp, hcache);
 #endif
       switch(hstatus)
 	{
@@ -472,36 +521,50 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 	default: 	   p7_Fail("Unexpected error in reading HMMs from %s",   cfg->hmmfile); 
 	}
 
-      /* merge the results of the search results */
-      for (i = 1; i < infocnt; ++i)
+      /* Output, one query at a time, in order */
+      for (q = 0; q < nq; q++)
 	{
-	  p7_tophits_Merge(info[0].th, info[i].th);
-	  p7_pipeline_Merge(info[0].pli, info[i].pli);
+	  nquery++;
 
-	  p7_pipeline_Destroy(info[i].pli);
-	  p7_tophits_Destroy(info[i].th);
-	}
+	  if (fprintf(ofp, "Query:       %s  [L=%ld]\n", qsq[q]->name, (long) qsq[q]->n) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  if (qsq[q]->acc[0]  != 0 && fprintf(ofp, "Accession:   %s\n", qsq[q]->acc)     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  if (qsq[q]->desc[0] != 0 && fprintf(ofp, "Description: %s\n", qsq[q]->desc)    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
-      /* Print results */
-      p7_tophits_SortBySortkey(info->th);
-      p7_tophits_Threshold(info->th, info->pli);
+	  /* merge the results of the search results */
+	  for (i = 1; i < infocnt; ++i)
+	    {
+	      p7_tophits_Merge(info[0].th[q], info[i].th[q]);
+	      p7_pipeline_Merge(info[0].pli[q], info[i].pli[q]);
 
-      p7_tophits_Targets(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      p7_tophits_Domains(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	      p7_pipeline_Destroy(info[i].pli[q]);
+	      p7_tophits_Destroy(info[i].th[q]);
+	    }
 
-      if (tblfp)     p7_tophits_TabularTargets(tblfp,    qsq->name, qsq->acc, info->th, info->pli, (nquery == 1));
-      if (domtblfp)  p7_tophits_TabularDomains(domtblfp, qsq->name, qsq->acc, info->th, info->pli, (nquery == 1));
-      if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, qsq->name, qsq->acc, info->th, info->pli);
+	  /* Print results */
+	  p7_tophits_SortBySortkey(info->th[q]);
+	  p7_tophits_Threshold(info->th[q], info->pli[q]);
 
-      esl_stopwatch_Stop(w);
-      p7_pli_Statistics(ofp, info->pli, w);
-      if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      fflush(ofp);
+	  p7_tophits_Targets(ofp, info->th[q], info->pli[q], textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  p7_tophits_Domains(ofp, info->th[q], info->pli[q], textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
-      p7_hmmfile_Close(hfp);
-      p7_pipeline_Destroy(info->pli);
-      p7_tophits_Destroy(info->th);
-      esl_sq_Reuse(qsq);
+	  if (tblfp)     p7_tophits_TabularTargets(tblfp,    qsq[q]->name, qsq[q]->acc, info->th[q], info->pli[q], (nquery == 1));
+	  if (domtblfp)  p7_tophits_TabularDomains(domtblfp, qsq[q]->name, qsq[q]->acc, info->th[q], info->pli[q], (nquery == 1));
+	  if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, qsq[q]->name, qsq[q]->acc, info->th[q], info->pli[q]);
+	  if (stagetblfp) p7_pli_WriteStageTable(stagetblfp, qsq[q]->name, info->pli[q], (nquery == 1));
+
+	  esl_stopwatch_Stop(w);
+	  p7_pli_Statistics(ofp, info->pli[q], w);
+	  if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  fflush(ofp);
+
+	  p7_pipeline_Destroy(info->pli[q]);
+	  p7_tophits_Destroy(info->th[q]);
+	  esl_sq_Reuse(qsq[q]);
+	}
+
+      if (hfp) p7_hmmfile_Close(hfp);
+      hfp = NULL;
+      if (sstatus != eslOK) break;
     }
   if      (sstatus == eslEFORMAT) esl_fatal("Parse failed (sequence file %s):\n%s\n",
 					    sqfp->filename, esl_sqfile_GetErrorBuf(sqfp));
@@ -513,27 +576,35 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (tblfp)    p7_tophits_TabularTail(tblfp,    "hmmscan", p7_SCAN_MODELS, cfg->seqfile, cfg->hmmfile, go);
   if (domtblfp) p7_tophits_TabularTail(domtblfp, "hmmscan", p7_SCAN_MODELS, cfg->seqfile, cfg->hmmfile, go);
   if (pfamtblfp)p7_tophits_TabularTail(pfamtblfp,"hmmscan", p7_SEARCH_SEQS, cfg->seqfile, cfg->hmmfile, go);
+  if (stagetblfp)p7_tophits_TabularTail(stagetblfp,"hmmscan", p7_SCAN_MODELS, cfg->seqfile, cfg->hmmfile, go);
   if (ofp)      { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
   /* Cleanup - prepare for successful exit
    */
   for (i = 0; i < infocnt; ++i)
-    p7_bg_Destroy(info[i].bg);
+    {
+      p7_bg_Destroy(info[i].bg);
+      free(info[i].qsq);
+      free(info[i].pli);
+      free(info[i].th);
+    }
 
 #ifdef HMMER_THREADS
   if (ncpus > 0)
     {
-      esl_workqueue_Reset(queue);
-      while (esl_workqueue_Remove(queue, (void **) &block) == eslOK)
+      p7_scheduler_Reset(sched);
+      while (p7_scheduler_Remove(sched, (void **) &block) == eslOK)
 	p7_oprofile_DestroyBlock(block);
-      esl_workqueue_Destroy(queue);
+      p7_scheduler_Destroy(sched);
       esl_threads_Destroy(threadObj);
     }
 #endif
 
   free(info);
 
-  esl_sq_Destroy(qsq);
+  for (q = 0; q < qblock; q++) esl_sq_Destroy(qsq[q]);
+  free(qsq);
+  p7_hmmcache_Close(hcache);
   esl_stopwatch_Destroy(w);
   esl_alphabet_Destroy(abc);
   esl_sqfile_Close(sqfp);
@@ -542,6 +613,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (tblfp)         fclose(tblfp);
   if (domtblfp)      fclose(domtblfp);
   if (pfamtblfp)     fclose(pfamtblfp);
+  if (stagetblfp)    fclose(stagetblfp);
   return eslOK;
 
  ERROR:
@@ -720,6 +792,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   FILE            *tblfp    = NULL;		 /* output stream for tabular per-seq (--tblout)    */
   FILE            *domtblfp = NULL;	  	 /* output stream for tabular per-seq (--domtblout) */
   FILE            *pfamtblfp= NULL;              /* output stream for pfam-style tabular output  (--pfamtblout) */
+  FILE            *stagetblfp= NULL;             /* output stream for per-stage timing table (--stagetblout) */
   int              seqfmt   = eslSQFILE_UNKNOWN; /* format of seqfile                               */
   P7_BG           *bg       = NULL;	         /* null model                                      */
   ESL_SQFILE      *sqfp     = NULL;              /* open seqfile                                    */
@@ -787,6 +860,9 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     mpi_failure("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblfp"));
   if (esl_opt_IsOn(go, "--pfamtblout") && (pfamtblfp = fopen(esl_opt_GetString(go, "--pfamtblout"), "w")) == NULL)
     mpi_failure("Failed to open pfam-style tabular output file %s for writing\n", esl_opt_GetString(go, "--pfamtblout"));
+
+  if (esl_opt_IsOn(go, "--stagetblout") && (stagetblfp = fopen(esl_opt_GetString(go, "--stagetblout"), "w")) == NULL)
+    mpi_failure("Failed to open pipeline stage table output file %s for writing\n", esl_opt_GetString(go, "--stagetblout"));
  
   ESL_ALLOC(list, sizeof(MSV_BLOCK));
   list->complete = 0;
@@ -923,6 +999,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       if (tblfp)     p7_tophits_TabularTargets(tblfp,    qsq->name, qsq->acc, th, pli, (nquery == 1));
       if (domtblfp)  p7_tophits_TabularDomains(domtblfp, qsq->name, qsq->acc, th, pli, (nquery == 1));
       if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp,   qsq->name, qsq->acc, th, pli);
+      if (stagetblfp) p7_pli_WriteStageTable(stagetblfp, qsq->name, pli, (nquery == 1));
 
       esl_stopwatch_Stop(w);
       p7_pli_Statistics(ofp, pli, w);
@@ -965,6 +1042,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (tblfp)    p7_tophits_TabularTail(tblfp,    "hmmscan", p7_SCAN_MODELS, cfg->seqfile, cfg->hmmfile, go);
   if (domtblfp) p7_tophits_TabularTail(domtblfp, "hmmscan", p7_SCAN_MODELS, cfg->seqfile, cfg->hmmfile, go);
   if (pfamtblfp)p7_tophits_TabularTail(pfamtblfp, "hmmscan", p7_SEARCH_SEQS, cfg->seqfile, cfg->hmmfile, go);
+  if (stagetblfp)p7_tophits_TabularTail(stagetblfp, "hmmscan", p7_SCAN_MODELS, cfg->seqfile, cfg->hmmfile, go);
   if (ofp)      { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
   /* Cleanup - prepare for successful exit
@@ -982,6 +1060,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (tblfp)         fclose(tblfp);
   if (domtblfp)      fclose(domtblfp);
   if (pfamtblfp)     fclose(pfamtblfp);
+  if (stagetblfp)    fclose(stagetblfp);
 
   return eslOK;
 
@@ -1153,26 +1232,34 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
 #endif /*HMMER_MPI*/
 
 static int
-serial_loop(WORKER_INFO *info, P7_HMMFILE *hfp)
+serial_loop(WORKER_INFO *info, P7_HMMFILE *hfp, P7_HMMCACHE *hcache)
 {
   int            status;
+  int            i, q;
+  uint32_t       next  = 0;	/* next profile in <hcache> */
 
-  P7_OPROFILE   *om;
-  ESL_ALPHABET  *abc = NULL;
-  /* Main loop: */
-  while ((status = p7_oprofile_ReadMSV(hfp, &abc, &om)) == eslOK)
-    {
-      p7_pli_NewModel(info->pli, om, info->bg);
-      p7_bg_SetLength(info->bg, info->qsq->n);
-      p7_oprofile_ReconfigLength(om, info->qsq->n);
+  P7_OM_BLOCK   *block = p7_oprofile_CreateBlock(BLOCK_SIZE);
+  ESL_ALPHABET  *abc   = NULL;
 
-      status = p7_Pipeline(info->pli, om, info->bg, info->qsq, NULL, info->th);
-      if (status == eslEINVAL) p7_Fail(info->pli->errbuf);
+  if (block == NULL) esl_fatal("Failed to allocate profile block");
 
-      p7_oprofile_Destroy(om);
-      p7_pipeline_Reuse(info->pli);
+  /* Main loop: the queries against a block of models at a time */
+  while ((status = (hcache ? p7_hmmcache_ReadBlock(hcache, &next, block) : p7_oprofile_ReadBlockMSV(hfp, &abc, block))) == eslOK)
+    {
+      for (q = 0; q < info->nq; q++)
+	{
+	  status = p7_Pipeline_ScanBlock(info->pli[q], block->list, block->count, info->bg, info->qsq[q], NULL, info->th[q]);
+	  if (status == eslEINVAL) p7_Fail(info->pli[q]->errbuf);
+	}
+
+      for (i = 0; i < block->count; ++i)
+	{
+	  if (! info->cached) p7_oprofile_Destroy(block->list[i]);
+	  block->list[i] = NULL;
+	}
     }
 
+  p7_oprofile_DestroyBlock(block);
   esl_alphabet_Destroy(abc);
 
   return status;
@@ -1180,47 +1267,44 @@ serial_loop(WORKER_INFO *info, P7_HMMFILE *hfp)
 
 #ifdef HMMER_THREADS
 static int
-thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, P7_HMMFILE *hfp)
+thread_loop(ESL_THREADS *obj, P7_SCHEDULER *sched, P7_HMMFILE *hfp, P7_HMMCACHE *hcache)
 {
   int  status   = eslOK;
   int  sstatus  = eslOK;
-  int  eofCount = 0;
   P7_OM_BLOCK   *block;
   ESL_ALPHABET  *abc = NULL;
   void          *newBlock;
+  uint32_t       next = 0;	/* next profile in <hcache> */
 
-  esl_workqueue_Reset(queue);
   esl_threads_WaitForStart(obj);
 
-  status = esl_workqueue_ReaderUpdate(queue, NULL, &newBlock);
-  if (status != eslOK) esl_fatal("Work queue reader failed");
+  status = p7_scheduler_ReaderUpdate(sched, NULL, 0, &newBlock);
+  if (status != eslOK) esl_fatal("Scheduler reader failed");
       
   /* Main loop: */
   while (sstatus == eslOK)
     {
       block = (P7_OM_BLOCK *) newBlock;
-      sstatus = p7_oprofile_ReadBlockMSV(hfp, &abc, block);
-      if (sstatus == eslEOF)
-	{
-	  if (eofCount < esl_threads_GetWorkerCount(obj)) sstatus = eslOK;
-	  ++eofCount;
-	}
+      if (hcache) sstatus = p7_hmmcache_ReadBlock(hcache, &next, block);
+      else        sstatus = p7_oprofile_ReadBlockMSV(hfp, &abc, block);
 	  
       if (sstatus == eslOK)
 	{
-	  status = esl_workqueue_ReaderUpdate(queue, block, &newBlock);
-	  if (status != eslOK) esl_fatal("Work queue reader failed");
+	  status = p7_scheduler_ReaderUpdate(sched, block, block->count, &newBlock);
+	  if (status != eslOK) esl_fatal("Scheduler reader failed");
 	}
     }
 
-  status = esl_workqueue_ReaderUpdate(queue, block, NULL);
-  if (status != eslOK) esl_fatal("Work queue reader failed");
+  status = p7_scheduler_ReaderUpdate(sched, block, block->count, NULL);
+  if (status != eslOK) esl_fatal("Scheduler reader failed");
+  status = p7_scheduler_ReaderFinish(sched);
+  if (status != eslOK) esl_fatal("Scheduler reader failed");
 
   if (sstatus == eslEOF)
     {
       /* wait for all the threads to complete */
       esl_threads_WaitForFinish(obj);
-      esl_workqueue_Complete(queue);  
+      p7_scheduler_Reset(sched);
     }
   
   esl_alphabet_Destroy(abc);
@@ -1230,13 +1314,13 @@ thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, P7_HMMFILE *hfp)
 static void 
 pipeline_thread(void *arg)
 {
-  int i;
+  int i, q;
   int status;
   int workeridx;
-  WORKER_INFO   *info;
-  ESL_THREADS   *obj;
-  P7_OM_BLOCK   *block;
-  void          *newBlock;
+  WORKER_INFO    *info;
+  ESL_THREADS    *obj;
+  P7_OM_BLOCK    *block;
+  P7_SCHED_RANGE  r;
   
   impl_Init();
 
@@ -1245,39 +1329,29 @@ pipeline_thread(void *arg)
 
   info = (WORKER_INFO *) esl_threads_GetData(obj, workeridx);
 
-  status = esl_workqueue_WorkerUpdate(info->queue, NULL, &newBlock);
-  if (status != eslOK) esl_fatal("Work queue worker failed");
-
-  /* loop until all blocks have been processed */
-  block = (P7_OM_BLOCK *) newBlock;
-  while (block->count > 0)
+  /* loop until all models have been processed, a few at a time */
+  r.blk = NULL;
+  while ((status = p7_scheduler_WorkerUpdate(info->sched, workeridx, &r)) == eslOK)
   {
-      /* Main loop: */
-    for (i = 0; i < block->count; ++i)
-    {
-      P7_OPROFILE *om = block->list[i];
-
-      p7_pli_NewModel(info->pli, om, info->bg);
-      p7_bg_SetLength(info->bg, info->qsq->n);
-      p7_oprofile_ReconfigLength(om, info->qsq->n);
+    block = (P7_OM_BLOCK *) r.blk;
 
-      status = p7_Pipeline(info->pli, om, info->bg, info->qsq, NULL, info->th);
-      if (status == eslEINVAL) p7_Fail(info->pli->errbuf);
-
-      p7_oprofile_Destroy(om);
-      p7_pipeline_Reuse(info->pli);
+    /* Main loop: the queries against the models; only MSV survivors go on.
+     * Models r.lo..r.hi-1 are this worker's alone, in this pass, so it
+     * can reconfigure their lengths even when they're shared in a cache.
+     */
+    for (q = 0; q < info->nq; q++)
+    {
+      status = p7_Pipeline_ScanBlock(info->pli[q], block->list + r.lo, r.hi - r.lo, info->bg, info->qsq[q], NULL, info->th[q]);
+      if (status == eslEINVAL) p7_Fail(info->pli[q]->errbuf);
+    }
 
+    for (i = r.lo; i < r.hi; ++i)
+    {
+      if (! info->cached) p7_oprofile_Destroy(block->list[i]);
       block->list[i] = NULL;
     }
-
-    status = esl_workqueue_WorkerUpdate(info->queue, block, &newBlock);
-    if (status != eslOK) esl_fatal("Work queue worker failed");
-
-    block = (P7_OM_BLOCK *) newBlock;
   }
-
-  status = esl_workqueue_WorkerUpdate(info->queue, block, NULL);
-  if (status != eslOK) esl_fatal("Work queue worker failed");
+  if (status != eslEOD) esl_fatal("Scheduler worker failed");
 
   esl_threads_Finished(obj, workeridx);
   return;
@@ -28,19 +28,23 @@
 #ifdef HMMER_THREADS
 #include <unistd.h>
 #include "esl_threads.h"
-#include "esl_workqueue.h"
 #endif 
 
 #include "hmmer.h"
+#include "p7_scheduler.h"
+#include "p7_seqdb.h"
+#include "p7_seqreader.h"
 
 typedef struct {
 #ifdef HMMER_THREADS
-  ESL_WORK_QUEUE   *queue;
+  P7_SCHEDULER     *sched;
 #endif 
-  P7_BG            *bg;	         /* null model                              */
-  P7_PIPELINE      *pli;         /* work pipeline                           */
-  P7_TOPHITS       *th;          /* top hit results                         */
-  P7_OPROFILE      *om;          /* optimized query profile                 */
+  P7_SEQDB         *seqdb;       /* pre-digitized targets, or NULL          */
+  int               nq;          /* number of queries in this batch         */
+  P7_BG           **bg;	         /* null models, one per query [0..nq-1]    */
+  P7_PIPELINE     **pli;         /* work pipelines, ditto                   */
+  P7_TOPHITS      **th;          /* top hit results, ditto                  */
+  P7_OPROFILE     **om;          /* optimized query profiles, ditto         */
 } WORKER_INFO;
 
 #define REPOPTS     "-E,-T,--cut_ga,--cut_nc,--cut_tc"
@@ -51,11 +55,16 @@ typedef struct {
 
 #if defined (HMMER_THREADS) && defined (HMMER_MPI)
 #define CPUOPTS     "--mpi"
-#define MPIOPTS     "--cpu"
+#define MPIOPTS     "--cpu,--rcpu,--qbatch"
 #else
 #define CPUOPTS     NULL
 #define MPIOPTS     NULL
 #endif
+#ifdef HMMER_MPI
+#define NOMPIOPTS   "--mpi"	/* incompat list of options the MPI path lacks   */
+#else
+#define NOMPIOPTS   NULL
+#endif
 
 static ESL_OPTIONS options[] = {
   /* name           type      default  env  range     toggles   reqs   incomp              help                                                      docgroup*/
@@ -66,6 +75,7 @@ static ESL_OPTIONS options[] = {
   { "--tblout",     eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save parseable table of per-sequence hits to file <f>",        2 },
   { "--domtblout",  eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save parseable table of per-domain hits to file <f>",          2 },
   { "--pfamtblout", eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save table of hits and domains to file, in Pfam format <f>",   2 },
+  { "--stagetblout",eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save table of time and work in each pipeline stage to file <f>", 2 },
   { "--acc",        eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "prefer accessions over names in output",                       2 },
   { "--noali",      eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "don't output alignments, so output is smaller",                2 },
   { "--notextw",    eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL, "--textw",        "unlimit ASCII text output line width",                         2 },
@@ -75,6 +85,7 @@ static ESL_OPTIONS options[] = {
   { "-T",           eslARG_REAL,   FALSE, NULL, NULL,    NULL,  NULL,  REPOPTS,         "report sequences >= this score threshold in output",           4 },
   { "--domE",       eslARG_REAL,  "10.0", NULL, "x>0",   NULL,  NULL,  DOMREPOPTS,      "report domains <= this E-value threshold in output",           4 },
   { "--domT",       eslARG_REAL,   FALSE, NULL, NULL,    NULL,  NULL,  DOMREPOPTS,      "report domains >= this score cutoff in output",                4 },
+  { "--topn",       eslARG_INT,    FALSE, NULL, "n>0",  NULL,  NULL,  NULL,            "report only the best <n> sequences, skipping the rest early",  4 },
   /* Control of inclusion (significance) thresholds */
   { "--incE",       eslARG_REAL,  "0.01", NULL, "x>0",   NULL,  NULL,  INCOPTS,         "consider sequences <= this E-value threshold as significant",  5 },
   { "--incT",       eslARG_REAL,   FALSE, NULL, NULL,    NULL,  NULL,  INCOPTS,         "consider sequences >= this score threshold as significant",    5 },
@@ -90,6 +101,8 @@ static ESL_OPTIONS options[] = {
   { "--F2",         eslARG_REAL,  "1e-3", NULL, NULL,    NULL,  NULL, "--max",          "Stage 2 (Vit) threshold: promote hits w/ P <= F2",             7 },
   { "--F3",         eslARG_REAL,  "1e-5", NULL, NULL,    NULL,  NULL, "--max",          "Stage 3 (Fwd) threshold: promote hits w/ P <= F3",             7 },
   { "--nobias",     eslARG_NONE,   NULL,  NULL, NULL,    NULL,  NULL, "--max",          "turn off composition bias filter",                             7 },
+  { "--banded",     eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "parse long targets in Forward bands, where they lose < 1e-3",  7 },
+  { "--defer",      eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NOMPIOPTS,       "define domains in a 2nd pass, only for reportable targets",   7 },
 
 /* Other options */
   { "--nonull2",    eslARG_NONE,   NULL,  NULL, NULL,    NULL,  NULL,  NULL,            "turn off biased composition score corrections",               12 },
@@ -97,9 +110,11 @@ static ESL_OPTIONS options[] = {
   { "--domZ",       eslARG_REAL,   FALSE, NULL, "x>0",   NULL,  NULL,  NULL,            "set # of significant seqs, for domain E-value calculation",   12 },
   { "--seed",       eslARG_INT,    "42",  NULL, "n>=0",  NULL,  NULL,  NULL,            "set RNG seed to <n> (if 0: one-time arbitrary seed)",         12 },
   { "--tformat",    eslARG_STRING,  NULL, NULL, NULL,    NULL,  NULL,  NULL,            "assert target <seqfile> is in format <s>: no autodetection",  12 },
+  { "--qbatch",     eslARG_INT,    "1",  NULL, "n>0",   NULL,  NULL,  NULL,            "search <n> queries at a time, in one pass over <seqdb>",      12 },
 
 #ifdef HMMER_THREADS 
   { "--cpu",        eslARG_INT, p7_NCPU,"HMMER_NCPU","n>=0",NULL,  NULL,  CPUOPTS,      "number of parallel CPU workers to use for multithreads",      12 },
+  { "--rcpu",       eslARG_INT,    "0",  NULL, "n>=0",  NULL,  NULL,  CPUOPTS,         "number of threads parsing <seqdb> (0: the master reads it)",  12 },
 #endif
 #ifdef HMMER_MPI
   { "--stall",      eslARG_NONE,   FALSE, NULL, NULL,    NULL,"--mpi", NULL,            "arrest after start: for debugging MPI under gdb",             12 },  
@@ -139,12 +154,13 @@ struct cfg_s {
 };
 
 static int  serial_master(ESL_GETOPTS *go, struct cfg_s *cfg);
-static int  serial_loop  (WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs);
+static int  serial_loop  (WORKER_INFO *info, ESL_SQFILE *dbfp, P7_SEQDB *seqdb, int n_targetseqs);
+static P7_PIPELINE *worker_pipeline(ESL_GETOPTS *go, P7_OPROFILE *om, P7_BG *bg);
 
 #ifdef HMMER_THREADS
 #define BLOCK_SIZE 1000
 
-static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_targetseqs);
+static int  thread_loop(ESL_THREADS *obj, P7_SCHEDULER *sched, P7_SEQREADER *rdr, ESL_SQFILE *dbfp, P7_SEQDB *seqdb, int n_targetseqs);
 static void pipeline_thread(void *arg);
 #endif 
 
@@ -228,6 +244,7 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *hmmfile, char *seqfile)
   if (esl_opt_IsUsed(go, "--tblout")     && fprintf(ofp, "# per-seq hits tabular output:     %s\n",             esl_opt_GetString(go, "--tblout"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domtblout")  && fprintf(ofp, "# per-dom hits tabular output:     %s\n",             esl_opt_GetString(go, "--domtblout"))  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--pfamtblout") && fprintf(ofp, "# pfam-style tabular hit output:   %s\n",             esl_opt_GetString(go, "--pfamtblout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--stagetblout") && fprintf(ofp, "# pipeline stage table output:    %s\n",             esl_opt_GetString(go, "--stagetblout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--acc")        && fprintf(ofp, "# prefer accessions over names:    yes\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--noali")      && fprintf(ofp, "# show alignments in output:       no\n")                                                    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--notextw")    && fprintf(ofp, "# max ASCII text line length:      unlimited\n")                                             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -236,6 +253,7 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *hmmfile, char *seqfile)
   if (esl_opt_IsUsed(go, "-T")           && fprintf(ofp, "# sequence reporting threshold:    score >= %g\n",    esl_opt_GetReal(go, "-T"))             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domE")       && fprintf(ofp, "# domain reporting threshold:      E-value <= %g\n",  esl_opt_GetReal(go, "--domE"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domT")       && fprintf(ofp, "# domain reporting threshold:      score >= %g\n",    esl_opt_GetReal(go, "--domT"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--topn")       && fprintf(ofp, "# report only the best:            %d sequences\n",  esl_opt_GetInteger(go, "--topn"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incE")       && fprintf(ofp, "# sequence inclusion threshold:    E-value <= %g\n",  esl_opt_GetReal(go, "--incE"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incT")       && fprintf(ofp, "# sequence inclusion threshold:    score >= %g\n",    esl_opt_GetReal(go, "--incT"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incdomE")    && fprintf(ofp, "# domain inclusion threshold:      E-value <= %g\n",  esl_opt_GetReal(go, "--incdomE"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -248,6 +266,8 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *hmmfile, char *seqfile)
   if (esl_opt_IsUsed(go, "--F2")         && fprintf(ofp, "# Vit filter P threshold:       <= %g\n",             esl_opt_GetReal(go, "--F2"))           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--F3")         && fprintf(ofp, "# Fwd filter P threshold:       <= %g\n",             esl_opt_GetReal(go, "--F3"))           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--nobias")     && fprintf(ofp, "# biased composition HMM filter:   off\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--banded")     && fprintf(ofp, "# banded Fwd/Bck on long targets:  on\n")                                                    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--defer")      && fprintf(ofp, "# deferred domain definition:      on\n")                                                    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--restrictdb_stkey") && fprintf(ofp, "# Restrict db to start at seq key: %s\n",            esl_opt_GetString(go, "--restrictdb_stkey"))  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--restrictdb_n")     && fprintf(ofp, "# Restrict db to # target seqs:    %d\n",            esl_opt_GetInteger(go, "--restrictdb_n")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--ssifile")          && fprintf(ofp, "# Override ssi file to:            %s\n",            esl_opt_GetString(go, "--ssifile"))       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -260,8 +280,10 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *hmmfile, char *seqfile)
     else if (                               fprintf(ofp, "# random number seed set to:       %d\n",             esl_opt_GetInteger(go, "--seed"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   }
   if (esl_opt_IsUsed(go, "--tformat")    && fprintf(ofp, "# targ <seqfile> format asserted:  %s\n",             esl_opt_GetString(go, "--tformat"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--qbatch")     && fprintf(ofp, "# queries searched per pass:       %d\n",             esl_opt_GetInteger(go, "--qbatch"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #ifdef HMMER_THREADS
   if (esl_opt_IsUsed(go, "--cpu")        && fprintf(ofp, "# number of worker threads:        %d\n",             esl_opt_GetInteger(go, "--cpu"))       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");  
+  if (esl_opt_IsUsed(go, "--rcpu")       && fprintf(ofp, "# number of parser threads:        %d\n",             esl_opt_GetInteger(go, "--rcpu"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #endif
 #ifdef HMMER_MPI
   if (esl_opt_IsUsed(go, "--mpi")        && fprintf(ofp, "# MPI:                             on\n")                                                    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -354,18 +376,28 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   FILE            *tblfp    = NULL;              /* output stream for tabular per-seq (--tblout)    */
   FILE            *domtblfp = NULL;              /* output stream for tabular per-dom (--domtblout) */
   FILE            *pfamtblfp= NULL;              /* output stream for pfam tabular output (--pfamtblout)    */
+  FILE            *stagetblfp= NULL;             /* output stream for per-stage timing table (--stagetblout) */
   P7_HMMFILE      *hfp      = NULL;              /* open input HMM file                             */
   ESL_SQFILE      *dbfp     = NULL;              /* open input sequence file                        */
-  P7_HMM          *hmm      = NULL;              /* one HMM query                                   */
+  P7_SEQDB        *seqdb    = NULL;              /* ... or open pre-digitized database              */
+  P7_HMM         **hmm      = NULL;              /* a batch of HMM queries [0..nb-1]                */
+  P7_PROFILE      *gm       = NULL;              /* profile of one query                            */
+  P7_OPROFILE    **om       = NULL;              /* optimized query profiles [0..nb-1]              */
+  P7_PIPELINE     *pli      = NULL;              /* merged pipeline of one query, for output        */
+  P7_TOPHITS      *th       = NULL;              /* merged hits of one query, ditto                 */
   ESL_ALPHABET    *abc      = NULL;              /* digital alphabet                                */
   int              dbfmt    = eslSQFILE_UNKNOWN; /* format code for sequence database file          */
   ESL_STOPWATCH   *w;
   int              textw    = 0;
   int              nquery   = 0;
+  int              qbatch   = esl_opt_GetInteger(go, "--qbatch");
+  int              nb;                           /* number of queries in the current batch          */
   int              status   = eslOK;
   int              hstatus  = eslOK;
   int              sstatus  = eslOK;
-  int              i;
+  int              i, q;
+  int              do_defer = esl_opt_GetBoolean(go, "--defer");
+  int              pass;
 
   int              ncpus    = 0;
 
@@ -374,7 +406,8 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #ifdef HMMER_THREADS
   ESL_SQ_BLOCK    *block    = NULL;
   ESL_THREADS     *threadObj= NULL;
-  ESL_WORK_QUEUE  *queue    = NULL;
+  P7_SCHEDULER    *sched    = NULL;
+  P7_SEQREADER    *rdr      = NULL;
 #endif
   char             errbuf[eslERRBUFSIZE];
 
@@ -388,15 +421,23 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     if (dbfmt == eslSQFILE_UNKNOWN) p7_Fail("%s is not a recognized sequence database file format\n", esl_opt_GetString(go, "--tformat"));
   }
 
-  /* Open the target sequence database */
-  status = esl_sqfile_Open(cfg->dbfile, dbfmt, p7_SEQDBENV, &dbfp);
-  if      (status == eslENOTFOUND) p7_Fail("Failed to open sequence file %s for reading\n",          cfg->dbfile);
-  else if (status == eslEFORMAT)   p7_Fail("Sequence file %s is empty or misformatted\n",            cfg->dbfile);
-  else if (status == eslEINVAL)    p7_Fail("Can't autodetect format of a stdin or .gz seqfile");
-  else if (status != eslOK)        p7_Fail("Unexpected error %d opening sequence file %s\n", status, cfg->dbfile);  
+  /* Open the target sequence database: a makehmmerseqdb file, or else a sequence file */
+  if (dbfmt == eslSQFILE_UNKNOWN && strcmp(cfg->dbfile, "-") != 0)
+    {
+      status = p7_seqdb_Open(cfg->dbfile, &seqdb, errbuf);
+      if (status != eslOK && status != eslEFORMAT && status != eslENOTFOUND) p7_Fail("Failed to open binary sequence database %s\n%s\n", cfg->dbfile, errbuf);
+    }
 
+  if (seqdb == NULL)
+    {
+      status = esl_sqfile_Open(cfg->dbfile, dbfmt, p7_SEQDBENV, &dbfp);
+      if      (status == eslENOTFOUND) p7_Fail("Failed to open sequence file %s for reading\n",          cfg->dbfile);
+      else if (status == eslEFORMAT)   p7_Fail("Sequence file %s is empty or misformatted\n",            cfg->dbfile);
+      else if (status == eslEINVAL)    p7_Fail("Can't autodetect format of a stdin or .gz seqfile");
+      else if (status != eslOK)        p7_Fail("Unexpected error %d opening sequence file %s\n", status, cfg->dbfile);  
+    }
 
-  if (esl_opt_IsUsed(go, "--restrictdb_stkey") || esl_opt_IsUsed(go, "--restrictdb_n")) {
+  if (dbfp != NULL && (esl_opt_IsUsed(go, "--restrictdb_stkey") || esl_opt_IsUsed(go, "--restrictdb_n"))) {
     if (esl_opt_IsUsed(go, "--ssifile"))
       esl_sqfile_OpenSSI(dbfp, esl_opt_GetString(go, "--ssifile"));
     else
@@ -417,6 +458,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (esl_opt_IsOn(go, "--tblout"))    { if ((tblfp    = fopen(esl_opt_GetString(go, "--tblout"),    "w")) == NULL)  esl_fatal("Failed to open tabular per-seq output file %s for writing\n", esl_opt_GetString(go, "--tblout")); }
   if (esl_opt_IsOn(go, "--domtblout")) { if ((domtblfp = fopen(esl_opt_GetString(go, "--domtblout"), "w")) == NULL)  esl_fatal("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblout")); }
   if (esl_opt_IsOn(go, "--pfamtblout")){ if ((pfamtblfp = fopen(esl_opt_GetString(go, "--pfamtblout"), "w")) == NULL)  esl_fatal("Failed to open pfam-style tabular output file %s for writing\n", esl_opt_GetString(go, "--pfamtblout")); }
+  if (esl_opt_IsOn(go, "--stagetblout")){ if ((stagetblfp = fopen(esl_opt_GetString(go, "--stagetblout"), "w")) == NULL)  esl_fatal("Failed to open pipeline stage table output file %s for writing\n", esl_opt_GetString(go, "--stagetblout")); }
 
 #ifdef HMMER_THREADS
   /* initialize thread data */
@@ -424,164 +466,259 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (ncpus > 0)
     {
       threadObj = esl_threads_Create(&pipeline_thread);
-      queue = esl_workqueue_Create(ncpus * 2);
+      sched     = p7_scheduler_Create(ncpus);
     }
 #endif
 
   infocnt = (ncpus == 0) ? 1 : ncpus;
   ESL_ALLOC(info, sizeof(*info) * infocnt);
+  for (i = 0; i < infocnt; ++i)
+    {
+      info[i].nq  = 0;
+      info[i].bg  = NULL;
+      info[i].pli = NULL;
+      info[i].th  = NULL;
+      info[i].om  = NULL;
+    }
+  ESL_ALLOC(hmm, sizeof(P7_HMM *)      * qbatch);
+  ESL_ALLOC(om,  sizeof(P7_OPROFILE *) * qbatch);
 
   /* <abc> is not known 'til first HMM is read. */
-  hstatus = p7_hmmfile_Read(hfp, &abc, &hmm);
+  hstatus = p7_hmmfile_Read(hfp, &abc, &hmm[0]);
   if (hstatus == eslOK)
     {
       /* One-time initializations after alphabet <abc> becomes known */
       output_header(ofp, go, cfg->hmmfile, cfg->dbfile);
-      esl_sqfile_SetDigital(dbfp, abc); //ReadBlock requires knowledge of the alphabet to decide how best to read blocks
+      if (seqdb && seqdb->abctype != abc->type) p7_Fail("Binary sequence database %s has a different alphabet than the query HMMs\n", cfg->dbfile);
+      if (dbfp) esl_sqfile_SetDigital(dbfp, abc); //ReadBlock requires knowledge of the alphabet to decide how best to read blocks
 
       for (i = 0; i < infocnt; ++i)
 	{
-	  info[i].bg    = p7_bg_Create(abc);
+	  /* each query of a batch needs its own null model: the bias filter is set per model */
+	  ESL_ALLOC(info[i].bg,  sizeof(P7_BG *)       * qbatch);
+	  ESL_ALLOC(info[i].pli, sizeof(P7_PIPELINE *) * qbatch);
+	  ESL_ALLOC(info[i].th,  sizeof(P7_TOPHITS *)  * qbatch);
+	  ESL_ALLOC(info[i].om,  sizeof(P7_OPROFILE *) * qbatch);
+	  for (q = 0; q < qbatch; q++)
+	    info[i].bg[q] = p7_bg_Create(abc);
+	  info[i].seqdb = seqdb;
 #ifdef HMMER_THREADS
-	  info[i].queue = queue;
+	  info[i].sched = sched;
 #endif
 	}
 
 #ifdef HMMER_THREADS
       for (i = 0; i < ncpus * 2; ++i)
 	{
-	  block = esl_sq_CreateDigitalBlock(BLOCK_SIZE, abc);
+	  block = (seqdb ? p7_seqdb_CreateBlock(BLOCK_SIZE, abc) : esl_sq_CreateDigitalBlock(BLOCK_SIZE, abc));
 	  if (block == NULL) 	      esl_fatal("Failed to allocate sequence block");
 
- 	  status = esl_workqueue_Init(queue, block);
-	  if (status != eslOK)	      esl_fatal("Failed to add block to work queue");
+ 	  status = p7_scheduler_Add(sched, block);
+	  if (status != eslOK)	      esl_fatal("Failed to add block to scheduler");
+	}
+
+      /* Parallel parsing of <seqdb>, if asked for and if the file can be split */
+      if (ncpus > 0 && dbfp != NULL && esl_opt_GetInteger(go, "--rcpu") > 0 && cfg->firstseq_key == NULL)
+	{
+	  status = p7_seqreader_Open(dbfp, esl_opt_GetInteger(go, "--rcpu"), BLOCK_SIZE, 0, &rdr);
+	  if (status != eslOK && status != eslEINCOMPAT) esl_fatal("Failed to set up parallel parsing of %s", cfg->dbfile);
 	}
 #endif
     }
 
-  /* Outer loop: over each query HMM in <hmmfile>. */
+  /* Outer loop: over each batch of query HMMs in <hmmfile>. 
+   * <hmm[0]> has been read; read the rest of the batch, up to <qbatch> queries.
+   */
   while (hstatus == eslOK) 
     {
-      P7_PROFILE      *gm      = NULL;
-      P7_OPROFILE     *om      = NULL;       /* optimized query profile                  */
+      nb = 1;
+      while (nb < qbatch && (hstatus = p7_hmmfile_Read(hfp, &abc, &hmm[nb])) == eslOK) nb++;
+      if (hstatus != eslOK && hstatus != eslEOF) break;
 
-      nquery++;
       esl_stopwatch_Start(w);
 
       /* seqfile may need to be rewound (multiquery mode) */
-      if (nquery > 1)
+      if (seqdb)
       {
-        if (! esl_sqfile_IsRewindable(dbfp))
-          esl_fatal("Target sequence file %s isn't rewindable; can't search it with multiple queries", cfg->dbfile);
-
-        if (! esl_opt_IsUsed(go, "--restrictdb_stkey") )
-          esl_sqfile_Position(dbfp, 0); //only re-set current position to 0 if we're not planning to set it in a moment
-      }
-
-      if ( cfg->firstseq_key != NULL ) { //it's tempting to want to do this once and capture the offset position for future passes, but ncbi files make this non-trivial, so this keeps it general
-        sstatus = esl_sqfile_PositionByKey(dbfp, cfg->firstseq_key);
+        if (cfg->firstseq_key != NULL) sstatus = p7_seqdb_PositionByKey(seqdb, cfg->firstseq_key);
+        else                           sstatus = p7_seqdb_Position(seqdb, 0);
         if (sstatus != eslOK)
-          p7_Fail("Failure setting restrictdb_stkey to %d\n", cfg->firstseq_key);
+          p7_Fail("Failure setting restrictdb_stkey to %s\n", cfg->firstseq_key);
       }
+      else
+      {
+        if (nquery > 0)
+        {
+          if (! esl_sqfile_IsRewindable(dbfp))
+            esl_fatal("Target sequence file %s isn't rewindable; can't search it with multiple queries", cfg->dbfile);
 
-      if (fprintf(ofp, "Query:       %s  [M=%d]\n", hmm->name, hmm->M)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      if (hmm->acc)  { if (fprintf(ofp, "Accession:   %s\n", hmm->acc)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
-      if (hmm->desc) { if (fprintf(ofp, "Description: %s\n", hmm->desc) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+          if (! esl_opt_IsUsed(go, "--restrictdb_stkey") )
+            esl_sqfile_Position(dbfp, 0); //only re-set current position to 0 if we're not planning to set it in a moment
+        }
+        if (do_defer && ! esl_sqfile_IsRewindable(dbfp))
+          esl_fatal("Target sequence file %s isn't rewindable; can't search it with --defer", cfg->dbfile);
 
-      /* Convert to an optimized model */
-      gm = p7_profile_Create (hmm->M, abc);
-      om = p7_oprofile_Create(hmm->M, abc);
-      p7_ProfileConfig(hmm, info->bg, gm, 100, p7_LOCAL); /* 100 is a dummy length for now; and MSVFilter requires local mode */
-      p7_oprofile_Convert(gm, om);                  /* <om> is now p7_LOCAL, multihit */
+        if ( cfg->firstseq_key != NULL ) { //it's tempting to want to do this once and capture the offset position for future passes, but ncbi files make this non-trivial, so this keeps it general
+          sstatus = esl_sqfile_PositionByKey(dbfp, cfg->firstseq_key);
+          if (sstatus != eslOK)
+            p7_Fail("Failure setting restrictdb_stkey to %d\n", cfg->firstseq_key);
+        }
+      }
+
+      /* Convert to optimized models */
+      for (q = 0; q < nb; q++)
+      {
+        gm    = p7_profile_Create (hmm[q]->M, abc);
+        om[q] = p7_oprofile_Create(hmm[q]->M, abc);
+        p7_ProfileConfig(hmm[q], info->bg[q], gm, 100, p7_LOCAL); /* 100 is a dummy length for now; and MSVFilter requires local mode */
+        p7_oprofile_Convert(gm, om[q]);                  /* <om> is now p7_LOCAL, multihit */
+        p7_profile_Destroy(gm);
+      }
 
       for (i = 0; i < infocnt; ++i)
       {
-        /* Create processing pipeline and hit list */
-        info[i].th  = p7_tophits_Create();
-        info[i].om  = p7_oprofile_Clone(om);
-        info[i].pli = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
-        status = p7_pli_NewModel(info[i].pli, info[i].om, info[i].bg);
-        if (status == eslEINVAL) p7_Fail(info->pli->errbuf);
+        /* Create processing pipelines and hit lists, one per query */
+        info[i].nq = nb;
+        for (q = 0; q < nb; q++)
+        {
+          info[i].th[q]  = p7_tophits_Create();
+          info[i].om[q]  = p7_oprofile_Clone(om[q]);
+          info[i].pli[q] = worker_pipeline(go, info[i].om[q], info[i].bg[q]);
+          if (do_defer) p7_pli_SetDeferred(info[i].pli[q]);
+        }
 
 #ifdef HMMER_THREADS
         if (ncpus > 0) esl_threads_AddThread(threadObj, &info[i]);
 #endif
       }
 
+      for (pass = 1; pass <= (do_defer ? 2 : 1); pass++)
+      {
+        if (pass == 2)
+        {
+          /* --defer: now that all targets are counted, pick those that could
+           * be reported or included, and read the targets again to define
+           * their domains. The other threads get new pipelines, which don't
+           * count the targets a second time.
+           */
+          for (q = 0; q < nb; q++)
+          {
+            for (i = 1; i < infocnt; ++i)
+            {
+              p7_pipeline_Merge(info[0].pli[q], info[i].pli[q]);
+              p7_pipeline_Destroy(info[i].pli[q]);
+              info[i].pli[q] = worker_pipeline(go, info[i].om[q], info[i].bg[q]);
+            }
+            p7_pli_DeferredSelect(info[0].pli[q], om[q]);
+            for (i = 1; i < infocnt; ++i)
+              p7_pli_DeferredShare(info[i].pli[q], info[0].pli[q]);
+          }
 #ifdef HMMER_THREADS
-      if (ncpus > 0)  sstatus = thread_loop(threadObj, queue, dbfp, cfg->n_targetseq);
-      else            sstatus = serial_loop(info, dbfp, cfg->n_targetseq);
-#else
-      sstatus = serial_loop(info, dbfp, cfg->n_targetseq);
+          for (i = 0; i < infocnt; ++i)
+            if (ncpus > 0) esl_threads_AddThread(threadObj, &info[i]);
 #endif
-      switch(sstatus)
-      {
-      case eslEFORMAT:
-        esl_fatal("Parse failed (sequence file %s):\n%s\n",
-            dbfp->filename, esl_sqfile_GetErrorBuf(dbfp));
-        break;
-      case eslEOF:
-        /* do nothing */
-        break;
-      default:
-        esl_fatal("Unexpected error %d reading sequence file %s", sstatus, dbfp->filename);
-      }
 
-      /* merge the results of the search results */
-      for (i = 1; i < infocnt; ++i)
-      {
-        p7_tophits_Merge(info[0].th, info[i].th);
-        p7_pipeline_Merge(info[0].pli, info[i].pli);
+          if      (seqdb)                      sstatus = (cfg->firstseq_key ? p7_seqdb_PositionByKey(seqdb, cfg->firstseq_key) : p7_seqdb_Position(seqdb, 0));
+          else if (cfg->firstseq_key != NULL)  sstatus = esl_sqfile_PositionByKey(dbfp, cfg->firstseq_key);
+          else                                 sstatus = esl_sqfile_Position(dbfp, 0);
+          if (sstatus != eslOK) p7_Fail("Failed to rewind sequence file %s for the second pass\n", cfg->dbfile);
+        }
 
-        p7_pipeline_Destroy(info[i].pli);
-        p7_tophits_Destroy(info[i].th);
-        p7_oprofile_Destroy(info[i].om);
+#ifdef HMMER_THREADS
+        if (ncpus > 0)  sstatus = thread_loop(threadObj, sched, rdr, dbfp, seqdb, cfg->n_targetseq);
+        else            sstatus = serial_loop(info, dbfp, seqdb, cfg->n_targetseq);
+#else
+        sstatus = serial_loop(info, dbfp, seqdb, cfg->n_targetseq);
+#endif
+        switch(sstatus)
+        {
+        case eslEFORMAT:
+          esl_fatal("Parse failed (sequence file %s):\n%s\n",
+              cfg->dbfile, esl_sqfile_GetErrorBuf(dbfp));
+          break;
+        case eslEOF:
+          /* do nothing */
+          break;
+        default:
+          esl_fatal("Unexpected error %d reading sequence file %s", sstatus, cfg->dbfile);
+        }
       }
-
-      /* Print the results.  */
-      p7_tophits_SortBySortkey(info->th);
-      p7_tophits_Threshold(info->th, info->pli);
-      p7_tophits_Targets(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      p7_tophits_Domains(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-
-      if (tblfp)     p7_tophits_TabularTargets(tblfp,    hmm->name, hmm->acc, info->th, info->pli, (nquery == 1));
-      if (domtblfp)  p7_tophits_TabularDomains(domtblfp, hmm->name, hmm->acc, info->th, info->pli, (nquery == 1));
-      if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, hmm->name, hmm->acc, info->th, info->pli);
-  
       esl_stopwatch_Stop(w);
-      p7_pli_Statistics(ofp, info->pli, w);
-      if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
-      /* Output the results in an MSA (-A option) */
-      if (afp) {
-	ESL_MSA *msa = NULL;
+      /* With --qbatch, the pass over <seqdb> was shared by the <nb> queries
+       * of the batch; each query's footer reports its share of that time.
+       */
+      w->elapsed /= (double) nb;
+      w->user    /= (double) nb;
+      w->sys     /= (double) nb;
 
-	if (p7_tophits_Alignment(info->th, abc, NULL, NULL, 0, p7_ALL_CONSENSUS_COLS, &msa) == eslOK)
-	  {
-	    esl_msa_SetName     (msa, hmm->name, -1);
-	    esl_msa_SetAccession(msa, hmm->acc,  -1);
-	    esl_msa_SetDesc     (msa, hmm->desc, -1);
-	    esl_msa_FormatAuthor(msa, "hmmsearch (HMMER %s)", HMMER_VERSION);
+      /* Output, one query at a time, in the order of <hmmfile> */
+      for (q = 0; q < nb; q++)
+      {
+        nquery++;
 
-	    if (textw > 0) esl_msafile_Write(afp, msa, eslMSAFILE_STOCKHOLM);
-	    else           esl_msafile_Write(afp, msa, eslMSAFILE_PFAM);
+        /* merge the results of the search results */
+        for (i = 1; i < infocnt; ++i)
+        {
+          p7_tophits_Merge(info[0].th[q], info[i].th[q]);
+          p7_pipeline_Merge(info[0].pli[q], info[i].pli[q]);
+
+          p7_pipeline_Destroy(info[i].pli[q]);
+          p7_tophits_Destroy(info[i].th[q]);
+          p7_oprofile_Destroy(info[i].om[q]);
+        }
+
+        if (fprintf(ofp, "Query:       %s  [M=%d]\n", hmm[q]->name, hmm[q]->M)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+        if (hmm[q]->acc)  { if (fprintf(ofp, "Accession:   %s\n", hmm[q]->acc)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+        if (hmm[q]->desc) { if (fprintf(ofp, "Description: %s\n", hmm[q]->desc) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+
+        /* Print the results.  */
+        th  = info->th[q];
+        pli = info->pli[q];
+        p7_tophits_SortBySortkey(th);
+        p7_tophits_Threshold(th, pli);
+        if (p7_tophits_MakeDisplays(th, pli, om[q], FALSE) != eslOK) p7_Fail("Failed to make alignment displays\n");
+        p7_tophits_Targets(ofp, th, pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+        p7_tophits_Domains(ofp, th, pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+
+        if (tblfp)     p7_tophits_TabularTargets(tblfp,    hmm[q]->name, hmm[q]->acc, th, pli, (nquery == 1));
+        if (domtblfp)  p7_tophits_TabularDomains(domtblfp, hmm[q]->name, hmm[q]->acc, th, pli, (nquery == 1));
+        if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, hmm[q]->name, hmm[q]->acc, th, pli);
+        if (stagetblfp) p7_pli_WriteStageTable(stagetblfp, hmm[q]->name, pli, (nquery == 1));
+  
+        p7_pli_Statistics(ofp, pli, w);
+        if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+
+        /* Output the results in an MSA (-A option) */
+        if (afp) {
+          ESL_MSA *msa = NULL;
+
+          if (p7_tophits_Alignment(th, abc, NULL, NULL, 0, p7_ALL_CONSENSUS_COLS, &msa) == eslOK)
+            {
+              esl_msa_SetName     (msa, hmm[q]->name, -1);
+              esl_msa_SetAccession(msa, hmm[q]->acc,  -1);
+              esl_msa_SetDesc     (msa, hmm[q]->desc, -1);
+              esl_msa_FormatAuthor(msa, "hmmsearch (HMMER %s)", HMMER_VERSION);
+
+              if (textw > 0) esl_msafile_Write(afp, msa, eslMSAFILE_STOCKHOLM);
+              else           esl_msafile_Write(afp, msa, eslMSAFILE_PFAM);
 	  
-	    if (fprintf(ofp, "# Alignment of %d hits satisfying inclusion thresholds saved to: %s\n", msa->nseq, esl_opt_GetString(go, "-A")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-	  } 
-	else { if (fprintf(ofp, "# No hits satisfy inclusion thresholds; no alignment saved\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+              if (fprintf(ofp, "# Alignment of %d hits satisfying inclusion thresholds saved to: %s\n", msa->nseq, esl_opt_GetString(go, "-A")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+            } 
+          else { if (fprintf(ofp, "# No hits satisfy inclusion thresholds; no alignment saved\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 	  
-	esl_msa_Destroy(msa);
-      }
+          esl_msa_Destroy(msa);
+        }
 
-      p7_pipeline_Destroy(info->pli);
-      p7_tophits_Destroy(info->th);
-      p7_oprofile_Destroy(info->om);
-      p7_oprofile_Destroy(om);
-      p7_profile_Destroy(gm);
-      p7_hmm_Destroy(hmm);
+        p7_pipeline_Destroy(pli);
+        p7_tophits_Destroy(th);
+        p7_oprofile_Destroy(info->om[q]);
+        p7_oprofile_Destroy(om[q]);
+        p7_hmm_Destroy(hmm[q]);
+      }
 
-      hstatus = p7_hmmfile_Read(hfp, &abc, &hmm);
-    } /* end outer loop over query HMMs */
+      if (hstatus == eslOK) hstatus = p7_hmmfile_Read(hfp, &abc, &hmm[0]);
+    } /* end outer loop over batches of query HMMs */
 
   switch(hstatus) {
   case eslEOD:       p7_Fail("read failed, HMM file %s may be truncated?", cfg->hmmfile);      break;
@@ -597,27 +734,42 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (tblfp)    p7_tophits_TabularTail(tblfp,    "hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
   if (domtblfp) p7_tophits_TabularTail(domtblfp, "hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
   if (pfamtblfp) p7_tophits_TabularTail(pfamtblfp,"hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
+  if (stagetblfp) p7_tophits_TabularTail(stagetblfp,"hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
   if (ofp)      { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
   /* Cleanup - prepare for exit
    */
   for (i = 0; i < infocnt; ++i)
-    p7_bg_Destroy(info[i].bg);
+    {
+      if (info[i].bg)
+	for (q = 0; q < qbatch; q++) p7_bg_Destroy(info[i].bg[q]);
+      free(info[i].bg);
+      free(info[i].pli);
+      free(info[i].th);
+      free(info[i].om);
+    }
 
 #ifdef HMMER_THREADS
   if (ncpus > 0)
     {
-      esl_workqueue_Reset(queue);
-      while (esl_workqueue_Remove(queue, (void **) &block) == eslOK)
-	esl_sq_DestroyBlock(block);
-      esl_workqueue_Destroy(queue);
+      p7_scheduler_Reset(sched);
+      while (p7_scheduler_Remove(sched, (void **) &block) == eslOK)
+	{
+	  if (seqdb) p7_seqdb_DestroyBlock(block);
+	  else       esl_sq_DestroyBlock(block);
+	}
+      p7_scheduler_Destroy(sched);
+      p7_seqreader_Close(rdr);
       esl_threads_Destroy(threadObj);
     }
 #endif
 
   free(info);
+  free(hmm);
+  free(om);
   p7_hmmfile_Close(hfp);
-  esl_sqfile_Close(dbfp);
+  if (dbfp) esl_sqfile_Close(dbfp);
+  p7_seqdb_Close(seqdb);
   esl_alphabet_Destroy(abc);
   esl_stopwatch_Destroy(w);
 
@@ -626,6 +778,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (tblfp)         fclose(tblfp);
   if (domtblfp)      fclose(domtblfp);
   if (pfamtblfp)     fclose(pfamtblfp);
+  if (stagetblfp)    fclose(stagetblfp);
 
   return eslOK;
 
@@ -808,6 +961,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   FILE            *tblfp    = NULL;              /* output stream for tabular per-seq (--tblout)    */
   FILE            *domtblfp = NULL;              /* output stream for tabular per-dom (--domtblout) */
   FILE            *pfamtblfp= NULL;              /* output stream for pfam-style tabular output  (--pfamtblout) */
+  FILE            *stagetblfp= NULL;             /* output stream for per-stage timing table (--stagetblout) */
   P7_BG           *bg       = NULL;	         /* null model                                      */
   P7_HMMFILE      *hfp      = NULL;              /* open input HMM file                             */
   ESL_SQFILE      *dbfp     = NULL;              /* open input sequence file                        */
@@ -882,6 +1036,9 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (esl_opt_IsOn(go, "--pfamtblout") && (pfamtblfp = fopen(esl_opt_GetString(go, "--pfamtblout"), "w")) == NULL)
     mpi_failure("Failed to open pfam-style tabular output file %s for writing\n", esl_opt_GetString(go, "--pfamtblout"));
 
+  if (esl_opt_IsOn(go, "--stagetblout") && (stagetblfp = fopen(esl_opt_GetString(go, "--stagetblout"), "w")) == NULL)
+    mpi_failure("Failed to open pipeline stage table output file %s for writing\n", esl_opt_GetString(go, "--stagetblout"));
+
   ESL_ALLOC(list, sizeof(BLOCK_LIST));
   list->complete = 0;
   list->size     = 0;
@@ -935,6 +1092,8 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       /* Create processing pipeline and hit list */
       th  = p7_tophits_Create(); 
       pli = p7_pipeline_Create(go, hmm->M, 100, FALSE, p7_SEARCH_SEQS);
+      pli->do_banded = esl_opt_GetBoolean(go, "--banded");
+      if (esl_opt_IsOn(go, "--topn")) p7_pli_SetTopN(pli, esl_opt_GetInteger(go, "--topn"));
       p7_pli_NewModel(pli, om, bg);
 
       /* Main loop: */
@@ -1035,6 +1194,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       if (tblfp)    p7_tophits_TabularTargets(tblfp,    hmm->name, hmm->acc, th, pli, (nquery == 1));
       if (domtblfp) p7_tophits_TabularDomains(domtblfp, hmm->name, hmm->acc, th, pli, (nquery == 1));
       if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, hmm->name, hmm->acc, th, pli);
+      if (stagetblfp) p7_pli_WriteStageTable(stagetblfp, hmm->name, pli, (nquery == 1));
 
       esl_stopwatch_Stop(w);
       p7_pli_Statistics(ofp, pli, w);
@@ -1103,6 +1263,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (tblfp)    p7_tophits_TabularTail(tblfp,     "hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
   if (domtblfp) p7_tophits_TabularTail(domtblfp,  "hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
   if (pfamtblfp)p7_tophits_TabularTail(pfamtblfp, "hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
+  if (stagetblfp)p7_tophits_TabularTail(stagetblfp, "hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
   if (ofp)     { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
   /* Cleanup - prepare for exit
@@ -1122,6 +1283,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (tblfp)         fclose(tblfp);
   if (domtblfp)      fclose(domtblfp);
   if (pfamtblfp)     fclose(pfamtblfp);
+  if (stagetblfp)    fclose(stagetblfp);
 
   return eslOK;
 
@@ -1199,6 +1361,8 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
 
       th  = p7_tophits_Create(); 
       pli = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
+      pli->do_banded = esl_opt_GetBoolean(go, "--banded");
+      if (esl_opt_IsOn(go, "--topn")) p7_pli_SetTopN(pli, esl_opt_GetInteger(go, "--topn"));
       p7_pli_NewModel(pli, om, bg);
 
       /* receive a sequence block from the master */
@@ -1285,52 +1449,76 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
 }
 #endif /*HMMER_MPI*/
 
+/* worker_pipeline()
+ * Create the search pipeline for one worker and one query <om>,
+ * configured from the command line.
+ */
+static P7_PIPELINE *
+worker_pipeline(ESL_GETOPTS *go, P7_OPROFILE *om, P7_BG *bg)
+{
+  P7_PIPELINE *pli = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
+
+  pli->do_banded  = esl_opt_GetBoolean(go, "--banded");
+  pli->do_lazy_ad = TRUE;	/* alignment displays are made after thresholding, p7_tophits_MakeDisplays() */
+  if (esl_opt_IsOn(go, "--topn")) p7_pli_SetTopN(pli, esl_opt_GetInteger(go, "--topn"));
+  if (p7_pli_NewModel(pli, om, bg) == eslEINVAL) p7_Fail(pli->errbuf);
+  return pli;
+}
+
 static int
-serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs)
+serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, P7_SEQDB *seqdb, int n_targetseqs)
 {
   int      sstatus;
   ESL_SQ   *dbsq     = NULL;   /* one target sequence (digital)  */
   int seq_cnt = 0;
+  int q;
 
-  dbsq = esl_sq_CreateDigital(info->om->abc);
+  dbsq = (seqdb ? p7_seqdb_CreateSeq(info->om[0]->abc) : esl_sq_CreateDigital(info->om[0]->abc));
 
   /* Main loop: */
-  while ( (n_targetseqs==-1 || seq_cnt<n_targetseqs) &&  (sstatus = esl_sqio_Read(dbfp, dbsq)) == eslOK)
+  while ( (n_targetseqs==-1 || seq_cnt<n_targetseqs) &&  (sstatus = (seqdb ? p7_seqdb_Read(seqdb, dbsq) : esl_sqio_Read(dbfp, dbsq))) == eslOK)
   {
-      p7_pli_NewSeq(info->pli, dbsq);
-      p7_bg_SetLength(info->bg, dbsq->n);
-      p7_oprofile_ReconfigLength(info->om, dbsq->n);
+      dbsq->idx = seq_cnt;	/* the same in both passes of --defer */
+      for (q = 0; q < info->nq; q++)
+      {
+        p7_pli_NewSeq(info->pli[q], dbsq);
+        p7_bg_SetLength(info->bg[q], dbsq->n);
+        p7_oprofile_ReconfigLength(info->om[q], dbsq->n);
       
-      p7_Pipeline(info->pli, info->om, info->bg, dbsq, NULL, info->th);
+        p7_Pipeline(info->pli[q], info->om[q], info->bg[q], dbsq, NULL, info->th[q]);
+        p7_pipeline_Reuse(info->pli[q]);
+      }
 
       seq_cnt++;
-      esl_sq_Reuse(dbsq);
-      p7_pipeline_Reuse(info->pli);
+      if (! seqdb) esl_sq_Reuse(dbsq);
   }
 
   if (n_targetseqs!=-1 && seq_cnt==n_targetseqs)
     sstatus = eslEOF;
 
-  esl_sq_Destroy(dbsq);
+  if (seqdb) p7_seqdb_DestroySeq(dbsq);
+  else       esl_sq_Destroy(dbsq);
 
   return sstatus;
 }
 
 #ifdef HMMER_THREADS
 static int
-thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_targetseqs)
+thread_loop(ESL_THREADS *obj, P7_SCHEDULER *sched, P7_SEQREADER *rdr, ESL_SQFILE *dbfp, P7_SEQDB *seqdb, int n_targetseqs)
 {
   int  status  = eslOK;
   int  sstatus = eslOK;
-  int  eofCount = 0;
+  int64_t nread = 0;
+  int  i;
   ESL_SQ_BLOCK *block;
   void         *newBlock;
 
-  esl_workqueue_Reset(queue);
   esl_threads_WaitForStart(obj);
 
-  status = esl_workqueue_ReaderUpdate(queue, NULL, &newBlock);
-  if (status != eslOK) esl_fatal("Work queue reader failed");
+  if (rdr != NULL && p7_seqreader_Start(rdr, -1, 0) != eslOK) esl_fatal("Failed to start parser threads");
+
+  status = p7_scheduler_ReaderUpdate(sched, NULL, 0, &newBlock);
+  if (status != eslOK) esl_fatal("Scheduler reader failed");
       
   /* Main loop: */
   while (sstatus == eslOK )
@@ -1342,31 +1530,37 @@ thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_tar
         block->count = 0;
         sstatus = eslEOF;
       } else {
-        sstatus = esl_sqio_ReadBlock(dbfp, block, -1, n_targetseqs, /*max_init_window=*/FALSE, FALSE);
+        if      (seqdb) sstatus = p7_seqdb_ReadBlock(seqdb, block, n_targetseqs);
+        else if (rdr)   sstatus = p7_seqreader_ReadBlock(rdr, block, n_targetseqs);
+        else            sstatus = esl_sqio_ReadBlock(dbfp, block, -1, n_targetseqs, /*max_init_window=*/FALSE, FALSE);
         n_targetseqs -= block->count;
-      }
-
-      if (sstatus == eslEOF)
-      {
-        if (eofCount < esl_threads_GetWorkerCount(obj)) sstatus = eslOK;
-        ++eofCount;
+        for (i = 0; i < block->count; i++) block->list[i].idx = nread + i; /* the same in both passes of --defer */
+        nread += block->count;
       }
 
       if (sstatus == eslOK)
       {
-        status = esl_workqueue_ReaderUpdate(queue, block, &newBlock);
-        if (status != eslOK) esl_fatal("Work queue reader failed");
+        status = p7_scheduler_ReaderUpdate(sched, block, block->count, &newBlock);
+        if (status != eslOK) esl_fatal("Scheduler reader failed");
       }
     }
 
-  status = esl_workqueue_ReaderUpdate(queue, block, NULL);
-  if (status != eslOK) esl_fatal("Work queue reader failed");
+  status = p7_scheduler_ReaderUpdate(sched, block, block->count, NULL);
+  if (status != eslOK) esl_fatal("Scheduler reader failed");
+  status = p7_scheduler_ReaderFinish(sched);
+  if (status != eslOK) esl_fatal("Scheduler reader failed");
+
+  if (rdr != NULL)
+    {
+      if (sstatus == eslEFORMAT) esl_fatal("Parse failed (sequence file %s):\n%s\n", dbfp->filename, rdr->errbuf);
+      p7_seqreader_Stop(rdr);
+    }
 
   if (sstatus == eslEOF)
     {
       /* wait for all the threads to complete */
       esl_threads_WaitForFinish(obj);
-      esl_workqueue_Complete(queue);  
+      p7_scheduler_Reset(sched);
     }
 
   return sstatus;
@@ -1375,14 +1569,14 @@ thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_tar
 static void 
 pipeline_thread(void *arg)
 {
-  int i;
+  int i, q;
   int status;
   int workeridx;
   WORKER_INFO   *info;
   ESL_THREADS   *obj;
 
-  ESL_SQ_BLOCK  *block = NULL;
-  void          *newBlock;
+  ESL_SQ_BLOCK   *block;
+  P7_SCHED_RANGE  r;
   
   impl_Init();
 
@@ -1391,36 +1585,24 @@ pipeline_thread(void *arg)
 
   info = (WORKER_INFO *) esl_threads_GetData(obj, workeridx);
 
-  status = esl_workqueue_WorkerUpdate(info->queue, NULL, &newBlock);
-  if (status != eslOK) esl_fatal("Work queue worker failed");
-
-  /* loop until all blocks have been processed */
-  block = (ESL_SQ_BLOCK *) newBlock;
-  while (block->count > 0)
+  /* loop until all targets have been processed, a few at a time */
+  r.blk = NULL;
+  while ((status = p7_scheduler_WorkerUpdate(info->sched, workeridx, &r)) == eslOK)
     {
-      /* Main loop: */
-      for (i = 0; i < block->count; ++i)
-	{
-	  ESL_SQ *dbsq = block->list + i;
+      block = (ESL_SQ_BLOCK *) r.blk;
 
-	  p7_pli_NewSeq(info->pli, dbsq);
-	  p7_bg_SetLength(info->bg, dbsq->n);
-	  p7_oprofile_ReconfigLength(info->om, dbsq->n);
-	  
-	  p7_Pipeline(info->pli, info->om, info->bg, dbsq, NULL, info->th);
-	  
-	  esl_sq_Reuse(dbsq);
-	  p7_pipeline_Reuse(info->pli);
+      /* The targets through the pipeline of each query, a filter stage at a time; the block stays in cache */
+      for (q = 0; q < info->nq; q++)
+	{
+	  status = p7_Pipeline_Block(info->pli[q], info->om[q], info->bg[q], block->list + r.lo, r.hi - r.lo, info->th[q]);
+	  if (status != eslOK && status != eslERANGE) p7_Fail("Search pipeline failed on a block of targets");
 	}
 
-      status = esl_workqueue_WorkerUpdate(info->queue, block, &newBlock);
-      if (status != eslOK) esl_fatal("Work queue worker failed");
-
-      block = (ESL_SQ_BLOCK *) newBlock;
+      if (info->seqdb == NULL)	/* views into a P7_SEQDB own nothing to reuse */
+	for (i = r.lo; i < r.hi; ++i)
+	  esl_sq_Reuse(block->list + i);
     }
-
-  status = esl_workqueue_WorkerUpdate(info->queue, block, NULL);
-  if (status != eslOK) esl_fatal("Work queue worker failed");
+  if (status != eslEOD) esl_fatal("Scheduler worker failed");
 
   esl_threads_Finished(obj, workeridx);
   return;
@@ -11,10 +11,17 @@
 #include "esl_getopts.h"
 
 #include "hmmer.h"
+#ifdef HMMER_THREADS
+#include "esl_threads.h"
+#include "p7_hmmreader.h"
+#endif
 
 static ESL_OPTIONS options[] = {
   /* name           type       default   env  range    toggles    reqs       incomp  help   docgroup*/
   { "-h",        eslARG_NONE,    FALSE,  NULL, NULL,    NULL,  NULL,           NULL, "show brief help on version and usage",            0 },
+#ifdef HMMER_THREADS
+  { "--cpu",     eslARG_INT,   p7_NCPU,"HMMER_NCPU","n>=0",NULL, NULL,           NULL, "number of parallel CPU workers parsing <hmmfile>", 0 },
+#endif
   {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
 
@@ -36,6 +43,10 @@ main(int argc, char **argv)
   float            KL;
   char             errbuf[eslERRBUFSIZE];
   int              status;
+#ifdef HMMER_THREADS
+  P7_HMMREADER    *rdr     = NULL;
+  int              ncpus;
+#endif
 
   /* Process command line
    */
@@ -83,6 +94,19 @@ main(int argc, char **argv)
   else if (status != eslOK)        p7_Fail("Unexpected error %d in opening HMM file %s.\n%s\n",               status, hmmfile, errbuf);  
 
 
+  /* With threads, parse the models in parallel if the file can be split;
+   * else (stdin, .gz, --cpu 0) read them one at a time.
+   */
+#ifdef HMMER_THREADS
+  ncpus = ESL_MIN( esl_opt_GetInteger(go, "--cpu"), esl_threads_GetCPUCount());
+  if (ncpus > 0)
+    {
+      status = p7_hmmreader_Open(hfp, &abc, ncpus, p7_HMMREADER_HMMS, 0, &rdr);
+      if      (status == eslEFORMAT) esl_fatal("bad file format in HMM file %s", hmmfile);
+      else if (status != eslOK && status != eslEINCOMPAT && status != eslEOF) esl_fatal("Unexpected error %d in opening parallel reader for %s", status, hmmfile);
+    }
+#endif
+
   /* Output header 
    */
   printf("#\n");
@@ -93,9 +117,16 @@ main(int argc, char **argv)
   /* Main body: read HMMs one at a time, print one line of stats per profile
    */
   nhmm = 0;
-  while ((status = p7_hmmfile_Read(hfp, &abc, &hmm)) != eslEOF) 
+  for (;;)
     {
-      if      (status == eslEOD)       esl_fatal("read failed, HMM file %s may be truncated?", hmmfile);
+#ifdef HMMER_THREADS
+      if (rdr) status = p7_hmmreader_Read(rdr, &hmm, NULL);
+      else
+#endif
+      status = p7_hmmfile_Read(hfp, &abc, &hmm);
+
+      if      (status == eslEOF)       break;
+      else if (status == eslEOD)       esl_fatal("read failed, HMM file %s may be truncated?", hmmfile);
       else if (status == eslEFORMAT)   esl_fatal("bad file format in HMM file %s",             hmmfile);
       else if (status == eslEINCOMPAT) esl_fatal("HMM file %s contains different alphabets",   hmmfile);
       else if (status != eslOK)        esl_fatal("Unexpected error in reading HMMs from %s",   hmmfile);
@@ -121,6 +152,9 @@ main(int argc, char **argv)
       p7_hmm_Destroy(hmm);
     }
 
+#ifdef HMMER_THREADS
+  p7_hmmreader_Close(rdr);
+#endif
   p7_bg_Destroy(bg);
   esl_alphabet_Destroy(abc);
   p7_hmmfile_Close(hfp);
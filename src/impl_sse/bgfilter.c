@@ -0,0 +1,272 @@
+/* Bias filter scores of one target against many models, 4-way SSE.
+ *
+ * The bias filter (p7_bg_FilterScore()) is a Forward score of the
+ * two-state filter HMM that p7_bg_SetFilter() builds from a model's
+ * mean residue composition. In scan mode it runs once per model that
+ * passes the MSV filter, over the same query each time. Here each of
+ * the four float lanes holds a different model's filter HMM, so the
+ * query is walked once per four models: for each residue x_i a
+ * single vector load from each of two [x][lane] tables gives all four
+ * models' emission odds.
+ *
+ * The recursion, in probability space, is the one
+ * p7_bg_FilterScore() uses:
+ *     a(i) = (a(i-1) t00 + b(i-1) t10) e0(x_i)
+ *     b(i) = (a(i-1) t01 + b(i-1) t11) e1(x_i)
+ * with a(1) = pi0 e0(x_1), b(1) = pi1 e1(x_1). The two states'
+ * values can't grow or shrink much in a few rows, so every eighth row
+ * all four lanes are normalized by max(a,b), and the logs of the
+ * scale factors are summed with esl_sse_logf().
+ *
+ * Contents:
+ *   1. p7_FilterScoreModels() implementation
+ *   2. Unit tests
+ *   3. Test driver
+ */
+#include "p7_config.h"
+
+#include <math.h>
+
+#include <xmmintrin.h>		/* SSE  */
+#include <emmintrin.h>		/* SSE2 */
+
+#include "easel.h"
+#include "esl_hmm.h"
+#include "esl_sse.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+
+/*****************************************************************
+ * 1. p7_FilterScoreModels() implementation
+ *****************************************************************/
+
+/* Function:  p7_FilterScoreModels()
+ * Synopsis:  Bias filter scores of one target for many models.
+ *
+ * Purpose:   For target <dsq> of length <L>, calculate the bias
+ *            filter score that <p7_bg_FilterScore()> would give
+ *            after <p7_bg_SetFilter(bg, om->M, om->compo)> and
+ *            <p7_bg_SetLength(bg, L)>, for each of the <n> models
+ *            <om = oml[idx[0..n-1]]>, and put it in <fsc[0..n-1]>.
+ *            Four models are scored per pass over <dsq>.
+ *
+ *            Only <om->M> and <om->compo> are used, so the models
+ *            need only have been read as far as the MSV filter
+ *            parts.
+ *
+ *            <bg> is used to build each model's filter HMM, so on
+ *            return its filter HMM is the one for the last model,
+ *            and its length is set to <L>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_FilterScoreModels(P7_BG *bg, const ESL_DSQ *dsq, int L, P7_OPROFILE **oml, const int64_t *idx, int n, float *fsc)
+{
+  ESL_HMM *hmm     = bg->fhmm;
+  int      Kp      = bg->abc->Kp;
+  float   *o0      = NULL;	/* [x*4+j] state 0 emission odds of residue x, model j */
+  float   *o1      = NULL;	/* [x*4+j] state 1 emission odds */
+  float    pi0[4], pi1[4], t10[4], t11[4], t0E[4], t1E[4];
+  float    lenterm;
+  __m128   t00v, t01v, t10v, t11v;
+  __m128   av, bv, nav, maxv, logv;
+  union { __m128 v; float x[4]; } u;
+  int      s, j, x, i;
+  int      status;
+
+  if (L == 0)
+    {			/* nothing to vectorize */
+      for (j = 0; j < n; j++)
+	{
+	  p7_bg_SetFilter(bg, oml[idx[j]]->M, oml[idx[j]]->compo);
+	  p7_bg_SetLength(bg, L);
+	  p7_bg_FilterScore(bg, dsq, L, &(fsc[j]));
+	}
+      return eslOK;
+    }
+
+  ESL_ALLOC(o0, sizeof(float) * Kp * 4);
+  ESL_ALLOC(o1, sizeof(float) * Kp * 4);
+
+  p7_bg_SetLength(bg, L);
+  t00v    = _mm_set1_ps(bg->p1);
+  t01v    = _mm_set1_ps(1.0f - bg->p1);
+  lenterm = (float) L * logf(bg->p1) + logf(1.-bg->p1);
+
+  for (s = 0; s < n; s += 4)
+    {
+      /* Each lane's filter HMM; an unused lane repeats the last model */
+      for (j = 0; j < 4; j++)
+	{
+	  if (s+j < n) p7_bg_SetFilter(bg, oml[idx[s+j]]->M, oml[idx[s+j]]->compo);
+	  for (x = 0; x < Kp; x++)
+	    {
+	      o0[x*4+j] = hmm->eo[x][0];
+	      o1[x*4+j] = hmm->eo[x][1];
+	    }
+	  pi0[j] = hmm->pi[0];   pi1[j] = hmm->pi[1];
+	  t10[j] = hmm->t[1][0]; t11[j] = hmm->t[1][1];
+	  t0E[j] = hmm->t[0][2]; t1E[j] = hmm->t[1][2];
+	}
+      t10v = _mm_loadu_ps(t10);
+      t11v = _mm_loadu_ps(t11);
+
+      av   = _mm_mul_ps(_mm_loadu_ps(pi0), _mm_loadu_ps(o0 + dsq[1]*4));
+      bv   = _mm_mul_ps(_mm_loadu_ps(pi1), _mm_loadu_ps(o1 + dsq[1]*4));
+      logv = _mm_setzero_ps();
+      for (i = 2; i <= L; i++)
+	{
+	  nav = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(av, t00v), _mm_mul_ps(bv, t10v)), _mm_loadu_ps(o0 + dsq[i]*4));
+	  bv  = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(av, t01v), _mm_mul_ps(bv, t11v)), _mm_loadu_ps(o1 + dsq[i]*4));
+	  av  = nav;
+
+	  if ((i & 7) == 0)
+	    {
+	      maxv = _mm_max_ps(av, bv);
+	      av   = _mm_div_ps(av, maxv);
+	      bv   = _mm_div_ps(bv, maxv);
+	      logv = _mm_add_ps(logv, esl_sse_logf(maxv));
+	    }
+	}
+      av  = _mm_mul_ps(av, _mm_loadu_ps(t0E));
+      bv  = _mm_mul_ps(bv, _mm_loadu_ps(t1E));
+      u.v = _mm_add_ps(logv, esl_sse_logf(_mm_add_ps(av, bv)));
+
+      for (j = 0; j < 4 && s+j < n; j++)
+	fsc[s+j] = u.x[j] + lenterm;
+    }
+
+  p7_bg_SetLength(bg, L);	/* SetFilter() reset t00, t01 */
+  free(o0);
+  free(o1);
+  return eslOK;
+
+ ERROR:
+  if (o0) free(o0);
+  if (o1) free(o1);
+  return status;
+}
+/*------------- end, p7_FilterScoreModels() ---------------------*/
+
+
+
+/*****************************************************************
+ * 2. Unit tests
+ *****************************************************************/
+#ifdef p7BGFILTER_TESTDRIVE
+#include "esl_random.h"
+#include "esl_randomseq.h"
+#include "esl_vectorops.h"
+
+/* utest_compare()
+ *
+ * p7_FilterScoreModels() against p7_bg_FilterScore(), one model at a
+ * time, for <N> random models of length 1..<M> (not a multiple of
+ * four, so the last vector has unused lanes) on an iid target of
+ * length <L>.
+ */
+static void
+utest_compare(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  char          msg[] = "bgfilter compare unit test failed";
+  P7_HMM       *hmm   = NULL;
+  P7_PROFILE   *gm    = NULL;
+  P7_OPROFILE **oml   = malloc(sizeof(P7_OPROFILE *) * N);
+  int64_t      *idx   = malloc(sizeof(int64_t)       * N);
+  float        *fsc   = malloc(sizeof(float)         * N);
+  ESL_DSQ      *dsq   = malloc(sizeof(ESL_DSQ)       * (L+2));
+  float         sc1;
+  int           n;
+
+  for (n = 0; n < N; n++)
+    {
+      if (p7_oprofile_Sample(r, abc, bg, 1 + esl_rnd_Roll(r, M), L, &hmm, &gm, &(oml[n])) != eslOK) esl_fatal(msg);
+      if (p7_hmm_SetComposition(hmm) != eslOK) esl_fatal(msg); /* sampled models don't have one */
+      esl_vec_FCopy(hmm->compo, abc->K, oml[n]->compo);
+      p7_hmm_Destroy(hmm);
+      p7_profile_Destroy(gm);
+      idx[n] = N-1-n;		/* any order */
+    }
+  esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+
+  if (p7_FilterScoreModels(bg, dsq, L, oml, idx, N, fsc) != eslOK) esl_fatal(msg);
+
+  for (n = 0; n < N; n++)
+    {
+      p7_bg_SetFilter(bg, oml[idx[n]]->M, oml[idx[n]]->compo);
+      p7_bg_SetLength(bg, L);
+      p7_bg_FilterScore(bg, dsq, L, &sc1);
+      if (fabs(sc1 - fsc[n]) > 0.001 * (1. + fabs(sc1))) esl_fatal("%s: model %d: score %f != %f", msg, n, fsc[n], sc1);
+    }
+
+  for (n = 0; n < N; n++) p7_oprofile_Destroy(oml[n]);
+  free(oml);
+  free(idx);
+  free(fsc);
+  free(dsq);
+}
+#endif /*p7BGFILTER_TESTDRIVE*/
+/*-------------------- end, unit tests --------------------------*/
+
+
+
+/*****************************************************************
+ * 3. Test driver
+ *****************************************************************/
+#ifdef p7BGFILTER_TESTDRIVE
+/*
+   gcc -g -Wall -msse2 -std=gnu99 -I.. -L.. -I../../easel -L../../easel -o bgfilter_utest -Dp7BGFILTER_TESTDRIVE bgfilter.c -lhmmer -leasel -lm
+   ./bgfilter_utest
+ */
+#include "p7_config.h"
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",           0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                  0 },
+  { "-L",        eslARG_INT,    "400", NULL, NULL,  NULL,  NULL, NULL, "size of random sequences to sample",             0 },
+  { "-M",        eslARG_INT,    "145", NULL, NULL,  NULL,  NULL, NULL, "maximum size of random models to sample",        0 },
+  { "-N",        eslARG_INT,     "13", NULL, NULL,  NULL,  NULL, NULL, "number of random models to sample",              0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for SSE bias filter scores";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go   = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *r    = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *abc  = NULL;
+  P7_BG          *bg   = NULL;
+  int             M    = esl_opt_GetInteger(go, "-M");
+  int             L    = esl_opt_GetInteger(go, "-L");
+  int             N    = esl_opt_GetInteger(go, "-N");
+
+  if ((abc = esl_alphabet_Create(eslAMINO)) == NULL)  esl_fatal("failed to create alphabet");
+  if ((bg = p7_bg_Create(abc))              == NULL)  esl_fatal("failed to create null model");
+
+  utest_compare(r, abc, bg, M,  L, N);
+  utest_compare(r, abc, bg, M,  1, 5);	/* size 1 sequences    */
+  utest_compare(r, abc, bg, M, 10, 4);	/* no rescaling        */
+
+  esl_alphabet_Destroy(abc);
+  p7_bg_Destroy(bg);
+  esl_getopts_Destroy(go);
+  esl_randomness_Destroy(r);
+  return eslOK;
+}
+#endif /*p7BGFILTER_TESTDRIVE*/
+/*---------------------- end, test driver -----------------------*/
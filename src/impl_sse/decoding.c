@@ -136,6 +136,89 @@ p7_Decoding(const P7_OPROFILE *om, const P7_OMX *oxf, P7_OMX *oxb, P7_OMX *pp)
   else                     return eslOK;
 }
 
+/* Function:  p7_DecodingSegment()
+ * Synopsis:  Posterior decoding of one segment of checkpointed matrices.
+ *
+ * Purpose:   Same as <p7_Decoding()>, but only for rows <a>+1..<b>:
+ *            calculate the posterior probabilities in rows
+ *            <a>+1..<b> of <pp> from rows <a>+1..<b> of the Forward
+ *            and Backward matrices <oxf> and <oxb>, and from their
+ *            specials. Used on checkpointed matrices (see
+ *            <p7_omx_GrowToCheckpointed()>), after the caller
+ *            recalculated that segment of <oxf> and <oxb> with
+ *            <p7_ForwardSegment()> and <p7_BackwardSegment()>.
+ *
+ *            <pp> can't be the same matrix as <oxb>, since the
+ *            Backward checkpoints are still needed for the next
+ *            segment. Decoding every segment gives values identical
+ *            to <p7_Decoding()>'s. Row 0 of <pp> is not touched.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ *            <eslERANGE> on numeric overflow; see <p7_Decoding()>.
+ *
+ * Throws:    (no abnormal error conditions)
+ */
+int
+p7_DecodingSegment(const P7_OPROFILE *om, const P7_OMX *oxf, const P7_OMX *oxb, P7_OMX *pp, int a, int b)
+{
+  __m128 *ppv;
+  __m128 *fv;
+  __m128 *bv;
+  __m128  totrv;
+  int    L  = oxf->L;
+  int    M  = om->M;
+  int    Q  = p7O_NQF(M);	
+  int    i,q;
+  float  scaleproduct = 1.0 / oxb->xmx[p7X_N];
+
+  pp->M = M;
+  pp->L = L;
+
+  /* With its own scale factors, <oxb>'s row scales differ from
+   * <oxf>'s, and the product of their ratios up to row <a> has to be
+   * carried in, multiplied in the same order as p7_Decoding() does. 
+   */
+  if (oxb->has_own_scales)
+    for (i = 1; i <= a; i++)
+      scaleproduct *= oxf->xmx[i*p7X_NXCELLS+p7X_SCALE] /  oxb->xmx[i*p7X_NXCELLS+p7X_SCALE];
+
+  for (i = a+1; i <= b; i++)
+    {
+      ppv   =  pp->dpf[i];
+      fv    = oxf->dpf[i];
+      bv    = oxb->dpf[i];
+      totrv = _mm_set1_ps(scaleproduct * oxf->xmx[i*p7X_NXCELLS+p7X_SCALE]);
+
+      for (q = 0; q < Q; q++)
+	{
+	  /* M */
+	  *ppv = _mm_mul_ps(*fv,  *bv);
+	  *ppv = _mm_mul_ps(*ppv,  totrv);
+	  ppv++;  fv++;  bv++;
+
+	  /* D */
+	  *ppv = _mm_setzero_ps();
+	  ppv++;  fv++;  bv++;
+
+	  /* I */
+	  *ppv = _mm_mul_ps(*fv,  *bv);
+	  *ppv = _mm_mul_ps(*ppv,  totrv);
+	  ppv++;  fv++;  bv++;
+	}
+      pp->xmx[i*p7X_NXCELLS+p7X_E] = 0.0;
+      pp->xmx[i*p7X_NXCELLS+p7X_N] = oxf->xmx[(i-1)*p7X_NXCELLS+p7X_N] * oxb->xmx[i*p7X_NXCELLS+p7X_N] * om->xf[p7O_N][p7O_LOOP] * scaleproduct;
+      pp->xmx[i*p7X_NXCELLS+p7X_J] = oxf->xmx[(i-1)*p7X_NXCELLS+p7X_J] * oxb->xmx[i*p7X_NXCELLS+p7X_J] * om->xf[p7O_J][p7O_LOOP] * scaleproduct;
+      pp->xmx[i*p7X_NXCELLS+p7X_C] = oxf->xmx[(i-1)*p7X_NXCELLS+p7X_C] * oxb->xmx[i*p7X_NXCELLS+p7X_C] * om->xf[p7O_C][p7O_LOOP] * scaleproduct;
+      pp->xmx[i*p7X_NXCELLS+p7X_B] = 0.0;
+
+      if (oxb->has_own_scales) scaleproduct *= oxf->xmx[i*p7X_NXCELLS+p7X_SCALE] /  oxb->xmx[i*p7X_NXCELLS+p7X_SCALE];
+    }
+
+  if (isinf(scaleproduct)) return eslERANGE;
+  else                     return eslOK;
+}
+
 /* Function:  p7_DomainDecoding()
  * Synopsis:  Posterior decoding of domain location.
  * Incept:    SRE, Tue Aug  5 08:39:07 2008 [Janelia]
@@ -0,0 +1,618 @@
+/* Runtime selection of SSE, AVX2, AVX-512 kernels.
+ *
+ * The AVX2 and AVX-512 kernels are compiled (when ./configure finds a
+ * compiler that can) into the same library as the SSE ones, each in
+ * its own file with its own ISA flags. Which of them runs is decided
+ * once, at startup, from what the processor says it supports
+ * (cpuid), and recorded in a table of function pointers that the
+ * public entry points (p7_MSVFilter(), etc.) call through. So one
+ * binary runs on any x86-64 processor and uses the widest kernels it
+ * can.
+ *
+ * The choice can be overridden by setting the environment variable
+ * HMMER_FORCE_ISA to "sse", "avx2" or "avx512", for example to
+ * benchmark each path on the same machine.
+ *
+ * The dispatch level also determines which striped score layouts
+ * p7_oprofile_Create() allocates and keeps up to date in a new
+ * profile (<om->layout>). Each wide kernel checks that the profile
+ * it's given carries its layout.
+ *
+ * Contents:
+ *   1. Selecting kernels.
+ *   2. Dispatched API.
+ *   3. Unit tests.
+ *   4. Test driver.
+ */
+#include "p7_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef HMMER_THREADS
+#include <pthread.h>
+#endif
+
+#include "easel.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+
+/*****************************************************************
+ * 1. Selecting kernels.
+ *****************************************************************/
+
+static struct {
+  int isa;		/* selected level: p7_ISA_SSE | p7_ISA_AVX | p7_ISA_AVX512; 0 = not yet initialized */
+  int avail;		/* flags for ISAs both compiled in and supported by this processor                 */
+  int layout;		/* flags for the score layouts profiles need for the selected kernels                */
+
+  int (*msv)(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
+  int (*ssv)(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, float *ret_sc);
+  int (*ssvis)(const ESL_DSQ **dsq, const int *L, int nseq, const P7_OPROFILE *om, P7_OMX *ox, uint8_t *xE);
+  int (*vit)(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
+  int (*fwdparser)(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *fwd, float *opt_sc);
+  int (*bckparser)(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc);
+} dispatch = { 0, 0, 0, NULL, NULL, NULL, NULL, NULL, NULL };
+
+#ifdef HMMER_THREADS
+static pthread_once_t dispatch_once = PTHREAD_ONCE_INIT;
+#endif
+
+
+/* cpu_available()
+ * Return flags for the instruction sets that we have kernels
+ * compiled for, and that this processor (and OS) supports.
+ * __builtin_cpu_supports() reads cpuid, and for AVX and AVX-512
+ * also checks that the OS saves the wide registers (xgetbv).
+ */
+static int
+cpu_available(void)
+{
+  int avail = p7_ISA_SSE;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+#ifdef eslENABLE_AVX
+  if (__builtin_cpu_supports("avx2"))    avail |= p7_ISA_AVX;
+#endif
+#ifdef eslENABLE_AVX512
+  if (__builtin_cpu_supports("avx512f")) avail |= p7_ISA_AVX512;
+#endif
+#endif
+  return avail;
+}
+
+
+/* set_level()
+ * Fill the function table for dispatch level <isa>: each function
+ * gets the widest available kernel that isn't above <isa>.
+ */
+static void
+set_level(int isa)
+{
+  dispatch.isa       = isa;
+  dispatch.layout    = p7_ISA_SSE;
+  dispatch.msv       = p7_MSVFilter_sse;
+  dispatch.ssv       = p7_SSVFilter_sse;
+  dispatch.ssvis     = p7_SSVInterseq_sse;
+  dispatch.vit       = p7_ViterbiFilter_sse;
+  dispatch.fwdparser = p7_ForwardParser_sse;
+  dispatch.bckparser = p7_BackwardParser_sse;
+
+#ifdef eslENABLE_AVX
+  if (isa >= p7_ISA_AVX && (dispatch.avail & p7_ISA_AVX))
+    {
+      dispatch.layout |= p7_ISA_AVX;
+      dispatch.msv     = p7_MSVFilter_avx;
+      dispatch.ssv     = p7_SSVFilter_avx;
+      dispatch.ssvis   = p7_SSVInterseq_avx;
+      dispatch.vit     = p7_ViterbiFilter_avx;
+    }
+#endif
+#ifdef eslENABLE_AVX512
+  if (isa >= p7_ISA_AVX512 && (dispatch.avail & p7_ISA_AVX512))
+    {
+      dispatch.layout   |= p7_ISA_AVX512;
+      dispatch.fwdparser = p7_ForwardParser_avx512;
+      dispatch.bckparser = p7_BackwardParser_avx512;
+    }
+#endif
+}
+
+
+static void
+dispatch_init(void)
+{
+  char *s   = getenv("HMMER_FORCE_ISA");
+  int   isa;
+
+  dispatch.avail = cpu_available();
+
+  if (s != NULL && *s != '\0')
+    {
+      if ((isa = p7_dispatch_EncodeISA(s)) == 0)
+	p7_Fail("HMMER_FORCE_ISA=%s not recognized; use sse, avx2, or avx512\n", s);
+      if (! (dispatch.avail & isa))
+	p7_Fail("HMMER_FORCE_ISA=%s, but %s kernels are not compiled in or not supported by this processor\n", s, p7_dispatch_DecodeISA(isa));
+    }
+  else if (dispatch.avail & p7_ISA_AVX512) isa = p7_ISA_AVX512;
+  else if (dispatch.avail & p7_ISA_AVX)    isa = p7_ISA_AVX;
+  else                                     isa = p7_ISA_SSE;
+
+  set_level(isa);
+}
+
+
+/* Function:  p7_dispatch_Init()
+ * Synopsis:  Select the kernels to use on this processor.
+ *
+ * Purpose:   Fill the dispatch table from cpuid and the
+ *            <HMMER_FORCE_ISA> environment variable. Only the first
+ *            call does anything; it is called by <impl_Init()> at
+ *            program startup, and by every dispatched function, so
+ *            callers never need to call it themselves.
+ *
+ *            Thread-safe.
+ *
+ * Returns:   <eslOK>.
+ *
+ * Throws:    (no abnormal error conditions)
+ *
+ *            Exits via <p7_Fail()> if <HMMER_FORCE_ISA> names an
+ *            instruction set that isn't recognized, or that isn't
+ *            compiled in or supported by this processor.
+ */
+int
+p7_dispatch_Init(void)
+{
+#ifdef HMMER_THREADS
+  pthread_once(&dispatch_once, dispatch_init);
+#else
+  if (! dispatch.isa) dispatch_init();
+#endif
+  return eslOK;
+}
+
+
+/* Function:  p7_dispatch_Select()
+ * Synopsis:  Force the kernels to a given instruction set.
+ *
+ * Purpose:   Set the dispatch level to <isa> (<p7_ISA_SSE>,
+ *            <p7_ISA_AVX>, or <p7_ISA_AVX512>), overriding the
+ *            automatic choice. Used by test and benchmark drivers;
+ *            it must be called before any profiles are created,
+ *            because profiles only carry the score layouts for the
+ *            level that was in effect when they were created.
+ *
+ *            Not thread-safe.
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslENORESULT> if kernels for <isa> are not compiled in,
+ *            or not supported by this processor; the level is
+ *            unchanged.
+ */
+int
+p7_dispatch_Select(int isa)
+{
+  p7_dispatch_Init();
+  if (! (dispatch.avail & isa)) return eslENORESULT;
+  set_level(isa);
+  return eslOK;
+}
+
+
+/* Function:  p7_dispatch_GetISA()
+ * Synopsis:  Return the selected instruction set.
+ */
+int
+p7_dispatch_GetISA(void)
+{
+  p7_dispatch_Init();
+  return dispatch.isa;
+}
+
+
+/* Function:  p7_dispatch_GetLayout()
+ * Synopsis:  Return the score layouts the selected kernels need.
+ *
+ * Purpose:   Return the <p7_ISA_*> flags for the striped score
+ *            layouts that the selected kernels use. <p7_ISA_SSE> is
+ *            always set: the full-matrix DP routines are SSE only.
+ */
+int
+p7_dispatch_GetLayout(void)
+{
+  p7_dispatch_Init();
+  return dispatch.layout;
+}
+
+
+/* Function:  p7_dispatch_EncodeISA()
+ * Synopsis:  Convert an instruction set name to a <p7_ISA_*> flag.
+ *
+ * Returns:   <p7_ISA_SSE>, <p7_ISA_AVX>, or <p7_ISA_AVX512> for
+ *            "sse", "avx2" (or "avx"), "avx512"; 0 if the name isn't
+ *            recognized.
+ */
+int
+p7_dispatch_EncodeISA(const char *s)
+{
+  if      (strcmp(s, "sse")    == 0) return p7_ISA_SSE;
+  else if (strcmp(s, "avx2")   == 0) return p7_ISA_AVX;
+  else if (strcmp(s, "avx")    == 0) return p7_ISA_AVX;
+  else if (strcmp(s, "avx512") == 0) return p7_ISA_AVX512;
+  return 0;
+}
+
+
+/* Function:  p7_dispatch_DecodeISA()
+ * Synopsis:  Return a printable name for a <p7_ISA_*> flag.
+ */
+const char *
+p7_dispatch_DecodeISA(int isa)
+{
+  switch (isa) {
+  case p7_ISA_SSE:    return "SSE";
+  case p7_ISA_AVX:    return "AVX2";
+  case p7_ISA_AVX512: return "AVX-512";
+  }
+  return "unknown";
+}
+/*----------------- end, selecting kernels ----------------------*/
+
+
+
+/*****************************************************************
+ * 2. Dispatched API.
+ *****************************************************************/
+
+/* Function:  p7_MSVFilter()
+ * Synopsis:  Calculates MSV score, vewy vewy fast, in limited precision.
+ *
+ * Purpose:   Calculates an approximation of the MSV score for sequence
+ *            <dsq> of length <L> residues, using optimized profile <om>,
+ *            and a preallocated one-row DP matrix <ox>, with the
+ *            selected kernel: <p7_MSVFilter_avx()> or
+ *            <p7_MSVFilter_sse()>. Both give identical results.
+ *
+ * Args:      (see p7_MSVFilter_sse())
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslERANGE> if the score overflows the limited range; in
+ *            this case, this is a high-scoring hit.
+ *
+ * Throws:    <eslEINVAL> if <ox> allocation is too small, or if <om>
+ *            doesn't carry the score layout for the selected kernel.
+ */
+int
+p7_MSVFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc)
+{
+  p7_dispatch_Init();
+  return (*dispatch.msv)(dsq, L, om, ox, ret_sc);
+}
+
+
+/* Function:  p7_SSVFilter()
+ * Synopsis:  Calculates SSV score with the selected kernel.
+ *
+ * Purpose:   Calls <p7_SSVFilter_avx()> or <p7_SSVFilter_sse()>. Both
+ *            give identical results.
+ */
+int
+p7_SSVFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, float *ret_sc)
+{
+  p7_dispatch_Init();
+  return (*dispatch.ssv)(dsq, L, om, ret_sc);
+}
+
+
+/* Function:  p7_SSVInterseq()
+ * Synopsis:  Inter-sequence SSV with the selected kernel.
+ *
+ * Purpose:   Calls <p7_SSVInterseq_avx()> (32 sequences per vector)
+ *            or <p7_SSVInterseq_sse()> (16 per vector). Both give
+ *            identical results. Used by <p7_MSVFilterInterseq()>.
+ */
+int
+p7_SSVInterseq(const ESL_DSQ **dsq, const int *L, int nseq, const P7_OPROFILE *om, P7_OMX *ox, uint8_t *xE)
+{
+  p7_dispatch_Init();
+  return (*dispatch.ssvis)(dsq, L, nseq, om, ox, xE);
+}
+
+
+/* Function:  p7_ViterbiFilter()
+ * Synopsis:  Calculates Viterbi score, vewy vewy fast, in limited precision.
+ *
+ * Purpose:   Calculates an approximation of the Viterbi score for
+ *            sequence <dsq> of length <L> residues, using optimized
+ *            profile <om> and a preallocated one-row DP matrix <ox>,
+ *            with the selected kernel: <p7_ViterbiFilter_avx()> or
+ *            <p7_ViterbiFilter_sse()>. Both give identical results.
+ *
+ * Args:      (see p7_ViterbiFilter_sse())
+ *
+ * Returns:   <eslOK> on success;
+ *            <eslERANGE> if the score overflows; in this case
+ *            <*ret_sc> is <eslINFINITY>, and the sequence can
+ *            be treated as a high-scoring hit.
+ *
+ * Throws:    <eslEINVAL> if <ox> allocation is too small, if
+ *            profile isn't in a local alignment mode, or if <om>
+ *            doesn't carry the score layout for the selected kernel.
+ */
+int
+p7_ViterbiFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc)
+{
+  p7_dispatch_Init();
+  return (*dispatch.vit)(dsq, L, om, ox, ret_sc);
+}
+
+
+/* Function:  p7_ForwardParser()
+ * Synopsis:  The Forward algorithm, linear memory parsing version.
+ *
+ * Purpose:   Calculates the Forward score of <dsq> against <om> in
+ *            parsing mode, keeping only the special (BENCJ) state
+ *            values in <ox>, with the selected kernel:
+ *            <p7_ForwardParser_avx512()> or <p7_ForwardParser_sse()>.
+ *            The two differ only by float roundoff, because they sum
+ *            in a different order.
+ *
+ * Args:      (see p7_ForwardParser_sse())
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <ox> allocation is too small, if the profile
+ *            isn't in local alignment mode, or if <om> doesn't carry
+ *            the score layout for the selected kernel.
+ *            <eslERANGE> if the score exceeds the limited range of
+ *            a probability-space odds ratio.
+ *            In either case, <*opt_sc> is undefined.
+ */
+int
+p7_ForwardParser(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *opt_sc)
+{
+  p7_dispatch_Init();
+  return (*dispatch.fwdparser)(dsq, L, om, ox, opt_sc);
+}
+
+
+/* Function:  p7_BackwardParser()
+ * Synopsis:  The Backward algorithm, linear memory parsing version.
+ *
+ * Purpose:   Calculates the Backward score of <dsq> against <om> in
+ *            parsing mode, using the sparse scale factors in the
+ *            Forward parsing matrix <fwd>, with the selected kernel:
+ *            <p7_BackwardParser_avx512()> or <p7_BackwardParser_sse()>.
+ *
+ * Args:      (see p7_BackwardParser_sse())
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <bck> allocation is too small, if the profile
+ *            isn't in local alignment mode, or if <om> doesn't carry
+ *            the score layout for the selected kernel.
+ *            <eslERANGE> if the score exceeds the limited range of
+ *            a probability-space odds ratio.
+ *            In either case, <*opt_sc> is undefined.
+ */
+int
+p7_BackwardParser(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc)
+{
+  p7_dispatch_Init();
+  return (*dispatch.bckparser)(dsq, L, om, fwd, bck, opt_sc);
+}
+/*------------------ end, dispatched API ------------------------*/
+
+
+
+/*****************************************************************
+ * 3. Unit tests.
+ *****************************************************************/
+#ifdef p7DISPATCH_TESTDRIVE
+#include "esl_randomseq.h"
+
+/* utest_levels()
+ *
+ * For each available dispatch level: profiles created at that level
+ * carry its layout, the dispatched filters give the same results as
+ * the SSE kernels, and the parsers agree with SSE within roundoff.
+ */
+static void
+utest_levels(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  char         msg[] = "dispatch levels unit test failed";
+  int          isa[3] = { p7_ISA_SSE, p7_ISA_AVX, p7_ISA_AVX512 };
+  P7_HMM      *hmm   = NULL;
+  P7_PROFILE  *gm    = NULL;
+  P7_OPROFILE *om    = NULL;
+  ESL_DSQ     *dsq   = malloc(sizeof(ESL_DSQ) * (L+2));
+  P7_OMX      *ox    = p7_omx_Create(M, 0, L);
+  P7_OMX      *bck   = p7_omx_Create(M, 0, L);
+  float        sc1, sc2;
+  int          st1, st2;
+  int          i, n;
+
+  for (i = 0; i < 3; i++)
+    {
+      if (p7_dispatch_Select(isa[i]) != eslOK) continue;
+      if (p7_dispatch_GetISA() != isa[i])      esl_fatal(msg);
+
+      if (p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om) != eslOK) esl_fatal(msg);
+      if (om->layout != p7_dispatch_GetLayout())                         esl_fatal(msg);
+      if (! (om->layout & p7_ISA_SSE))                                   esl_fatal(msg);
+
+      for (n = 0; n < N; n++)
+	{
+	  esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+
+	  st1 = p7_MSVFilter    (dsq, L, om, ox, &sc1);
+	  st2 = p7_MSVFilter_sse(dsq, L, om, ox, &sc2);
+	  if (st1 != st2 || sc1 != sc2) esl_fatal("%s: MSV %s", msg, p7_dispatch_DecodeISA(isa[i]));
+
+	  st1 = p7_ViterbiFilter    (dsq, L, om, ox, &sc1);
+	  st2 = p7_ViterbiFilter_sse(dsq, L, om, ox, &sc2);
+	  if (st1 != st2 || sc1 != sc2) esl_fatal("%s: Viterbi %s", msg, p7_dispatch_DecodeISA(isa[i]));
+
+	  if (p7_ForwardParser (dsq, L, om, ox,      &sc1) != eslOK) esl_fatal(msg);
+	  if (p7_BackwardParser(dsq, L, om, ox, bck, &sc2) != eslOK) esl_fatal(msg);
+	  if (fabs(sc1-sc2) > 0.0001) esl_fatal("%s: Fwd/Bck %s", msg, p7_dispatch_DecodeISA(isa[i]));
+	  if (p7_ForwardParser_sse(dsq, L, om, ox,   &sc2) != eslOK) esl_fatal(msg);
+	  if (fabs(sc1-sc2) > 0.001)  esl_fatal("%s: Fwd vs SSE %s", msg, p7_dispatch_DecodeISA(isa[i]));
+	}
+
+      p7_hmm_Destroy(hmm);
+      p7_profile_Destroy(gm);
+      p7_oprofile_Destroy(om);
+    }
+
+  free(dsq);
+  p7_omx_Destroy(ox);
+  p7_omx_Destroy(bck);
+}
+
+/* utest_forced()
+ *
+ * With HMMER_FORCE_ISA set to <isaname> before anything is
+ * dispatched, the forced level is the one selected, whatever the
+ * processor supports, and new profiles carry no layout wider than
+ * it needs. Must run before anything else touches the dispatch table.
+ */
+static void
+utest_forced(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, char *isaname)
+{
+  char         msg[] = "dispatch forced unit test failed";
+  int          isa   = p7_dispatch_EncodeISA(isaname);
+  P7_HMM      *hmm   = NULL;
+  P7_PROFILE  *gm    = NULL;
+  P7_OPROFILE *om    = NULL;
+  ESL_DSQ     *dsq   = malloc(sizeof(ESL_DSQ) * (L+2));
+  P7_OMX      *ox    = p7_omx_Create(M, 0, L);
+  float        sc1, sc2;
+
+  if (isa == 0)                                                      esl_fatal(msg);
+  if (setenv("HMMER_FORCE_ISA", isaname, 1) != 0)                    esl_fatal(msg);
+  if (p7_dispatch_GetISA()    != isa)                                esl_fatal(msg);
+  if (p7_dispatch_GetLayout() >= (isa << 1))                         esl_fatal(msg); /* nothing wider than <isa> */
+
+  if (p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om) != eslOK) esl_fatal(msg);
+  if (om->layout != p7_dispatch_GetLayout())                         esl_fatal(msg);
+
+  esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+  if (p7_MSVFilter    (dsq, L, om, ox, &sc1) != eslOK) esl_fatal(msg);
+  if (p7_MSVFilter_sse(dsq, L, om, ox, &sc2) != eslOK) esl_fatal(msg);
+  if (sc1 != sc2)                                      esl_fatal(msg);
+
+  free(dsq);
+  p7_omx_Destroy(ox);
+  p7_hmm_Destroy(hmm);
+  p7_profile_Destroy(gm);
+  p7_oprofile_Destroy(om);
+}
+
+/* utest_layout()
+ *
+ * A profile created at the SSE level doesn't carry the wider layouts,
+ * and the wide kernels refuse it.
+ */
+static void
+utest_layout(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L)
+{
+  char         msg[] = "dispatch layout unit test failed";
+  P7_HMM      *hmm   = NULL;
+  P7_PROFILE  *gm    = NULL;
+  P7_OPROFILE *om    = NULL;
+  ESL_DSQ     *dsq   = malloc(sizeof(ESL_DSQ) * (L+2));
+  P7_OMX      *ox    = p7_omx_Create(M, 0, L);
+  float        sc;
+
+  if (p7_dispatch_Select(p7_ISA_SSE) != eslOK)                       esl_fatal(msg);
+  if (p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om) != eslOK) esl_fatal(msg);
+  if (om->layout != p7_ISA_SSE)                                      esl_fatal(msg);
+  esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+
+  esl_exception_SetHandler(&esl_nonfatal_handler);
+#ifdef eslENABLE_AVX
+  if (p7_MSVFilter_avx    (dsq, L, om, ox, &sc) != eslEINVAL) esl_fatal(msg);
+  if (p7_ViterbiFilter_avx(dsq, L, om, ox, &sc) != eslEINVAL) esl_fatal(msg);
+#endif
+#ifdef eslENABLE_AVX512
+  if (p7_ForwardParser_avx512(dsq, L, om, ox, &sc) != eslEINVAL) esl_fatal(msg);
+#endif
+  esl_exception_ResetDefaultHandler();
+  if (p7_MSVFilter(dsq, L, om, ox, &sc) == eslEINVAL) esl_fatal(msg);
+
+  free(dsq);
+  p7_omx_Destroy(ox);
+  p7_hmm_Destroy(hmm);
+  p7_profile_Destroy(gm);
+  p7_oprofile_Destroy(om);
+}
+#endif /*p7DISPATCH_TESTDRIVE*/
+
+
+/*****************************************************************
+ * 4. Test driver
+ *****************************************************************/
+#ifdef p7DISPATCH_TESTDRIVE
+/*
+   gcc -g -Wall -msse2 -std=gnu99 -I.. -L.. -I../../easel -L../../easel -o dispatch_utest -Dp7DISPATCH_TESTDRIVE dispatch.c -lhmmer -leasel -lm
+   ./dispatch_utest
+ */
+#include "p7_config.h"
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",           0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                  0 },
+  { "-v",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "be verbose",                                     0 },
+  { "-L",        eslARG_INT,    "200", NULL, NULL,  NULL,  NULL, NULL, "size of random sequences to sample",             0 },
+  { "-M",        eslARG_INT,    "145", NULL, NULL,  NULL,  NULL, NULL, "size of random models to sample",                0 },
+  { "-N",        eslARG_INT,     "50", NULL, NULL,  NULL,  NULL, NULL, "number of random sequences to sample",           0 },
+  { "--force",   eslARG_STRING,  NULL, NULL, NULL,  NULL,  NULL, NULL, "first test HMMER_FORCE_ISA=<s>: sse|avx2|avx512", 0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for runtime kernel dispatch";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go   = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *r    = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *abc  = NULL;
+  P7_BG          *bg   = NULL;
+  int             M    = esl_opt_GetInteger(go, "-M");
+  int             L    = esl_opt_GetInteger(go, "-L");
+  int             N    = esl_opt_GetInteger(go, "-N");
+
+  if ((abc = esl_alphabet_Create(eslAMINO)) == NULL)  esl_fatal("failed to create alphabet");
+  if ((bg = p7_bg_Create(abc))              == NULL)  esl_fatal("failed to create null model");
+
+  if (esl_opt_IsOn(go, "--force")) utest_forced(r, abc, bg, M, L, esl_opt_GetString(go, "--force"));
+  if (esl_opt_GetBoolean(go, "-v")) printf("dispatch level: %s\n", p7_dispatch_DecodeISA(p7_dispatch_GetISA()));
+
+  utest_levels(r, abc, bg, M, L, N);
+  utest_levels(r, abc, bg, 1, L, 10);
+  utest_layout(r, abc, bg, M, L);
+
+  esl_alphabet_Destroy(abc);
+  p7_bg_Destroy(bg);
+  esl_getopts_Destroy(go);
+  esl_randomness_Destroy(r);
+  return eslOK;
+}
+#endif /*p7DISPATCH_TESTDRIVE*/
+/*---------------------- end, test driver -----------------------*/
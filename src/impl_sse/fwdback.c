@@ -18,6 +18,17 @@
  * nonhomology states (NCJ) versus not -- thus, identifying where
  * high-probability "regions" are, the first step of identifying the
  * domain structure of a target sequence.
+ *
+ * In between, a checkpointed matrix (p7_omx_GrowToCheckpointed())
+ * keeps O(M sqrt(L)) memory; the full Forward and Backward fill it
+ * as they would a full matrix, and p7_ForwardSegment() and
+ * p7_BackwardSegment() recalculate the rows between two checkpoints
+ * when a later step needs them.
+ *
+ * p7_ForwardBanded() and p7_BackwardBanded() are parsers that only
+ * let the core model states use the rows in a P7_GBANDS band list,
+ * for long targets where most rows can't be in any alignment; a full
+ * parse picks the rows (p7_BandsFromForward()).
  * 
  * Contents:
  *   1. Forward/Backward wrapper API
@@ -45,6 +56,14 @@
 
 static int forward_engine (int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om,                    P7_OMX *fwd, float *opt_sc);
 static int backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc);
+static void forward_rows   (int do_full,                const ESL_DSQ *dsq, const P7_OPROFILE *om,                    P7_OMX *ox,  int ia, int ib);
+static void backward_rows  (int do_full, int do_replay, const ESL_DSQ *dsq, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, int ib, int ia);
+static void forward_init   (const P7_OPROFILE *om, P7_OMX *ox, int L);
+static void forward_gap    (const P7_OPROFILE *om, P7_OMX *ox, int ia, int ib);
+static int  forward_score  (const P7_OPROFILE *om, const P7_OMX *ox, int L, float *opt_sc);
+static void backward_init  (int do_full, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, int L);
+static void backward_gap   (const P7_OPROFILE *om, P7_OMX *bck, int ib, int ia);
+static int  backward_term  (int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *bck, float *opt_sc);
 
 
 /*****************************************************************
@@ -99,8 +118,8 @@ p7_Forward(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *
   return forward_engine(TRUE, dsq, L, om, ox, opt_sc);
 }
 
-/* Function:  p7_ForwardParser()
- * Synopsis:  The Forward algorithm, linear memory parsing version.
+/* Function:  p7_ForwardParser_sse()
+ * Synopsis:  The Forward algorithm, linear memory parsing version, 4-way SSE.
  * Incept:    SRE, Fri Aug 15 19:05:26 2008 [Casa de Gatos]
  *
  * Purpose:   Same as <p7_Forward() except that the full matrix isn't
@@ -129,7 +148,7 @@ p7_Forward(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *
  *            In either case, <*opt_sc> is undefined.
  */
 int
-p7_ForwardParser(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *opt_sc)
+p7_ForwardParser_sse(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *opt_sc)
 {
 #if eslDEBUGLEVEL > 0		
   if (om->M >  ox->allocQ4*4)    ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few columns)");
@@ -202,8 +221,8 @@ p7_Backward(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd,
 
 
 
-/* Function:  p7_BackwardParser()
- * Synopsis:  The Backward algorithm, linear memory parsing version.
+/* Function:  p7_BackwardParser_sse()
+ * Synopsis:  The Backward algorithm, linear memory parsing version, 4-way SSE.
  * Incept:    SRE, Sat Aug 16 08:34:13 2008 [Janelia]
  *
  * Purpose:   Same as <p7_Backward()> except that the full matrix isn't
@@ -233,7 +252,7 @@ p7_Backward(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd,
  *            In either case, <*opt_sc> is undefined.
  */
 int 
-p7_BackwardParser(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc)
+p7_BackwardParser_sse(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc)
 {
 #if eslDEBUGLEVEL > 0		
   if (om->M >  bck->allocQ4*4)    ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few columns)");
@@ -248,50 +267,336 @@ p7_BackwardParser(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX
 
 
 
+/* Function:  p7_ForwardSegment()
+ * Synopsis:  Recalculate one segment of a checkpointed Forward matrix.
+ *
+ * Purpose:   Given a Forward matrix <fwd> that <p7_Forward()> has
+ *            filled for <dsq> and <om>, recalculate rows <a>+1..<b>-1
+ *            from row <a>. This is how the rows in between the
+ *            checkpoints of a checkpointed matrix (see
+ *            <p7_omx_GrowToCheckpointed()>) are brought back, one
+ *            segment at a time; <a> and <b> are then consecutive
+ *            checkpoints, $a = nS$ and $b = \min(a+S, L)$, and both
+ *            rows are valid already.
+ *
+ *            The recalculated values are identical to the ones
+ *            <p7_Forward()> calculated, including the scale factors.
+ *            <fwd->totscale> is left as it was.
+ *
+ * Args:      dsq  - digital target sequence, 1..L
+ *            om   - optimized profile, configured as for p7_Forward()
+ *            fwd  - filled Forward matrix
+ *            a,b  - recalculate rows a+1..b-1; 0 <= a < b <= L
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <a>..<b> isn't a valid range for <fwd>.
+ */
+int
+p7_ForwardSegment(const ESL_DSQ *dsq, const P7_OPROFILE *om, P7_OMX *fwd, int a, int b)
+{
+  float totscale = fwd->totscale;
+
+  if (a < 0 || b <= a || b > fwd->L) ESL_EXCEPTION(eslEINVAL, "bad segment for Forward matrix");
+
+  forward_rows(TRUE, dsq, om, fwd, a, b-1);
+  fwd->totscale = totscale;
+  return eslOK;
+}
+
+
+/* Function:  p7_BackwardSegment()
+ * Synopsis:  Recalculate one segment of a checkpointed Backward matrix.
+ *
+ * Purpose:   Given a Backward matrix <bck> that <p7_Backward()> has
+ *            filled for <dsq> and <om>, using Forward matrix <fwd>
+ *            for scale factors, recalculate rows <b>-1 down to
+ *            <a>+1 from row <b>. See <p7_ForwardSegment()>.
+ *
+ *            The recalculated values are identical to the ones
+ *            <p7_Backward()> calculated. The row scale factors that
+ *            <p7_Backward()> stored in <bck> are reused, which
+ *            matters when <bck> had to switch to its own (see
+ *            <bck->has_own_scales>).
+ *
+ * Args:      dsq  - digital target sequence, 1..L
+ *            om   - optimized profile, configured as for p7_Backward()
+ *            fwd  - Forward matrix <bck> was calculated with
+ *            bck  - filled Backward matrix
+ *            a,b  - recalculate rows b-1..a+1; 0 <= a < b <= L
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <a>..<b> isn't a valid range for <bck>.
+ */
+int
+p7_BackwardSegment(const ESL_DSQ *dsq, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, int a, int b)
+{
+  if (a < 0 || b <= a || b > bck->L) ESL_EXCEPTION(eslEINVAL, "bad segment for Backward matrix");
+
+  backward_rows(TRUE, TRUE, dsq, om, fwd, bck, b, a);
+  return eslOK;
+}
+
+
+/* Function:  p7_BandsFromForward()
+ * Synopsis:  Choose the rows a banded Forward/Backward should calculate.
+ *
+ * Purpose:   Given a Forward matrix <fwd> (parsing or full) for a
+ *            target against <om>, find the rows that can be left out
+ *            of a banded recalculation, and put the rest in <bnd>.
+ *
+ *            A row <i> is a candidate alignment end when the Forward
+ *            probability of reaching E there is at least a fraction
+ *            <endp> of the flanking mass $N(i)+J(i)+C(i)$. A domain
+ *            ending at <i> starts no further back than the longest
+ *            alignment <om> expects, <om->max_length> (or $4M$ if that
+ *            isn't set), so each candidate end brings in the window of
+ *            rows <i>-W+1..<i>. Overlapping and adjacent windows are
+ *            merged into one segment.
+ *
+ *            Bands only cover rows: every row in a band covers all of
+ *            1..M, because the striped vectors interleave model
+ *            positions.
+ *
+ * Args:      om   - optimized profile
+ *            fwd  - Forward matrix for the target
+ *            endp - threshold for a candidate alignment end
+ *            bnd  - RETURN: the bands; reused, and grown if needed
+ *
+ * Returns:   <eslOK> on success. <bnd->nrow> may be 0, if no row
+ *            passes <endp>.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_BandsFromForward(const P7_OPROFILE *om, const P7_OMX *fwd, float endp, P7_GBANDS *bnd)
+{
+  int   L    = fwd->L;
+  int   W    = (om->max_length > 0 ? om->max_length : 4 * om->M);
+  int   last = 0;		/* last row appended to <bnd> so far */
+  float flank;
+  int   i, e;
+  int   status;
+
+  p7_gbands_Reuse(bnd);
+  bnd->L = L;
+  bnd->M = om->M;
+
+  for (e = 1; e <= L; e++)
+    {
+      flank = fwd->xmx[e*p7X_NXCELLS+p7X_N] + fwd->xmx[e*p7X_NXCELLS+p7X_J] + fwd->xmx[e*p7X_NXCELLS+p7X_C];
+      if (fwd->xmx[e*p7X_NXCELLS+p7X_E] <= endp * flank) continue;
+
+      for (i = ESL_MAX(ESL_MAX(last+1, e-W+1), 1); i <= e; i++)
+	if ((status = p7_gbands_Append(bnd, i, 1, om->M)) != eslOK) return status;
+      last = e;
+    }
+  return eslOK;
+}
+
+
+/* Function:  p7_ForwardBanded()
+ * Synopsis:  The Forward algorithm, restricted to bands; parsing version.
+ *
+ * Purpose:   Same as <p7_ForwardParser()>, except that the model
+ *            states M, D and I are only allowed to use the rows in
+ *            <bnd>. Elsewhere only N, J and C emit, which costs $O(1)$
+ *            per row, so the calculation takes $O(M \cdot nrow + L)$
+ *            time rather than $O(ML)$.
+ *
+ *            The banded score is a sum over a subset of the paths of
+ *            the full Forward score, so it is never larger. If the
+ *            two scores are <bsc> and <fsc>, $1 - e^{bsc - fsc}$ is
+ *            the total probability of the alignments the bands leave
+ *            out, and so bounds the error of any posterior
+ *            probability decoded from the banded matrices.
+ *
+ *            The caller provides a "parsing" <ox> as for
+ *            <p7_ForwardParser()>.
+ *
+ * Args:      dsq     - digital target sequence, 1..L
+ *            L       - length of dsq in residues
+ *            om      - optimized profile
+ *            bnd     - row bands, from <p7_BandsFromForward()>
+ *            ox      - RETURN: Forward DP matrix
+ *            opt_sc  - optRETURN: banded Forward score (in nats)
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <ox> allocation is too small, if <bnd>
+ *            wasn't made for a target of length <L>, or if the
+ *            profile isn't in local alignment mode.
+ *            <eslERANGE> if the score exceeds the limited range of
+ *            a probability-space odds ratio.
+ *            In either case, <*opt_sc> is undefined.
+ */
+int
+p7_ForwardBanded(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_GBANDS *bnd, P7_OMX *ox, float *opt_sc)
+{
+  __m128 zerov = _mm_setzero_ps();
+  int    Q     = p7O_NQF(om->M);
+  int    last  = 0;		/* last row calculated so far */
+  int    g, q, ia, ib;
+
+  if (bnd->L != L) ESL_EXCEPTION(eslEINVAL, "bands weren't made for this target");
+#if eslDEBUGLEVEL > 0		
+  if (om->M >  ox->allocQ4*4)    ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few columns)");
+  if (ox->validR < 1)            ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few MDI rows)");
+  if (L     >= ox->allocXR)      ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few X rows)");
+  if (! p7_oprofile_IsLocal(om)) ESL_EXCEPTION(eslEINVAL, "Forward implementation makes assumptions that only work for local alignment");
+#endif
+
+  forward_init(om, ox, L);
+  for (g = 0; g < bnd->nseg; g++)
+    {
+      ia = bnd->imem[g*2];
+      ib = bnd->imem[g*2+1];
+
+      /* row ia-1 is outside the band: only B reaches into it */
+      forward_gap(om, ox, last, ia-1);
+      for (q = 0; q < Q; q++)
+	MMO(ox->dpf[0],q) = IMO(ox->dpf[0],q) = DMO(ox->dpf[0],q) = zerov;
+      forward_rows(FALSE, dsq, om, ox, ia-1, ib);
+      last = ib;
+    }
+  forward_gap(om, ox, last, L);
+  return forward_score(om, ox, L, opt_sc);
+}
+
+
+/* Function:  p7_BackwardBanded()
+ * Synopsis:  The Backward algorithm, restricted to bands; parsing version.
+ *
+ * Purpose:   The Backward counterpart of <p7_ForwardBanded()>: same as
+ *            <p7_BackwardParser()>, except that M, D and I only use
+ *            the rows in <bnd>. <fwd> must be the matrix
+ *            <p7_ForwardBanded()> filled with the same <bnd>, and on
+ *            success the banded Backward score equals the banded
+ *            Forward score. Together, <fwd> and <bck> can be handed
+ *            to <p7_DomainDecoding()> as usual.
+ *
+ * Args:      dsq     - digital target sequence, 1..L
+ *            L       - length of dsq in residues
+ *            om      - optimized profile
+ *            bnd     - row bands, as used for <fwd>
+ *            fwd     - banded Forward DP matrix, for scale factors
+ *            bck     - RETURN: Backward DP matrix
+ *            opt_sc  - optRETURN: banded Backward score (in nats)
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <bck> allocation is too small, if <bnd>
+ *            wasn't made for a target of length <L>, or if the
+ *            profile isn't in local alignment mode.
+ *            <eslERANGE> if the score exceeds the limited range of
+ *            a probability-space odds ratio.
+ *            In either case, <*opt_sc> is undefined.
+ */
+int
+p7_BackwardBanded(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_GBANDS *bnd, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc)
+{
+  __m128 zerov = _mm_setzero_ps();
+  int    Q     = p7O_NQF(om->M);
+  int    last;			/* last row calculated so far */
+  int    g, q, ia, ib;
+
+  if (bnd->L != L) ESL_EXCEPTION(eslEINVAL, "bands weren't made for this target");
+#if eslDEBUGLEVEL > 0		
+  if (om->M >  bck->allocQ4*4)    ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few columns)");
+  if (bck->validR < 1)            ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few MDI rows)");
+  if (L     >= bck->allocXR)      ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few X rows)");
+  if (L     != fwd->L)            ESL_EXCEPTION(eslEINVAL, "fwd matrix size doesn't agree with length L");
+  if (! p7_oprofile_IsLocal(om))  ESL_EXCEPTION(eslEINVAL, "Forward implementation makes assumptions that only work for local alignment");
+#endif
+
+  if (bnd->nseg && bnd->imem[(bnd->nseg-1)*2+1] == L)
+    backward_init(FALSE, om, fwd, bck, L);
+  else
+    {				/* row L is outside the bands: only C->T and E->C */
+      bck->M = om->M;
+      bck->L = L;
+      bck->has_own_scales = FALSE;
+      bck->xmx[L*p7X_NXCELLS+p7X_C]     = om->xf[p7O_C][p7O_MOVE];
+      bck->xmx[L*p7X_NXCELLS+p7X_E]     = bck->xmx[L*p7X_NXCELLS+p7X_C] * om->xf[p7O_E][p7O_MOVE];
+      bck->xmx[L*p7X_NXCELLS+p7X_N]     = 0.0;
+      bck->xmx[L*p7X_NXCELLS+p7X_J]     = 0.0;
+      bck->xmx[L*p7X_NXCELLS+p7X_B]     = 0.0;
+      bck->xmx[L*p7X_NXCELLS+p7X_SCALE] = 1.0;
+      bck->totscale                     = 0.0;
+    }
+
+  last = L;
+  for (g = bnd->nseg-1; g >= 0; g--)
+    {
+      ia = bnd->imem[g*2];
+      ib = bnd->imem[g*2+1];
+
+      /* rows ib..ia-1 need the band: ib..ia for MDI, ia-1 for B->Mk.
+       * Starting from row ib+1 (when ib < L), its MDI row is zero.
+       */
+      if (ib < L)
+	{
+	  backward_gap(om, bck, last, ib);
+	  for (q = 0; q < Q; q++)
+	    MMO(bck->dpf[0],q) = IMO(bck->dpf[0],q) = DMO(bck->dpf[0],q) = zerov;
+	  backward_rows(FALSE, FALSE, dsq, om, fwd, bck, ib+1, ESL_MAX(ia-2, 0));
+	}
+      else
+	backward_rows(FALSE, FALSE, dsq, om, fwd, bck, L,    ESL_MAX(ia-2, 0));
+      last = ESL_MAX(ia-1, 1);
+    }
+
+  /* Unless row 1 is in a band, its MDI row is zero (the last row
+   * calculated above, ia-1, isn't in one) 
+   */
+  if (! bnd->nseg || bnd->imem[0] > 1)
+    {
+      backward_gap(om, bck, last, 0);
+      for (q = 0; q < Q; q++)
+	MMO(bck->dpf[0],q) = IMO(bck->dpf[0],q) = DMO(bck->dpf[0],q) = zerov;
+    }
+  return backward_term(FALSE, dsq, L, om, bck, opt_sc);
+}
+
+
+
 /*****************************************************************
  * 2. Forward/Backward engine implementations (called thru API)
  *****************************************************************/
 
-static int
-forward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *opt_sc)
+/* forward_rows()
+ * Calculate Forward rows <ia>+1..<ib>, starting from row <ia>, which
+ * must already be calculated: its MDI cells in <ox->dpf[ia]> (or
+ * <dpf[0]>, when <do_full> is FALSE), and its specials in
+ * <ox->xmx>. The log of each row's scale factor is added to
+ * <ox->totscale>.
+ */
+static void
+forward_rows(int do_full, const ESL_DSQ *dsq, const P7_OPROFILE *om, P7_OMX *ox, int ia, int ib)
 {
   register __m128 mpv, dpv, ipv;   /* previous row values                                       */
   register __m128 sv;		   /* temp storage of 1 curr row value in progress              */
   register __m128 dcv;		   /* delayed storage of D(i,q+1)                               */
   register __m128 xEv;		   /* E state: keeps max for Mk->E as we go                     */
   register __m128 xBv;		   /* B state: splatted vector of B[i-1] for B->Mk calculations */
-  __m128   zerov;		   /* splatted 0.0's in a vector                                */
+  __m128   zerov = _mm_setzero_ps(); /* splatted 0.0's in a vector                              */
   float    xN, xE, xB, xC, xJ;	   /* special states' scores                                    */
-  int i;			   /* counter over sequence positions 1..L                      */
+  int i;			   /* counter over sequence positions ia+1..ib                  */
   int q;			   /* counter over quads 0..nq-1                                */
   int j;			   /* counter over DD iterations (4 is full serialization)      */
   int Q       = p7O_NQF(om->M);	   /* segment length: # of vectors                              */
-  __m128 *dpc = ox->dpf[0];        /* current row, for use in {MDI}MO(dpp,q) access macro       */
+  __m128 *dpc = ox->dpf[do_full * ia]; /* current row, for use in {MDI}MO(dpp,q) access macro   */
   __m128 *dpp;                     /* previous row, for use in {MDI}MO(dpp,q) access macro      */
   __m128 *rp;			   /* will point at om->rfv[x] for residue x[i]                 */
   __m128 *tp;			   /* will point into (and step thru) om->tfv                   */
 
-  /* Initialization. */
-  ox->M  = om->M;
-  ox->L  = L;
-  ox->has_own_scales = TRUE; 	/* all forward matrices control their own scalefactors */
-  zerov  = _mm_setzero_ps();
-  for (q = 0; q < Q; q++)
-    MMO(dpc,q) = IMO(dpc,q) = DMO(dpc,q) = zerov;
-  xE    = ox->xmx[p7X_E] = 0.;
-  xN    = ox->xmx[p7X_N] = 1.;
-  xJ    = ox->xmx[p7X_J] = 0.;
-  xB    = ox->xmx[p7X_B] = om->xf[p7O_N][p7O_MOVE];
-  xC    = ox->xmx[p7X_C] = 0.;
+  xN = ox->xmx[ia*p7X_NXCELLS+p7X_N];
+  xJ = ox->xmx[ia*p7X_NXCELLS+p7X_J];
+  xB = ox->xmx[ia*p7X_NXCELLS+p7X_B];
+  xC = ox->xmx[ia*p7X_NXCELLS+p7X_C];
 
-  ox->xmx[p7X_SCALE] = 1.0;
-  ox->totscale       = 0.0;
-
-#if eslDEBUGLEVEL > 0
-  if (ox->debugging) p7_omx_DumpFBRow(ox, TRUE, 0, 9, 5, xE, xN, xJ, xB, xC);	/* logify=TRUE, <rowi>=0, width=8, precision=5*/
-#endif
-
-  for (i = 1; i <= L; i++)
+  for (i = ia+1; i <= ib; i++)
     {
       dpp   = dpc;                      
       dpc   = ox->dpf[do_full * i];     /* avoid conditional, use do_full as kronecker delta */
@@ -447,34 +752,32 @@ forward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7
 #if eslDEBUGLEVEL > 0
       if (ox->debugging) p7_omx_DumpFBRow(ox, TRUE, i, 9, 5, xE, xN, xJ, xB, xC);	/* logify=TRUE, <rowi>=i, width=8, precision=5*/
 #endif
-    } /* end loop over sequence residues 1..L */
-
-  /* finally C->T, and flip total score back to log space (nats) */
-  /* On overflow, xC is inf or nan (nan arises because inf*0 = nan). */
-  /* On an underflow (which shouldn't happen), we counterintuitively return infinity:
-   * the effect of this is to force the caller to rescore us with full range.
-   */
-  if       (isnan(xC))        ESL_EXCEPTION(eslERANGE, "forward score is NaN");
-  else if  (L>0 && xC == 0.0) ESL_EXCEPTION(eslERANGE, "forward score underflow (is 0.0)");     /* if L==0, xC *should* be 0.0; J5/118 */
-  else if  (isinf(xC) == 1)   ESL_EXCEPTION(eslERANGE, "forward score overflow (is infinity)");
-
-  if (opt_sc != NULL) *opt_sc = ox->totscale + log(xC * om->xf[p7O_C][p7O_MOVE]);
-  return eslOK;
+    } /* end loop over sequence residues ia+1..ib */
 }
 
 
-
-static int 
-backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc)
+/* backward_rows()
+ * Calculate Backward rows <ib>-1 down to <ia>+1, starting from row
+ * <ib>, which must already be calculated. 
+ *
+ * If <do_replay> is TRUE, these rows have been calculated before, and
+ * are being recalculated in a checkpointed matrix: the scale factors
+ * stored in <bck->xmx> are reused, rather than decided anew, and
+ * neither <bck->totscale> nor <bck->has_own_scales> is touched.  (The
+ * decision to switch to own scale factors is sticky, so it can't be
+ * remade correctly from the middle of the matrix.)
+ */
+static void
+backward_rows(int do_full, int do_replay, const ESL_DSQ *dsq, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, int ib, int ia)
 {
   register __m128 mpv, ipv, dpv;      /* previous row values                                       */
   register __m128 mcv, dcv;           /* current row values                                        */
   register __m128 tmmv, timv, tdmv;   /* tmp vars for accessing rotated transition scores          */
   register __m128 xBv;		      /* collects B->Mk components of B(i)                         */
   register __m128 xEv;	              /* splatted E(i)                                             */
-  __m128   zerov;		      /* splatted 0.0's in a vector                                */
+  __m128   zerov = _mm_setzero_ps();  /* splatted 0.0's in a vector                                */
   float    xN, xE, xB, xC, xJ;	      /* special states' scores                                    */
-  int      i;			      /* counter over sequence positions 0,1..L                    */
+  int      i;			      /* counter over sequence positions ib-1..ia+1                */
   int      q;			      /* counter over quads 0..Q-1                                 */
   int      Q       = p7O_NQF(om->M);  /* segment length: # of vectors                              */
   int      j;			      /* DD segment iteration counter (4 = full serialization)     */
@@ -483,85 +786,11 @@ backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, c
   __m128  *rp;			      /* will point into om->rfv[x] for residue x[i+1]             */
   __m128  *tp;		              /* will point into (and step thru) om->tfv transition scores */
 
-  /* initialize the L row. */
-  bck->M = om->M;
-  bck->L = L;
-  bck->has_own_scales = FALSE;	/* backwards scale factors are *usually* given by <fwd> */
-  dpc    = bck->dpf[L * do_full];
-  xJ     = 0.0;
-  xB     = 0.0;
-  xN     = 0.0;
-  xC     = om->xf[p7O_C][p7O_MOVE];      /* C<-T */
-  xE     = xC * om->xf[p7O_E][p7O_MOVE]; /* E<-C, no tail */
-  xEv    = _mm_set1_ps(xE); 
-  zerov  = _mm_setzero_ps();  
-  dcv    = zerov;		/* solely to silence a compiler warning */
-  for (q = 0; q < Q; q++) MMO(dpc,q) = DMO(dpc,q) = xEv;
-  for (q = 0; q < Q; q++) IMO(dpc,q) = zerov;
+  xN = bck->xmx[ib*p7X_NXCELLS+p7X_N];
+  xJ = bck->xmx[ib*p7X_NXCELLS+p7X_J];
+  xC = bck->xmx[ib*p7X_NXCELLS+p7X_C];
 
-  /* init row L's DD paths, 1) first segment includes xE, from DMO(q) */
-  tp  = om->tfv + 8*Q - 1;	                        /* <*tp> now the [4 8 12 x] TDD quad         */
-  dpv = _mm_move_ss(DMO(dpc,Q-1), zerov);               /* start leftshift: [1 5 9 13] -> [x 5 9 13] */
-  dpv = _mm_shuffle_ps(dpv, dpv, _MM_SHUFFLE(0,3,2,1)); /* finish leftshift:[x 5 9 13] -> [5 9 13 x] */
-  for (q = Q-1; q >= 0; q--)
-    {
-      dcv        = _mm_mul_ps(dpv, *tp);      tp--;
-      DMO(dpc,q) = _mm_add_ps(DMO(dpc,q), dcv);
-      dpv        = DMO(dpc,q);
-    }
-  /* 2) three more passes, only extending DD component (dcv only; no xE contrib from DMO(q)) */
-  for (j = 1; j < 4; j++)
-    {
-      tp  = om->tfv + 8*Q - 1;	                            /* <*tp> now the [4 8 12 x] TDD quad         */
-      dcv = _mm_move_ss(dcv, zerov);                        /* start leftshift: [1 5 9 13] -> [x 5 9 13] */
-      dcv = _mm_shuffle_ps(dcv, dcv, _MM_SHUFFLE(0,3,2,1)); /* finish leftshift:[x 5 9 13] -> [5 9 13 x] */
-      for (q = Q-1; q >= 0; q--)
-	{
-	  dcv        = _mm_mul_ps(dcv, *tp); tp--;
-	  DMO(dpc,q) = _mm_add_ps(DMO(dpc,q), dcv);
-	}
-    }
-  /* now MD init */
-  tp  = om->tfv + 7*Q - 3;	                        /* <*tp> now the [4 8 12 x] Mk->Dk+1 quad    */
-  dcv = _mm_move_ss(DMO(dpc,0), zerov);                 /* start leftshift: [1 5 9 13] -> [x 5 9 13] */
-  dcv = _mm_shuffle_ps(dcv, dcv, _MM_SHUFFLE(0,3,2,1)); /* finish leftshift:[x 5 9 13] -> [5 9 13 x] */
-  for (q = Q-1; q >= 0; q--)
-    {
-      MMO(dpc,q) = _mm_add_ps(MMO(dpc,q), _mm_mul_ps(dcv, *tp)); tp -= 7;
-      dcv        = DMO(dpc,q);
-    }
-
-  /* Sparse rescaling: same scale factors as fwd matrix */
-  if (fwd->xmx[L*p7X_NXCELLS+p7X_SCALE] > 1.0)
-    {
-      xE  = xE / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
-      xN  = xN / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
-      xC  = xC / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
-      xJ  = xJ / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
-      xB  = xB / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
-      xEv = _mm_set1_ps(1.0 / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE]);
-      for (q = 0; q < Q; q++) {
-	MMO(dpc,q) = _mm_mul_ps(MMO(dpc,q), xEv);
-	DMO(dpc,q) = _mm_mul_ps(DMO(dpc,q), xEv);
-	IMO(dpc,q) = _mm_mul_ps(IMO(dpc,q), xEv);
-      }
-    }
-  bck->xmx[L*p7X_NXCELLS+p7X_SCALE] = fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
-  bck->totscale                     = log(bck->xmx[L*p7X_NXCELLS+p7X_SCALE]);
-
-  /* Stores */
-  bck->xmx[L*p7X_NXCELLS+p7X_E] = xE;
-  bck->xmx[L*p7X_NXCELLS+p7X_N] = xN;
-  bck->xmx[L*p7X_NXCELLS+p7X_J] = xJ;
-  bck->xmx[L*p7X_NXCELLS+p7X_B] = xB;
-  bck->xmx[L*p7X_NXCELLS+p7X_C] = xC;
-
-#if eslDEBUGLEVEL > 0
-  if (bck->debugging) p7_omx_DumpFBRow(bck, TRUE, L, 9, 4, xE, xN, xJ, xB, xC);	/* logify=TRUE, <rowi>=L, width=9, precision=4*/
-#endif
-
-  /* main recursion */
-  for (i = L-1; i >= 1; i--)	/* backwards stride */
+  for (i = ib-1; i > ia; i--)	/* backwards stride */
     {
       /* phase 1. B(i) collected. Old row destroyed, new row contains
        *    complete I(i,k), partial {MD}(i,k) w/ no {MD}->{DE} paths yet.
@@ -656,10 +885,13 @@ backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, c
        * from those in <fwd>. This will complicate subsequent
        * posterior decoding routines.
        */
-      if (xB > 1.0e16) bck->has_own_scales = TRUE;
+      if (! do_replay)
+	{
+	  if (xB > 1.0e16) bck->has_own_scales = TRUE;
 
-      if      (bck->has_own_scales)  bck->xmx[i*p7X_NXCELLS+p7X_SCALE] = (xB > 1.0e4) ? xB : 1.0;
-      else                           bck->xmx[i*p7X_NXCELLS+p7X_SCALE] = fwd->xmx[i*p7X_NXCELLS+p7X_SCALE];
+	  if      (bck->has_own_scales)  bck->xmx[i*p7X_NXCELLS+p7X_SCALE] = (xB > 1.0e4) ? xB : 1.0;
+	  else                           bck->xmx[i*p7X_NXCELLS+p7X_SCALE] = fwd->xmx[i*p7X_NXCELLS+p7X_SCALE];
+	}
 
       if (bck->xmx[i*p7X_NXCELLS+p7X_SCALE] > 1.0)
 	{
@@ -674,7 +906,7 @@ backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, c
 	    DMO(dpc,q) = _mm_mul_ps(DMO(dpc,q), xBv);
 	    IMO(dpc,q) = _mm_mul_ps(IMO(dpc,q), xBv);
 	  }
-	  bck->totscale += log(bck->xmx[i*p7X_NXCELLS+p7X_SCALE]);
+	  if (! do_replay) bck->totscale += log(bck->xmx[i*p7X_NXCELLS+p7X_SCALE]);
 	}
 
       /* Stores are separate only for pedagogical reasons: easy to
@@ -691,8 +923,253 @@ backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, c
       if (bck->debugging) p7_omx_DumpFBRow(bck, TRUE, i, 9, 4, xE, xN, xJ, xB, xC);	/* logify=TRUE, <rowi>=i, width=9, precision=4*/
 #endif
     } /* thus ends the loop over sequence positions i */
+}
+
+
+/* forward_init()
+ * Initialize row 0 of a Forward matrix <ox> for a target of length <L>.
+ */
+static void
+forward_init(const P7_OPROFILE *om, P7_OMX *ox, int L)
+{
+  __m128   zerov = _mm_setzero_ps(); /* splatted 0.0's in a vector                              */
+  int      q;			     /* counter over quads 0..nq-1                              */
+  int      Q     = p7O_NQF(om->M);   /* segment length: # of vectors                            */
+  __m128  *dpc   = ox->dpf[0];       /* row 0                                                   */
+
+  ox->M  = om->M;
+  ox->L  = L;
+  ox->has_own_scales = TRUE; 	/* all forward matrices control their own scalefactors */
+  for (q = 0; q < Q; q++)
+    MMO(dpc,q) = IMO(dpc,q) = DMO(dpc,q) = zerov;
+  ox->xmx[p7X_E] = 0.;
+  ox->xmx[p7X_N] = 1.;
+  ox->xmx[p7X_J] = 0.;
+  ox->xmx[p7X_B] = om->xf[p7O_N][p7O_MOVE];
+  ox->xmx[p7X_C] = 0.;
+
+  ox->xmx[p7X_SCALE] = 1.0;
+  ox->totscale       = 0.0;
+
+#if eslDEBUGLEVEL > 0
+  if (ox->debugging) p7_omx_DumpFBRow(ox, TRUE, 0, 9, 5, ox->xmx[p7X_E], ox->xmx[p7X_N], ox->xmx[p7X_J], ox->xmx[p7X_B], ox->xmx[p7X_C]);	/* logify=TRUE, <rowi>=0, width=8, precision=5*/
+#endif
+}
+
+
+/* forward_gap()
+ * Carry the Forward specials from row <ia> through rows <ia>+1..<ib>,
+ * where no core model state emits (rows outside any band): only N, J
+ * and C loop, and E is zero, so no rescaling is needed. The MDI row
+ * isn't touched.
+ */
+static void
+forward_gap(const P7_OPROFILE *om, P7_OMX *ox, int ia, int ib)
+{
+  float xN = ox->xmx[ia*p7X_NXCELLS+p7X_N];
+  float xJ = ox->xmx[ia*p7X_NXCELLS+p7X_J];
+  float xC = ox->xmx[ia*p7X_NXCELLS+p7X_C];
+  float xB;
+  int   i;
+
+  for (i = ia+1; i <= ib; i++)
+    {
+      xN = xN * om->xf[p7O_N][p7O_LOOP];
+      xC = xC * om->xf[p7O_C][p7O_LOOP];
+      xJ = xJ * om->xf[p7O_J][p7O_LOOP];
+      xB = (xJ * om->xf[p7O_J][p7O_MOVE]) +  (xN * om->xf[p7O_N][p7O_MOVE]);
+
+      ox->xmx[i*p7X_NXCELLS+p7X_SCALE] = 1.0;
+      ox->xmx[i*p7X_NXCELLS+p7X_E]     = 0.0;
+      ox->xmx[i*p7X_NXCELLS+p7X_N]     = xN;
+      ox->xmx[i*p7X_NXCELLS+p7X_J]     = xJ;
+      ox->xmx[i*p7X_NXCELLS+p7X_B]     = xB;
+      ox->xmx[i*p7X_NXCELLS+p7X_C]     = xC;
+    }
+}
+
+
+/* forward_score()
+ * Forward termination: C->T from row <L>, and the score in nats.
+ */
+static int
+forward_score(const P7_OPROFILE *om, const P7_OMX *ox, int L, float *opt_sc)
+{
+  float xC = ox->xmx[L*p7X_NXCELLS+p7X_C];
+
+  /* finally C->T, and flip total score back to log space (nats) */
+  /* On overflow, xC is inf or nan (nan arises because inf*0 = nan). */
+  /* On an underflow (which shouldn't happen), we counterintuitively return infinity:
+   * the effect of this is to force the caller to rescore us with full range.
+   */
+  if       (isnan(xC))        ESL_EXCEPTION(eslERANGE, "forward score is NaN");
+  else if  (L>0 && xC == 0.0) ESL_EXCEPTION(eslERANGE, "forward score underflow (is 0.0)");     /* if L==0, xC *should* be 0.0; J5/118 */
+  else if  (isinf(xC) == 1)   ESL_EXCEPTION(eslERANGE, "forward score overflow (is infinity)");
+
+  if (opt_sc != NULL) *opt_sc = ox->totscale + log(xC * om->xf[p7O_C][p7O_MOVE]);
+  return eslOK;
+}
+
+
+static int
+forward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *opt_sc)
+{
+  forward_init(om, ox, L);
+  forward_rows(do_full, dsq, om, ox, 0, L);
+  return forward_score(om, ox, L, opt_sc);
+}
+
+
+/* backward_init()
+ * Initialize row <L> of a Backward matrix <bck>, using the
+ * scale factor of row <L> in Forward matrix <fwd>.
+ */
+static void
+backward_init(int do_full, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, int L)
+{
+  register __m128 dpv;                /* previous row values                                       */
+  register __m128 dcv;                /* current row values                                        */
+  register __m128 xEv;	              /* splatted E(i)                                             */
+  __m128   zerov;		      /* splatted 0.0's in a vector                                */
+  float    xN, xE, xB, xC, xJ;	      /* special states' scores                                    */
+  int      q;			      /* counter over quads 0..Q-1                                 */
+  int      Q       = p7O_NQF(om->M);  /* segment length: # of vectors                              */
+  int      j;			      /* DD segment iteration counter (4 = full serialization)     */
+  __m128  *dpc;                       /* current DP row                                            */
+  __m128  *tp;		              /* will point into (and step thru) om->tfv transition scores */
+
+  /* initialize the L row. */
+  bck->M = om->M;
+  bck->L = L;
+  bck->has_own_scales = FALSE;	/* backwards scale factors are *usually* given by <fwd> */
+  dpc    = bck->dpf[L * do_full];
+  xJ     = 0.0;
+  xB     = 0.0;
+  xN     = 0.0;
+  xC     = om->xf[p7O_C][p7O_MOVE];      /* C<-T */
+  xE     = xC * om->xf[p7O_E][p7O_MOVE]; /* E<-C, no tail */
+  xEv    = _mm_set1_ps(xE); 
+  zerov  = _mm_setzero_ps();  
+  dcv    = zerov;		/* solely to silence a compiler warning */
+  for (q = 0; q < Q; q++) MMO(dpc,q) = DMO(dpc,q) = xEv;
+  for (q = 0; q < Q; q++) IMO(dpc,q) = zerov;
+
+  /* init row L's DD paths, 1) first segment includes xE, from DMO(q) */
+  tp  = om->tfv + 8*Q - 1;	                        /* <*tp> now the [4 8 12 x] TDD quad         */
+  dpv = _mm_move_ss(DMO(dpc,Q-1), zerov);               /* start leftshift: [1 5 9 13] -> [x 5 9 13] */
+  dpv = _mm_shuffle_ps(dpv, dpv, _MM_SHUFFLE(0,3,2,1)); /* finish leftshift:[x 5 9 13] -> [5 9 13 x] */
+  for (q = Q-1; q >= 0; q--)
+    {
+      dcv        = _mm_mul_ps(dpv, *tp);      tp--;
+      DMO(dpc,q) = _mm_add_ps(DMO(dpc,q), dcv);
+      dpv        = DMO(dpc,q);
+    }
+  /* 2) three more passes, only extending DD component (dcv only; no xE contrib from DMO(q)) */
+  for (j = 1; j < 4; j++)
+    {
+      tp  = om->tfv + 8*Q - 1;	                            /* <*tp> now the [4 8 12 x] TDD quad         */
+      dcv = _mm_move_ss(dcv, zerov);                        /* start leftshift: [1 5 9 13] -> [x 5 9 13] */
+      dcv = _mm_shuffle_ps(dcv, dcv, _MM_SHUFFLE(0,3,2,1)); /* finish leftshift:[x 5 9 13] -> [5 9 13 x] */
+      for (q = Q-1; q >= 0; q--)
+	{
+	  dcv        = _mm_mul_ps(dcv, *tp); tp--;
+	  DMO(dpc,q) = _mm_add_ps(DMO(dpc,q), dcv);
+	}
+    }
+  /* now MD init */
+  tp  = om->tfv + 7*Q - 3;	                        /* <*tp> now the [4 8 12 x] Mk->Dk+1 quad    */
+  dcv = _mm_move_ss(DMO(dpc,0), zerov);                 /* start leftshift: [1 5 9 13] -> [x 5 9 13] */
+  dcv = _mm_shuffle_ps(dcv, dcv, _MM_SHUFFLE(0,3,2,1)); /* finish leftshift:[x 5 9 13] -> [5 9 13 x] */
+  for (q = Q-1; q >= 0; q--)
+    {
+      MMO(dpc,q) = _mm_add_ps(MMO(dpc,q), _mm_mul_ps(dcv, *tp)); tp -= 7;
+      dcv        = DMO(dpc,q);
+    }
+
+  /* Sparse rescaling: same scale factors as fwd matrix */
+  if (fwd->xmx[L*p7X_NXCELLS+p7X_SCALE] > 1.0)
+    {
+      xE  = xE / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
+      xN  = xN / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
+      xC  = xC / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
+      xJ  = xJ / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
+      xB  = xB / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
+      xEv = _mm_set1_ps(1.0 / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE]);
+      for (q = 0; q < Q; q++) {
+	MMO(dpc,q) = _mm_mul_ps(MMO(dpc,q), xEv);
+	DMO(dpc,q) = _mm_mul_ps(DMO(dpc,q), xEv);
+	IMO(dpc,q) = _mm_mul_ps(IMO(dpc,q), xEv);
+      }
+    }
+  bck->xmx[L*p7X_NXCELLS+p7X_SCALE] = fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
+  bck->totscale                     = log(bck->xmx[L*p7X_NXCELLS+p7X_SCALE]);
+
+  /* Stores */
+  bck->xmx[L*p7X_NXCELLS+p7X_E] = xE;
+  bck->xmx[L*p7X_NXCELLS+p7X_N] = xN;
+  bck->xmx[L*p7X_NXCELLS+p7X_J] = xJ;
+  bck->xmx[L*p7X_NXCELLS+p7X_B] = xB;
+  bck->xmx[L*p7X_NXCELLS+p7X_C] = xC;
+
+#if eslDEBUGLEVEL > 0
+  if (bck->debugging) p7_omx_DumpFBRow(bck, TRUE, L, 9, 4, xE, xN, xJ, xB, xC);	/* logify=TRUE, <rowi>=L, width=9, precision=4*/
+#endif
+}
+
+
+/* backward_gap()
+ * Carry the Backward specials from row <ib> down through rows
+ * <ib>-1..<ia>+1, where neither the row nor the one after it is in a
+ * band: B can't reach an emitting core state, so B is zero and only
+ * N, J and C loop. Like the banded Forward, these rows aren't
+ * rescaled. The MDI row isn't touched.
+ */
+static void
+backward_gap(const P7_OPROFILE *om, P7_OMX *bck, int ib, int ia)
+{
+  float xN = bck->xmx[ib*p7X_NXCELLS+p7X_N];
+  float xJ = bck->xmx[ib*p7X_NXCELLS+p7X_J];
+  float xC = bck->xmx[ib*p7X_NXCELLS+p7X_C];
+  float xE;
+  int   i;
+
+  for (i = ib-1; i > ia; i--)
+    {
+      xC = xC * om->xf[p7O_C][p7O_LOOP];
+      xJ = xJ * om->xf[p7O_J][p7O_LOOP];
+      xN = xN * om->xf[p7O_N][p7O_LOOP];
+      xE = (xC * om->xf[p7O_E][p7O_MOVE]) + (xJ * om->xf[p7O_E][p7O_LOOP]);
+
+      bck->xmx[i*p7X_NXCELLS+p7X_SCALE] = 1.0;
+      bck->xmx[i*p7X_NXCELLS+p7X_E]     = xE;
+      bck->xmx[i*p7X_NXCELLS+p7X_N]     = xN;
+      bck->xmx[i*p7X_NXCELLS+p7X_J]     = xJ;
+      bck->xmx[i*p7X_NXCELLS+p7X_B]     = 0.0;
+      bck->xmx[i*p7X_NXCELLS+p7X_C]     = xC;
+    }
+}
+
+
+/* backward_term()
+ * Backward termination at row 0, from row 1 (its MDI row in
+ * <bck->dpf[1]>, or <dpf[0]> when <do_full> is FALSE), and the score
+ * in nats.
+ */
+static int
+backward_term(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *bck, float *opt_sc)
+{
+  register __m128 mpv;                /* previous row values                                       */
+  register __m128 xBv;		      /* collects B->Mk components of B(i)                         */
+  __m128   zerov = _mm_setzero_ps();  /* splatted 0.0's in a vector                                */
+  float    xN, xB;		      /* special states' scores                                    */
+  int      q;			      /* counter over quads 0..Q-1                                 */
+  int      Q       = p7O_NQF(om->M);  /* segment length: # of vectors                              */
+  __m128  *dpp;			      /* next ("previous") DP row                                  */
+  __m128  *rp;			      /* will point into om->rfv[x] for residue x[i+1]             */
+  __m128  *tp;		              /* will point into (and step thru) om->tfv transition scores */
 
   /* Termination at i=0, where we can only reach N,B states. */
+  xN  = bck->xmx[ESL_MIN(L,1)*p7X_NXCELLS+p7X_N]; /* N(1); or N(0), as initialized by backward_init(), if L=0 */
   dpp = bck->dpf[1 * do_full];
   tp  = om->tfv;          /* <*tp> is now the [1 5 9 13] TBMk transition quad  */
   rp  = om->rfv[dsq[1]];  /* <*rp> is now the [1 5 9 13] match emission quad   */
@@ -718,9 +1195,9 @@ backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, c
   bck->xmx[p7X_SCALE] = 1.0;
 
 #if eslDEBUGLEVEL > 0
-  dpc = bck->dpf[0];
+  dpp = bck->dpf[0];
   for (q = 0; q < Q; q++) /* Not strictly necessary, but if someone's looking at DP matrices, this is nice to do: */
-    MMO(dpc,q) = DMO(dpc,q) = IMO(dpc,q) = zerov;
+    MMO(dpp,q) = DMO(dpp,q) = IMO(dpp,q) = zerov;
   if (bck->debugging) p7_omx_DumpFBRow(bck, TRUE, 0, 9, 4, bck->xmx[p7X_E], bck->xmx[p7X_N],  bck->xmx[p7X_J], bck->xmx[p7X_B],  bck->xmx[p7X_C]);	/* logify=TRUE, <rowi>=0, width=9, precision=4*/
 #endif
 
@@ -731,6 +1208,15 @@ backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, c
   if (opt_sc != NULL) *opt_sc = bck->totscale + log(xN);
   return eslOK;
 }
+
+
+static int 
+backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc)
+{
+  backward_init(do_full, om, fwd, bck, L);
+  backward_rows(do_full, FALSE, dsq, om, fwd, bck, L, 0);
+  return backward_term(do_full, dsq, L, om, bck, opt_sc);
+}
 /*-------------- end, forward/backward engines  -----------------*/
 
 
@@ -944,6 +1430,68 @@ utest_fwdback(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int
   p7_profile_Destroy(gm);
   p7_oprofile_Destroy(om);
 }
+
+/* 
+ * Banded Forward/Backward: with bands that cover every row, the same
+ * scores as the parsers; with random bands, Forward and Backward
+ * agree, and score no more than the full parse.
+ */
+static void
+utest_banded(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  char        *msg = "banded forward/backward unit test failed";
+  P7_HMM      *hmm = NULL;
+  P7_PROFILE  *gm  = NULL;
+  P7_OPROFILE *om  = NULL;
+  ESL_DSQ     *dsq = malloc(sizeof(ESL_DSQ) * (L+2));
+  P7_OMX      *fwd = p7_omx_Create(M, 0, L);
+  P7_OMX      *bck = p7_omx_Create(M, 0, L);
+  P7_GBANDS   *bnd = p7_gbands_Create();
+  float        fsc, bsc;
+  float        fbsc, bbsc;
+  int          i, in;
+
+  p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om);
+  while (N--)
+    {
+      esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+      p7_ForwardParser (dsq, L, om, fwd,      &fsc);
+      p7_BackwardParser(dsq, L, om, fwd, bck, &bsc);
+
+      /* every row in the band */
+      p7_gbands_Reuse(bnd);
+      bnd->L = L;
+      bnd->M = M;
+      for (i = 1; i <= L; i++) p7_gbands_Append(bnd, i, 1, M);
+      if (p7_ForwardBanded (dsq, L, om, bnd, fwd,      &fbsc) != eslOK) esl_fatal(msg);
+      if (p7_BackwardBanded(dsq, L, om, bnd, fwd, bck, &bbsc) != eslOK) esl_fatal(msg);
+      if (fabs(fbsc-fsc) > 0.0001) esl_fatal(msg);
+      if (fabs(bbsc-bsc) > 0.0001) esl_fatal(msg);
+
+      /* random segments */
+      p7_gbands_Reuse(bnd);
+      bnd->L = L;
+      bnd->M = M;
+      for (in = FALSE, i = 1; i <= L; i++)
+	{
+	  if (esl_random(r) < 0.1) in = !in;
+	  if (in) p7_gbands_Append(bnd, i, 1, M);
+	}
+      if (bnd->nrow == 0) p7_gbands_Append(bnd, L, 1, M);
+      if (p7_ForwardBanded (dsq, L, om, bnd, fwd,      &fbsc) != eslOK) esl_fatal(msg);
+      if (p7_BackwardBanded(dsq, L, om, bnd, fwd, bck, &bbsc) != eslOK) esl_fatal(msg);
+      if (fabs(fbsc-bbsc) > 0.0001) esl_fatal(msg);
+      if (fbsc > fsc + 0.0001)      esl_fatal(msg);
+    }
+
+  free(dsq);
+  p7_gbands_Destroy(bnd);
+  p7_hmm_Destroy(hmm);
+  p7_omx_Destroy(bck);
+  p7_omx_Destroy(fwd);
+  p7_profile_Destroy(gm);
+  p7_oprofile_Destroy(om);
+}
 #endif /*p7FWDBACK_TESTDRIVE*/
 /*---------------------- end, unit tests ------------------------*/
 
@@ -998,6 +1546,7 @@ main(int argc, char **argv)
   utest_fwdback(r, abc, bg, M, L, N);   /* normal sized models */
   utest_fwdback(r, abc, bg, 1, L, 10);  /* size 1 models       */
   utest_fwdback(r, abc, bg, M, 1, 10);  /* size 1 sequences    */
+  utest_banded (r, abc, bg, M, L, N);
 
   esl_alphabet_Destroy(abc);
   p7_bg_Destroy(bg);
@@ -1009,6 +1558,8 @@ main(int argc, char **argv)
   utest_fwdback(r, abc, bg, M, L, N);   
   utest_fwdback(r, abc, bg, 1, L, 10);  
   utest_fwdback(r, abc, bg, M, 1, 10);  
+  utest_banded (r, abc, bg, M, L, N);
+  utest_banded (r, abc, bg, M, 1, 10);
 
   esl_alphabet_Destroy(abc);
   p7_bg_Destroy(bg);
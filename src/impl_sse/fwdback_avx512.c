@@ -0,0 +1,755 @@
+/* Forward/Backward parsers; AVX-512 version.
+ *
+ * Same algorithms as the parsing (linear memory) mode of fwdback.c,
+ * with 16-way float vectors. The striped scores <om->rfv_avx512>,
+ * <om->tfv_avx512> are derived from the SSE ones by
+ * p7_oprofile_RestripeFB_avx512(). Only the parsers are vectorized
+ * this way: they are what the acceleration pipeline runs on every
+ * sequence that passes the Viterbi filter, and they keep only the
+ * special states in the <xmx> rows, so posterior decoding of domain
+ * regions (p7_DomainDecoding()) works unchanged on their output. The
+ * full matrix routines (Forward, Backward, Decoding, OA) still use
+ * the SSE layout.
+ *
+ * Floating point sums are done in a different order than the SSE
+ * version, so scores differ from it by roundoff.
+ *
+ * Compiled unless HMMER is configured with --disable-avx512, or the compiler
+ * can't generate AVX-512; called only through dispatch.c, when
+ * the processor supports it.
+ *
+ * Contents:
+ *   1. Forward/Backward parser implementations.
+ *   2. Benchmark driver.
+ *   3. Unit tests.
+ *   4. Test driver.
+ */
+#include "p7_config.h"
+#ifdef eslENABLE_AVX512
+
+#include <stdio.h>
+#include <math.h>
+
+#include <immintrin.h>		/* AVX-512 */
+
+#include "easel.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+
+/*****************************************************************
+ * 1. Forward/Backward parser implementations.
+ *****************************************************************/
+
+/* Function:  p7_ForwardParser_avx512()
+ * Synopsis:  The Forward algorithm, linear memory parsing version, 16-way AVX-512.
+ *
+ * Purpose:   Same as <p7_ForwardParser_sse()>, using the AVX-512 score
+ *            arrays in <om> and the AVX-512 row <ox->dpf_avx512> of
+ *            the DP matrix. The special (BENCJ) state values and
+ *            scale factors are stored in <ox->xmx> as usual.
+ *
+ *            The D->D paths are extended until they stop changing
+ *            any D cell; with 16 lanes, full serialization would
+ *            take 16 passes, but most rows converge in a few.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <ox> allocation is too small, or if the profile
+ *            isn't in local alignment mode.
+ *            <eslERANGE> if the score exceeds the limited range of
+ *            a probability-space odds ratio.
+ *            In either case, <*opt_sc> is undefined.
+ */
+int
+p7_ForwardParser_avx512(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *opt_sc)
+{
+  register __m512 mpv, dpv, ipv;   /* previous row values                                       */
+  register __m512 sv;		   /* temp storage of 1 curr row value in progress              */
+  register __m512 dcv;		   /* delayed storage of D(i,q+1)                               */
+  register __m512 xEv;		   /* E state: keeps sum for Mk->E as we go                     */
+  register __m512 xBv;		   /* B state: splatted vector of B[i-1] for B->Mk calculations */
+  __m512   zerov;		   /* splatted 0.0's in a vector                                */
+  __mmask16 cv;			   /* lanes in which a DD pass changed some DMO(q)              */
+  float    xN, xE, xB, xC, xJ;	   /* special states' scores                                    */
+  int i;			   /* counter over sequence positions 1..L                      */
+  int q;			   /* counter over vectors 0..nq-1                              */
+  int j;			   /* counter over DD iterations (16 is full serialization)     */
+  int Q       = p7O_NQF_AVX512(om->M); /* segment length: # of vectors                          */
+  __m512 *dpc = ox->dpf_avx512;    /* current row, for use in {MDI}MO(dpc,q) access macro       */
+  __m512 *dpp = ox->dpf_avx512;    /* previous row: same memory, parsing mode keeps one row     */
+  __m512 *rp;			   /* will point at om->rfv_avx512[x] for residue x[i]          */
+  __m512 *tp;			   /* will point into (and step thru) om->tfv_avx512            */
+
+  if (Q > ox->allocQF_avx512)         ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few columns)");
+  if (! (om->layout & p7_ISA_AVX512)) ESL_EXCEPTION(eslEINVAL, "profile has no AVX-512 score layout");
+#if eslDEBUGLEVEL > 0
+  if (L     >= ox->allocXR)      ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few X rows)");
+  if (! p7_oprofile_IsLocal(om)) ESL_EXCEPTION(eslEINVAL, "Forward implementation makes assumptions that only work for local alignment");
+#endif
+
+  /* Initialization. */
+  ox->M  = om->M;
+  ox->L  = L;
+  ox->has_own_scales = TRUE; 	/* all forward matrices control their own scalefactors */
+  zerov  = _mm512_setzero_ps();
+  for (q = 0; q < Q; q++)
+    MMO(dpc,q) = IMO(dpc,q) = DMO(dpc,q) = zerov;
+  xE    = ox->xmx[p7X_E] = 0.;
+  xN    = ox->xmx[p7X_N] = 1.;
+  xJ    = ox->xmx[p7X_J] = 0.;
+  xB    = ox->xmx[p7X_B] = om->xf[p7O_N][p7O_MOVE];
+  xC    = ox->xmx[p7X_C] = 0.;
+
+  ox->xmx[p7X_SCALE] = 1.0;
+  ox->totscale       = 0.0;
+
+  for (i = 1; i <= L; i++)
+    {
+      rp    = om->rfv_avx512[dsq[i]];
+      tp    = om->tfv_avx512;
+      dcv   = _mm512_setzero_ps();
+      xEv   = _mm512_setzero_ps();
+      xBv   = _mm512_set1_ps(xB);
+
+      /* Right shifts by one lane, shifting zero on. */
+      mpv   = p7_avx512_rightshift_ps(MMO(dpp,Q-1));
+      dpv   = p7_avx512_rightshift_ps(DMO(dpp,Q-1));
+      ipv   = p7_avx512_rightshift_ps(IMO(dpp,Q-1));
+
+      for (q = 0; q < Q; q++)
+	{
+	  /* Calculate new MMO(i,q); don't store it yet, hold it in sv. */
+	  sv   =                   _mm512_mul_ps(xBv, *tp);  tp++;
+	  sv   = _mm512_fmadd_ps(mpv, *tp, sv);              tp++;
+	  sv   = _mm512_fmadd_ps(ipv, *tp, sv);              tp++;
+	  sv   = _mm512_fmadd_ps(dpv, *tp, sv);              tp++;
+	  sv   = _mm512_mul_ps(sv, *rp);                     rp++;
+	  xEv  = _mm512_add_ps(xEv, sv);
+
+	  /* Load {MDI}(i-1,q) into mpv, dpv, ipv;
+	   * {MDI}MX(q) is then the current, not the prev row
+	   */
+	  mpv = MMO(dpp,q);
+	  dpv = DMO(dpp,q);
+	  ipv = IMO(dpp,q);
+
+	  /* Do the delayed stores of {MD}(i,q) now that memory is usable */
+	  MMO(dpc,q) = sv;
+	  DMO(dpc,q) = dcv;
+
+	  /* Calculate the next D(i,q+1) partially: M->D only;
+           * delay storage, holding it in dcv
+	   */
+	  dcv   = _mm512_mul_ps(sv, *tp); tp++;
+
+	  /* Calculate and store I(i,q); assumes odds ratio for emission is 1.0 */
+	  sv         =                 _mm512_mul_ps(mpv, *tp);  tp++;
+	  IMO(dpc,q) = _mm512_fmadd_ps(ipv, *tp, sv);            tp++;
+	}
+
+      /* Now the DD paths. One complete pass, adding M->D and D->D into DMO(q). */
+      dcv        = p7_avx512_rightshift_ps(dcv);
+      DMO(dpc,0) = zerov;
+      tp         = om->tfv_avx512 + 7*Q;	/* set tp to start of the DD's */
+      for (q = 0; q < Q; q++)
+	{
+	  DMO(dpc,q) = _mm512_add_ps(dcv, DMO(dpc,q));
+	  dcv        = _mm512_mul_ps(DMO(dpc,q), *tp); tp++; /* extend DMO(q), so we include M->D and D->D paths */
+	}
+
+      /* Then extend only the DD component, until it no longer
+       * changes any DMO(q). The compare result is a lane mask, so
+       * the test costs no extra instructions over the SSE version.
+       */
+      for (j = 1; j < 16; j++)
+	{
+	  dcv = p7_avx512_rightshift_ps(dcv);
+	  tp  = om->tfv_avx512 + 7*Q;	/* set tp to start of the DD's */
+	  cv  = 0;
+	  for (q = 0; q < Q; q++)
+	    {
+	      sv         = _mm512_add_ps(dcv, DMO(dpc,q));
+	      cv        |= _mm512_cmp_ps_mask(sv, DMO(dpc,q), _CMP_GT_OQ);
+	      DMO(dpc,q) = sv;	                                     /* store new DMO(q) */
+	      dcv        = _mm512_mul_ps(dcv, *tp);   tp++;          /* note, extend dcv, not DMO(q) */
+	    }
+	  if (! cv) break; /* DD's didn't change any DMO(q)? Then done, break out. */
+	}
+
+      /* Add D's to xEv, and take the horizontal sum */
+      for (q = 0; q < Q; q++) xEv = _mm512_add_ps(DMO(dpc,q), xEv);
+      xE = _mm512_reduce_add_ps(xEv);
+
+      xN =  xN * om->xf[p7O_N][p7O_LOOP];
+      xC = (xC * om->xf[p7O_C][p7O_LOOP]) +  (xE * om->xf[p7O_E][p7O_MOVE]);
+      xJ = (xJ * om->xf[p7O_J][p7O_LOOP]) +  (xE * om->xf[p7O_E][p7O_LOOP]);
+      xB = (xJ * om->xf[p7O_J][p7O_MOVE]) +  (xN * om->xf[p7O_N][p7O_MOVE]);
+      /* and now xB will carry over into next i, and xC carries over after i=L */
+
+      /* Sparse rescaling. xE above threshold? trigger a rescaling event.            */
+      if (xE > 1.0e4)	/* that's a little less than e^10, ~10% of our dynamic range */
+	{
+	  xN  = xN / xE;
+	  xC  = xC / xE;
+	  xJ  = xJ / xE;
+	  xB  = xB / xE;
+	  xEv = _mm512_set1_ps(1.0 / xE);
+	  for (q = 0; q < Q; q++)
+	    {
+	      MMO(dpc,q) = _mm512_mul_ps(MMO(dpc,q), xEv);
+	      DMO(dpc,q) = _mm512_mul_ps(DMO(dpc,q), xEv);
+	      IMO(dpc,q) = _mm512_mul_ps(IMO(dpc,q), xEv);
+	    }
+	  ox->xmx[i*p7X_NXCELLS+p7X_SCALE] = xE;
+	  ox->totscale += log(xE);
+	  xE = 1.0;
+	}
+      else ox->xmx[i*p7X_NXCELLS+p7X_SCALE] = 1.0;
+
+      ox->xmx[i*p7X_NXCELLS+p7X_E] = xE;
+      ox->xmx[i*p7X_NXCELLS+p7X_N] = xN;
+      ox->xmx[i*p7X_NXCELLS+p7X_J] = xJ;
+      ox->xmx[i*p7X_NXCELLS+p7X_B] = xB;
+      ox->xmx[i*p7X_NXCELLS+p7X_C] = xC;
+    } /* end loop over sequence residues 1..L */
+
+  /* finally C->T, and flip total score back to log space (nats) */
+  if       (isnan(xC))        ESL_EXCEPTION(eslERANGE, "forward score is NaN");
+  else if  (L>0 && xC == 0.0) ESL_EXCEPTION(eslERANGE, "forward score underflow (is 0.0)");
+  else if  (isinf(xC) == 1)   ESL_EXCEPTION(eslERANGE, "forward score overflow (is infinity)");
+
+  if (opt_sc != NULL) *opt_sc = ox->totscale + log(xC * om->xf[p7O_C][p7O_MOVE]);
+  return eslOK;
+}
+
+
+/* backward_dd()
+ * Extend the D->D paths leftward from <dcv> (the D->D contribution
+ * leaving the last pass) until they stop changing any DMO(q), or
+ * until 16 passes have fully serialized them.
+ */
+static inline void
+backward_dd(const P7_OPROFILE *om, __m512 *dpc, __m512 dcv, int Q)
+{
+  __m512   *tp;
+  __m512    sv;
+  __mmask16 cv;
+  int       q, j;
+
+  for (j = 1; j < 16; j++)
+    {
+      dcv = p7_avx512_leftshift_ps(dcv);
+      tp  = om->tfv_avx512 + 8*Q - 1;	/* <*tp> now the last TDD vector */
+      cv  = 0;
+      for (q = Q-1; q >= 0; q--)
+	{
+	  dcv        = _mm512_mul_ps(dcv, *tp); tp--;
+	  sv         = _mm512_add_ps(DMO(dpc,q), dcv);
+	  cv        |= _mm512_cmp_ps_mask(sv, DMO(dpc,q), _CMP_GT_OQ);
+	  DMO(dpc,q) = sv;
+	}
+      if (! cv) break;
+    }
+}
+
+
+/* Function:  p7_BackwardParser_avx512()
+ * Synopsis:  The Backward algorithm, linear memory parsing version, 16-way AVX-512.
+ *
+ * Purpose:   Same as <p7_BackwardParser_sse()>, using the AVX-512
+ *            score arrays in <om> and the AVX-512 row
+ *            <bck->dpf_avx512> of the DP matrix. Sparse scale factors
+ *            are taken from the Forward parsing matrix <fwd>, which
+ *            may have been calculated by either parser.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <bck> allocation is too small, or if the profile
+ *            isn't in local alignment mode.
+ *            <eslERANGE> if the score exceeds the limited range of
+ *            a probability-space odds ratio.
+ *            In either case, <*opt_sc> is undefined.
+ */
+int
+p7_BackwardParser_avx512(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc)
+{
+  register __m512 mpv, ipv, dpv;      /* previous row values                                       */
+  register __m512 mcv, dcv;           /* current row values                                        */
+  register __m512 tmmv, timv, tdmv;   /* tmp vars for accessing rotated transition scores          */
+  register __m512 xBv;		      /* collects B->Mk components of B(i)                         */
+  register __m512 xEv;	              /* splatted E(i)                                             */
+  __m512   zerov;		      /* splatted 0.0's in a vector                                */
+  float    xN, xE, xB, xC, xJ;	      /* special states' scores                                    */
+  int      i;			      /* counter over sequence positions 0,1..L                    */
+  int      q;			      /* counter over vectors 0..Q-1                               */
+  int      Q       = p7O_NQF_AVX512(om->M); /* segment length: # of vectors                        */
+  __m512  *dpc     = bck->dpf_avx512; /* current DP row                                            */
+  __m512  *dpp     = bck->dpf_avx512; /* next ("previous") DP row: same memory in parsing mode     */
+  __m512  *rp;			      /* will point into om->rfv_avx512[x] for residue x[i+1]      */
+  __m512  *tp;		              /* will point into (and step thru) om->tfv_avx512            */
+
+  if (Q > bck->allocQF_avx512)        ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few columns)");
+  if (! (om->layout & p7_ISA_AVX512)) ESL_EXCEPTION(eslEINVAL, "profile has no AVX-512 score layout");
+#if eslDEBUGLEVEL > 0
+  if (L     >= bck->allocXR)      ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few X rows)");
+  if (L     != fwd->L)            ESL_EXCEPTION(eslEINVAL, "fwd matrix size doesn't agree with length L");
+  if (! p7_oprofile_IsLocal(om))  ESL_EXCEPTION(eslEINVAL, "Forward implementation makes assumptions that only work for local alignment");
+#endif
+
+  /* initialize the L row. */
+  bck->M = om->M;
+  bck->L = L;
+  bck->has_own_scales = FALSE;	/* backwards scale factors are *usually* given by <fwd> */
+  xJ     = 0.0;
+  xB     = 0.0;
+  xN     = 0.0;
+  xC     = om->xf[p7O_C][p7O_MOVE];      /* C<-T */
+  xE     = xC * om->xf[p7O_E][p7O_MOVE]; /* E<-C, no tail */
+  xEv    = _mm512_set1_ps(xE);
+  zerov  = _mm512_setzero_ps();
+  dcv    = zerov;		/* solely to silence a compiler warning */
+  for (q = 0; q < Q; q++) MMO(dpc,q) = DMO(dpc,q) = xEv;
+  for (q = 0; q < Q; q++) IMO(dpc,q) = zerov;
+
+  /* init row L's DD paths, 1) first segment includes xE, from DMO(q) */
+  tp  = om->tfv_avx512 + 8*Q - 1;	/* <*tp> now the last TDD vector */
+  dpv = p7_avx512_leftshift_ps(DMO(dpc,0));
+  for (q = Q-1; q >= 0; q--)
+    {
+      dcv        = _mm512_mul_ps(dpv, *tp);      tp--;
+      DMO(dpc,q) = _mm512_add_ps(DMO(dpc,q), dcv);
+      dpv        = DMO(dpc,q);
+    }
+  /* 2) more passes, only extending DD component (dcv only; no xE contrib from DMO(q)) */
+  backward_dd(om, dpc, dcv, Q);
+
+  /* now MD init */
+  tp  = om->tfv_avx512 + 7*Q - 3;	/* <*tp> now the last Mk->Dk+1 vector */
+  dcv = p7_avx512_leftshift_ps(DMO(dpc,0));
+  for (q = Q-1; q >= 0; q--)
+    {
+      MMO(dpc,q) = _mm512_fmadd_ps(dcv, *tp, MMO(dpc,q)); tp -= 7;
+      dcv        = DMO(dpc,q);
+    }
+
+  /* Sparse rescaling: same scale factors as fwd matrix */
+  if (fwd->xmx[L*p7X_NXCELLS+p7X_SCALE] > 1.0)
+    {
+      xE  = xE / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
+      xN  = xN / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
+      xC  = xC / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
+      xJ  = xJ / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
+      xB  = xB / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
+      xEv = _mm512_set1_ps(1.0 / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE]);
+      for (q = 0; q < Q; q++) {
+	MMO(dpc,q) = _mm512_mul_ps(MMO(dpc,q), xEv);
+	DMO(dpc,q) = _mm512_mul_ps(DMO(dpc,q), xEv);
+	IMO(dpc,q) = _mm512_mul_ps(IMO(dpc,q), xEv);
+      }
+    }
+  bck->xmx[L*p7X_NXCELLS+p7X_SCALE] = fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
+  bck->totscale                     = log(bck->xmx[L*p7X_NXCELLS+p7X_SCALE]);
+
+  bck->xmx[L*p7X_NXCELLS+p7X_E] = xE;
+  bck->xmx[L*p7X_NXCELLS+p7X_N] = xN;
+  bck->xmx[L*p7X_NXCELLS+p7X_J] = xJ;
+  bck->xmx[L*p7X_NXCELLS+p7X_B] = xB;
+  bck->xmx[L*p7X_NXCELLS+p7X_C] = xC;
+
+  /* main recursion */
+  for (i = L-1; i >= 1; i--)	/* backwards stride */
+    {
+      /* phase 1. B(i) collected. Old row destroyed, new row contains
+       *    complete I(i,k), partial {MD}(i,k) w/ no {MD}->{DE} paths yet.
+       */
+      rp  = om->rfv_avx512[dsq[i+1]] + Q-1; /* <*rp> is now the last match emission vector */
+      tp  = om->tfv_avx512 + 7*Q - 1;	    /* <*tp> is now the last TII transition vector  */
+
+      /* leftshift the first transition vectors */
+      tmmv = p7_avx512_leftshift_ps(om->tfv_avx512[1]);
+      timv = p7_avx512_leftshift_ps(om->tfv_avx512[2]);
+      tdmv = p7_avx512_leftshift_ps(om->tfv_avx512[3]);
+
+      mpv = _mm512_mul_ps(MMO(dpp,0), om->rfv_avx512[dsq[i+1]][0]); /* precalc M(i+1,k+1) * e(M_k+1, x_{i+1}) */
+      mpv = p7_avx512_leftshift_ps(mpv);
+
+      xBv = zerov;
+      for (q = Q-1; q >= 0; q--)     /* backwards stride */
+	{
+	  ipv = IMO(dpp,q); /* assumes emission odds ratio of 1.0; i+1's IMO(q) now free */
+	  IMO(dpc,q) = _mm512_fmadd_ps(ipv, *tp, _mm512_mul_ps(mpv, timv));   tp--;
+	  DMO(dpc,q) =                           _mm512_mul_ps(mpv, tdmv);
+	  mcv        = _mm512_fmadd_ps(ipv, *tp, _mm512_mul_ps(mpv, tmmv));   tp-= 2;
+
+	  mpv        = _mm512_mul_ps(MMO(dpp,q), *rp);  rp--;  /* obtain mpv for next q. i+1's MMO(q) is freed  */
+	  MMO(dpc,q) = mcv;
+
+	  tdmv = *tp;   tp--;
+	  timv = *tp;   tp--;
+	  tmmv = *tp;   tp--;
+
+	  xBv = _mm512_fmadd_ps(mpv, *tp, xBv); tp--;
+	}
+
+      /* phase 2: now that we have accumulated the B->Mk transitions in xBv, we can do the specials */
+      xB = _mm512_reduce_add_ps(xBv);
+
+      xC =  xC * om->xf[p7O_C][p7O_LOOP];
+      xJ = (xB * om->xf[p7O_J][p7O_MOVE]) + (xJ * om->xf[p7O_J][p7O_LOOP]); /* must come after xB */
+      xN = (xB * om->xf[p7O_N][p7O_MOVE]) + (xN * om->xf[p7O_N][p7O_LOOP]); /* must come after xB */
+      xE = (xC * om->xf[p7O_E][p7O_MOVE]) + (xJ * om->xf[p7O_E][p7O_LOOP]); /* must come after xJ, xC */
+      xEv = _mm512_set1_ps(xE);	/* splat */
+
+      /* phase 3: {MD}->E paths and one step of the D->D paths */
+      tp  = om->tfv_avx512 + 8*Q - 1;	/* <*tp> now the last TDD vector */
+      dpv = p7_avx512_leftshift_ps(_mm512_add_ps(DMO(dpc,0), xEv));
+      for (q = Q-1; q >= 0; q--)
+	{
+	  dcv        = _mm512_mul_ps(dpv, *tp); tp--;
+	  DMO(dpc,q) = _mm512_add_ps(DMO(dpc,q), _mm512_add_ps(dcv, xEv));
+	  dpv        = DMO(dpc,q);
+	  MMO(dpc,q) = _mm512_add_ps(MMO(dpc,q), xEv);
+	}
+
+      /* phase 4: finish extending the DD paths */
+      backward_dd(om, dpc, dcv, Q);
+
+      /* phase 5: add M->D paths */
+      dcv = p7_avx512_leftshift_ps(DMO(dpc,0));
+      tp  = om->tfv_avx512 + 7*Q - 3;	/* <*tp> is now the last Mk->Dk+1 vector */
+      for (q = Q-1; q >= 0; q--)
+	{
+	  MMO(dpc,q) = _mm512_fmadd_ps(dcv, *tp, MMO(dpc,q)); tp -= 7;
+	  dcv        = DMO(dpc,q);
+	}
+
+      /* Sparse rescaling; see backward_engine() in fwdback.c for
+       * why we may have to switch to our own scale factors [J3/119].
+       */
+      if (xB > 1.0e16) bck->has_own_scales = TRUE;
+
+      if      (bck->has_own_scales)  bck->xmx[i*p7X_NXCELLS+p7X_SCALE] = (xB > 1.0e4) ? xB : 1.0;
+      else                           bck->xmx[i*p7X_NXCELLS+p7X_SCALE] = fwd->xmx[i*p7X_NXCELLS+p7X_SCALE];
+
+      if (bck->xmx[i*p7X_NXCELLS+p7X_SCALE] > 1.0)
+	{
+	  xE /= bck->xmx[i*p7X_NXCELLS+p7X_SCALE];
+	  xN /= bck->xmx[i*p7X_NXCELLS+p7X_SCALE];
+	  xJ /= bck->xmx[i*p7X_NXCELLS+p7X_SCALE];
+	  xB /= bck->xmx[i*p7X_NXCELLS+p7X_SCALE];
+	  xC /= bck->xmx[i*p7X_NXCELLS+p7X_SCALE];
+	  xBv = _mm512_set1_ps(1.0 / bck->xmx[i*p7X_NXCELLS+p7X_SCALE]);
+	  for (q = 0; q < Q; q++) {
+	    MMO(dpc,q) = _mm512_mul_ps(MMO(dpc,q), xBv);
+	    DMO(dpc,q) = _mm512_mul_ps(DMO(dpc,q), xBv);
+	    IMO(dpc,q) = _mm512_mul_ps(IMO(dpc,q), xBv);
+	  }
+	  bck->totscale += log(bck->xmx[i*p7X_NXCELLS+p7X_SCALE]);
+	}
+
+      bck->xmx[i*p7X_NXCELLS+p7X_E] = xE;
+      bck->xmx[i*p7X_NXCELLS+p7X_N] = xN;
+      bck->xmx[i*p7X_NXCELLS+p7X_J] = xJ;
+      bck->xmx[i*p7X_NXCELLS+p7X_B] = xB;
+      bck->xmx[i*p7X_NXCELLS+p7X_C] = xC;
+    } /* thus ends the loop over sequence positions i */
+
+  /* Termination at i=0, where we can only reach N,B states. */
+  tp  = om->tfv_avx512;          /* <*tp> is now the first TBMk transition vector */
+  rp  = om->rfv_avx512[dsq[1]];  /* <*rp> is now the first match emission vector  */
+  xBv = zerov;
+  for (q = 0; q < Q; q++)
+    {
+      mpv = _mm512_mul_ps(MMO(dpp,q), *rp);  rp++;
+      xBv = _mm512_fmadd_ps(mpv, *tp, xBv);  tp += 7;
+    }
+  xB = _mm512_reduce_add_ps(xBv);
+
+  xN = (xB * om->xf[p7O_N][p7O_MOVE]) + (xN * om->xf[p7O_N][p7O_LOOP]);
+
+  bck->xmx[p7X_B]     = xB;
+  bck->xmx[p7X_C]     = 0.0;
+  bck->xmx[p7X_J]     = 0.0;
+  bck->xmx[p7X_N]     = xN;
+  bck->xmx[p7X_E]     = 0.0;
+  bck->xmx[p7X_SCALE] = 1.0;
+
+  if       (isnan(xN))        ESL_EXCEPTION(eslERANGE, "backward score is NaN");
+  else if  (L>0 && xN == 0.0) ESL_EXCEPTION(eslERANGE, "backward score underflow (is 0.0)");
+  else if  (isinf(xN) == 1)   ESL_EXCEPTION(eslERANGE, "backward score overflow (is infinity)");
+
+  if (opt_sc != NULL) *opt_sc = bck->totscale + log(xN);
+  return eslOK;
+}
+/*-------------- end, forward/backward parsers ------------------*/
+
+
+
+/*****************************************************************
+ * 2. Benchmark driver.
+ *****************************************************************/
+#ifdef p7FWDBACK_AVX512_BENCHMARK
+/*
+   ./fwdback_avx512_benchmark <hmmfile>            runs benchmark
+   ./fwdback_avx512_benchmark -s <hmmfile>         runs the SSE version, for comparison
+ */
+#include "p7_config.h"
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+#include "esl_randomseq.h"
+#include "esl_stopwatch.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",             0 },
+  { "-r",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "set random number seed randomly",                  0 },
+  { "-s",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "run the SSE version instead, for comparison",      0 },
+  { "-B",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "also run the Backward parser",                     0 },
+  { "-L",        eslARG_INT,    "400", NULL, "n>0", NULL,  NULL, NULL, "length of random target seqs",                     0 },
+  { "-N",        eslARG_INT,   "2000", NULL, "n>0", NULL,  NULL, NULL, "number of random target seqs",                     0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options] <hmmfile>";
+static char banner[] = "benchmark driver for the AVX-512 Forward/Backward parsers";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go      = p7_CreateDefaultApp(options, 1, argc, argv, banner, usage);
+  char           *hmmfile = esl_opt_GetArg(go, 1);
+  ESL_STOPWATCH  *w       = esl_stopwatch_Create();
+  ESL_RANDOMNESS *r       = esl_randomness_CreateFast(esl_opt_GetBoolean(go, "-r") ? 0 : 42);
+  ESL_ALPHABET   *abc     = NULL;
+  P7_HMMFILE     *hfp     = NULL;
+  P7_HMM         *hmm     = NULL;
+  P7_BG          *bg      = NULL;
+  P7_PROFILE     *gm      = NULL;
+  P7_OPROFILE    *om      = NULL;
+  P7_OMX         *fwd     = NULL;
+  P7_OMX         *bck     = NULL;
+  int             L       = esl_opt_GetInteger(go, "-L");
+  int             N       = esl_opt_GetInteger(go, "-N");
+  ESL_DSQ        *dsq     = malloc(sizeof(ESL_DSQ) * (L+2));
+  int             i;
+  float           sc;
+  double          base_time, bench_time, Mcs;
+
+  /* select the AVX-512 level before any profile is made, so profiles carry its layout */
+  if (p7_dispatch_Select(p7_ISA_AVX512) != eslOK) p7_Fail("This processor doesn't support AVX-512");
+  if (p7_hmmfile_OpenE(hmmfile, NULL, &hfp, NULL) != eslOK) p7_Fail("Failed to open HMM file %s", hmmfile);
+  if (p7_hmmfile_Read(hfp, &abc, &hmm)            != eslOK) p7_Fail("Failed to read HMM");
+
+  bg = p7_bg_Create(abc);
+  p7_bg_SetLength(bg, L);
+  gm = p7_profile_Create(hmm->M, abc);
+  p7_ProfileConfig(hmm, bg, gm, L, p7_LOCAL);
+  om = p7_oprofile_Create(gm->M, abc);
+  p7_oprofile_Convert(gm, om);
+  p7_oprofile_ReconfigLength(om, L);
+  fwd = p7_omx_Create(gm->M, 0, L);
+  bck = p7_omx_Create(gm->M, 0, L);
+
+  esl_stopwatch_Start(w);
+  for (i = 0; i < N; i++) esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+  esl_stopwatch_Stop(w);
+  base_time = w->user;
+
+  esl_stopwatch_Start(w);
+  for (i = 0; i < N; i++)
+    {
+      esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+      if (esl_opt_GetBoolean(go, "-s"))
+	{
+	  p7_ForwardParser_sse(dsq, L, om, fwd, &sc);
+	  if (esl_opt_GetBoolean(go, "-B")) p7_BackwardParser_sse(dsq, L, om, fwd, bck, NULL);
+	}
+      else
+	{
+	  p7_ForwardParser_avx512(dsq, L, om, fwd, &sc);
+	  if (esl_opt_GetBoolean(go, "-B")) p7_BackwardParser_avx512(dsq, L, om, fwd, bck, NULL);
+	}
+    }
+  esl_stopwatch_Stop(w);
+  bench_time = w->user - base_time;
+  Mcs        = (double) N * (double) L * (double) gm->M * 1e-6 / (double) bench_time;
+  esl_stopwatch_Display(stdout, w, "# CPU time: ");
+  printf("# M    = %d\n",   gm->M);
+  printf("# %.1f Mc/s\n", Mcs);
+
+  free(dsq);
+  p7_omx_Destroy(bck);
+  p7_omx_Destroy(fwd);
+  p7_oprofile_Destroy(om);
+  p7_profile_Destroy(gm);
+  p7_bg_Destroy(bg);
+  p7_hmm_Destroy(hmm);
+  p7_hmmfile_Close(hfp);
+  esl_alphabet_Destroy(abc);
+  esl_stopwatch_Destroy(w);
+  esl_randomness_Destroy(r);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /*p7FWDBACK_AVX512_BENCHMARK*/
+/*---------------- end, benchmark driver ------------------------*/
+
+
+
+/*****************************************************************
+ * 3. Unit tests.
+ *****************************************************************/
+#ifdef p7FWDBACK_AVX512_TESTDRIVE
+#include "esl_random.h"
+#include "esl_randomseq.h"
+
+/* utest_compare()
+ *
+ * The AVX-512 parsers must agree with the SSE ones, up to float
+ * roundoff, and Forward must agree with Backward. Compare them for a
+ * random model of length <M> on <N> iid sequences of length <L>, and
+ * on <N> sequences emitted from the model, which exercise the D->D
+ * paths and the sparse rescaling.
+ */
+static void
+utest_compare(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  char         msg[] = "fwdback_avx512 compare unit test failed";
+  P7_HMM      *hmm   = NULL;
+  P7_PROFILE  *gm    = NULL;
+  P7_OPROFILE *om    = NULL;
+  ESL_SQ      *sq    = esl_sq_CreateDigital(abc);
+  P7_OMX      *fwd   = p7_omx_Create(M, 0, L);
+  P7_OMX      *bck   = p7_omx_Create(M, 0, L);
+  float        fsc1, fsc2;
+  float        bsc1, bsc2;
+  int          n;
+
+  if (p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om) != eslOK) esl_fatal(msg);
+
+  for (n = 0; n < 2*N; n++)
+    {
+      if (n < N) { if (esl_sq_GrowTo(sq, L) != eslOK) esl_fatal(msg); esl_rsq_xfIID(r, bg->f, abc->K, L, sq->dsq); sq->n = L; }
+      else if (p7_ProfileEmit(r, hmm, gm, bg, sq, NULL) != eslOK) esl_fatal(msg);
+
+      p7_oprofile_ReconfigLength(om, sq->n);
+      if (p7_omx_GrowTo(fwd, M, 0, sq->n) != eslOK) esl_fatal(msg);
+      if (p7_omx_GrowTo(bck, M, 0, sq->n) != eslOK) esl_fatal(msg);
+
+      if (p7_ForwardParser_sse    (sq->dsq, sq->n, om, fwd,      &fsc1) != eslOK) esl_fatal(msg);
+      if (p7_BackwardParser_sse   (sq->dsq, sq->n, om, fwd, bck, &bsc1) != eslOK) esl_fatal(msg);
+      if (p7_ForwardParser_avx512 (sq->dsq, sq->n, om, fwd,      &fsc2) != eslOK) esl_fatal(msg);
+      if (p7_BackwardParser_avx512(sq->dsq, sq->n, om, fwd, bck, &bsc2) != eslOK) esl_fatal(msg);
+
+      if (fabs(fsc2-bsc2) > 0.0001) esl_fatal("%s: fwd %f != bck %f", msg, fsc2, bsc2);
+      if (fabs(fsc1-fsc2) > 0.001)  esl_fatal("%s: sse fwd %f != avx512 fwd %f", msg, fsc1, fsc2);
+      if (fabs(bsc1-bsc2) > 0.001)  esl_fatal("%s: sse bck %f != avx512 bck %f", msg, bsc1, bsc2);
+
+      esl_sq_Reuse(sq);
+    }
+
+  esl_sq_Destroy(sq);
+  p7_hmm_Destroy(hmm);
+  p7_omx_Destroy(bck);
+  p7_omx_Destroy(fwd);
+  p7_profile_Destroy(gm);
+  p7_oprofile_Destroy(om);
+}
+#endif /*p7FWDBACK_AVX512_TESTDRIVE*/
+
+
+/*****************************************************************
+ * 4. Test driver
+ *****************************************************************/
+#ifdef p7FWDBACK_AVX512_TESTDRIVE
+/*
+   gcc -g -Wall -mavx512f -std=gnu99 -I.. -L.. -I../../easel -L../../easel -o fwdback_avx512_utest -Dp7FWDBACK_AVX512_TESTDRIVE fwdback_avx512.c -lhmmer -leasel -lm
+   ./fwdback_avx512_utest
+ */
+#include "p7_config.h"
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_sq.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",           0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                  0 },
+  { "-v",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "be verbose",                                     0 },
+  { "-L",        eslARG_INT,    "200", NULL, NULL,  NULL,  NULL, NULL, "size of random sequences to sample",             0 },
+  { "-M",        eslARG_INT,    "145", NULL, NULL,  NULL,  NULL, NULL, "size of random models to sample",                0 },
+  { "-N",        eslARG_INT,    "100", NULL, NULL,  NULL,  NULL, NULL, "number of random sequences to sample",           0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for the AVX-512 Forward/Backward parsers";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go   = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *r    = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *abc  = NULL;
+  P7_BG          *bg   = NULL;
+  int             M    = esl_opt_GetInteger(go, "-M");
+  int             L    = esl_opt_GetInteger(go, "-L");
+  int             N    = esl_opt_GetInteger(go, "-N");
+
+  /* On a processor without AVX-512 there's nothing to test; pass. */
+  if (p7_dispatch_Select(p7_ISA_AVX512) != eslOK) {
+    if (esl_opt_GetBoolean(go, "-v")) printf("No AVX-512 on this processor; skipping tests\n");
+    esl_randomness_Destroy(r);
+    esl_getopts_Destroy(go);
+    return eslOK;
+  }
+
+  if ((abc = esl_alphabet_Create(eslDNA)) == NULL)  esl_fatal("failed to create alphabet");
+  if ((bg = p7_bg_Create(abc))            == NULL)  esl_fatal("failed to create null model");
+
+  if (esl_opt_GetBoolean(go, "-v")) printf("Forward/BackwardParser_avx512() tests, DNA\n");
+  utest_compare(r, abc, bg, M, L, N);
+  utest_compare(r, abc, bg, 1, L, 10);
+  utest_compare(r, abc, bg, M, 1, 10);
+
+  esl_alphabet_Destroy(abc);
+  p7_bg_Destroy(bg);
+
+  if ((abc = esl_alphabet_Create(eslAMINO)) == NULL)  esl_fatal("failed to create alphabet");
+  if ((bg = p7_bg_Create(abc))              == NULL)  esl_fatal("failed to create null model");
+
+  if (esl_opt_GetBoolean(go, "-v")) printf("Forward/BackwardParser_avx512() tests, protein\n");
+  utest_compare(r, abc, bg, M, L, N);
+  utest_compare(r, abc, bg, 1, L, 10);
+  utest_compare(r, abc, bg, M, 1, 10);
+  utest_compare(r, abc, bg, 600, L, 10);
+
+  esl_alphabet_Destroy(abc);
+  p7_bg_Destroy(bg);
+
+  esl_getopts_Destroy(go);
+  esl_randomness_Destroy(r);
+  return eslOK;
+}
+#endif /*p7FWDBACK_AVX512_TESTDRIVE*/
+/*---------------------- end, test driver -----------------------*/
+
+
+#else /*! eslENABLE_AVX512*/
+/* Standard compiler-pleasing mantra for an #ifdef'd-out, empty code file. */
+void p7_fwdback_avx512_silence_hack(void) { return; }
+#if defined p7FWDBACK_AVX512_TESTDRIVE || defined p7FWDBACK_AVX512_BENCHMARK
+int main(void) { return 0; }
+#endif
+#endif /*eslENABLE_AVX512*/
@@ -16,6 +16,9 @@
 #ifdef __SSE3__
 #include <pmmintrin.h>   /* DENORMAL_MODE */
 #endif
+#if defined(eslENABLE_AVX) || defined(eslENABLE_AVX512)
+#include <immintrin.h>    /* AVX2, AVX-512 */
+#endif
 #include "hmmer.h"
 
 /* In calculating Q, the number of vectors we need in a row, we have
@@ -27,6 +30,21 @@
 
 #define p7O_EXTRA_SB 17    /* see ssvfilter.c for explanation */
 
+/* The AVX2 filters use the same striped layouts, 2x as wide. */
+#define p7O_NQB_AVX(M)   ( ESL_MAX(2, ((((M)-1) / 32) + 1)))   /* 32 uchars  */
+#define p7O_NQW_AVX(M)   ( ESL_MAX(2, ((((M)-1) / 16) + 1)))   /* 16 words   */
+
+/* The AVX-512 Forward/Backward parsers use 16 floats per vector. */
+#define p7O_NQF_AVX512(M) ( ESL_MAX(2, ((((M)-1) / 16) + 1)))  /* 16 floats  */
+
+/* Instruction sets we have kernels for. Levels for the runtime
+ * dispatcher (dispatch.c), and flags for the striped score layouts
+ * a P7_OPROFILE carries (om->layout).
+ */
+#define p7_ISA_SSE     (1<<0)
+#define p7_ISA_AVX     (1<<1)     /* AVX2    */
+#define p7_ISA_AVX512  (1<<2)     /* AVX-512F */
+
 
 /*****************************************************************
  * 1. P7_OPROFILE: an optimized score profile
@@ -104,6 +122,34 @@ typedef struct p7_oprofile_s {
   __m128i  *twv_mem;
   __m128   *tfv_mem;
   __m128   *rfv_mem;
+
+#ifdef eslENABLE_AVX
+  /* AVX2 MSV/SSV and Viterbi filters: same scores as rbv, sbv, rwv, twv above,
+   * restriped for 32x uchar and 16x sword vectors. Filled from the SSE arrays
+   * by p7_oprofile_RestripeMSV_avx(), p7_oprofile_RestripeVF_avx().
+   */
+  __m256i **rbv_avx;       /* match scores [x][q]: [Kp][Q32]                    */
+  __m256i **sbv_avx;       /* ssvfilter match scores [x][q]: [Kp][Q32+EXTRA_SB] */
+  __m256i **rwv_avx;       /* [x][q]: [Kp][Q16]                                 */
+  __m256i  *twv_avx;       /* transition score blocks [8*Q16]                   */
+  __m256i  *rbv_avx_mem;
+  __m256i  *sbv_avx_mem;
+  __m256i  *rwv_avx_mem;
+  __m256i  *twv_avx_mem;
+  int       allocQB_avx;   /* p7O_NQB_AVX(allocM): alloc size for rbv_avx       */
+  int       allocQW_avx;   /* p7O_NQW_AVX(allocM): alloc size for rwv_avx       */
+#endif
+
+#ifdef eslENABLE_AVX512
+  /* AVX-512 Forward/Backward parsers: rfv, tfv restriped for 16x float vectors,
+   * by p7_oprofile_RestripeFB_avx512().
+   */
+  __m512  **rfv_avx512;    /* [x][q]: [Kp][Q16]                                 */
+  __m512   *tfv_avx512;    /* transition probability blocks [8*Q16]             */
+  __m512   *rfv_avx512_mem;
+  __m512   *tfv_avx512_mem;
+  int       allocQF_avx512; /* p7O_NQF_AVX512(allocM): alloc size for rfv_avx512 */
+#endif
   
   /* Disk offset information for hmmpfam's fast model retrieval                      */
   off_t  offs[p7_NOFFSETS];     /* p7_{MFP}OFFSET, or -1                             */
@@ -133,12 +179,15 @@ typedef struct p7_oprofile_s {
   int    allocQ4;    /* p7_NQF(allocM): alloc size for tf, rf             */
   int    allocQ8;    /* p7_NQW(allocM): alloc size for tw, rw             */
   int    allocQ16;    /* p7_NQB(allocM): alloc size for rb                 */
+  int    layout;                /* p7_ISA_* flags: score layouts allocated and set   */
   int    mode;      /* currently must be p7_LOCAL                        */
   float  nj;      /* expected # of J's: 0 or 1, uni vs. multihit       */
 
   int    clone;                 /* this optimized profile structure is just a copy   */
                                 /* of another profile structre.  all pointers of     */
                                 /* this structure should not be freed.               */
+  int    mapped;                /* TRUE if SSE scores and rf,mm,cs,consensus point   */
+                                /* into a mapped .h3f/.h3p (see io.c); not owned     */
 } P7_OPROFILE;
 
 typedef struct {
@@ -179,6 +228,12 @@ enum p7x_xcells_e { p7X_E = 0, p7X_N = 1, p7X_J = 2, p7X_B = 3, p7X_C = 4, p7X_S
  * xmx[] arrays for individual special states:
  *    xmx[ENJBC] = [0 1 2 3][4 5 6 7]..[L-2 L-1 L x]     XRQ >= (L/4)+1
  *    to access B[i] for example, for i=0..L:   xmx[B][i/4].x[i%4]  (quad i/4; element i%4).
+ *
+ * A checkpointed matrix (p7_omx_GrowToCheckpointed(), chkS = S > 0)
+ * still has row pointers dpf[0..L], but they share memory: checkpoint
+ * rows i%S==0, and row L, each have their own row; the rows in between
+ * share S-1 rows, so only the most recently calculated segment of them
+ * is valid. The xmx[] specials are always kept for all rows.
  */  
 typedef struct p7_omx_s {
   int       M;      /* current actual model dimension                              */
@@ -191,11 +246,35 @@ typedef struct p7_omx_s {
   void     *dp_mem;    /* DP memory shared by <dpb>, <dpw>, <dpf>                     */
   int       allocR;    /* current allocated # rows in dp{uf}. allocR >= validR >= L+1 */
   int       validR;    /* current # of rows actually pointing at DP memory            */
+  int       chkS;      /* checkpoint interval, for a checkpointed matrix; 0 = not     */
   int       allocQ4;    /* current set row width in <dpf> quads:   allocQ4*4 >= M      */
   int       allocQ8;    /* current set row width in <dpw> octets:  allocQ8*8 >= M      */
   int       allocQ16;    /* current set row width in <dpb> 16-mers: allocQ16*16 >= M    */
   size_t    ncells;    /* current allocation size of <dp_mem>, in accessible cells    */
 
+#ifdef eslENABLE_AVX
+  /* One row for the AVX2 filters, which never need more than that              */
+  __m256i  *dpb_avx;    /* one row [0..Q-1] of 32x uchar vectors for MSV                */
+  __m256i  *dpw_avx;    /* one row [0..Q-1][MDI] of 16x sword vectors for Viterbi       */
+  void     *avx_mem;    /* memory shared by <dpb_avx>, <dpw_avx>                       */
+  int       allocQB_avx;  /* current row width in <dpb_avx>: allocQB_avx*32 >= M      */
+  int       allocQW_avx;  /* current row width in <dpw_avx>: allocQW_avx*16 >= M      */
+#endif
+
+  /* Inter-sequence SSV (ssvfilter_interseq.c); allocated on first use                         */
+  int8_t  **isv_sc;         /* isv_sc[x][k-1]: SSV cost of residue x at node k, unstriped; [Kp] = no residue */
+  uint8_t  *isv_dp;         /* one DP column [0..M-1] of lane vectors, 32-byte aligned            */
+  void     *isv_mem;        /* memory for <isv_dp> and the <isv_sc> rows                          */
+  int       isv_allocM;     /* current allocation: M <= isv_allocM                                */
+  int       isv_allocKp;    /* current allocation: Kp <= isv_allocKp                              */
+
+#ifdef eslENABLE_AVX512
+  /* One row for the AVX-512 parsers, which only keep the specials for all rows */
+  __m512   *dpf_avx512;     /* one row [0..Q-1][MDI] of 16x float vectors                */
+  void     *avx512_mem;     /* memory for <dpf_avx512> before 64-byte alignment          */
+  int       allocQF_avx512; /* current row width in <dpf_avx512>: allocQF_avx512*16 >= M */
+#endif
+
   /* The X states (for full,parser; or NULL, for scorer)                                       */
   float    *xmx;          /* logically [0.1..L][ENJBCS]; indexed [i*p7X_NXCELLS+s]       */
   void     *x_mem;    /* X memory before 16-byte alignment                           */
@@ -250,13 +329,98 @@ p7_omx_FSetMDI(const P7_OMX *ox, int s, int i, int k, float val)
 
 
 
+#if defined(eslENABLE_AVX) && defined(__AVX2__)
+/* Vector utilities for the AVX2 filters. Only visible in translation
+ * units compiled with AVX2 flags. AVX2 byte shifts stay within each
+ * 128-bit lane, so shifting a striped vector by one element needs a
+ * cross-lane permute first.
+ */
+static inline __m256i
+p7_avx_leftshift_epu8(__m256i a)      /* a[z] -> a[z+1], 0 shifts onto a[0]      */
+{
+  return _mm256_alignr_epi8(a, _mm256_permute2x128_si256(a, a, _MM_SHUFFLE(0,0,3,0)), 15);
+}
+
+static inline __m256i
+p7_avx_leftshift_epi16(__m256i a)     /* a[z] -> a[z+1], 0 shifts onto a[0]      */
+{
+  return _mm256_alignr_epi8(a, _mm256_permute2x128_si256(a, a, _MM_SHUFFLE(0,0,3,0)), 14);
+}
+
+static inline uint8_t
+p7_avx_hmax_epu8(__m256i a)
+{
+  __m128i t = _mm_max_epu8(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+  t = _mm_max_epu8(t, _mm_srli_si128(t, 8));
+  t = _mm_max_epu8(t, _mm_srli_si128(t, 4));
+  t = _mm_max_epu8(t, _mm_srli_si128(t, 2));
+  t = _mm_max_epu8(t, _mm_srli_si128(t, 1));
+  return (uint8_t) _mm_extract_epi8(t, 0);
+}
+
+static inline int16_t
+p7_avx_hmax_epi16(__m256i a)
+{
+  __m128i t = _mm_max_epi16(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+  t = _mm_max_epi16(t, _mm_srli_si128(t, 8));
+  t = _mm_max_epi16(t, _mm_srli_si128(t, 4));
+  t = _mm_max_epi16(t, _mm_srli_si128(t, 2));
+  return (int16_t) _mm_extract_epi16(t, 0);
+}
+
+static inline int
+p7_avx_any_gt_epi16(__m256i a, __m256i b)
+{
+  return (_mm256_movemask_epi8(_mm256_cmpgt_epi16(a, b)) != 0);
+}
+#endif /*eslENABLE_AVX && __AVX2__*/
+
+
+#if defined(eslENABLE_AVX512) && defined(__AVX512F__)
+/* Vector utilities for the AVX-512 parsers. Element shifts of a
+ * striped vector are one permute, with a zeroing mask register
+ * supplying the 0.0 that shifts on.
+ */
+static inline __m512
+p7_avx512_rightshift_ps(__m512 a)     /* a[z] -> a[z+1], 0.0 shifts onto a[0]    */
+{
+  return _mm512_maskz_permutexvar_ps((__mmask16) 0xfffe,
+				     _mm512_set_epi32(14,13,12,11,10,9,8,7,6,5,4,3,2,1,0,0), a);
+}
+
+static inline __m512
+p7_avx512_leftshift_ps(__m512 a)      /* a[z+1] -> a[z], 0.0 shifts onto a[15]   */
+{
+  return _mm512_maskz_permutexvar_ps((__mmask16) 0x7fff,
+				     _mm512_set_epi32(15,15,14,13,12,11,10,9,8,7,6,5,4,3,2,1), a);
+}
+#endif /*eslENABLE_AVX512 && __AVX512F__*/
+
+
 /*****************************************************************
  * 3. Declarations of the external API.
  *****************************************************************/
 
+/* dispatch.c */
+extern int          p7_dispatch_Init(void);
+extern int          p7_dispatch_Select(int isa);
+extern int          p7_dispatch_GetISA(void);
+extern int          p7_dispatch_GetLayout(void);
+extern int          p7_dispatch_EncodeISA(const char *s);
+extern const char  *p7_dispatch_DecodeISA(int isa);
+
+extern int p7_MSVFilter     (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
+extern int p7_SSVFilter     (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, float *ret_sc);
+extern int p7_ViterbiFilter (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
+extern int p7_ForwardParser (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om,                    P7_OMX *fwd, float *opt_sc);
+extern int p7_BackwardParser(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc);
+extern int p7_SSVInterseq   (const ESL_DSQ **dsq, const int *L, int nseq, const P7_OPROFILE *om, P7_OMX *ox, uint8_t *xE);
+
 /* p7_omx.c */
 extern P7_OMX      *p7_omx_Create(int allocM, int allocL, int allocXL);
 extern int          p7_omx_GrowTo(P7_OMX *ox, int allocM, int allocL, int allocXL);
+extern int          p7_omx_GrowToCheckpointed(P7_OMX *ox, int allocM, int L);
+extern double       p7_omx_FullMB(int M, int L);
 extern int          p7_omx_FDeconvert(P7_OMX *ox, P7_GMX *gx);
 extern int          p7_omx_Reuse  (P7_OMX *ox);
 extern void         p7_omx_Destroy(P7_OMX *ox);
@@ -270,6 +434,7 @@ extern int          p7_omx_DumpFBRow(P7_OMX *ox, int logify, int rowi, int width
 
 /* p7_oprofile.c */
 extern P7_OPROFILE *p7_oprofile_Create(int M, const ESL_ALPHABET *abc);
+extern P7_OPROFILE *p7_oprofile_CreateMapped(int M, const ESL_ALPHABET *abc);
 extern int          p7_oprofile_IsLocal(const P7_OPROFILE *om);
 extern void         p7_oprofile_Destroy(P7_OPROFILE *om);
 extern size_t       p7_oprofile_Sizeof(P7_OPROFILE *om);
@@ -299,15 +464,32 @@ extern int          p7_oprofile_GetSSVEmissionScoreArray(const P7_OPROFILE *om,
 extern int          p7_oprofile_GetFwdEmissionScoreArray(const P7_OPROFILE *om, float *arr );
 extern int          p7_oprofile_GetFwdEmissionArray(const P7_OPROFILE *om, P7_BG *bg, float *arr );
 
+#ifdef eslENABLE_AVX
+extern int          p7_oprofile_RestripeMSV_avx(P7_OPROFILE *om);
+extern int          p7_oprofile_RestripeVF_avx (P7_OPROFILE *om);
+#endif
+#ifdef eslENABLE_AVX512
+extern int          p7_oprofile_RestripeFB_avx512(P7_OPROFILE *om);
+#endif
+
+/* bgfilter.c */
+extern int p7_FilterScoreModels(P7_BG *bg, const ESL_DSQ *dsq, int L, P7_OPROFILE **oml, const int64_t *idx, int n, float *fsc);
+
 /* decoding.c */
 extern int p7_Decoding      (const P7_OPROFILE *om, const P7_OMX *oxf,       P7_OMX *oxb, P7_OMX *pp);
 extern int p7_DomainDecoding(const P7_OPROFILE *om, const P7_OMX *oxf, const P7_OMX *oxb, P7_DOMAINDEF *ddef);
+extern int p7_DecodingSegment(const P7_OPROFILE *om, const P7_OMX *oxf, const P7_OMX *oxb, P7_OMX *pp, int a, int b);
 
 /* fwdback.c */
 extern int p7_Forward       (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om,                    P7_OMX *fwd, float *opt_sc);
-extern int p7_ForwardParser (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om,                    P7_OMX *fwd, float *opt_sc);
+extern int p7_ForwardParser_sse (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om,                P7_OMX *fwd, float *opt_sc);
 extern int p7_Backward      (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc);
-extern int p7_BackwardParser(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc);
+extern int p7_BackwardParser_sse(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc);
+extern int p7_ForwardSegment    (const ESL_DSQ *dsq, const P7_OPROFILE *om,                    P7_OMX *fwd, int a, int b);
+extern int p7_BackwardSegment   (const ESL_DSQ *dsq, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, int a, int b);
+extern int p7_BandsFromForward  (const P7_OPROFILE *om, const P7_OMX *fwd, float endp, P7_GBANDS *bnd);
+extern int p7_ForwardBanded     (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_GBANDS *bnd,                    P7_OMX *fwd, float *opt_sc);
+extern int p7_BackwardBanded    (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_GBANDS *bnd, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc);
 
 /* io.c */
 extern int p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om);
@@ -316,31 +498,43 @@ extern int p7_oprofile_ReadInfoMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_O
 extern int p7_oprofile_ReadBlockMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OM_BLOCK *hmmBlock);
 extern int p7_oprofile_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om);
 extern int p7_oprofile_Position(P7_HMMFILE *hfp, off_t offset);
+extern int p7_oprofile_IsAligned(P7_HMMFILE *hfp);
 
 extern P7_OM_BLOCK *p7_oprofile_CreateBlock(int size);
 extern void p7_oprofile_DestroyBlock(P7_OM_BLOCK *block);
 
 /* ssvfilter.c */
-extern int p7_SSVFilter    (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, float *ret_sc);
+extern int p7_SSVFilter_sse   (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, float *ret_sc);
+extern int p7_SSVFilter_Finish(const P7_OPROFILE *om, uint16_t xE, float *ret_sc);
+
+/* ssvfilter_interseq.c */
+extern int p7_MSVFilterInterseq(const ESL_DSQ **dsq, const int *L, int nseq, P7_OPROFILE *om, P7_OMX *ox, float *sc);
+extern int p7_SSVInterseq_sse  (const ESL_DSQ **dsq, const int *L, int nseq, const P7_OPROFILE *om, P7_OMX *ox, uint8_t *xE);
 
 /* msvfilter.c */
-extern int p7_MSVFilter           (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
+extern int p7_MSVFilter_sse       (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
 extern int p7_SSVFilter_longtarget(const ESL_DSQ *dsq, int L, P7_OPROFILE *om, P7_OMX *ox, const P7_SCOREDATA *msvdata, P7_BG *bg, double P, P7_HMM_WINDOWLIST *windowlist);
 
 
 /* null2.c */
 extern int p7_Null2_ByExpectation(const P7_OPROFILE *om, const P7_OMX *pp, float *null2);
 extern int p7_Null2_ByTrace      (const P7_OPROFILE *om, const P7_TRACE *tr, int zstart, int zend, P7_OMX *wrk, float *null2);
+extern int p7_Null2_ByExpectedCounts(const P7_OPROFILE *om, const P7_OMX *pp, float *null2);
 
 /* optacc.c */
 extern int p7_OptimalAccuracy(const P7_OPROFILE *om, const P7_OMX *pp,       P7_OMX *ox, float *ret_e);
 extern int p7_OATrace        (const P7_OPROFILE *om, const P7_OMX *pp, const P7_OMX *ox, P7_TRACE *tr);
+extern int p7_OptimalAccuracyCheckpointed(const ESL_DSQ *dsq, const P7_OPROFILE *om, P7_OMX *oxf, P7_OMX *oxb, P7_OMX *pp, P7_OMX *ox, float *ret_e);
+extern int p7_OATraceCheckpointed        (const ESL_DSQ *dsq, const P7_OPROFILE *om, P7_OMX *oxf, P7_OMX *oxb, P7_OMX *pp, P7_OMX *ox, P7_TRACE *tr);
+extern int p7_DecodingOptimalAccuracy    (const P7_OPROFILE *om, P7_OMX *oxf, P7_OMX *oxb, float *ret_e);
 
 /* stotrace.c */
 extern int p7_StochasticTrace(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *ox, P7_TRACE *tr);
+extern int p7_StochasticTraceCheckpointed(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, P7_TRACE **tr, int ntr);
+extern int p7_StochasticTraceBatch(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *ox, P7_TRACE **tr, int ntr);
 
 /* vitfilter.c */
-extern int p7_ViterbiFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
+extern int p7_ViterbiFilter_sse(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
 extern int p7_ViterbiFilter_longtarget(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox,
                                         float filtersc, double P, P7_HMM_WINDOWLIST *windowlist);
 
@@ -348,6 +542,20 @@ extern int p7_ViterbiFilter_longtarget(const ESL_DSQ *dsq, int L, const P7_OPROF
 /* vitscore.c */
 extern int p7_ViterbiScore (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
 
+/* msvfilter_avx.c, ssvfilter_avx.c, vitfilter_avx.c, ssvfilter_interseq_avx.c */
+#ifdef eslENABLE_AVX
+extern int p7_MSVFilter_avx    (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
+extern int p7_SSVFilter_avx    (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, float *ret_sc);
+extern int p7_ViterbiFilter_avx(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
+extern int p7_SSVInterseq_avx  (const ESL_DSQ **dsq, const int *L, int nseq, const P7_OPROFILE *om, P7_OMX *ox, uint8_t *xE);
+#endif
+
+/* fwdback_avx512.c */
+#ifdef eslENABLE_AVX512
+extern int p7_ForwardParser_avx512 (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om,                    P7_OMX *fwd, float *opt_sc);
+extern int p7_BackwardParser_avx512(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc);
+#endif
+
 
 /*****************************************************************
  * 4. Implementation specific initialization
@@ -372,6 +580,11 @@ impl_Init(void)
    */
   _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
 #endif
+
+  /* Choose SSE, AVX2, or AVX-512 kernels for this processor now,
+   * before any profiles are made.
+   */
+  p7_dispatch_Init();
 }
 #endif /* P7_IMPL_SSE_INCLUDED */
 
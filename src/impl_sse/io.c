@@ -10,6 +10,18 @@
  * <hmmfile>.h3p, which nominally stand for "H3 filter" and "H3
  * profile".
  * 
+ * Since format 3/g, each vector array starts at a file offset that's
+ * a multiple of 16, after zero padding. So when the files are mapped
+ * into memory (p7_hmmfile_MapPressed()), a profile's scores can be
+ * used right where they are in the map, without being read and
+ * copied: see the mapped_*() readers. The records still follow one
+ * another with no global header, as before; each .h3f record's
+ * offs[] is its offset table into the other files.
+ * 
+ * Format 3/f is the same without the padding. Files in it, pressed by
+ * an earlier HMMER, are still read the usual way, by fread(); they
+ * just aren't mapped (see p7_oprofile_IsAligned()).
+ * 
  * Contents:
  *    1. Writing optimized profiles to two files.
  *    2. Reading optimized profiles in two stages.
@@ -43,6 +55,9 @@
 #include "hmmer.h"
 #include "impl_sse.h"
 
+static uint32_t  v3g_fmagic = 0xb3e7e6f3; /* 3/g binary MSV file, SSE:     "3gfs" = 0x 33 67 66 73  + 0x80808080 */
+static uint32_t  v3g_pmagic = 0xb3e7f0f3; /* 3/g binary profile file, SSE: "3gps" = 0x 33 67 70 73  + 0x80808080 */
+
 static uint32_t  v3f_fmagic = 0xb3e6e6f3; /* 3/f binary MSV file, SSE:     "3ffs" = 0x 33 66 66 73  + 0x80808080 */
 static uint32_t  v3f_pmagic = 0xb3e6f0f3; /* 3/f binary profile file, SSE: "3fps" = 0x 33 66 70 73  + 0x80808080 */
 
@@ -61,6 +76,16 @@ static uint32_t  v3b_pmagic = 0xb3e2f0f3; /* 3/b binary profile file, SSE: "3bps
 static uint32_t  v3a_fmagic = 0xe8b3e6f3; /* 3/a binary MSV file, SSE:     "h3fs" = 0x 68 33 66 73  + 0x80808080 */
 static uint32_t  v3a_pmagic = 0xe8b3f0f3; /* 3/a binary profile file, SSE: "h3ps" = 0x 68 33 70 73  + 0x80808080 */
 
+static int         oprofile_write(FILE *ffp, FILE *pfp, P7_OPROFILE *om, int aligned);
+static char       *outdated_format(uint32_t magic);
+static off_t       aligned_offset(off_t off);
+static int         write_padding(FILE *fp);
+static int         skip_padding(FILE *fp);
+static int         mapped_ReadMSV (P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **ret_om);
+static int         mapped_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om);
+static int         map_read(const char *mem, off_t size, off_t *pos, void *dst, size_t n);
+static const void *map_ref (const char *mem, off_t size, off_t *pos, size_t n);
+
 
 /*****************************************************************
  *# 1. Writing optimized profiles to two files.
@@ -80,21 +105,39 @@ static uint32_t  v3a_pmagic = 0xe8b3f0f3; /* 3/a binary profile file, SSE: "h3ps
  *
  * Returns:   <eslOK> on success.
  *
+ *            The streams must be positionable (files, not pipes),
+ *            because the vector arrays are aligned to 16-byte file
+ *            offsets.
+ *
  * Throws:    <eslEWRITE> on any write failure, such as filling
  *            the disk.
  */
 int
 p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om)
 {
+  return oprofile_write(ffp, pfp, om, TRUE);
+}
+
+/* oprofile_write()
+ * p7_oprofile_Write(), in the current, <aligned> 3/g format; or, if
+ * <aligned> is FALSE, in the 3/f format of earlier HMMERs, which the
+ * io unit test uses to check that those files are still read.
+ */
+static int
+oprofile_write(FILE *ffp, FILE *pfp, P7_OPROFILE *om, int aligned)
+{
+  uint32_t fmagic = (aligned ? v3g_fmagic : v3f_fmagic);
+  uint32_t pmagic = (aligned ? v3g_pmagic : v3f_pmagic);
   int Q4   = p7O_NQF(om->M);
   int Q8   = p7O_NQW(om->M);
   int Q16  = p7O_NQB(om->M);
   int Q16x = p7O_NQB(om->M) + p7O_EXTRA_SB;
   int n    = strlen(om->name);
   int x;
+  int status;
 
   /* <ffp> is the part of the oprofile that MSVFilter() needs */
-  if (fwrite((char *) &(v3f_fmagic),    sizeof(uint32_t), 1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
+  if (fwrite((char *) &fmagic,          sizeof(uint32_t), 1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &(om->M),         sizeof(int),      1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &(om->abc->type), sizeof(int),      1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &n,               sizeof(int),      1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
@@ -107,6 +150,7 @@ p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om)
   if (fwrite((char *) &(om->base_b),    sizeof(uint8_t),  1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");  
   if (fwrite((char *) &(om->bias_b),    sizeof(uint8_t),  1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");  
 
+  if (aligned && (status = write_padding(ffp)) != eslOK) return status;
   for (x = 0; x < om->abc->Kp; x++)
     if (fwrite( (char *) om->sbv[x],    sizeof(__m128i),  Q16x,        ffp) != Q16x)        ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   
@@ -116,10 +160,10 @@ p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om)
   if (fwrite((char *) om->evparam,      sizeof(float),    p7_NEVPARAM, ffp) != p7_NEVPARAM) ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) om->offs,         sizeof(off_t),    p7_NOFFSETS, ffp) != p7_NOFFSETS) ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) om->compo,        sizeof(float),    p7_MAXABET,  ffp) != p7_MAXABET)  ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
-  if (fwrite((char *) &(v3f_fmagic),    sizeof(uint32_t), 1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed"); /* sentinel */
+  if (fwrite((char *) &fmagic,          sizeof(uint32_t), 1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed"); /* sentinel */
 
   /* <pfp> gets the rest of the oprofile */
-  if (fwrite((char *) &(v3f_pmagic),    sizeof(uint32_t), 1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
+  if (fwrite((char *) &pmagic,          sizeof(uint32_t), 1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &(om->M),         sizeof(int),      1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &(om->abc->type), sizeof(int),      1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &n,               sizeof(int),      1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
@@ -149,6 +193,7 @@ p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om)
   if (fwrite((char *) om->consensus,    sizeof(char),     om->M+2,     pfp) != om->M+2)     ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
 
   /* ViterbiFilter part */
+  if (aligned && (status = write_padding(pfp)) != eslOK) return status;
   if (fwrite((char *) om->twv,             sizeof(__m128i),  8*Q8,        pfp) != 8*Q8)        ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   for (x = 0; x < om->abc->Kp; x++)
     if (fwrite( (char *) om->rwv[x],       sizeof(__m128i),  Q8,          pfp) != Q8)          ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
@@ -160,6 +205,7 @@ p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om)
   if (fwrite((char *) &(om->ncj_roundoff), sizeof(float),    1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
 
   /* Forward/Backward part */
+  if (aligned && (status = write_padding(pfp)) != eslOK) return status;
   if (fwrite((char *) om->tfv,          sizeof(__m128),   8*Q4,        pfp) != 8*Q4)        ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   for (x = 0; x < om->abc->Kp; x++)
     if (fwrite( (char *) om->rfv[x],    sizeof(__m128),   Q4,          pfp) != Q4)          ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
@@ -170,7 +216,7 @@ p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om)
   if (fwrite((char *) &(om->nj),        sizeof(float),    1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &(om->mode),      sizeof(int),      1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &(om->L)   ,      sizeof(int),      1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
-  if (fwrite((char *) &(v3f_pmagic),    sizeof(uint32_t), 1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed"); /* sentinel */
+  if (fwrite((char *) &pmagic,          sizeof(uint32_t), 1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed"); /* sentinel */
   return eslOK;
 }
 /*---------------- end, writing oprofile ------------------------*/
@@ -201,6 +247,10 @@ p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om)
  *            
  *            The <.h3f> file was opened automatically, if it existed,
  *            when the HMM file was opened with <p7_hmmfile_OpenE()>.
+ *            If it was then mapped with <p7_hmmfile_MapPressed()>,
+ *            the scores of <*ret_om> point into the map (see
+ *            <p7_oprofile_CreateMapped()>), and <*ret_om> must be
+ *            destroyed before <hfp> is closed.
  *            
  *            When no more HMMs remain in the file, return <eslEOF>.
  *
@@ -233,7 +283,9 @@ p7_oprofile_ReadMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **ret_o
   P7_OPROFILE  *om = NULL;
   ESL_ALPHABET *abc = NULL;
   uint32_t      magic;
+  uint32_t      fmagic;		/* v3g_fmagic or v3f_fmagic: this record's format */
   off_t         roff;
+  char         *fmt;
   int           M, Q16, Q16x;
   int           x,n;
   int           alphatype;
@@ -241,18 +293,16 @@ p7_oprofile_ReadMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **ret_o
 
   hfp->errbuf[0] = '\0';
   if (hfp->ffp == NULL) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "no MSV profile file; hmmpress probably wasn't run");
+  if (hfp->fmap != NULL) return mapped_ReadMSV(hfp, byp_abc, ret_om);
   if (feof(hfp->ffp))   { status = eslEOF; goto ERROR; }	/* normal EOF: no more profiles */
   
   /* keep track of the starting offset of the MSV model */
   roff = ftello(hfp->ffp);
 
   if (! fread( (char *) &magic,     sizeof(uint32_t), 1, hfp->ffp)) { status = eslEOF; goto ERROR; }
-  if (magic == v3a_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/a); please hmmpress your HMM file again");
-  if (magic == v3b_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/b); please hmmpress your HMM file again");
-  if (magic == v3c_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/c); please hmmpress your HMM file again");
-  if (magic == v3d_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/d); please hmmpress your HMM file again");
-  if (magic == v3e_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/e); please hmmpress your HMM file again");
-  if (magic != v3f_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad magic; not an HMM database?");
+  if ((fmt = outdated_format(magic)) != NULL) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (%s); please hmmpress your HMM file again", fmt);
+  if (magic != v3g_fmagic && magic != v3f_fmagic) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad magic; not an HMM database?");
+  fmagic = magic;
 
   if (! fread( (char *) &M,         sizeof(int),      1, hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read model size M");
   if (! fread( (char *) &alphatype, sizeof(int),      1, hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read alphabet type");  
@@ -284,6 +334,7 @@ p7_oprofile_ReadMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **ret_o
   if (! fread((char *) &(om->scale_b),   sizeof(float),   1,           hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read scale");
   if (! fread((char *) &(om->base_b),    sizeof(uint8_t), 1,           hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read base");
   if (! fread((char *) &(om->bias_b),    sizeof(uint8_t), 1,           hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read bias");
+  if (fmagic == v3g_fmagic && skip_padding(hfp->ffp) != eslOK)                    ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read padding before ssv scores");
   for (x = 0; x < abc->Kp; x++)
     if (! fread((char *) om->sbv[x],     sizeof(__m128i), Q16x,        hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read ssv scores at %d [residue %c]", x, abc->sym[x]); 
   for (x = 0; x < abc->Kp; x++)
@@ -294,11 +345,15 @@ p7_oprofile_ReadMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **ret_o
 
   /* record ends with magic sentinel, for detecting binary file corruption */
   if (! fread( (char *) &magic,     sizeof(uint32_t), 1, hfp->ffp))  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "no sentinel magic: .h3f file corrupted?");
-  if (magic != v3f_fmagic)                                           ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad sentinel magic; .h3f file corrupted?");
+  if (magic != fmagic)                                               ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad sentinel magic; .h3f file corrupted?");
 
   /* keep track of the ending offset of the MSV model */
   om->eoff = ftello(hfp->ffp) - 1;;
 
+#ifdef eslENABLE_AVX
+  p7_oprofile_RestripeMSV_avx(om);
+#endif
+
   if (byp_abc != NULL) *byp_abc = abc;  /* pass alphabet (whether new or not) back to caller, if caller wanted it */
   *ret_om = om;
   return eslOK;
@@ -354,7 +409,9 @@ p7_oprofile_ReadInfoMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **r
   P7_OPROFILE  *om = NULL;
   ESL_ALPHABET *abc = NULL;
   uint32_t      magic;
+  uint32_t      fmagic;		/* v3g_fmagic or v3f_fmagic: this record's format */
   off_t         roff;
+  char         *fmt;
   int           M, Q16, Q16x;
   int           n;
   int           alphatype;
@@ -368,12 +425,9 @@ p7_oprofile_ReadInfoMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **r
   roff = ftello(hfp->ffp);
 
   if (! fread( (char *) &magic,     sizeof(uint32_t), 1, hfp->ffp)) { status = eslEOF; goto ERROR; }
-  if (magic == v3a_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/a); please hmmpress your HMM file again");
-  if (magic == v3b_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/b); please hmmpress your HMM file again");
-  if (magic == v3c_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/c); please hmmpress your HMM file again");
-  if (magic == v3d_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/d); please hmmpress your HMM file again");
-  if (magic == v3e_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/e); please hmmpress your HMM file again");
-  if (magic != v3f_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad magic; not an HMM database?");
+  if ((fmt = outdated_format(magic)) != NULL) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (%s); please hmmpress your HMM file again", fmt);
+  if (magic != v3g_fmagic && magic != v3f_fmagic) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad magic; not an HMM database?");
+  fmagic = magic;
 
   if (! fread( (char *) &M,         sizeof(int),      1, hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read model size M");
   if (! fread( (char *) &alphatype, sizeof(int),      1, hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read alphabet type");  
@@ -400,6 +454,8 @@ p7_oprofile_ReadInfoMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **r
   roff += (sizeof(int) * 5);                      /* magic, model size, alphabet type, max length, name length */
   roff += (sizeof(char) * (n + 1));               /* name string and terminator '\0'                           */
   roff += (sizeof(float) + sizeof(uint8_t) * 5);  /* transition  costs, bias, scale and base                   */
+  if (fmagic == v3g_fmagic)
+    roff = aligned_offset(roff);                  /* 3/g padding, to align the vectors                         */
   roff += (sizeof(__m128i) * abc->Kp * Q16x);     /* ssv scores                                                */
   roff += (sizeof(__m128i) * abc->Kp * Q16);      /* msv scores                                                */
   roff += (sizeof(float) * p7_NEVPARAM);          /* stat params                                               */
@@ -491,12 +547,16 @@ int
 p7_oprofile_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om)
 {
   uint32_t      magic;
+  uint32_t      pmagic;		/* v3g_pmagic or v3f_pmagic: this record's format */
   int           M, Q4, Q8;
   int           x,n;
   char         *name = NULL;
+  char         *fmt;
   int           alphatype;
   int           status;
 
+  if (om->mapped) return mapped_ReadRest(hfp, om);
+
 #ifdef HMMER_THREADS
   /* lock the mutex to prevent other threads from reading from the optimized
    * profile at the same time.
@@ -514,12 +574,9 @@ p7_oprofile_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om)
   if (fseeko(hfp->pfp, om->offs[p7_POFFSET], SEEK_SET) != 0)                       ESL_EXCEPTION(eslESYS, "fseeko() failed");
    
   if (! fread( (char *) &magic,          sizeof(uint32_t), 1,           hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read magic");
-  if (magic == v3a_pmagic) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/a); please hmmpress your HMM file again");
-  if (magic == v3b_pmagic) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/b); please hmmpress your HMM file again");
-  if (magic == v3c_pmagic) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/c); please hmmpress your HMM file again");
-  if (magic == v3d_pmagic) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/d); please hmmpress your HMM file again");
-  if (magic == v3e_pmagic) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/e); please hmmpress your HMM file again");
-  if (magic != v3f_pmagic) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad magic; not an HMM database file?");
+  if ((fmt = outdated_format(magic)) != NULL) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (%s); please hmmpress your HMM file again", fmt);
+  if (magic != v3g_pmagic && magic != v3f_pmagic) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad magic; not an HMM database file?");
+  pmagic = magic;
 
   if (! fread( (char *) &M,              sizeof(int),      1,           hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read model size M");
   if (! fread( (char *) &alphatype,      sizeof(int),      1,           hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read alphabet type");  
@@ -550,6 +607,7 @@ p7_oprofile_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om)
   Q4  = p7O_NQF(om->M);
   Q8  = p7O_NQW(om->M);
 
+  if (pmagic == v3g_pmagic && skip_padding(hfp->pfp) != eslOK)                       ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read padding before vitfilter scores");
   if (! fread((char *) om->twv,             sizeof(__m128i),  8*Q8,        hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read <tu>, vitfilter transitions");
   for (x = 0; x < om->abc->Kp; x++)
     if (! fread( (char *) om->rwv[x],       sizeof(__m128i),  Q8,          hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read <ru>[%d], vitfilter emissions for sym %c", x, om->abc->sym[x]);
@@ -560,6 +618,7 @@ p7_oprofile_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om)
   if (! fread((char *) &(om->ddbound_w),    sizeof(int16_t),  1,           hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read ddbound_w");
   if (! fread((char *) &(om->ncj_roundoff), sizeof(float),    1,           hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read ddbound_w");
 
+  if (pmagic == v3g_pmagic && skip_padding(hfp->pfp) != eslOK)                    ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read padding before <tf> transitions");
   if (! fread((char *) om->tfv,          sizeof(__m128),   8*Q4,        hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read <tf> transitions");
   for (x = 0; x < om->abc->Kp; x++)
     if (! fread( (char *) om->rfv[x],    sizeof(__m128),   Q4,          hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read <rf>[%d] emissions for sym %c", x, om->abc->sym[x]);
@@ -573,7 +632,14 @@ p7_oprofile_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om)
 
   /* record ends with magic sentinel, for detecting binary file corruption */
   if (! fread( (char *) &magic,     sizeof(uint32_t), 1, hfp->pfp))  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "no sentinel magic: .h3p file corrupted?");
-  if (magic != v3f_pmagic)                                           ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad sentinel magic; .h3p file corrupted?");
+  if (magic != pmagic)                                               ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad sentinel magic; .h3p file corrupted?");
+
+#ifdef eslENABLE_AVX
+  p7_oprofile_RestripeVF_avx(om);
+#endif
+#ifdef eslENABLE_AVX512
+  p7_oprofile_RestripeFB_avx512(om);
+#endif
 
 #ifdef HMMER_THREADS
   if (hfp->syncRead)
@@ -597,6 +663,197 @@ p7_oprofile_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om)
   if (name != NULL) free(name);
   return status;
 }
+
+/* mapped_ReadMSV()
+ * p7_oprofile_ReadMSV() from the .h3f file mapped by
+ * p7_hmmfile_MapPressed(): the profile's MSV and SSV scores point
+ * into the map, instead of being read into memory of its own.
+ * The record is the one at the <hfp->ffp> stream's position, and
+ * the stream is moved past it, so p7_oprofile_Position() and
+ * p7_oprofile_ReadInfoMSV() work as usual.
+ */
+static int
+mapped_ReadMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **ret_om)
+{
+  P7_OPROFILE  *om  = NULL;
+  ESL_ALPHABET *abc = NULL;
+  const char   *fmap  = hfp->fmap;
+  off_t         fsize = hfp->fmapsize;
+  const char   *name;
+  uint32_t      magic;
+  off_t         roff, pos;
+  char         *fmt;
+  int           M, Q16, Q16x;
+  int           x,n;
+  int           alphatype;
+  int           status;
+
+  if ((roff = ftello(hfp->ffp)) < 0) ESL_XEXCEPTION(eslESYS, "ftello() failed");
+  if (roff >= fsize) { status = eslEOF; goto ERROR; }	/* normal EOF: no more profiles */
+  pos = roff;
+
+  if (map_read(fmap, fsize, &pos, &magic, sizeof(uint32_t)) != eslOK) { status = eslEOF; goto ERROR; }
+  if ((fmt = outdated_format(magic)) != NULL) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (%s); please hmmpress your HMM file again", fmt);
+  if (magic == v3f_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "3/f profile in a mapped 3/g .h3f file; please hmmpress your HMM file again");
+  if (magic != v3g_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad magic; not an HMM database?");
+
+  if (map_read(fmap, fsize, &pos, &M,         sizeof(int)) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read model size M");
+  if (map_read(fmap, fsize, &pos, &alphatype, sizeof(int)) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read alphabet type");
+  if (M < 1)                                                          ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad model size M; .h3f file corrupted?");
+  Q16  = p7O_NQB(M);
+  Q16x = p7O_NQB(M) + p7O_EXTRA_SB;
+
+  /* Set or verify alphabet. */
+  if (byp_abc == NULL || *byp_abc == NULL)	{	/* alphabet unknown: whether wanted or unwanted, make a new one */
+    if ((abc = esl_alphabet_Create(alphatype)) == NULL)  ESL_XFAIL(eslEMEM, hfp->errbuf, "allocation failed: alphabet");
+  } else {			/* alphabet already known: verify it against what we see in the HMM */
+    abc = *byp_abc;
+    if (abc->type != alphatype) 
+      ESL_XFAIL(eslEINCOMPAT, hfp->errbuf, "Alphabet type mismatch: was %s, but current profile says %s", 
+		esl_abc_DecodeType(abc->type), esl_abc_DecodeType(alphatype));
+  }
+  if ((om = p7_oprofile_CreateMapped(M, abc)) == NULL)   ESL_XFAIL(eslEMEM, hfp->errbuf, "allocation failed: oprofile");
+  om->M    = M;
+  om->roff = roff;
+
+  if (map_read(fmap, fsize, &pos, &n, sizeof(int)) != eslOK || n < 0)                    ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read name length");
+  if ((name = map_ref(fmap, fsize, &pos, n+1)) == NULL || name[n] != '\0')               ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read name");
+  if ((status = esl_strdup(name, n, &(om->name))) != eslOK) goto ERROR;
+
+  if (map_read(fmap, fsize, &pos, &(om->max_length), sizeof(int))     != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read max_length");
+  if (map_read(fmap, fsize, &pos, &(om->tbm_b),      sizeof(uint8_t)) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read tbm");
+  if (map_read(fmap, fsize, &pos, &(om->tec_b),      sizeof(uint8_t)) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read tec");
+  if (map_read(fmap, fsize, &pos, &(om->tjb_b),      sizeof(uint8_t)) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read tjb");
+  if (map_read(fmap, fsize, &pos, &(om->scale_b),    sizeof(float))   != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read scale");
+  if (map_read(fmap, fsize, &pos, &(om->base_b),     sizeof(uint8_t)) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read base");
+  if (map_read(fmap, fsize, &pos, &(om->bias_b),     sizeof(uint8_t)) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read bias");
+
+  pos = aligned_offset(pos);
+  for (x = 0; x < abc->Kp; x++)
+    if ((om->sbv[x] = (__m128i *) map_ref(fmap, fsize, &pos, sizeof(__m128i) * Q16x)) == NULL) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read ssv scores at %d [residue %c]", x, abc->sym[x]);
+  for (x = 0; x < abc->Kp; x++)
+    if ((om->rbv[x] = (__m128i *) map_ref(fmap, fsize, &pos, sizeof(__m128i) * Q16))  == NULL) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read msv scores at %d [residue %c]", x, abc->sym[x]);
+
+  if (map_read(fmap, fsize, &pos, om->evparam, sizeof(float) * p7_NEVPARAM) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read stat params");
+  if (map_read(fmap, fsize, &pos, om->offs,    sizeof(off_t) * p7_NOFFSETS) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read hmmpfam offsets");
+  if (map_read(fmap, fsize, &pos, om->compo,   sizeof(float) * p7_MAXABET)  != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read model composition");
+
+  if (map_read(fmap, fsize, &pos, &magic, sizeof(uint32_t)) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "no sentinel magic: .h3f file corrupted?");
+  if (magic != v3g_fmagic)                                            ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad sentinel magic; .h3f file corrupted?");
+
+  om->eoff = pos - 1;
+  if (fseeko(hfp->ffp, pos, SEEK_SET) != 0) ESL_XEXCEPTION(eslESYS, "fseeko() failed");
+
+#ifdef eslENABLE_AVX
+  p7_oprofile_RestripeMSV_avx(om);
+#endif
+
+  if (byp_abc != NULL) *byp_abc = abc;  /* pass alphabet (whether new or not) back to caller, if caller wanted it */
+  *ret_om = om;
+  return eslOK;
+
+ ERROR:
+  if (abc != NULL && (byp_abc == NULL || *byp_abc == NULL)) esl_alphabet_Destroy(abc); /* destroy alphabet if we created it here */
+  if (om != NULL) p7_oprofile_Destroy(om);
+  *ret_om = NULL;
+  return status;
+}
+
+/* mapped_ReadRest()
+ * p7_oprofile_ReadRest() for a profile <om> from mapped_ReadMSV(),
+ * pointing its remaining scores and its annotation into the mapped
+ * .h3p file. Threads need no lock, because nothing is read from the
+ * shared <hfp->pfp> stream; <om> itself is only touched by the
+ * caller that owns it.
+ */
+static int
+mapped_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om)
+{
+  const char   *pmap  = hfp->pmap;
+  off_t         psize = hfp->pmapsize;
+  const char   *str;
+  uint32_t      magic;
+  off_t         pos;
+  char         *fmt;
+  int           M, Q4, Q8;
+  int           x,n;
+  int           alphatype;
+  int           status;
+
+  if (pmap == NULL) ESL_EXCEPTION(eslEINVAL, "mapped profile, but no mapped .h3p file");
+
+  pos = om->offs[p7_POFFSET];
+  if (pos < 0 || pos >= psize) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad .h3p offset for %s; .h3f file corrupted?", om->name);
+
+  if (map_read(pmap, psize, &pos, &magic, sizeof(uint32_t)) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read magic");
+  if ((fmt = outdated_format(magic)) != NULL) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (%s); please hmmpress your HMM file again", fmt);
+  if (magic == v3f_pmagic) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "3/f profile in a mapped 3/g .h3p file; please hmmpress your HMM file again");
+  if (magic != v3g_pmagic) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad magic; not an HMM database file?");
+
+  if (map_read(pmap, psize, &pos, &M,         sizeof(int)) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read model size M");
+  if (map_read(pmap, psize, &pos, &alphatype, sizeof(int)) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read alphabet type");
+  if (map_read(pmap, psize, &pos, &n,         sizeof(int)) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read name length");
+  if (M         != om->M)                                             ESL_XFAIL(eslEFORMAT, hfp->errbuf, "p/f model length mismatch");
+  if (alphatype != om->abc->type)                                     ESL_XFAIL(eslEFORMAT, hfp->errbuf, "p/f alphabet type mismatch");
+  if (n < 0 || (str = map_ref(pmap, psize, &pos, n+1)) == NULL)       ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read name");
+  if (str[n] != '\0' || strcmp(str, om->name) != 0)                   ESL_XFAIL(eslEFORMAT, hfp->errbuf, "p/f name mismatch");
+
+  if (map_read(pmap, psize, &pos, &n, sizeof(int)) != eslOK || n < 0) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read accession length");
+  if (n > 0) {
+    if ((str = map_ref(pmap, psize, &pos, n+1)) == NULL || str[n] != '\0') ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read accession");
+    if ((status = esl_strdup(str, n, &(om->acc))) != eslOK) goto ERROR;
+  }
+  if (map_read(pmap, psize, &pos, &n, sizeof(int)) != eslOK || n < 0) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read description length");
+  if (n > 0) {
+    if ((str = map_ref(pmap, psize, &pos, n+1)) == NULL || str[n] != '\0') ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read description");
+    if ((status = esl_strdup(str, n, &(om->desc))) != eslOK) goto ERROR;
+  }
+
+  if ((om->rf        = (char *) map_ref(pmap, psize, &pos, M+2)) == NULL) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read rf annotation");
+  if ((om->mm        = (char *) map_ref(pmap, psize, &pos, M+2)) == NULL) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read mm annotation");
+  if ((om->cs        = (char *) map_ref(pmap, psize, &pos, M+2)) == NULL) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read cs annotation");
+  if ((om->consensus = (char *) map_ref(pmap, psize, &pos, M+2)) == NULL) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read consensus annotation");
+
+  Q4  = p7O_NQF(om->M);
+  Q8  = p7O_NQW(om->M);
+
+  pos = aligned_offset(pos);
+  if ((om->twv = (__m128i *) map_ref(pmap, psize, &pos, sizeof(__m128i) * 8 * Q8)) == NULL)            ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read <tu>, vitfilter transitions");
+  for (x = 0; x < om->abc->Kp; x++)
+    if ((om->rwv[x] = (__m128i *) map_ref(pmap, psize, &pos, sizeof(__m128i) * Q8)) == NULL)           ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read <ru>[%d], vitfilter emissions for sym %c", x, om->abc->sym[x]);
+  for (x = 0; x < p7O_NXSTATES; x++)
+    if (map_read(pmap, psize, &pos, om->xw[x], sizeof(int16_t) * p7O_NXTRANS) != eslOK)               ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read <xu>[%d], vitfilter special transitions", x);
+  if (map_read(pmap, psize, &pos, &(om->scale_w),      sizeof(float))   != eslOK)                     ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read scale_w");
+  if (map_read(pmap, psize, &pos, &(om->base_w),       sizeof(int16_t)) != eslOK)                     ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read base_w");
+  if (map_read(pmap, psize, &pos, &(om->ddbound_w),    sizeof(int16_t)) != eslOK)                     ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read ddbound_w");
+  if (map_read(pmap, psize, &pos, &(om->ncj_roundoff), sizeof(float))   != eslOK)                     ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read ncj_roundoff");
+
+  pos = aligned_offset(pos);
+  if ((om->tfv = (__m128 *) map_ref(pmap, psize, &pos, sizeof(__m128) * 8 * Q4)) == NULL)              ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read <tf> transitions");
+  for (x = 0; x < om->abc->Kp; x++)
+    if ((om->rfv[x] = (__m128 *) map_ref(pmap, psize, &pos, sizeof(__m128) * Q4)) == NULL)             ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read <rf>[%d] emissions for sym %c", x, om->abc->sym[x]);
+  for (x = 0; x < p7O_NXSTATES; x++)
+    if (map_read(pmap, psize, &pos, om->xf[x], sizeof(float) * p7O_NXTRANS) != eslOK)                 ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read <xf>[%d] special transitions", x);
+
+  if (map_read(pmap, psize, &pos, om->cutoff,   sizeof(float) * p7_NCUTOFFS) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read Pfam score cutoffs");
+  if (map_read(pmap, psize, &pos, &(om->nj),    sizeof(float))               != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read nj");
+  if (map_read(pmap, psize, &pos, &(om->mode),  sizeof(int))                 != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read mode");
+  if (map_read(pmap, psize, &pos, &(om->L),     sizeof(int))                 != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read L");
+
+  if (map_read(pmap, psize, &pos, &magic, sizeof(uint32_t)) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "no sentinel magic: .h3p file corrupted?");
+  if (magic != v3g_pmagic)                                            ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad sentinel magic; .h3p file corrupted?");
+
+#ifdef eslENABLE_AVX
+  p7_oprofile_RestripeVF_avx(om);
+#endif
+#ifdef eslENABLE_AVX512
+  p7_oprofile_RestripeFB_avx512(om);
+#endif
+  return eslOK;
+
+ ERROR:
+  return status;
+}
 /*----------- end, reading optimized profiles -------------------*/
 
 
@@ -699,6 +956,124 @@ p7_oprofile_Position(P7_HMMFILE *hfp, off_t offset)
   return eslOK;
 }
 
+/* Function:  p7_oprofile_IsAligned()
+ * Synopsis:  See if pressed profiles can be used in place.
+ *
+ * Purpose:   Look at the magic number of the first record in the
+ *            <.h3f> file of open HMM file <hfp>, and return <TRUE> if
+ *            it is format 3/g, whose vector arrays are aligned, so
+ *            profiles can be used right where they are in a mapped
+ *            file. Return <FALSE> for a file pressed in the older
+ *            3/f format, which is only read the usual way; or if
+ *            there's no <.h3f> file, or it's empty or can't be read.
+ *            The <.h3f> file is left positioned where it was.
+ *
+ * Returns:   <TRUE> or <FALSE>.
+ */
+int
+p7_oprofile_IsAligned(P7_HMMFILE *hfp)
+{
+  uint32_t magic;
+  off_t    pos;
+  int      ok;
+
+  if (hfp->ffp == NULL)                  return FALSE;
+  if ((pos = ftello(hfp->ffp)) < 0)      return FALSE;
+  if (fseeko(hfp->ffp, 0, SEEK_SET) != 0) return FALSE;
+  ok = (fread((char *) &magic, sizeof(uint32_t), 1, hfp->ffp) == 1);
+  clearerr(hfp->ffp);
+  if (fseeko(hfp->ffp, pos, SEEK_SET) != 0) return FALSE;
+  return (ok && magic == v3g_fmagic);
+}
+
+/* outdated_format()
+ * If <magic> is the tag of an older .h3f or .h3p format, return
+ * the name of that format (such as "3/f"); else return NULL.
+ */
+static char *
+outdated_format(uint32_t magic)
+{
+  if (magic == v3a_fmagic || magic == v3a_pmagic) return "3/a";
+  if (magic == v3b_fmagic || magic == v3b_pmagic) return "3/b";
+  if (magic == v3c_fmagic || magic == v3c_pmagic) return "3/c";
+  if (magic == v3d_fmagic || magic == v3d_pmagic) return "3/d";
+  if (magic == v3e_fmagic || magic == v3e_pmagic) return "3/e";
+  return NULL;
+}
+
+/* aligned_offset()
+ * Return file offset <off>, rounded up to the next multiple of 16,
+ * where a vector array starts.
+ */
+static off_t
+aligned_offset(off_t off)
+{
+  return (off + 15) & ~((off_t) 15);
+}
+
+/* write_padding()
+ * Write zeros to <fp> up to the next 16-byte aligned offset.
+ * Throws <eslEWRITE> if that fails, or if <fp> isn't positionable.
+ */
+static int
+write_padding(FILE *fp)
+{
+  static const char zeros[16] = { 0 };
+  off_t             off       = ftello(fp);
+  size_t            n;
+
+  if (off < 0) ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed: can't find offset in binary file");
+  n = (size_t) (aligned_offset(off) - off);
+  if (n > 0 && fwrite(zeros, sizeof(char), n, fp) != n) ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
+  return eslOK;
+}
+
+/* skip_padding()
+ * Read past the padding written by write_padding().
+ * Returns <eslOK> on success, <eslEOF> if <fp> ends first.
+ */
+static int
+skip_padding(FILE *fp)
+{
+  char   pad[16];
+  off_t  off = ftello(fp);
+  size_t n;
+
+  if (off < 0) return eslEOF;
+  n = (size_t) (aligned_offset(off) - off);
+  if (n > 0 && fread(pad, sizeof(char), n, fp) != n) return eslEOF;
+  return eslOK;
+}
+
+/* map_read()
+ * Copy <n> bytes at offset <*pos> of mapped file <mem> of <size>
+ * bytes into <dst>, and advance <*pos> past them. Returns <eslOK>,
+ * or <eslEOF> if the file ends first.
+ */
+static int
+map_read(const char *mem, off_t size, off_t *pos, void *dst, size_t n)
+{
+  if (*pos + (off_t) n > size) return eslEOF;
+  memcpy(dst, mem + *pos, n);
+  *pos += n;
+  return eslOK;
+}
+
+/* map_ref()
+ * Like map_read(), but return a pointer to the <n> bytes in the
+ * map instead of copying them; or NULL if the file ends first.
+ */
+static const void *
+map_ref(const char *mem, off_t size, off_t *pos, size_t n)
+{
+  const void *p;
+
+  if (*pos + (off_t) n > size) return NULL;
+  p     = mem + *pos;
+  *pos += n;
+  return p;
+}
+
 /*-------------------- end, utility routines ---------------------*/
 
 
@@ -779,8 +1154,15 @@ main(int argc, char **argv)
  *****************************************************************/
 #ifdef p7IO_TESTDRIVE
 
+/* utest_ReadWrite()
+ * 
+ * Press <hmm>, <om> into a tmpfile database, in the current aligned
+ * format or, with <aligned> FALSE, in the 3/f format of earlier
+ * HMMERs, and read the profile back, both read and mapped. 3/f files
+ * aren't mapped, and are read as usual.
+ */
 static void
-utest_ReadWrite(P7_HMM *hmm, P7_OPROFILE *om)
+utest_ReadWrite(P7_HMM *hmm, P7_OPROFILE *om, int aligned)
 {
   char        *msg         = "oprofile read/write unit test failure";
   ESL_ALPHABET *abc        = NULL;
@@ -824,7 +1206,7 @@ utest_ReadWrite(P7_HMM *hmm, P7_OPROFILE *om)
 
   if ( p7_hmmfile_WriteASCII(fp,   -1, hmm)     != eslOK) esl_fatal(msg);
   if ( p7_hmmfile_WriteBinary(mfp, -1, hmm)     != eslOK) esl_fatal(msg);
-  if ( p7_oprofile_Write(ffp, pfp, om)          != eslOK) esl_fatal(msg);
+  if ( oprofile_write(ffp, pfp, om, aligned)    != eslOK) esl_fatal(msg);
 
   if ( esl_newssi_AddFile(nssi, tmpfile, 0, &fh)                           != eslOK) esl_fatal(msg);
   if ( esl_newssi_AddKey (nssi, hmm->name, fh, om->offs[p7_MOFFSET], 0, 0) != eslOK) esl_fatal(msg);
@@ -846,6 +1228,22 @@ utest_ReadWrite(P7_HMM *hmm, P7_OPROFILE *om)
        
   p7_oprofile_Destroy(om2);
   p7_hmmfile_Close(hfp);
+
+  /* 4. again, with the scores pointing into the mapped files; on
+   *    systems without mmap(), this is the same as 2.
+   */
+  if ( p7_hmmfile_OpenE(tmpfile, NULL, &hfp, NULL)  != eslOK) esl_fatal(msg);
+  if ( p7_hmmfile_MapPressed(hfp)                   != eslOK) esl_fatal(msg);
+  if ( p7_oprofile_IsAligned(hfp)                   != aligned) esl_fatal(msg);
+  if (!aligned && hfp->fmap != NULL)                            esl_fatal(msg);
+  if ( p7_oprofile_ReadMSV(hfp, &abc, &om2)         != eslOK) esl_fatal(msg);
+  if ( p7_oprofile_ReadRest(hfp, om2)               != eslOK) esl_fatal(msg);
+  if ( p7_oprofile_Compare(om, om2, tolerance, errbuf) != eslOK) esl_fatal("%s\n%s", msg, errbuf);
+  if ( ((uintptr_t) om2->sbv[0] | (uintptr_t) om2->twv | (uintptr_t) om2->tfv) & 0xf) esl_fatal(msg);
+  p7_oprofile_ReconfigLength(om2, 2*om2->L+1); /* configuration is the profile's own, even when mapped */
+  p7_oprofile_Destroy(om2);
+  if ( p7_oprofile_ReadMSV(hfp, &abc, &om2)         != eslEOF) esl_fatal(msg);
+  p7_hmmfile_Close(hfp);
   esl_alphabet_Destroy(abc);
   remove(ssifile);
   remove(ffile);
@@ -909,7 +1307,8 @@ main(int argc, char **argv)
   if (( p7_oprofile_Sample(r, abc, bg, M, L, &hmm, NULL, &om)) != eslOK) esl_fatal("failed to sample HMM and profile");
 
   /* unit test(s) */
-  utest_ReadWrite(hmm, om);
+  utest_ReadWrite(hmm, om, TRUE);
+  utest_ReadWrite(hmm, om, FALSE);
 
   p7_oprofile_Destroy(om);
   p7_hmm_Destroy(hmm);
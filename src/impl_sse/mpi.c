@@ -450,6 +450,14 @@ p7_oprofile_MPIUnpack(char *buf, int n, int *pos, MPI_Comm comm, ESL_ALPHABET **
   if (MPI_Unpack(buf, n, pos,  om->cutoff,       p7_NCUTOFFS,          MPI_FLOAT, comm) != 0) ESL_EXCEPTION(eslESYS, "mpi unpack failed");
   if (MPI_Unpack(buf, n, pos,  om->compo,        p7_MAXABET,           MPI_FLOAT, comm) != 0) ESL_EXCEPTION(eslESYS, "mpi unpack failed");
 
+#ifdef eslENABLE_AVX
+  p7_oprofile_RestripeMSV_avx(om);
+  p7_oprofile_RestripeVF_avx(om);
+#endif
+#ifdef eslENABLE_AVX512
+  p7_oprofile_RestripeFB_avx512(om);
+#endif
+
   *ret_om = om;
   return eslOK;
 
@@ -33,9 +33,9 @@
 /*****************************************************************
  * 1. The p7_MSVFilter() DP implementation.
  *****************************************************************/
- 
-/* Function:  p7_MSVFilter()
- * Synopsis:  Calculates MSV score, vewy vewy fast, in limited precision.
+
+/* Function:  p7_MSVFilter_sse()
+ * Synopsis:  Calculates MSV score with 16-way SSE2 vectors.
  * Incept:    SRE, Wed Dec 26 15:12:25 2007 [Janelia]
  *
  * Purpose:   Calculates an approximation of the MSV score for sequence
@@ -71,7 +71,7 @@
  * Throws:    <eslEINVAL> if <ox> allocation is too small.
  */
 int
-p7_MSVFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc)
+p7_MSVFilter_sse(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc)
 {
   register __m128i mpv;            /* previous row values                                       */
   register __m128i xEv;		   /* E state: keeps max for Mk->E as we go                     */
@@ -100,7 +100,7 @@ p7_MSVFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float
   ox->M   = om->M;
 
   /* Try highly optimized ssv filter first */
-  status = p7_SSVFilter(dsq, L, om, ret_sc);
+  status = p7_SSVFilter_sse(dsq, L, om, ret_sc);
   if (status != eslENORESULT) return status;
 
   /* Initialization. In offset unsigned arithmetic, -infinity is 0, and 0 is om->base.
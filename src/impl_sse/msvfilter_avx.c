@@ -0,0 +1,401 @@
+/* The MSV filter implementation; AVX2 version.
+ *
+ * Same algorithm as msvfilter.c, with 32-way uchar vectors. The
+ * striped score arrays <om->rbv_avx>, <om->sbv_avx> are derived from
+ * the SSE ones by p7_oprofile_RestripeMSV_avx(), and every DP cell is
+ * computed with the same saturated arithmetic, so p7_MSVFilter_avx()
+ * gives exactly the same status and score as p7_MSVFilter_sse().
+ *
+ * Compiled unless HMMER is configured with --disable-avx, or the compiler
+ * can't generate AVX2; called only through dispatch.c, when
+ * the processor supports it.
+ *
+ * Contents:
+ *   1. p7_MSVFilter_avx() implementation
+ *   2. Benchmark driver
+ *   3. Unit tests
+ *   4. Test driver
+ */
+#include "p7_config.h"
+#ifdef eslENABLE_AVX
+
+#include <stdio.h>
+#include <math.h>
+
+#include <immintrin.h>		/* AVX2 */
+
+#include "easel.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+/*****************************************************************
+ * 1. The p7_MSVFilter_avx() DP implementation.
+ *****************************************************************/
+
+/* Function:  p7_MSVFilter_avx()
+ * Synopsis:  Calculates MSV score with 32-way AVX2 vectors.
+ *
+ * Purpose:   Same as <p7_MSVFilter_sse()>, using the AVX2 score
+ *            arrays in <om> and the AVX2 row <ox->dpb_avx> of the
+ *            DP matrix.
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslERANGE> if the score overflows the limited range; in
+ *            this case, this is a high-scoring hit.
+ *
+ * Throws:    <eslEINVAL> if <ox> allocation is too small.
+ */
+int
+p7_MSVFilter_avx(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc)
+{
+  register __m256i mpv;            /* previous row values                                       */
+  register __m256i xEv;		   /* E state: keeps max for Mk->E as we go                     */
+  register __m256i xBv;		   /* B state: splatted vector of B[i-1] for B->Mk calculations */
+  register __m256i sv;		   /* temp storage of 1 curr row value in progress              */
+  register __m256i biasv;	   /* emission bias in a vector                                 */
+  uint8_t  xJ;                     /* special states' scores                                    */
+  int i;			   /* counter over sequence positions 1..L                      */
+  int q;			   /* counter over vectors 0..nq-1                              */
+  int Q        = p7O_NQB_AVX(om->M); /* segment length: # of vectors                            */
+  __m256i *dp  = ox->dpb_avx;	   /* one row dp[0..q..Q-1]                                     */
+  __m256i *rsc;			   /* will point at om->rbv_avx[x] for residue x[i]             */
+
+  __m256i xJv;                     /* vector for states score                                   */
+  __m256i tjbmv;                   /* vector for cost of moving from either J or N through B to an M state */
+  __m256i tecv;                    /* vector for E->C  cost                                     */
+  __m256i basev;                   /* offset for scores                                         */
+  __m256i ceilingv;                /* saturated simd value used to test for overflow            */
+  __m256i tempv;                   /* work vector                                               */
+
+  int status = eslOK;
+
+  /* Check that the DP matrix is ok for us. */
+  if (! (om->layout & p7_ISA_AVX)) ESL_EXCEPTION(eslEINVAL, "profile has no AVX2 score layout");
+  if (Q > ox->allocQB_avx)          ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small");
+  ox->M   = om->M;
+
+  /* Try highly optimized ssv filter first */
+  status = p7_SSVFilter_avx(dsq, L, om, ret_sc);
+  if (status != eslENORESULT) return status;
+
+  /* Initialization. In offset unsigned arithmetic, -infinity is 0, and 0 is om->base.
+   */
+  biasv = _mm256_set1_epi8((int8_t) om->bias_b);
+  for (q = 0; q < Q; q++) dp[q] = _mm256_setzero_si256();
+
+  ceilingv = _mm256_cmpeq_epi8(biasv, biasv);
+  basev    = _mm256_set1_epi8((int8_t) om->base_b);
+  tjbmv    = _mm256_set1_epi8((int8_t) om->tjb_b + (int8_t) om->tbm_b);
+  tecv     = _mm256_set1_epi8((int8_t) om->tec_b);
+
+  xJv = _mm256_subs_epu8(biasv, biasv);
+  xBv = _mm256_subs_epu8(basev, tjbmv);
+
+  for (i = 1; i <= L; i++)
+    {
+      rsc = om->rbv_avx[dsq[i]];
+      xEv = _mm256_setzero_si256();
+
+      /* Shift by one element across the whole 256-bit vector; 0 is our -infinity. */
+      mpv = p7_avx_leftshift_epu8(dp[Q-1]);
+      for (q = 0; q < Q; q++)
+	{
+	  /* Calculate new MMXo(i,q); don't store it yet, hold it in sv. */
+	  sv   = _mm256_max_epu8(mpv, xBv);
+	  sv   = _mm256_adds_epu8(sv, biasv);
+	  sv   = _mm256_subs_epu8(sv, *rsc);   rsc++;
+	  xEv  = _mm256_max_epu8(xEv, sv);
+
+	  mpv   = dp[q];   	  /* Load {MDI}(i-1,q) into mpv */
+	  dp[q] = sv;       	  /* Do delayed store of M(i,q) now that memory is usable */
+	}
+
+      /* immediately detect overflow */
+      tempv = _mm256_adds_epu8(xEv, biasv);
+      tempv = _mm256_cmpeq_epi8(tempv, ceilingv);
+      if (_mm256_movemask_epi8(tempv) != 0)
+	{
+	  *ret_sc = eslINFINITY;
+	  return eslERANGE;
+	}
+
+      /* Now the "special" states, which start from Mk->E (->C, ->J->B) */
+      xEv = _mm256_set1_epi8((int8_t) p7_avx_hmax_epu8(xEv));
+      xEv = _mm256_subs_epu8(xEv, tecv);
+      xJv = _mm256_max_epu8(xJv,xEv);
+
+      xBv = _mm256_max_epu8(basev, xJv);
+      xBv = _mm256_subs_epu8(xBv, tjbmv);
+    } /* end loop over sequence residues 1..L */
+
+  xJ = (uint8_t) _mm256_extract_epi8(xJv, 0);
+
+  /* finally C->T, and add our missing precision on the NN,CC,JJ back */
+  *ret_sc = ((float) (xJ - om->tjb_b) - (float) om->base_b);
+  *ret_sc /= om->scale_b;
+  *ret_sc -= 3.0; /* that's ~ L \log \frac{L}{L+3}, for our NN,CC,JJ */
+
+  return eslOK;
+}
+/*------------------ end, p7_MSVFilter_avx() --------------------*/
+
+
+
+/*****************************************************************
+ * 2. Benchmark driver.
+ *****************************************************************/
+#ifdef p7MSVFILTER_AVX_BENCHMARK
+/*
+   ./msvfilter_avx_benchmark <hmmfile>            runs benchmark
+   ./msvfilter_avx_benchmark -s <hmmfile>         runs the SSE version, for comparison
+ */
+#include "p7_config.h"
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+#include "esl_randomseq.h"
+#include "esl_stopwatch.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",             0 },
+  { "-r",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "set random number seed randomly",                  0 },
+  { "-s",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "run the SSE version instead, for comparison",      0 },
+  { "-L",        eslARG_INT,    "400", NULL, "n>0", NULL,  NULL, NULL, "length of random target seqs",                     0 },
+  { "-N",        eslARG_INT,  "50000", NULL, "n>0", NULL,  NULL, NULL, "number of random target seqs",                     0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options] <hmmfile>";
+static char banner[] = "benchmark driver for the AVX2 MSVFilter() implementation";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go      = p7_CreateDefaultApp(options, 1, argc, argv, banner, usage);
+  char           *hmmfile = esl_opt_GetArg(go, 1);
+  ESL_STOPWATCH  *w       = esl_stopwatch_Create();
+  ESL_RANDOMNESS *r       = esl_randomness_CreateFast(esl_opt_GetBoolean(go, "-r") ? 0 : 42);
+  ESL_ALPHABET   *abc     = NULL;
+  P7_HMMFILE     *hfp     = NULL;
+  P7_HMM         *hmm     = NULL;
+  P7_BG          *bg      = NULL;
+  P7_PROFILE     *gm      = NULL;
+  P7_OPROFILE    *om      = NULL;
+  P7_OMX         *ox      = NULL;
+  int             L       = esl_opt_GetInteger(go, "-L");
+  int             N       = esl_opt_GetInteger(go, "-N");
+  ESL_DSQ        *dsq     = malloc(sizeof(ESL_DSQ) * (L+2));
+  int             i;
+  float           sc;
+  double          base_time, bench_time, Mcs;
+
+  /* select the AVX2 level before any profile is made, so profiles carry its layout */
+  if (p7_dispatch_Select(p7_ISA_AVX) != eslOK) p7_Fail("This processor doesn't support AVX2");
+  if (p7_hmmfile_OpenE(hmmfile, NULL, &hfp, NULL) != eslOK) p7_Fail("Failed to open HMM file %s", hmmfile);
+  if (p7_hmmfile_Read(hfp, &abc, &hmm)            != eslOK) p7_Fail("Failed to read HMM");
+
+  bg = p7_bg_Create(abc);
+  p7_bg_SetLength(bg, L);
+  gm = p7_profile_Create(hmm->M, abc);
+  p7_ProfileConfig(hmm, bg, gm, L, p7_LOCAL);
+  om = p7_oprofile_Create(gm->M, abc);
+  p7_oprofile_Convert(gm, om);
+  p7_oprofile_ReconfigLength(om, L);
+  ox = p7_omx_Create(gm->M, 0, 0);
+
+  /* Get a baseline time: how long it takes just to generate the sequences */
+  esl_stopwatch_Start(w);
+  for (i = 0; i < N; i++) esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+  esl_stopwatch_Stop(w);
+  base_time = w->user;
+
+  /* Run the benchmark */
+  esl_stopwatch_Start(w);
+  for (i = 0; i < N; i++)
+    {
+      esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+      if (esl_opt_GetBoolean(go, "-s")) p7_MSVFilter_sse(dsq, L, om, ox, &sc);
+      else                              p7_MSVFilter_avx(dsq, L, om, ox, &sc);
+    }
+  esl_stopwatch_Stop(w);
+  bench_time = w->user - base_time;
+  Mcs        = (double) N * (double) L * (double) gm->M * 1e-6 / (double) bench_time;
+  esl_stopwatch_Display(stdout, w, "# CPU time: ");
+  printf("# M    = %d\n",   gm->M);
+  printf("# %.1f Mc/s\n", Mcs);
+
+  free(dsq);
+  p7_omx_Destroy(ox);
+  p7_oprofile_Destroy(om);
+  p7_profile_Destroy(gm);
+  p7_bg_Destroy(bg);
+  p7_hmm_Destroy(hmm);
+  p7_hmmfile_Close(hfp);
+  esl_alphabet_Destroy(abc);
+  esl_stopwatch_Destroy(w);
+  esl_randomness_Destroy(r);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /*p7MSVFILTER_AVX_BENCHMARK*/
+/*------------------ end, benchmark driver ----------------------*/
+
+
+
+/*****************************************************************
+ * 3. Unit tests
+ *****************************************************************/
+#ifdef p7MSVFILTER_AVX_TESTDRIVE
+#include "esl_random.h"
+#include "esl_randomseq.h"
+
+/* utest_compare()
+ *
+ * The AVX2 SSV and MSV filters must give exactly the same status and
+ * score as the SSE ones. Compare them for a random model of length
+ * <M> on <N> iid sequences of length <L> and <N> sequences emitted
+ * from the model itself; the emitted ones exercise the overflow and
+ * J state paths.
+ */
+static void
+utest_compare(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  char         msg[] = "msvfilter_avx compare unit test failed";
+  P7_HMM      *hmm   = NULL;
+  P7_PROFILE  *gm    = NULL;
+  P7_OPROFILE *om    = NULL;
+  ESL_SQ      *sq    = esl_sq_CreateDigital(abc);
+  P7_OMX      *ox    = p7_omx_Create(M, 0, 0);
+  float        sc1, sc2;
+  int          st1, st2;
+  int          n;
+
+  if (p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om) != eslOK) esl_fatal(msg);
+
+  for (n = 0; n < 2*N; n++)
+    {
+      if (n < N) { if (esl_sq_GrowTo(sq, L) != eslOK) esl_fatal(msg); esl_rsq_xfIID(r, bg->f, abc->K, L, sq->dsq); sq->n = L; }
+      else if (p7_ProfileEmit(r, hmm, gm, bg, sq, NULL) != eslOK) esl_fatal(msg);
+
+      p7_oprofile_ReconfigLength(om, sq->n);
+
+      sc1 = sc2 = 0.;
+      st1 = p7_SSVFilter_sse(sq->dsq, sq->n, om, &sc1);
+      st2 = p7_SSVFilter_avx(sq->dsq, sq->n, om, &sc2);
+      if (st1 != st2)                      esl_fatal("%s: SSV status %d != %d", msg, st1, st2);
+      if (st1 != eslENORESULT && sc1 != sc2) esl_fatal("%s: SSV score %f != %f", msg, sc1, sc2);
+
+      st1 = p7_MSVFilter_sse(sq->dsq, sq->n, om, ox, &sc1);
+      st2 = p7_MSVFilter_avx(sq->dsq, sq->n, om, ox, &sc2);
+      if (st1 != st2)  esl_fatal("%s: MSV status %d != %d", msg, st1, st2);
+      if (sc1 != sc2)  esl_fatal("%s: MSV score %f != %f",  msg, sc1, sc2);
+
+      esl_sq_Reuse(sq);
+    }
+
+  esl_sq_Destroy(sq);
+  p7_hmm_Destroy(hmm);
+  p7_omx_Destroy(ox);
+  p7_profile_Destroy(gm);
+  p7_oprofile_Destroy(om);
+}
+#endif /*p7MSVFILTER_AVX_TESTDRIVE*/
+/*-------------------- end, unit tests --------------------------*/
+
+
+
+/*****************************************************************
+ * 4. Test driver
+ *****************************************************************/
+#ifdef p7MSVFILTER_AVX_TESTDRIVE
+/*
+   gcc -g -Wall -mavx2 -std=gnu99 -I.. -L.. -I../../easel -L../../easel -o msvfilter_avx_utest -Dp7MSVFILTER_AVX_TESTDRIVE msvfilter_avx.c -lhmmer -leasel -lm
+   ./msvfilter_avx_utest
+ */
+#include "p7_config.h"
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_sq.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",           0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                  0 },
+  { "-v",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "be verbose",                                     0 },
+  { "-L",        eslARG_INT,    "200", NULL, NULL,  NULL,  NULL, NULL, "size of random sequences to sample",             0 },
+  { "-M",        eslARG_INT,    "145", NULL, NULL,  NULL,  NULL, NULL, "size of random models to sample",                0 },
+  { "-N",        eslARG_INT,    "100", NULL, NULL,  NULL,  NULL, NULL, "number of random sequences to sample",           0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for the AVX2 MSVFilter() implementation";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go   = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *r    = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *abc  = NULL;
+  P7_BG          *bg   = NULL;
+  int             M    = esl_opt_GetInteger(go, "-M");
+  int             L    = esl_opt_GetInteger(go, "-L");
+  int             N    = esl_opt_GetInteger(go, "-N");
+
+  /* On a processor without AVX2 there's nothing to test; pass. */
+  if (p7_dispatch_Select(p7_ISA_AVX) != eslOK) {
+    if (esl_opt_GetBoolean(go, "-v")) printf("No AVX2 on this processor; skipping tests\n");
+    esl_randomness_Destroy(r);
+    esl_getopts_Destroy(go);
+    return eslOK;
+  }
+
+  if ((abc = esl_alphabet_Create(eslDNA)) == NULL)  esl_fatal("failed to create alphabet");
+  if ((bg = p7_bg_Create(abc))            == NULL)  esl_fatal("failed to create null model");
+
+  if (esl_opt_GetBoolean(go, "-v")) printf("MSVFilter_avx() tests, DNA\n");
+  utest_compare(r, abc, bg, M,   L, N);   /* normal sized models       */
+  utest_compare(r, abc, bg, 1,   L, 10);  /* size 1 models             */
+  utest_compare(r, abc, bg, M,   1, 10);  /* size 1 sequences          */
+  utest_compare(r, abc, bg, 600, L, 10);  /* enough vectors for >1 SSV band */
+
+  esl_alphabet_Destroy(abc);
+  p7_bg_Destroy(bg);
+
+  if ((abc = esl_alphabet_Create(eslAMINO)) == NULL)  esl_fatal("failed to create alphabet");
+  if ((bg = p7_bg_Create(abc))              == NULL)  esl_fatal("failed to create null model");
+
+  if (esl_opt_GetBoolean(go, "-v")) printf("MSVFilter_avx() tests, protein\n");
+  utest_compare(r, abc, bg, M,   L, N);
+  utest_compare(r, abc, bg, 1,   L, 10);
+  utest_compare(r, abc, bg, M,   1, 10);
+  utest_compare(r, abc, bg, 600, L, 10);
+
+  esl_alphabet_Destroy(abc);
+  p7_bg_Destroy(bg);
+
+  esl_getopts_Destroy(go);
+  esl_randomness_Destroy(r);
+  return eslOK;
+}
+#endif /*p7MSVFILTER_AVX_TESTDRIVE*/
+/*---------------------- end, test driver -----------------------*/
+
+
+#else /*! eslENABLE_AVX*/
+/* Standard compiler-pleasing mantra for an #ifdef'd-out, empty code file. */
+void p7_msvfilter_avx_silence_hack(void) { return; }
+#if defined p7MSVFILTER_AVX_TESTDRIVE || defined p7MSVFILTER_AVX_BENCHMARK
+int main(void) { return 0; }
+#endif
+#endif /*eslENABLE_AVX*/
@@ -47,11 +47,7 @@ p7_Null2_ByExpectation(const P7_OPROFILE *om, const P7_OMX *pp, float *null2)
   int      Ld   = pp->L;
   int      Q    = p7O_NQF(M);
   float   *xmx  = pp->xmx;	/* enables use of XMXo(i,s) macro */
-  float    norm;
-  __m128  *rp;
-  __m128   sv;
-  float    xfactor;
-  int      i,q,x;
+  int      i,q;
   
   /* Calculate expected # of times that each emitting state was used
    * in generating the Ld residues in this domain.
@@ -74,6 +70,39 @@ p7_Null2_ByExpectation(const P7_OPROFILE *om, const P7_OMX *pp, float *null2)
       XMXo(0,p7X_J) += XMXo(i,p7X_J); 
     }
 
+  return p7_Null2_ByExpectedCounts(om, pp, null2);
+}
+
+
+/* Function:  p7_Null2_ByExpectedCounts()
+ * Synopsis:  Finish a null2 calculation from summed posterior probabilities.
+ *
+ * Purpose:   The second half of <p7_Null2_ByExpectation()>, for a
+ *            caller that has already summed the posterior
+ *            probabilities of rows 1..<pp->L> of <pp> into its row 0
+ *            (MI cells, and the N,C,J specials), because the
+ *            rows themselves aren't all kept at once; see
+ *            <p7_OptimalAccuracyCheckpointed()>. 
+ *
+ * Args:      om    - profile, in any mode, target length model set to <L>
+ *            pp    - posterior prob matrix; row 0 holds the summed posteriors
+ *            null2 - RETURN: null2 log odds scores per residue; <0..Kp-1>; caller allocated space
+ *
+ * Returns:   <eslOK> on success. Row 0 of <pp> is overwritten.
+ */
+int
+p7_Null2_ByExpectedCounts(const P7_OPROFILE *om, const P7_OMX *pp, float *null2)
+{
+  int      M    = om->M;
+  int      Ld   = pp->L;
+  int      Q    = p7O_NQF(M);
+  float   *xmx  = pp->xmx;	/* enables use of XMXo(i,s) macro */
+  float    norm;
+  __m128  *rp;
+  __m128   sv;
+  float    xfactor;
+  int      q,x;
+
   /* Convert those expected #'s to frequencies, to use as posterior weights. */
   norm = 1.0 / (float) Ld;
   sv   = _mm_set1_ps(norm);
@@ -13,6 +13,7 @@
 #include "p7_config.h"
 
 #include <float.h>
+#include <math.h>
 
 #include <xmmintrin.h>
 #include <emmintrin.h>
@@ -28,34 +29,35 @@
  * 1. Optimal accuracy alignment, DP fill
  *****************************************************************/
 
-/* Function:  p7_OptimalAccuracy()
- * Synopsis:  DP fill of an optimal accuracy alignment calculation.
- * Incept:    SRE, Mon Aug 18 11:04:48 2008 [Janelia]
- *
- * Purpose:   Calculates the fill step of the optimal accuracy decoding
- *            algorithm \citep{Kall05}.
- *            
- *            Caller provides the posterior decoding matrix <pp>,
- *            which was calculated by Forward/Backward on a target sequence
- *            of length <pp->L> using the query model <om>.
- *            
- *            Caller also provides a DP matrix <ox>, allocated for a full
- *            <om->M> by <L> comparison. The routine fills this in
- *            with OA scores.
- *  
- * Args:      gm    - query profile      
- *            pp    - posterior decoding matrix created by <p7_GPosteriorDecoding()>
- *            gx    - RESULT: caller provided DP matrix for <gm->M> by <L> 
- *            ret_e - RETURN: expected number of correctly decoded positions 
- *
- * Returns:   <eslOK> on success, and <*ret_e> contains the final OA
- *            score, which is the expected number of correctly decoded
- *            positions in the target sequence (up to <L>).
- *
- * Throws:    (no abnormal error conditions)
+/* oa_init()
+ * Initialize row 0 of OA matrix <ox>, for a target of length <L>.
  */
-int
-p7_OptimalAccuracy(const P7_OPROFILE *om, const P7_OMX *pp, P7_OMX *ox, float *ret_e)
+static void
+oa_init(const P7_OPROFILE *om, P7_OMX *ox, int L)
+{
+  float  *xmx  = ox->xmx;
+  __m128 *dpc  = ox->dpf[0];
+  __m128  infv = _mm_set1_ps(-eslINFINITY);
+  int     Q    = p7O_NQF(om->M);
+  int     q;
+
+  ox->M = om->M;
+  ox->L = L;
+  for (q = 0; q < Q; q++) MMO(dpc, q) = IMO(dpc,q) = DMO(dpc,q) = infv;
+  XMXo(0, p7X_E)    = -eslINFINITY;
+  XMXo(0, p7X_N)    = 0.;
+  XMXo(0, p7X_J)    = -eslINFINITY;
+  XMXo(0, p7X_B)    = 0.;
+  XMXo(0, p7X_C)    = -eslINFINITY;
+}
+
+/* oa_rows()
+ * Calculate OA rows <ia>+1..<ib> of <ox> from posterior probability
+ * rows <ia>+1..<ib> of <pp>, starting from OA row <ia>, which must
+ * already be calculated.
+ */
+static void
+oa_rows(const P7_OPROFILE *om, const P7_OMX *pp, P7_OMX *ox, int ia, int ib)
 {
   register __m128 mpv, dpv, ipv;   /* previous row values                                       */
   register __m128 sv;		   /* temp storage of 1 curr row value in progress              */
@@ -63,7 +65,7 @@ p7_OptimalAccuracy(const P7_OPROFILE *om, const P7_OMX *pp, P7_OMX *ox, float *r
   register __m128 xBv;		   /* B state: splatted vector of B[i-1] for B->Mk calculations */
   register __m128 dcv;
   float  *xmx = ox->xmx;
-  __m128 *dpc = ox->dpf[0];        /* current row, for use in {MDI}MO(dpp,q) access macro       */
+  __m128 *dpc = ox->dpf[ia];       /* current row, for use in {MDI}MO(dpp,q) access macro       */
   __m128 *dpp;                     /* previous row, for use in {MDI}MO(dpp,q) access macro      */
   __m128 *ppp;			   /* quads in the <pp> posterior probability matrix            */
   __m128 *tp;			   /* quads in the <om->tfv> transition scores                  */
@@ -76,16 +78,7 @@ p7_OptimalAccuracy(const P7_OPROFILE *om, const P7_OMX *pp, P7_OMX *ox, float *r
   int i;
   float t1, t2;
 
-  ox->M = om->M;
-  ox->L = pp->L;
-  for (q = 0; q < Q; q++) MMO(dpc, q) = IMO(dpc,q) = DMO(dpc,q) = infv;
-  XMXo(0, p7X_E)    = -eslINFINITY;
-  XMXo(0, p7X_N)    = 0.;
-  XMXo(0, p7X_J)    = -eslINFINITY;
-  XMXo(0, p7X_B)    = 0.;
-  XMXo(0, p7X_C)    = -eslINFINITY;
-
-  for (i = 1; i <= pp->L; i++)
+  for (i = ia+1; i <= ib; i++)
     {
       dpp = dpc;		/* previous DP row in OA matrix */
       dpc = ox->dpf[i];   	/* current DP row in OA matrix  */
@@ -164,10 +157,242 @@ p7_OptimalAccuracy(const P7_OPROFILE *om, const P7_OMX *pp, P7_OMX *ox, float *r
       t2 = ( (om->xf[p7O_J][p7O_MOVE] == 0.0) ? 0.0 : ox->xmx[i*p7X_NXCELLS+p7X_J]);
       ox->xmx[i*p7X_NXCELLS+p7X_B] = ESL_MAX(t1, t2);
     }
+}
+
+
+/* Function:  p7_OptimalAccuracy()
+ * Synopsis:  DP fill of an optimal accuracy alignment calculation.
+ * Incept:    SRE, Mon Aug 18 11:04:48 2008 [Janelia]
+ *
+ * Purpose:   Calculates the fill step of the optimal accuracy decoding
+ *            algorithm \citep{Kall05}.
+ *            
+ *            Caller provides the posterior decoding matrix <pp>,
+ *            which was calculated by Forward/Backward on a target sequence
+ *            of length <pp->L> using the query model <om>.
+ *            
+ *            Caller also provides a DP matrix <ox>, allocated for a full
+ *            <om->M> by <L> comparison. The routine fills this in
+ *            with OA scores.
+ *  
+ * Args:      gm    - query profile      
+ *            pp    - posterior decoding matrix created by <p7_GPosteriorDecoding()>
+ *            gx    - RESULT: caller provided DP matrix for <gm->M> by <L> 
+ *            ret_e - RETURN: expected number of correctly decoded positions 
+ *
+ * Returns:   <eslOK> on success, and <*ret_e> contains the final OA
+ *            score, which is the expected number of correctly decoded
+ *            positions in the target sequence (up to <L>).
+ *
+ * Throws:    (no abnormal error conditions)
+ */
+int
+p7_OptimalAccuracy(const P7_OPROFILE *om, const P7_OMX *pp, P7_OMX *ox, float *ret_e)
+{
+  oa_init(om, ox, pp->L);
+  oa_rows(om, pp, ox, 0, pp->L);
 
   *ret_e = ox->xmx[pp->L*p7X_NXCELLS+p7X_C];
   return eslOK;
 }
+
+
+/* Function:  p7_OptimalAccuracyCheckpointed()
+ * Synopsis:  OA DP fill in checkpointed matrices.
+ *
+ * Purpose:   Same as <p7_OptimalAccuracy()>, for target sequences too
+ *            long for full matrices. Caller provides the Forward and
+ *            Backward matrices <oxf> and <oxb>, filled by
+ *            <p7_Forward()> and <p7_Backward()> for <dsq> in
+ *            checkpointed layout, and two more matrices <pp> and
+ *            <ox>, laid out the same way; all four by
+ *            <p7_omx_GrowToCheckpointed(ox, M, L)> for the same <L>.
+ *
+ *            Segment by segment, the Forward and Backward rows are
+ *            recalculated, decoded into <pp>, and passed on to the
+ *            OA fill in <ox>, so the posterior probability matrix is
+ *            never held in full. The OA score is identical to what
+ *            <p7_OptimalAccuracy()> gets from a full <pp>.
+ *
+ *            Since each posterior row is only seen here once, their
+ *            sum is collected on the way: on return, row 0 of <pp>
+ *            is what <p7_Null2_ByExpectation()> would have made of
+ *            it, ready for <p7_Null2_ByExpectedCounts()>.
+ *            <p7_OATraceCheckpointed()> doesn't use row 0, so the
+ *            null2 calculation can be done before or after the
+ *            traceback.
+ *
+ * Args:      dsq   - digital target sequence, 1..L
+ *            om    - query profile
+ *            oxf   - filled checkpointed Forward matrix
+ *            oxb   - filled checkpointed Backward matrix
+ *            pp    - RESULT: posterior decoding workspace; row 0 has summed posteriors
+ *            ox    - RESULT: checkpointed OA matrix
+ *            ret_e - RETURN: expected number of correctly decoded positions 
+ *
+ * Returns:   <eslOK> on success, and <*ret_e> contains the final OA
+ *            score.
+ *
+ *            <eslERANGE> if the posterior decoding overflows; see
+ *            <p7_Decoding()>. The OA matrix must not be used then.
+ *
+ * Throws:    <eslEINVAL> if the matrices aren't in a common checkpointed layout.
+ */
+int
+p7_OptimalAccuracyCheckpointed(const ESL_DSQ *dsq, const P7_OPROFILE *om, P7_OMX *oxf, P7_OMX *oxb, P7_OMX *pp, P7_OMX *ox, float *ret_e)
+{
+  float  *xmx = pp->xmx;	/* enables use of XMXo(i,s) macro on <pp> */
+  __m128 *acc = pp->dpf[0];
+  __m128  zerov = _mm_setzero_ps();
+  int     L = oxf->L;
+  int     S = oxf->chkS;
+  int     Q = p7O_NQF(om->M);
+  int     a, b, i, q;
+  int     status;
+
+  if (S == 0 || oxb->chkS != S || pp->chkS != S || ox->chkS != S) ESL_EXCEPTION(eslEINVAL, "matrices not in a common checkpointed layout");
+
+  oa_init(om, ox, L);
+  for (q = 0; q < Q; q++) MMO(acc,q) = DMO(acc,q) = IMO(acc,q) = zerov;
+  XMXo(0,p7X_N) = XMXo(0,p7X_C) = XMXo(0,p7X_J) = 0.;
+
+  for (a = 0; a < L; a = b)
+    {
+      b = ESL_MIN(a+S, L);
+      p7_ForwardSegment (dsq, om, oxf,      a, b);
+      p7_BackwardSegment(dsq, om, oxf, oxb, a, b);
+      if ((status = p7_DecodingSegment(om, oxf, oxb, pp, a, b)) != eslOK) return status;
+
+      /* sum the expected counts, in the same order as p7_Null2_ByExpectation() */
+      for (i = a+1; i <= b; i++)
+	{
+	  for (q = 0; q < Q; q++)
+	    {
+	      MMO(acc,q) = _mm_add_ps(MMO(pp->dpf[i],q), MMO(acc,q));
+	      IMO(acc,q) = _mm_add_ps(IMO(pp->dpf[i],q), IMO(acc,q));
+	    }
+	  XMXo(0,p7X_N) += XMXo(i,p7X_N);
+	  XMXo(0,p7X_C) += XMXo(i,p7X_C);
+	  XMXo(0,p7X_J) += XMXo(i,p7X_J);
+	}
+
+      oa_rows(om, pp, ox, a, b);
+    }
+
+  *ret_e = ox->xmx[L*p7X_NXCELLS+p7X_C];
+  return eslOK;
+}
+
+
+/* Function:  p7_DecodingOptimalAccuracy()
+ * Synopsis:  Posterior decoding and OA DP fill in one pass.
+ *
+ * Purpose:   Does in one pass over the rows what
+ *            <p7_Decoding(om, oxf, oxb, oxb)>,
+ *            <p7_OptimalAccuracy(om, oxb, oxf, &e)> and the summing
+ *            half of <p7_Null2_ByExpectation()> do in three. Each
+ *            row <i> of the Forward and Backward matrices <oxf>,
+ *            <oxb> is decoded into posterior probabilities over row
+ *            <i> of <oxb>, which then goes straight into OA row <i>,
+ *            over row <i> of <oxf>; the rows of <oxf> are no longer
+ *            needed by then, except for the specials of row <i-1>,
+ *            which are kept aside.
+ *
+ *            On return, <oxb> holds the posterior decoding matrix
+ *            and <oxf> the OA matrix, ready for
+ *            <p7_OATrace(om, oxb, oxf, tr)>, and row 0 of <oxb> holds
+ *            the summed posteriors, ready for
+ *            <p7_Null2_ByExpectedCounts()>. All values are identical
+ *            to the three-pass calculation's.
+ *
+ * Args:      om    - query profile
+ *            oxf   - filled Forward matrix; RESULT: OA matrix
+ *            oxb   - filled Backward matrix; RESULT: posterior decoding matrix
+ *            ret_e - RETURN: expected number of correctly decoded positions 
+ *
+ * Returns:   <eslOK> on success, and <*ret_e> contains the final OA
+ *            score.
+ *
+ *            <eslERANGE> if the posterior decoding overflows; see
+ *            <p7_Decoding()>. Neither matrix must be used then.
+ *
+ * Throws:    (no abnormal error conditions)
+ */
+int
+p7_DecodingOptimalAccuracy(const P7_OPROFILE *om, P7_OMX *oxf, P7_OMX *oxb, float *ret_e)
+{
+  P7_OMX *pp    = oxb;		/* posteriors overwrite the Backward rows */
+  P7_OMX *ox    = oxf;		/* OA scores overwrite the Forward rows   */
+  float  *xmx   = pp->xmx;	/* enables use of XMXo(i,s) macro on <pp> */
+  __m128 *acc   = pp->dpf[0];
+  __m128 *ppv;
+  __m128 *fv;
+  __m128  totrv;
+  __m128  zerov = _mm_setzero_ps();
+  int     L     = oxf->L;
+  int     M     = om->M;
+  int     Q     = p7O_NQF(M);
+  float   scaleproduct = 1.0 / oxb->xmx[p7X_N];
+  float   fN, fJ, fC;		/* Forward N,J,C of row i-1 */
+  int     i, q;
+
+  fN = oxf->xmx[p7X_N];
+  fJ = oxf->xmx[p7X_J];
+  fC = oxf->xmx[p7X_C];
+  pp->M = M;
+  pp->L = L;
+  oa_init(om, ox, L);
+  for (q = 0; q < Q; q++) MMO(acc,q) = DMO(acc,q) = IMO(acc,q) = zerov;
+  XMXo(0,p7X_E) = XMXo(0,p7X_N) = XMXo(0,p7X_J) = XMXo(0,p7X_C) = XMXo(0,p7X_B) = 0.;
+
+  for (i = 1; i <= L; i++)
+    {
+      /* Decode row i in place, as p7_Decoding() does */
+      ppv   = pp->dpf[i];
+      fv    = oxf->dpf[i];
+      totrv = _mm_set1_ps(scaleproduct * oxf->xmx[i*p7X_NXCELLS+p7X_SCALE]);
+      for (q = 0; q < Q; q++)
+	{
+	  *ppv = _mm_mul_ps(*fv,  *ppv);
+	  *ppv = _mm_mul_ps(*ppv,  totrv);
+	  ppv++;  fv++;
+
+	  *ppv = _mm_setzero_ps();
+	  ppv++;  fv++;
+
+	  *ppv = _mm_mul_ps(*fv,  *ppv);
+	  *ppv = _mm_mul_ps(*ppv,  totrv);
+	  ppv++;  fv++;
+	}
+      XMXo(i,p7X_E) = 0.0;
+      XMXo(i,p7X_N) = fN * XMXo(i,p7X_N) * om->xf[p7O_N][p7O_LOOP] * scaleproduct;
+      XMXo(i,p7X_J) = fJ * XMXo(i,p7X_J) * om->xf[p7O_J][p7O_LOOP] * scaleproduct;
+      XMXo(i,p7X_C) = fC * XMXo(i,p7X_C) * om->xf[p7O_C][p7O_LOOP] * scaleproduct;
+      XMXo(i,p7X_B) = 0.0;
+
+      if (oxb->has_own_scales) scaleproduct *= oxf->xmx[i*p7X_NXCELLS+p7X_SCALE] /  oxb->xmx[i*p7X_NXCELLS+p7X_SCALE];
+
+      /* Sum expected counts for null2, in the same order as p7_Null2_ByExpectation() */
+      for (q = 0; q < Q; q++)
+	{
+	  MMO(acc,q) = _mm_add_ps(MMO(pp->dpf[i],q), MMO(acc,q));
+	  IMO(acc,q) = _mm_add_ps(IMO(pp->dpf[i],q), IMO(acc,q));
+	}
+      XMXo(0,p7X_N) += XMXo(i,p7X_N);
+      XMXo(0,p7X_C) += XMXo(i,p7X_C);
+      XMXo(0,p7X_J) += XMXo(i,p7X_J);
+
+      /* OA row i overwrites Forward row i */
+      fN = oxf->xmx[i*p7X_NXCELLS+p7X_N];
+      fJ = oxf->xmx[i*p7X_NXCELLS+p7X_J];
+      fC = oxf->xmx[i*p7X_NXCELLS+p7X_C];
+      oa_rows(om, pp, ox, i-1, i);
+    }
+
+  *ret_e = ox->xmx[L*p7X_NXCELLS+p7X_C];
+  if (isinf(scaleproduct)) return eslERANGE;
+  else                     return eslOK;
+}
 /*------------------- end, OA DP fill ---------------------------*/
 
 
@@ -262,6 +487,86 @@ p7_OATrace(const P7_OPROFILE *om, const P7_OMX *pp, const P7_OMX *ox, P7_TRACE *
   return p7_trace_Reverse(tr);
 }
 
+/* Function:  p7_OATraceCheckpointed()
+ * Synopsis:  OA traceback in checkpointed matrices.
+ *
+ * Purpose:   Same as <p7_OATrace()>, for the checkpointed matrices
+ *            that <p7_OptimalAccuracyCheckpointed()> just used and
+ *            filled: as the traceback moves back into a segment, its
+ *            Forward, Backward, posterior and OA rows are recalculated
+ *            from the checkpoints. The trace is identical to what
+ *            <p7_OATrace()> gets from full matrices.
+ *
+ * Args:      dsq - digital target sequence, 1..L
+ *            om  - profile
+ *            oxf - checkpointed Forward matrix
+ *            oxb - checkpointed Backward matrix
+ *            pp  - posterior probability workspace
+ *            ox  - OA matrix filled by <p7_OptimalAccuracyCheckpointed()>
+ *            tr  - storage for the recovered traceback
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation error.
+ *            <eslEINVAL> if the trace <tr> isn't empty (needs to be Reuse()'d).
+ */
+int
+p7_OATraceCheckpointed(const ESL_DSQ *dsq, const P7_OPROFILE *om, P7_OMX *oxf, P7_OMX *oxb, P7_OMX *pp, P7_OMX *ox, P7_TRACE *tr)
+{
+  int   i   = ox->L;		/* position in sequence 1..L */
+  int   k   = 0;		/* position in model 1..M */
+  int   S   = ox->chkS;
+  int   a   = ox->L;		/* rows a+1..b are valid in all four matrices; none yet */
+  int   b;
+  int   s0, s1;			/* choice of a state */
+  float postprob;
+  int   status;			
+  
+  if (tr->N != 0) ESL_EXCEPTION(eslEINVAL, "trace not empty; needs to be Reuse()'d?");
+
+  if ((status = p7_trace_AppendWithPP(tr, p7T_T, k, i, 0.0)) != eslOK) return status;
+  if ((status = p7_trace_AppendWithPP(tr, p7T_C, k, i, 0.0)) != eslOK) return status;
+
+  s0 = tr->st[tr->N-1];
+  while (s0 != p7T_S)
+    {
+      /* Every step reads rows i-1..i at most, and row a is a checkpoint: 
+       * so once i reaches a, bring back the segment before it.
+       */
+      if (i > 0 && i <= a)
+	{
+	  a = ((i-1) / S) * S;
+	  b = ESL_MIN(a+S, ox->L);
+	  p7_ForwardSegment (dsq, om, oxf,      a, b);
+	  p7_BackwardSegment(dsq, om, oxf, oxb, a, b);
+	  p7_DecodingSegment(om, oxf, oxb, pp,  a, b);
+	  oa_rows(om, pp, ox, a, b);
+	}
+
+      switch (s0) {
+      case p7T_M: s1 = select_m(om,     ox, i, k);  k--; i--; break;
+      case p7T_D: s1 = select_d(om,     ox, i, k);  k--;      break;
+      case p7T_I: s1 = select_i(om,     ox, i, k);       i--; break;
+      case p7T_N: s1 = select_n(i);                           break;
+      case p7T_C: s1 = select_c(om, pp, ox, i);               break;
+      case p7T_J: s1 = select_j(om, pp, ox, i);               break;
+      case p7T_E: s1 = select_e(om,     ox, i, &k);           break;
+      case p7T_B: s1 = select_b(om,     ox, i);               break;
+      default: ESL_EXCEPTION(eslEINVAL, "bogus state in traceback");
+      }
+      if (s1 == -1) ESL_EXCEPTION(eslEINVAL, "OA traceback choice failed");
+
+      postprob = get_postprob(pp, s1, s0, k, i);
+      if ((status = p7_trace_AppendWithPP(tr, s1, k, i, postprob)) != eslOK) return status;
+
+      if ( (s1 == p7T_N || s1 == p7T_J || s1 == p7T_C) && s1 == s0) i--;
+      s0 = s1;
+    } /* end traceback, at S state */
+  tr->M = om->M;
+  tr->L = ox->L;
+  return p7_trace_Reverse(tr);
+}
+
 static inline float
 get_postprob(const P7_OMX *pp, int scur, int sprv, int k, int i)
 {
@@ -577,6 +882,7 @@ main(int argc, char **argv)
 #include "esl_alphabet.h"
 #include "esl_getopts.h"
 #include "esl_random.h"
+#include "esl_randomseq.h"
 /* 
  * 1. Compare accscore to GOptimalAccuracy().
  * 2. Compare trace to GOATrace().
@@ -728,6 +1034,149 @@ utest_optacc(ESL_GETOPTS *go, ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, i
   p7_hmm_Destroy(hmm);
 }
 
+
+/* utest_checkpointed()
+ * 
+ * The checkpointed OA fill and traceback recalculate the same rows
+ * in the same order as the full-matrix versions, so the Forward
+ * score, OA score, OA trace, and null2 have to be identical, not
+ * just close.
+ */
+static void
+utest_checkpointed(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  char        *msg = "checkpointed optimal accuracy unit test failed";
+  P7_HMM      *hmm = NULL;
+  P7_PROFILE  *gm  = NULL;
+  P7_OPROFILE *om  = NULL;
+  ESL_SQ      *sq  = esl_sq_CreateDigital(abc);
+  P7_OMX      *ox1 = p7_omx_Create(M, L, L);
+  P7_OMX      *ox2 = p7_omx_Create(M, L, L);
+  P7_OMX      *cxf = p7_omx_Create(M, 0, 0);
+  P7_OMX      *cxb = p7_omx_Create(M, 0, 0);
+  P7_OMX      *cpp = p7_omx_Create(M, 0, 0);
+  P7_OMX      *cox = p7_omx_Create(M, 0, 0);
+  P7_TRACE    *tr  = p7_trace_CreateWithPP();
+  P7_TRACE    *trc = p7_trace_CreateWithPP();
+  float        null2[p7_MAXCODE];
+  float        null2c[p7_MAXCODE];
+  float        fsc, fscc, accscore, accscore_c;
+  int          x;
+
+  if (p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om)!= eslOK) esl_fatal(msg);
+  while (N--)
+    {
+      if (esl_sq_GrowTo(sq, L)                            != eslOK) esl_fatal(msg);
+      if (esl_rsq_xfIID(r, bg->f, abc->K, L, sq->dsq)     != eslOK) esl_fatal(msg);
+      sq->n = L;
+
+      if (p7_omx_GrowTo(ox1, M, L, L)                     != eslOK) esl_fatal(msg);
+      if (p7_omx_GrowTo(ox2, M, L, L)                     != eslOK) esl_fatal(msg);
+      if (p7_Forward (sq->dsq, L, om, ox1,      &fsc)     != eslOK) esl_fatal(msg);
+      if (p7_Backward(sq->dsq, L, om, ox1, ox2, NULL)     != eslOK) esl_fatal(msg);
+      if (p7_Decoding(om, ox1, ox2, ox2)                  != eslOK) esl_fatal(msg);
+      if (p7_Null2_ByExpectation(om, ox2, null2)          != eslOK) esl_fatal(msg);
+      if (p7_OptimalAccuracy(om, ox2, ox1, &accscore)     != eslOK) esl_fatal(msg);
+      if (p7_OATrace(om, ox2, ox1, tr)                    != eslOK) esl_fatal(msg);
+
+      if (p7_omx_GrowToCheckpointed(cxf, M, L)            != eslOK) esl_fatal(msg);
+      if (p7_omx_GrowToCheckpointed(cxb, M, L)            != eslOK) esl_fatal(msg);
+      if (p7_omx_GrowToCheckpointed(cpp, M, L)            != eslOK) esl_fatal(msg);
+      if (p7_omx_GrowToCheckpointed(cox, M, L)            != eslOK) esl_fatal(msg);
+      if (p7_Forward (sq->dsq, L, om, cxf,      &fscc)    != eslOK) esl_fatal(msg);
+      if (p7_Backward(sq->dsq, L, om, cxf, cxb, NULL)     != eslOK) esl_fatal(msg);
+      if (p7_OptimalAccuracyCheckpointed(sq->dsq, om, cxf, cxb, cpp, cox, &accscore_c) != eslOK) esl_fatal(msg);
+      if (p7_OATraceCheckpointed(sq->dsq, om, cxf, cxb, cpp, cox, trc)                 != eslOK) esl_fatal(msg);
+      if (p7_Null2_ByExpectedCounts(om, cpp, null2c)      != eslOK) esl_fatal(msg);
+
+      if (p7_trace_Validate(trc, abc, sq->dsq, NULL)      != eslOK) esl_fatal(msg);
+      if (p7_trace_Compare(tr, trc, 0.0)                  != eslOK) esl_fatal(msg);
+      if (fsc      != fscc)                                         esl_fatal(msg);
+      if (accscore != accscore_c)                                   esl_fatal(msg);
+      for (x = 0; x < abc->Kp; x++)
+	if (null2[x] != null2c[x])                                  esl_fatal(msg);
+
+      p7_trace_Reuse(tr);
+      p7_trace_Reuse(trc);
+    }
+
+  p7_trace_Destroy(trc);
+  p7_trace_Destroy(tr);
+  p7_omx_Destroy(cox);
+  p7_omx_Destroy(cpp);
+  p7_omx_Destroy(cxb);
+  p7_omx_Destroy(cxf);
+  p7_omx_Destroy(ox2);
+  p7_omx_Destroy(ox1);  
+  esl_sq_Destroy(sq);
+  p7_oprofile_Destroy(om);
+  p7_profile_Destroy(gm);
+  p7_hmm_Destroy(hmm);
+}
+
+/* utest_fused()
+ * 
+ * p7_DecodingOptimalAccuracy() does the same arithmetic as
+ * p7_Decoding(), p7_OptimalAccuracy() and p7_Null2_ByExpectation(),
+ * in a different order of rows, so its OA score, OA trace, and null2
+ * have to be identical to theirs.
+ */
+static void
+utest_fused(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  char        *msg = "fused decoding/optimal accuracy unit test failed";
+  P7_HMM      *hmm = NULL;
+  P7_PROFILE  *gm  = NULL;
+  P7_OPROFILE *om  = NULL;
+  ESL_SQ      *sq  = esl_sq_CreateDigital(abc);
+  P7_OMX      *ox1 = p7_omx_Create(M, L, L);
+  P7_OMX      *ox2 = p7_omx_Create(M, L, L);
+  P7_TRACE    *tr  = p7_trace_CreateWithPP();
+  P7_TRACE    *trf = p7_trace_CreateWithPP();
+  float        null2[p7_MAXCODE];
+  float        null2f[p7_MAXCODE];
+  float        fsc, accscore, accscore_f;
+  int          x;
+
+  if (p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om)!= eslOK) esl_fatal(msg);
+  while (N--)
+    {
+      if (esl_sq_GrowTo(sq, L)                            != eslOK) esl_fatal(msg);
+      if (esl_rsq_xfIID(r, bg->f, abc->K, L, sq->dsq)     != eslOK) esl_fatal(msg);
+      sq->n = L;
+
+      if (p7_Forward (sq->dsq, L, om, ox1,      &fsc)     != eslOK) esl_fatal(msg);
+      if (p7_Backward(sq->dsq, L, om, ox1, ox2, NULL)     != eslOK) esl_fatal(msg);
+      if (p7_Decoding(om, ox1, ox2, ox2)                  != eslOK) esl_fatal(msg);
+      if (p7_Null2_ByExpectation(om, ox2, null2)          != eslOK) esl_fatal(msg);
+      if (p7_OptimalAccuracy(om, ox2, ox1, &accscore)     != eslOK) esl_fatal(msg);
+      if (p7_OATrace(om, ox2, ox1, tr)                    != eslOK) esl_fatal(msg);
+
+      if (p7_Forward (sq->dsq, L, om, ox1,      &fsc)     != eslOK) esl_fatal(msg);
+      if (p7_Backward(sq->dsq, L, om, ox1, ox2, NULL)     != eslOK) esl_fatal(msg);
+      if (p7_DecodingOptimalAccuracy(om, ox1, ox2, &accscore_f) != eslOK) esl_fatal(msg);
+      if (p7_OATrace(om, ox2, ox1, trf)                   != eslOK) esl_fatal(msg);
+      if (p7_Null2_ByExpectedCounts(om, ox2, null2f)      != eslOK) esl_fatal(msg);
+
+      if (p7_trace_Validate(trf, abc, sq->dsq, NULL)      != eslOK) esl_fatal(msg);
+      if (p7_trace_Compare(tr, trf, 0.0)                  != eslOK) esl_fatal(msg);
+      if (accscore != accscore_f)                                   esl_fatal(msg);
+      for (x = 0; x < abc->Kp; x++)
+	if (null2[x] != null2f[x])                                  esl_fatal(msg);
+
+      p7_trace_Reuse(tr);
+      p7_trace_Reuse(trf);
+    }
+
+  p7_trace_Destroy(trf);
+  p7_trace_Destroy(tr);
+  p7_omx_Destroy(ox2);
+  p7_omx_Destroy(ox1);  
+  esl_sq_Destroy(sq);
+  p7_oprofile_Destroy(om);
+  p7_profile_Destroy(gm);
+  p7_hmm_Destroy(hmm);
+}
 #endif /*p7OPTACC_TESTDRIVE*/
 /*------------------- end, unit tests ---------------------------*/
 
@@ -786,6 +1235,7 @@ main(int argc, char **argv)
 {
   ESL_GETOPTS    *go   = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
   ESL_RANDOMNESS *r    = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_RANDOMNESS *rc   = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s")); /* own RNG: don't perturb the seed-sensitive optacc tests */
   ESL_ALPHABET   *abc  = NULL;
   P7_BG          *bg   = NULL;
   int             M    = esl_opt_GetInteger(go, "-M");
@@ -799,6 +1249,10 @@ main(int argc, char **argv)
   utest_optacc(go, r, abc, bg, M, L, N);   /* normal sized models */
   utest_optacc(go, r, abc, bg, 1, L, 10);  /* size 1 models       */
   utest_optacc(go, r, abc, bg, M, 1, 10);  /* size 1 sequences    */
+  utest_checkpointed(rc, abc, bg, M, 10*L, 5);
+  utest_checkpointed(rc, abc, bg, M, 1,    5);
+  utest_fused       (rc, abc, bg, M, L,    5);
+  utest_fused       (rc, abc, bg, M, 1,    5);
 
   esl_alphabet_Destroy(abc);
   p7_bg_Destroy(bg);
@@ -810,11 +1264,14 @@ main(int argc, char **argv)
   utest_optacc(go, r, abc, bg, M, L, N);   
   utest_optacc(go, r, abc, bg, 1, L, 10);  
   utest_optacc(go, r, abc, bg, M, 1, 10);  
+  utest_checkpointed(rc, abc, bg, M, 10*L, 5);
+  utest_fused       (rc, abc, bg, M, L,    5);
 
   esl_alphabet_Destroy(abc);
   p7_bg_Destroy(bg);
 
   esl_getopts_Destroy(go);
+  esl_randomness_Destroy(rc);
   esl_randomness_Destroy(r);
   return eslOK;
 }
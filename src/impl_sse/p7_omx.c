@@ -72,10 +72,25 @@ p7_omx_Create(int allocM, int allocL, int allocXL)
   ox->dpf    = NULL;
   ox->xmx    = NULL;
   ox->x_mem  = NULL;
+  ox->isv_sc      = NULL;
+  ox->isv_dp      = NULL;
+  ox->isv_mem     = NULL;
+  ox->isv_allocM  = 0;
+  ox->isv_allocKp = 0;
+#ifdef eslENABLE_AVX
+  ox->avx_mem = NULL;
+  ox->dpb_avx = NULL;
+  ox->dpw_avx = NULL;
+#endif
+#ifdef eslENABLE_AVX512
+  ox->avx512_mem = NULL;
+  ox->dpf_avx512 = NULL;
+#endif
 
   /* DP matrix will be allocated for allocL+1 rows 0,1..L; allocQ4*p7X_NSCELLS columns */
   ox->allocR   = allocL+1;
   ox->validR   = ox->allocR;
+  ox->chkS     = 0;
   ox->allocQ4  = p7O_NQF(allocM);
   ox->allocQ8  = p7O_NQW(allocM);
   ox->allocQ16 = p7O_NQB(allocM);
@@ -96,6 +111,22 @@ p7_omx_Create(int allocM, int allocL, int allocXL)
     ox->dpb[i] = ox->dpb[0] + i * ox->allocQ16;
   }
 
+#ifdef eslENABLE_AVX
+  /* The AVX2 filters only need one row: MSV uchars and Viterbi words share it; words dominate. */
+  ox->allocQB_avx = p7O_NQB_AVX(allocM);
+  ox->allocQW_avx = p7O_NQW_AVX(allocM);
+  ESL_ALLOC(ox->avx_mem, sizeof(__m256i) * ox->allocQW_avx * p7X_NSCELLS + 31);
+  ox->dpb_avx = (__m256i *) ( ( (unsigned long int) ((char *) ox->avx_mem + 31) & (~0x1f)));
+  ox->dpw_avx = ox->dpb_avx;
+#endif
+
+#ifdef eslENABLE_AVX512
+  /* The AVX-512 Forward/Backward parsers only need one row of floats. */
+  ox->allocQF_avx512 = p7O_NQF_AVX512(allocM);
+  ESL_ALLOC(ox->avx512_mem, sizeof(__m512) * ox->allocQF_avx512 * p7X_NSCELLS + 63);
+  ox->dpf_avx512 = (__m512 *) ( ( (unsigned long int) ((char *) ox->avx512_mem + 63) & (~0x3f)));
+#endif
+
   ox->allocXR = allocXL+1;
   ESL_ALLOC(ox->x_mem,  sizeof(float) * ox->allocXR * p7X_NXCELLS + 15); 
   ox->xmx = (float *) ( ( (unsigned long int) ((char *) ox->x_mem  + 15) & (~0xf)));
@@ -147,7 +178,7 @@ p7_omx_GrowTo(P7_OMX *ox, int allocM, int allocL, int allocXL)
   int    status;
  
   /* If all possible dimensions are already satisfied, the matrix is fine */
-  if (ox->allocQ4*4 >= allocM && ox->validR > allocL && ox->allocXR >= allocXL+1) return eslOK;
+  if (ox->allocQ4*4 >= allocM && ox->validR > allocL && ox->allocXR >= allocXL+1 && ox->chkS == 0) return eslOK;
 
   /* If the main matrix is too small in cells, reallocate it; 
    * and we'll need to realign/reset the row pointers later.
@@ -183,8 +214,8 @@ p7_omx_GrowTo(P7_OMX *ox, int allocM, int allocL, int allocXL)
   if (allocM > ox->allocQ4*4)
     reset_row_pointers = TRUE;
 
-  /* must we set some more valid row pointers? */
-  if (allocL >= ox->validR)
+  /* must we set some more valid row pointers? or undo a checkpointed layout? */
+  if (allocL >= ox->validR || ox->chkS)
     reset_row_pointers = TRUE;
 
   /* now reset the row pointers, if needed */
@@ -205,7 +236,27 @@ p7_omx_GrowTo(P7_OMX *ox, int allocM, int allocL, int allocXL)
       ox->allocQ4  = nqf;
       ox->allocQ8  = nqw;
       ox->allocQ16 = nqb;
+      ox->chkS     = 0;
     }
+
+#ifdef eslENABLE_AVX
+  if (p7O_NQW_AVX(allocM) > ox->allocQW_avx)
+    {
+      ESL_RALLOC(ox->avx_mem, p, sizeof(__m256i) * p7O_NQW_AVX(allocM) * p7X_NSCELLS + 31);
+      ox->allocQB_avx = p7O_NQB_AVX(allocM);
+      ox->allocQW_avx = p7O_NQW_AVX(allocM);
+      ox->dpb_avx     = (__m256i *) ( ( (unsigned long int) ((char *) ox->avx_mem + 31) & (~0x1f)));
+      ox->dpw_avx     = ox->dpb_avx;
+    }
+#endif
+#ifdef eslENABLE_AVX512
+  if (p7O_NQF_AVX512(allocM) > ox->allocQF_avx512)
+    {
+      ESL_RALLOC(ox->avx512_mem, p, sizeof(__m512) * p7O_NQF_AVX512(allocM) * p7X_NSCELLS + 63);
+      ox->allocQF_avx512 = p7O_NQF_AVX512(allocM);
+      ox->dpf_avx512     = (__m512 *) ( ( (unsigned long int) ((char *) ox->avx512_mem + 63) & (~0x3f)));
+    }
+#endif
   
   ox->M = 0;
   ox->L = 0;
@@ -215,6 +266,105 @@ p7_omx_GrowTo(P7_OMX *ox, int allocM, int allocL, int allocXL)
   return status;
 }  
 
+/* Function:  p7_omx_GrowToCheckpointed()
+ * Synopsis:  Lay out a DP matrix in checkpointed sqrt(L) memory.
+ *
+ * Purpose:   Assures that <ox> can hold a checkpointed Forward,
+ *            Backward, posterior decoding or OA matrix for a model of
+ *            up to <allocM> nodes against a sequence of exactly <L>
+ *            residues, reallocating if needed, and sets its row
+ *            pointers <dpf[0..L]> up for that layout.
+ *
+ *            With a checkpoint interval $S = \lceil \sqrt{L} \rceil$,
+ *            rows 0,S,2S... and row L get their own memory, and the
+ *            other rows share $S-1$ rows, one segment at a time: a
+ *            total of about $2\sqrt{L}$ rows instead of $L+1$. The
+ *            ordinary <p7_Forward()> and <p7_Backward()> work
+ *            unchanged on such a matrix, leaving the checkpoint rows
+ *            valid; <p7_ForwardSegment()> and <p7_BackwardSegment()>
+ *            recalculate the rows of one segment from them when
+ *            they're needed.
+ *
+ *            The layout stays in effect until the next
+ *            <p7_omx_GrowTo()> or <p7_omx_GrowToCheckpointed()>
+ *            call. Because the row pointers depend on <L>, this must
+ *            be called again for each new target length.
+ *
+ * Returns:   <eslOK> on success; data in <ox> is invalidated.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_omx_GrowToCheckpointed(P7_OMX *ox, int allocM, int L)
+{
+  void  *p;
+  int    nqf = p7O_NQF(allocM);
+  int    S   = ESL_MAX(1, (int) ceil(sqrt((double) L)));
+  int    R   = L/S + S + 1;	/* kept rows 0..L/S, row L, S-1 shared rows */
+  size_t ncells = (size_t) R * nqf * 4;
+  int    i, r;
+  int    status;
+
+  if (ncells > ox->ncells)
+    {
+      ESL_RALLOC(ox->dp_mem, p, sizeof(__m128) * R * nqf * p7X_NSCELLS + 15);
+      ox->ncells = ncells;
+    }
+  if (L >= ox->allocXR)
+    {
+      ESL_RALLOC(ox->x_mem, p,  sizeof(float) * (L+1) * p7X_NXCELLS + 15); 
+      ox->allocXR = L+1;
+      ox->xmx     = (float *) ( ( (unsigned long int) ((char *) ox->x_mem  + 15) & (~0xf)));
+    }
+  if (L >= ox->allocR)
+    {
+      ESL_RALLOC(ox->dpb, p, sizeof(__m128i *) * (L+1));
+      ESL_RALLOC(ox->dpw, p, sizeof(__m128i *) * (L+1));
+      ESL_RALLOC(ox->dpf, p, sizeof(__m128  *) * (L+1));
+      ox->allocR = L+1;
+    }
+
+  /* Only the float rows are meaningful in this layout; the filters only use row 0. */
+  ox->dpb[0] = (__m128i *) ( ( (unsigned long int) ((char *) ox->dp_mem + 15) & (~0xf)));
+  ox->dpw[0] = (__m128i *) ( ( (unsigned long int) ((char *) ox->dp_mem + 15) & (~0xf)));
+  ox->dpf[0] = (__m128  *) ( ( (unsigned long int) ((char *) ox->dp_mem + 15) & (~0xf)));
+  for (i = 1; i <= L; i++)
+    {
+      if      (i % S == 0) r = i/S;
+      else if (i == L)     r = L/S + 1;
+      else                 r = L/S + 2 + (i-1) % S;
+      ox->dpf[i] = ox->dpf[0] + r * nqf * p7X_NSCELLS;
+    }
+
+  ox->allocQ4  = nqf;
+  ox->allocQ8  = p7O_NQW(allocM);
+  ox->allocQ16 = p7O_NQB(allocM);
+  ox->validR   = L+1;
+  ox->chkS     = S;
+  ox->M        = 0;
+  ox->L        = 0;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+/* Function:  p7_omx_FullMB()
+ * Synopsis:  Size of a full Forward/Backward matrix, in MB.
+ *
+ * Purpose:   Return the size, in megabytes, of the MDI rows of a full
+ *            (not checkpointed) DP matrix for a model of <M> nodes
+ *            against a sequence of <L> residues, as allocated by
+ *            <p7_omx_GrowTo(ox, M, L, L)>. Used to decide when it's
+ *            worth switching to a checkpointed matrix.
+ */
+double
+p7_omx_FullMB(int M, int L)
+{
+  return (double) sizeof(__m128) * p7X_NSCELLS * p7O_NQF(M) * (L+1) / 1000000.;
+}
+
+
 /* Function:  p7_omx_FDeconvert()
  * Synopsis:  Convert an optimized DP matrix to generic one.
  * Incept:    SRE, Tue Aug 19 17:58:13 2008 [Janelia]
@@ -299,6 +449,14 @@ p7_omx_Destroy(P7_OMX *ox)
   if (ox->dpf     != NULL) free(ox->dpf);
   if (ox->dpw     != NULL) free(ox->dpw);
   if (ox->dpb     != NULL) free(ox->dpb);
+  if (ox->isv_sc  != NULL) free(ox->isv_sc);
+  if (ox->isv_mem != NULL) free(ox->isv_mem);
+#ifdef eslENABLE_AVX
+  if (ox->avx_mem != NULL) free(ox->avx_mem);
+#endif
+#ifdef eslENABLE_AVX512
+  if (ox->avx512_mem != NULL) free(ox->avx512_mem);
+#endif
   free(ox);
   return;
 }
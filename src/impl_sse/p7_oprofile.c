@@ -32,6 +32,10 @@ static uint8_t unbiased_byteify(P7_OPROFILE *om, float sc);
 static uint8_t biased_byteify(P7_OPROFILE *om, float sc);
 static int16_t wordify(P7_OPROFILE *om, float sc);
 static int     sf_conversion(P7_OPROFILE *om);
+#if defined(eslENABLE_AVX) || defined(eslENABLE_AVX512)
+static void    restripe(const void *src, int Q1, int s1, int w1, void *dst, int Q2, int s2, int w2, size_t sz, int n, const void *pad);
+#endif
+static P7_OPROFILE *oprofile_create(int allocM, const ESL_ALPHABET *abc, int mapped);
 
 /*****************************************************************
  * 1. The P7_OPROFILE structure: a score profile.
@@ -47,6 +51,41 @@ static int     sf_conversion(P7_OPROFILE *om);
  */
 P7_OPROFILE *
 p7_oprofile_Create(int allocM, const ESL_ALPHABET *abc)
+{
+  return oprofile_create(allocM, abc, FALSE);
+}
+
+/* Function:  p7_oprofile_CreateMapped()
+ * Synopsis:  Allocate an optimized profile to point into a mapped file.
+ *
+ * Purpose:   Allocate an optimized profile of exactly <M> nodes for
+ *            digital alphabet <abc>, for <p7_oprofile_ReadMSV()> and
+ *            <p7_oprofile_ReadRest()> to point into the memory-mapped
+ *            <.h3f> and <.h3p> files of a pressed HMM database.
+ *
+ *            Only the structure itself, the row pointers of the match
+ *            emission scores, and any AVX/AVX-512 score copies are
+ *            allocated. The SSE scores and the <rf>, <mm>, <cs>,
+ *            <consensus> annotation are left <NULL>, to be set by the
+ *            readers, and they're not freed by <p7_oprofile_Destroy()>.
+ *            The length and mode configuration (<xf>, <xw>, <tjb_b>,
+ *            <L>, <nj>...) stays in the structure, so each profile
+ *            can still be reconfigured on its own.
+ *
+ * Throws:    <NULL> on allocation error.
+ */
+P7_OPROFILE *
+p7_oprofile_CreateMapped(int M, const ESL_ALPHABET *abc)
+{
+  return oprofile_create(M, abc, TRUE);
+}
+
+/* oprofile_create()
+ * The work of p7_oprofile_Create() and p7_oprofile_CreateMapped():
+ * if <mapped>, leave out the SSE score and annotation memory.
+ */
+static P7_OPROFILE *
+oprofile_create(int allocM, const ESL_ALPHABET *abc, int mapped)
 {
   int          status;
   P7_OPROFILE *om  = NULL;
@@ -54,6 +93,14 @@ p7_oprofile_Create(int allocM, const ESL_ALPHABET *abc)
   int          nqw = p7O_NQW(allocM); /* # of sword vectors needed for query */
   int          nqf = p7O_NQF(allocM); /* # of float vectors needed for query */
   int          nqs = nqb + p7O_EXTRA_SB;
+#ifdef eslENABLE_AVX
+  int          nqb_avx = p7O_NQB_AVX(allocM); /* # of 32x uchar vectors needed for query */
+  int          nqw_avx = p7O_NQW_AVX(allocM); /* # of 16x sword vectors needed for query */
+  int          nqs_avx = nqb_avx + p7O_EXTRA_SB;
+#endif
+#ifdef eslENABLE_AVX512
+  int          nqf_avx512 = p7O_NQF_AVX512(allocM); /* # of 16x float vectors needed for query */
+#endif
   int          x;
 
   /* level 0 */
@@ -70,40 +117,120 @@ p7_oprofile_Create(int allocM, const ESL_ALPHABET *abc)
   om->twv     = NULL;
   om->rfv     = NULL;
   om->tfv     = NULL;
+#ifdef eslENABLE_AVX
+  om->rbv_avx_mem = NULL;
+  om->sbv_avx_mem = NULL;
+  om->rwv_avx_mem = NULL;
+  om->twv_avx_mem = NULL;
+  om->rbv_avx     = NULL;
+  om->sbv_avx     = NULL;
+  om->rwv_avx     = NULL;
+  om->twv_avx     = NULL;
+#endif
+#ifdef eslENABLE_AVX512
+  om->rfv_avx512_mem = NULL;
+  om->tfv_avx512_mem = NULL;
+  om->rfv_avx512     = NULL;
+  om->tfv_avx512     = NULL;
+#endif
   om->clone   = 0;
+  om->mapped  = mapped;
+  om->layout  = p7_dispatch_GetLayout(); /* SSE, plus any wider layouts the selected kernels use */
+  om->rf        = NULL;
+  om->mm        = NULL;
+  om->cs        = NULL;
+  om->consensus = NULL;
+  om->name      = NULL;
+  om->acc       = NULL;
+  om->desc      = NULL;
 
   /* level 1 */
-  ESL_ALLOC(om->rbv_mem, sizeof(__m128i) * nqb  * abc->Kp          +15); /* +15 is for manual 16-byte alignment */
-  ESL_ALLOC(om->sbv_mem, sizeof(__m128i) * nqs  * abc->Kp          +15); 
-  ESL_ALLOC(om->rwv_mem, sizeof(__m128i) * nqw  * abc->Kp          +15);                     
-  ESL_ALLOC(om->twv_mem, sizeof(__m128i) * nqw  * p7O_NTRANS       +15);   
-  ESL_ALLOC(om->rfv_mem, sizeof(__m128)  * nqf  * abc->Kp          +15);                     
-  ESL_ALLOC(om->tfv_mem, sizeof(__m128)  * nqf  * p7O_NTRANS       +15);    
-
   ESL_ALLOC(om->rbv, sizeof(__m128i *) * abc->Kp); 
   ESL_ALLOC(om->sbv, sizeof(__m128i *) * abc->Kp); 
   ESL_ALLOC(om->rwv, sizeof(__m128i *) * abc->Kp); 
   ESL_ALLOC(om->rfv, sizeof(__m128  *) * abc->Kp); 
 
-  /* align vector memory on 16-byte boundaries */
-  om->rbv[0] = (__m128i *) (((unsigned long int) om->rbv_mem + 15) & (~0xf));
-  om->sbv[0] = (__m128i *) (((unsigned long int) om->sbv_mem + 15) & (~0xf));
-  om->rwv[0] = (__m128i *) (((unsigned long int) om->rwv_mem + 15) & (~0xf));
-  om->twv    = (__m128i *) (((unsigned long int) om->twv_mem + 15) & (~0xf));
-  om->rfv[0] = (__m128  *) (((unsigned long int) om->rfv_mem + 15) & (~0xf));
-  om->tfv    = (__m128  *) (((unsigned long int) om->tfv_mem + 15) & (~0xf));
-
-  /* set the rest of the row pointers for match emissions */
-  for (x = 1; x < abc->Kp; x++) {
-    om->rbv[x] = om->rbv[0] + (x * nqb);
-    om->sbv[x] = om->sbv[0] + (x * nqs);
-    om->rwv[x] = om->rwv[0] + (x * nqw);
-    om->rfv[x] = om->rfv[0] + (x * nqf);
-  }
+  if (mapped)
+    { /* the readers set the row pointers into the mapped file */
+      for (x = 0; x < abc->Kp; x++) {
+	om->rbv[x] = om->sbv[x] = om->rwv[x] = NULL;
+	om->rfv[x] = NULL;
+      }
+    }
+  else
+    {
+      ESL_ALLOC(om->rbv_mem, sizeof(__m128i) * nqb  * abc->Kp          +15); /* +15 is for manual 16-byte alignment */
+      ESL_ALLOC(om->sbv_mem, sizeof(__m128i) * nqs  * abc->Kp          +15); 
+      ESL_ALLOC(om->rwv_mem, sizeof(__m128i) * nqw  * abc->Kp          +15);                     
+      ESL_ALLOC(om->twv_mem, sizeof(__m128i) * nqw  * p7O_NTRANS       +15);   
+      ESL_ALLOC(om->rfv_mem, sizeof(__m128)  * nqf  * abc->Kp          +15);                     
+      ESL_ALLOC(om->tfv_mem, sizeof(__m128)  * nqf  * p7O_NTRANS       +15);    
+
+      /* align vector memory on 16-byte boundaries */
+      om->rbv[0] = (__m128i *) (((unsigned long int) om->rbv_mem + 15) & (~0xf));
+      om->sbv[0] = (__m128i *) (((unsigned long int) om->sbv_mem + 15) & (~0xf));
+      om->rwv[0] = (__m128i *) (((unsigned long int) om->rwv_mem + 15) & (~0xf));
+      om->twv    = (__m128i *) (((unsigned long int) om->twv_mem + 15) & (~0xf));
+      om->rfv[0] = (__m128  *) (((unsigned long int) om->rfv_mem + 15) & (~0xf));
+      om->tfv    = (__m128  *) (((unsigned long int) om->tfv_mem + 15) & (~0xf));
+
+      /* set the rest of the row pointers for match emissions */
+      for (x = 1; x < abc->Kp; x++) {
+	om->rbv[x] = om->rbv[0] + (x * nqb);
+	om->sbv[x] = om->sbv[0] + (x * nqs);
+	om->rwv[x] = om->rwv[0] + (x * nqw);
+	om->rfv[x] = om->rfv[0] + (x * nqf);
+      }
+    }
   om->allocQ16  = nqb;
   om->allocQ8   = nqw;
   om->allocQ4   = nqf;
 
+#ifdef eslENABLE_AVX
+  om->allocQB_avx = om->allocQW_avx = 0;
+  if (om->layout & p7_ISA_AVX)
+    {
+      ESL_ALLOC(om->rbv_avx_mem, sizeof(__m256i) * nqb_avx * abc->Kp    +31); /* +31 is for manual 32-byte alignment */
+      ESL_ALLOC(om->sbv_avx_mem, sizeof(__m256i) * nqs_avx * abc->Kp    +31);
+      ESL_ALLOC(om->rwv_avx_mem, sizeof(__m256i) * nqw_avx * abc->Kp    +31);
+      ESL_ALLOC(om->twv_avx_mem, sizeof(__m256i) * nqw_avx * p7O_NTRANS +31);
+
+      ESL_ALLOC(om->rbv_avx, sizeof(__m256i *) * abc->Kp);
+      ESL_ALLOC(om->sbv_avx, sizeof(__m256i *) * abc->Kp);
+      ESL_ALLOC(om->rwv_avx, sizeof(__m256i *) * abc->Kp);
+
+      om->rbv_avx[0] = (__m256i *) (((unsigned long int) om->rbv_avx_mem + 31) & (~0x1f));
+      om->sbv_avx[0] = (__m256i *) (((unsigned long int) om->sbv_avx_mem + 31) & (~0x1f));
+      om->rwv_avx[0] = (__m256i *) (((unsigned long int) om->rwv_avx_mem + 31) & (~0x1f));
+      om->twv_avx    = (__m256i *) (((unsigned long int) om->twv_avx_mem + 31) & (~0x1f));
+
+      for (x = 1; x < abc->Kp; x++) {
+	om->rbv_avx[x] = om->rbv_avx[0] + (x * nqb_avx);
+	om->sbv_avx[x] = om->sbv_avx[0] + (x * nqs_avx);
+	om->rwv_avx[x] = om->rwv_avx[0] + (x * nqw_avx);
+      }
+      om->allocQB_avx = nqb_avx;
+      om->allocQW_avx = nqw_avx;
+    }
+#endif
+
+#ifdef eslENABLE_AVX512
+  om->allocQF_avx512 = 0;
+  if (om->layout & p7_ISA_AVX512)
+    {
+      ESL_ALLOC(om->rfv_avx512_mem, sizeof(__m512) * nqf_avx512 * abc->Kp    +63); /* +63 is for manual 64-byte alignment */
+      ESL_ALLOC(om->tfv_avx512_mem, sizeof(__m512) * nqf_avx512 * p7O_NTRANS +63);
+      ESL_ALLOC(om->rfv_avx512, sizeof(__m512 *) * abc->Kp);
+
+      om->rfv_avx512[0] = (__m512 *) (((unsigned long int) om->rfv_avx512_mem + 63) & (~0x3f));
+      om->tfv_avx512    = (__m512 *) (((unsigned long int) om->tfv_avx512_mem + 63) & (~0x3f));
+
+      for (x = 1; x < abc->Kp; x++)
+	om->rfv_avx512[x] = om->rfv_avx512[0] + (x * nqf_avx512);
+      om->allocQF_avx512 = nqf_avx512;
+    }
+#endif
+
   /* Remaining initializations */
   om->tbm_b     = 0;
   om->tec_b     = 0;
@@ -122,23 +249,22 @@ p7_oprofile_Create(int allocM, const ESL_ALPHABET *abc)
   for (x = 0; x < p7_NCUTOFFS; x++) om->cutoff[x]  = p7_CUTOFF_UNSET;
   for (x = 0; x < p7_MAXABET;  x++) om->compo[x]   = p7_COMPO_UNSET;
 
-  om->name      = NULL;
-  om->acc       = NULL;
-  om->desc      = NULL;
-
   /* in a P7_OPROFILE, we always allocate for the optional RF, CS annotation.  
    * we only rely on the leading \0 to signal that it's unused, but 
    * we initialize all this memory to zeros to shut valgrind up about 
    * fwrite'ing uninitialized memory in the io functions.
    */
-  ESL_ALLOC(om->rf,          sizeof(char) * (allocM+2));
-  ESL_ALLOC(om->mm,          sizeof(char) * (allocM+2));
-  ESL_ALLOC(om->cs,          sizeof(char) * (allocM+2));
-  ESL_ALLOC(om->consensus,   sizeof(char) * (allocM+2));
-  memset(om->rf,       '\0', sizeof(char) * (allocM+2));
-  memset(om->mm,       '\0', sizeof(char) * (allocM+2));
-  memset(om->cs,       '\0', sizeof(char) * (allocM+2));
-  memset(om->consensus,'\0', sizeof(char) * (allocM+2));
+  if (! mapped)
+    {
+      ESL_ALLOC(om->rf,          sizeof(char) * (allocM+2));
+      ESL_ALLOC(om->mm,          sizeof(char) * (allocM+2));
+      ESL_ALLOC(om->cs,          sizeof(char) * (allocM+2));
+      ESL_ALLOC(om->consensus,   sizeof(char) * (allocM+2));
+      memset(om->rf,       '\0', sizeof(char) * (allocM+2));
+      memset(om->mm,       '\0', sizeof(char) * (allocM+2));
+      memset(om->cs,       '\0', sizeof(char) * (allocM+2));
+      memset(om->consensus,'\0', sizeof(char) * (allocM+2));
+    }
 
   om->abc        = abc;
   om->L          = 0;
@@ -188,13 +314,30 @@ p7_oprofile_Destroy(P7_OPROFILE *om)
       if (om->sbv       != NULL) free(om->sbv);
       if (om->rwv       != NULL) free(om->rwv);
       if (om->rfv       != NULL) free(om->rfv);
+#ifdef eslENABLE_AVX
+      if (om->rbv_avx_mem != NULL) free(om->rbv_avx_mem);
+      if (om->sbv_avx_mem != NULL) free(om->sbv_avx_mem);
+      if (om->rwv_avx_mem != NULL) free(om->rwv_avx_mem);
+      if (om->twv_avx_mem != NULL) free(om->twv_avx_mem);
+      if (om->rbv_avx     != NULL) free(om->rbv_avx);
+      if (om->sbv_avx     != NULL) free(om->sbv_avx);
+      if (om->rwv_avx     != NULL) free(om->rwv_avx);
+#endif
+#ifdef eslENABLE_AVX512
+      if (om->rfv_avx512_mem != NULL) free(om->rfv_avx512_mem);
+      if (om->tfv_avx512_mem != NULL) free(om->tfv_avx512_mem);
+      if (om->rfv_avx512     != NULL) free(om->rfv_avx512);
+#endif
       if (om->name      != NULL) free(om->name);
       if (om->acc       != NULL) free(om->acc);
       if (om->desc      != NULL) free(om->desc);
-      if (om->rf        != NULL) free(om->rf);
-      if (om->mm        != NULL) free(om->mm);
-      if (om->cs        != NULL) free(om->cs);
-      if (om->consensus != NULL) free(om->consensus);
+      if (! om->mapped)
+	{
+	  if (om->rf        != NULL) free(om->rf);
+	  if (om->mm        != NULL) free(om->mm);
+	  if (om->cs        != NULL) free(om->cs);
+	  if (om->consensus != NULL) free(om->consensus);
+	}
     }
 
   free(om);
@@ -223,22 +366,43 @@ p7_oprofile_Sizeof(P7_OPROFILE *om)
    * maintainability and clarity.
    */
   n  += sizeof(P7_OPROFILE);
-  n  += sizeof(__m128i) * nqb  * om->abc->Kp +15; /* om->rbv_mem   */
-  n  += sizeof(__m128i) * nqs  * om->abc->Kp +15; /* om->sbv_mem   */
-  n  += sizeof(__m128i) * nqw  * om->abc->Kp +15; /* om->rwv_mem   */
-  n  += sizeof(__m128i) * nqw  * p7O_NTRANS  +15; /* om->twv_mem   */
-  n  += sizeof(__m128)  * nqf  * om->abc->Kp +15; /* om->rfv_mem   */
-  n  += sizeof(__m128)  * nqf  * p7O_NTRANS  +15; /* om->tfv_mem   */
+  if (! om->mapped) {		/* a mapped profile's scores are in the mapped file */
+    n  += sizeof(__m128i) * nqb  * om->abc->Kp +15; /* om->rbv_mem   */
+    n  += sizeof(__m128i) * nqs  * om->abc->Kp +15; /* om->sbv_mem   */
+    n  += sizeof(__m128i) * nqw  * om->abc->Kp +15; /* om->rwv_mem   */
+    n  += sizeof(__m128i) * nqw  * p7O_NTRANS  +15; /* om->twv_mem   */
+    n  += sizeof(__m128)  * nqf  * om->abc->Kp +15; /* om->rfv_mem   */
+    n  += sizeof(__m128)  * nqf  * p7O_NTRANS  +15; /* om->tfv_mem   */
+  }
   
   n  += sizeof(__m128i *) * om->abc->Kp;          /* om->rbv       */
   n  += sizeof(__m128i *) * om->abc->Kp;          /* om->sbv       */
   n  += sizeof(__m128i *) * om->abc->Kp;          /* om->rwv       */
   n  += sizeof(__m128  *) * om->abc->Kp;          /* om->rfv       */
+
+#ifdef eslENABLE_AVX
+  if (om->layout & p7_ISA_AVX) {
+    n  += sizeof(__m256i) * om->allocQB_avx                  * om->abc->Kp +31; /* om->rbv_avx_mem */
+    n  += sizeof(__m256i) * (om->allocQB_avx + p7O_EXTRA_SB) * om->abc->Kp +31; /* om->sbv_avx_mem */
+    n  += sizeof(__m256i) * om->allocQW_avx                  * om->abc->Kp +31; /* om->rwv_avx_mem */
+    n  += sizeof(__m256i) * om->allocQW_avx                  * p7O_NTRANS  +31; /* om->twv_avx_mem */
+    n  += sizeof(__m256i *) * om->abc->Kp * 3;      /* om->{rbv,sbv,rwv}_avx */
+  }
+#endif
+#ifdef eslENABLE_AVX512
+  if (om->layout & p7_ISA_AVX512) {
+    n  += sizeof(__m512) * om->allocQF_avx512 * om->abc->Kp +63; /* om->rfv_avx512_mem */
+    n  += sizeof(__m512) * om->allocQF_avx512 * p7O_NTRANS  +63; /* om->tfv_avx512_mem */
+    n  += sizeof(__m512 *) * om->abc->Kp;           /* om->rfv_avx512 */
+  }
+#endif
   
-  n  += sizeof(char) * (om->allocM+2);            /* om->rf        */
-  n  += sizeof(char) * (om->allocM+2);            /* om->mm        */
-  n  += sizeof(char) * (om->allocM+2);            /* om->cs        */
-  n  += sizeof(char) * (om->allocM+2);            /* om->consensus */
+  if (! om->mapped) {
+    n  += sizeof(char) * (om->allocM+2);            /* om->rf        */
+    n  += sizeof(char) * (om->allocM+2);            /* om->mm        */
+    n  += sizeof(char) * (om->allocM+2);            /* om->cs        */
+    n  += sizeof(char) * (om->allocM+2);            /* om->consensus */
+  }
 
   return n;
 }
@@ -264,6 +428,14 @@ p7_oprofile_Copy(P7_OPROFILE *om1)
   int           nqw  = p7O_NQW(om1->allocM); /* # of sword vectors needed for query */
   int           nqf  = p7O_NQF(om1->allocM); /* # of float vectors needed for query */
   int           nqs  = nqb + p7O_EXTRA_SB;
+#ifdef eslENABLE_AVX
+  int           nqb_avx = om1->allocQB_avx;
+  int           nqw_avx = om1->allocQW_avx;
+  int           nqs_avx = nqb_avx + p7O_EXTRA_SB;
+#endif
+#ifdef eslENABLE_AVX512
+  int           nqf_avx512 = om1->allocQF_avx512;
+#endif
 
   size_t        size = sizeof(char) * (om1->allocM+2);
 
@@ -285,6 +457,23 @@ p7_oprofile_Copy(P7_OPROFILE *om1)
   om2->twv     = NULL;
   om2->rfv     = NULL;
   om2->tfv     = NULL;
+  om2->mapped  = FALSE;		/* a copy owns all its memory, even of a mapped <om1> */
+#ifdef eslENABLE_AVX
+  om2->rbv_avx_mem = NULL;
+  om2->sbv_avx_mem = NULL;
+  om2->rwv_avx_mem = NULL;
+  om2->twv_avx_mem = NULL;
+  om2->rbv_avx     = NULL;
+  om2->sbv_avx     = NULL;
+  om2->rwv_avx     = NULL;
+  om2->twv_avx     = NULL;
+#endif
+#ifdef eslENABLE_AVX512
+  om2->rfv_avx512_mem = NULL;
+  om2->tfv_avx512_mem = NULL;
+  om2->rfv_avx512     = NULL;
+  om2->tfv_avx512     = NULL;
+#endif
 
   /* level 1 */
   ESL_ALLOC(om2->rbv_mem, sizeof(__m128i) * nqb  * abc->Kp    +15);	/* +15 is for manual 16-byte alignment */
@@ -324,6 +513,60 @@ p7_oprofile_Copy(P7_OPROFILE *om1)
   om2->allocQ8   = nqw;
   om2->allocQ4   = nqf;
 
+#ifdef eslENABLE_AVX
+  om2->allocQB_avx = om2->allocQW_avx = 0;
+  if (om1->layout & p7_ISA_AVX)
+    {
+      ESL_ALLOC(om2->rbv_avx_mem, sizeof(__m256i) * nqb_avx * abc->Kp    +31);
+      ESL_ALLOC(om2->sbv_avx_mem, sizeof(__m256i) * nqs_avx * abc->Kp    +31);
+      ESL_ALLOC(om2->rwv_avx_mem, sizeof(__m256i) * nqw_avx * abc->Kp    +31);
+      ESL_ALLOC(om2->twv_avx_mem, sizeof(__m256i) * nqw_avx * p7O_NTRANS +31);
+
+      ESL_ALLOC(om2->rbv_avx, sizeof(__m256i *) * abc->Kp);
+      ESL_ALLOC(om2->sbv_avx, sizeof(__m256i *) * abc->Kp);
+      ESL_ALLOC(om2->rwv_avx, sizeof(__m256i *) * abc->Kp);
+
+      om2->rbv_avx[0] = (__m256i *) (((unsigned long int) om2->rbv_avx_mem + 31) & (~0x1f));
+      om2->sbv_avx[0] = (__m256i *) (((unsigned long int) om2->sbv_avx_mem + 31) & (~0x1f));
+      om2->rwv_avx[0] = (__m256i *) (((unsigned long int) om2->rwv_avx_mem + 31) & (~0x1f));
+      om2->twv_avx    = (__m256i *) (((unsigned long int) om2->twv_avx_mem + 31) & (~0x1f));
+
+      memcpy(om2->rbv_avx[0], om1->rbv_avx[0], sizeof(__m256i) * nqb_avx * abc->Kp);
+      memcpy(om2->sbv_avx[0], om1->sbv_avx[0], sizeof(__m256i) * nqs_avx * abc->Kp);
+      memcpy(om2->rwv_avx[0], om1->rwv_avx[0], sizeof(__m256i) * nqw_avx * abc->Kp);
+      memcpy(om2->twv_avx,    om1->twv_avx,    sizeof(__m256i) * nqw_avx * p7O_NTRANS);
+
+      for (x = 1; x < abc->Kp; x++) {
+	om2->rbv_avx[x] = om2->rbv_avx[0] + (x * nqb_avx);
+	om2->sbv_avx[x] = om2->sbv_avx[0] + (x * nqs_avx);
+	om2->rwv_avx[x] = om2->rwv_avx[0] + (x * nqw_avx);
+      }
+      om2->allocQB_avx = nqb_avx;
+      om2->allocQW_avx = nqw_avx;
+    }
+#endif
+
+#ifdef eslENABLE_AVX512
+  om2->allocQF_avx512 = 0;
+  if (om1->layout & p7_ISA_AVX512)
+    {
+      ESL_ALLOC(om2->rfv_avx512_mem, sizeof(__m512) * nqf_avx512 * abc->Kp    +63);
+      ESL_ALLOC(om2->tfv_avx512_mem, sizeof(__m512) * nqf_avx512 * p7O_NTRANS +63);
+      ESL_ALLOC(om2->rfv_avx512, sizeof(__m512 *) * abc->Kp);
+
+      om2->rfv_avx512[0] = (__m512 *) (((unsigned long int) om2->rfv_avx512_mem + 63) & (~0x3f));
+      om2->tfv_avx512    = (__m512 *) (((unsigned long int) om2->tfv_avx512_mem + 63) & (~0x3f));
+
+      memcpy(om2->rfv_avx512[0], om1->rfv_avx512[0], sizeof(__m512) * nqf_avx512 * abc->Kp);
+      memcpy(om2->tfv_avx512,    om1->tfv_avx512,    sizeof(__m512) * nqf_avx512 * p7O_NTRANS);
+
+      for (x = 1; x < abc->Kp; x++)
+	om2->rfv_avx512[x] = om2->rfv_avx512[0] + (x * nqf_avx512);
+      om2->allocQF_avx512 = nqf_avx512;
+    }
+#endif
+  om2->layout = om1->layout;
+
   /* Remaining initializations */
   om2->tbm_b     = om1->tbm_b;
   om2->tec_b     = om1->tec_b;
@@ -481,6 +724,9 @@ p7_oprofile_UpdateFwdEmissionScores(P7_OPROFILE *om, P7_BG *bg, float *fwd_emiss
     }
   }
 
+#ifdef eslENABLE_AVX512
+  p7_oprofile_RestripeFB_avx512(om);
+#endif
   return eslOK;
 }
 
@@ -550,6 +796,9 @@ p7_oprofile_UpdateVitEmissionScores(P7_OPROFILE *om, P7_BG *bg, float *fwd_emiss
     }
   }
 
+#ifdef eslENABLE_AVX
+  p7_oprofile_RestripeVF_avx(om);
+#endif
   return eslOK;
 }
 
@@ -642,6 +891,9 @@ p7_oprofile_UpdateMSVEmissionScores(P7_OPROFILE *om, P7_BG *bg, float *fwd_emiss
   }
 
   sf_conversion(om);
+#ifdef eslENABLE_AVX
+  p7_oprofile_RestripeMSV_avx(om);
+#endif
 
   return eslOK;
 }
@@ -808,6 +1060,9 @@ mf_conversion(const P7_PROFILE *gm, P7_OPROFILE *om)
   om->tjb_b = unbiased_byteify(om, logf(3.0f / (float) (gm->L+3))); /* this adopts the L setting of the parent profile */
 
   sf_conversion(om);
+#ifdef eslENABLE_AVX
+  p7_oprofile_RestripeMSV_avx(om);
+#endif
 
   return eslOK;
 }
@@ -917,6 +1172,9 @@ vf_conversion(const P7_PROFILE *gm, P7_OPROFILE *om)
       om->ddbound_w = ESL_MAX(om->ddbound_w, ddtmp);
     }
 
+#ifdef eslENABLE_AVX
+  p7_oprofile_RestripeVF_avx(om);
+#endif
   return eslOK;
 }
 
@@ -990,6 +1248,9 @@ fb_conversion(const P7_PROFILE *gm, P7_OPROFILE *om)
   om->xf[p7O_J][p7O_LOOP] = expf(gm->xsc[p7P_J][p7P_LOOP]);
   om->xf[p7O_J][p7O_MOVE] = expf(gm->xsc[p7P_J][p7P_MOVE]);
 
+#ifdef eslENABLE_AVX512
+  p7_oprofile_RestripeFB_avx512(om);
+#endif
   return eslOK;
 }
 
@@ -1193,6 +1454,149 @@ p7_oprofile_ReconfigUnihit(P7_OPROFILE *om, int L)
 
   return p7_oprofile_ReconfigLength(om, L);
 }
+
+#if defined(eslENABLE_AVX) || defined(eslENABLE_AVX512)
+/* restripe()
+ * Copy one striped array of <n> elements of <sz> bytes each from
+ * a layout of <Q1> vectors of <w1> lanes into a layout of <Q2> vectors
+ * of <w2> lanes. Element <idx> lives in vector <idx%Q> at lane
+ * <idx/Q>; vectors are <s> apart, so interleaved arrays like the
+ * transition scores can be done one transition at a time. Lanes past
+ * <n> are set to <pad>.
+ *
+ * This is how the AVX2 filter scores and the AVX-512 parser scores
+ * are made: they are exactly the SSE scores, moved around.
+ */
+static void
+restripe(const void *src, int Q1, int s1, int w1, void *dst, int Q2, int s2, int w2, size_t sz, int n, const void *pad)
+{
+  const char *sp = (const char *) src;
+  char       *dp = (char *) dst;
+  int         q, z, idx;
+
+  for (q = 0; q < Q2; q++)
+    for (z = 0; z < w2; z++)
+      {
+	idx = q + z*Q2;
+	if (idx < n) memcpy(dp + (q*s2*w2 + z) * sz, sp + ((idx%Q1)*s1*w1 + idx/Q1) * sz, sz);
+	else         memcpy(dp + (q*s2*w2 + z) * sz, pad,                                  sz);
+      }
+}
+#endif /*eslENABLE_AVX || eslENABLE_AVX512*/
+
+#ifdef eslENABLE_AVX
+/* Function:  p7_oprofile_RestripeMSV_avx()
+ * Synopsis:  Set the AVX2 MSV/SSV filter scores from the SSE ones.
+ *
+ * Purpose:   Fill <om->rbv_avx> and <om->sbv_avx> from the completed
+ *            SSE MSV scores in <om->rbv>, restriping them for 32-way
+ *            uchar vectors. Called by the conversion routines, and
+ *            by anything that reads or changes <om->rbv> directly.
+ *            Does nothing if <om> doesn't carry the AVX2 layout.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <om> hasn't been allocated properly.
+ */
+int
+p7_oprofile_RestripeMSV_avx(P7_OPROFILE *om)
+{
+  int     Q    = p7O_NQB(om->M);
+  int     Qa   = p7O_NQB_AVX(om->M);
+  uint8_t pad  = 255;
+  uint8_t hi   = om->bias_b + 127;
+  uint8_t *rb, *sb;
+  int     x, q;
+
+  if (! (om->layout & p7_ISA_AVX)) return eslOK; /* AVX2 kernels not in use */
+  if (Qa > om->allocQB_avx) ESL_EXCEPTION(eslEINVAL, "optimized profile is too small to hold AVX conversion");
+
+  for (x = 0; x < om->abc->Kp; x++)
+    {
+      restripe(om->rbv[x], Q, 1, 16, om->rbv_avx[x], Qa, 1, 32, sizeof(uint8_t), om->M, &pad);
+
+      /* sbv is ((127 + bias) - rbv) ^ 127, as in sf_conversion() */
+      rb = (uint8_t *) om->rbv_avx[x];
+      sb = (uint8_t *) om->sbv_avx[x];
+      for (q = 0; q < Qa*32; q++) sb[q] = ((hi > rb[q]) ? hi - rb[q] : 0) ^ 127;
+      for (q = Qa; q < Qa + p7O_EXTRA_SB; q++) om->sbv_avx[x][q] = om->sbv_avx[x][q % Qa];
+    }
+  return eslOK;
+}
+
+/* Function:  p7_oprofile_RestripeVF_avx()
+ * Synopsis:  Set the AVX2 Viterbi filter scores from the SSE ones.
+ *
+ * Purpose:   Fill <om->rwv_avx> and <om->twv_avx> from the completed
+ *            SSE ViterbiFilter() scores in <om->rwv>, <om->twv>,
+ *            restriping them for 16-way sword vectors.
+ *
+ *            The seven interleaved transitions are stored for
+ *            element <q + z*Q> of the model in both layouts (the
+ *            -1 rotation of BM, MM, IM, DM is the same), so each is
+ *            simply restriped; unused lanes are -32768 (-infinity).
+ *            Does nothing if <om> doesn't carry the AVX2 layout.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <om> hasn't been allocated properly.
+ */
+int
+p7_oprofile_RestripeVF_avx(P7_OPROFILE *om)
+{
+  int     Q    = p7O_NQW(om->M);
+  int     Qa   = p7O_NQW_AVX(om->M);
+  int16_t pad  = -32768;
+  int     x, t;
+
+  if (! (om->layout & p7_ISA_AVX)) return eslOK;
+  if (Qa > om->allocQW_avx) ESL_EXCEPTION(eslEINVAL, "optimized profile is too small to hold AVX conversion");
+
+  for (x = 0; x < om->abc->Kp; x++)
+    restripe(om->rwv[x], Q, 1, 8, om->rwv_avx[x], Qa, 1, 16, sizeof(int16_t), om->M, &pad);
+
+  for (t = p7O_BM; t <= p7O_II; t++)
+    restripe(om->twv + t, Q, 7, 8, om->twv_avx + t, Qa, 7, 16, sizeof(int16_t), om->M, &pad);
+  restripe(om->twv + 7*Q, Q, 1, 8, om->twv_avx + 7*Qa, Qa, 1, 16, sizeof(int16_t), om->M, &pad);
+  return eslOK;
+}
+#endif /*eslENABLE_AVX*/
+
+#ifdef eslENABLE_AVX512
+/* Function:  p7_oprofile_RestripeFB_avx512()
+ * Synopsis:  Set the AVX-512 Forward/Backward scores from the SSE ones.
+ *
+ * Purpose:   Fill <om->rfv_avx512> and <om->tfv_avx512> from the
+ *            completed SSE Forward/Backward scores in <om->rfv>,
+ *            <om->tfv>, restriping them for 16-way float vectors.
+ *            Unused lanes are 0.0 (probability of an impossible
+ *            transition or emission). Does nothing if <om> doesn't
+ *            carry the AVX-512 layout.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <om> hasn't been allocated properly.
+ */
+int
+p7_oprofile_RestripeFB_avx512(P7_OPROFILE *om)
+{
+  int     Q    = p7O_NQF(om->M);
+  int     Qa   = p7O_NQF_AVX512(om->M);
+  float   pad  = 0.0f;
+  int     x, t;
+
+  if (! (om->layout & p7_ISA_AVX512)) return eslOK; /* AVX-512 kernels not in use */
+  if (Qa > om->allocQF_avx512) ESL_EXCEPTION(eslEINVAL, "optimized profile is too small to hold AVX-512 conversion");
+
+  for (x = 0; x < om->abc->Kp; x++)
+    restripe(om->rfv[x], Q, 1, 4, om->rfv_avx512[x], Qa, 1, 16, sizeof(float), om->M, &pad);
+
+  for (t = p7O_BM; t <= p7O_II; t++)
+    restripe(om->tfv + t, Q, 7, 4, om->tfv_avx512 + t, Qa, 7, 16, sizeof(float), om->M, &pad);
+  restripe(om->tfv + 7*Q, Q, 1, 4, om->tfv_avx512 + 7*Qa, Qa, 1, 16, sizeof(float), om->M, &pad);
+  return eslOK;
+}
+#endif /*eslENABLE_AVX512*/
 /*------------ end, conversions to P7_OPROFILE ------------------*/
 
 /*******************************************************************
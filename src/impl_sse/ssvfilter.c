@@ -3,6 +3,8 @@
  * Contents:
  *   1. Introduction
  *   2. p7_SSVFilter() implementation
+ *
+ * An AVX2 version of the same algorithm is in ssvfilter_avx.c.
  * 
  * Bjarne Knudsen, CLC Bio
  */
@@ -872,11 +874,31 @@ get_xE(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om)
 }
 
 
+/* Function:  p7_SSVFilter_Finish()
+ * Synopsis:  Convert the best SSV diagonal to an MSV score.
+ *
+ * Purpose:   Given the maximum <xE> over all diagonals of an SSV
+ *            calculation (in the shifted baseline described at the
+ *            start of this file) for profile <om>, configured for
+ *            the length of the target sequence, decide whether the
+ *            SSV result stands as the MSV score, and if so put that
+ *            score (in nats) in <ret_sc>.
+ *
+ *            This is the common ending of the SSE and AVX2 SSV
+ *            filters and of the inter-sequence version
+ *            (ssvfilter_interseq.c).
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslERANGE> if the MSV score certainly overflows;
+ *            <ret_sc> is set to <eslINFINITY>.
+ *            <eslENORESULT> if the MSV filter must be run to get the
+ *            score, either because the J state could have been used,
+ *            or because the shifted baseline makes the result
+ *            uncertain.
+ */
 int
-p7_SSVFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, float *ret_sc)
+p7_SSVFilter_Finish(const P7_OPROFILE *om, uint16_t xE, float *ret_sc)
 {
-  /* Use 16 bit values to avoid overflow due to moved baseline */
-  uint16_t  xE;
   uint16_t  xJ;
 
   if (om->tjb_b + om->tbm_b + om->tec_b + om->bias_b >= 127) {
@@ -885,8 +907,6 @@ p7_SSVFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, float *ret_sc)
     return eslENORESULT;
   }
 
-  xE = get_xE(dsq, L, om);
-
   if (xE >= 255 - om->bias_b)
     {
       /* We have an overflow. */
@@ -924,3 +944,14 @@ p7_SSVFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, float *ret_sc)
 }
 
 
+int
+p7_SSVFilter_sse(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, float *ret_sc)
+{
+  if (om->tjb_b + om->tbm_b + om->tec_b + om->bias_b >= 127) {
+    /* the optimizations are not guaranteed to work under these
+       conditions (see comments at start of file) */
+    return eslENORESULT;
+  }
+
+  return p7_SSVFilter_Finish(om, get_xE(dsq, L, om), ret_sc);
+}
@@ -0,0 +1,553 @@
+/* Inter-sequence SSV filter: scoring many short targets at once.
+ *
+ * p7_SSVFilter() stripes the model across vector lanes, and scores one
+ * target at a time. For short targets (metagenomic ORFs, peptides of
+ * 50-150 residues) the per-target overhead of setting up and draining
+ * the striped calculation is a large part of the cost. Here each
+ * vector lane holds a different target instead, and the model is
+ * walked once per row, node by node, for 16 (SSE) or 32 (AVX2)
+ * targets at a time.
+ *
+ * The recursion is the same one the SSV filter uses (see the
+ * introduction to ssvfilter.c): for each diagonal, in signed
+ * saturated bytes,
+ *     sv(i,k) = sv(i-1,k-1) - cost(x_i, k),   sv(i-1,0) = -128
+ * and xE is the unsigned maximum of all sv(i,k). Only the residues
+ * x_i differ between the lanes. The costs of node k for each lane's
+ * residue are gathered by loading each lane's residue row of an
+ * unstriped cost table (<ox->isv_sc>, made from <om->sbv>) and
+ * transposing blocks of 16x16 (32x32) bytes.
+ *
+ * A lane whose target has ended reads a "no residue" row in which
+ * every cost is 127. That drives any diagonal that hasn't already
+ * overflowed to the -128 floor, which is where xE starts anyway.
+ * A diagonal that has gone past 0 must first have gone through
+ * 255 - om->bias_b or more (unsigned), so its target is already
+ * overflowed, whatever the dead cells add. So each lane's xE is the
+ * same as get_xE() in ssvfilter.c gives for its target alone, and
+ * p7_MSVFilterInterseq() returns exactly the same scores as
+ * p7_MSVFilter().
+ *
+ * The cells of ended lanes are wasted work, so targets should be
+ * passed in order of length, which fills each vector with targets of
+ * about the same length. The pipeline does that for blocks of short
+ * targets (p7_pli_MSVBlock()).
+ *
+ * The AVX2 kernel is in ssvfilter_interseq_avx.c.
+ *
+ * Contents:
+ *   1. p7_MSVFilterInterseq() API
+ *   2. SSE kernel
+ *   3. Benchmark driver
+ *   4. Unit tests
+ *   5. Test driver
+ */
+#include "p7_config.h"
+
+#include <stdio.h>
+#include <math.h>
+
+#include <xmmintrin.h>		/* SSE  */
+#include <emmintrin.h>		/* SSE2 */
+
+#include "easel.h"
+#include "esl_sse.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+#define ISV_MAXLANES 32		/* widest kernel: 32 targets, AVX2 */
+
+
+/*****************************************************************
+ * 1. p7_MSVFilterInterseq() API
+ *****************************************************************/
+
+/* isv_grow()
+ * Make sure <ox> has inter-sequence SSV workspace for a model of
+ * length <M> in an alphabet of <Kp> residue codes: a DP column of
+ * <M> 32-byte vectors, and <Kp>+1 cost rows padded to a multiple
+ * of 32 nodes.
+ */
+static int
+isv_grow(P7_OMX *ox, int M, int Kp)
+{
+  int    Mpad;
+  int    x;
+  int    status;
+
+  if (M <= ox->isv_allocM && Kp <= ox->isv_allocKp) return eslOK;
+  M    = ESL_MAX(M,  ox->isv_allocM);
+  Kp   = ESL_MAX(Kp, ox->isv_allocKp);
+  Mpad = ((M + ISV_MAXLANES - 1) / ISV_MAXLANES) * ISV_MAXLANES;
+
+  if (ox->isv_mem != NULL) free(ox->isv_mem);
+  ox->isv_allocM = ox->isv_allocKp = 0;
+  ESL_ALLOC  (ox->isv_mem, sizeof(uint8_t) * (ISV_MAXLANES * M + Mpad * (Kp+1)) + 31);
+  ESL_REALLOC(ox->isv_sc,  sizeof(int8_t *) * (Kp+1));
+
+  ox->isv_dp = (uint8_t *) (((unsigned long int) ox->isv_mem + 31) & (~0x1f));
+  for (x = 0; x <= Kp; x++)
+    ox->isv_sc[x] = (int8_t *) (ox->isv_dp + ISV_MAXLANES * M + x * Mpad);
+
+  ox->isv_allocM  = M;
+  ox->isv_allocKp = Kp;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+/* isv_fill()
+ * Unstripe the SSV costs <om->sbv> into <ox->isv_sc>: row x is the
+ * cost of residue x at nodes 1..M, in order, padded with 127s; the
+ * no-residue row [Kp] is all 127.
+ */
+static void
+isv_fill(const P7_OPROFILE *om, P7_OMX *ox)
+{
+  int     M    = om->M;
+  int     Kp   = om->abc->Kp;
+  int     Q    = p7O_NQB(M);
+  int     Mpad = ((M + ISV_MAXLANES - 1) / ISV_MAXLANES) * ISV_MAXLANES;
+  int8_t *sc;
+  int     x, k;
+
+  for (x = 0; x < Kp; x++)
+    {
+      sc = (int8_t *) om->sbv[x];
+      for (k = 0; k < M;    k++) ox->isv_sc[x][k] = sc[(k % Q) * 16 + k / Q]; /* node k+1 is in vector k%Q, lane k/Q */
+      for (     ; k < Mpad; k++) ox->isv_sc[x][k] = 127;
+    }
+  for (k = 0; k < Mpad; k++) ox->isv_sc[Kp][k] = 127;
+}
+
+
+/* Function:  p7_MSVFilterInterseq()
+ * Synopsis:  MSV scores for many short targets, several per vector.
+ *
+ * Purpose:   Calculate the MSV score of each of <nseq> digital target
+ *            sequences <dsq[0..nseq-1]>, of lengths <L[0..nseq-1]>,
+ *            against optimized profile <om>, using <ox> for
+ *            workspace. Put the scores (in nats) in
+ *            <sc[0..nseq-1]>. Each score is exactly the score
+ *            <p7_MSVFilter()> gives when <om> is configured for that
+ *            target's length; overflowing targets get <eslINFINITY>.
+ *
+ *            Targets are scored 16 or 32 at a time with
+ *            <p7_SSVInterseq()>. The few that the SSV calculation
+ *            can't decide (see ssvfilter.c) are rescored one at a
+ *            time with <p7_MSVFilter()>. For efficiency, targets
+ *            should be short, and sorted by length.
+ *
+ *            The MSV part of <om> is reconfigured for each target's
+ *            length in turn, so on return it is configured for
+ *            <L[nseq-1]>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_MSVFilterInterseq(const ESL_DSQ **dsq, const int *L, int nseq, P7_OPROFILE *om, P7_OMX *ox, float *sc)
+{
+  uint8_t xE[ISV_MAXLANES];
+  int     s, n, t;
+  int     status;
+
+  if ((status = isv_grow(ox, om->M, om->abc->Kp)) != eslOK) return status;
+  isv_fill(om, ox);
+
+  for (s = 0; s < nseq; s += ISV_MAXLANES)
+    {
+      n = ESL_MIN(ISV_MAXLANES, nseq - s);
+      if ((status = p7_SSVInterseq(dsq+s, L+s, n, om, ox, xE)) != eslOK) return status;
+
+      for (t = 0; t < n; t++)
+	{
+	  p7_oprofile_ReconfigMSVLength(om, L[s+t]);
+	  if (p7_SSVFilter_Finish(om, xE[t], &(sc[s+t])) == eslENORESULT)
+	    {
+	      if ((status = p7_omx_GrowTo(ox, om->M, 0, L[s+t])) != eslOK) return status;
+	      p7_MSVFilter(dsq[s+t], L[s+t], om, ox, &(sc[s+t]));
+	    }
+	}
+    }
+  return eslOK;
+}
+/*------------- end, p7_MSVFilterInterseq() API -----------------*/
+
+
+
+/*****************************************************************
+ * 2. SSE kernel
+ *****************************************************************/
+
+/* transpose_16x16()
+ * Transpose 16 vectors of 16 bytes in place: on return, byte j of
+ * v[m] is what byte m of v[j] was. Four rounds of interleaving rows
+ * j and j+8 do it.
+ */
+static inline void
+transpose_16x16(__m128i *v)
+{
+  __m128i t[16];
+  int     pass, j;
+
+  for (pass = 0; pass < 4; pass++)
+    {
+      for (j = 0; j < 8; j++)
+	{
+	  t[2*j]   = _mm_unpacklo_epi8(v[j], v[j+8]);
+	  t[2*j+1] = _mm_unpackhi_epi8(v[j], v[j+8]);
+	}
+      for (j = 0; j < 16; j++) v[j] = t[j];
+    }
+}
+
+
+/* Function:  p7_SSVInterseq_sse()
+ * Synopsis:  Inter-sequence SSV, 16 targets per SSE vector.
+ *
+ * Purpose:   For each of <nseq> targets <dsq[]> of lengths <L[]>,
+ *            calculate the maximum SSV diagonal score against <om>,
+ *            in the shifted baseline of ssvfilter.c (the <xE> that
+ *            <p7_SSVFilter_Finish()> takes), and put it in
+ *            <xE[0..nseq-1]>.
+ *
+ *            <ox->isv_sc> must hold the unstriped costs for <om>;
+ *            <p7_MSVFilterInterseq()> takes care of that.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if the workspace in <ox> is too small.
+ */
+int
+p7_SSVInterseq_sse(const ESL_DSQ **dsq, const int *L, int nseq, const P7_OPROFILE *om, P7_OMX *ox, uint8_t *xE)
+{
+  __m128i      *dp     = (__m128i *) ox->isv_dp; /* dp[k-1]: node k of each lane's diagonals, previous row */
+  __m128i       beginv = _mm_set1_epi8(-128);     /* begin score, which is also the floor              */
+  __m128i       xEv;		                  /* max over all cells, per lane                       */
+  __m128i       mpv;		                  /* dp(i-1,k-1)                                        */
+  __m128i       sv;		                  /* dp(i,k)                                            */
+  __m128i       e[16];		                  /* costs at 16 nodes, after transposition             */
+  const int8_t *row[16];	                  /* cost row for each lane's residue x_i               */
+  union { __m128i v; uint8_t b[16]; } u;
+  int           M  = om->M;
+  int           Kp = om->abc->Kp;
+  int           Lmax;
+  int           s, n, i, j, k, k0, w;
+
+  if (M > ox->isv_allocM || Kp > ox->isv_allocKp) ESL_EXCEPTION(eslEINVAL, "inter-sequence SSV workspace too small");
+
+  for (s = 0; s < nseq; s += 16)
+    {
+      n = ESL_MIN(16, nseq - s);
+      for (Lmax = 0, j = 0; j < n; j++) Lmax = ESL_MAX(Lmax, L[s+j]);
+
+      for (k = 0; k < M; k++) dp[k] = beginv;
+      xEv = beginv;
+
+      for (i = 1; i <= Lmax; i++)
+	{
+	  for (j = 0; j < 16; j++)
+	    row[j] = ox->isv_sc[(j < n && i <= L[s+j]) ? dsq[s+j][i] : Kp];
+
+	  mpv = beginv;
+	  for (k0 = 0; k0 < M; k0 += 16)
+	    {
+	      for (j = 0; j < 16; j++) e[j] = _mm_loadu_si128((__m128i *) (row[j] + k0));
+	      transpose_16x16(e);
+
+	      w = ESL_MIN(16, M - k0);
+	      for (k = 0; k < w; k++)
+		{
+		  sv         = _mm_subs_epi8(mpv, e[k]);
+		  xEv        = _mm_max_epu8(xEv, sv);
+		  mpv        = dp[k0+k];
+		  dp[k0+k]   = sv;
+		}
+	    }
+	}
+
+      u.v = xEv;
+      for (j = 0; j < n; j++) xE[s+j] = u.b[j];
+    }
+  return eslOK;
+}
+/*------------------- end, SSE kernel ---------------------------*/
+
+
+
+/*****************************************************************
+ * 3. Benchmark driver
+ *****************************************************************/
+#ifdef p7SSVFILTER_INTERSEQ_BENCHMARK
+/*
+   gcc -o ssvfilter_interseq_benchmark -std=gnu99 -g -O3 -msse2 -I.. -L.. -I../../easel -L../../easel -Dp7SSVFILTER_INTERSEQ_BENCHMARK ssvfilter_interseq.c -lhmmer -leasel -lm
+
+   ./ssvfilter_interseq_benchmark <hmmfile>       inter-sequence MSV scores for N short targets
+   ./ssvfilter_interseq_benchmark -b <hmmfile>    ... and time p7_MSVFilter() on them one at a time
+ */
+#include "p7_config.h"
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+#include "esl_randomseq.h"
+#include "esl_stopwatch.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",             0 },
+  { "-b",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "also time p7_MSVFilter(), one target at a time",   0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                    0 },
+  { "-L",        eslARG_INT,    "100", NULL, "n>0", NULL,  NULL, NULL, "length of random target seqs",                     0 },
+  { "-N",        eslARG_INT,  "50000", NULL, "n>0", NULL,  NULL, NULL, "number of random target seqs",                     0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options] <hmmfile>";
+static char banner[] = "benchmark driver for inter-sequence MSVFilter()";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go      = p7_CreateDefaultApp(options, 1, argc, argv, banner, usage);
+  char           *hmmfile = esl_opt_GetArg(go, 1);
+  ESL_STOPWATCH  *w       = esl_stopwatch_Create();
+  ESL_RANDOMNESS *r       = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *abc     = NULL;
+  P7_HMMFILE     *hfp     = NULL;
+  P7_HMM         *hmm     = NULL;
+  P7_BG          *bg      = NULL;
+  P7_PROFILE     *gm      = NULL;
+  P7_OPROFILE    *om      = NULL;
+  P7_OMX         *ox      = NULL;
+  int             L       = esl_opt_GetInteger(go, "-L");
+  int             N       = esl_opt_GetInteger(go, "-N");
+  ESL_DSQ       **dsq     = malloc(sizeof(ESL_DSQ *) * N);
+  int            *len     = malloc(sizeof(int)       * N);
+  float          *sc      = malloc(sizeof(float)     * N);
+  int             i;
+  double          Mcs;
+
+  if (p7_hmmfile_OpenE(hmmfile, NULL, &hfp, NULL) != eslOK) p7_Fail("Failed to open HMM file %s", hmmfile);
+  if (p7_hmmfile_Read(hfp, &abc, &hmm)            != eslOK) p7_Fail("Failed to read HMM");
+
+  bg = p7_bg_Create(abc);
+  p7_bg_SetLength(bg, L);
+  gm = p7_profile_Create(hmm->M, abc);
+  p7_ProfileConfig(hmm, bg, gm, L, p7_LOCAL);
+  om = p7_oprofile_Create(gm->M, abc);
+  p7_oprofile_Convert(gm, om);
+  p7_oprofile_ReconfigLength(om, L);
+
+  ox = p7_omx_Create(gm->M, 0, 0);
+
+  for (i = 0; i < N; i++)
+    {
+      len[i] = L;
+      dsq[i] = malloc(sizeof(ESL_DSQ) * (L+2));
+      esl_rsq_xfIID(r, bg->f, abc->K, L, dsq[i]);
+    }
+
+  esl_stopwatch_Start(w);
+  p7_MSVFilterInterseq((const ESL_DSQ **) dsq, len, N, om, ox, sc);
+  esl_stopwatch_Stop(w);
+  Mcs = (double) N * (double) L * (double) gm->M * 1e-6 / w->user;
+  esl_stopwatch_Display(stdout, w, "# CPU time (inter-sequence): ");
+  printf("# %.1f Mc/s (%s)\n", Mcs, p7_dispatch_DecodeISA(p7_dispatch_GetISA()));
+
+  if (esl_opt_GetBoolean(go, "-b"))
+    {
+      esl_stopwatch_Start(w);
+      for (i = 0; i < N; i++)
+	p7_MSVFilter(dsq[i], L, om, ox, &(sc[i]));
+      esl_stopwatch_Stop(w);
+      Mcs = (double) N * (double) L * (double) gm->M * 1e-6 / w->user;
+      esl_stopwatch_Display(stdout, w, "# CPU time (one at a time):  ");
+      printf("# %.1f Mc/s\n", Mcs);
+    }
+  printf("# M    = %d\n", gm->M);
+
+  for (i = 0; i < N; i++) free(dsq[i]);
+  free(dsq);
+  free(len);
+  free(sc);
+  p7_omx_Destroy(ox);
+  p7_oprofile_Destroy(om);
+  p7_profile_Destroy(gm);
+  p7_bg_Destroy(bg);
+  p7_hmm_Destroy(hmm);
+  p7_hmmfile_Close(hfp);
+  esl_alphabet_Destroy(abc);
+  esl_stopwatch_Destroy(w);
+  esl_randomness_Destroy(r);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /*p7SSVFILTER_INTERSEQ_BENCHMARK*/
+/*------------------ end, benchmark driver ----------------------*/
+
+
+
+/*****************************************************************
+ * 4. Unit tests
+ *****************************************************************/
+#ifdef p7SSVFILTER_INTERSEQ_TESTDRIVE
+#include "esl_random.h"
+#include "esl_randomseq.h"
+#include "esl_sq.h"
+
+/* utest_compare()
+ *
+ * p7_MSVFilterInterseq() must give exactly the scores that
+ * p7_MSVFilter() gives one target at a time. Compare them for a
+ * random model of length <M>, on <N> iid targets of random lengths
+ * 1..<L>, in no particular order, and <N> targets emitted from the
+ * model itself, which exercise the overflow and J state paths.
+ */
+static void
+utest_compare(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  char         msg[] = "ssvfilter_interseq compare unit test failed";
+  P7_HMM      *hmm   = NULL;
+  P7_PROFILE  *gm    = NULL;
+  P7_OPROFILE *om    = NULL;
+  ESL_SQ     **sq    = malloc(sizeof(ESL_SQ *)  * 2 * N);
+  ESL_DSQ    **dsq   = malloc(sizeof(ESL_DSQ *) * 2 * N);
+  int         *len   = malloc(sizeof(int)       * 2 * N);
+  float       *sc    = malloc(sizeof(float)     * 2 * N);
+  P7_OMX      *ox    = p7_omx_Create(M, 0, 0);
+  float        sc1;
+  int          n;
+
+  if (p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om) != eslOK) esl_fatal(msg);
+
+  for (n = 0; n < 2*N; n++)
+    {
+      sq[n] = esl_sq_CreateDigital(abc);
+      if (n < N)
+	{
+	  sq[n]->n = 1 + esl_rnd_Roll(r, L);
+	  if (esl_sq_GrowTo(sq[n], sq[n]->n) != eslOK) esl_fatal(msg);
+	  esl_rsq_xfIID(r, bg->f, abc->K, sq[n]->n, sq[n]->dsq);
+	}
+      else
+	{
+	  do {
+	    esl_sq_Reuse(sq[n]);
+	    if (p7_ProfileEmit(r, hmm, gm, bg, sq[n], NULL) != eslOK) esl_fatal(msg);
+	  } while (sq[n]->n == 0);
+	}
+      dsq[n] = sq[n]->dsq;
+      len[n] = sq[n]->n;
+    }
+
+  if (p7_MSVFilterInterseq((const ESL_DSQ **) dsq, len, 2*N, om, ox, sc) != eslOK) esl_fatal(msg);
+
+  for (n = 0; n < 2*N; n++)
+    {
+      p7_oprofile_ReconfigLength(om, len[n]);
+      p7_MSVFilter(dsq[n], len[n], om, ox, &sc1);
+      if (sc1 != sc[n]) esl_fatal("%s: target %d (L=%d): score %f != %f", msg, n, len[n], sc[n], sc1);
+    }
+
+  for (n = 0; n < 2*N; n++) esl_sq_Destroy(sq[n]);
+  free(sq);
+  free(dsq);
+  free(len);
+  free(sc);
+  p7_hmm_Destroy(hmm);
+  p7_omx_Destroy(ox);
+  p7_profile_Destroy(gm);
+  p7_oprofile_Destroy(om);
+}
+#endif /*p7SSVFILTER_INTERSEQ_TESTDRIVE*/
+/*-------------------- end, unit tests --------------------------*/
+
+
+
+/*****************************************************************
+ * 5. Test driver
+ *****************************************************************/
+#ifdef p7SSVFILTER_INTERSEQ_TESTDRIVE
+/*
+   gcc -g -Wall -msse2 -std=gnu99 -I.. -L.. -I../../easel -L../../easel -o ssvfilter_interseq_utest -Dp7SSVFILTER_INTERSEQ_TESTDRIVE ssvfilter_interseq.c -lhmmer -leasel -lm
+   ./ssvfilter_interseq_utest
+ */
+#include "p7_config.h"
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",           0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                  0 },
+  { "-v",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "be verbose",                                     0 },
+  { "-L",        eslARG_INT,    "150", NULL, NULL,  NULL,  NULL, NULL, "maximum size of random sequences to sample",     0 },
+  { "-M",        eslARG_INT,    "145", NULL, NULL,  NULL,  NULL, NULL, "size of random models to sample",                0 },
+  { "-N",        eslARG_INT,    "100", NULL, NULL,  NULL,  NULL, NULL, "number of random sequences to sample",           0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for inter-sequence MSVFilter()";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go     = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *r      = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *abc    = NULL;
+  P7_BG          *bg     = NULL;
+  int             M      = esl_opt_GetInteger(go, "-M");
+  int             L      = esl_opt_GetInteger(go, "-L");
+  int             N      = esl_opt_GetInteger(go, "-N");
+  int             isa[]  = { p7_ISA_SSE, p7_ISA_AVX };
+  int             a;
+
+  /* Each kernel this processor can run, selected before profiles are made */
+  for (a = 0; a < 2; a++)
+    {
+      if (p7_dispatch_Select(isa[a]) != eslOK) continue;
+
+      if ((abc = esl_alphabet_Create(eslDNA)) == NULL)  esl_fatal("failed to create alphabet");
+      if ((bg = p7_bg_Create(abc))            == NULL)  esl_fatal("failed to create null model");
+
+      if (esl_opt_GetBoolean(go, "-v")) printf("MSVFilterInterseq() tests, %s, DNA\n", p7_dispatch_DecodeISA(isa[a]));
+      utest_compare(r, abc, bg, M,   L, N);   /* normal sized models            */
+      utest_compare(r, abc, bg, 1,   L, 10);  /* size 1 models                  */
+      utest_compare(r, abc, bg, M,   1, 10);  /* size 1 sequences               */
+      utest_compare(r, abc, bg, 600, L, 40);  /* several node blocks, >1 group  */
+
+      esl_alphabet_Destroy(abc);
+      p7_bg_Destroy(bg);
+
+      if ((abc = esl_alphabet_Create(eslAMINO)) == NULL)  esl_fatal("failed to create alphabet");
+      if ((bg = p7_bg_Create(abc))              == NULL)  esl_fatal("failed to create null model");
+
+      if (esl_opt_GetBoolean(go, "-v")) printf("MSVFilterInterseq() tests, %s, protein\n", p7_dispatch_DecodeISA(isa[a]));
+      utest_compare(r, abc, bg, M,   L, N);
+      utest_compare(r, abc, bg, 1,   L, 10);
+      utest_compare(r, abc, bg, M,   1, 10);
+      utest_compare(r, abc, bg, 600, L, 40);
+
+      esl_alphabet_Destroy(abc);
+      p7_bg_Destroy(bg);
+    }
+
+  esl_getopts_Destroy(go);
+  esl_randomness_Destroy(r);
+  return eslOK;
+}
+#endif /*p7SSVFILTER_INTERSEQ_TESTDRIVE*/
+/*---------------------- end, test driver -----------------------*/
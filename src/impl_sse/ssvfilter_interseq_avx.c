@@ -0,0 +1,133 @@
+/* Inter-sequence SSV filter; AVX2 version.
+ *
+ * A 32-way translation of the kernel in ssvfilter_interseq.c, which
+ * has the description of the method: 32 targets, one per byte lane,
+ * walked through the model a node at a time. The costs for 32 nodes
+ * are gathered by transposing a 32x32 byte block. The unpack
+ * instructions work within each 128-bit half, so the same four
+ * rounds as the SSE 16x16 transpose are done on rows 0..15 and on
+ * rows 16..31, which leaves node k of the first sixteen targets in
+ * the low half of one vector and node 16+k in its high half;
+ * _mm256_permute2x128_si256() then pairs the halves up.
+ *
+ * Compiled unless HMMER is configured with --disable-avx, or the compiler
+ * can't generate AVX2; called only through dispatch.c, when
+ * the processor supports it.
+ *
+ * Contents:
+ *   1. p7_SSVInterseq_avx() implementation
+ */
+#include "p7_config.h"
+#ifdef eslENABLE_AVX
+
+#include <immintrin.h>		/* AVX2 */
+
+#include "easel.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+
+/*****************************************************************
+ * 1. p7_SSVInterseq_avx() implementation
+ *****************************************************************/
+
+/* transpose_32x32()
+ * Transpose 32 vectors of 32 bytes: on return, byte j of e[k] is
+ * byte k of v[j]. <v> is used as scratch.
+ */
+static inline void
+transpose_32x32(__m256i *v, __m256i *e)
+{
+  __m256i t[16];
+  int     h, pass, j;
+
+  for (h = 0; h < 32; h += 16)
+    for (pass = 0; pass < 4; pass++)
+      {
+	for (j = 0; j < 8; j++)
+	  {
+	    t[2*j]   = _mm256_unpacklo_epi8(v[h+j], v[h+j+8]);
+	    t[2*j+1] = _mm256_unpackhi_epi8(v[h+j], v[h+j+8]);
+	  }
+	for (j = 0; j < 16; j++) v[h+j] = t[j];
+      }
+
+  for (j = 0; j < 16; j++)
+    {
+      e[j]    = _mm256_permute2x128_si256(v[j], v[16+j], 0x20);
+      e[16+j] = _mm256_permute2x128_si256(v[j], v[16+j], 0x31);
+    }
+}
+
+
+/* Function:  p7_SSVInterseq_avx()
+ * Synopsis:  Inter-sequence SSV, 32 targets per AVX2 vector.
+ *
+ * Purpose:   AVX2 version of <p7_SSVInterseq_sse()>: put the maximum
+ *            SSV diagonal score of each of the <nseq> targets
+ *            <dsq[]>, of lengths <L[]>, against <om> in <xE[]>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if the workspace in <ox> is too small.
+ */
+int
+p7_SSVInterseq_avx(const ESL_DSQ **dsq, const int *L, int nseq, const P7_OPROFILE *om, P7_OMX *ox, uint8_t *xE)
+{
+  __m256i      *dp     = (__m256i *) ox->isv_dp;
+  __m256i       beginv = _mm256_set1_epi8(-128);
+  __m256i       xEv;
+  __m256i       mpv;
+  __m256i       sv;
+  __m256i       v[32];
+  __m256i       e[32];
+  const int8_t *row[32];
+  union { __m256i v; uint8_t b[32]; } u;
+  int           M  = om->M;
+  int           Kp = om->abc->Kp;
+  int           Lmax;
+  int           s, n, i, j, k, k0, w;
+
+  if (M > ox->isv_allocM || Kp > ox->isv_allocKp) ESL_EXCEPTION(eslEINVAL, "inter-sequence SSV workspace too small");
+
+  for (s = 0; s < nseq; s += 32)
+    {
+      n = ESL_MIN(32, nseq - s);
+      for (Lmax = 0, j = 0; j < n; j++) Lmax = ESL_MAX(Lmax, L[s+j]);
+
+      for (k = 0; k < M; k++) dp[k] = beginv;
+      xEv = beginv;
+
+      for (i = 1; i <= Lmax; i++)
+	{
+	  for (j = 0; j < 32; j++)
+	    row[j] = ox->isv_sc[(j < n && i <= L[s+j]) ? dsq[s+j][i] : Kp];
+
+	  mpv = beginv;
+	  for (k0 = 0; k0 < M; k0 += 32)
+	    {
+	      for (j = 0; j < 32; j++) v[j] = _mm256_loadu_si256((__m256i *) (row[j] + k0));
+	      transpose_32x32(v, e);
+
+	      w = ESL_MIN(32, M - k0);
+	      for (k = 0; k < w; k++)
+		{
+		  sv         = _mm256_subs_epi8(mpv, e[k]);
+		  xEv        = _mm256_max_epu8(xEv, sv);
+		  mpv        = dp[k0+k];
+		  dp[k0+k]   = sv;
+		}
+	    }
+	}
+
+      u.v = xEv;
+      for (j = 0; j < n; j++) xE[s+j] = u.b[j];
+    }
+  return eslOK;
+}
+
+#else /*! eslENABLE_AVX*/
+/* Standard compiler-pleasing mantra for an #ifdef'd-out, empty code file. */
+void p7_ssvfilter_interseq_avx_silence_hack(void) { return; }
+#endif /*eslENABLE_AVX*/
@@ -14,6 +14,7 @@
 #include "p7_config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 
 #include <xmmintrin.h>		/* SSE  */
@@ -35,6 +36,8 @@ static inline int select_c(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_
 static inline int select_j(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i);
 static inline int select_e(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i, int *ret_k);
 static inline int select_b(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i);
+static inline void cumulate_e(const P7_OMX *ox, int i, double *ecum);
+static inline int  select_e_cumulated(ESL_RANDOMNESS *rng, const P7_OMX *ox, const double *ecum, int *ret_k);
 
 
 /*****************************************************************
@@ -108,6 +111,228 @@ p7_StochasticTrace(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPRO
   tr->L = L;
   return p7_trace_Reverse(tr);
 }
+
+/* Function:  p7_StochasticTraceCheckpointed()
+ * Synopsis:  Sample a batch of tracebacks from a checkpointed Forward matrix.
+ *
+ * Purpose:   Same as <p7_StochasticTrace()>, for a Forward matrix
+ *            <ox> in checkpointed layout (see
+ *            <p7_omx_GrowToCheckpointed()>), and sampling <ntr>
+ *            traces <tr[0..ntr-1]> at once. 
+ *
+ *            The traces are walked back together, one segment of
+ *            the matrix at a time: the segment's rows are
+ *            recalculated with <p7_ForwardSegment()>, then each
+ *            trace is extended for as long as it stays in that
+ *            segment. That costs one extra Forward pass per call,
+ *            however many traces are drawn, so callers should draw
+ *            as many as they can afford to hold at once.
+ *
+ *            Random numbers are drawn in a different order than by
+ *            <ntr> calls to <p7_StochasticTrace()>, so the samples
+ *            differ, but they are the same given the same state of
+ *            <rng>.
+ *
+ * Args:      rng - source of random numbers
+ *            dsq - digital sequence being aligned, 1..L
+ *            L   - length of dsq
+ *            om  - profile
+ *            ox  - checkpointed Forward matrix to trace, LxM
+ *            tr  - storage for the recovered tracebacks, <[0..ntr-1]>
+ *            ntr - number of traces to sample
+ *
+ * Returns:   <eslOK> on success
+ *
+ * Throws:    <eslEMEM> on allocation error.
+ *            <eslEINVAL> on several types of problems, including:
+ *            a trace isn't empty (wasn't Reuse()'d).
+ */
+int
+p7_StochasticTraceCheckpointed(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox,
+			       P7_TRACE **tr, int ntr)
+{
+  int  *ti = NULL;		/* ti[t]: position in sequence of trace t, 1..L */
+  int  *tk = NULL;		/* tk[t]: position in model of trace t, 1..M    */
+  int   S  = ox->chkS;
+  int   a, b;
+  int   t;
+  int   s0, s1;			/* choice of a state */
+  int   status;			
+  
+  for (t = 0; t < ntr; t++)
+    if (tr[t]->N != 0) ESL_EXCEPTION(eslEINVAL, "trace not empty; needs to be Reuse()'d?");
+  if (S == 0) ESL_EXCEPTION(eslEINVAL, "Forward matrix isn't checkpointed");
+
+  ESL_ALLOC(ti, sizeof(int) * ntr);
+  ESL_ALLOC(tk, sizeof(int) * ntr);
+  for (t = 0; t < ntr; t++)
+    {
+      ti[t] = L;
+      tk[t] = 0;
+      if ((status = p7_trace_Append(tr[t], p7T_T, tk[t], ti[t])) != eslOK) goto ERROR;
+      if ((status = p7_trace_Append(tr[t], p7T_C, tk[t], ti[t])) != eslOK) goto ERROR;
+    }
+
+  /* Segments a+1..b, last to first. Every step reads rows i-1..i at most,
+   * and row a is a checkpoint, so a trace can stay in a segment while i > a.
+   */
+  for (b = L; b > 0; b = a)
+    {
+      a = ((b-1) / S) * S;
+      p7_ForwardSegment(dsq, om, ox, a, b);
+
+      for (t = 0; t < ntr; t++)
+	{
+	  s0 = tr[t]->st[tr[t]->N-1];
+	  while (s0 != p7T_S && (ti[t] > a || a == 0))
+	    {
+	      switch (s0) {
+	      case p7T_M: s1 = select_m(rng, om, ox, ti[t], tk[t]);  tk[t]--; ti[t]--; break;
+	      case p7T_D: s1 = select_d(rng, om, ox, ti[t], tk[t]);  tk[t]--;          break;
+	      case p7T_I: s1 = select_i(rng, om, ox, ti[t], tk[t]);           ti[t]--; break;
+	      case p7T_N: s1 = select_n(ti[t]);                                        break;
+	      case p7T_C: s1 = select_c(rng, om, ox, ti[t]);                           break;
+	      case p7T_J: s1 = select_j(rng, om, ox, ti[t]);                           break;
+	      case p7T_E: s1 = select_e(rng, om, ox, ti[t], &(tk[t]));                 break;
+	      case p7T_B: s1 = select_b(rng, om, ox, ti[t]);                           break;
+	      default: ESL_XEXCEPTION(eslEINVAL, "bogus state in traceback");
+	      }
+	      if (s1 == -1) ESL_XEXCEPTION(eslEINVAL, "Stochastic traceback choice failed");
+
+	      if ((status = p7_trace_Append(tr[t], s1, tk[t], ti[t])) != eslOK) goto ERROR;
+
+	      if ( (s1 == p7T_N || s1 == p7T_J || s1 == p7T_C) && s1 == s0) ti[t]--;
+	      s0 = s1;
+	    }
+	}
+    }
+
+  for (t = 0; t < ntr; t++)
+    {
+      tr[t]->M = om->M;
+      tr[t]->L = L;
+      if ((status = p7_trace_Reverse(tr[t])) != eslOK) goto ERROR;
+    }
+  free(ti);
+  free(tk);
+  return eslOK;
+
+ ERROR:
+  if (ti) free(ti);
+  if (tk) free(tk);
+  return status;
+}
+
+/* Function:  p7_StochasticTraceBatch()
+ * Synopsis:  Sample a batch of tracebacks from a Forward matrix.
+ *
+ * Purpose:   Same as <p7_StochasticTrace()>, sampling <ntr> traces
+ *            <tr[0..ntr-1]> in one pass over the Forward matrix <ox>.
+ *
+ *            The traces are walked back together, a row at a time:
+ *            each trace is extended for as long as it stays in row
+ *            <i> before any trace moves on to row <i-1>. The rows
+ *            of the matrix are therefore read once per batch, not
+ *            once per trace, which keeps them in cache for large
+ *            <L> by <M> matrices. The choice of an M or D state
+ *            for an E state, which otherwise costs a scan of the
+ *            whole row, is made by a binary search of the row's
+ *            cumulative probabilities; those are calculated once
+ *            per row, however many traces end a domain there.
+ *
+ *            Random numbers are drawn in a different order than by
+ *            <ntr> calls to <p7_StochasticTrace()>, so the samples
+ *            differ, but they are the same given the same state of
+ *            <rng>.
+ *
+ * Args:      rng - source of random numbers
+ *            dsq - digital sequence being aligned, 1..L
+ *            L   - length of dsq
+ *            om  - profile
+ *            ox  - Forward matrix to trace, LxM
+ *            tr  - storage for the recovered tracebacks, <[0..ntr-1]>
+ *            ntr - number of traces to sample
+ *
+ * Returns:   <eslOK> on success
+ *
+ * Throws:    <eslEMEM> on allocation error.
+ *            <eslEINVAL> on several types of problems, including:
+ *            a trace isn't empty (wasn't Reuse()'d).
+ */
+int
+p7_StochasticTraceBatch(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *ox,
+			P7_TRACE **tr, int ntr)
+{
+  int    *ti   = NULL;		/* ti[t]: position in sequence of trace t, 1..L */
+  int    *tk   = NULL;		/* tk[t]: position in model of trace t, 1..M    */
+  double *ecum = NULL;		/* cumulative E(i) path probabilities, [0..8Q-1] */
+  int     erow;			/* row that <ecum> holds, or -1                   */
+  int     i;
+  int     t;
+  int     s0, s1;		/* choice of a state */
+  int     status;
+
+  for (t = 0; t < ntr; t++)
+    if (tr[t]->N != 0) ESL_EXCEPTION(eslEINVAL, "trace not empty; needs to be Reuse()'d?");
+
+  ESL_ALLOC(ti,   sizeof(int)    * ntr);
+  ESL_ALLOC(tk,   sizeof(int)    * ntr);
+  ESL_ALLOC(ecum, sizeof(double) * p7O_NQF(ox->M) * 8);
+  erow = -1;
+  for (t = 0; t < ntr; t++)
+    {
+      ti[t] = L;
+      tk[t] = 0;
+      if ((status = p7_trace_Append(tr[t], p7T_T, tk[t], ti[t])) != eslOK) goto ERROR;
+      if ((status = p7_trace_Append(tr[t], p7T_C, tk[t], ti[t])) != eslOK) goto ERROR;
+    }
+
+  /* Rows L..1; in row 1, the traces are followed on to the S state */
+  for (i = L; i > 0; i--)
+    for (t = 0; t < ntr; t++)
+      {
+	s0 = tr[t]->st[tr[t]->N-1];
+	while (s0 != p7T_S && (ti[t] == i || i == 1))
+	  {
+	    switch (s0) {
+	    case p7T_M: s1 = select_m(rng, om, ox, ti[t], tk[t]);  tk[t]--; ti[t]--; break;
+	    case p7T_D: s1 = select_d(rng, om, ox, ti[t], tk[t]);  tk[t]--;          break;
+	    case p7T_I: s1 = select_i(rng, om, ox, ti[t], tk[t]);           ti[t]--; break;
+	    case p7T_N: s1 = select_n(ti[t]);                                        break;
+	    case p7T_C: s1 = select_c(rng, om, ox, ti[t]);                           break;
+	    case p7T_J: s1 = select_j(rng, om, ox, ti[t]);                           break;
+	    case p7T_E: 
+	      if (erow != ti[t]) { cumulate_e(ox, ti[t], ecum); erow = ti[t]; }
+	      s1 = select_e_cumulated(rng, ox, ecum, &(tk[t]));                      break;
+	    case p7T_B: s1 = select_b(rng, om, ox, ti[t]);                           break;
+	    default: ESL_XEXCEPTION(eslEINVAL, "bogus state in traceback");
+	    }
+	    if (s1 == -1) ESL_XEXCEPTION(eslEINVAL, "Stochastic traceback choice failed");
+
+	    if ((status = p7_trace_Append(tr[t], s1, tk[t], ti[t])) != eslOK) goto ERROR;
+
+	    if ( (s1 == p7T_N || s1 == p7T_J || s1 == p7T_C) && s1 == s0) ti[t]--;
+	    s0 = s1;
+	  }
+      }
+
+  for (t = 0; t < ntr; t++)
+    {
+      tr[t]->M = om->M;
+      tr[t]->L = L;
+      if ((status = p7_trace_Reverse(tr[t])) != eslOK) goto ERROR;
+    }
+  free(ti);
+  free(tk);
+  free(ecum);
+  return eslOK;
+
+ ERROR:
+  if (ti)   free(ti);
+  if (tk)   free(tk);
+  if (ecum) free(ecum);
+  return status;
+}
 /*------------------ end, stochastic traceback ------------------*/
 
 
@@ -278,6 +503,51 @@ select_e(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i, in
   ESL_EXCEPTION(-1, "unreached code was reached. universe collapses.");
 } 
 
+/* For a batch of traces, the E(i) choice above is split in two:
+ * cumulate_e() sums the same terms in the same order, once per row,
+ * into <ecum[0..8Q-1]> (four M then four D cells per q), and
+ * select_e_cumulated() finds the first one that exceeds the roll by
+ * binary search.
+ */
+static inline void
+cumulate_e(const P7_OMX *ox, int i, double *ecum)
+{
+  int    Q     = p7O_NQF(ox->M);
+  double sum   = 0.0;
+  __m128 xEv   = _mm_set1_ps(1.0 / ox->xmx[i*p7X_NXCELLS+p7X_E]);
+  union { __m128 v; float p[4]; } u;
+  int    q,r;
+
+  for (q = 0; q < Q; q++)
+    {
+      u.v = _mm_mul_ps(ox->dpf[i][q*3 + p7X_M], xEv);
+      for (r = 0; r < 4; r++) { sum += u.p[r]; *ecum++ = sum; }
+      u.v = _mm_mul_ps(ox->dpf[i][q*3 + p7X_D], xEv);
+      for (r = 0; r < 4; r++) { sum += u.p[r]; *ecum++ = sum; }
+    }
+}
+
+static inline int
+select_e_cumulated(ESL_RANDOMNESS *rng, const P7_OMX *ox, const double *ecum, int *ret_k)
+{
+  int    Q    = p7O_NQF(ox->M);
+  int    n    = 8*Q;
+  double roll = esl_random(rng);
+  int    lo, hi, mid;
+
+  if (ecum[n-1] <= 0.) return -1;
+  while (roll >= ecum[n-1]) roll -= ecum[n-1]; /* as select_e() wraps around */
+
+  lo = 0; hi = n-1;		/* smallest x with roll < ecum[x] */
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (roll < ecum[mid]) hi = mid;
+    else                  lo = mid+1;
+  }
+  *ret_k = (lo % 8 % 4) * Q + lo / 8 + 1;
+  return (lo % 8 < 4 ? p7T_M : p7T_D);
+}
+
 /* B(i) is reached from N(i) or J(i). */
 static inline int
 select_b(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i)
@@ -450,6 +720,51 @@ utest_stotrace(ESL_GETOPTS *go, ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, P7_PROFI
   p7_omx_Destroy(ox);
   p7_gmx_Destroy(gx);
 }
+
+/* utest_batch()
+ * The same tests for p7_StochasticTraceBatch(), drawing <ntrace>
+ * traces in one batch.
+ */
+static void
+utest_batch(ESL_GETOPTS *go, ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, P7_PROFILE *gm, P7_OPROFILE *om, ESL_DSQ *dsq, int L, int ntrace)
+{
+  P7_GMX    *gx  = NULL;
+  P7_OMX    *ox  = NULL;
+  P7_TRACE  *vtr = NULL;
+  P7_TRACE **trb = NULL;
+  char       errbuf[eslERRBUFSIZE];
+  int        idx;
+  float      maxsc = -eslINFINITY;
+  float      vsc, sc;
+
+  if ((gx     = p7_gmx_Create(gm->M, L))        == NULL)  esl_fatal("generic DP matrix creation failed");
+  if ((ox     = p7_omx_Create(gm->M, L, L))     == NULL)  esl_fatal("optimized DP matrix create failed");
+  if ((vtr    = p7_trace_Create())              == NULL)  esl_fatal("trace creation failed");
+  if ((trb    = malloc(sizeof(P7_TRACE *) * ntrace)) == NULL) esl_fatal("malloc failed");
+  for (idx = 0; idx < ntrace; idx++)
+    if ((trb[idx] = p7_trace_Create())          == NULL)  esl_fatal("trace creation failed");
+
+  if (p7_GViterbi(dsq, L, gm, gx, &vsc)         != eslOK) esl_fatal("viterbi failed");
+  if (p7_GTrace  (dsq, L, gm, gx, vtr)          != eslOK) esl_fatal("viterbi trace failed");
+  if (p7_Forward (dsq, L, om, ox, NULL)         != eslOK) esl_fatal("forward failed");
+
+  if (p7_StochasticTraceBatch(rng, dsq, L, om, ox, trb, ntrace) != eslOK) esl_fatal("stochastic trace batch failed");
+  for (idx = 0; idx < ntrace; idx++)
+    {
+      if (p7_trace_Validate(trb[idx], abc, dsq, errbuf)         != eslOK) esl_fatal("trace invalid:\n%s", errbuf);
+      if (p7_trace_Score(trb[idx], dsq, gm, &sc)                != eslOK) esl_fatal("trace scoring failed"); 
+
+      maxsc = ESL_MAX(sc, maxsc);
+      if (sc > vsc + 0.001) esl_fatal("sampled trace has score > optimal Viterbi path; not possible (%f > %f)", sc, vsc);
+    }
+  if (esl_FCompare(maxsc, vsc, 0.1) != eslOK) esl_fatal("stochastic trace batch failed to sample the Viterbi path");
+  
+  for (idx = 0; idx < ntrace; idx++) p7_trace_Destroy(trb[idx]);
+  free(trb);
+  p7_trace_Destroy(vtr);
+  p7_omx_Destroy(ox);
+  p7_gmx_Destroy(gx);
+}
 #endif /*p7STOTRACE_TESTDRIVE*/
 /*----------------- end, unit tests -----------------------------*/
 
@@ -507,11 +822,13 @@ main(int argc, char **argv)
   if ((dsq = malloc(sizeof(ESL_DSQ) *(L+2)))  == NULL)  esl_fatal("malloc failed");
   if (esl_rsq_xfIID(r, bg->f, abc->K, L, dsq) != eslOK) esl_fatal("seq generation failed");
   utest_stotrace(go, r, abc, gm, om, dsq, L, ntrace);
+  utest_batch   (go, r, abc, gm, om, dsq, L, ntrace);
 
   /* Test with seq sampled from profile */
   if ((sq = esl_sq_CreateDigital(abc))             == NULL) esl_fatal("sequence allocation failed");
   if (p7_ProfileEmit(r, hmm, gm, bg, sq, NULL)    != eslOK) esl_fatal("profile emission failed");
   utest_stotrace(go, r, abc, gm, om, sq->dsq, sq->n, ntrace);
+  utest_batch   (go, r, abc, gm, om, sq->dsq, sq->n, ntrace);
    
   esl_sq_Destroy(sq);
   free(dsq);
@@ -36,8 +36,8 @@
  * 1. Viterbi filter implementation.
  *****************************************************************/
 
-/* Function:  p7_ViterbiFilter()
- * Synopsis:  Calculates Viterbi score, vewy vewy fast, in limited precision.
+/* Function:  p7_ViterbiFilter_sse()
+ * Synopsis:  Calculates Viterbi score with 8-way SSE2 vectors.
  * Incept:    SRE, Tue Nov 27 09:15:24 2007 [Janelia]
  *
  * Purpose:   Calculates an approximation of the Viterbi score for sequence
@@ -80,7 +80,7 @@
  *            J4/138-140 for reimplementation in 16-bit precision
  */
 int
-p7_ViterbiFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc)
+p7_ViterbiFilter_sse(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc)
 {
   register __m128i mpv, dpv, ipv;  /* previous row values                                       */
   register __m128i sv;		   /* temp storage of 1 curr row value in progress              */
@@ -0,0 +1,431 @@
+/* Viterbi filter implementation; AVX2 version.
+ *
+ * Same algorithm as vitfilter.c, with 16-way sword vectors. The
+ * striped scores <om->rwv_avx>, <om->twv_avx> are derived from the
+ * SSE ones by p7_oprofile_RestripeVF_avx(). Every DP cell is computed
+ * with the same saturated arithmetic, and the "lazy F" decision only
+ * depends on row maxima, so p7_ViterbiFilter_avx() gives exactly the
+ * same status and score as p7_ViterbiFilter_sse().
+ *
+ * Compiled unless HMMER is configured with --disable-avx, or the compiler
+ * can't generate AVX2; called only through dispatch.c, when
+ * the processor supports it.
+ *
+ * Contents:
+ *   1. Viterbi filter implementation.
+ *   2. Benchmark driver.
+ *   3. Unit tests.
+ *   4. Test driver.
+ */
+#include "p7_config.h"
+#ifdef eslENABLE_AVX
+
+#include <stdio.h>
+#include <math.h>
+
+#include <immintrin.h>		/* AVX2 */
+
+#include "easel.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+
+/*****************************************************************
+ * 1. Viterbi filter implementation.
+ *****************************************************************/
+
+/* Function:  p7_ViterbiFilter_avx()
+ * Synopsis:  Calculates Viterbi score with 16-way AVX2 vectors.
+ *
+ * Purpose:   Same as <p7_ViterbiFilter_sse()>, using the AVX2 score
+ *            arrays in <om> and the AVX2 row <ox->dpw_avx> of the
+ *            DP matrix.
+ *
+ * Returns:   <eslOK> on success;
+ *            <eslERANGE> if the score overflows; in this case
+ *            <*ret_sc> is <eslINFINITY>, and the sequence can
+ *            be treated as a high-scoring hit.
+ *
+ * Throws:    <eslEINVAL> if <ox> allocation is too small, or if
+ *            profile isn't in a local alignment mode.
+ */
+int
+p7_ViterbiFilter_avx(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc)
+{
+  register __m256i mpv, dpv, ipv;  /* previous row values                                       */
+  register __m256i sv;		   /* temp storage of 1 curr row value in progress              */
+  register __m256i dcv;		   /* delayed storage of D(i,q+1)                               */
+  register __m256i xEv;		   /* E state: keeps max for Mk->E as we go                     */
+  register __m256i xBv;		   /* B state: splatted vector of B[i-1] for B->Mk calculations */
+  register __m256i Dmaxv;          /* keeps track of maximum D cell on row                      */
+  int16_t  xE, xB, xC, xJ, xN;	   /* special states' scores                                    */
+  int16_t  Dmax;		   /* maximum D cell score on row                               */
+  int i;			   /* counter over sequence positions 1..L                      */
+  int q;			   /* counter over vectors 0..nq-1                              */
+  int Q        = p7O_NQW_AVX(om->M); /* segment length: # of vectors                            */
+  __m256i *dp  = ox->dpw_avx;	   /* using {MDI}MX(q) macro requires initialization of <dp>    */
+  __m256i *rsc;			   /* will point at om->rwv_avx[x] for residue x[i]             */
+  __m256i *tsc;			   /* will point into (and step thru) om->twv_avx               */
+
+  __m256i negInfv;
+
+  /* Check that the DP matrix is ok for us. */
+  if (! (om->layout & p7_ISA_AVX))                     ESL_EXCEPTION(eslEINVAL, "profile has no AVX2 score layout");
+  if (Q > ox->allocQW_avx)                             ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small");
+  if (om->mode != p7_LOCAL && om->mode != p7_UNILOCAL) ESL_EXCEPTION(eslEINVAL, "Fast filter only works for local alignment");
+  ox->M   = om->M;
+
+  /* -infinity is -32768; negInfv has it in element 0 only, zeros elsewhere, for an OR operation. */
+  negInfv = _mm256_setr_epi16(-32768, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+  for (q = 0; q < Q; q++)
+    MMXo(q) = IMXo(q) = DMXo(q) = _mm256_set1_epi16(-32768);
+  xN   = om->base_w;
+  xB   = xN + om->xw[p7O_N][p7O_MOVE];
+  xJ   = -32768;
+  xC   = -32768;
+  xE   = -32768;
+
+  for (i = 1; i <= L; i++)
+    {
+      rsc   = om->rwv_avx[dsq[i]];
+      tsc   = om->twv_avx;
+      dcv   = _mm256_set1_epi16(-32768);      /* "-infinity" */
+      xEv   = _mm256_set1_epi16(-32768);
+      Dmaxv = _mm256_set1_epi16(-32768);
+      xBv   = _mm256_set1_epi16(xB);
+
+      /* Shift by one element across the whole vector; replace the zero shifted on with -32768. */
+      mpv = _mm256_or_si256(p7_avx_leftshift_epi16(MMXo(Q-1)), negInfv);
+      dpv = _mm256_or_si256(p7_avx_leftshift_epi16(DMXo(Q-1)), negInfv);
+      ipv = _mm256_or_si256(p7_avx_leftshift_epi16(IMXo(Q-1)), negInfv);
+
+      for (q = 0; q < Q; q++)
+	{
+	  /* Calculate new MMXo(i,q); don't store it yet, hold it in sv. */
+	  sv   =                       _mm256_adds_epi16(xBv, *tsc);  tsc++;
+	  sv   = _mm256_max_epi16 (sv, _mm256_adds_epi16(mpv, *tsc)); tsc++;
+	  sv   = _mm256_max_epi16 (sv, _mm256_adds_epi16(ipv, *tsc)); tsc++;
+	  sv   = _mm256_max_epi16 (sv, _mm256_adds_epi16(dpv, *tsc)); tsc++;
+	  sv   = _mm256_adds_epi16(sv, *rsc);                         rsc++;
+	  xEv  = _mm256_max_epi16(xEv, sv);
+
+	  /* Load {MDI}(i-1,q) into mpv, dpv, ipv;
+	   * {MDI}MX(q) is then the current, not the prev row
+	   */
+	  mpv = MMXo(q);
+	  dpv = DMXo(q);
+	  ipv = IMXo(q);
+
+	  /* Do the delayed stores of {MD}(i,q) now that memory is usable */
+	  MMXo(q) = sv;
+	  DMXo(q) = dcv;
+
+	  /* Calculate the next D(i,q+1) partially: M->D only;
+	   * delay storage, holding it in dcv
+	   */
+	  dcv   = _mm256_adds_epi16(sv, *tsc);  tsc++;
+	  Dmaxv = _mm256_max_epi16(dcv, Dmaxv);
+
+	  /* Calculate and store I(i,q) */
+	  sv     =                       _mm256_adds_epi16(mpv, *tsc);  tsc++;
+	  IMXo(q)= _mm256_max_epi16 (sv, _mm256_adds_epi16(ipv, *tsc)); tsc++;
+	}
+
+      /* Now the "special" states, which start from Mk->E (->C, ->J->B) */
+      xE = p7_avx_hmax_epi16(xEv);
+      if (xE >= 32767) { *ret_sc = eslINFINITY; return eslERANGE; }	/* immediately detect overflow */
+      xN = xN + om->xw[p7O_N][p7O_LOOP];
+      xC = ESL_MAX(xC + om->xw[p7O_C][p7O_LOOP], xE + om->xw[p7O_E][p7O_MOVE]);
+      xJ = ESL_MAX(xJ + om->xw[p7O_J][p7O_LOOP], xE + om->xw[p7O_E][p7O_LOOP]);
+      xB = ESL_MAX(xJ + om->xw[p7O_J][p7O_MOVE], xN + om->xw[p7O_N][p7O_MOVE]);
+
+      /* Finally the "lazy F" loop; see vitfilter.c. The test uses
+       * row maxima, so it makes the same decision as the SSE version,
+       * and the D->D passes converge to the same D values.
+       */
+      Dmax = p7_avx_hmax_epi16(Dmaxv);
+      if (Dmax + om->ddbound_w > xB)
+	{
+	  dcv = _mm256_or_si256(p7_avx_leftshift_epi16(dcv), negInfv);
+	  tsc = om->twv_avx + 7*Q;	/* set tsc to start of the DD's */
+	  for (q = 0; q < Q; q++)
+	    {
+	      DMXo(q) = _mm256_max_epi16(dcv, DMXo(q));
+	      dcv     = _mm256_adds_epi16(DMXo(q), *tsc); tsc++;
+	    }
+
+	  do {
+	    dcv = _mm256_or_si256(p7_avx_leftshift_epi16(dcv), negInfv);
+	    tsc = om->twv_avx + 7*Q;	/* set tsc to start of the DD's */
+	    for (q = 0; q < Q; q++)
+	      {
+		if (! p7_avx_any_gt_epi16(dcv, DMXo(q))) break;
+		DMXo(q) = _mm256_max_epi16(dcv, DMXo(q));
+		dcv     = _mm256_adds_epi16(DMXo(q), *tsc);   tsc++;
+	      }
+	  } while (q == Q);
+	}
+      else  /* not calculating DD? then just store the last M->D vector calc'ed.*/
+	DMXo(0) = _mm256_or_si256(p7_avx_leftshift_epi16(dcv), negInfv);
+    } /* end loop over sequence residues 1..L */
+
+  /* finally C->T */
+  if (xC > -32768)
+    {
+      *ret_sc = (float) xC + (float) om->xw[p7O_C][p7O_MOVE] - (float) om->base_w;
+      *ret_sc /= om->scale_w;
+      *ret_sc -= 3.0; /* the NN/CC/JJ=0,-3nat approximation: see J5/36. */
+    }
+  else  *ret_sc = -eslINFINITY;
+  return eslOK;
+}
+/*---------------- end, p7_ViterbiFilter_avx() ------------------*/
+
+
+
+/*****************************************************************
+ * 2. Benchmark driver.
+ *****************************************************************/
+#ifdef p7VITFILTER_AVX_BENCHMARK
+/*
+   ./vitfilter_avx_benchmark <hmmfile>            runs benchmark
+   ./vitfilter_avx_benchmark -s <hmmfile>         runs the SSE version, for comparison
+ */
+#include "p7_config.h"
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+#include "esl_randomseq.h"
+#include "esl_stopwatch.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",             0 },
+  { "-r",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "set random number seed randomly",                  0 },
+  { "-s",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "run the SSE version instead, for comparison",      0 },
+  { "-L",        eslARG_INT,    "400", NULL, "n>0", NULL,  NULL, NULL, "length of random target seqs",                     0 },
+  { "-N",        eslARG_INT,  "20000", NULL, "n>0", NULL,  NULL, NULL, "number of random target seqs",                     0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options] <hmmfile>";
+static char banner[] = "benchmark driver for the AVX2 ViterbiFilter() implementation";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go      = p7_CreateDefaultApp(options, 1, argc, argv, banner, usage);
+  char           *hmmfile = esl_opt_GetArg(go, 1);
+  ESL_STOPWATCH  *w       = esl_stopwatch_Create();
+  ESL_RANDOMNESS *r       = esl_randomness_CreateFast(esl_opt_GetBoolean(go, "-r") ? 0 : 42);
+  ESL_ALPHABET   *abc     = NULL;
+  P7_HMMFILE     *hfp     = NULL;
+  P7_HMM         *hmm     = NULL;
+  P7_BG          *bg      = NULL;
+  P7_PROFILE     *gm      = NULL;
+  P7_OPROFILE    *om      = NULL;
+  P7_OMX         *ox      = NULL;
+  int             L       = esl_opt_GetInteger(go, "-L");
+  int             N       = esl_opt_GetInteger(go, "-N");
+  ESL_DSQ        *dsq     = malloc(sizeof(ESL_DSQ) * (L+2));
+  int             i;
+  float           sc;
+  double          base_time, bench_time, Mcs;
+
+  /* select the AVX2 level before any profile is made, so profiles carry its layout */
+  if (p7_dispatch_Select(p7_ISA_AVX) != eslOK) p7_Fail("This processor doesn't support AVX2");
+  if (p7_hmmfile_OpenE(hmmfile, NULL, &hfp, NULL) != eslOK) p7_Fail("Failed to open HMM file %s", hmmfile);
+  if (p7_hmmfile_Read(hfp, &abc, &hmm)            != eslOK) p7_Fail("Failed to read HMM");
+
+  bg = p7_bg_Create(abc);
+  p7_bg_SetLength(bg, L);
+  gm = p7_profile_Create(hmm->M, abc);
+  p7_ProfileConfig(hmm, bg, gm, L, p7_LOCAL);
+  om = p7_oprofile_Create(gm->M, abc);
+  p7_oprofile_Convert(gm, om);
+  p7_oprofile_ReconfigLength(om, L);
+  ox = p7_omx_Create(gm->M, 0, 0);
+
+  esl_stopwatch_Start(w);
+  for (i = 0; i < N; i++) esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+  esl_stopwatch_Stop(w);
+  base_time = w->user;
+
+  esl_stopwatch_Start(w);
+  for (i = 0; i < N; i++)
+    {
+      esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+      if (esl_opt_GetBoolean(go, "-s")) p7_ViterbiFilter_sse(dsq, L, om, ox, &sc);
+      else                              p7_ViterbiFilter_avx(dsq, L, om, ox, &sc);
+    }
+  esl_stopwatch_Stop(w);
+  bench_time = w->user - base_time;
+  Mcs        = (double) N * (double) L * (double) gm->M * 1e-6 / (double) bench_time;
+  esl_stopwatch_Display(stdout, w, "# CPU time: ");
+  printf("# M    = %d\n",   gm->M);
+  printf("# %.1f Mc/s\n", Mcs);
+
+  free(dsq);
+  p7_omx_Destroy(ox);
+  p7_oprofile_Destroy(om);
+  p7_profile_Destroy(gm);
+  p7_bg_Destroy(bg);
+  p7_hmm_Destroy(hmm);
+  p7_hmmfile_Close(hfp);
+  esl_alphabet_Destroy(abc);
+  esl_stopwatch_Destroy(w);
+  esl_randomness_Destroy(r);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /*p7VITFILTER_AVX_BENCHMARK*/
+/*---------------- end, benchmark driver ------------------------*/
+
+
+
+/*****************************************************************
+ * 3. Unit tests.
+ *****************************************************************/
+#ifdef p7VITFILTER_AVX_TESTDRIVE
+#include "esl_random.h"
+#include "esl_randomseq.h"
+
+/* utest_compare()
+ *
+ * The AVX2 Viterbi filter must give exactly the same status and score
+ * as the SSE one. Compare them for a random model of length <M> on
+ * <N> iid sequences of length <L>, and on <N> sequences emitted from
+ * the model, which exercise the D->D and overflow paths.
+ */
+static void
+utest_compare(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  char         msg[] = "vitfilter_avx compare unit test failed";
+  P7_HMM      *hmm   = NULL;
+  P7_PROFILE  *gm    = NULL;
+  P7_OPROFILE *om    = NULL;
+  ESL_SQ      *sq    = esl_sq_CreateDigital(abc);
+  P7_OMX      *ox    = p7_omx_Create(M, 0, 0);
+  float        sc1, sc2;
+  int          st1, st2;
+  int          n;
+
+  if (p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om) != eslOK) esl_fatal(msg);
+
+  for (n = 0; n < 2*N; n++)
+    {
+      if (n < N) { if (esl_sq_GrowTo(sq, L) != eslOK) esl_fatal(msg); esl_rsq_xfIID(r, bg->f, abc->K, L, sq->dsq); sq->n = L; }
+      else if (p7_ProfileEmit(r, hmm, gm, bg, sq, NULL) != eslOK) esl_fatal(msg);
+
+      p7_oprofile_ReconfigLength(om, sq->n);
+
+      st1 = p7_ViterbiFilter_sse(sq->dsq, sq->n, om, ox, &sc1);
+      st2 = p7_ViterbiFilter_avx(sq->dsq, sq->n, om, ox, &sc2);
+      if (st1 != st2)  esl_fatal("%s: status %d != %d", msg, st1, st2);
+      if (sc1 != sc2)  esl_fatal("%s: score %f != %f",  msg, sc1, sc2);
+
+      esl_sq_Reuse(sq);
+    }
+
+  esl_sq_Destroy(sq);
+  p7_hmm_Destroy(hmm);
+  p7_omx_Destroy(ox);
+  p7_profile_Destroy(gm);
+  p7_oprofile_Destroy(om);
+}
+#endif /*p7VITFILTER_AVX_TESTDRIVE*/
+
+
+/*****************************************************************
+ * 4. Test driver
+ *****************************************************************/
+#ifdef p7VITFILTER_AVX_TESTDRIVE
+/*
+   gcc -g -Wall -mavx2 -std=gnu99 -I.. -L.. -I../../easel -L../../easel -o vitfilter_avx_utest -Dp7VITFILTER_AVX_TESTDRIVE vitfilter_avx.c -lhmmer -leasel -lm
+   ./vitfilter_avx_utest
+ */
+#include "p7_config.h"
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_sq.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",           0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                  0 },
+  { "-v",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "be verbose",                                     0 },
+  { "-L",        eslARG_INT,    "200", NULL, NULL,  NULL,  NULL, NULL, "size of random sequences to sample",             0 },
+  { "-M",        eslARG_INT,    "145", NULL, NULL,  NULL,  NULL, NULL, "size of random models to sample",                0 },
+  { "-N",        eslARG_INT,    "100", NULL, NULL,  NULL,  NULL, NULL, "number of random sequences to sample",           0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for the AVX2 ViterbiFilter() implementation";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go   = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *r    = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *abc  = NULL;
+  P7_BG          *bg   = NULL;
+  int             M    = esl_opt_GetInteger(go, "-M");
+  int             L    = esl_opt_GetInteger(go, "-L");
+  int             N    = esl_opt_GetInteger(go, "-N");
+
+  /* On a processor without AVX2 there's nothing to test; pass. */
+  if (p7_dispatch_Select(p7_ISA_AVX) != eslOK) {
+    if (esl_opt_GetBoolean(go, "-v")) printf("No AVX2 on this processor; skipping tests\n");
+    esl_randomness_Destroy(r);
+    esl_getopts_Destroy(go);
+    return eslOK;
+  }
+
+  if ((abc = esl_alphabet_Create(eslDNA)) == NULL)  esl_fatal("failed to create alphabet");
+  if ((bg = p7_bg_Create(abc))            == NULL)  esl_fatal("failed to create null model");
+
+  if (esl_opt_GetBoolean(go, "-v")) printf("ViterbiFilter_avx() tests, DNA\n");
+  utest_compare(r, abc, bg, M, L, N);
+  utest_compare(r, abc, bg, 1, L, 10);
+  utest_compare(r, abc, bg, M, 1, 10);
+
+  esl_alphabet_Destroy(abc);
+  p7_bg_Destroy(bg);
+
+  if ((abc = esl_alphabet_Create(eslAMINO)) == NULL)  esl_fatal("failed to create alphabet");
+  if ((bg = p7_bg_Create(abc))              == NULL)  esl_fatal("failed to create null model");
+
+  if (esl_opt_GetBoolean(go, "-v")) printf("ViterbiFilter_avx() tests, protein\n");
+  utest_compare(r, abc, bg, M, L, N);
+  utest_compare(r, abc, bg, 1, L, 10);
+  utest_compare(r, abc, bg, M, 1, 10);
+
+  esl_alphabet_Destroy(abc);
+  p7_bg_Destroy(bg);
+
+  esl_getopts_Destroy(go);
+  esl_randomness_Destroy(r);
+  return eslOK;
+}
+#endif /*p7VITFILTER_AVX_TESTDRIVE*/
+/*---------------------- end, test driver -----------------------*/
+
+
+#else /*! eslENABLE_AVX*/
+/* Standard compiler-pleasing mantra for an #ifdef'd-out, empty code file. */
+void p7_vitfilter_avx_silence_hack(void) { return; }
+#if defined p7VITFILTER_AVX_TESTDRIVE || defined p7VITFILTER_AVX_BENCHMARK
+int main(void) { return 0; }
+#endif
+#endif /*eslENABLE_AVX*/
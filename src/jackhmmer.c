@@ -26,15 +26,20 @@
 #ifdef HMMER_THREADS
 #include <unistd.h>
 #include "esl_threads.h"
-#include "esl_workqueue.h"
 #endif 
 
 #include "hmmer.h"
+#include "cachedb.h"
+#include "p7_scheduler.h"
+#include "p7_seqdb.h"
+#include "p7_seqreader.h"
 
 typedef struct {
 #ifdef HMMER_THREADS
-  ESL_WORK_QUEUE   *queue;
+  P7_SCHEDULER     *sched;
 #endif
+  P7_SEQDB         *seqdb;       /* pre-digitized targets, or NULL */
+  P7_SEQCACHE      *cache;       /* targets loaded in memory, or NULL */
   P7_BG            *bg;
   P7_PIPELINE      *pli;
   P7_TOPHITS       *th;
@@ -52,7 +57,7 @@ typedef struct {
 
 #if defined (HMMER_THREADS) && defined (HMMER_MPI)
 #define CPUOPTS     "--mpi"
-#define MPIOPTS     "--cpu"
+#define MPIOPTS     "--cpu,--rcpu,--cache"
 #else
 #define CPUOPTS     NULL
 #define MPIOPTS     NULL
@@ -137,9 +142,11 @@ static ESL_OPTIONS options[] = {
   { "--seed",       eslARG_INT,          "42", NULL, "n>=0",    NULL,    NULL,  NULL,            "set RNG seed to <n> (if 0: one-time arbitrary seed)",         12 },
   { "--qformat",    eslARG_STRING,       NULL, NULL, NULL,      NULL,    NULL,  NULL,            "assert query <seqfile> is in format <s>: no autodetection",   12 },
   { "--tformat",    eslARG_STRING,       NULL, NULL, NULL,      NULL,    NULL,  NULL,            "assert target <seqdb> is in format <s>>: no autodetection",   12 },
+  { "--cache",      eslARG_NONE,        FALSE, NULL, NULL,      NULL,    NULL,  NULL,            "read <seqdb> into memory once, and search it from there",      12 },
 
 #ifdef HMMER_THREADS
   { "--cpu",        eslARG_INT,      p7_NCPU,"HMMER_NCPU","n>=0", NULL,    NULL,  CPUOPTS,       "number of parallel CPU workers to use for multithreads",      12 },
+  { "--rcpu",       eslARG_INT,          "0", NULL,      "n>=0", NULL,    NULL,  CPUOPTS,       "number of threads parsing <seqdb> (0: the master reads it)",  12 },
 #endif
 #ifdef HMMER_MPI
   { "--stall",      eslARG_NONE,       FALSE, NULL,  NULL,      NULL,  "--mpi", NULL,            "arrest after start: for debugging MPI under gdb",             12 },  
@@ -168,11 +175,11 @@ struct cfg_s {
 
 
 static int  serial_master(ESL_GETOPTS *go, struct cfg_s *cfg);
-static int  serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp);
+static int  serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, P7_SEQDB *seqdb, P7_SEQCACHE *cache);
 #ifdef HMMER_THREADS
 #define BLOCK_SIZE 1000
 
-static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp);
+static int  thread_loop(ESL_THREADS *obj, P7_SCHEDULER *sched, P7_SEQREADER *rdr, ESL_SQFILE *dbfp, P7_SEQDB *seqdb, P7_SEQCACHE *cache);
 static void pipeline_thread(void *arg);
 #endif 
 
@@ -261,8 +268,8 @@ process_commandline(int argc, char **argv, ESL_GETOPTS **ret_go, char **ret_qfil
   if ((*ret_dbfile = esl_opt_GetArg(go, 2)) == NULL) { if (puts("Failed to get <seqdb> argument on command line")   < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed");   goto FAILURE; }
 
   /* Validate any attempted use of stdin streams */
-  if (strcmp(*ret_dbfile, "-") == 0) 
-    { if (puts("jackhmmer cannot read <seqdb> from stdin stream") < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed"); goto FAILURE; }
+  if (strcmp(*ret_dbfile, "-") == 0 && ! esl_opt_GetBoolean(go, "--cache"))
+    { if (puts("jackhmmer cannot read <seqdb> from stdin stream, except with --cache") < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed"); goto FAILURE; }
 
   *ret_go = go;
   return eslOK;
@@ -353,8 +360,10 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *qfile, char *dbfile)
     }
   if (esl_opt_IsUsed(go, "--qformat")    && fprintf(ofp, "# query <seqfile> format asserted: %s\n",             esl_opt_GetString(go, "--qformat"))   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--tformat")    && fprintf(ofp, "# target <seqdb> format asserted:  %s\n",             esl_opt_GetString(go, "--tformat"))   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--cache")      && fprintf(ofp, "# targets held in memory:          yes\n")                                                      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #ifdef HMMER_THREADS
   if (esl_opt_IsUsed(go, "--cpu")        && fprintf(ofp, "# number of worker threads:        %d\n",             esl_opt_GetInteger(go, "--cpu"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--rcpu")       && fprintf(ofp, "# number of parser threads:        %d\n",             esl_opt_GetInteger(go, "--rcpu"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #endif
 #ifdef HMMER_MPI
   if (esl_opt_IsUsed(go, "--mpi")        && fprintf(ofp, "# MPI:                             on\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -435,6 +444,8 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   int              dbformat = eslSQFILE_UNKNOWN;  /* format of dbfile                                */
   ESL_SQFILE      *qfp      = NULL;		  /* open qfile                                      */
   ESL_SQFILE      *dbfp     = NULL;               /* open dbfile                                     */
+  P7_SEQDB        *seqdb    = NULL;               /* ... or open pre-digitized dbfile                */
+  P7_SEQCACHE     *cache    = NULL;               /* ... or dbfile loaded in memory (--cache)        */
   ESL_ALPHABET    *abc      = NULL;               /* sequence alphabet                               */
   P7_BG           *bg       = NULL;		  /* null model                                      */
   P7_BUILDER      *bld      = NULL;               /* HMM construction configuration                  */
@@ -459,8 +470,10 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #ifdef HMMER_THREADS
   ESL_SQ_BLOCK    *block    = NULL;
   ESL_THREADS     *threadObj= NULL;
-  ESL_WORK_QUEUE  *queue    = NULL;
+  P7_SCHEDULER    *sched    = NULL;
+  P7_SEQREADER    *rdr      = NULL;
 #endif
+  char             errbuf[eslERRBUFSIZE];
 
   /* Initializations */
   abc           = esl_alphabet_Create(eslAMINO);
@@ -505,15 +518,34 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (esl_opt_IsOn(go, "--domtblout") && (domtblfp = fopen(esl_opt_GetString(go, "--domtblout"), "w")) == NULL)  
     p7_Fail("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblout"));
 
-  /* Open the target sequence database for sequential access. */
-  status =  esl_sqfile_OpenDigital(abc, cfg->dbfile, dbformat, p7_SEQDBENV, &dbfp);
-  if      (status == eslENOTFOUND) p7_Fail("Failed to open target sequence database %s for reading\n",      cfg->dbfile);
-  else if (status == eslEFORMAT)   p7_Fail("Target sequence database file %s is empty or misformatted\n",   cfg->dbfile);
-  else if (status == eslEINVAL)    p7_Fail("Can't autodetect format of a stdin or .gz seqfile");
-  else if (status != eslOK)        p7_Fail("Unexpected error %d opening target sequence database file %s\n", status, cfg->dbfile);
-  
-  if (! esl_sqfile_IsRewindable(dbfp)) 
-    p7_Fail("Target sequence file %s isn't rewindable; jackhmmer requires that it is", cfg->dbfile);
+  /* Open the target sequence database: a makehmmerseqdb file, or else a sequence file for sequential access. */
+  if (dbformat == eslSQFILE_UNKNOWN && strcmp(cfg->dbfile, "-") != 0)
+    {
+      status = p7_seqdb_Open(cfg->dbfile, &seqdb, errbuf);
+      if      (status != eslOK && status != eslEFORMAT && status != eslENOTFOUND) p7_Fail("Failed to open binary target sequence database %s\n%s\n", cfg->dbfile, errbuf);
+      else if (status == eslOK && seqdb->abctype != abc->type)                   p7_Fail("Binary target sequence database %s isn't protein\n", cfg->dbfile);
+    }
+
+  if (seqdb == NULL)
+    {
+      status =  esl_sqfile_OpenDigital(abc, cfg->dbfile, dbformat, p7_SEQDBENV, &dbfp);
+      if      (status == eslENOTFOUND) p7_Fail("Failed to open target sequence database %s for reading\n",      cfg->dbfile);
+      else if (status == eslEFORMAT)   p7_Fail("Target sequence database file %s is empty or misformatted\n",   cfg->dbfile);
+      else if (status == eslEINVAL)    p7_Fail("Can't autodetect format of a stdin or .gz seqfile");
+      else if (status != eslOK)        p7_Fail("Unexpected error %d opening target sequence database file %s\n", status, cfg->dbfile);
+
+      /* With --cache, targets are read once, here, and every iteration searches them in memory. */
+      if (esl_opt_GetBoolean(go, "--cache"))
+	{
+	  status = p7_seqcache_Load(dbfp, abc, &cache, errbuf);
+	  if      (status == eslEFORMAT || status == eslERANGE) p7_Fail("Failed to load target sequence database %s:\n%s\n", cfg->dbfile, errbuf);
+	  else if (status != eslOK)                             p7_Fail("Unexpected error %d loading target sequence database %s\n", status, cfg->dbfile);
+	  esl_sqfile_Close(dbfp);
+	  dbfp = NULL;
+	}
+      else if (! esl_sqfile_IsRewindable(dbfp)) 
+        p7_Fail("Target sequence file %s isn't rewindable; jackhmmer requires that it is, unless --cache is used", cfg->dbfile);
+    }
 
   /* Open the query sequence file  */
   status = esl_sqfile_OpenDigital(abc, cfg->qfile, qformat, NULL, &qfp);
@@ -529,7 +561,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (ncpus > 0)
     {
       threadObj = esl_threads_Create(&pipeline_thread);
-      queue = esl_workqueue_Create(ncpus * 2);
+      sched     = p7_scheduler_Create(ncpus);
     }
 #endif
 
@@ -545,26 +577,35 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       info[i].th    = NULL;
       info[i].om    = NULL;
       info[i].bg    = p7_bg_Clone(bg);
+      info[i].seqdb = seqdb;
+      info[i].cache = cache;
 #ifdef HMMER_THREADS
-      info[i].queue = queue;
+      info[i].sched = sched;
 #endif
     }
 
 #ifdef HMMER_THREADS
   for (i = 0; i < ncpus * 2; ++i)
     {
-      block = esl_sq_CreateDigitalBlock(BLOCK_SIZE, abc);
+      block = ((seqdb || cache) ? p7_seqdb_CreateBlock(BLOCK_SIZE, abc) : esl_sq_CreateDigitalBlock(BLOCK_SIZE, abc));
       if (block == NULL) 
 	{
 	  p7_Fail("Failed to allocate sequence block");
 	}
 
-      status = esl_workqueue_Init(queue, block);
+      status = p7_scheduler_Add(sched, block);
       if (status != eslOK) 
 	{
-	  p7_Fail("Failed to add block to work queue");
+	  p7_Fail("Failed to add block to scheduler");
 	}
     }
+
+  /* Parallel parsing of <seqdb>, if asked for and if the file can be split */
+  if (ncpus > 0 && dbfp != NULL && esl_opt_GetInteger(go, "--rcpu") > 0)
+    {
+      status = p7_seqreader_Open(dbfp, esl_opt_GetInteger(go, "--rcpu"), BLOCK_SIZE, 0, &rdr);
+      if (status != eslOK && status != eslEINCOMPAT) p7_Fail("Failed to set up parallel parsing of %s", cfg->dbfile);
+    }
 #endif
 
   /* Outer loop over sequence queries, if more than one */
@@ -641,23 +682,23 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 	    }
 
 #ifdef HMMER_THREADS
-	  if (ncpus > 0) sstatus = thread_loop(threadObj, queue, dbfp);
-	  else           sstatus = serial_loop(info, dbfp);
+	  if (ncpus > 0) sstatus = thread_loop(threadObj, sched, rdr, dbfp, seqdb, cache);
+	  else           sstatus = serial_loop(info, dbfp, seqdb, cache);
 #else
-	  sstatus = serial_loop(info, dbfp);
+	  sstatus = serial_loop(info, dbfp, seqdb, cache);
 #endif
 	  switch(sstatus)
 	    {
 	    case eslEFORMAT:
 	      p7_Fail("Parse failed (sequence file %s):\n%s\n",
-			dbfp->filename, esl_sqfile_GetErrorBuf(dbfp));
+			cfg->dbfile, esl_sqfile_GetErrorBuf(dbfp));
 	      break;
 	    case eslEOF:
 	      /* do nothing */
 	      break;
 	    default:
 	      p7_Fail("Unexpected error %d reading sequence file %s",
-			sstatus, dbfp->filename);
+			sstatus, cfg->dbfile);
 	    }
 
 	  /* merge the results of the search results */
@@ -709,7 +750,8 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 	  else if (iteration < maxiterations)
 	    { if (fprintf(ofp, "@@ Continuing to next round.\n\n")           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
-	  esl_sqfile_Position(dbfp, 0);
+	  if      (seqdb) p7_seqdb_Position(seqdb, 0);
+	  else if (dbfp)  esl_sqfile_Position(dbfp, 0);
 	} /* end iteration loop */
 
       /* Because we destroy/create the hitlist, om, pipeline, and msa above, rather than create/destroy,
@@ -740,7 +782,8 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       p7_trace_Destroy(qtr);
       esl_sq_Reuse(qsq);
       esl_keyhash_Reuse(kh);
-      esl_sqfile_Position(dbfp, 0);
+      if      (seqdb) p7_seqdb_Position(seqdb, 0);
+      else if (dbfp)  esl_sqfile_Position(dbfp, 0);
     }
   if      (qstatus == eslEFORMAT) p7_Fail("Parse failed (sequence file %s):\n%s\n",
 					    qfp->filename, esl_sqfile_GetErrorBuf(qfp));
@@ -761,10 +804,14 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #ifdef HMMER_THREADS
   if (ncpus > 0)
     {
-      esl_workqueue_Reset(queue);
-      while (esl_workqueue_Remove(queue, (void **) &block) == eslOK)
-	esl_sq_DestroyBlock(block);
-      esl_workqueue_Destroy(queue);
+      p7_scheduler_Reset(sched);
+      while (p7_scheduler_Remove(sched, (void **) &block) == eslOK)
+	{
+	  if (seqdb || cache) p7_seqdb_DestroyBlock(block);
+	  else                esl_sq_DestroyBlock(block);
+	}
+      p7_scheduler_Destroy(sched);
+      p7_seqreader_Close(rdr);
       esl_threads_Destroy(threadObj);
     }
 #endif
@@ -773,7 +820,9 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   esl_keyhash_Destroy(kh);
   esl_sqfile_Close(qfp);
-  esl_sqfile_Close(dbfp);
+  if (dbfp) esl_sqfile_Close(dbfp);
+  p7_seqdb_Close(seqdb);
+  if (cache) p7_seqcache_Close(cache);
   esl_sq_Destroy(qsq);  
   esl_stopwatch_Destroy(w);
   p7_builder_Destroy(bld);
@@ -1598,73 +1647,88 @@ checkpoint_msa(int nquery, ESL_MSA *msa, char *basename, int iteration)
 }
 
 static int
-serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp)
+serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, P7_SEQDB *seqdb, P7_SEQCACHE *cache)
 {
   int      sstatus;
   ESL_SQ   *dbsq     = NULL;   /* one target sequence (digital)  */
+  uint32_t  next     = 0;      /* next target in <cache>          */
+  int       is_view  = (seqdb != NULL || cache != NULL);
 
-  dbsq = esl_sq_CreateDigital(info->om->abc);
+  dbsq = (is_view ? p7_seqdb_CreateSeq(info->om->abc) : esl_sq_CreateDigital(info->om->abc));
 
   /* Main loop: */
-  while ((sstatus = esl_sqio_Read(dbfp, dbsq)) == eslOK)
+  while (1)
     {
+      if      (seqdb) sstatus = p7_seqdb_Read(seqdb, dbsq);
+      else if (cache) sstatus = p7_seqcache_Read(cache, &next, dbsq);
+      else            sstatus = esl_sqio_Read(dbfp, dbsq);
+      if (sstatus != eslOK) break;
+
       p7_pli_NewSeq(info->pli, dbsq);
       p7_bg_SetLength(info->bg, dbsq->n);
       p7_oprofile_ReconfigLength(info->om, dbsq->n);
       
       p7_Pipeline(info->pli, info->om, info->bg, dbsq, NULL, info->th);
 
-      esl_sq_Reuse(dbsq);
+      if (! is_view) esl_sq_Reuse(dbsq);
       p7_pipeline_Reuse(info->pli);
     }
 
-  esl_sq_Destroy(dbsq);
+  if (is_view) p7_seqdb_DestroySeq(dbsq);
+  else         esl_sq_Destroy(dbsq);
 
   return sstatus;
 }
 
 #ifdef HMMER_THREADS
 static int
-thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp)
+thread_loop(ESL_THREADS *obj, P7_SCHEDULER *sched, P7_SEQREADER *rdr, ESL_SQFILE *dbfp, P7_SEQDB *seqdb, P7_SEQCACHE *cache)
 {
   int  status  = eslOK;
   int  sstatus = eslOK;
-  int  eofCount = 0;
+  uint32_t      next = 0;	/* next target in <cache> */
   ESL_SQ_BLOCK *block;
   void         *newBlock;
 
-  esl_workqueue_Reset(queue);
   esl_threads_WaitForStart(obj);
 
-  status = esl_workqueue_ReaderUpdate(queue, NULL, &newBlock);
-  if (status != eslOK) p7_Fail("Work queue reader failed");
+  if (rdr != NULL && p7_seqreader_Start(rdr, -1, 0) != eslOK) p7_Fail("Failed to start parser threads");
+
+  status = p7_scheduler_ReaderUpdate(sched, NULL, 0, &newBlock);
+  if (status != eslOK) p7_Fail("Scheduler reader failed");
       
   /* Main loop: */
   while (sstatus == eslOK)
     {
       block = (ESL_SQ_BLOCK *) newBlock;
-      sstatus = esl_sqio_ReadBlock(dbfp, block, -1, -1, /*max_init_window=*/FALSE, FALSE);
-      if (sstatus == eslEOF)
-	{
-	  if (eofCount < esl_threads_GetWorkerCount(obj)) sstatus = eslOK;
-	  ++eofCount;
-	}
+      if      (seqdb) sstatus = p7_seqdb_ReadBlock(seqdb, block, -1);
+      else if (cache) sstatus = p7_seqcache_ReadBlock(cache, &next, block, -1);
+      else if (rdr)   sstatus = p7_seqreader_ReadBlock(rdr, block, -1);
+      else            sstatus = esl_sqio_ReadBlock(dbfp, block, -1, -1, /*max_init_window=*/FALSE, FALSE);
 
       if (sstatus == eslOK)
 	{
-	  status = esl_workqueue_ReaderUpdate(queue, block, &newBlock);
-	  if (status != eslOK) p7_Fail("Work queue reader failed");
+	  status = p7_scheduler_ReaderUpdate(sched, block, block->count, &newBlock);
+	  if (status != eslOK) p7_Fail("Scheduler reader failed");
 	}
     }
 
-  status = esl_workqueue_ReaderUpdate(queue, block, NULL);
-  if (status != eslOK) p7_Fail("Work queue reader failed");
+  status = p7_scheduler_ReaderUpdate(sched, block, block->count, NULL);
+  if (status != eslOK) p7_Fail("Scheduler reader failed");
+  status = p7_scheduler_ReaderFinish(sched);
+  if (status != eslOK) p7_Fail("Scheduler reader failed");
+
+  if (rdr != NULL)
+    {
+      if (sstatus == eslEFORMAT) p7_Fail("Parse failed (sequence file %s):\n%s\n", dbfp->filename, rdr->errbuf);
+      p7_seqreader_Stop(rdr);
+    }
 
   if (sstatus == eslEOF)
     {
       /* wait for all the threads to complete */
       esl_threads_WaitForFinish(obj);
-      esl_workqueue_Complete(queue);  
+      p7_scheduler_Reset(sched);
     }
 
   return sstatus;
@@ -1679,8 +1743,8 @@ pipeline_thread(void *arg)
   WORKER_INFO   *info;
   ESL_THREADS   *obj;
 
-  ESL_SQ_BLOCK  *block = NULL;
-  void          *newBlock;
+  ESL_SQ_BLOCK   *block;
+  P7_SCHED_RANGE  r;
 
   impl_Init();
 
@@ -1690,15 +1754,14 @@ pipeline_thread(void *arg)
 
   info = (WORKER_INFO *) esl_threads_GetData(obj, workeridx);
 
-  status = esl_workqueue_WorkerUpdate(info->queue, NULL, &newBlock);
-  if (status != eslOK) p7_Fail("Work queue worker failed");
-
-  /* loop until all blocks have been processed */
-  block = (ESL_SQ_BLOCK *) newBlock;
-  while (block->count > 0)
+  /* loop until all targets have been processed, a few at a time */
+  r.blk = NULL;
+  while ((status = p7_scheduler_WorkerUpdate(info->sched, workeridx, &r)) == eslOK)
     {
+      block = (ESL_SQ_BLOCK *) r.blk;
+
       /* Main loop: */
-      for (i = 0; i < block->count; ++i)
+      for (i = r.lo; i < r.hi; ++i)
 	{
 	  ESL_SQ *dbsq = block->list + i;
 
@@ -1708,18 +1771,11 @@ pipeline_thread(void *arg)
 
 	  p7_Pipeline(info->pli, info->om, info->bg, dbsq, NULL, info->th);
 
-	  esl_sq_Reuse(dbsq);
+	  if (info->seqdb == NULL && info->cache == NULL) esl_sq_Reuse(dbsq); /* views own nothing to reuse */
 	  p7_pipeline_Reuse(info->pli);
 	}
-
-      status = esl_workqueue_WorkerUpdate(info->queue, block, &newBlock);
-      if (status != eslOK) p7_Fail("Work queue worker failed");
-
-      block = (ESL_SQ_BLOCK *) newBlock;
     }
-
-  status = esl_workqueue_WorkerUpdate(info->queue, block, NULL);
-  if (status != eslOK) p7_Fail("Work queue worker failed");
+  if (status != eslEOD) p7_Fail("Scheduler worker failed");
 
   esl_threads_Finished(obj, workeridx);
   return;
@@ -0,0 +1,105 @@
+/* makehmmerseqdb: prepare a sequence database for faster hmmsearch, phmmer, jackhmmer searches.
+ *
+ * The sequences are digitized once, here, and written in a binary
+ * file that the search programs memory-map; see p7_seqdb.c.
+ */
+#include "p7_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_sq.h"
+#include "esl_sqio.h"
+
+#include "hmmer.h"
+#include "p7_seqdb.h"
+
+#define ALPHOPTS "--amino,--dna,--rna"                         /* Exclusive options for alphabet choice */
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range     toggles      reqs   incomp  help   docgroup*/
+  { "-h",         eslARG_NONE,   FALSE, NULL, NULL,      NULL,      NULL,    NULL, "show brief help on version and usage",          0 },
+  { "-f",         eslARG_NONE,   FALSE, NULL, NULL,      NULL,      NULL,    NULL, "force: overwrite any previous <binaryfile>",    0 },
+  { "--amino",    eslARG_NONE,   FALSE, NULL, NULL,  ALPHOPTS,      NULL,    NULL, "input is protein sequence",                     0 },
+  { "--dna",      eslARG_NONE,   FALSE, NULL, NULL,  ALPHOPTS,      NULL,    NULL, "input is DNA sequence",                         0 },
+  { "--rna",      eslARG_NONE,   FALSE, NULL, NULL,  ALPHOPTS,      NULL,    NULL, "input is RNA sequence",                         0 },
+  { "--informat", eslARG_STRING,  NULL, NULL, NULL,      NULL,      NULL,    NULL, "assert input <seqfile> is in format <s>",       0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options] <seqfile> <binaryfile>";
+static char banner[] = "prepare a sequence database for faster hmmsearch, phmmer, jackhmmer searches";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go      = p7_CreateDefaultApp(options, 2, argc, argv, banner, usage);
+  char           *seqfile = esl_opt_GetArg(go, 1);
+  char           *dbfile  = esl_opt_GetArg(go, 2);
+  ESL_ALPHABET   *abc     = NULL;
+  ESL_SQFILE     *sqfp    = NULL;
+  FILE           *ofp     = NULL;
+  int             infmt   = eslSQFILE_UNKNOWN;
+  int             alphatype;
+  int64_t         nseq    = 0;
+  int64_t         nres    = 0;
+  int             status;
+  char            errbuf[eslERRBUFSIZE];
+
+  if (strcmp(dbfile, "-") == 0) p7_Fail("Can't use - for <binaryfile> argument: the database must be a file that can be memory-mapped\n");
+  if (esl_FileExists(dbfile) && ! esl_opt_GetBoolean(go, "-f"))
+    p7_Fail("Binary database %s already exists.\nDelete it, rename it, or use -f to overwrite it.\n", dbfile);
+
+  if (esl_opt_IsOn(go, "--informat")) {
+    infmt = esl_sqio_EncodeFormat(esl_opt_GetString(go, "--informat"));
+    if (infmt == eslSQFILE_UNKNOWN) p7_Fail("%s is not a recognized input sequence file format\n", esl_opt_GetString(go, "--informat"));
+  }
+
+  status = esl_sqfile_Open(seqfile, infmt, p7_SEQDBENV, &sqfp);
+  if      (status == eslENOTFOUND) p7_Fail("Failed to open sequence file %s for reading\n",          seqfile);
+  else if (status == eslEFORMAT)   p7_Fail("Sequence file %s is empty or misformatted\n",            seqfile);
+  else if (status == eslEINVAL)    p7_Fail("Can't autodetect format of a stdin or .gz seqfile");
+  else if (status != eslOK)        p7_Fail("Unexpected error %d opening sequence file %s\n", status, seqfile);
+
+  if      (esl_opt_GetBoolean(go, "--amino")) alphatype = eslAMINO;
+  else if (esl_opt_GetBoolean(go, "--dna"))   alphatype = eslDNA;
+  else if (esl_opt_GetBoolean(go, "--rna"))   alphatype = eslRNA;
+  else {
+    status = esl_sqfile_GuessAlphabet(sqfp, &alphatype);
+    if      (status == eslENOALPHABET) p7_Fail("Couldn't guess alphabet from first sequence in %s.\nUse --amino, --dna, or --rna to specify it.\n", seqfile);
+    else if (status == eslEFORMAT)     p7_Fail("Parse failed (sequence file %s):\n%s\n", seqfile, esl_sqfile_GetErrorBuf(sqfp));
+    else if (status == eslENODATA)     p7_Fail("Sequence file %s contains no data?\n", seqfile);
+    else if (status != eslOK)          p7_Fail("Failed to guess alphabet of %s (error code %d)\n", seqfile, status);
+  }
+  abc = esl_alphabet_Create(alphatype);
+  esl_sqfile_SetDigital(sqfp, abc);
+
+  if ((ofp = fopen(dbfile, "wb")) == NULL) p7_Fail("Failed to open binary database %s for writing\n", dbfile);
+
+  printf("Working...    ");
+  fflush(stdout);
+
+  status = p7_seqdb_Write(sqfp, ofp, &nseq, &nres, errbuf);
+  if (fclose(ofp) != 0 && status == eslOK) ESL_XFAIL(eslEWRITE, errbuf, "failed to close %s", dbfile);
+  ofp = NULL;
+  if (status != eslOK) goto ERROR;
+
+  printf("done.\n");
+  printf("Digitized %" PRId64 " sequences (%" PRId64 " residues) into %s.\n", nseq, nres, dbfile);
+
+  esl_sqfile_Close(sqfp);
+  esl_alphabet_Destroy(abc);
+  esl_getopts_Destroy(go);
+  return eslOK;
+
+ ERROR:
+  /* Don't leave a partial/corrupt database behind. */
+  if (ofp) fclose(ofp);
+  if (esl_FileExists(dbfile)) remove(dbfile);
+  printf("failed.\n");
+  fprintf(stderr, "\nError: %s\n", errbuf);
+  exit(1);
+}
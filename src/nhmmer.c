@@ -26,13 +26,16 @@
 #endif /*HMMER_THREADS*/
 
 #include "hmmer.h"
+#include "p7_scheduler.h"
+#include "p7_seqreader.h"
 
 /* set the max residue count to 1/4 meg when reading a block */
 #define NHMMER_MAX_RESIDUE_COUNT (1024 * 256)  /* 1/4 Mb */
 
 typedef struct {
 #ifdef HMMER_THREADS
-  ESL_WORK_QUEUE   *queue;
+  ESL_WORK_QUEUE   *queue;       /* FM-index searches                       */
+  P7_SCHEDULER     *sched;       /* sequence file searches                  */
 #endif /*HMMER_THREADS*/
   P7_BG            *bg;          /* null model                              */
   P7_PIPELINE      *pli;         /* work pipeline                           */
@@ -176,6 +179,7 @@ static ESL_OPTIONS options[] = {
 
 #ifdef HMMER_THREADS 
   { "--cpu",        eslARG_INT, p7_NCPU,"HMMER_NCPU","n>=0",NULL,  NULL,  CPUOPTS,         "number of parallel CPU workers to use for multithreads",      12 },
+  { "--rcpu",       eslARG_INT,    "0",  NULL, "n>=0",  NULL,  NULL,  CPUOPTS,           "number of threads parsing <seqdb> (0: the master reads it)",  12 },
 #endif
   {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
@@ -212,7 +216,7 @@ static int  serial_loop    (WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, E
 #ifdef HMMER_THREADS
 #define BLOCK_SIZE 1000
 
-static int  thread_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, char *firstseq_key, int n_targetseqs);
+static int  thread_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_THREADS *obj, P7_SCHEDULER *sched, P7_SEQREADER *rdr, ESL_SQFILE *dbfp, char *firstseq_key, int n_targetseqs);
 static void pipeline_thread(void *arg);
 #if defined (eslENABLE_SSE)
 static int  thread_loop_FM(WORKER_INFO *info, ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp);
@@ -374,6 +378,7 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *queryfile, char *seqfile,
 #ifdef HMMER_THREADS
   //if (esl_opt_IsUsed(go, "--cpu")        && fprintf(ofp, "# number of worker threads:        %d\n",             esl_opt_GetInteger(go, "--cpu"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (fprintf(ofp, "# number of worker threads:        %d\n",             ncpus)      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--rcpu")       && fprintf(ofp, "# number of parser threads:        %d\n",             esl_opt_GetInteger(go, "--rcpu"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #endif
   if (fprintf(ofp, "# - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -\n\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   return eslOK;
@@ -553,6 +558,8 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #endif // eslENABLE_SSE
   ESL_THREADS     *threadObj= NULL;
   ESL_WORK_QUEUE  *queue    = NULL;
+  P7_SCHEDULER    *sched    = NULL;
+  P7_SEQREADER    *rdr      = NULL;
 #endif // HMMER_THREADS
   char   errbuf[eslERRBUFSIZE];
   double window_beta = -1.0 ;
@@ -804,7 +811,8 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #endif
         threadObj = esl_threads_Create(&pipeline_thread);
 
-      queue = esl_workqueue_Create(ncpus * 2);
+      if (dbformat == eslSQFILE_FMINDEX) queue = esl_workqueue_Create(ncpus * 2);
+      else                               sched = p7_scheduler_Create(ncpus);
   }
 #endif
 
@@ -835,6 +843,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
 #ifdef HMMER_THREADS
           info[i].queue = queue;
+          info[i].sched = sched;
 #endif
       }
 
@@ -861,10 +870,16 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
           block = esl_sq_CreateDigitalBlock(BLOCK_SIZE, abc);
           if (block == NULL)           esl_fatal("Failed to allocate sequence block");
 
-          status = esl_workqueue_Init(queue, block);
-          if (status != eslOK)          esl_fatal("Failed to add block to work queue");
+          status = p7_scheduler_Add(sched, block);
+          if (status != eslOK)          esl_fatal("Failed to add block to scheduler");
         }
       }
+
+      /* Parallel parsing of <seqdb>, if asked for and if the file can be split */
+      if (ncpus > 0 && dbformat != eslSQFILE_FMINDEX && esl_opt_GetInteger(go, "--rcpu") > 0 && cfg->firstseq_key == NULL) {
+        status = p7_seqreader_Open(dbfp, esl_opt_GetInteger(go, "--rcpu"), BLOCK_SIZE, 0, &rdr);
+        if (status != eslOK && status != eslEINCOMPAT) esl_fatal("Failed to set up parallel parsing of %s", cfg->dbfile);
+      }
 #endif
   }
 
@@ -1067,7 +1082,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       else
 #endif //defined (eslENABLE_SSE)
       {
-        if (ncpus > 0)  sstatus = thread_loop    (info, id_length_list, threadObj, queue, dbfp, cfg->firstseq_key, cfg->n_targetseq);
+        if (ncpus > 0)  sstatus = thread_loop    (info, id_length_list, threadObj, sched, rdr, dbfp, cfg->firstseq_key, cfg->n_targetseq);
         else            sstatus = serial_loop    (info, id_length_list, dbfp, cfg->firstseq_key, cfg->n_targetseq);
       }
 
@@ -1248,9 +1263,9 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
 #ifdef HMMER_THREADS
   if (ncpus > 0) {
-      esl_workqueue_Reset(queue);
 #if defined (eslENABLE_SSE)
       if (dbformat == eslSQFILE_FMINDEX) {
+        esl_workqueue_Reset(queue);
         while (esl_workqueue_Remove(queue, (void **) &fminfo) == eslOK) {
           if (fminfo) {
             if (fminfo->fmf) free(fminfo->fmf);
@@ -1258,15 +1273,18 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
             free(fminfo);
           }
         }
+        esl_workqueue_Destroy(queue);
       }
       else
 #endif
       {
-        while (esl_workqueue_Remove(queue, (void **) &block) == eslOK) {
+        p7_scheduler_Reset(sched);
+        while (p7_scheduler_Remove(sched, (void **) &block) == eslOK) {
           esl_sq_DestroyBlock(block);
         }
+        p7_scheduler_Destroy(sched);
+        p7_seqreader_Close(rdr);
       }
-      esl_workqueue_Destroy(queue);
       esl_threads_Destroy(threadObj);
   }
 #endif
@@ -1429,13 +1447,12 @@ serial_loop_FM(WORKER_INFO *info, ESL_SQFILE *dbfp)
 
 #ifdef HMMER_THREADS
 static int
-thread_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, char *firstseq_key, int n_targetseqs)
+thread_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_THREADS *obj, P7_SCHEDULER *sched, P7_SEQREADER *rdr, ESL_SQFILE *dbfp, char *firstseq_key, int n_targetseqs)
 {
 
   int          i;
   int          status  = eslOK;
   int          sstatus = eslOK;
-  int          eofCount = 0;
   ESL_SQ_BLOCK *block;
   void         *newBlock;
   int          seqid = -1;
@@ -1444,11 +1461,12 @@ thread_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_THREADS *obj,
   int          abort = FALSE; // in the case n_targetseqs != -1, a block may get abbreviated
 
 
-  esl_workqueue_Reset(queue);
   esl_threads_WaitForStart(obj);
 
-  status = esl_workqueue_ReaderUpdate(queue, NULL, &newBlock);
-  if (status != eslOK) esl_fatal("Work queue reader failed");
+  if (rdr != NULL && p7_seqreader_Start(rdr, info->pli->block_length, info->om->max_length) != eslOK) esl_fatal("Failed to start parser threads");
+
+  status = p7_scheduler_ReaderUpdate(sched, NULL, 0, &newBlock);
+  if (status != eslOK) esl_fatal("Scheduler reader failed");
   ((ESL_SQ_BLOCK *)newBlock)->complete = TRUE;
 
   /* Main loop: */
@@ -1458,6 +1476,8 @@ thread_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_THREADS *obj,
       if (abort) {
         block->count = 0;
         sstatus = eslEOF;
+      } else if (rdr != NULL) {
+        sstatus = p7_seqreader_ReadBlock(rdr, block, -1); /* windows, not sequences; the abort check below limits them */
       } else {
         sstatus = esl_sqio_ReadBlock(dbfp, block, info->pli->block_length, n_targetseqs, /*max_init_window=*/FALSE, TRUE);
       }
@@ -1480,10 +1500,7 @@ thread_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_THREADS *obj,
       info->pli->nseqs += block->count  - ((abort || block->complete) ? 0 : 1);// if there's an incomplete sequence read into the block wait to count it until it's complete.
 
 
-      if (sstatus == eslEOF) {
-          if (eofCount < esl_threads_GetWorkerCount(obj)) sstatus = eslOK;
-          ++eofCount;
-      } else if (!block->complete ) {
+      if (rdr == NULL && sstatus != eslEOF && !block->complete ) {
           // The final sequence on the block was an incomplete window of the active sequence,
           // so our next read will need a copy of it to correctly deal with overlapping
           // regions. We capture a copy of the sequence here before sending it off to the
@@ -1502,10 +1519,9 @@ thread_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_THREADS *obj,
            * during the esl_sqio_ReadBlock() function call earlier in this loop
            * (i.e. "complete" isn't altered by the worker threads)*/
           int prev_complete = block->complete;
-          status = esl_workqueue_ReaderUpdate(queue, block, &newBlock); 
-
-
-          if (status != eslOK) esl_fatal("Work queue reader failed");
+          status = p7_scheduler_ReaderUpdate(sched, block, block->count, &newBlock);
+          if (status != eslOK) esl_fatal("Scheduler reader failed");
+          if (rdr != NULL) continue; // the parser threads carry windows over between blocks themselves
 
           // Check how much space the new structure is using and re-allocate if it has grown to more than 20*block_size bytes
           // this loop iterates from 0 to newBlock->listsize rather than newBlock->count because we want to count all of the
@@ -1554,13 +1570,20 @@ thread_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_THREADS *obj,
   }
 
 
-  status = esl_workqueue_ReaderUpdate(queue, block, NULL);
-  if (status != eslOK) esl_fatal("Work queue reader failed");
+  status = p7_scheduler_ReaderUpdate(sched, block, block->count, NULL);
+  if (status != eslOK) esl_fatal("Scheduler reader failed");
+  status = p7_scheduler_ReaderFinish(sched);
+  if (status != eslOK) esl_fatal("Scheduler reader failed");
+
+  if (rdr != NULL) {
+    if (sstatus == eslEFORMAT) esl_fatal("Parse failed (sequence file %s):\n%s\n", dbfp->filename, rdr->errbuf);
+    p7_seqreader_Stop(rdr);
+  }
 
   if (sstatus == eslEOF) {
       /* wait for all the threads to complete */
       esl_threads_WaitForFinish(obj);
-      esl_workqueue_Complete(queue);  
+      p7_scheduler_Reset(sched);
     }
 
   esl_sq_Destroy(tmpsq);
@@ -1576,8 +1599,8 @@ pipeline_thread(void *arg)
   int workeridx;
   WORKER_INFO   *info;
   ESL_THREADS   *obj;
-  ESL_SQ_BLOCK  *block = NULL;
-  void          *newBlock;
+  ESL_SQ_BLOCK   *block;
+  P7_SCHED_RANGE  r;
   
   impl_Init();
 
@@ -1586,17 +1609,14 @@ pipeline_thread(void *arg)
 
   info = (WORKER_INFO *) esl_threads_GetData(obj, workeridx);
 
-  status = esl_workqueue_WorkerUpdate(info->queue, NULL, &newBlock);
-  if (status != eslOK) esl_fatal("Work queue worker failed");
-
-
-  /* loop until all blocks have been processed */
-  block = (ESL_SQ_BLOCK *) newBlock;
-
-  while (block->count > 0)
+  /* loop until all windows have been processed, a few at a time */
+  r.blk = NULL;
+  while ((status = p7_scheduler_WorkerUpdate(info->sched, workeridx, &r)) == eslOK)
   {
+      block = (ESL_SQ_BLOCK *) r.blk;
+
       /* Main loop: */
-      for (i = 0; i < block->count; ++i)
+      for (i = r.lo; i < r.hi; ++i)
     {
       ESL_SQ *dbsq = block->list + i;
 
@@ -1622,15 +1642,8 @@ pipeline_thread(void *arg)
           info->pli->nres += dbsq->W;
       }
     }
- 
-      status = esl_workqueue_WorkerUpdate(info->queue, block, &newBlock);
-      if (status != eslOK) esl_fatal("Work queue worker failed");
-
-      block = (ESL_SQ_BLOCK *) newBlock;
-
   }
-  status = esl_workqueue_WorkerUpdate(info->queue, block, NULL);
-  if (status != eslOK) esl_fatal("Work queue worker failed");
+  if (status != eslEOD) esl_fatal("Scheduler worker failed");
   esl_threads_Finished(obj, workeridx);
   return;
 }
@@ -59,6 +59,38 @@
  * revisit how these modes are handled in H4 once that portion of the code stabilizes.
  */ 
 
+/* alidisplay_span()
+ *
+ * Find the piece of trace <tr> that an alignment display of domain
+ * <which> represents, from its first to its last M state, and return
+ * it in <*ret_z1>..<*ret_z2>. Uses the trace's index if it has one.
+ * Returns <eslOK>, or <eslFAIL> if there's no such domain or it has
+ * no M state (a corrupt trace).
+ */
+static int
+alidisplay_span(const P7_TRACE *tr, int which, int *ret_z1, int *ret_z2)
+{
+  int z1, z2;
+
+  if (tr->ndom > 0) {		/* if we have an index, this is a little faster: */
+    for (z1 = tr->tfrom[which]; z1 < tr->N; z1++) if (tr->st[z1] == p7T_M) break;  /* find next M state      */
+    if (z1 == tr->N) return eslFAIL;                                               /* no M? corrupt trace    */
+    for (z2 = tr->tto[which];   z2 >= 0 ;   z2--) if (tr->st[z2] == p7T_M) break;  /* find prev M state      */
+    if (z2 == -1) return eslFAIL;                                                  /* no M? corrupt trace    */
+  } else {			/* without an index, we can still do it fine:    */
+    for (z1 = 0; which >= 0 && z1 < tr->N; z1++) if (tr->st[z1] == p7T_B) which--; /* find the right B state */
+    if (z1 == tr->N) return eslFAIL;                                               /* no such domain <which> */
+    for (; z1 < tr->N; z1++) if (tr->st[z1] == p7T_M) break;                       /* find next M state      */
+    if (z1 == tr->N) return eslFAIL;                                               /* no M? corrupt trace    */
+    for (z2 = z1; z2 < tr->N; z2++) if (tr->st[z2] == p7T_E) break;                /* find the next E state  */
+    for (; z2 >= 0;    z2--) if (tr->st[z2] == p7T_M) break;                       /* find prev M state      */
+    if (z2 == -1) return eslFAIL;                                                  /* no M? corrupt trace    */
+  }
+  *ret_z1 = z1;
+  *ret_z2 = z2;
+  return eslOK;
+}
+
 /* Function:  p7_alidisplay_Create()
  * Synopsis:  Create an alignment display, from trace and oprofile.
  *
@@ -104,20 +136,7 @@ p7_alidisplay_Create(const P7_TRACE *tr, int which, const P7_OPROFILE *om, const
   /* First figure out which piece of the trace (from first match to last match) 
    * we're going to represent, and how big it is.
    */
-  if (tr->ndom > 0) {		/* if we have an index, this is a little faster: */
-    for (z1 = tr->tfrom[which]; z1 < tr->N; z1++) if (tr->st[z1] == p7T_M) break;  /* find next M state      */
-    if (z1 == tr->N) return NULL;                                                  /* no M? corrupt trace    */
-    for (z2 = tr->tto[which];   z2 >= 0 ;   z2--) if (tr->st[z2] == p7T_M) break;  /* find prev M state      */
-    if (z2 == -1) return NULL;                                                     /* no M? corrupt trace    */
-  } else {			/* without an index, we can still do it fine:    */
-    for (z1 = 0; which >= 0 && z1 < tr->N; z1++) if (tr->st[z1] == p7T_B) which--; /* find the right B state */
-    if (z1 == tr->N) return NULL;                                                  /* no such domain <which> */
-    for (; z1 < tr->N; z1++) if (tr->st[z1] == p7T_M) break;                       /* find next M state      */
-    if (z1 == tr->N) return NULL;                                                  /* no M? corrupt trace    */
-    for (z2 = z1; z2 < tr->N; z2++) if (tr->st[z2] == p7T_E) break;                /* find the next E state  */
-    for (; z2 >= 0;    z2--) if (tr->st[z2] == p7T_M) break;                       /* find prev M state      */
-    if (z2 == -1) return NULL;                                                     /* no M? corrupt trace    */
-  }
+  if (alidisplay_span(tr, which, &z1, &z2) != eslOK) return NULL;
 
   /* Now we know that z1..z2 in the trace will be represented in the
    * alidisplay; that's z2-z1+1 positions. We need a \0 trailer on all
@@ -1341,6 +1360,152 @@ p7_alidisplay_Backconvert(const P7_ALIDISPLAY *ad, const ESL_ALPHABET *abc, ESL_
   *ret_tr = NULL;
   return status;
 }
+
+
+/* Function:  p7_alitrace_Create()
+ * Synopsis:  Keep a domain's alignment compactly, to display later.
+ *
+ * Purpose:   Creates and returns a <P7_ALITRACE> for domain number
+ *            <which> in traceback <tr> of a profile to digital
+ *            sequence <sq>: the states of the trace from its first to
+ *            its last M, their posterior probabilities (encoded as in
+ *            a <ppline>) if <tr> has them, and the residues they
+ *            emit. That's all <p7_alidisplay_Create()> needs from the
+ *            trace and the sequence, so <p7_alitrace_Display()> can
+ *            make the same display later, once the caller knows the
+ *            domain is going to be shown, for a fraction of the
+ *            memory.
+ *
+ *            As with <p7_alidisplay_Create()>, the trace may or may
+ *            not be indexed.
+ *
+ * Returns:   a pointer to the new <P7_ALITRACE>.
+ *
+ * Throws:    <NULL> on allocation failure, or if something's internally
+ *            corrupt in the trace.
+ */
+P7_ALITRACE *
+p7_alitrace_Create(const P7_TRACE *tr, int which, const ESL_SQ *sq)
+{
+  P7_ALITRACE *atr = NULL;
+  int          z1, z2, z;
+  int          N, R, r;
+  int          status;
+
+  if (alidisplay_span(tr, which, &z1, &z2) != eslOK) return NULL;
+
+  N = z2-z1+1;
+  for (R = 0, z = z1; z <= z2; z++)
+    if (tr->st[z] == p7T_M || tr->st[z] == p7T_I) R++;
+
+  ESL_ALLOC(atr, sizeof(P7_ALITRACE));
+  atr->mem = NULL;
+  ESL_ALLOC(atr->mem, sizeof(ESL_DSQ) * (R+2) + sizeof(char) * (tr->pp ? 2*N : N));
+  atr->rsq = (ESL_DSQ *) atr->mem;
+  atr->st  = atr->mem + sizeof(ESL_DSQ) * (R+2);
+  atr->pp  = (tr->pp ? atr->st + N : NULL);
+
+  atr->N       = N;
+  atr->hmmfrom = tr->k[z1];
+  atr->sqfrom  = tr->i[z1];
+  atr->sqto    = tr->i[z2];
+  atr->L       = sq->n;
+
+  atr->rsq[0] = eslDSQ_SENTINEL;
+  for (r = 1, z = z1; z <= z2; z++)
+    {
+      switch (tr->st[z]) {
+      case p7T_M: 
+      case p7T_I: atr->rsq[r++] = sq->dsq[tr->i[z]]; break;
+      case p7T_D:                                    break;
+      default: ESL_XEXCEPTION(eslEINVAL, "invalid state in trace: not M,D,I");
+      }
+      atr->st[z-z1] = tr->st[z];
+      if (atr->pp) atr->pp[z-z1] = ( (tr->st[z] == p7T_D) ? '.' : p7_alidisplay_EncodePostProb(tr->pp[z]));
+    }
+  atr->rsq[R+1] = eslDSQ_SENTINEL;
+  return atr;
+
+ ERROR:
+  p7_alitrace_Destroy(atr);
+  return NULL;
+}
+
+
+/* Function:  p7_alitrace_Display()
+ * Synopsis:  Make the alignment display of a <P7_ALITRACE>.
+ *
+ * Purpose:   Create and return the alignment display of the domain
+ *            that <atr> holds, aligned to profile <om>. The target's
+ *            name, accession, and description are <sqname>, <sqacc>,
+ *            and <sqdesc>; <sqacc> and <sqdesc> may be <NULL> if
+ *            unset. <om> must be the profile the domain was aligned
+ *            to. The display is identical to the one
+ *            <p7_alidisplay_Create()> would have made from the
+ *            original trace and sequence.
+ *
+ * Returns:   a pointer to the new <P7_ALIDISPLAY>.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+P7_ALIDISPLAY *
+p7_alitrace_Display(const P7_ALITRACE *atr, const P7_OPROFILE *om, const char *sqname, const char *sqacc, const char *sqdesc)
+{
+  P7_ALIDISPLAY *ad = NULL;
+  P7_TRACE      *tr = NULL;
+  ESL_SQ        *sq = NULL;
+  int            k  = atr->hmmfrom;
+  int            i  = 1;
+  int            z;
+  float          pp;
+  int            status;
+
+  /* Rebuild a one-domain trace of the residues in <atr->rsq> */
+  if ((tr = (atr->pp ? p7_trace_CreateWithPP() : p7_trace_Create())) == NULL) goto ERROR;
+  if ((status = p7_trace_GrowTo(tr, atr->N+2))                       != eslOK) goto ERROR;
+
+  if ((status = (atr->pp ? p7_trace_AppendWithPP(tr, p7T_B, 0, 0, 0.0) : p7_trace_Append(tr, p7T_B, 0, 0))) != eslOK) goto ERROR;
+  for (z = 0; z < atr->N; z++)
+    {
+      pp = (atr->pp ? p7_alidisplay_DecodePostProb(atr->pp[z]) : 0.0);
+      switch (atr->st[z]) {
+      case p7T_M: status = (atr->pp ? p7_trace_AppendWithPP(tr, p7T_M, k,   i, pp) : p7_trace_Append(tr, p7T_M, k,   i)); k++; i++; break;
+      case p7T_D: status = (atr->pp ? p7_trace_AppendWithPP(tr, p7T_D, k,   0, pp) : p7_trace_Append(tr, p7T_D, k,   0)); k++;      break;
+      case p7T_I: status = (atr->pp ? p7_trace_AppendWithPP(tr, p7T_I, k-1, i, pp) : p7_trace_Append(tr, p7T_I, k-1, i));      i++; break;
+      }
+      if (status != eslOK) goto ERROR;
+    }
+  if ((status = (atr->pp ? p7_trace_AppendWithPP(tr, p7T_E, 0, 0, 0.0) : p7_trace_Append(tr, p7T_E, 0, 0))) != eslOK) goto ERROR;
+
+  if ((sq = esl_sq_CreateDigitalFrom(om->abc, sqname, atr->rsq, i-1, sqdesc, sqacc, NULL)) == NULL) goto ERROR;
+  if ((ad = p7_alidisplay_Create(tr, 0, om, sq, NULL))                                       == NULL) goto ERROR;
+
+  /* coords were relative to the residues we kept; shift them back */
+  ad->sqto   += atr->sqfrom - 1;
+  ad->sqfrom  = atr->sqfrom;
+  ad->L       = atr->L;
+
+  p7_trace_Destroy(tr);
+  esl_sq_Destroy(sq);
+  return ad;
+
+ ERROR:
+  if (tr) p7_trace_Destroy(tr);
+  if (sq) esl_sq_Destroy(sq);
+  return NULL;
+}
+
+
+/* Function:  p7_alitrace_Destroy()
+ * Synopsis:  Frees a <P7_ALITRACE>.
+ */
+void
+p7_alitrace_Destroy(P7_ALITRACE *atr)
+{
+  if (atr == NULL) return;
+  if (atr->mem) free(atr->mem);
+  free(atr);
+}
 /*------------------- end, alidisplay API -----------------------*/
 
 
@@ -2063,6 +2228,58 @@ utest_Backconvert(int be_verbose, ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, int nt
 }
 
 
+/* utest_Alitrace()
+ *
+ * A display made later from a P7_ALITRACE must be identical to the
+ * one p7_alidisplay_Create() makes from the trace, for each domain
+ * of sequences emitted from a random profile, with and without
+ * posterior probabilities.
+ */
+static void
+utest_Alitrace(ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, int ntrials, int M)
+{
+  char           msg[] = "utest_Alitrace failed";
+  P7_BG         *bg    = p7_bg_Create(abc);
+  P7_HMM        *hmm   = NULL;
+  P7_PROFILE    *gm    = NULL;
+  P7_OPROFILE   *om    = NULL;
+  ESL_SQ        *sq    = esl_sq_CreateDigital(abc);
+  P7_TRACE      *tr    = NULL;
+  P7_ALITRACE   *atr   = NULL;
+  P7_ALIDISPLAY *ad1   = NULL;
+  P7_ALIDISPLAY *ad2   = NULL;
+  int            trial, d, z;
+
+  if (p7_oprofile_Sample(rng, abc, bg, M, 100, &hmm, &gm, &om) != eslOK) esl_fatal(msg);
+
+  for (trial = 0; trial < ntrials; trial++)
+    {
+      tr = (trial % 2 ? p7_trace_CreateWithPP() : p7_trace_Create());
+      if (p7_ProfileEmit(rng, hmm, gm, bg, sq, tr) != eslOK) esl_fatal(msg);
+      if (esl_sq_FormatName(sq, "seq%d", trial)    != eslOK) esl_fatal(msg);
+      if (tr->pp) for (z = 0; z < tr->N; z++) tr->pp[z] = esl_random(rng);
+      if (p7_trace_Index(tr)                       != eslOK) esl_fatal(msg);
+
+      for (d = 0; d < tr->ndom; d++)
+	{
+	  if ((ad1 = p7_alidisplay_Create(tr, d, om, sq, NULL))          == NULL)  esl_fatal(msg);
+	  if ((atr = p7_alitrace_Create(tr, d, sq))                      == NULL)  esl_fatal(msg);
+	  if ((ad2 = p7_alitrace_Display(atr, om, sq->name, NULL, NULL)) == NULL)  esl_fatal(msg);
+	  if (p7_alidisplay_Compare(ad1, ad2)                            != eslOK) esl_fatal(msg);
+	  p7_alidisplay_Destroy(ad1);
+	  p7_alidisplay_Destroy(ad2);
+	  p7_alitrace_Destroy(atr);
+	}
+      p7_trace_Destroy(tr);
+    }
+
+  esl_sq_Destroy(sq);
+  p7_oprofile_Destroy(om);
+  p7_profile_Destroy(gm);
+  p7_hmm_Destroy(hmm);
+  p7_bg_Destroy(bg);
+}
+
 #endif /*p7ALIDISPLAY_TESTDRIVE*/
 /*------------------- end, unit tests ---------------------------*/
 
@@ -2105,6 +2322,7 @@ main(int argc, char **argv)
   //utest_Serialize_old  (            rng,      N, L);
   utest_Serialize(rng, 100);
   utest_Backconvert(be_verbose, rng, abc, N, L);
+  utest_Alitrace(rng, abc, N, 50);
   utest_serialize_error_conditions(rng);
   utest_deserialize_error_conditions(rng);
 
@@ -12,6 +12,7 @@
  */
 #include "p7_config.h"
 
+#include <math.h>
 #include <string.h>
 
 #include "easel.h"
@@ -466,18 +467,47 @@ p7_bg_SetFilter(P7_BG *bg, int M, const float *compo)
  *            The filter null model has no length distribution of its
  *            own; the same geometric length distribution (controlled
  *            by <bg->p1>) that the null1 model uses is imposed.
+ *
+ *            This is the same calculation as <esl_hmm_Forward()> on
+ *            <bg->fhmm>, written out for two states: it needs no DP
+ *            matrix, and instead of normalizing every row (a log()
+ *            per residue), it only rescales when the values drift
+ *            out of range, the way the SSE Forward filter does.
  */
 int
 p7_bg_FilterScore(P7_BG *bg, const ESL_DSQ *dsq, int L, float *ret_sc)
 {
-  ESL_HMX *hmx = esl_hmx_Create(L, bg->fhmm->M); /* optimization target: this can be a 2-row matrix, and it can be stored in <bg>. */
-  float nullsc;		                  	 /* (or it could be passed in as an arg, but for sure it shouldn't be alloc'ed here */
-  
-  esl_hmm_Forward(dsq, L, bg->fhmm, hmx, &nullsc);
+  ESL_HMM *hmm   = bg->fhmm;
+  double   logsc = 0.;		/* log of the scale factors taken out so far */
+  float    a, b;		/* scaled Forward values of states 0, 1 at row i */
+  float    na;
+  float    max;
+  int      i;
+
+  if (L == 0) logsc = log(hmm->pi[2]);
+  else
+    {
+      a = hmm->pi[0] * hmm->eo[dsq[1]][0];
+      b = hmm->pi[1] * hmm->eo[dsq[1]][1];
+      for (i = 2; i <= L; i++)
+	{
+	  na = (a * hmm->t[0][0] + b * hmm->t[1][0]) * hmm->eo[dsq[i]][0];
+	  b  = (a * hmm->t[0][1] + b * hmm->t[1][1]) * hmm->eo[dsq[i]][1];
+	  a  = na;
+
+	  max = ESL_MAX(a, b);
+	  if (max > 1e10 || (max < 1e-10 && max > 0.))
+	    {
+	      a     /= max;
+	      b     /= max;
+	      logsc += log(max);
+	    }
+	}
+      logsc += log(a * hmm->t[0][2] + b * hmm->t[1][2]);
+    }
 
   /* impose the length distribution */
-  *ret_sc = nullsc + (float) L * logf(bg->p1) + logf(1.-bg->p1);
-  esl_hmx_Destroy(hmx);
+  *ret_sc = (float) logsc + (float) L * logf(bg->p1) + logf(1.-bg->p1);
   return eslOK;
 }
 
@@ -555,6 +585,7 @@ main(int argc, char **argv)
 #ifdef p7BG_TESTDRIVE
 #include "esl_dirichlet.h"
 #include "esl_random.h"
+#include "esl_randomseq.h"
 
 static void
 utest_ReadWrite(ESL_RANDOMNESS *rng)
@@ -587,6 +618,53 @@ utest_ReadWrite(ESL_RANDOMNESS *rng)
   free(fq);
   remove(tmpfile);
 }
+
+/* utest_FilterScore()
+ * p7_bg_FilterScore() against the general-purpose esl_hmm_Forward() 
+ * on the same filter HMM.
+ */
+static void
+utest_FilterScore(ESL_RANDOMNESS *rng)
+{
+  char          msg[] = "bg FilterScore unit test failed";
+  ESL_ALPHABET *abc   = NULL;
+  P7_BG        *bg    = NULL;
+  float        *compo = NULL;
+  ESL_DSQ      *dsq   = NULL;
+  ESL_HMX      *hmx   = NULL;
+  int           M     = 1 + esl_rnd_Roll(rng, 400);
+  int           L     = 1 + esl_rnd_Roll(rng, 2000);
+  float         sc1, sc2;
+  int           n;
+
+  if ((abc   = esl_alphabet_Create(eslAMINO))     == NULL)  esl_fatal(msg);
+  if ((bg    = p7_bg_Create(abc))                 == NULL)  esl_fatal(msg);
+  if ((compo = malloc(sizeof(float) * abc->K))    == NULL)  esl_fatal(msg);
+  if ((dsq   = malloc(sizeof(ESL_DSQ) * (L+2)))   == NULL)  esl_fatal(msg);
+  if ((hmx   = esl_hmx_Create(L, 2))              == NULL)  esl_fatal(msg);
+
+  for (n = 0; n < 10; n++)
+    {
+      /* a biased composition, and a target with some of it */
+      do {
+	if (esl_dirichlet_FSampleUniform(rng, abc->K, compo) != eslOK) esl_fatal(msg);
+      } while (esl_vec_FMin(compo, abc->K) < 0.001); 
+      if (esl_rsq_xfIID(rng, (n%2 ? compo : bg->f), abc->K, L, dsq) != eslOK) esl_fatal(msg);
+
+      p7_bg_SetFilter(bg, M, compo);
+      p7_bg_SetLength(bg, L);
+      if (p7_bg_FilterScore(bg, dsq, L, &sc1)               != eslOK) esl_fatal(msg);
+      if (esl_hmm_Forward(dsq, L, bg->fhmm, hmx, &sc2)      != eslOK) esl_fatal(msg);
+      sc2 += (float) L * logf(bg->p1) + logf(1.-bg->p1);
+      if (fabs(sc1 - sc2) > 0.001 * (1. + fabs(sc2)))                 esl_fatal(msg);
+    }
+
+  esl_hmx_Destroy(hmx);
+  free(dsq);
+  free(compo);
+  p7_bg_Destroy(bg);
+  esl_alphabet_Destroy(abc);
+}
 #endif /*p7BG_TESTDRIVE*/
 
 
@@ -625,6 +703,7 @@ main(int argc, char **argv)
   if (be_verbose) printf("p7_bg unit test: rng seed %" PRIu32 "\n", esl_randomness_GetSeed(rng));
 
   utest_ReadWrite(rng);
+  utest_FilterScore(rng);
 
   esl_randomness_Destroy(rng);
   esl_getopts_Destroy(go);
@@ -49,6 +49,7 @@ extern P7_DOMAIN *p7_domain_Create_empty(){
   the_domain->is_included = 0;
   the_domain->scores_per_pos = NULL;
   the_domain->ad = NULL;
+  the_domain->atr = NULL;
 
   return the_domain;
 
@@ -80,6 +81,9 @@ extern void p7_domain_Destroy(P7_DOMAIN *obj){
   if(obj->ad != NULL){
     p7_alidisplay_Destroy(obj->ad);
   }
+  if(obj->atr != NULL){
+    p7_alitrace_Destroy(obj->atr);
+  }
   free(obj);
   return;
 }
@@ -112,9 +116,9 @@ extern void p7_domain_Destroy(P7_DOMAIN *obj){
  *            Returns eslFAIL if a calculation fails a consistency check.   
  */
 
-// base size is 2 ints bigger than required for the fixed-length members of the strucuture, one int for the serialized length,
-// one int for the length of the scores_per_pos array (in floats)
-#define SER_BASE_SIZE (4 * sizeof(int)) + (6 * sizeof(int64_t)) + (5 * sizeof(float)) + (sizeof(double))
+// base size is 3 ints bigger than required for the fixed-length members of the strucuture, one int for the serialized length,
+// one int for whether an alignment display follows, one int for the length of the scores_per_pos array (in floats)
+#define SER_BASE_SIZE (5 * sizeof(int)) + (6 * sizeof(int64_t)) + (5 * sizeof(float)) + (sizeof(double))
 
 extern int p7_domain_Serialize(const P7_DOMAIN *obj, uint8_t **buf, uint32_t *n, uint32_t *nalloc){
 
@@ -229,6 +233,11 @@ extern int p7_domain_Serialize(const P7_DOMAIN *obj, uint8_t **buf, uint32_t *n,
   memcpy(ptr, &network_32bit, sizeof(int32_t));
   ptr += sizeof(int32_t);
 
+  // Field 16: whether a P7_ALIDISPLAY follows; a lazy pipeline only makes them for domains it might report
+  network_32bit = esl_hton32(obj->ad != NULL);
+  memcpy(ptr, &network_32bit, sizeof(int32_t));
+  ptr += sizeof(int32_t);
+
   //Handle the scores_per_pos_array
   if(obj->scores_per_pos == NULL){ // No scores_per_pos, so just record its size as 0
     network_32bit = esl_hton32(0);
@@ -255,6 +264,9 @@ extern int p7_domain_Serialize(const P7_DOMAIN *obj, uint8_t **buf, uint32_t *n,
   }
 
   *n = ptr - *buf; // update offset into buffer so that alidisplay_Serialize starts in the right place
+  if(obj->ad == NULL){ // no alignment display to send
+    return eslOK;
+  }
   // Finally, the P7_ALIDISPLAY object
   int ser_return = p7_alidisplay_Serialize(obj->ad, buf, n, nalloc);
 
@@ -381,6 +393,11 @@ extern int p7_domain_Deserialize(const uint8_t *buf, uint32_t *n, P7_DOMAIN *ret
   ret_obj->is_included = esl_ntoh32(network_32bit);
   ptr += sizeof(uint32_t);
 
+  // Whether a P7_ALIDISPLAY follows
+  memcpy(&network_32bit, ptr, sizeof(uint32_t)); 
+  int has_ad = esl_ntoh32(network_32bit);
+  ptr += sizeof(uint32_t);
+
   // Thirteenth field: length of scores_per_pos array
   memcpy(&network_32bit, ptr, sizeof(uint32_t)); 
   int scores_per_pos_length = esl_ntoh32(network_32bit);
@@ -407,7 +424,12 @@ extern int p7_domain_Deserialize(const uint8_t *buf, uint32_t *n, P7_DOMAIN *ret
 
   *n = ptr - buf;  //update index into the buffer
 
-    // finally, the enclosed P7_ALIDISPLAY object
+    // finally, the enclosed P7_ALIDISPLAY object, if any
+  if(! has_ad){
+    p7_alidisplay_Destroy(ret_obj->ad);
+    ret_obj->ad = NULL;
+    return eslOK;
+  }
   if(ret_obj->ad == NULL){
     ret_obj->ad =p7_alidisplay_Create_empty(); // need a structure to serialize into
   }
@@ -478,7 +500,12 @@ extern int p7_domain_TestSample(ESL_RAND64 *rng, P7_DOMAIN **ret_obj){
   }
   else{ // array is empty
     the_domain->scores_per_pos = NULL;
+    if(esl_rand64_Roll(rng, 2) == 0){ // and sometimes, like an unreported domain from a lazy pipeline, no alignment display either
+      p7_alidisplay_Destroy(the_domain->ad);
+      the_domain->ad = NULL;
+    }
   }
+  the_domain->atr = NULL;
 
   return eslOK; // If we make it here, everything went well
 
@@ -569,6 +596,9 @@ extern int p7_domain_Compare(P7_DOMAIN *first, P7_DOMAIN *second, double atol, d
     }
   }
   // Finally, compare the alidisplays.  If they match, and we've gotten this far, we match
+  if(first->ad == NULL || second->ad == NULL){
+    return (first->ad == second->ad) ? eslOK : eslFAIL;
+  }
   return p7_alidisplay_Compare(first->ad, second->ad);
 }
 
@@ -45,7 +45,9 @@
 #include "hmmer.h"
 
 static int is_multidomain_region  (P7_DOMAINDEF *ddef, int i, int j);
-static int region_trace_ensemble  (P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *dsq, int ireg, int jreg, const P7_OMX *fwd, P7_OMX *wrk, int *ret_nc);
+static int use_checkpointed       (const P7_DOMAINDEF *ddef, const P7_OPROFILE *om, int L, int long_target);
+static int region_trace_ensemble  (P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *dsq, int ireg, int jreg, P7_OMX *fwd, P7_OMX *wrk, int use_ckp, int *ret_nc);
+static int decode_and_align(const P7_OPROFILE *om, P7_OMX *ox1, P7_OMX *ox2, float *ret_oasc);
 static int rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OMX *ox1, P7_OMX *ox2,
 				   int i, int j, int null2_is_done, P7_BG *bg, int long_target, P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr);
 
@@ -102,6 +104,9 @@ p7_domaindef_Create(ESL_RANDOMNESS *r)
   ddef->nclustered = 0;
   ddef->noverlaps  = 0;
   ddef->nenvelopes = 0;
+  ddef->ad_ns      = 0;
+  ddef->ad_cells   = 0;
+  ddef->do_lazy_ad = FALSE;
 
   /* default thresholds */
   ddef->rt1           = 0.25;
@@ -113,6 +118,7 @@ p7_domaindef_Create(ESL_RANDOMNESS *r)
   ddef->max_diagdiff  = 4;
   ddef->min_posterior = 0.25;
   ddef->min_endpointp = 0.02;
+  ddef->ramlimit      = p7_CKPT_RAMLIMIT;
 
   /* allocate reusable, growable objects that domain def reuses for each seq */
   ddef->sp  = p7_spensemble_Create(1024, 64, 32); /* init allocs = # sampled pairs; max endpoint range; # of domains */
@@ -197,6 +203,7 @@ p7_domaindef_Reuse(P7_DOMAINDEF *ddef)
     {
       for (d = 0; d < ddef->ndom; d++) {
 	p7_alidisplay_Destroy(ddef->dcl[d].ad); ddef->dcl[d].ad             = NULL;
+	p7_alitrace_Destroy(ddef->dcl[d].atr);  ddef->dcl[d].atr            = NULL;
 	free(ddef->dcl[d].scores_per_pos);      ddef->dcl[d].scores_per_pos = NULL;
       }
       
@@ -294,6 +301,7 @@ p7_domaindef_Destroy(P7_DOMAINDEF *ddef)
     for (d = 0; d < ddef->ndom; d++) {
       if (ddef->dcl[d].scores_per_pos) free(ddef->dcl[d].scores_per_pos);
       p7_alidisplay_Destroy(ddef->dcl[d].ad);
+      p7_alitrace_Destroy(ddef->dcl[d].atr);
     }
     free(ddef->dcl);
   }
@@ -364,6 +372,12 @@ p7_domaindef_ByViterbi(P7_PROFILE *gm, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_
  *            using <fwd> and <bck> matrices as workspace for the
  *            necessary full-matrix DP calculations. Caller provides a
  *            new or reused <ddef> object to hold these results.
+ *            Regions and envelopes whose full matrices would be
+ *            bigger than <ddef->ramlimit> MB are done in checkpointed
+ *            matrices instead, in $O(M \sqrt{L})$ memory (not for
+ *            <long_target>; SSE implementation only). Their stochastic
+ *            traces are then sampled in batches, so they differ from
+ *            the full-matrix ones, though still reproducibly.
  *            A <bg> is provided for (possible) use in biased-composition
  *            score correction (used in nhmmer), and a boolean
  *            <long_target> argument is provided to allow nhmmer-
@@ -392,6 +406,7 @@ p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPRO
   int i2,j2;
   int last_j2;
   int nc;
+  int use_ckp;
   int saveL     = om->L;	/* Save the length config of <om>; will restore upon return */
   int save_mode = om->mode;	/* Likewise for the mode. */
   int status;
@@ -418,8 +433,19 @@ p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPRO
     else if (ddef->mocc[j] - (ddef->etot[j] - ddef->etot[j-1])  <  ddef->rt2)
     {
         /* We have a region i..j to evaluate. */
-        p7_omx_GrowTo(fwd, om->M, j-i+1, j-i+1);
-        p7_omx_GrowTo(bck, om->M, j-i+1, j-i+1);
+        use_ckp = use_checkpointed(ddef, om, j-i+1, long_target);
+        if (use_ckp)
+        {
+#if defined (eslENABLE_SSE)
+            p7_omx_GrowToCheckpointed(fwd, om->M, j-i+1);
+            p7_omx_GrowToCheckpointed(bck, om->M, j-i+1);
+#endif
+        }
+        else
+        {
+            p7_omx_GrowTo(fwd, om->M, j-i+1, j-i+1);
+            p7_omx_GrowTo(bck, om->M, j-i+1, j-i+1);
+        }
         ddef->nregions++;
         if (is_multidomain_region(ddef, i, j))
         {
@@ -438,7 +464,7 @@ p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPRO
             p7_oprofile_ReconfigMultihit(om, saveL);
             p7_Forward(sq->dsq+i-1, j-i+1, om, fwd, NULL);
 
-            region_trace_ensemble(ddef, om, sq->dsq, i, j, fwd, bck, &nc);
+            if ((status = region_trace_ensemble(ddef, om, sq->dsq, i, j, fwd, bck, use_ckp, &nc)) != eslOK) return status;
             p7_oprofile_ReconfigUnihit(om, saveL);
             /* ddef->n2sc is now set on i..j by the traceback-dependent method */
 
@@ -499,6 +525,25 @@ p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPRO
  *****************************************************************/
 
 
+/* use_checkpointed()
+ *
+ * Decide whether a region or envelope of <L> residues is to be
+ * done in checkpointed DP matrices, because full ones for <om> would
+ * be bigger than <ddef->ramlimit>. Only the SSE implementation has
+ * checkpointed matrices; nhmmer's <long_target> windows are short,
+ * and its envelope rescoring is not checkpointed.
+ */
+static int
+use_checkpointed(const P7_DOMAINDEF *ddef, const P7_OPROFILE *om, int L, int long_target)
+{
+#if defined (eslENABLE_SSE)
+  return (! long_target && p7_omx_FullMB(om->M, L) > ddef->ramlimit);
+#else
+  return FALSE;
+#endif
+}
+
+
 /* is_multidomain_region()
  * SRE, Fri Feb  8 11:35:04 2008 [Janelia]
  *
@@ -589,20 +634,25 @@ is_multidomain_region(P7_DOMAINDEF *ddef, int i, int j)
  *    answers, it needs to <esl_spensemble_Reuse()> it before calling
  *    <region_trace_ensemble()> again.
  *    
- * <ddef->tr> is used as working memory for sampled traces.
+ * Sampled traces are held in a batch allocated here, as many as
+ *    <ddef->ramlimit> allows.
  *    
  * <wrk> has had its zero row clobbered as working space for a null2 calculation.
  */
 static int
 region_trace_ensemble(P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *dsq, int ireg, int jreg, 
-		      const P7_OMX *fwd, P7_OMX *wrk, int *ret_nc)
+		      P7_OMX *fwd, P7_OMX *wrk, int use_ckp, int *ret_nc)
 {
+  P7_TRACE **trb = NULL;	/* batch of sampled traces */
+  P7_TRACE  *tr;
+  int    ntr;			/* number of traces in <trb> */
   int    Lr  = jreg-ireg+1;
-  int    t, d, d2;
+  int    t, b, nb, d, d2;
   int    nov, n;
   int    nc;
   int    pos;
   float  null2[p7_MAXCODE];
+  int    status;
 
   esl_vec_FSet(ddef->n2sc+ireg, Lr, 0.0); /* zero the null2 scores in region */
 
@@ -612,30 +662,63 @@ region_trace_ensemble(P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *
   if (ddef->do_reseeding) 
     esl_randomness_Init(ddef->r, esl_randomness_GetSeed(ddef->r));
 
+  /* Traces are sampled in batches, each batch in one pass over <fwd>;
+   * in a checkpointed <fwd>, each pass also costs a Forward
+   * calculation. Take as many samples per pass as the memory limit
+   * allows, at about 20 bytes per residue per trace.
+   */
+  ntr = ESL_MAX(1, ESL_MIN(ddef->nsamples, (int) (ddef->ramlimit * 1e6 / (20. * Lr))));
+  ESL_ALLOC(trb, sizeof(P7_TRACE *) * ntr);
+  for (b = 0; b < ntr; b++) trb[b] = NULL;
+  for (b = 0; b < ntr; b++) 
+    if ((trb[b] = p7_trace_Create()) == NULL) { status = eslEMEM; goto ERROR; }
+
   /* Collect an ensemble of sampled traces; calculate null2 odds ratios from these */
-  for (t = 0; t < ddef->nsamples; t++)
+  for (t = 0; t < ddef->nsamples; t += nb)
     {
-      p7_StochasticTrace(ddef->r, dsq+ireg-1, Lr, om, fwd, ddef->tr);
-      p7_trace_Index(ddef->tr);
+      nb = ESL_MIN(ntr, ddef->nsamples - t);
+      if (use_ckp) 
+	{
+#if defined (eslENABLE_SSE)
+	  if ((status = p7_StochasticTraceCheckpointed(ddef->r, dsq+ireg-1, Lr, om, fwd, trb, nb)) != eslOK) goto ERROR;
+#endif
+	}
+      else
+	{
+#if defined (eslENABLE_SSE)
+	  if ((status = p7_StochasticTraceBatch(ddef->r, dsq+ireg-1, Lr, om, fwd, trb, nb)) != eslOK) goto ERROR;
+#else
+	  for (b = 0; b < nb; b++) p7_StochasticTrace(ddef->r, dsq+ireg-1, Lr, om, fwd, trb[b]);
+#endif
+	}
 
-      pos = 1;
-      for (d = 0; d < ddef->tr->ndom; d++)
+      for (b = 0; b < nb; b++)
 	{
-	  p7_spensemble_Add(ddef->sp, t, ddef->tr->sqfrom[d]+ireg-1, ddef->tr->sqto[d]+ireg-1, ddef->tr->hmmfrom[d], ddef->tr->hmmto[d]);
+	  tr = trb[b];
+	  p7_trace_Index(tr);
 
-	  p7_Null2_ByTrace(om, ddef->tr, ddef->tr->tfrom[d], ddef->tr->tto[d], wrk, null2);
+	  pos = 1;
+	  for (d = 0; d < tr->ndom; d++)
+	    {
+	      p7_spensemble_Add(ddef->sp, t+b, tr->sqfrom[d]+ireg-1, tr->sqto[d]+ireg-1, tr->hmmfrom[d], tr->hmmto[d]);
+
+	      p7_Null2_ByTrace(om, tr, tr->tfrom[d], tr->tto[d], wrk, null2);
 	  
-	  /* residues outside domains get bumped +1: because f'(x) = f(x), so f'(x)/f(x) = 1 in these segments */
-	  for (; pos <= ddef->tr->sqfrom[d]; pos++) ddef->n2sc[ireg+pos-1] += 1.0;
+	      /* residues outside domains get bumped +1: because f'(x) = f(x), so f'(x)/f(x) = 1 in these segments */
+	      for (; pos <= tr->sqfrom[d]; pos++) ddef->n2sc[ireg+pos-1] += 1.0;
 
-	  /* Residues inside domains get bumped by their null2 ratio */
-	  for (; pos <= ddef->tr->sqto[d];   pos++) ddef->n2sc[ireg+pos-1] += null2[dsq[ireg+pos-1]];
-	}
-      /* the remaining residues in the region outside any domains get +1 */
-      for (; pos <= Lr; pos++)  ddef->n2sc[ireg+pos-1] += 1.0;
+	      /* Residues inside domains get bumped by their null2 ratio */
+	      for (; pos <= tr->sqto[d];   pos++) ddef->n2sc[ireg+pos-1] += null2[dsq[ireg+pos-1]];
+	    }
+	  /* the remaining residues in the region outside any domains get +1 */
+	  for (; pos <= Lr; pos++)  ddef->n2sc[ireg+pos-1] += 1.0;
 
-      p7_trace_Reuse(ddef->tr);        
+	  p7_trace_Reuse(tr);        
+	}
     }
+  for (b = 0; b < ntr; b++) p7_trace_Destroy(trb[b]);
+  free(trb);
+  trb = NULL;
 
   /* Convert the accumulated n2sc[] ratios in this region to log odds null2 scores on each residue. */
   for (pos = ireg; pos <= jreg; pos++)
@@ -675,6 +758,15 @@ region_trace_ensemble(P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *
   ddef->sp->nc = d;
   *ret_nc = d;
   return eslOK;
+
+ ERROR:
+  if (trb)
+    {
+      for (b = 0; b < ntr; b++) p7_trace_Destroy(trb[b]);
+      free(trb);
+    }
+  *ret_nc = 0;
+  return status;
 }
 
 
@@ -750,6 +842,32 @@ reparameterize_model (P7_BG *bg, P7_OPROFILE *om, const ESL_SQ *sq, int start, i
 }
 
 
+/* decode_and_align()
+ *
+ * Given full Forward and Backward matrices <ox1>,<ox2> for a domain
+ * envelope, overwrite <ox2> with posterior probabilities and <ox1>
+ * with OA scores, ready for <p7_OATrace(om, ox2, ox1, tr)>, and
+ * return the OA score in <*ret_oasc>. In SSE builds that's one fused
+ * pass over the rows, which also leaves the summed posteriors in row
+ * 0 of <ox2> for <p7_Null2_ByExpectedCounts()>; otherwise, it's
+ * <p7_Decoding()> then <p7_OptimalAccuracy()>.
+ *
+ * Returns <eslERANGE> on decoding overflow, as <p7_Decoding()> does.
+ */
+static int
+decode_and_align(const P7_OPROFILE *om, P7_OMX *ox1, P7_OMX *ox2, float *ret_oasc)
+{
+#if defined (eslENABLE_SSE)
+  return p7_DecodingOptimalAccuracy(om, ox1, ox2, ret_oasc);
+#else
+  int status;
+
+  if ((status = p7_Decoding(om, ox1, ox2, ox2)) != eslOK) return status;
+  return p7_OptimalAccuracy(om, ox2, ox1, ret_oasc);
+#endif
+}
+
+
 /* rescore_isolated_domain()
  * SRE, Fri Feb  8 09:18:33 2008 [Janelia]
  *
@@ -795,7 +913,9 @@ reparameterize_model (P7_BG *bg, P7_OPROFILE *om, const ESL_SQ *sq, int start, i
  * 
  * <ox1> : happens to be holding OA score matrix for the domain
  *         upon return, but that's not part of the spec; officially
- *         its contents are "undefined".
+ *         its contents are "undefined". It and <ox2> are grown
+ *         here, and may be left checkpointed, if the envelope is
+ *         too big for full matrices (see <ddef->ramlimit>).
  *
  * <ox2> : happens to be holding a posterior probability matrix
  *         for the domain upon return, but we're not making that
@@ -816,6 +936,8 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
 			P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr)
 {
   P7_DOMAIN     *dom           = NULL;
+  P7_OMX        *pp            = NULL;
+  P7_OMX        *oa            = NULL;
   int            Ld            = j-i+1;
   float          domcorrection = 0.0;
   float          envsc, oasc;
@@ -825,6 +947,8 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
   int            status;
   int            max_env_extra = 20;
   int            orig_L;
+  int64_t        iali = 0, jali = 0;
+  uint64_t       t0;
 
 
   if (long_target) {
@@ -840,20 +964,55 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
     reparameterize_model (bg, om, sq, i, j-i+1, fwd_emissions_arr, bg_tmp->f, scores_arr);
   }
 
-  p7_Forward (sq->dsq + i-1, Ld, om,      ox1, &envsc);
-  p7_Backward(sq->dsq + i-1, Ld, om, ox1, ox2, NULL);
+  if (use_checkpointed(ddef, om, Ld, long_target))
+    {
+#if defined (eslENABLE_SSE)
+      /* Checkpointed: posteriors and OA scores are recomputed a
+       * segment at a time, so they need their own checkpointed
+       * matrices, and <ox1>,<ox2> keep the Forward and Backward
+       * checkpoints. Null2 comes out of the same pass.
+       */
+      if ((pp = p7_omx_Create(om->M, 0, 0)) == NULL) { status = eslEMEM; goto ERROR; }
+      if ((oa = p7_omx_Create(om->M, 0, 0)) == NULL) { status = eslEMEM; goto ERROR; }
+      if ((status = p7_omx_GrowToCheckpointed(ox1, om->M, Ld)) != eslOK) goto ERROR;
+      if ((status = p7_omx_GrowToCheckpointed(ox2, om->M, Ld)) != eslOK) goto ERROR;
+      if ((status = p7_omx_GrowToCheckpointed(pp,  om->M, Ld)) != eslOK) goto ERROR;
+      if ((status = p7_omx_GrowToCheckpointed(oa,  om->M, Ld)) != eslOK) goto ERROR;
 
-  status = p7_Decoding(om, ox1, ox2, ox2);      /* <ox2> is now overwritten with post probabilities     */
-  if (status == eslERANGE) { /* rare: numeric overflow; domain is assumed to be repetitive garbage [J3/119-121] */
-    if (long_target && scores_arr) 
-      reparameterize_model(bg, om, NULL, 0, 0, fwd_emissions_arr, bg_tmp->f, scores_arr); /* revert to original bg model */
-    status = eslFAIL;
-    goto ERROR;
-  }
+      p7_Forward (sq->dsq + i-1, Ld, om,      ox1, &envsc);
+      p7_Backward(sq->dsq + i-1, Ld, om, ox1, ox2, NULL);
+
+      status = p7_OptimalAccuracyCheckpointed(sq->dsq + i-1, om, ox1, ox2, pp, oa, &oasc);
+      if      (status == eslERANGE) { status = eslFAIL; goto ERROR; } /* same numeric overflow as below [J3/119-121] */
+      else if (status != eslOK)     goto ERROR;
+      if ((status = p7_OATraceCheckpointed(sq->dsq + i-1, om, ox1, ox2, pp, oa, ddef->tr)) != eslOK) goto ERROR;
+
+      if (! null2_is_done) {
+        p7_Null2_ByExpectedCounts(om, pp, null2);
+        for (pos = i; pos <= j; pos++)
+          ddef->n2sc[pos]  = logf(null2[sq->dsq[pos]]);
+        null2_is_done = TRUE;
+      }
+#endif
+    }
+  else
+    {
+      p7_omx_GrowTo(ox1, om->M, Ld, Ld);
+      p7_omx_GrowTo(ox2, om->M, Ld, Ld);
 
-  /* Find an optimal accuracy alignment */
-  p7_OptimalAccuracy(om, ox2, ox1, &oasc);      /* <ox1> is now overwritten with OA scores              */
-  p7_OATrace        (om, ox2, ox1, ddef->tr);   /* <tr>'s seq coords are offset by i-1, rel to orig dsq */
+      p7_Forward (sq->dsq + i-1, Ld, om,      ox1, &envsc);
+      p7_Backward(sq->dsq + i-1, Ld, om, ox1, ox2, NULL);
+
+      /* Posterior decoding, and an optimal accuracy alignment */
+      status = decode_and_align(om, ox1, ox2, &oasc); /* <ox2> is now post probabilities, <ox1> OA scores */
+      if (status == eslERANGE) { /* rare: numeric overflow; domain is assumed to be repetitive garbage [J3/119-121] */
+        if (long_target && scores_arr) 
+          reparameterize_model(bg, om, NULL, 0, 0, fwd_emissions_arr, bg_tmp->f, scores_arr); /* revert to original bg model */
+        status = eslFAIL;
+        goto ERROR;
+      }
+      p7_OATrace(om, ox2, ox1, ddef->tr);          /* <tr>'s seq coords are offset by i-1, rel to orig dsq */
+    }
 
   /* hack the trace's sq coords to be correct w.r.t. original dsq */
   for (z = 0; z < ddef->tr->N; z++)
@@ -865,7 +1024,23 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
     ddef->nalloc *= 2;
   }
   dom = &(ddef->dcl[ddef->ndom]);
-  dom->ad             = p7_alidisplay_Create(ddef->tr, 0, om, sq, ntsq);
+  t0  = p7_pli_Clock();
+  if (ddef->do_lazy_ad && ! long_target && ntsq == NULL)
+    {  /* keep a compact copy; the caller makes displays only for domains it reports */
+      dom->ad  = NULL;
+      if ((dom->atr = p7_alitrace_Create(ddef->tr, 0, sq)) == NULL) { status = eslEMEM; goto ERROR; }
+      iali = dom->atr->sqfrom;
+      jali = dom->atr->sqto;
+    }
+  else
+    {
+      dom->atr = NULL;
+      if ((dom->ad = p7_alidisplay_Create(ddef->tr, 0, om, sq, ntsq)) == NULL) { status = eslEMEM; goto ERROR; }
+      ddef->ad_cells += dom->ad->N;
+      iali = dom->ad->sqfrom;
+      jali = dom->ad->sqto;
+    }
+  ddef->ad_ns        += p7_pli_Clock() - t0;
   dom->scores_per_pos = NULL;
 
 
@@ -898,7 +1073,7 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
       p7_Forward (sq->dsq + i-1, Ld, om,      ox1, &envsc);
       p7_Backward(sq->dsq + i-1, Ld, om, ox1, ox2, NULL);
 
-      status = p7_Decoding(om, ox1, ox2, ox2);      /* <ox2> is now overwritten with post probabilities     */
+      status = decode_and_align(om, ox1, ox2, &oasc); /* <ox2> is now post probabilities, <ox1> OA scores */
       if (status == eslERANGE) { /* rare: numeric overflow; domain is assumed to be repetitive garbage [J3/119-121] */
           reparameterize_model(bg, om, NULL, 0, 0, fwd_emissions_arr, bg_tmp->f, scores_arr); /* revert to original bg model */
           status = eslFAIL;
@@ -906,7 +1081,6 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
       }
 
       /* Find an optimal accuracy alignment */
-      p7_OptimalAccuracy(om, ox2, ox1, &oasc);      /* <ox1> is now overwritten with OA scores              */
       p7_trace_Reuse(ddef->tr);
       p7_OATrace        (om, ox2, ox1, ddef->tr);   /* <tr>'s seq coords are offset by i-1, rel to orig dsq */
 
@@ -946,7 +1120,11 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
      * do it now, by the expectation (posterior decoding) method.
      */
       if (!null2_is_done) {
+#if defined (eslENABLE_SSE)
+        p7_Null2_ByExpectedCounts(om, ox2, null2);  /* decode_and_align() summed the posteriors */
+#else
         p7_Null2_ByExpectation(om, ox2, null2);
+#endif
         for (pos = i; pos <= j; pos++)
           ddef->n2sc[pos]  = logf(null2[sq->dsq[pos]]);
       }
@@ -958,8 +1136,9 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
   }
 
 
-  dom->iali          = dom->ad->sqfrom;
-  dom->jali          = dom->ad->sqto;
+  if (long_target) { iali = dom->ad->sqfrom; jali = dom->ad->sqto; } /* <ad> may have been remade on a trimmed envelope */
+  dom->iali          = iali;
+  dom->jali          = jali;
   dom->ienv          = i;
   dom->jenv          = j;
   dom->envsc         = envsc;         /* in units of NATS */
@@ -974,10 +1153,14 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
   ddef->ndom++;
 
   p7_trace_Reuse(ddef->tr);
+  if (pp) p7_omx_Destroy(pp);
+  if (oa) p7_omx_Destroy(oa);
   return eslOK;
 
  ERROR:
   p7_trace_Reuse(ddef->tr);
+  if (pp) p7_omx_Destroy(pp);
+  if (oa) p7_omx_Destroy(oa);
   return status;
 }
   
@@ -111,6 +111,9 @@ extern void p7_hit_Destroy(P7_HIT *the_hit){
       if(the_hit->dcl[i].ad != NULL){
         p7_alidisplay_Destroy(the_hit->dcl[i].ad);
       }
+      if(the_hit->dcl[i].atr != NULL){
+        p7_alitrace_Destroy(the_hit->dcl[i].atr);
+      }
     }
   }
   
@@ -566,6 +569,7 @@ extern int p7_hit_Deserialize(const uint8_t *buf, uint32_t *n, P7_HIT *ret_obj){
   for(int i = 0; i < ret_obj->ndom; i++){
     ret_obj->dcl[i].scores_per_pos = NULL;  // set internal pointers to known values so that domain_Deserialize does the right thing
     ret_obj->dcl[i].ad = NULL;
+    ret_obj->dcl[i].atr = NULL;
     int ret_code = p7_domain_Deserialize(buf, n, &(ret_obj->dcl[i]));
     if (ret_code != eslOK){
       return ret_code;
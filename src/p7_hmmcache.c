@@ -1,4 +1,5 @@
-/* A cached profile database. Used by the hmmpgmd daemon.
+/* A cached profile database. Used by the hmmpgmd daemon, and by
+ * hmmscan --cache.
  * 
  * Contents:
  *   1. P7_HMMCACHE : a daemon's cached profile database.
@@ -14,6 +15,14 @@
 
 #include "hmmer.h"
 #include "p7_hmmcache.h"
+#ifdef HMMER_THREADS
+#include "esl_threads.h"
+#include "p7_hmmreader.h"
+#endif
+
+static int read_pressed (P7_HMMCACHE *cache, P7_HMMFILE *hfp, char *errbuf);
+static int read_flatfile(P7_HMMCACHE *cache, P7_HMMFILE *hfp, char *errbuf);
+static int add_profile  (P7_HMMCACHE *cache, P7_OPROFILE *om);
 
 /*****************************************************************
  * 1. P7_HMMCACHE: a daemon's cached profile database
@@ -29,6 +38,19 @@
  *            Caller may optionally provide an <errbuf> ptr to
  *            at least <eslERRBUFSIZE> bytes, to capture an 
  *            informative error message on failure. 
+ *
+ *            Where the system has <mmap()>, the pressed <.h3f> and
+ *            <.h3p> files are mapped and stay open with the cache,
+ *            and the cached profiles' scores point into them
+ *            (see <p7_hmmfile_MapPressed()>), so the cache takes
+ *            little memory of its own, and several processes caching
+ *            the same database share it in the page cache.
+ *
+ *            If <hmmfile> isn't pressed, its models are parsed,
+ *            configured and converted to optimized profiles on all
+ *            available cores (see <p7_hmmreader.c>), and cached in
+ *            file order, configured the way <hmmpress> would save
+ *            them.
  *            
  * Args:      hmmfile   - (base) name of profile file to open
  *            ret_cache - RETURN: cached profile database
@@ -52,7 +74,6 @@ p7_hmmcache_Open(char *hmmfile, P7_HMMCACHE **ret_cache, char *errbuf)
 {
   P7_HMMCACHE *cache    = NULL;
   P7_HMMFILE  *hfp      = NULL;        /* open HMM database file    */
-  P7_OPROFILE *om       = NULL;        /* target profile            */
   int          status;
   
   ESL_ALLOC(cache, sizeof(P7_HMMCACHE));
@@ -61,35 +82,134 @@ p7_hmmcache_Open(char *hmmfile, P7_HMMCACHE **ret_cache, char *errbuf)
   cache->list      = NULL;
   cache->lalloc    = 4096;	/* allocation chunk size for <list> of ptrs  */
   cache->n         = 0;
+  cache->hfp       = NULL;
 
   if ( ( status = esl_strdup(hmmfile, -1, &cache->name) != eslOK)) goto ERROR; 
   ESL_ALLOC(cache->list, sizeof(P7_OPROFILE *) * cache->lalloc);
 
   if ( (status = p7_hmmfile_OpenE(hmmfile, NULL, &hfp, errbuf)) != eslOK) goto ERROR;  // eslENOTFOUND | eslEFORMAT 
 
+  if (hfp->is_pressed) status = read_pressed (cache, hfp, errbuf);
+  else                 status = read_flatfile(cache, hfp, errbuf);
+  if (status != eslOK) goto ERROR;
+
+  //printf("\nfinal:: %d  memory %" PRId64 "\n", inx, total_mem);
+  if (hfp->fmap) cache->hfp = hfp;   /* profiles point into it: keep it open */
+  else           p7_hmmfile_Close(hfp);
+  *ret_cache = cache;
+  return eslOK;
+
+ ERROR:
+  if (cache) p7_hmmcache_Close(cache);
+  if (hfp)   p7_hmmfile_Close(hfp);
+  return status;
+}
+
+
+/* read_pressed()
+ * Cache the profiles of pressed database <hfp>, mapping its binary
+ * files if we can.
+ */
+static int
+read_pressed(P7_HMMCACHE *cache, P7_HMMFILE *hfp, char *errbuf)
+{
+  P7_OPROFILE *om = NULL;
+  int          status;
+
+  if ( (status = p7_hmmfile_MapPressed(hfp)) != eslOK) { if (errbuf) strncpy(errbuf, hfp->errbuf, eslERRBUFSIZE); return status; }
+
   while ((status = p7_oprofile_ReadMSV(hfp, &(cache->abc), &om)) == eslOK) /* eslEFORMAT | eslEINCOMPAT */
     {
       if (( status = p7_oprofile_ReadRest(hfp, om)) != eslOK) break; /* eslEFORMAT */
+      if (( status = add_profile(cache, om))        != eslOK) break; /* eslEMEM */
+      om = NULL;
+    }
+  if (om) p7_oprofile_Destroy(om);
+  if (status != eslEOF)  { if (errbuf) strncpy(errbuf, hfp->errbuf, eslERRBUFSIZE); return status; }
+  return eslOK;
+}
+
+/* read_flatfile()
+ * Cache the profiles of unpressed HMM file <hfp>: parse, configure
+ * and convert its models, in parallel if we can, else one at a
+ * time, configured as hmmpress would save them.
+ */
+static int
+read_flatfile(P7_HMMCACHE *cache, P7_HMMFILE *hfp, char *errbuf)
+{
+  P7_HMM       *hmm = NULL;
+  P7_BG        *bg  = NULL;
+  P7_PROFILE   *gm  = NULL;
+  P7_OPROFILE  *om  = NULL;
+  int           status;
+#ifdef HMMER_THREADS
+  P7_HMMREADER *rdr = NULL;
+  int           ncpus;
+
+  if ((ncpus = esl_threads_GetCPUCount()) > 0) 
+    {
+      status = p7_hmmreader_Open(hfp, &(cache->abc), ncpus, p7_HMMREADER_PROFILES, 0, &rdr);
+      if      (status == eslEFORMAT) { if (errbuf) strncpy(errbuf, hfp->errbuf, eslERRBUFSIZE); return status; }
+      else if (status == eslEOF)     return eslOK;
+      else if (status != eslOK && status != eslEINCOMPAT) return status;
+    }
+  if (rdr)
+    {
+      while ((status = p7_hmmreader_Read(rdr, NULL, &om)) == eslOK) /* eslEFORMAT | eslEINCOMPAT */
+	{
+	  if (( status = add_profile(cache, om)) != eslOK) { p7_oprofile_Destroy(om); break; }
+	}
+      if (status != eslEOF && errbuf) strncpy(errbuf, rdr->errbuf, eslERRBUFSIZE);
+      p7_hmmreader_Close(rdr);
+      return (status == eslEOF ? eslOK : status);
+    }
+#endif /*HMMER_THREADS*/
 
-      if (cache->n >= cache->lalloc) {
-	ESL_REALLOC(cache->list, sizeof(char *) * cache->lalloc * 2);
-	cache->lalloc *= 2;
+  while ((status = p7_hmmfile_Read(hfp, &(cache->abc), &hmm)) == eslOK) /* eslEFORMAT | eslEINCOMPAT */
+    {
+      if (bg == NULL) {
+	if ((bg = p7_bg_Create(cache->abc)) == NULL) { status = eslEMEM; goto ERROR; }
+	p7_bg_SetLength(bg, 400);
       }
-      
-      cache->list[cache->n++] = om;
+      if ((gm = p7_profile_Create (hmm->M, hmm->abc))  == NULL)  { status = eslEMEM; goto ERROR; }
+      if ((om = p7_oprofile_Create(hmm->M, hmm->abc))  == NULL)  { status = eslEMEM; goto ERROR; }
+      if ((status = p7_ProfileConfig(hmm, bg, gm, 400, p7_LOCAL)) != eslOK) goto ERROR;
+      if ((status = p7_oprofile_Convert(gm, om))                   != eslOK) goto ERROR;
+      if ((status = add_profile(cache, om))                        != eslOK) goto ERROR;
       om = NULL;
+
+      p7_profile_Destroy(gm);  gm  = NULL;
+      p7_hmm_Destroy(hmm);     hmm = NULL;
     }
-  if (status != eslEOF)  { strncpy(errbuf, hfp->errbuf, eslERRBUFSIZE); goto ERROR; }
+  if (status != eslEOF)  { if (errbuf) strncpy(errbuf, hfp->errbuf, eslERRBUFSIZE); goto ERROR; }
 
-  //printf("\nfinal:: %d  memory %" PRId64 "\n", inx, total_mem);
-  p7_hmmfile_Close(hfp);
-  *ret_cache = cache;
+  if (bg) p7_bg_Destroy(bg);
+  return eslOK;
+
+ ERROR:
+  if (om)  p7_oprofile_Destroy(om);
+  if (gm)  p7_profile_Destroy(gm);
+  if (hmm) p7_hmm_Destroy(hmm);
+  if (bg)  p7_bg_Destroy(bg);
+  return status;
+}
+
+/* add_profile()
+ * Append <om> to the cache's list, which takes it over.
+ */
+static int
+add_profile(P7_HMMCACHE *cache, P7_OPROFILE *om)
+{
+  int status;
+
+  if (cache->n >= cache->lalloc) {
+    ESL_REALLOC(cache->list, sizeof(char *) * cache->lalloc * 2);
+    cache->lalloc *= 2;
+  }
+  cache->list[cache->n++] = om;
   return eslOK;
 
  ERROR:
-  if (cache) p7_hmmcache_Close(cache);
-  if (om)    p7_oprofile_Destroy(om);
-  if (hfp)   p7_hmmfile_Close(hfp);
   return status;
 }
 
@@ -162,9 +282,41 @@ p7_hmmcache_Close(P7_HMMCACHE *cache)
 	p7_oprofile_Destroy(cache->list[i]);
       free(cache->list);
     }
+  if (cache->hfp) p7_hmmfile_Close(cache->hfp); /* after the profiles that point into it */
   free(cache);
 }
 
+
+/* Function:  p7_hmmcache_ReadBlock()
+ * Synopsis:  Hand out the next block of cached profiles.
+ *
+ * Purpose:   Fill <block> with the profiles of <cache> starting at
+ *            <*next>, as many as it holds, and bump <*next> past
+ *            them; start <*next> at 0 to go through the cache from
+ *            the beginning. The counterpart of
+ *            <p7_oprofile_ReadBlockMSV()>, with no reading at all:
+ *            the profiles are complete, so the pipeline doesn't need
+ *            an <hfp> to read the rest of them.
+ *
+ *            The block only borrows the profiles, which still belong
+ *            to the cache. Caller sets <block->list[]> to <NULL>
+ *            when it is done with them, before the block is filled
+ *            again by a file or destroyed.
+ *
+ * Returns:   <eslOK> on success; <eslEOF> if there are no more
+ *            profiles, and <block->count> is 0.
+ */
+int
+p7_hmmcache_ReadBlock(P7_HMMCACHE *cache, uint32_t *next, P7_OM_BLOCK *block)
+{
+  int n = 0;
+
+  while (n < block->listSize && *next < cache->n)
+    block->list[n++] = cache->list[(*next)++];
+  block->count = n;
+  return (n > 0 ? eslOK : eslEOF);
+}
+
 /*****************************************************************
  * 2. Benchmark driver
  *****************************************************************/
@@ -1,4 +1,4 @@
-/* A cached profile database. Used by the hmmpgmd daemon.
+/* A cached profile database. Used by the hmmpgmd daemon, and by hmmscan --cache.
  */
 #ifndef P7_HMMCACHE_INCLUDED
 #define P7_HMMCACHE_INCLUDED
@@ -13,12 +13,15 @@ typedef struct {
   P7_OPROFILE       **list;        /* list of profiles [0 .. n-1]           */
   uint32_t            lalloc;	   /* allocated length of <list>            */
   uint32_t            n;           /* number of entries in <list>           */
+
+  P7_HMMFILE         *hfp;         /* mapped pressed db the profiles point into, or NULL */
 } P7_HMMCACHE;
 
 extern int    p7_hmmcache_Open (char *hmmfile, P7_HMMCACHE **ret_cache, char *errbuf);
 extern size_t p7_hmmcache_Sizeof         (P7_HMMCACHE *cache);
 extern int    p7_hmmcache_SetNumericNames(P7_HMMCACHE *cache);
 extern void   p7_hmmcache_Close          (P7_HMMCACHE *cache);
+extern int    p7_hmmcache_ReadBlock      (P7_HMMCACHE *cache, uint32_t *next, P7_OM_BLOCK *block);
 
 #endif /*P7_HMMCACHE_INCLUDED*/
 
@@ -180,6 +180,18 @@ extern int p7_hmmd_search_stats_Serialize(const HMMD_SEARCH_STATS *obj, uint8_t
   memcpy((void *) ptr, (void *) &network_64bit, sizeof(obj->n_past_fwd));
   ptr += sizeof(obj->n_past_fwd);
 
+  // Stage timing: stage_ns[], then stage_cells[]
+  for(int s = 0; s < p7_PLI_NSTAGES; s++){
+    network_64bit = esl_hton64(obj->stage_ns[s]);
+    memcpy((void *) ptr, (void *) &network_64bit, sizeof(uint64_t));
+    ptr += sizeof(uint64_t);
+  }
+  for(int s = 0; s < p7_PLI_NSTAGES; s++){
+    network_64bit = esl_hton64(obj->stage_cells[s]);
+    memcpy((void *) ptr, (void *) &network_64bit, sizeof(uint64_t));
+    ptr += sizeof(uint64_t);
+  }
+
   // Fourteenth field: nhits
   network_64bit = esl_hton64(obj->nhits); 
   memcpy((void *) ptr, (void *) &network_64bit, sizeof(obj->nhits));
@@ -341,6 +353,18 @@ extern int p7_hmmd_search_stats_Deserialize(const uint8_t *buf, uint32_t *n, HMM
   ret_obj->n_past_fwd = esl_ntoh64(network_64bit);
   ptr += sizeof(uint64_t);
 
+  // Stage timing: stage_ns[], then stage_cells[]
+  for(int s = 0; s < p7_PLI_NSTAGES; s++){
+    memcpy(&network_64bit, ptr, sizeof(uint64_t));
+    ret_obj->stage_ns[s] = esl_ntoh64(network_64bit);
+    ptr += sizeof(uint64_t);
+  }
+  for(int s = 0; s < p7_PLI_NSTAGES; s++){
+    memcpy(&network_64bit, ptr, sizeof(uint64_t));
+    ret_obj->stage_cells[s] = esl_ntoh64(network_64bit);
+    ptr += sizeof(uint64_t);
+  }
+
   //Fourteenth field: nhits
   memcpy(&network_64bit, ptr, sizeof(uint64_t)); // Grab the bytes out of the buffer
   ret_obj->nhits = esl_ntoh64(network_64bit);
@@ -458,6 +482,12 @@ static int hmmd_search_stats_Same(const HMMD_SEARCH_STATS *first, const HMMD_SEA
     return eslFAIL;
   }
 
+  for(int s = 0; s < p7_PLI_NSTAGES; s++){
+    if((first->stage_ns[s] != second->stage_ns[s]) || (first->stage_cells[s] != second->stage_cells[s])){
+      return eslFAIL;
+    }
+  }
+
   if(first->nhits != second->nhits){
     return eslFAIL;
   }
@@ -542,6 +572,10 @@ utest_serialize()
       serial[i].n_past_bias = rand();
       serial[i].n_past_vit  = rand();
       serial[i].n_past_fwd  = rand();
+      for(j = 0; j < p7_PLI_NSTAGES; j++){
+	serial[i].stage_ns[j]    = (((uint64_t) rand()) << 32) + ((uint64_t) rand());
+	serial[i].stage_cells[j] = (((uint64_t) rand()) << 32) + ((uint64_t) rand());
+      }
       serial[i].nhits       = rand() % 10000; // keep the size of the hit_offsets array reasonable
       serial[i].nreported   = rand();
       serial[i].nincluded   = rand();
@@ -20,6 +20,9 @@
 #ifdef HMMER_THREADS
 #include <pthread.h>
 #endif
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 
 #include "easel.h"
 #include "esl_alphabet.h"
@@ -230,6 +233,10 @@ p7_hmmfile_OpenBuffer(const char *buffer, int size, P7_HMMFILE **ret_hfp)
   hfp->efp          = NULL;
   hfp->ffp          = NULL;
   hfp->pfp          = NULL;
+  hfp->fmap         = NULL;
+  hfp->pmap         = NULL;
+  hfp->fmapsize     = 0;
+  hfp->pmapsize     = 0;
   hfp->ssi          = NULL;
   hfp->errbuf[0]    = '\0';
 
@@ -300,6 +307,10 @@ open_engine(const char *filename, char *env, P7_HMMFILE **ret_hfp, int do_ascii_
   hfp->efp          = NULL;
   hfp->ffp          = NULL;
   hfp->pfp          = NULL;
+  hfp->fmap         = NULL;
+  hfp->pmap         = NULL;
+  hfp->fmapsize     = 0;
+  hfp->pmapsize     = 0;
   hfp->ssi          = NULL;
   hfp->errbuf[0]    = '\0';
 
@@ -486,6 +497,10 @@ p7_hmmfile_Close(P7_HMMFILE *hfp)
   if (hfp->do_gzip && hfp->f != NULL)    pclose(hfp->f);
 #endif
   if (!hfp->do_gzip && !hfp->do_stdin && hfp->f != NULL) fclose(hfp->f);
+#ifdef HAVE_MMAP
+  if (hfp->fmap  != NULL) munmap(hfp->fmap, hfp->fmapsize);
+  if (hfp->pmap  != NULL) munmap(hfp->pmap, hfp->pmapsize);
+#endif
   if (hfp->ffp   != NULL) fclose(hfp->ffp);
   if (hfp->pfp   != NULL) fclose(hfp->pfp);
   if (hfp->fname != NULL) free(hfp->fname);
@@ -526,6 +541,75 @@ p7_hmmfile_CreateLock(P7_HMMFILE *hfp)
   return eslFAIL;
 }
 #endif
+
+/* Function:  p7_hmmfile_MapPressed()
+ * Synopsis:  Map the binary profile files of a pressed database.
+ *
+ * Purpose:   Map the <.h3f> and <.h3p> files of an open pressed
+ *            HMM database <hfp> read-only into memory. After this,
+ *            <p7_oprofile_ReadMSV()> and <p7_oprofile_ReadRest()>
+ *            don't read and copy each optimized profile; they return
+ *            profiles whose scores point straight into the mapped
+ *            files, so they start up faster, and several processes
+ *            searching the same database share one copy of it in the
+ *            page cache.
+ *
+ *            Those profiles can't outlive <hfp>, and their scores
+ *            can't be modified, so this is only for programs that
+ *            don't (hmmscan does; nhmmscan, which rescores its
+ *            profiles with a local background composition, doesn't).
+ *            Call it right after opening <hfp>, before reading any
+ *            profiles.
+ *
+ *            Does nothing if <hfp> isn't a pressed database, if the
+ *            files are already mapped, if they were pressed in the
+ *            older, unaligned 3/f format, or if the system has no
+ *            <mmap()>; then the profiles are read as usual.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ *            <eslESYS> if a file can't be sized or mapped; then
+ *            <hfp->errbuf> has an informative message, and <hfp> is
+ *            still open, unmapped.
+ */
+int
+p7_hmmfile_MapPressed(P7_HMMFILE *hfp)
+{
+#ifdef HAVE_MMAP
+  off_t fpos, fsize, psize;
+  int   status;
+
+  hfp->errbuf[0] = '\0';
+  if (hfp->ffp == NULL || hfp->pfp == NULL || hfp->fmap != NULL) return eslOK;
+
+  /* find the sizes, leaving the .h3f where the next ReadMSV() expects it */
+  if ((fpos = ftello(hfp->ffp)) < 0)                                 ESL_XFAIL(eslESYS, hfp->errbuf, "failed to find offset in .h3f file");
+  if (fseeko(hfp->ffp, 0, SEEK_END) != 0 || (fsize = ftello(hfp->ffp)) < 0) ESL_XFAIL(eslESYS, hfp->errbuf, "failed to find size of .h3f file");
+  if (fseeko(hfp->ffp, fpos, SEEK_SET) != 0)                         ESL_XFAIL(eslESYS, hfp->errbuf, "failed to reposition .h3f file");
+  if (fseeko(hfp->pfp, 0, SEEK_END) != 0 || (psize = ftello(hfp->pfp)) < 0) ESL_XFAIL(eslESYS, hfp->errbuf, "failed to find size of .h3p file");
+  if (fsize == 0 || psize == 0) return eslOK; /* nothing to map; reading finds the empty database as usual */
+#if defined (eslENABLE_SSE)
+  if (! p7_oprofile_IsAligned(hfp)) return eslOK; /* pressed in 3/f format by an older HMMER: read as usual */
+#endif
+
+  hfp->fmap = mmap(NULL, fsize, PROT_READ, MAP_SHARED, fileno(hfp->ffp), 0);
+  if (hfp->fmap == MAP_FAILED) { hfp->fmap = NULL; ESL_XFAIL(eslESYS, hfp->errbuf, "failed to map .h3f file into memory"); }
+  hfp->fmapsize = fsize;
+
+  hfp->pmap = mmap(NULL, psize, PROT_READ, MAP_SHARED, fileno(hfp->pfp), 0);
+  if (hfp->pmap == MAP_FAILED) { hfp->pmap = NULL; ESL_XFAIL(eslESYS, hfp->errbuf, "failed to map .h3p file into memory"); }
+  hfp->pmapsize = psize;
+  return eslOK;
+
+ ERROR:
+  if (hfp->fmap) munmap(hfp->fmap, hfp->fmapsize);
+  hfp->fmap     = NULL;
+  hfp->fmapsize = 0;
+  return status;
+#else
+  return eslOK;
+#endif
+}
 /*----------------- end, P7_HMMFILE object ----------------------*/
 
 
@@ -0,0 +1,735 @@
+/* Parallel parsing of a profile HMM file.
+ *
+ * Reading a large profile database (Pfam, say) with
+ * p7_hmmfile_Read() is serial: one thread parses every model, and
+ * programs that load a whole database before they start (hmmpgmd's
+ * cache of an unpressed database, hmmstat, hmmconvert, hmmfetch
+ * without an index) wait on it. A P7_HMMREADER splits the file into
+ * chunks at record boundaries, and several parser threads, each with
+ * its own open P7_HMMFILE, parse chunks into models, and optionally
+ * configure and convert them to optimized profiles too. The consumer
+ * gets the models back in file order with p7_hmmreader_Read(), which
+ * works like p7_hmmfile_Read(); the output doesn't depend on how many
+ * parsers there were.
+ *
+ * Chunk boundaries come from the file itself for ASCII files (a
+ * record ends with a line starting with "//"), or from the SSI index
+ * for binary ones, such as a pressed .h3m file. A file that can't be
+ * split (compressed, standard input, or binary without an index)
+ * can't be read this way, and the caller reads it the usual way.
+ *
+ * Parsers run at most 2 nreaders chunks ahead of the consumer, so the
+ * memory used is bounded by the chunk size, not by the file size.
+ *
+ * This is the P7_SEQREADER of p7_seqreader.c, for models.
+ *
+ * Contents:
+ *   1. P7_HMMREADER: opening a file and splitting it into chunks.
+ *   2. Parsing and reading.
+ *   3. Unit tests.
+ *   4. Test driver.
+ */
+#include "p7_config.h"
+
+#ifdef HMMER_THREADS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_ssi.h"
+
+#include "hmmer.h"
+#include "p7_hmmreader.h"
+
+static int   record_boundary(FILE *fp, off_t pos, off_t *ret_off);
+static int   ssi_boundaries(P7_HMMREADER *rdr, ESL_SSI *ssi, off_t fsize, int nchunks);
+static int   cmp_off(const void *a, const void *b);
+static void *parse_thread(void *arg);
+
+
+/*****************************************************************
+ * 1. P7_HMMREADER: opening a file and splitting it into chunks.
+ *****************************************************************/
+
+/* Function:  p7_hmmreader_Open()
+ * Synopsis:  Start parsing an HMM file in parallel.
+ *
+ * Purpose:   Read the HMM file that <hfp> has open with <nreaders>
+ *            parser threads, and start them. The file is split into
+ *            chunks of about <chunksize> bytes
+ *            (<p7_HMMREADER_CHUNKSIZE>, if <chunksize> is 0), and
+ *            into at least <4 nreaders> chunks.
+ *
+ *            <what> says what the parsers make of each model:
+ *            <p7_HMMREADER_HMMS> for the <P7_HMM> itself,
+ *            <p7_HMMREADER_PROFILES> for its optimized profile,
+ *            configured in local mode for a target length of 400
+ *            with a default null model (as <hmmpress> saves it), or
+ *            both OR'ed together.
+ *
+ *            <hfp> itself isn't used to read models; the parsers
+ *            open the file again, with its name. It should be
+ *            freshly opened, and the caller can go on reading it
+ *            independently, or close it.
+ *
+ *            As with <p7_hmmfile_Read()>, if <*byp_abc> is <NULL>,
+ *            the alphabet is set from the first model in the file,
+ *            and returned in <*byp_abc> for the caller to free; else
+ *            it's the alphabet the models are expected to be in,
+ *            and a model in a different one is an <eslEINCOMPAT>
+ *            error when it's read.
+ *
+ * Returns:   <eslOK> on success, and <*ret_rdr> is the new reader.
+ *
+ *            <eslEINCOMPAT> if the file can't be split: it's
+ *            compressed, or is standard input, or is binary and has
+ *            no SSI index. <*ret_rdr> is <NULL>; the caller reads
+ *            <hfp> the usual way.
+ *
+ *            <eslEOF> if the file has no models, and <eslEFORMAT>
+ *            if its first model can't be parsed when its alphabet is
+ *            needed; <*ret_rdr> is <NULL>, and <hfp->errbuf> has a
+ *            message for <eslEFORMAT>.
+ *
+ * Throws:    <eslEMEM> on allocation failure; <eslESYS> on a system
+ *            call or thread initialization failure.
+ */
+int
+p7_hmmreader_Open(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, int nreaders, int what, off_t chunksize, P7_HMMREADER **ret_rdr)
+{
+  P7_HMMREADER *rdr   = NULL;
+  P7_HMMFILE   *hfp1  = NULL;
+  FILE         *fp    = NULL;
+  off_t         fsize;
+  off_t         b;
+  int           nchunks;
+  int           c, i;
+  int           status;
+
+  *ret_rdr = NULL;
+  if (hfp->do_stdin || hfp->do_gzip)         return eslEINCOMPAT;
+  if (hfp->efp == NULL && hfp->ssi == NULL)  return eslEINCOMPAT;
+
+  /* The parsers share one alphabet; if we don't have it yet, the first model sets it. */
+  if (*byp_abc == NULL)
+    {
+      if (p7_hmmfile_OpenENoDB(hfp->fname, NULL, &hfp1, NULL) != eslOK) return eslEINCOMPAT;
+      status = p7_hmmfile_Read(hfp1, byp_abc, NULL);
+      if (status == eslEFORMAT) strcpy(hfp->errbuf, hfp1->errbuf);
+      p7_hmmfile_Close(hfp1);
+      if (status != eslOK) return status;
+    }
+
+  ESL_ALLOC(rdr, sizeof(P7_HMMREADER));
+  rdr->hmmfile   = NULL;
+  rdr->abc       = *byp_abc;
+  rdr->nreaders  = ESL_MAX(nreaders, 1);
+  rdr->what      = what;
+  rdr->coff      = NULL;
+  rdr->nchunks   = 0;
+  rdr->chunk     = NULL;
+  rdr->tid       = NULL;
+  rdr->nthreads  = 0;
+  rdr->nextc     = 0;
+  rdr->curc      = 0;
+  rdr->abort     = FALSE;
+  rdr->errbuf[0] = '\0';
+
+  if ((status = esl_strdup(hfp->fname, -1, &(rdr->hmmfile))) != eslOK) goto ERROR;
+  if (pthread_mutex_init(&rdr->mutex, NULL) != 0) ESL_XEXCEPTION(eslESYS, "mutex init failed");
+  if (pthread_cond_init (&rdr->cond,  NULL) != 0) ESL_XEXCEPTION(eslESYS, "cond init failed");
+
+  if ((fp = fopen(rdr->hmmfile, "rb")) == NULL)    { status = eslEINCOMPAT; goto ERROR; }
+  if (fseeko(fp, 0, SEEK_END) != 0)                ESL_XEXCEPTION(eslESYS, "fseeko() failed");
+  if ((fsize = ftello(fp)) < 0)                    ESL_XEXCEPTION(eslESYS, "ftello() failed");
+
+  if (chunksize <= 0) chunksize = p7_HMMREADER_CHUNKSIZE;
+  nchunks = ESL_MAX(4 * rdr->nreaders, (fsize + chunksize - 1) / chunksize);
+  ESL_ALLOC(rdr->coff, sizeof(off_t) * (nchunks + 1));
+
+  if (hfp->efp != NULL)
+    {
+      rdr->coff[0] = 0;
+      rdr->nchunks = 1;
+      for (c = 1; c < nchunks; c++)
+	{
+	  if ((status = record_boundary(fp, fsize / nchunks * c, &b)) != eslOK) goto ERROR;
+	  if (b >= fsize) break;
+	  if (b > rdr->coff[rdr->nchunks-1]) rdr->coff[rdr->nchunks++] = b;
+	}
+      rdr->coff[rdr->nchunks] = fsize;
+    }
+  else if ((status = ssi_boundaries(rdr, hfp->ssi, fsize, nchunks)) != eslOK) goto ERROR;
+
+  fclose(fp);
+  fp = NULL;
+
+  ESL_ALLOC(rdr->chunk, sizeof(P7_HMMCHUNK) * rdr->nchunks);
+  for (c = 0; c < rdr->nchunks; c++)
+    {
+      rdr->chunk[c].hmm       = NULL;
+      rdr->chunk[c].om        = NULL;
+      rdr->chunk[c].n         = 0;
+      rdr->chunk[c].nalloc    = 0;
+      rdr->chunk[c].next      = 0;
+      rdr->chunk[c].done      = FALSE;
+      rdr->chunk[c].status    = eslOK;
+      rdr->chunk[c].errbuf[0] = '\0';
+    }
+
+  ESL_ALLOC(rdr->tid, sizeof(pthread_t) * rdr->nreaders);
+  for (i = 0; i < rdr->nreaders; i++)
+    {
+      if (pthread_create(&(rdr->tid[i]), NULL, parse_thread, rdr) != 0) ESL_XEXCEPTION(eslESYS, "failed to create parser thread");
+      rdr->nthreads++;
+    }
+
+  *ret_rdr = rdr;
+  return eslOK;
+
+ ERROR:
+  if (fp) fclose(fp);
+  p7_hmmreader_Close(rdr);
+  return status;
+}
+
+/* Function:  p7_hmmreader_Close()
+ * Synopsis:  Stop parsing and free a parallel HMM reader.
+ *
+ * Purpose:   Stop <rdr>'s parsers, whether or not the consumer read
+ *            to the end of the file, wait for them to exit, and free
+ *            <rdr> and any models that nobody read.
+ */
+void
+p7_hmmreader_Close(P7_HMMREADER *rdr)
+{
+  P7_HMMCHUNK *ch;
+  int          c, i;
+
+  if (rdr == NULL) return;
+
+  if (rdr->nthreads > 0)
+    {
+      pthread_mutex_lock(&rdr->mutex);
+      rdr->abort = TRUE;
+      pthread_cond_broadcast(&rdr->cond);
+      pthread_mutex_unlock(&rdr->mutex);
+      for (i = 0; i < rdr->nthreads; i++) pthread_join(rdr->tid[i], NULL);
+    }
+
+  if (rdr->chunk)
+    {
+      for (c = 0; c < rdr->nchunks; c++)
+	{
+	  ch = &(rdr->chunk[c]);
+	  for (i = ch->next; i < ch->n; i++)
+	    {
+	      if (ch->hmm[i]) p7_hmm_Destroy(ch->hmm[i]);
+	      if (ch->om[i])  p7_oprofile_Destroy(ch->om[i]);
+	    }
+	  free(ch->hmm);
+	  free(ch->om);
+	}
+      free(rdr->chunk);
+    }
+  free(rdr->tid);
+  free(rdr->coff);
+  free(rdr->hmmfile);
+  pthread_mutex_destroy(&rdr->mutex);
+  pthread_cond_destroy(&rdr->cond);
+  free(rdr);
+}
+
+/* record_boundary()
+ * Find the first record of ASCII HMM file <fp> that starts at or
+ * after byte <pos>: the line after the first line at or after <pos>
+ * that starts with "//". Return its offset in <*ret_off>, or the
+ * file size if there is none.
+ */
+static int
+record_boundary(FILE *fp, off_t pos, off_t *ret_off)
+{
+  int   prev, c;
+  int   state = 0;  /* 0 = elsewhere; 1 = seen '/' at line start; 2 = in a "//" line */
+  off_t off;
+
+  if (pos == 0) { *ret_off = 0; return eslOK; }
+
+  if (fseeko(fp, pos - 1, SEEK_SET) != 0) ESL_EXCEPTION(eslESYS, "fseeko() failed");
+  prev = getc(fp);
+  for (off = pos; (c = getc(fp)) != EOF; off++)
+    {
+      if      (state == 2) { if (c == '\n') { off++; break; } }
+      else if (state == 1) state = (c == '/' ? 2 : 0);
+      else if (c == '/' && prev == '\n') state = 1;
+      prev = c;
+    }
+  *ret_off = off;
+  return eslOK;
+}
+
+/* ssi_boundaries()
+ * Set <rdr>'s chunks from the file's open SSI index <ssi>: the
+ * record offsets of <nchunks> keys, evenly spaced in the index. The
+ * index is sorted by name, so these are a scatter of records through
+ * the file; sorted, they split it into chunks of roughly equal
+ * numbers of models. Returns <eslEINCOMPAT> if the index isn't
+ * usable.
+ */
+static int
+ssi_boundaries(P7_HMMREADER *rdr, ESL_SSI *ssi, off_t fsize, int nchunks)
+{
+  uint16_t  fh;
+  off_t     roff;
+  int       c, n;
+  int       status;
+
+  if (ssi->nfiles != 1 || ssi->nprimary == 0) return eslEINCOMPAT;
+
+  nchunks = ESL_MIN(nchunks, ssi->nprimary);
+  rdr->coff[0] = 0;
+  for (c = 1; c < nchunks; c++)
+    {
+      if ((status = esl_ssi_FindNumber(ssi, ssi->nprimary / nchunks * c, &fh, &roff, NULL, NULL, NULL)) != eslOK) return eslEINCOMPAT;
+      rdr->coff[c] = roff;
+    }
+  qsort(rdr->coff, nchunks, sizeof(off_t), cmp_off);
+
+  for (n = 1, c = 1; c < nchunks; c++)
+    if (rdr->coff[c] > rdr->coff[n-1] && rdr->coff[c] < fsize) rdr->coff[n++] = rdr->coff[c];
+  rdr->nchunks = n;
+  rdr->coff[n] = fsize;
+  return eslOK;
+}
+
+static int
+cmp_off(const void *a, const void *b)
+{
+  off_t x = *(const off_t *) a;
+  off_t y = *(const off_t *) b;
+  return (x > y) - (x < y);
+}
+/*------------------- end, P7_HMMREADER -------------------------*/
+
+
+
+/*****************************************************************
+ * 2. Parsing and reading.
+ *****************************************************************/
+
+/* Function:  p7_hmmreader_Read()
+ * Synopsis:  Get the next model, in file order.
+ *
+ * Purpose:   Get the next model of the file: the HMM in <*opt_hmm>
+ *            and its optimized profile in <*opt_om>, of whichever
+ *            the reader was opened to make. Either may be <NULL> if
+ *            the caller doesn't want it; what it doesn't take is
+ *            freed. The caller frees the ones it gets.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ *            <eslEOF> at the end of the file.
+ *
+ *            <eslEFORMAT>, <eslEINCOMPAT>, or another error code if
+ *            a parser failed at this point of the file;
+ *            <rdr->errbuf> has its message.
+ *
+ * Throws:    <eslESYS> if the mutex or condition variable fails.
+ */
+int
+p7_hmmreader_Read(P7_HMMREADER *rdr, P7_HMM **opt_hmm, P7_OPROFILE **opt_om)
+{
+  P7_HMMCHUNK *ch;
+  P7_HMM      *hmm = NULL;
+  P7_OPROFILE *om  = NULL;
+  int          status;
+
+  if (pthread_mutex_lock(&rdr->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex lock failed");
+
+  for (;;)
+    {
+      if (rdr->curc == rdr->nchunks) { status = eslEOF; break; }
+      ch = &(rdr->chunk[rdr->curc]);
+
+      if (ch->next < ch->n)
+	{
+	  hmm = ch->hmm[ch->next];
+	  om  = ch->om[ch->next];
+	  ch->hmm[ch->next] = NULL;
+	  ch->om[ch->next]  = NULL;
+	  ch->next++;
+	  status = eslOK;
+	  break;
+	}
+
+      if (ch->done)
+	{
+	  if (ch->status != eslOK)
+	    {
+	      strcpy(rdr->errbuf, ch->errbuf);
+	      status = ch->status;
+	      break;
+	    }
+	  rdr->curc++;
+	  if (pthread_cond_broadcast(&rdr->cond) != 0) ESL_EXCEPTION(eslESYS, "cond broadcast failed");
+	  continue;
+	}
+
+      if (pthread_cond_wait(&rdr->cond, &rdr->mutex) != 0) ESL_EXCEPTION(eslESYS, "cond wait failed");
+    }
+
+  if (pthread_mutex_unlock(&rdr->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex unlock failed");
+
+  if (opt_hmm) *opt_hmm = hmm; else if (hmm) p7_hmm_Destroy(hmm);
+  if (opt_om)  *opt_om  = om;  else if (om)  p7_oprofile_Destroy(om);
+  return status;
+}
+
+
+/* put_model()
+ * A parser has read <hmm> and/or <om>: add them to the end of chunk
+ * <c>. Set <*ret_stop> if the reader is being closed.
+ */
+static int
+put_model(P7_HMMREADER *rdr, int c, P7_HMM *hmm, P7_OPROFILE *om, int *ret_stop)
+{
+  P7_HMMCHUNK *ch = &(rdr->chunk[c]);
+  int          status;
+
+  if (pthread_mutex_lock(&rdr->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex lock failed");
+  if (ch->n == ch->nalloc)
+    {
+      ch->nalloc = (ch->nalloc == 0 ? 16 : ch->nalloc * 2);
+      ESL_REALLOC(ch->hmm, sizeof(P7_HMM *)      * ch->nalloc);
+      ESL_REALLOC(ch->om,  sizeof(P7_OPROFILE *) * ch->nalloc);
+    }
+  ch->hmm[ch->n] = hmm;
+  ch->om[ch->n]  = om;
+  ch->n++;
+  *ret_stop = rdr->abort;
+  pthread_cond_broadcast(&rdr->cond);
+  if (pthread_mutex_unlock(&rdr->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex unlock failed");
+  return eslOK;
+
+ ERROR:
+  pthread_mutex_unlock(&rdr->mutex);
+  return status;
+}
+
+/* convert_model()
+ * Configure <hmm> as a local profile, using null model <bg>, and
+ * convert it to the optimized profile returned in <*ret_om>, the way
+ * hmmpress does.
+ */
+static int
+convert_model(P7_HMM *hmm, P7_BG *bg, P7_OPROFILE **ret_om)
+{
+  P7_PROFILE  *gm = NULL;
+  P7_OPROFILE *om = NULL;
+  int          status;
+
+  if ((gm = p7_profile_Create(hmm->M, hmm->abc)) == NULL) { status = eslEMEM; goto ERROR; }
+  if ((om = p7_oprofile_Create(hmm->M, hmm->abc)) == NULL) { status = eslEMEM; goto ERROR; }
+  if ((status = p7_ProfileConfig(hmm, bg, gm, 400, p7_LOCAL)) != eslOK) goto ERROR;
+  if ((status = p7_oprofile_Convert(gm, om))                   != eslOK) goto ERROR;
+
+  p7_profile_Destroy(gm);
+  *ret_om = om;
+  return eslOK;
+
+ ERROR:
+  if (gm) p7_profile_Destroy(gm);
+  if (om) p7_oprofile_Destroy(om);
+  *ret_om = NULL;
+  return status;
+}
+
+/* parse_chunk()
+ * Parse chunk <c> with <hfp>, converting models with null model <bg>
+ * if profiles are wanted, and add them to the chunk one by one.
+ */
+static int
+parse_chunk(P7_HMMREADER *rdr, P7_HMMFILE *hfp, P7_BG *bg, int c)
+{
+  ESL_ALPHABET *abc  = (ESL_ALPHABET *) rdr->abc; /* p7_hmmfile_Read() only checks it */
+  P7_HMM       *hmm  = NULL;
+  P7_OPROFILE  *om   = NULL;
+  off_t         end  = rdr->coff[c+1];
+  off_t         pos;
+  int           stop = FALSE;  /* copy of rdr->abort, taken with the mutex */
+  int           status;
+
+  if ((status = p7_hmmfile_Position(hfp, rdr->coff[c])) != eslOK) goto ERROR;
+
+  while (! stop)
+    {
+      if ((pos = ftello(hfp->f)) < 0) ESL_XEXCEPTION(eslESYS, "ftello() failed");
+      if (pos >= end) break;   /* the rest is the next chunk's */
+
+      status = p7_hmmfile_Read(hfp, &abc, &hmm);
+      if      (status == eslEOF) break;
+      else if (status != eslOK)  goto ERROR;
+
+      if ((rdr->what & p7_HMMREADER_PROFILES) && (status = convert_model(hmm, bg, &om)) != eslOK) goto ERROR;
+      if (! (rdr->what & p7_HMMREADER_HMMS)) { p7_hmm_Destroy(hmm); hmm = NULL; }
+
+      if ((status = put_model(rdr, c, hmm, om, &stop)) != eslOK) goto ERROR;
+      hmm = NULL;
+      om  = NULL;
+    }
+  return eslOK;
+
+ ERROR:
+  if (hmm) p7_hmm_Destroy(hmm);
+  if (om)  p7_oprofile_Destroy(om);
+  if (status == eslEFORMAT || status == eslEINCOMPAT)
+    snprintf(rdr->chunk[c].errbuf, eslERRBUFSIZE, "%s", hfp->errbuf);
+  if (status == eslEINCOMPAT && rdr->chunk[c].errbuf[0] == '\0')
+    snprintf(rdr->chunk[c].errbuf, eslERRBUFSIZE, "HMM in %s is not in the expected %s alphabet", rdr->hmmfile, esl_abc_DecodeType(rdr->abc->type));
+  return status;
+}
+
+/* parse_thread()
+ * A parser: claim chunks in file order, no more than 2 nreaders
+ * ahead of the consumer, and parse them, until there are none left
+ * or the reader is closed.
+ */
+static void *
+parse_thread(void *arg)
+{
+  P7_HMMREADER *rdr   = (P7_HMMREADER *) arg;
+  P7_HMMFILE   *hfp   = NULL;
+  P7_BG        *bg    = NULL;
+  int           c;
+  int           status;
+
+  /* The reader's file is the flatfile, or the .h3m of a pressed database; either way, open just it */
+  status = p7_hmmfile_OpenENoDB(rdr->hmmfile, NULL, &hfp, NULL);
+  if (status == eslOK && (rdr->what & p7_HMMREADER_PROFILES))
+    {
+      if ((bg = p7_bg_Create(rdr->abc)) == NULL) status = eslEMEM;
+      else p7_bg_SetLength(bg, 400);
+    }
+
+  pthread_mutex_lock(&rdr->mutex);
+  for (;;)
+    {
+      while (!rdr->abort && rdr->nextc < rdr->nchunks && rdr->nextc >= rdr->curc + 2 * rdr->nreaders)
+	pthread_cond_wait(&rdr->cond, &rdr->mutex);
+      if (rdr->abort || rdr->nextc == rdr->nchunks) break;
+      c = rdr->nextc++;
+      pthread_mutex_unlock(&rdr->mutex);
+
+      if (status == eslOK) status = parse_chunk(rdr, hfp, bg, c);
+      else snprintf(rdr->chunk[c].errbuf, eslERRBUFSIZE, "parser couldn't open %s", rdr->hmmfile);
+
+      pthread_mutex_lock(&rdr->mutex);
+      rdr->chunk[c].status = status;
+      rdr->chunk[c].done   = TRUE;
+      pthread_cond_broadcast(&rdr->cond);
+    }
+  pthread_mutex_unlock(&rdr->mutex);
+
+  if (bg)  p7_bg_Destroy(bg);
+  if (hfp) p7_hmmfile_Close(hfp);
+  return NULL;
+}
+/*------------------- end, parsing and reading ------------------*/
+
+
+
+/*****************************************************************
+ * 3. Unit tests.
+ *****************************************************************/
+#ifdef p7HMMREADER_TESTDRIVE
+#include "esl_random.h"
+
+/* utest_order()
+ *
+ * Write <N> random models of length 1..<M> to an ASCII HMM file,
+ * read them back with <nreaders> parsers and chunks of <chunksize>
+ * bytes, and check that they come back in file order, the same as a
+ * plain p7_hmmfile_Read() gives them, and that their profiles are
+ * the ones hmmpress would make. Then check that closing the reader
+ * partway through is fine.
+ */
+static void
+utest_order(ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, int N, int M, int nreaders, off_t chunksize)
+{
+  char          msg[]       = "hmmreader order unit test failed";
+  char          tmpfile[32] = "p7hmmrdrXXXXXX";
+  FILE         *fp          = NULL;
+  P7_HMMFILE   *hfp         = NULL;
+  P7_HMMREADER *rdr         = NULL;
+  ESL_ALPHABET *abc2        = NULL;
+  P7_BG        *bg          = p7_bg_Create(abc);
+  P7_HMM       *hmm         = NULL;
+  P7_HMM       *hmm2        = NULL;
+  P7_PROFILE   *gm          = NULL;
+  P7_OPROFILE  *om          = NULL;
+  P7_OPROFILE  *om2         = NULL;
+  char          name[32];
+  char          errbuf[eslERRBUFSIZE];
+  int           i, n;
+  int           status;
+
+  if (esl_tmpfile_named(tmpfile, &fp) != eslOK) esl_fatal(msg);
+  for (i = 0; i < N; i++)
+    {
+      snprintf(name, 32, "hmm%d", i);
+      if (p7_hmm_Sample(rng, 1 + esl_rnd_Roll(rng, M), abc, &hmm)  != eslOK) esl_fatal(msg);
+      if (p7_hmm_SetName(hmm, name)                                 != eslOK) esl_fatal(msg);
+      if (p7_hmmfile_WriteASCII(fp, -1, hmm)                        != eslOK) esl_fatal(msg);
+      p7_hmm_Destroy(hmm);
+    }
+  fclose(fp);
+  p7_bg_SetLength(bg, 400);
+
+  /* the reference: a serial read */
+  if (p7_hmmfile_OpenE(tmpfile, NULL, &hfp, errbuf) != eslOK) esl_fatal(msg);
+
+  /* models and profiles, learning the alphabet from the file */
+  if (p7_hmmreader_Open(hfp, &abc2, nreaders, p7_HMMREADER_HMMS | p7_HMMREADER_PROFILES, chunksize, &rdr) != eslOK) esl_fatal(msg);
+  if (abc2 == NULL || abc2->type != abc->type) esl_fatal(msg);
+  n = 0;
+  while ((status = p7_hmmreader_Read(rdr, &hmm2, &om2)) == eslOK)
+    {
+      if (n >= N)                                         esl_fatal(msg);
+      if (hmm2 == NULL || om2 == NULL)                    esl_fatal(msg);
+      if (p7_hmmfile_Read(hfp, &abc, &hmm)       != eslOK) esl_fatal(msg);
+      if (strcmp(hmm->name, hmm2->name) != 0)              esl_fatal("%s: got %s, expected %s", msg, hmm2->name, hmm->name);
+      if (p7_hmm_Compare(hmm, hmm2, 0.0)         != eslOK) esl_fatal(msg);
+
+      if ((gm = p7_profile_Create(hmm->M, abc))  == NULL)  esl_fatal(msg);
+      if ((om = p7_oprofile_Create(hmm->M, abc)) == NULL)  esl_fatal(msg);
+      if (p7_ProfileConfig(hmm, bg, gm, 400, p7_LOCAL) != eslOK) esl_fatal(msg);
+      if (p7_oprofile_Convert(gm, om)                  != eslOK) esl_fatal(msg);
+      if (p7_oprofile_Compare(om, om2, 0.0, errbuf)    != eslOK) esl_fatal("%s: %s", msg, errbuf);
+
+      p7_profile_Destroy(gm);
+      p7_oprofile_Destroy(om);
+      p7_oprofile_Destroy(om2);
+      p7_hmm_Destroy(hmm);
+      p7_hmm_Destroy(hmm2);
+      n++;
+    }
+  if (status != eslEOF || n != N) esl_fatal(msg);
+  if (p7_hmmfile_Read(hfp, &abc, NULL) != eslEOF) esl_fatal(msg);
+  p7_hmmreader_Close(rdr);
+
+  /* profiles only, known alphabet, and stopping early */
+  if (p7_hmmreader_Open(hfp, &abc, nreaders, p7_HMMREADER_PROFILES, chunksize, &rdr) != eslOK) esl_fatal(msg);
+  if (p7_hmmreader_Read(rdr, &hmm2, &om2) != eslOK) esl_fatal(msg);
+  if (hmm2 != NULL || om2 == NULL)                  esl_fatal(msg);
+  if (strcmp(om2->name, "hmm0") != 0)              esl_fatal(msg);
+  p7_oprofile_Destroy(om2);
+  p7_hmmreader_Close(rdr);
+
+  p7_hmmfile_Close(hfp);
+  esl_alphabet_Destroy(abc2);
+  p7_bg_Destroy(bg);
+  remove(tmpfile);
+}
+
+/* utest_badformat()
+ *
+ * A model that can't be parsed partway through the file is an
+ * eslEFORMAT error at that point, after the models before it.
+ */
+static void
+utest_badformat(ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, int nreaders)
+{
+  char          msg[]       = "hmmreader badformat unit test failed";
+  char          tmpfile[32] = "p7hmmrdrXXXXXX";
+  FILE         *fp          = NULL;
+  P7_HMMFILE   *hfp         = NULL;
+  P7_HMMREADER *rdr         = NULL;
+  P7_HMM       *hmm         = NULL;
+  int           i, n;
+  int           status;
+
+  if (esl_tmpfile_named(tmpfile, &fp) != eslOK) esl_fatal(msg);
+  for (i = 0; i < 20; i++)
+    {
+      if (i == 10) fprintf(fp, "HMMER3/f [garbage]\nNAME  bad\nSTATS BOGUS MSV 1.0 1.0\n//\n");
+      if (p7_hmm_Sample(rng, 10, abc, &hmm)         != eslOK) esl_fatal(msg);
+      if (p7_hmmfile_WriteASCII(fp, -1, hmm)        != eslOK) esl_fatal(msg);
+      p7_hmm_Destroy(hmm);
+    }
+  fclose(fp);
+
+  if (p7_hmmfile_OpenE(tmpfile, NULL, &hfp, NULL)                              != eslOK) esl_fatal(msg);
+  if (p7_hmmreader_Open(hfp, &abc, nreaders, p7_HMMREADER_HMMS, 100, &rdr)     != eslOK) esl_fatal(msg);
+  n = 0;
+  while ((status = p7_hmmreader_Read(rdr, NULL, NULL)) == eslOK) n++;
+  if (status != eslEFORMAT || n != 10) esl_fatal(msg);
+  if (rdr->errbuf[0] == '\0')          esl_fatal(msg);
+  p7_hmmreader_Close(rdr);
+  p7_hmmfile_Close(hfp);
+  remove(tmpfile);
+}
+#endif /*p7HMMREADER_TESTDRIVE*/
+/*--------------------- end, unit tests -------------------------*/
+
+
+
+/*****************************************************************
+ * 4. Test driver.
+ *****************************************************************/
+#ifdef p7HMMREADER_TESTDRIVE
+/*
+   gcc -g -Wall -pthread -I. -L. -I../easel -L../easel -Dp7HMMREADER_TESTDRIVE -o p7_hmmreader_utest p7_hmmreader.c -lhmmer -leasel -lm
+   ./p7_hmmreader_utest
+ */
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",           0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                  0 },
+  { "-M",        eslARG_INT,     "50", NULL, "n>0", NULL,  NULL, NULL, "maximum length of sampled models",               0 },
+  { "-N",        eslARG_INT,    "100", NULL, "n>0", NULL,  NULL, NULL, "number of sampled models",                       0 },
+  { "-R",        eslARG_INT,      "3", NULL, "n>0", NULL,  NULL, NULL, "number of parser threads",                       0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for parallel HMM file parsing";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go  = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *aa  = esl_alphabet_Create(eslAMINO);
+  ESL_ALPHABET   *nt  = esl_alphabet_Create(eslDNA);
+  int             M   = esl_opt_GetInteger(go, "-M");
+  int             N   = esl_opt_GetInteger(go, "-N");
+  int             R   = esl_opt_GetInteger(go, "-R");
+
+  utest_order(rng, aa, N, M, R, 1000);   /* many small chunks        */
+  utest_order(rng, nt, N, M, R, 1000);
+  utest_order(rng, aa, N, M, 1, 0);      /* one parser               */
+  utest_order(rng, aa, 3, M, R, 1000);   /* more chunks than models  */
+  utest_badformat(rng, aa, R);
+
+  esl_alphabet_Destroy(aa);
+  esl_alphabet_Destroy(nt);
+  esl_randomness_Destroy(rng);
+  esl_getopts_Destroy(go);
+  return eslOK;
+}
+#endif /*p7HMMREADER_TESTDRIVE*/
+/*--------------------- end, test driver ------------------------*/
+
+#else  /*!HMMER_THREADS*/
+/* Parallel parsing needs threads; without them the test passes trivially. */
+#ifdef p7HMMREADER_TESTDRIVE
+int main(void) { return 0; }
+#endif
+#endif /*HMMER_THREADS*/
@@ -0,0 +1,62 @@
+/* Parallel parsing of a profile HMM file.
+ */
+#ifndef P7_HMMREADER_INCLUDED
+#define P7_HMMREADER_INCLUDED
+
+#include "p7_config.h"
+
+#ifdef HMMER_THREADS
+#include <stdio.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+
+#include "hmmer.h"
+
+#define p7_HMMREADER_CHUNKSIZE (1024 * 1024)  /* default bytes per chunk */
+
+/* What the parsers make of each model; Read() returns them */
+#define p7_HMMREADER_HMMS      (1<<0)    /* the P7_HMM                               */
+#define p7_HMMREADER_PROFILES  (1<<1)    /* its optimized profile, configured as hmmpress does */
+
+/* The models of one chunk of the file, in file order. */
+typedef struct {
+  P7_HMM       **hmm;            /* parsed models [0..n-1], or NULLs          */
+  P7_OPROFILE  **om;             /* their profiles [0..n-1], or NULLs         */
+  int            n;
+  int            nalloc;
+  int            next;           /* next model the consumer takes             */
+  int            done;           /* TRUE once the parser is done with it      */
+  int            status;         /* eslOK, or the parser's error code         */
+  char           errbuf[eslERRBUFSIZE];
+} P7_HMMCHUNK;
+
+typedef struct {
+  char               *hmmfile;   /* name of the file the parsers open         */
+  const ESL_ALPHABET *abc;       /* alphabet of the models                    */
+  int                 nreaders;  /* number of parser threads                  */
+  int                 what;      /* p7_HMMREADER_HMMS | p7_HMMREADER_PROFILES */
+
+  off_t              *coff;      /* chunk c is bytes coff[c]..coff[c+1]-1     */
+  int                 nchunks;
+  P7_HMMCHUNK        *chunk;     /* [0..nchunks-1]                            */
+
+  pthread_t          *tid;       /* parser threads [0..nreaders-1]            */
+  int                 nthreads;  /* how many of them were started             */
+  pthread_mutex_t     mutex;     /* protects everything below                 */
+  pthread_cond_t      cond;      /* a chunk got a model or was consumed       */
+  int                 nextc;     /* next chunk a parser claims                */
+  int                 curc;      /* chunk the consumer is reading             */
+  int                 abort;     /* TRUE: parsers stop early                  */
+
+  char                errbuf[eslERRBUFSIZE];
+} P7_HMMREADER;
+
+extern int  p7_hmmreader_Open (P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, int nreaders, int what, off_t chunksize, P7_HMMREADER **ret_rdr);
+extern int  p7_hmmreader_Read (P7_HMMREADER *rdr, P7_HMM **opt_hmm, P7_OPROFILE **opt_om);
+extern void p7_hmmreader_Close(P7_HMMREADER *rdr);
+
+#endif /*HMMER_THREADS*/
+#endif /*P7_HMMREADER_INCLUDED*/
@@ -8,9 +8,11 @@
  */
 #include "p7_config.h"
 
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h> 
+#include <time.h>
 
 #include "easel.h"
 #include "esl_exponential.h"
@@ -33,6 +35,31 @@ typedef struct {
   float            *fwd_emissions_arr;
 } P7_PIPELINE_LONGTARGET_OBJS;
 
+/* Longest target the protein pipeline accepts. The SSE implementation
+ * falls back to checkpointed Forward/Backward matrices in domain
+ * definition when full ones would be too big (see <ddef->ramlimit>),
+ * so it takes targets of any length; the others still stop at 100K,
+ * the old limit on full O(ML) matrices.
+ */
+#if defined (eslENABLE_SSE)
+#define p7_PLI_MAXL  INT_MAX
+#else
+#define p7_PLI_MAXL  100000
+#endif
+
+/* pli_check_length()
+ * Return <eslOK> if target <sq> is within the pipeline's length
+ * limit, <p7_PLI_MAXL>. Otherwise throw <eslETYPE>: the usual cause
+ * is a genome DNA seq db given to hmmsearch/hmmscan instead of
+ * nhmmer/nhmmscan.
+ */
+static int
+pli_check_length(const ESL_SQ *sq)
+{
+  if (sq->n > p7_PLI_MAXL) ESL_EXCEPTION(eslETYPE, "Target sequence length > %d, over comparison pipeline limit.\n(Did you mean to use nhmmer/nhmmscan?)", p7_PLI_MAXL);
+  return eslOK;
+}
+
 
 /*****************************************************************
  * 1. The P7_PIPELINE object: allocation, initialization, destruction.
@@ -103,14 +130,32 @@ p7_pipeline_Create(const ESL_GETOPTS *go, int M_hint, int L_hint, int long_targe
   int          status;
 
   ESL_ALLOC(pli, sizeof(P7_PIPELINE));
+  pli->blk_usc    = NULL;
+  pli->blk_key    = NULL;
+  pli->blk_dsq    = NULL;
+  pli->blk_L      = NULL;
+  pli->blk_sc     = NULL;
+  pli->blk_nalloc = 0;
+  pli->bnd        = NULL;
+  pli->bfx        = NULL;
+  pli->topn       = 0;
+  pli->topn_key   = NULL;
+  pli->topn_n     = 0;
+  pli->defer      = p7_DEFER_OFF;
+  pli->dfr        = NULL;
+  pli->ndfr       = 0;
+  pli->dfr_nalloc = 0;
 
   pli->do_alignment_score_calc = 0;
+  pli->do_lazy_ad   = FALSE;
   pli->long_targets = long_targets;
 
   if ((pli->fwd = p7_omx_Create(M_hint, L_hint, L_hint)) == NULL) goto ERROR;
   if ((pli->bck = p7_omx_Create(M_hint, L_hint, L_hint)) == NULL) goto ERROR;
   if ((pli->oxf = p7_omx_Create(M_hint, 0,      L_hint)) == NULL) goto ERROR;
   if ((pli->oxb = p7_omx_Create(M_hint, 0,      L_hint)) == NULL) goto ERROR;     
+  if ((pli->bnd = p7_gbands_Create())                    == NULL) goto ERROR;
+  if ((pli->bfx = p7_omx_Create(M_hint, 0,      L_hint)) == NULL) goto ERROR;
 
   /* Normally, we reinitialize the RNG to the original seed every time we're
    * about to collect a stochastic trace ensemble. This eliminates run-to-run
@@ -229,6 +274,12 @@ p7_pipeline_Create(const ESL_GETOPTS *go, int M_hint, int L_hint, int long_targe
     }
   if (go && esl_opt_GetBoolean(go, "--nonull2")) pli->do_null2      = FALSE;
   if (go && esl_opt_GetBoolean(go, "--nobias"))  pli->do_biasfilter = FALSE;
+
+  /* Banded Forward/Backward parsing is off unless the caller turns it on (hmmsearch --banded) */
+  pli->do_banded  = FALSE;
+  pli->band_minLM = 1e8;
+  pli->band_endp  = 1e-4;
+  pli->band_tol   = 1e-3;
   
 
   /* Accounting as we collect results */
@@ -240,10 +291,18 @@ p7_pipeline_Create(const ESL_GETOPTS *go, int M_hint, int L_hint, int long_targe
   pli->n_past_bias     = 0;
   pli->n_past_vit      = 0;
   pli->n_past_fwd      = 0;
+  pli->n_banded        = 0;
+  pli->n_band_fallback = 0;
+  pli->band_maxerr     = 0.0;
+  pli->n_topn_skipped  = 0;
+  pli->n_deferred      = 0;
+  pli->n_dfr_selected  = 0;
   pli->pos_past_msv    = 0;
   pli->pos_past_bias   = 0;
   pli->pos_past_vit    = 0;
   pli->pos_past_fwd    = 0;
+  memset(pli->stage_ns,    0, sizeof(uint64_t) * p7_PLI_NSTAGES);
+  memset(pli->stage_cells, 0, sizeof(uint64_t) * p7_PLI_NSTAGES);
   pli->mode            = mode;
   pli->show_accessions = (go && esl_opt_GetBoolean(go, "--acc")   ? TRUE  : FALSE);
   pli->show_alignments = (go && esl_opt_GetBoolean(go, "--noali") ? FALSE : TRUE);
@@ -275,6 +334,7 @@ p7_pipeline_Reuse(P7_PIPELINE *pli)
   p7_omx_Reuse(pli->oxb);
   p7_omx_Reuse(pli->fwd);
   p7_omx_Reuse(pli->bck);
+  p7_omx_Reuse(pli->bfx);
   p7_domaindef_Reuse(pli->ddef);
   return eslOK;
 }
@@ -295,8 +355,17 @@ p7_pipeline_Destroy(P7_PIPELINE *pli)
   p7_omx_Destroy(pli->oxb);
   p7_omx_Destroy(pli->fwd);
   p7_omx_Destroy(pli->bck);
+  p7_omx_Destroy(pli->bfx);
   esl_randomness_Destroy(pli->r);
   p7_domaindef_Destroy(pli->ddef);
+  p7_gbands_Destroy(pli->bnd);
+  if (pli->blk_usc) free(pli->blk_usc);
+  if (pli->blk_key) free(pli->blk_key);
+  if (pli->blk_dsq) free(pli->blk_dsq);
+  if (pli->blk_L)   free(pli->blk_L);
+  if (pli->blk_sc)  free(pli->blk_sc);
+  if (pli->topn_key) free(pli->topn_key);
+  if (pli->dfr && pli->dfr_nalloc > 0) free(pli->dfr);
   free(pli);
 }
 /*---------------- end, P7_PIPELINE object ----------------------*/
@@ -570,17 +639,24 @@ p7_pli_NewModelThresholds(P7_PIPELINE *pli, const P7_OPROFILE *om)
  * Purpose:   Caller has a new sequence <sq>. Prepare the pipeline <pli>
  *            to receive this model as either a query or a target.
  *
+ *            In the annotating pass of deferred domain definition
+ *            (<p7_pli_DeferredSelect()>), the targets were already
+ *            counted in the recording pass, and this does nothing.
+ *
  * Returns:   <eslOK> on success.
  */
 int
 p7_pli_NewSeq(P7_PIPELINE *pli, const ESL_SQ *sq)
 {
+  if (pli->defer == p7_DEFER_ANNOTATE) return eslOK;
   if (!pli->long_targets) pli->nseqs++; // if long_targets, sequence counting happens in the serial loop, which can track multiple windows for a single long sequence
   pli->nres += sq->n;
   if (pli->Z_setby == p7_ZSETBY_NTARGETS && pli->mode == p7_SEARCH_SEQS) pli->Z = pli->nseqs;
   return eslOK;
 }
 
+static int pli_deferred_Add(P7_PIPELINE *pli, int64_t idx, float fwdsc, float nullsc);
+
 /* Function:  p7_pipeline_Merge()
  * Synopsis:  Merge the pipeline statistics
  *
@@ -591,15 +667,24 @@ p7_pli_NewSeq(P7_PIPELINE *pli, const ESL_SQ *sq)
  *            way (if we're using a composition bias filter HMM in the
  *            pipeline).
  *
+ *            Targets that <p2> recorded for deferred domain
+ *            definition are added to <p1>'s.
+ *
  * Returns:   <eslOK> on success.
  * 
  *            <eslEINVAL> if pipeline expects to be able to use a
  *            model's bit score thresholds, but this model does not
  *            have the appropriate ones set.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
  */
 int
 p7_pipeline_Merge(P7_PIPELINE *p1, P7_PIPELINE *p2)
 {
+  int64_t i;
+  int     s;
+  int     status;
+
   /* if we are searching a sequence database, we need to keep track of the
    * number of sequences and residues processed.
    */
@@ -620,12 +705,29 @@ p7_pipeline_Merge(P7_PIPELINE *p1, P7_PIPELINE *p2)
   p1->n_past_fwd  += p2->n_past_fwd;
   p1->n_output    += p2->n_output;
 
+  p1->n_banded        += p2->n_banded;
+  p1->n_band_fallback += p2->n_band_fallback;
+  p1->band_maxerr      = ESL_MAX(p1->band_maxerr, p2->band_maxerr);
+  p1->n_topn_skipped  += p2->n_topn_skipped;
+  p1->n_deferred      += p2->n_deferred;
+  p1->n_dfr_selected  += p2->n_dfr_selected;
+
+  if (p2->defer == p7_DEFER_RECORD)
+    for (i = 0; i < p2->ndfr; i++)
+      if ((status = pli_deferred_Add(p1, p2->dfr[i].idx, p2->dfr[i].fwdsc, p2->dfr[i].nullsc)) != eslOK) return status;
+
   p1->pos_past_msv  += p2->pos_past_msv;
   p1->pos_past_bias += p2->pos_past_bias;
   p1->pos_past_vit  += p2->pos_past_vit;
   p1->pos_past_fwd  += p2->pos_past_fwd;
   p1->pos_output    += p2->pos_output;
 
+  for (s = 0; s < p7_PLI_NSTAGES; s++)
+    {
+      p1->stage_ns[s]    += p2->stage_ns[s];
+      p1->stage_cells[s] += p2->stage_cells[s];
+    }
+
   if (p1->Z_setby == p7_ZSETBY_NTARGETS)
     {
       p1->Z += (p1->mode == p7_SCAN_MODELS) ? p2->nmodels : p2->nseqs;
@@ -638,6 +740,374 @@ p7_pipeline_Merge(P7_PIPELINE *p1, P7_PIPELINE *p2)
   return eslOK;
 }
 
+
+/* Function:  p7_pli_SetTopN()
+ * Synopsis:  Report only the best <topn> targets.
+ *
+ * Purpose:   Put pipeline <pli> in top-N mode: of the targets that
+ *            pass the reporting thresholds, only the <topn> with the
+ *            best sortkeys (E-value, or bit score if inclusion is by
+ *            score) are reported. <topn> of 0 turns it off.
+ *
+ *            The pipeline keeps a heap of the <topn> best sortkeys
+ *            of the hits it has added to its hit list. Once the heap
+ *            is full, a target that passes the Forward filter is only
+ *            taken through domain definition if its uncorrected
+ *            Forward score (<pre_score>) could still beat the worst
+ *            of them. This bounds the final score from above, except
+ *            that the per-domain "reconstruction" score, which
+ *            overrides it when it is higher, isn't known without
+ *            domain definition; a target whose reconstruction score
+ *            alone would have put it in the top N may be missed.
+ *
+ *            Each thread's pipeline prunes against its own top N,
+ *            which can only be looser than the merged one. Threaded
+ *            and MPI callers also set <topn> in the pipeline they
+ *            merge into, where <p7_tophits_Threshold()> cuts the
+ *            merged, sorted list to its first <topn> reported hits.
+ *            Since pruned targets aren't counted, the default <domZ>
+ *            is then the number of targets reported, at most <topn>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_pli_SetTopN(P7_PIPELINE *pli, int topn)
+{
+  int status;
+
+  pli->topn   = topn;
+  pli->topn_n = 0;
+  if (topn > 0) ESL_REALLOC(pli->topn_key, sizeof(double) * topn);
+  return eslOK;
+
+ ERROR:
+  pli->topn = 0;
+  return status;
+}
+
+/* pli_topn_Excluded()
+ * In top-N mode, return TRUE if a hit with sortkey <key> can't enter
+ * the <pli->topn> best seen so far.
+ */
+static int
+pli_topn_Excluded(const P7_PIPELINE *pli, double key)
+{
+  return (pli->topn > 0 && pli->topn_n == pli->topn && key < pli->topn_key[0]);
+}
+
+/* pli_topn_Add()
+ * In top-N mode, add sortkey <key> of a new hit to the min-heap of
+ * the <pli->topn> best, displacing the worst if it's full.
+ */
+static void
+pli_topn_Add(P7_PIPELINE *pli, double key)
+{
+  double *h = pli->topn_key;
+  int     i, c;
+
+  if (pli->topn == 0) return;
+  if (pli->topn_n < pli->topn)
+    {				/* sift up */
+      for (i = pli->topn_n++; i > 0 && h[(i-1)/2] > key; i = (i-1)/2)
+	h[i] = h[(i-1)/2];
+      h[i] = key;
+    }
+  else if (key > h[0])
+    {				/* replace the root, sift down */
+      for (i = 0; (c = 2*i+1) < pli->topn_n; i = c)
+	{
+	  if (c+1 < pli->topn_n && h[c+1] < h[c]) c++;
+	  if (h[c] >= key) break;
+	  h[i] = h[c];
+	}
+      h[i] = key;
+    }
+}
+
+
+/* Function:  p7_pli_SetDeferred()
+ * Synopsis:  Defer domain definition to a second pass over the targets.
+ *
+ * Purpose:   Put search pipeline <pli> in the recording pass of
+ *            deferred domain definition. 
+ *
+ *            When the search space size Z is the number of targets
+ *            (<p7_ZSETBY_NTARGETS>), the E-value thresholds aren't
+ *            known until the whole database has been seen, so the
+ *            pipeline has to take every target that passes the
+ *            Forward filter through Backward, domain definition and
+ *            alignment display, only for <p7_tophits_Threshold()> to
+ *            drop most of them. In the recording pass, a target that
+ *            passes the Forward filter is instead only recorded, by
+ *            its index <sq->idx>, its Forward score and its null
+ *            model score, and nothing is added to the hit list.
+ *
+ *            Once every target has been counted (and threaded
+ *            pipelines merged with <p7_pipeline_Merge()>),
+ *            <p7_pli_DeferredSelect()> keeps the targets that could
+ *            still be reported or included and switches <pli> to the
+ *            annotating pass, and <p7_pli_DeferredShare()> gives that
+ *            selection to any other pipelines. The caller then reads
+ *            the same targets again, with the same <sq->idx>, through
+ *            <p7_Pipeline()> or <p7_Pipeline_Block()> as before. Only
+ *            the selected targets are parsed (Forward again, then the
+ *            rest of the pipeline); the others are passed over
+ *            without any filter, and <p7_pli_NewSeq()> doesn't count
+ *            any of them a second time.
+ *
+ *            The selection is by the uncorrected Forward score,
+ *            which bounds the final score from above except when the
+ *            reconstruction score from the domains overrides it, as
+ *            in <p7_pli_SetTopN()>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <pli> isn't a search pipeline.
+ */
+int
+p7_pli_SetDeferred(P7_PIPELINE *pli)
+{
+  if (pli->mode != p7_SEARCH_SEQS || pli->long_targets) ESL_EXCEPTION(eslEINVAL, "deferred domain definition is for search pipelines");
+  pli->defer = p7_DEFER_RECORD;
+  pli->ndfr  = 0;
+  return eslOK;
+}
+
+/* pli_deferred_Add()
+ * Record target <idx> with Forward score <fwdsc> and null score <nullsc>
+ * for the annotating pass.
+ */
+static int
+pli_deferred_Add(P7_PIPELINE *pli, int64_t idx, float fwdsc, float nullsc)
+{
+  int status;
+
+  if (pli->ndfr == pli->dfr_nalloc)
+    {
+      ESL_REALLOC(pli->dfr, sizeof(P7_PLI_DEFERRED) * (pli->dfr_nalloc > 0 ? 2 * pli->dfr_nalloc : 256));
+      pli->dfr_nalloc = (pli->dfr_nalloc > 0 ? 2 * pli->dfr_nalloc : 256);
+    }
+  pli->dfr[pli->ndfr].idx    = idx;
+  pli->dfr[pli->ndfr].fwdsc  = fwdsc;
+  pli->dfr[pli->ndfr].nullsc = nullsc;
+  pli->ndfr++;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+static int
+cmp_deferred(const void *p1, const void *p2)
+{
+  int64_t i1 = ((const P7_PLI_DEFERRED *) p1)->idx;
+  int64_t i2 = ((const P7_PLI_DEFERRED *) p2)->idx;
+  return (i1 > i2) - (i1 < i2);
+}
+
+/* Function:  p7_pli_DeferredSelect()
+ * Synopsis:  Pick the recorded targets that can still be reported.
+ *
+ * Purpose:   End the recording pass of deferred domain definition
+ *            (<p7_pli_SetDeferred()>) for pipeline <pli>, searched
+ *            with query <om>. <pli> has now counted every target
+ *            (merged with any other pipelines), so its search space
+ *            size <Z> and thresholds are final. Keep only the
+ *            recorded targets whose uncorrected Forward score meets
+ *            the per-target reporting or inclusion threshold, sort
+ *            them by index, and put <pli> in the annotating pass.
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+p7_pli_DeferredSelect(P7_PIPELINE *pli, const P7_OPROFILE *om)
+{
+  float   pre_score;
+  double  lnP;
+  int64_t i, n;
+
+  for (n = 0, i = 0; i < pli->ndfr; i++)
+    {
+      pre_score = (pli->dfr[i].fwdsc - pli->dfr[i].nullsc) / eslCONST_LOG2;
+      lnP       = esl_exp_logsurv(pre_score, om->evparam[p7_FTAU], om->evparam[p7_FLAMBDA]);
+      if (p7_pli_TargetReportable(pli, pre_score, lnP) || p7_pli_TargetIncludable(pli, pre_score, lnP))
+	pli->dfr[n++] = pli->dfr[i];
+    }
+  pli->ndfr = n;
+  pli->n_dfr_selected = n;
+  qsort(pli->dfr, n, sizeof(P7_PLI_DEFERRED), cmp_deferred);
+  pli->defer = p7_DEFER_ANNOTATE;
+  return eslOK;
+}
+
+/* Function:  p7_pli_DeferredShare()
+ * Synopsis:  Annotate another pipeline's selected targets.
+ *
+ * Purpose:   Put pipeline <pli> in the annotating pass of deferred
+ *            domain definition, with the targets that
+ *            <p7_pli_DeferredSelect()> selected in <src>, so that
+ *            several threads can share the second pass. <pli>
+ *            shares <src>'s list without copying it; <src> must
+ *            outlive <pli>'s use of it. Any targets <pli> recorded
+ *            itself must already have been merged into <src>.
+ *
+ *            Since its targets were counted in the first pass, <pli>
+ *            should be a new pipeline that counts none, so that
+ *            merging it into <src> afterwards adds only hits and
+ *            time. Until then its reporting thresholds are too
+ *            permissive; <p7_tophits_Threshold()> on the merged hits
+ *            sets them straight.
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+p7_pli_DeferredShare(P7_PIPELINE *pli, const P7_PIPELINE *src)
+{
+  if (pli->dfr && pli->dfr_nalloc > 0) free(pli->dfr);
+  pli->dfr        = src->dfr;
+  pli->ndfr       = src->ndfr;
+  pli->dfr_nalloc = 0;
+  pli->defer      = p7_DEFER_ANNOTATE;
+  return eslOK;
+}
+
+/* Targets at most this long are given to the inter-sequence MSV
+ * filter in p7_pli_MSVBlock(); longer ones are scored one at a time
+ * by the striped filter. The inter-sequence filter saves the striped
+ * filter's per-row overhead, which matters less the longer the
+ * target, and the 32-lane AVX2 kernel amortizes its per-column work
+ * over twice as many targets as the 16-lane SSE one, so it keeps the
+ * lead to longer lengths. The cutoffs only affect speed, never
+ * scores or stage counts. To tune them for a machine, compare the
+ * two filters with `ssvfilter_interseq_benchmark -b -L <n>` and
+ * rebuild with, e.g., -Dp7_PLI_ISV_MAXL_SSE=<n>.
+ *
+ * It takes at least one SSE vector's worth of short targets to be
+ * worth sorting them.
+ */
+#ifndef p7_PLI_ISV_MAXL_SSE
+#define p7_PLI_ISV_MAXL_SSE  256
+#endif
+#ifndef p7_PLI_ISV_MAXL_AVX
+#define p7_PLI_ISV_MAXL_AVX  512
+#endif
+#define p7_PLI_ISV_MINSEQ    16
+
+static int
+cmp_blk_key(const void *p1, const void *p2)
+{
+  int64_t k1 = *(const int64_t *) p1;
+  int64_t k2 = *(const int64_t *) p2;
+  return (k1 > k2) - (k1 < k2);
+}
+
+/* Function:  p7_pli_MSVBlock()
+ * Synopsis:  MSV filter scores for a block of targets.
+ *
+ * Purpose:   Calculate the MSV filter score of profile <om> against
+ *            each of the <nseq> target sequences <sq[0..nseq-1]>,
+ *            and leave them in <pli->blk_usc[0..nseq-1]>, for the
+ *            caller to pass one at a time to <p7_Pipeline_FromMSV()>.
+ *            The scores are the same as <p7_Pipeline()> would
+ *            calculate.
+ *
+ *            Short targets are sorted by length and scored together
+ *            with <p7_MSVFilterInterseq()> (SSE implementation only),
+ *            which is much faster for them than the striped
+ *            filter. What counts as short is a fixed cutoff for the
+ *            dispatched instruction set, <p7_PLI_ISV_MAXL_SSE> or
+ *            <p7_PLI_ISV_MAXL_AVX>, so which filter scores a target
+ *            never depends on timing. Empty targets are not scored,
+ *            since the pipeline skips them anyway.
+ *
+ *            The MSV part of <om> is left configured for the length
+ *            of whichever target was scored last, so the caller has
+ *            to call <p7_oprofile_ReconfigLength()> for each target
+ *            before passing it on to <p7_Pipeline_FromMSV()>, as it
+ *            would before <p7_Pipeline()>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ *
+ *            <eslETYPE> if a target is longer than <p7_PLI_MAXL>,
+ *            as <p7_Pipeline()>; no target is scored.
+ */
+int
+p7_pli_MSVBlock(P7_PIPELINE *pli, P7_OPROFILE *om, const ESL_SQ *sq, int nseq)
+{
+  uint64_t t0     = p7_pli_Clock();
+  int      maxl   = 0;
+  int      nshort = 0;
+  int      i, j;
+  int      status;
+
+  for (i = 0; i < nseq; i++)
+    if ((status = pli_check_length(&(sq[i]))) != eslOK) return status;
+
+  if (nseq > pli->blk_nalloc)
+    {
+      ESL_REALLOC(pli->blk_usc, sizeof(float)     * nseq);
+      ESL_REALLOC(pli->blk_key, sizeof(int64_t)   * nseq);
+      ESL_REALLOC(pli->blk_dsq, sizeof(ESL_DSQ *) * nseq);
+      ESL_REALLOC(pli->blk_L,   sizeof(int)       * nseq);
+      ESL_REALLOC(pli->blk_sc,  sizeof(float)     * nseq);
+      pli->blk_nalloc = nseq;
+    }
+
+#if defined (eslENABLE_SSE)
+  maxl = (p7_dispatch_GetISA() >= p7_ISA_AVX ? p7_PLI_ISV_MAXL_AVX : p7_PLI_ISV_MAXL_SSE);
+#endif
+
+  for (i = 0; i < nseq; i++)
+    {
+      pli->blk_usc[i] = -eslINFINITY;
+      if (sq[i].n == 0) continue;
+      pli->stage_cells[p7_PLI_MSV] += (uint64_t) om->M * sq[i].n;
+      if (sq[i].n <= maxl) pli->blk_key[nshort++] = ((int64_t) sq[i].n << 32) | i;
+    }
+
+#if defined (eslENABLE_SSE)
+  if (nshort >= p7_PLI_ISV_MINSEQ)
+    {
+      qsort(pli->blk_key, nshort, sizeof(int64_t), cmp_blk_key);
+      for (j = 0; j < nshort; j++)
+	{
+	  i = (int) (pli->blk_key[j] & 0xffffffff);
+	  pli->blk_dsq[j] = sq[i].dsq;
+	  pli->blk_L[j]   = sq[i].n;
+	}
+      if ((status = p7_MSVFilterInterseq(pli->blk_dsq, pli->blk_L, nshort, om, pli->oxf, pli->blk_sc)) != eslOK) return status;
+      for (j = 0; j < nshort; j++)
+	pli->blk_usc[pli->blk_key[j] & 0xffffffff] = pli->blk_sc[j];
+    }
+  else nshort = 0;
+#else
+  nshort = 0;
+#endif
+
+  /* Everything the inter-sequence filter didn't take: the striped filter, one at a time */
+  for (i = 0; i < nseq; i++)
+    {
+      if (sq[i].n == 0)               continue;
+      if (nshort && sq[i].n <= maxl)  continue;
+
+      p7_oprofile_ReconfigMSVLength(om, sq[i].n);
+      p7_omx_GrowTo(pli->oxf, om->M, 0, sq[i].n);
+      p7_MSVFilter(sq[i].dsq, sq[i].n, om, pli->oxf, &(pli->blk_usc[i]));
+    }
+  pli->stage_ns[p7_PLI_MSV] += p7_pli_Clock() - t0;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
+static int pli_deferred(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *hitlist);
+
 /* Function:  p7_Pipeline()
  * Synopsis:  HMMER3's accelerated seq/profile comparison pipeline.
  *
@@ -663,9 +1133,10 @@ p7_pipeline_Merge(P7_PIPELINE *p1, P7_PIPELINE *p2)
  *
  * Throws:    <eslEMEM> on allocation failure.
  *
- *            <eslETYPE> if <sq> is more than 100K long, which can
- *            happen when someone uses hmmsearch/hmmscan instead of
- *            nhmmer/nhmmscan on a genome DNA seq db.
+ *            <eslETYPE> if <sq> is longer than <p7_PLI_MAXL> (100K),
+ *            which can happen when someone uses hmmsearch/hmmscan
+ *            instead of nhmmer/nhmmscan on a genome DNA seq db. (Not
+ *            in the SSE implementation, which has no length limit.)
  *
  * Xref:      J4/25.
  *
@@ -679,30 +1150,89 @@ p7_pipeline_Merge(P7_PIPELINE *p1, P7_PIPELINE *p2)
 int
 p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *hitlist)
 {
-  P7_HIT          *hit     = NULL;     /* ptr to the current hit output data      */
-  float            usc, vfsc, fwdsc;   /* filter scores                           */
+  float    usc;			/* MSV filter score */
+  uint64_t t0;
+  int      status;
+
+  if (sq->n == 0) return eslOK;    /* silently skip length 0 seqs; they'd cause us all sorts of weird problems */
+  if ((status = pli_check_length(sq)) != eslOK) return status;
+  if (pli->defer == p7_DEFER_ANNOTATE) return pli_deferred(pli, om, bg, sq, ntsq, hitlist);
+
+  p7_omx_GrowTo(pli->oxf, om->M, 0, sq->n);    /* expand the one-row omx if needed */
+  t0 = p7_pli_Clock();
+  p7_MSVFilter(sq->dsq, sq->n, om, pli->oxf, &usc);
+  pli->stage_ns[p7_PLI_MSV]    += p7_pli_Clock() - t0;
+  pli->stage_cells[p7_PLI_MSV] += (uint64_t) om->M * sq->n;
+
+  return p7_Pipeline_FromMSV(pli, om, bg, sq, ntsq, hitlist, usc);
+}
+
+
+#if defined (eslENABLE_SSE)
+/* pli_banded_parse()
+ * Redo the Forward/Backward parse of target <sq>, whose full Forward
+ * score is <fwdsc> (its matrix in <pli->oxf>), in the row bands that
+ * p7_BandsFromForward() picks. The banded Forward goes into
+ * <pli->bfx> and the Backward into <pli->oxb>.
+ *
+ * The bands drop a fraction 1 - exp(bsc - fwdsc) of the probability
+ * mass, which is also a bound on the error of every posterior that
+ * domain definition decodes. Beyond <pli->band_tol>, or when the bands
+ * wouldn't save at least half of the rows, return <eslFAIL>, and the
+ * caller does a full Backward parse instead.
+ */
+static int
+pli_banded_parse(P7_PIPELINE *pli, const P7_OPROFILE *om, const ESL_SQ *sq, float fwdsc)
+{
+  float  bsc;
+  double err;
+  int    status;
+
+  if ((status = p7_BandsFromForward(om, pli->oxf, pli->band_endp, pli->bnd)) != eslOK) return status;
+  if (pli->bnd->nrow == 0 || pli->bnd->nrow > sq->n / 2) return eslFAIL;
+
+  p7_omx_GrowTo(pli->bfx, om->M, 0, sq->n);
+  if ((status = p7_ForwardBanded(sq->dsq, sq->n, om, pli->bnd, pli->bfx, &bsc)) != eslOK) return status;
+
+  err = 1.0 - exp(ESL_MIN(0.0, bsc - fwdsc));
+  pli->band_maxerr = ESL_MAX(pli->band_maxerr, err);
+  if (err > pli->band_tol) { pli->n_band_fallback++; return eslFAIL; }
+
+  if ((status = p7_BackwardBanded(sq->dsq, sq->n, om, pli->bnd, pli->bfx, pli->oxb, NULL)) != eslOK) return status;
+  pli->n_banded++;
+  return eslOK;
+}
+#endif /*eslENABLE_SSE*/
+
+
+static int pli_from_forward(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *hitlist, float nullsc, float filtersc);
+static int pli_domains     (P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *hitlist, float fwdsc, float nullsc);
+
+/* pli_from_msv()
+ * The work of p7_Pipeline_FromMSV(). If <opt_fsc> is non-NULL, it
+ * is the target's bias filter score, already calculated by the caller
+ * (p7_Pipeline_ScanBlock(), four models at a time).
+ */
+static int
+pli_from_msv(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *hitlist, float usc, const float *opt_fsc)
+{
+  float            vfsc;               /* filter scores                           */
   float            filtersc;           /* HMM null filter score                   */
   float            nullsc;             /* null model score                        */
-  float            seqbias;  
   float            seq_score;          /* the corrected per-seq bit score */
-  float            sum_score;           /* the corrected reconstruction score for the seq */
-  float            pre_score, pre2_score; /* uncorrected bit scores for seq */
   double           P;                /* P-value of a hit */
-  double           lnP;              /* log P-value of a hit */
-  int              Ld;               /* # of residues in envelopes */
-  int              d;
+  uint64_t         t0;
   int              status;
   
   if (sq->n == 0) return eslOK;    /* silently skip length 0 seqs; they'd cause us all sorts of weird problems */
-  if (sq->n > 100000) ESL_EXCEPTION(eslETYPE, "Target sequence length > 100K, over comparison pipeline limit.\n(Did you mean to use nhmmer/nhmmscan?)");
+  if ((status = pli_check_length(sq)) != eslOK) return status;
 
   p7_omx_GrowTo(pli->oxf, om->M, 0, sq->n);    /* expand the one-row omx if needed */
 
   /* Base null model score (we could calculate this in NewSeq(), for a scan pipeline) */
   p7_bg_NullOne  (bg, sq->dsq, sq->n, &nullsc);
 
-  /* First level filter: the MSV filter, multihit with <om> */
-  p7_MSVFilter(sq->dsq, sq->n, om, pli->oxf, &usc);
+  /* First level filter: the MSV filter, multihit with <om>; <usc> was calculated by the caller */
   seq_score = (usc - nullsc) / eslCONST_LOG2;
   P = esl_gumbel_surv(seq_score,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
   if (P > pli->F1) return eslOK;
@@ -711,7 +1241,14 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
   /* biased composition HMM filtering */
   if (pli->do_biasfilter)
     {
-      p7_bg_FilterScore(bg, sq->dsq, sq->n, &filtersc);
+      if (opt_fsc) filtersc = *opt_fsc;
+      else
+	{
+	  t0 = p7_pli_Clock();
+	  p7_bg_FilterScore(bg, sq->dsq, sq->n, &filtersc);
+	  pli->stage_ns[p7_PLI_BIAS]    += p7_pli_Clock() - t0;
+	  pli->stage_cells[p7_PLI_BIAS] += sq->n;
+	}
       seq_score = (usc - filtersc) / eslCONST_LOG2;
       P = esl_gumbel_surv(seq_score,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
       if (P > pli->F1) return eslOK;
@@ -719,10 +1256,12 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
   else filtersc = nullsc;
   pli->n_past_bias++;
 
-  /* In scan mode, if it passes the MSV filter, read the rest of the profile */
+  /* In scan mode, if it passes the MSV filter, read the rest of the profile,
+   * unless an earlier query in the same block already did.
+   */
   if (pli->mode == p7_SCAN_MODELS)
     {
-      if (pli->hfp) p7_oprofile_ReadRest(pli->hfp, om);
+      if (pli->hfp && om->base_w == 0 && om->scale_w == 0) p7_oprofile_ReadRest(pli->hfp, om);
       p7_oprofile_ReconfigRestLength(om, sq->n);
       if ((status = p7_pli_NewModelThresholds(pli, om)) != eslOK) return status; /* pli->errbuf has err msg set */
     }
@@ -730,26 +1269,146 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
   /* Second level filter: ViterbiFilter(), multihit with <om> */
   if (P > pli->F2)
     {
+      t0 = p7_pli_Clock();
       p7_ViterbiFilter(sq->dsq, sq->n, om, pli->oxf, &vfsc);  
+      pli->stage_ns[p7_PLI_VIT]    += p7_pli_Clock() - t0;
+      pli->stage_cells[p7_PLI_VIT] += (uint64_t) om->M * sq->n;
       seq_score = (vfsc-filtersc) / eslCONST_LOG2;
       P  = esl_gumbel_surv(seq_score,  om->evparam[p7_VMU],  om->evparam[p7_VLAMBDA]);
       if (P > pli->F2) return eslOK;
     }
   pli->n_past_vit++;
 
+  return pli_from_forward(pli, om, bg, sq, ntsq, hitlist, nullsc, filtersc);
+}
+
+
+/* pli_from_forward()
+ * The rest of the pipeline, from the Forward parser on, for a target
+ * that passed the MSV, bias and Viterbi filters, with null model
+ * score <nullsc> and bias filter score <filtersc> (which is <nullsc>
+ * if the bias filter is off). <om>, <bg> and <pli->oxf> are set up
+ * for the target's length. Past the Forward filter, pli_domains()
+ * does the rest, unless domain definition is being deferred.
+ */
+static int
+pli_from_forward(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *hitlist, float nullsc, float filtersc)
+{
+  float            fwdsc;              /* filter scores                           */
+  float            seq_score;          /* the corrected per-seq bit score */
+  double           P;                /* P-value of a hit */
+  uint64_t         t0, t1;
 
   /* Parse it with Forward and obtain its real Forward score. */
+  t0 = p7_pli_Clock();
   p7_ForwardParser(sq->dsq, sq->n, om, pli->oxf, &fwdsc);
+  t1 = p7_pli_Clock();
+  pli->stage_ns[p7_PLI_FWD]    += t1 - t0;
+  pli->stage_cells[p7_PLI_FWD] += (uint64_t) om->M * sq->n;
   seq_score = (fwdsc-filtersc) / eslCONST_LOG2;
   P = esl_exp_surv(seq_score,  om->evparam[p7_FTAU],  om->evparam[p7_FLAMBDA]);
   if (P > pli->F3) return eslOK;
   pli->n_past_fwd++;
 
-  /* ok, it's for real. Now a Backwards parser pass, and hand it to domain definition workflow */
-  p7_omx_GrowTo(pli->oxb, om->M, 0, sq->n);
-  p7_BackwardParser(sq->dsq, sq->n, om, pli->oxf, pli->oxb, NULL);
+  /* In the recording pass of deferred domain definition, that's all for now */
+  if (pli->defer == p7_DEFER_RECORD)
+    {
+      pli->n_deferred++;
+      return pli_deferred_Add(pli, sq->idx, fwdsc, nullsc);
+    }
+
+  return pli_domains(pli, om, bg, sq, ntsq, hitlist, fwdsc, nullsc);
+}
+
+
+/* pli_deferred()
+ * The annotating pass of deferred domain definition: if target <sq>
+ * is one that p7_pli_DeferredSelect() kept, parse it with Forward
+ * again and take it through the rest of the pipeline; otherwise
+ * nothing. Sets up <om>, <bg> for its length itself.
+ */
+static int
+pli_deferred(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *hitlist)
+{
+  P7_PLI_DEFERRED  key;
+  P7_PLI_DEFERRED *d;
+  float            fwdsc;
+  uint64_t         t0;
+
+  key.idx = sq->idx;
+  if ((d = bsearch(&key, pli->dfr, pli->ndfr, sizeof(P7_PLI_DEFERRED), cmp_deferred)) == NULL) return eslOK;
+
+  p7_bg_SetLength(bg, sq->n);
+  p7_oprofile_ReconfigLength(om, sq->n);
+  p7_omx_GrowTo(pli->oxf, om->M, 0, sq->n);
+  t0 = p7_pli_Clock();
+  p7_ForwardParser(sq->dsq, sq->n, om, pli->oxf, &fwdsc);
+  pli->stage_ns[p7_PLI_FWD]    += p7_pli_Clock() - t0;
+  pli->stage_cells[p7_PLI_FWD] += (uint64_t) om->M * sq->n;
+
+  return pli_domains(pli, om, bg, sq, ntsq, hitlist, fwdsc, d->nullsc);
+}
 
-  status = p7_domaindef_ByPosteriorHeuristics(sq, ntsq, om, pli->oxf, pli->oxb, pli->fwd, pli->bck, pli->ddef, bg, FALSE, NULL, NULL, NULL);
+
+/* pli_domains()
+ * The rest of the pipeline after the Forward filter: Backward, domain
+ * definition, scoring and the hit list, for target <sq> with Forward
+ * score <fwdsc> (matrix in <pli->oxf>) and null model score <nullsc>.
+ */
+static int
+pli_domains(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *hitlist, float fwdsc, float nullsc)
+{
+  P7_HIT          *hit     = NULL;     /* ptr to the current hit output data      */
+  P7_OMX          *oxf;                /* Forward parsing matrix for decoding     */
+  float            seqbias;  
+  float            seq_score;          /* the corrected per-seq bit score */
+  float            sum_score;           /* the corrected reconstruction score for the seq */
+  float            pre_score, pre2_score; /* uncorrected bit scores for seq */
+  double           lnP;              /* log P-value of a hit */
+  int              Ld;               /* # of residues in envelopes */
+  int              d;
+  uint64_t         t0, t1;
+  int              status;
+
+  /* In top-N mode, skip the rest if even the uncorrected Forward score can't make the top N */
+  if (pli->topn > 0)
+    {
+      pre_score = (fwdsc - nullsc) / eslCONST_LOG2;
+      if (pli_topn_Excluded(pli, pli->inc_by_E ? -esl_exp_logsurv(pre_score, om->evparam[p7_FTAU], om->evparam[p7_FLAMBDA]) : pre_score))
+	{
+	  pli->n_topn_skipped++;
+	  return eslOK;
+	}
+    }
+
+  /* ok, it's for real. Now a Backwards parser pass, and hand it to domain definition workflow.
+   * On a long target, the parse may be redone in bands instead (pli_banded_parse()); then the
+   * banded Forward is in <pli->bfx>, so that domain definition can use <pli->fwd> as its own
+   * workspace.
+   */
+  t1     = p7_pli_Clock();
+  p7_omx_GrowTo(pli->oxb, om->M, 0, sq->n);
+  oxf    = pli->oxf;
+  status = eslFAIL;
+#if defined (eslENABLE_SSE)
+  if (pli->do_banded && (double) om->M * (double) sq->n >= pli->band_minLM)
+    status = pli_banded_parse(pli, om, sq, fwdsc);
+#endif
+  if      (status == eslOK)   oxf = pli->bfx;
+  else if (status == eslFAIL) p7_BackwardParser(sq->dsq, sq->n, om, pli->oxf, pli->oxb, NULL);
+  else return status;
+  t0 = p7_pli_Clock();
+  pli->stage_ns[p7_PLI_BCK]    += t0 - t1;	/* banded Fwd/Bck, if it was tried, counts as Backward */
+  pli->stage_cells[p7_PLI_BCK] += (uint64_t) om->M * (oxf == pli->bfx ? pli->bnd->nrow : sq->n);
+
+  pli->ddef->ad_ns      = 0;
+  pli->ddef->ad_cells   = 0;
+  pli->ddef->do_lazy_ad = (pli->do_lazy_ad && pli->mode == p7_SEARCH_SEQS && ntsq == NULL); /* in scan mode, <om> is gone by output time */
+  status = p7_domaindef_ByPosteriorHeuristics(sq, ntsq, om, oxf, pli->oxb, pli->fwd, pli->bck, pli->ddef, bg, FALSE, NULL, NULL, NULL);
+  pli->stage_ns[p7_PLI_DOMAIN]       += p7_pli_Clock() - t0 - pli->ddef->ad_ns;
+  pli->stage_cells[p7_PLI_DOMAIN]    += (uint64_t) om->M * sq->n;
+  pli->stage_ns[p7_PLI_ALIDISPLAY]   += pli->ddef->ad_ns;
+  pli->stage_cells[p7_PLI_ALIDISPLAY]+= pli->ddef->ad_cells;
   if (status != eslOK) ESL_FAIL(status, pli->errbuf, "domain definition workflow failure"); /* eslERANGE can happen  */
   if (pli->ddef->nregions   == 0) return eslOK; /* score passed threshold but there's no discrete domains here       */
   if (pli->ddef->nenvelopes == 0) return eslOK; /* rarer: region was found, stochastic clustered, no envelopes found */
@@ -843,6 +1502,7 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
       hit->score      = seq_score; /* BITS */
       hit->lnP        = lnP;
       hit->sortkey    = pli->inc_by_E ? -lnP : seq_score; /* per-seq output sorts on bit score if inclusion is by score  */
+      pli_topn_Add(pli, hit->sortkey);
 
       hit->sum_score  = sum_score; /* BITS */
       hit->sum_lnP    = esl_exp_logsurv (hit->sum_score,  om->evparam[p7_FTAU], om->evparam[p7_FLAMBDA]);
@@ -920,6 +1580,314 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
 
 
 
+/* Function:  p7_Pipeline_FromMSV()
+ * Synopsis:  The pipeline, given the target's MSV filter score.
+ *
+ * Purpose:   Same as <p7_Pipeline()>, for a target whose MSV filter
+ *            score <usc> (in nats) the caller has already calculated,
+ *            usually for a whole block of targets at once with
+ *            <p7_pli_MSVBlock()>. Everything from the MSV filter
+ *            threshold on, including the accounting, is as in
+ *            <p7_Pipeline()>.
+ *
+ * Returns:   As <p7_Pipeline()>.
+ *
+ * Throws:    As <p7_Pipeline()>.
+ */
+int
+p7_Pipeline_FromMSV(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *hitlist, float usc)
+{
+  return pli_from_msv(pli, om, bg, sq, ntsq, hitlist, usc, NULL);
+}
+
+
+/* Function:  p7_Pipeline_Block()
+ * Synopsis:  Search pipeline for a block of targets, a stage at a time.
+ *
+ * Purpose:   Compare profile <om> against each of the <nseq> target
+ *            sequences <sq[0..nseq-1]>, as <p7_SEARCH_SEQS> mode
+ *            <p7_Pipeline()> does one target at a time, and add any
+ *            significant hits to <hitlist>, in the order of the
+ *            targets.
+ *
+ *            Instead of taking each target through every stage in
+ *            turn, each filter stage is run over all the targets
+ *            that passed the one before: the MSV filter over the
+ *            whole block (<p7_pli_MSVBlock()>), then the bias filter
+ *            over its survivors, then the Viterbi filter over
+ *            theirs, and then the Forward parser and the rest of the
+ *            pipeline over what's left. Each kernel and its data stay
+ *            in cache for a stretch of targets, instead of
+ *            alternating with the others on the few percent of
+ *            targets that pass MSV.
+ *
+ *            This does the work of the per-target calls to
+ *            <p7_pli_NewSeq()>, <p7_bg_SetLength()>,
+ *            <p7_oprofile_ReconfigLength()>, <p7_Pipeline()> and
+ *            <p7_pipeline_Reuse()> that a caller would otherwise
+ *            make. Results and accounting, including the search
+ *            space size each target is thresholded against, are the
+ *            same as for those calls. The targets themselves aren't
+ *            changed; the caller still reuses or frees them.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ *            <eslERANGE> if domain definition overflowed on any
+ *            target; see <p7_Pipeline()>. That target is skipped and
+ *            the rest of the block is still searched.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ *
+ *            <eslEINVAL> if <pli> is not a search pipeline.
+ *
+ *            <eslETYPE> if a target is longer than <p7_PLI_MAXL>
+ *            (100K; no limit in the SSE implementation).
+ */
+int
+p7_Pipeline_Block(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, int nseq, P7_TOPHITS *hitlist)
+{
+  float        nullsc;		/* null model score        */
+  float        vfsc;		/* Viterbi filter score    */
+  float        seq_score;
+  double       P;
+  int          npass;		/* # of targets that passed the last stage; their indices are in blk_key[] */
+  int          n;
+  int          i, j;
+  int          k = 0;		/* targets 0..k-1 have been counted by p7_pli_NewSeq() */
+  uint64_t     t0;
+  int          retval = eslOK;
+  int          status;
+
+  if (pli->mode != p7_SEARCH_SEQS) ESL_EXCEPTION(eslEINVAL, "p7_Pipeline_Block() is for search pipelines");
+  for (i = 0; i < nseq; i++)
+    if ((status = pli_check_length(&(sq[i]))) != eslOK) return status;
+
+  /* Annotating pass of deferred domain definition: no filters, just the selected targets */
+  if (pli->defer == p7_DEFER_ANNOTATE)
+    {
+      for (i = 0; i < nseq; i++)
+	{
+	  if (sq[i].n == 0) continue;
+	  status = pli_deferred(pli, om, bg, &(sq[i]), NULL, hitlist);
+	  p7_pipeline_Reuse(pli);
+	  if      (status == eslERANGE) retval = status;
+	  else if (status != eslOK)     return status;
+	}
+      return retval;
+    }
+
+  /* MSV filter, the whole block */
+  if ((status = p7_pli_MSVBlock(pli, om, sq, nseq)) != eslOK) return status;
+  for (npass = 0, i = 0; i < nseq; i++)
+    {
+      if (sq[i].n == 0) continue;
+      p7_bg_SetLength(bg, sq[i].n);
+      p7_bg_NullOne  (bg, sq[i].dsq, sq[i].n, &nullsc);
+      seq_score = (pli->blk_usc[i] - nullsc) / eslCONST_LOG2;
+      P = esl_gumbel_surv(seq_score,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
+      if (P > pli->F1) continue;
+      pli->n_past_msv++;
+      pli->blk_key[npass++] = i;
+    }
+
+  /* Bias filter. blk_sc[i] becomes the filter score that the later stages correct by. */
+  t0 = p7_pli_Clock();
+  for (n = 0, j = 0; j < npass; j++)
+    {
+      i = pli->blk_key[j];
+      p7_bg_SetLength(bg, sq[i].n);
+      if (pli->do_biasfilter)
+	{
+	  p7_bg_FilterScore(bg, sq[i].dsq, sq[i].n, &(pli->blk_sc[i]));
+	  pli->stage_cells[p7_PLI_BIAS] += sq[i].n;
+	  seq_score = (pli->blk_usc[i] - pli->blk_sc[i]) / eslCONST_LOG2;
+	  P = esl_gumbel_surv(seq_score,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
+	  if (P > pli->F1) continue;
+	}
+      else p7_bg_NullOne(bg, sq[i].dsq, sq[i].n, &(pli->blk_sc[i]));
+      pli->n_past_bias++;
+      pli->blk_key[n++] = i;
+    }
+  npass = n;
+  if (pli->do_biasfilter) pli->stage_ns[p7_PLI_BIAS] += p7_pli_Clock() - t0;
+
+  /* Viterbi filter; skipped for targets whose MSV P-value already passes F2 */
+  t0 = p7_pli_Clock();
+  for (n = 0, j = 0; j < npass; j++)
+    {
+      i = pli->blk_key[j];
+      seq_score = (pli->blk_usc[i] - pli->blk_sc[i]) / eslCONST_LOG2;
+      P = esl_gumbel_surv(seq_score,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
+      if (P > pli->F2)
+	{
+	  p7_oprofile_ReconfigLength(om, sq[i].n);
+	  p7_omx_GrowTo(pli->oxf, om->M, 0, sq[i].n);
+	  p7_ViterbiFilter(sq[i].dsq, sq[i].n, om, pli->oxf, &vfsc);
+	  pli->stage_cells[p7_PLI_VIT] += (uint64_t) om->M * sq[i].n;
+	  seq_score = (vfsc - pli->blk_sc[i]) / eslCONST_LOG2;
+	  P  = esl_gumbel_surv(seq_score,  om->evparam[p7_VMU],  om->evparam[p7_VLAMBDA]);
+	  if (P > pli->F2) continue;
+	}
+      pli->n_past_vit++;
+      pli->blk_key[n++] = i;
+    }
+  npass = n;
+  pli->stage_ns[p7_PLI_VIT] += p7_pli_Clock() - t0;
+
+  /* Forward parser and the rest, in target order. Targets are
+   * counted up to each survivor first, so its E-value is taken
+   * against the same search space as in p7_Pipeline().
+   */
+  for (j = 0; j < npass; j++)
+    {
+      i = pli->blk_key[j];
+      for (; k <= i; k++) p7_pli_NewSeq(pli, &(sq[k]));
+
+      p7_bg_SetLength(bg, sq[i].n);
+      p7_bg_NullOne  (bg, sq[i].dsq, sq[i].n, &nullsc);
+      p7_oprofile_ReconfigLength(om, sq[i].n);
+      p7_omx_GrowTo(pli->oxf, om->M, 0, sq[i].n);
+
+      status = pli_from_forward(pli, om, bg, &(sq[i]), NULL, hitlist, nullsc, pli->blk_sc[i]);
+      p7_pipeline_Reuse(pli);
+      if      (status == eslERANGE) retval = status;
+      else if (status != eslOK)     return status;
+    }
+  for (; k < nseq; k++) p7_pli_NewSeq(pli, &(sq[k]));
+  return retval;
+}
+
+
+/* Function:  p7_Pipeline_ScanBlock()
+ * Synopsis:  Scan pipeline for one query against a block of models.
+ *
+ * Purpose:   Compare query sequence <sq> against each of the <nmodels>
+ *            profiles <oml[0..nmodels-1]>, as <p7_SCAN_MODELS> mode
+ *            <p7_Pipeline()> does one model at a time, and add any
+ *            significant hits to <hitlist>. The profiles need only
+ *            have their MSV filter parts, as returned by
+ *            <p7_oprofile_ReadBlockMSV()>; the rest of each profile
+ *            that passes the MSV filter is read with
+ *            <p7_oprofile_ReadRest()> from <pli->hfp>, as usual, the
+ *            first time any query passes it; a block of models can
+ *            be compared to several queries in turn.
+ *
+ *            This does the work of the per-model calls to
+ *            <p7_pli_NewModel()>, <p7_bg_SetLength()>,
+ *            <p7_oprofile_ReconfigLength()> and <p7_Pipeline()> that a
+ *            caller would otherwise make, but in two passes. The
+ *            first pass scores the query against every model with
+ *            the MSV filter, configuring only the MSV part of each
+ *            profile and using a single null model score for the
+ *            query. Only models that pass the MSV threshold go on to
+ *            the second pass, where the bias filter HMM is built
+ *            from the model's composition, the rest of the profile is
+ *            configured, and the rest of the pipeline runs. In
+ *            Pfam-sized scans, most models never get past the first
+ *            pass.
+ *
+ *            Results and accounting are the same as for calling
+ *            <p7_Pipeline()> on each model in turn. The caller still
+ *            owns the profiles, and frees them.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ *            <eslEINVAL> if a model that passes the filters has no
+ *            GA/TC/NC bit score thresholds when we need them; 
+ *            <pli->errbuf> has the message. Scanning stops there.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ *
+ *            <eslETYPE> if <sq> is longer than <p7_PLI_MAXL> (100K;
+ *            no limit in the SSE implementation).
+ */
+int
+p7_Pipeline_ScanBlock(P7_PIPELINE *pli, P7_OPROFILE **oml, int nmodels, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *hitlist)
+{
+  P7_OPROFILE *om;
+  float        nullsc;		/* null model score, same for every model  */
+  float        seq_score;
+  double       P;
+  int          npass = 0;	/* models that pass the MSV filter         */
+  int          have_fsc;	/* TRUE if blk_sc[] has their bias filter scores */
+  uint64_t     t0;
+  int          m;
+  int          status;
+
+  if (pli->mode != p7_SCAN_MODELS) ESL_EXCEPTION(eslEINVAL, "p7_Pipeline_ScanBlock() is for scan pipelines");
+
+  /* Every model counts toward the search space, even if the query is skipped */
+  for (m = 0; m < nmodels; m++)
+    {
+      pli->nmodels++;
+      pli->nnodes += oml[m]->M;
+    }
+  if (pli->Z_setby == p7_ZSETBY_NTARGETS) pli->Z = pli->nmodels;
+
+  if (sq->n == 0) return eslOK;    /* silently skip length 0 seqs, as p7_Pipeline() does */
+  if ((status = pli_check_length(sq)) != eslOK) return status;
+
+  if (nmodels > pli->blk_nalloc)
+    {
+      ESL_REALLOC(pli->blk_usc, sizeof(float)     * nmodels);
+      ESL_REALLOC(pli->blk_key, sizeof(int64_t)   * nmodels);
+      ESL_REALLOC(pli->blk_dsq, sizeof(ESL_DSQ *) * nmodels);
+      ESL_REALLOC(pli->blk_L,   sizeof(int)       * nmodels);
+      ESL_REALLOC(pli->blk_sc,  sizeof(float)     * nmodels);
+      pli->blk_nalloc = nmodels;
+    }
+
+  /* First pass: MSV filter, all models. <bg>'s length only has to be set once. */
+  p7_bg_SetLength(bg, sq->n);
+  p7_bg_NullOne  (bg, sq->dsq, sq->n, &nullsc);
+  t0 = p7_pli_Clock();
+  for (m = 0; m < nmodels; m++)
+    {
+      om = oml[m];
+      p7_oprofile_ReconfigMSVLength(om, sq->n);
+      p7_omx_GrowTo(pli->oxf, om->M, 0, sq->n);
+      p7_MSVFilter(sq->dsq, sq->n, om, pli->oxf, &(pli->blk_usc[m]));
+      pli->stage_cells[p7_PLI_MSV] += (uint64_t) om->M * sq->n;
+
+      seq_score = (pli->blk_usc[m] - nullsc) / eslCONST_LOG2;
+      P = esl_gumbel_surv(seq_score,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
+      if (P <= pli->F1) pli->blk_key[npass++] = m;
+    }
+  pli->stage_ns[p7_PLI_MSV] += p7_pli_Clock() - t0;
+
+  /* Bias filter scores of the models that passed, four per pass over the query */
+  have_fsc = FALSE;
+#if defined (eslENABLE_SSE)
+  if (pli->do_biasfilter && npass > 0)
+    {
+      t0 = p7_pli_Clock();
+      if ((status = p7_FilterScoreModels(bg, sq->dsq, sq->n, oml, pli->blk_key, npass, pli->blk_sc)) != eslOK) return status;
+      pli->stage_ns[p7_PLI_BIAS]    += p7_pli_Clock() - t0;
+      pli->stage_cells[p7_PLI_BIAS] += (uint64_t) npass * sq->n;
+      have_fsc = TRUE;
+    }
+#endif
+
+  /* Second pass: the rest of the pipeline, for the models that passed */
+  for (m = 0; m < npass; m++)
+    {
+      om = oml[pli->blk_key[m]];
+      if (pli->do_biasfilter) p7_bg_SetFilter(bg, om->M, om->compo);
+      p7_bg_SetLength(bg, sq->n);
+      p7_oprofile_ReconfigLength(om, sq->n);
+      pli->W = om->max_length;
+
+      status = pli_from_msv(pli, om, bg, sq, ntsq, hitlist, pli->blk_usc[pli->blk_key[m]], (have_fsc ? &(pli->blk_sc[m]) : NULL));
+      p7_pipeline_Reuse(pli);
+      if (status != eslOK) return status;
+    }
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
 /* Function:  p7_pli_computeAliScores()
  * Synopsis:  Compute per-position scores for the alignment for a domain
  *
@@ -1690,6 +2658,32 @@ ERROR:
 }
 
 
+/* Function:  p7_pli_Clock()
+ * Synopsis:  Read the clock used for per-stage timing.
+ *
+ * Purpose:   Return a monotonic wall clock time, in nanoseconds from
+ *            an arbitrary origin, for charging elapsed time to one of
+ *            a pipeline's stages in <stage_ns[]>. Falls back to
+ *            process CPU time from <clock()> where there's no POSIX
+ *            monotonic clock.
+ *
+ * Returns:   the time, in nanoseconds.
+ */
+uint64_t
+p7_pli_Clock(void)
+{
+#if defined (CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+#else
+  return (uint64_t) ((double) clock() * 1e9 / (double) CLOCKS_PER_SEC);
+#endif
+}
+
+static const char *pli_stage_names[p7_PLI_NSTAGES] = { "MSV", "bias", "Viterbi", "Forward", "Backward", "domaindef", "alidisplay" };
+
 /* Function:  p7_pli_Statistics()
  * Synopsis:  Final statistics output from a processing pipeline.
  *
@@ -1770,8 +2764,27 @@ p7_pli_Statistics(FILE *ofp, P7_PIPELINE *pli, ESL_STOPWATCH *w)
           pli->F3 * ntargets,
           pli->F3);
 
+      if (pli->do_banded)
+        fprintf(ofp, "Banded Fwd/Bck parses:       %15" PRId64 "  (%" PRId64 " fell back to full; max error %.3g)\n",
+            pli->n_banded,
+            pli->n_band_fallback,
+            pli->band_maxerr);
+
+      if (pli->n_deferred > 0)
+        fprintf(ofp, "Deferred domain definitions: %15" PRId64 "  (%" PRId64 " selected for the second pass)\n",
+            pli->n_deferred,
+            pli->n_dfr_selected);
+
+      if (pli->topn > 0)
+        fprintf(ofp, "Skipped, not in top %-9d %15" PRId64 "  (%.6g)\n",
+            pli->topn,
+            pli->n_topn_skipped,
+            (double) pli->n_topn_skipped / ntargets);
+
       fprintf(ofp, "Initial search space (Z):    %15.0f  %s\n", pli->Z,    pli->Z_setby    == p7_ZSETBY_OPTION ? "[as set by --Z on cmdline]"    : "[actual number of targets]");
       fprintf(ofp, "Domain search space  (domZ): %15.0f  %s\n", pli->domZ, pli->domZ_setby == p7_ZSETBY_OPTION ? "[as set by --domZ on cmdline]" : "[number of targets reported over threshold]");
+
+      p7_pli_StageStatistics(ofp, pli);
   }
 
   if (w != NULL) {
@@ -1782,6 +2795,91 @@ p7_pli_Statistics(FILE *ofp, P7_PIPELINE *pli, ESL_STOPWATCH *w)
 
   return eslOK;
 }
+
+
+/* Function:  p7_pli_StageStatistics()
+ * Synopsis:  Report time and work spent in each pipeline stage.
+ *
+ * Purpose:   Print the wall time and the number of DP cells (for the
+ *            bias filter, residues; for alignment displays, their
+ *            total length) that pipeline <pli> spent in each of its
+ *            stages to stream <ofp>, with the throughput of each.
+ *            For a merged pipeline, times are summed over threads,
+ *            not elapsed. Prints nothing if no stage was timed, as
+ *            in a long-target (nhmmer) pipeline.
+ *
+ *            Called by <p7_pli_Statistics()>.
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+p7_pli_StageStatistics(FILE *ofp, P7_PIPELINE *pli)
+{
+  uint64_t tot = 0;
+  double   sec;
+  int      s;
+
+  for (s = 0; s < p7_PLI_NSTAGES; s++) tot += pli->stage_ns[s];
+  if (tot == 0) return eslOK;
+
+  fprintf(ofp, "Time in pipeline stages:     %15.2f  secs, summed over threads\n", (double) tot * 1e-9);
+  for (s = 0; s < p7_PLI_NSTAGES; s++)
+    {
+      sec = (double) pli->stage_ns[s] * 1e-9;
+      fprintf(ofp, "  %-26s %15.2f  (%5.1f%%)  %10.3g cells  %10.2f Mc/sec\n",
+	      pli_stage_names[s], sec, 100. * (double) pli->stage_ns[s] / (double) tot,
+	      (double) pli->stage_cells[s],
+	      (sec > 0. ? (double) pli->stage_cells[s] / (sec * 1.0e6) : 0.));
+    }
+  return eslOK;
+}
+
+
+/* Function:  p7_pli_WriteStageTable()
+ * Synopsis:  Tabular output of per-stage time and work.
+ *
+ * Purpose:   Write pipeline <pli>'s per-stage accounting for query
+ *            <qname> to <ofp> in a space-delimited table, one line
+ *            per stage: query name, stage name, number of
+ *            comparisons that entered it, wall time in nanoseconds,
+ *            and DP cells (as in <p7_pli_StageStatistics()>). If
+ *            <show_header> is TRUE, precede it with a comment line
+ *            naming the columns.
+ *
+ *            Counts of comparisons entering the MSV stage are the
+ *            number of targets (search) or models (scan); the later
+ *            stages count the comparisons passing the filter before
+ *            them, except that the Viterbi stage counts those that
+ *            passed the bias filter whether or not Viterbi had to be
+ *            run, and alidisplay counts comparisons that reached
+ *            domain definition.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEWRITE> on a write error.
+ */
+int
+p7_pli_WriteStageTable(FILE *ofp, char *qname, P7_PIPELINE *pli, int show_header)
+{
+  uint64_t nin[p7_PLI_NSTAGES];
+  int      s;
+
+  nin[p7_PLI_MSV]        = (pli->mode == p7_SEARCH_SEQS ? pli->nseqs : pli->nmodels);
+  nin[p7_PLI_BIAS]       = pli->n_past_msv;
+  nin[p7_PLI_VIT]        = pli->n_past_bias;
+  nin[p7_PLI_FWD]        = pli->n_past_vit;
+  nin[p7_PLI_BCK]        = pli->n_past_fwd;
+  nin[p7_PLI_DOMAIN]     = pli->n_past_fwd;
+  nin[p7_PLI_ALIDISPLAY] = pli->n_past_fwd;
+
+  if (show_header)
+    if (fprintf(ofp, "#%-19s %-12s %15s %20s %20s\n", " query name", "stage", "comparisons", "nanosec", "cells") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "stage table write failed");
+
+  for (s = 0; s < p7_PLI_NSTAGES; s++)
+    if (fprintf(ofp, "%-20s %-12s %15" PRIu64 " %20" PRIu64 " %20" PRIu64 "\n", qname, pli_stage_names[s], nin[s], pli->stage_ns[s], pli->stage_cells[s]) < 0)
+      ESL_EXCEPTION_SYS(eslEWRITE, "stage table write failed");
+  return eslOK;
+}
 /*------------------- end, pipeline API -------------------------*/
 
 
@@ -0,0 +1,639 @@
+/* A work-stealing scheduler for the threaded search programs.
+ *
+ * The threaded front ends have one reader, which fills blocks of
+ * targets (or of models, in hmmscan), and <ncpus> workers that take
+ * them through the pipeline. With the Easel work queue a worker takes
+ * a whole block at a time, so how long a worker is busy depends on
+ * how long the targets that happened to land in its block are, and
+ * at the end of a run the last few blocks keep a few workers busy
+ * while the rest sit idle.
+ *
+ * Here a worker instead takes a few items at a time. Each worker has
+ * a deque of items: a run [lo..hi-1] of the block it is working on.
+ * The worker takes its items from the bottom, in grains that shrink
+ * as the work that's left shrinks: nleft / (2 nworkers) items, and at
+ * least one. When its deque is empty, a worker claims the next block
+ * the reader filled; if there isn't one, it steals the top half of
+ * the largest deque of another worker. A block goes back to the
+ * reader once all of its items are finished.
+ *
+ * A grain is a handful of pipeline calls, so one mutex guards the
+ * whole scheduler.
+ *
+ * Contents:
+ *   1. P7_SCHEDULER: the blocks and the workers' deques.
+ *   2. The reader's side.
+ *   3. The workers' side.
+ *   4. Unit tests.
+ *   5. Test driver.
+ */
+#include "p7_config.h"
+
+#ifdef HMMER_THREADS
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "easel.h"
+
+#include "hmmer.h"
+#include "p7_scheduler.h"
+
+
+/*****************************************************************
+ * 1. P7_SCHEDULER: the blocks and the workers' deques.
+ *****************************************************************/
+
+/* Function:  p7_scheduler_Create()
+ * Synopsis:  Create a scheduler for <nworkers> workers.
+ *
+ * Purpose:   Create a scheduler for one reader and <nworkers> worker
+ *            threads, numbered <0..nworkers-1>. It has no blocks;
+ *            the caller adds them with <p7_scheduler_Add()>.
+ *
+ * Returns:   a pointer to the new scheduler.
+ *
+ * Throws:    <NULL> on allocation or initialization failure.
+ */
+P7_SCHEDULER *
+p7_scheduler_Create(int nworkers)
+{
+  P7_SCHEDULER *s = NULL;
+  int           w;
+  int           status;
+
+  ESL_ALLOC(s, sizeof(P7_SCHEDULER));
+  s->blk      = NULL;
+  s->count    = NULL;
+  s->pending  = NULL;
+  s->freeb    = NULL;
+  s->fullq    = NULL;
+  s->dq       = NULL;
+  s->nblocks  = 0;
+  s->balloc   = 0;
+  s->nworkers = nworkers;
+
+  ESL_ALLOC(s->dq, sizeof(P7_SCHED_RANGE) * nworkers);
+
+  if (pthread_mutex_init(&s->mutex,     NULL) != 0) ESL_XEXCEPTION(eslESYS, "mutex init failed");
+  if (pthread_cond_init (&s->work_cond, NULL) != 0) ESL_XEXCEPTION(eslESYS, "cond init failed");
+  if (pthread_cond_init (&s->free_cond, NULL) != 0) ESL_XEXCEPTION(eslESYS, "cond init failed");
+
+  for (w = 0; w < nworkers; w++) s->dq[w].blk = NULL;
+  p7_scheduler_Reset(s);
+  return s;
+
+ ERROR:
+  if (s) { free(s->dq); free(s); }
+  return NULL;
+}
+
+/* Function:  p7_scheduler_Add()
+ * Synopsis:  Give the scheduler an empty block.
+ *
+ * Purpose:   Add block <blk> to the blocks that <s> passes between
+ *            the reader and the workers, as an empty block. Two per
+ *            worker is usual. The scheduler only stores the pointer;
+ *            the caller still owns the block, and gets it back with
+ *            <p7_scheduler_Remove()> at cleanup time.
+ *
+ *            Blocks are added before any thread uses <s>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_scheduler_Add(P7_SCHEDULER *s, void *blk)
+{
+  int status;
+
+  if (s->nblocks == s->balloc)
+    {
+      s->balloc = (s->balloc == 0 ? 8 : s->balloc * 2);
+      ESL_REALLOC(s->blk,     sizeof(void *) * s->balloc);
+      ESL_REALLOC(s->count,   sizeof(int)    * s->balloc);
+      ESL_REALLOC(s->pending, sizeof(int)    * s->balloc);
+      ESL_REALLOC(s->freeb,   sizeof(int)    * s->balloc);
+      ESL_REALLOC(s->fullq,   sizeof(int)    * s->balloc);
+    }
+  s->blk[s->nblocks]     = blk;
+  s->count[s->nblocks]   = 0;
+  s->pending[s->nblocks] = 0;
+  s->freeb[s->nfree++]   = s->nblocks;
+  s->nblocks++;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+/* Function:  p7_scheduler_Reset()
+ * Synopsis:  Make all blocks empty again.
+ *
+ * Purpose:   Put every block of <s> back with the reader, empty the
+ *            workers' deques, and forget that the reader finished,
+ *            so <s> can be used for another run. The reader calls
+ *            it once all workers have returned from
+ *            <p7_scheduler_WorkerUpdate()> with <eslEOD>; the
+ *            workers of the next run mustn't be started until it
+ *            has.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslESYS> if the mutex fails.
+ */
+int
+p7_scheduler_Reset(P7_SCHEDULER *s)
+{
+  int b, w;
+
+  if (pthread_mutex_lock(&s->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex lock failed");
+
+  for (b = 0; b < s->nblocks; b++)
+    {
+      s->count[b]   = 0;
+      s->pending[b] = 0;
+      s->freeb[b]   = b;
+    }
+  s->nfree = s->nblocks;
+  s->fhead = 0;
+  s->nfull = 0;
+  for (w = 0; w < s->nworkers; w++)
+    {
+      s->dq[w].blk = NULL;
+      s->dq[w].b   = -1;
+      s->dq[w].lo  = s->dq[w].hi = 0;
+    }
+  s->nwaiting    = 0;
+  s->nleft       = 0;
+  s->reader_done = FALSE;
+
+  if (pthread_mutex_unlock(&s->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex unlock failed");
+  return eslOK;
+}
+
+/* Function:  p7_scheduler_Remove()
+ * Synopsis:  Take an empty block back from the scheduler.
+ *
+ * Purpose:   Take one empty block out of <s>, and return it in
+ *            <*ret_blk> for the caller to free. Used at cleanup time,
+ *            after <p7_scheduler_Reset()>, as
+ *            <while (p7_scheduler_Remove(s, &blk) == eslOK)>.
+ *
+ * Returns:   <eslOK> on success. <eslEOD> if there are no empty
+ *            blocks left; <*ret_blk> is <NULL>.
+ */
+int
+p7_scheduler_Remove(P7_SCHEDULER *s, void **ret_blk)
+{
+  int b;
+
+  if (s->nfree == 0) { *ret_blk = NULL; return eslEOD; }
+
+  b = s->freeb[--s->nfree];
+  *ret_blk  = s->blk[b];
+  s->blk[b] = NULL;
+  return eslOK;
+}
+
+/* Function:  p7_scheduler_Destroy()
+ * Synopsis:  Free a scheduler.
+ *
+ * Purpose:   Free scheduler <s>. Blocks that are still in it aren't
+ *            freed; see <p7_scheduler_Remove()>.
+ */
+void
+p7_scheduler_Destroy(P7_SCHEDULER *s)
+{
+  if (s == NULL) return;
+
+  pthread_mutex_destroy(&s->mutex);
+  pthread_cond_destroy(&s->work_cond);
+  pthread_cond_destroy(&s->free_cond);
+  free(s->blk);
+  free(s->count);
+  free(s->pending);
+  free(s->freeb);
+  free(s->fullq);
+  free(s->dq);
+  free(s);
+}
+/*------------------- end, P7_SCHEDULER -------------------------*/
+
+
+
+/*****************************************************************
+ * 2. The reader's side.
+ *****************************************************************/
+
+/* Function:  p7_scheduler_ReaderUpdate()
+ * Synopsis:  Hand a filled block to the workers; get an empty one.
+ *
+ * Purpose:   The reader has filled block <full> with <nitems> items.
+ *            Hand it to the workers; if <nitems> is 0, the block just
+ *            goes back to the empty ones. <full> may be <NULL>, on
+ *            the reader's first call.
+ *
+ *            Then, unless <ret_empty> is <NULL>, wait for an empty
+ *            block and return it in <*ret_empty>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <full> isn't one of the blocks of <s>.
+ *            <eslESYS> if the mutex or a condition variable fails.
+ */
+int
+p7_scheduler_ReaderUpdate(P7_SCHEDULER *s, void *full, int nitems, void **ret_empty)
+{
+  int b;
+
+  if (pthread_mutex_lock(&s->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex lock failed");
+
+  if (full != NULL)
+    {
+      for (b = 0; b < s->nblocks; b++)
+	if (s->blk[b] == full) break;
+      if (b == s->nblocks) { pthread_mutex_unlock(&s->mutex); ESL_EXCEPTION(eslEINVAL, "not a block of this scheduler"); }
+
+      if (nitems > 0)
+	{
+	  s->count[b]   = nitems;
+	  s->pending[b] = nitems;
+	  s->fullq[(s->fhead + s->nfull) % s->nblocks] = b;
+	  s->nfull++;
+	  s->nleft += nitems;
+	  if (s->nwaiting > 0 && pthread_cond_signal(&s->work_cond) != 0) { pthread_mutex_unlock(&s->mutex); ESL_EXCEPTION(eslESYS, "cond signal failed"); }
+	}
+      else
+	s->freeb[s->nfree++] = b;
+    }
+
+  if (ret_empty != NULL)
+    {
+      while (s->nfree == 0)
+	if (pthread_cond_wait(&s->free_cond, &s->mutex) != 0) { pthread_mutex_unlock(&s->mutex); ESL_EXCEPTION(eslESYS, "cond wait failed"); }
+      *ret_empty = s->blk[s->freeb[--s->nfree]];
+    }
+
+  if (pthread_mutex_unlock(&s->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex unlock failed");
+  return eslOK;
+}
+
+/* Function:  p7_scheduler_ReaderFinish()
+ * Synopsis:  Tell the workers there are no more blocks.
+ *
+ * Purpose:   The reader has handed over its last block. Once the
+ *            workers have taken all the items that are left, their
+ *            <p7_scheduler_WorkerUpdate()> calls return <eslEOD>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslESYS> if the mutex or a condition variable fails.
+ */
+int
+p7_scheduler_ReaderFinish(P7_SCHEDULER *s)
+{
+  if (pthread_mutex_lock(&s->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex lock failed");
+
+  s->reader_done = TRUE;
+  if (pthread_cond_broadcast(&s->work_cond) != 0) { pthread_mutex_unlock(&s->mutex); ESL_EXCEPTION(eslESYS, "cond broadcast failed"); }
+
+  if (pthread_mutex_unlock(&s->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex unlock failed");
+  return eslOK;
+}
+/*------------------ end, the reader's side ---------------------*/
+
+
+
+/*****************************************************************
+ * 3. The workers' side.
+ *****************************************************************/
+
+/* steal()
+ * Worker <w>'s deque is empty. Find the largest deque of another
+ * worker and move its top half to <w>'s deque. Return TRUE if there
+ * was anything to steal. Caller holds the mutex.
+ */
+static int
+steal(P7_SCHEDULER *s, int w)
+{
+  P7_SCHED_RANGE *v   = NULL;
+  int             len = 0;
+  int             u, k;
+
+  for (u = 0; u < s->nworkers; u++)
+    if (u != w && s->dq[u].hi - s->dq[u].lo > len)
+      {
+	v   = &(s->dq[u]);
+	len = v->hi - v->lo;
+      }
+  if (v == NULL) return FALSE;
+
+  k = (len + 1) / 2;
+  s->dq[w].blk = v->blk;
+  s->dq[w].b   = v->b;
+  s->dq[w].lo  = v->hi - k;
+  s->dq[w].hi  = v->hi;
+  v->hi       -= k;
+  return TRUE;
+}
+
+/* Function:  p7_scheduler_WorkerUpdate()
+ * Synopsis:  Finish a range of items and get the next one.
+ *
+ * Purpose:   Worker <w> has finished the items in <r> (if <r->blk> is
+ *            non-<NULL>); if they were the last unfinished items of
+ *            their block, the block goes back to the reader. Then get
+ *            the worker its next items, and return them in <r>: from
+ *            its own deque; or from the next block the reader filled;
+ *            or stolen from another worker's deque; or else wait for
+ *            the reader.
+ *
+ *            A worker starts with <r->blk> set to <NULL>, and loops
+ *            while this returns <eslOK>, working on items
+ *            <r->lo..r->hi-1> of block <r->blk>.
+ *
+ * Returns:   <eslOK> on success: <r> has the next items.
+ *            <eslEOD> if there are no more items, and the reader has
+ *            called <p7_scheduler_ReaderFinish()>; <r->blk> is
+ *            <NULL>.
+ *
+ * Throws:    <eslESYS> if the mutex or a condition variable fails.
+ */
+int
+p7_scheduler_WorkerUpdate(P7_SCHEDULER *s, int w, P7_SCHED_RANGE *r)
+{
+  P7_SCHED_RANGE *d = &(s->dq[w]);
+  int             b;
+  int64_t         g;
+
+  if (pthread_mutex_lock(&s->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex lock failed");
+
+  if (r->blk != NULL)
+    {
+      s->pending[r->b] -= r->hi - r->lo;
+      if (s->pending[r->b] == 0)
+	{
+	  s->freeb[s->nfree++] = r->b;
+	  if (pthread_cond_signal(&s->free_cond) != 0) { pthread_mutex_unlock(&s->mutex); ESL_EXCEPTION(eslESYS, "cond signal failed"); }
+	}
+      r->blk = NULL;
+    }
+
+  for (;;)
+    {
+      if (d->lo < d->hi)
+	{
+	  g = s->nleft / (2 * s->nworkers);
+	  g = ESL_MAX(g, 1);
+	  g = ESL_MIN(g, d->hi - d->lo);
+
+	  r->blk = d->blk;
+	  r->b   = d->b;
+	  r->lo  = d->lo;
+	  r->hi  = d->lo + g;
+	  d->lo += g;
+	  s->nleft -= g;
+
+	  /* the rest of the deque can be stolen */
+	  if (d->lo < d->hi && s->nwaiting > 0 && pthread_cond_signal(&s->work_cond) != 0) { pthread_mutex_unlock(&s->mutex); ESL_EXCEPTION(eslESYS, "cond signal failed"); }
+	  break;
+	}
+
+      if (s->nfull > 0)
+	{
+	  b = s->fullq[s->fhead];
+	  s->fhead = (s->fhead + 1) % s->nblocks;
+	  s->nfull--;
+
+	  d->blk = s->blk[b];
+	  d->b   = b;
+	  d->lo  = 0;
+	  d->hi  = s->count[b];
+	  continue;
+	}
+
+      if (steal(s, w)) continue;
+
+      if (s->reader_done) break;
+
+      s->nwaiting++;
+      if (pthread_cond_wait(&s->work_cond, &s->mutex) != 0) { s->nwaiting--; pthread_mutex_unlock(&s->mutex); ESL_EXCEPTION(eslESYS, "cond wait failed"); }
+      s->nwaiting--;
+    }
+
+  if (pthread_mutex_unlock(&s->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex unlock failed");
+  return (r->blk == NULL ? eslEOD : eslOK);
+}
+/*------------------ end, the workers' side ---------------------*/
+
+
+
+/*****************************************************************
+ * 4. Unit tests.
+ *****************************************************************/
+#ifdef p7SCHEDULER_TESTDRIVE
+#include "esl_random.h"
+
+/* A block of items for the tests: item i is number id[i]. */
+typedef struct {
+  int   count;
+  int  *id;
+} UTEST_BLOCK;
+
+typedef struct {
+  P7_SCHEDULER *s;
+  int           w;
+  int          *seen;		/* [id] times this worker did item id */
+  int           nranges;	/* ranges this worker got             */
+} UTEST_WORKER;
+
+static void *
+utest_worker(void *arg)
+{
+  UTEST_WORKER    *wk = (UTEST_WORKER *) arg;
+  P7_SCHED_RANGE   r;
+  UTEST_BLOCK     *blk;
+  volatile double  x = 0.;
+  int              i, j;
+
+  r.blk = NULL;
+  while (p7_scheduler_WorkerUpdate(wk->s, wk->w, &r) == eslOK)
+    {
+      blk = (UTEST_BLOCK *) r.blk;
+      for (i = r.lo; i < r.hi; i++)
+	{
+	  /* every 64th item is slow, so workers fall out of step */
+	  if (blk->id[i] % 64 == 0) for (j = 0; j < 100000; j++) x += j;
+	  wk->seen[blk->id[i]]++;
+	}
+      wk->nranges++;
+    }
+  return NULL;
+}
+
+/* utest_exactly_once()
+ *
+ * A reader hands <N> items to <nworkers> workers, in blocks of up to
+ * <B> items (of random size, some of them empty); all <N> items must
+ * be done exactly once. Then again, after a reset, for the same
+ * scheduler.
+ */
+static void
+utest_exactly_once(ESL_RANDOMNESS *rng, int nworkers, int N, int B)
+{
+  char           msg[]  = "scheduler exactly_once unit test failed";
+  P7_SCHEDULER  *s      = p7_scheduler_Create(nworkers);
+  UTEST_BLOCK   *blk    = NULL;
+  UTEST_WORKER  *wk     = malloc(sizeof(UTEST_WORKER) * nworkers);
+  pthread_t     *tid    = malloc(sizeof(pthread_t)    * nworkers);
+  void          *p;
+  int            run, w, n, i;
+
+  if (s == NULL) esl_fatal(msg);
+  for (i = 0; i < 2 * nworkers; i++)
+    {
+      blk = malloc(sizeof(UTEST_BLOCK));
+      blk->id = malloc(sizeof(int) * B);
+      if (p7_scheduler_Add(s, blk) != eslOK) esl_fatal(msg);
+    }
+
+  for (run = 0; run < 2; run++)
+    {
+      for (w = 0; w < nworkers; w++)
+	{
+	  wk[w].s       = s;
+	  wk[w].w       = w;
+	  wk[w].seen    = calloc(N, sizeof(int));
+	  wk[w].nranges = 0;
+	  if (pthread_create(&tid[w], NULL, utest_worker, &wk[w]) != 0) esl_fatal(msg);
+	}
+
+      if (p7_scheduler_ReaderUpdate(s, NULL, 0, &p) != eslOK) esl_fatal(msg);
+      for (n = 0; n < N; )
+	{
+	  blk = (UTEST_BLOCK *) p;
+	  blk->count = ESL_MIN(esl_rnd_Roll(rng, B+1), N-n);
+	  for (i = 0; i < blk->count; i++) blk->id[i] = n++;
+	  if (p7_scheduler_ReaderUpdate(s, blk, blk->count, (n < N ? &p : NULL)) != eslOK) esl_fatal(msg);
+	}
+      if (p7_scheduler_ReaderFinish(s) != eslOK) esl_fatal(msg);
+
+      for (w = 0; w < nworkers; w++)
+	if (pthread_join(tid[w], NULL) != 0) esl_fatal(msg);
+
+      for (w = 1; w < nworkers; w++)
+	for (i = 0; i < N; i++) wk[0].seen[i] += wk[w].seen[i];
+      for (i = 0; i < N; i++)
+	if (wk[0].seen[i] != 1) esl_fatal("%s: item %d done %d times", msg, i, wk[0].seen[i]);
+
+      /* every block must have come back to the reader */
+      if (s->nfree != s->nblocks || s->nleft != 0) esl_fatal(msg);
+
+      for (w = 0; w < nworkers; w++) free(wk[w].seen);
+      if (p7_scheduler_Reset(s) != eslOK) esl_fatal(msg);
+    }
+
+  while (p7_scheduler_Remove(s, &p) == eslOK)
+    {
+      free(((UTEST_BLOCK *) p)->id);
+      free(p);
+    }
+  p7_scheduler_Destroy(s);
+  free(wk);
+  free(tid);
+}
+
+/* utest_split()
+ *
+ * With one worker and one block of <B> items, the worker's grains
+ * shrink as the work left shrinks: they never grow, and the last one
+ * is a single item.
+ */
+static void
+utest_split(int B)
+{
+  char           msg[] = "scheduler split unit test failed";
+  P7_SCHEDULER  *s     = p7_scheduler_Create(1);
+  UTEST_BLOCK    blk;
+  P7_SCHED_RANGE r;
+  void          *p;
+  int            last  = B;
+  int            ndone = 0;
+
+  blk.count = B;
+  blk.id    = NULL;
+  if (s == NULL || p7_scheduler_Add(s, &blk)          != eslOK) esl_fatal(msg);
+  if (p7_scheduler_ReaderUpdate(s, NULL, 0, &p)       != eslOK) esl_fatal(msg);
+  if (p != &blk)                                                esl_fatal(msg);
+  if (p7_scheduler_ReaderUpdate(s, p, blk.count, NULL) != eslOK) esl_fatal(msg);
+  if (p7_scheduler_ReaderFinish(s)                     != eslOK) esl_fatal(msg);
+
+  r.blk = NULL;
+  while (p7_scheduler_WorkerUpdate(s, 0, &r) == eslOK)
+    {
+      if (r.blk != &blk || r.lo != ndone) esl_fatal(msg);
+      if (r.hi - r.lo < 1 || r.hi - r.lo > last) esl_fatal(msg);
+      last   = r.hi - r.lo;
+      ndone  = r.hi;
+    }
+  if (ndone != B || last != 1) esl_fatal(msg);
+
+  p7_scheduler_Destroy(s);
+}
+#endif /*p7SCHEDULER_TESTDRIVE*/
+/*--------------------- end, unit tests -------------------------*/
+
+
+
+/*****************************************************************
+ * 5. Test driver.
+ *****************************************************************/
+#ifdef p7SCHEDULER_TESTDRIVE
+/*
+   gcc -g -Wall -pthread -I. -L. -I../easel -L../easel -Dp7SCHEDULER_TESTDRIVE -o p7_scheduler_utest p7_scheduler.c -lhmmer -leasel -lm
+   ./p7_scheduler_utest
+ */
+#include "easel.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",           0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                  0 },
+  { "-B",        eslARG_INT,    "100", NULL, "n>0", NULL,  NULL, NULL, "maximum number of items in a block",             0 },
+  { "-N",        eslARG_INT,  "10000", NULL, "n>0", NULL,  NULL, NULL, "number of items",                                0 },
+  { "-W",        eslARG_INT,      "4", NULL, "n>0", NULL,  NULL, NULL, "number of worker threads",                       0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for the work-stealing scheduler";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go  = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  int             B   = esl_opt_GetInteger(go, "-B");
+  int             N   = esl_opt_GetInteger(go, "-N");
+  int             W   = esl_opt_GetInteger(go, "-W");
+
+  utest_exactly_once(rng, W, N, B);
+  utest_exactly_once(rng, 1, N, B);   /* nothing to steal from */
+  utest_exactly_once(rng, W, W, 1);   /* fewer items than blocks */
+  utest_split(B);
+
+  esl_randomness_Destroy(rng);
+  esl_getopts_Destroy(go);
+  return eslOK;
+}
+#endif /*p7SCHEDULER_TESTDRIVE*/
+/*--------------------- end, test driver ------------------------*/
+
+#else  /*!HMMER_THREADS*/
+/* The scheduler needs threads; without them the test passes trivially. */
+#ifdef p7SCHEDULER_TESTDRIVE
+int main(void) { return 0; }
+#endif
+#endif /*HMMER_THREADS*/
@@ -0,0 +1,53 @@
+/* A work-stealing scheduler for the threaded search programs.
+ */
+#ifndef P7_SCHEDULER_INCLUDED
+#define P7_SCHEDULER_INCLUDED
+
+#include "p7_config.h"
+
+#ifdef HMMER_THREADS
+#include <stdint.h>
+#include <pthread.h>
+
+/* A run of items [lo..hi-1] in one block. */
+typedef struct {
+  void            *blk;          /* block the items belong to; NULL if none  */
+  int              b;            /* slot of <blk> in the scheduler           */
+  int              lo, hi;       /* items lo..hi-1 of <blk>                  */
+} P7_SCHED_RANGE;
+
+typedef struct {
+  pthread_mutex_t  mutex;        /* protects everything below                */
+  pthread_cond_t   work_cond;    /* workers wait here for items              */
+  pthread_cond_t   free_cond;    /* the reader waits here for an empty block */
+
+  void           **blk;          /* all blocks [0..nblocks-1]                */
+  int             *count;        /* [b] number of items the reader put in b  */
+  int             *pending;      /* [b] items of b not yet finished          */
+  int              nblocks;      /* number of blocks                         */
+  int              balloc;       /* allocated size of the block arrays       */
+
+  int             *freeb;        /* stack of empty block slots [0..nfree-1]  */
+  int              nfree;
+  int             *fullq;        /* ring of filled, unclaimed block slots    */
+  int              fhead;        /* first of them                            */
+  int              nfull;        /* how many                                 */
+
+  P7_SCHED_RANGE  *dq;           /* [w] worker w's deque                     */
+  int              nworkers;
+  int              nwaiting;     /* workers waiting on <work_cond>           */
+  int64_t          nleft;        /* items filled but not yet handed out      */
+  int              reader_done;  /* TRUE once the reader has no more blocks  */
+} P7_SCHEDULER;
+
+extern P7_SCHEDULER *p7_scheduler_Create(int nworkers);
+extern int           p7_scheduler_Add         (P7_SCHEDULER *s, void *blk);
+extern int           p7_scheduler_Reset       (P7_SCHEDULER *s);
+extern int           p7_scheduler_Remove      (P7_SCHEDULER *s, void **ret_blk);
+extern int           p7_scheduler_ReaderUpdate(P7_SCHEDULER *s, void *full, int nitems, void **ret_empty);
+extern int           p7_scheduler_ReaderFinish(P7_SCHEDULER *s);
+extern int           p7_scheduler_WorkerUpdate(P7_SCHEDULER *s, int w, P7_SCHED_RANGE *r);
+extern void          p7_scheduler_Destroy     (P7_SCHEDULER *s);
+
+#endif /*HMMER_THREADS*/
+#endif /*P7_SCHEDULER_INCLUDED*/
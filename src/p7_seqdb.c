@@ -0,0 +1,678 @@
+/* P7_SEQDB: a pre-digitized, memory-mapped target sequence database.
+ *
+ * Every search reads its target database as text, and parses and
+ * digitizes every residue again; for big databases searched many
+ * times, that's all overhead. makehmmerseqdb does it once, and
+ * writes a binary file of digital sequences that hmmsearch, phmmer,
+ * and jackhmmer map into memory and read without any parsing.
+ *
+ * The file is:
+ *    P7_SEQDB_HEADER           at offset 0
+ *    residues                  one digital sequence after another,
+ *                              each with its sentinels, dsq[1] aligned
+ *                              to p7_SEQDB_ALIGN bytes; sentinels pad
+ *                              the gaps.
+ *    P7_SEQDB_ENTRY idx[]      offset and length of each sequence,
+ *                              and offsets of its name, accession and
+ *                              description in the text
+ *    text                      NUL-terminated strings; the text starts
+ *                              with an empty one, for missing fields.
+ *
+ * Sequences are read as views: ESL_SQ's whose <dsq>, <name>, <acc>
+ * and <desc> point into the file. Views are read-only, and have to be
+ * created and destroyed with the functions here, not the usual
+ * esl_sq_*() ones.
+ *
+ * Contents:
+ *   1. Writing a database.
+ *   2. Opening and closing a database.
+ *   3. Reading sequences as views into the file.
+ *   4. Unit tests.
+ *   5. Test driver.
+ */
+#include "p7_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_sq.h"
+#include "esl_sqio.h"
+
+#include "hmmer.h"
+#include "p7_seqdb.h"
+
+static uint32_t  seqdb_magic = 0xe8f3f1b1; /* "hsq1" + 0x80808080 */
+static uint32_t  seqdb_swap  = 0xb1f1f3e8; /* byteswapped         */
+
+static int  write_pad (FILE *ofp, uint64_t *pos, int align, int want);
+static int  copy_file (FILE *src, FILE *dst, uint64_t *pos);
+static void seq_view  (const P7_SEQDB *db, int64_t i, ESL_SQ *sq);
+static void seq_init  (ESL_SQ *sq, const ESL_ALPHABET *abc);
+
+
+/*****************************************************************
+ * 1. Writing a database.
+ *****************************************************************/
+
+/* Function:  p7_seqdb_Write()
+ * Synopsis:  Write a pre-digitized database of the sequences in a file.
+ *
+ * Purpose:   Read all the sequences of <sqfp>, which must be open in
+ *            digital mode, and write them to <ofp> as a P7_SEQDB
+ *            file. <ofp> must be a file that can be repositioned,
+ *            because the header is written last. If <opt_nseq> or
+ *            <opt_nres> aren't <NULL>, return the number of sequences
+ *            and residues in them.
+ *
+ *            The index and text are kept in temporary files until
+ *            the residues are written, so memory use doesn't grow
+ *            with the size of the database.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ *            <eslEFORMAT> if <sqfp> can't be parsed; <eslEWRITE> if a
+ *            write fails. <errbuf> has a message.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_seqdb_Write(ESL_SQFILE *sqfp, FILE *ofp, int64_t *opt_nseq, int64_t *opt_nres, char *errbuf)
+{
+  P7_SEQDB_HEADER  hdr;
+  P7_SEQDB_ENTRY   e;
+  ESL_SQ          *sq       = NULL;
+  FILE            *ifp      = NULL;   /* index, until the residues are written */
+  FILE            *tfp      = NULL;   /* text, ditto                           */
+  char             itmp[16] = "p7sqiXXXXXX";
+  char             ttmp[16] = "p7sqtXXXXXX";
+  uint64_t         pos      = 0;      /* current offset in <ofp>               */
+  uint64_t         tpos     = 0;      /* current offset in the text            */
+  int              status;
+
+  if (errbuf) errbuf[0] = '\0';
+  if (sqfp->abc == NULL) ESL_XFAIL(eslEINVAL, errbuf, "sequence file isn't open in digital mode");
+  if ((sq = esl_sq_CreateDigital(sqfp->abc)) == NULL) { status = eslEMEM; goto ERROR; }
+
+  if (esl_tmpfile(itmp, &ifp) != eslOK) ESL_XFAIL(eslEWRITE, errbuf, "failed to open a temporary file for the index");
+  if (esl_tmpfile(ttmp, &tfp) != eslOK) ESL_XFAIL(eslEWRITE, errbuf, "failed to open a temporary file for the text");
+
+  memset(&hdr, 0, sizeof(P7_SEQDB_HEADER));
+  hdr.magic   = seqdb_magic;
+  hdr.abctype = sqfp->abc->type;
+  if (fwrite(&hdr, sizeof(P7_SEQDB_HEADER), 1, ofp) != 1) ESL_XFAIL(eslEWRITE, errbuf, "failed to write header");
+  pos += sizeof(P7_SEQDB_HEADER);
+
+  if (fputc('\0', tfp) == EOF) ESL_XFAIL(eslEWRITE, errbuf, "failed to write text");  /* txt[0] is "" */
+  tpos = 1;
+
+  while ((status = esl_sqio_Read(sqfp, sq)) == eslOK)
+    {
+      /* residues: dsq[1] on an aligned boundary */
+      if ((status = write_pad(ofp, &pos, p7_SEQDB_ALIGN, p7_SEQDB_ALIGN-1)) != eslOK) ESL_XFAIL(status, errbuf, "failed to write residues");
+      e.doff = pos;
+      e.L    = sq->n;
+      if (fwrite(sq->dsq, sizeof(ESL_DSQ), sq->n+2, ofp) != (size_t) sq->n+2)      ESL_XFAIL(eslEWRITE, errbuf, "failed to write residues");
+      pos += sq->n + 2;
+
+      /* text */
+      e.name = tpos;
+      if (fwrite(sq->name, 1, strlen(sq->name)+1, tfp) != strlen(sq->name)+1)     ESL_XFAIL(eslEWRITE, errbuf, "failed to write text");
+      tpos  += strlen(sq->name)+1;
+      if (sq->acc[0] != '\0') {
+	e.acc = tpos;
+	if (fwrite(sq->acc, 1, strlen(sq->acc)+1, tfp) != strlen(sq->acc)+1)      ESL_XFAIL(eslEWRITE, errbuf, "failed to write text");
+	tpos += strlen(sq->acc)+1;
+      } else e.acc = 0;
+      if (sq->desc[0] != '\0') {
+	e.desc = tpos;
+	if (fwrite(sq->desc, 1, strlen(sq->desc)+1, tfp) != strlen(sq->desc)+1)   ESL_XFAIL(eslEWRITE, errbuf, "failed to write text");
+	tpos += strlen(sq->desc)+1;
+      } else e.desc = 0;
+
+      if (fwrite(&e, sizeof(P7_SEQDB_ENTRY), 1, ifp) != 1)                         ESL_XFAIL(eslEWRITE, errbuf, "failed to write index");
+      hdr.nseq++;
+      hdr.nres += sq->n;
+      esl_sq_Reuse(sq);
+    }
+  if      (status == eslEFORMAT) ESL_XFAIL(status, errbuf, "Parse failed (sequence file %s):\n%s", sqfp->filename, esl_sqfile_GetErrorBuf(sqfp));
+  else if (status != eslEOF)     ESL_XFAIL(status, errbuf, "Unexpected error %d reading sequence file %s", status, sqfp->filename);
+
+  /* index, then text */
+  if ((status = write_pad(ofp, &pos, sizeof(uint64_t), 0)) != eslOK) ESL_XFAIL(status, errbuf, "failed to write index");
+  hdr.idxoff = pos;
+  if ((status = copy_file(ifp, ofp, &pos)) != eslOK)                 ESL_XFAIL(status, errbuf, "failed to write index");
+  hdr.txtoff  = pos;
+  hdr.txtsize = tpos;
+  if ((status = copy_file(tfp, ofp, &pos)) != eslOK)                 ESL_XFAIL(status, errbuf, "failed to write text");
+  hdr.fsize = pos;
+
+  if (fseeko(ofp, 0, SEEK_SET) != 0)                       ESL_XFAIL(eslEWRITE, errbuf, "failed to rewind the output to write its header");
+  if (fwrite(&hdr, sizeof(P7_SEQDB_HEADER), 1, ofp) != 1)  ESL_XFAIL(eslEWRITE, errbuf, "failed to write header");
+  if (fflush(ofp) != 0)                                    ESL_XFAIL(eslEWRITE, errbuf, "failed to write database");
+
+  if (opt_nseq) *opt_nseq = hdr.nseq;
+  if (opt_nres) *opt_nres = hdr.nres;
+  fclose(ifp);
+  fclose(tfp);
+  esl_sq_Destroy(sq);
+  return eslOK;
+
+ ERROR:
+  if (opt_nseq) *opt_nseq = 0;
+  if (opt_nres) *opt_nres = 0;
+  if (ifp) fclose(ifp);
+  if (tfp) fclose(tfp);
+  if (sq)  esl_sq_Destroy(sq);
+  return status;
+}
+
+/* write_pad()
+ * Write sentinels to <ofp> until <*pos> % <align> == <want>.
+ */
+static int
+write_pad(FILE *ofp, uint64_t *pos, int align, int want)
+{
+  while (*pos % align != (uint64_t) want)
+    {
+      if (fputc(eslDSQ_SENTINEL, ofp) == EOF) return eslEWRITE;
+      (*pos)++;
+    }
+  return eslOK;
+}
+
+/* copy_file()
+ * Append all of <src> to <dst>, adding its size to <*pos>.
+ */
+static int
+copy_file(FILE *src, FILE *dst, uint64_t *pos)
+{
+  char   buf[65536];
+  size_t n;
+
+  if (fseeko(src, 0, SEEK_SET) != 0) return eslEWRITE;
+  while ((n = fread(buf, 1, sizeof(buf), src)) > 0)
+    {
+      if (fwrite(buf, 1, n, dst) != n) return eslEWRITE;
+      *pos += n;
+    }
+  return (ferror(src) ? eslEWRITE : eslOK);
+}
+/*--------------------- end, writing ----------------------------*/
+
+
+
+/*****************************************************************
+ * 2. Opening and closing a database.
+ *****************************************************************/
+
+/* Function:  p7_seqdb_Open()
+ * Synopsis:  Open a pre-digitized sequence database.
+ *
+ * Purpose:   Open the P7_SEQDB file <filename>, and map it into memory
+ *            (or, on systems without <mmap()>, read it all in).
+ *            Pages of a mapped file are shared by all the processes
+ *            that map it, and stay in the page cache from one search
+ *            to the next.
+ *
+ * Returns:   <eslOK> on success, and <*ret_db> is the database.
+ *
+ *            <eslENOTFOUND> if the file can't be opened.
+ *
+ *            <eslEFORMAT> if the file isn't a P7_SEQDB database, so
+ *            the caller can try to open it as a sequence file.
+ *
+ *            <eslEINCOMPAT> if it is one, but was written on a
+ *            machine of different byte order, or is truncated or
+ *            corrupt.
+ *
+ *            On any error, <*ret_db> is <NULL> and <errbuf> has a
+ *            message.
+ *
+ * Throws:    <eslEMEM> on allocation failure; <eslESYS> if the file
+ *            can't be mapped.
+ */
+int
+p7_seqdb_Open(const char *filename, P7_SEQDB **ret_db, char *errbuf)
+{
+  P7_SEQDB        *db  = NULL;
+  FILE            *fp  = NULL;
+  P7_SEQDB_HEADER  hdr;
+  off_t            fsize;
+  int              status;
+
+  if (errbuf) errbuf[0] = '\0';
+  *ret_db = NULL;
+
+  if ((fp = fopen(filename, "rb")) == NULL)                   ESL_XFAIL(eslENOTFOUND, errbuf, "couldn't open %s for reading", filename);
+  if (fread(&hdr, sizeof(P7_SEQDB_HEADER), 1, fp) != 1)       ESL_XFAIL(eslEFORMAT,   errbuf, "%s isn't a pre-digitized sequence database", filename);
+  if (hdr.magic == seqdb_swap)                                ESL_XFAIL(eslEINCOMPAT, errbuf, "%s was written on a machine of different byte order; rebuild it with makehmmerseqdb", filename);
+  if (hdr.magic != seqdb_magic)                               ESL_XFAIL(eslEFORMAT,   errbuf, "%s isn't a pre-digitized sequence database", filename);
+
+  if (fseeko(fp, 0, SEEK_END) != 0 || (fsize = ftello(fp)) < 0) ESL_XFAIL(eslESYS, errbuf, "failed to find the size of %s", filename);
+  if ((uint64_t) fsize != hdr.fsize ||
+      hdr.idxoff + hdr.nseq * sizeof(P7_SEQDB_ENTRY) > hdr.txtoff ||
+      hdr.txtoff + hdr.txtsize > hdr.fsize || hdr.txtsize == 0)
+    ESL_XFAIL(eslEINCOMPAT, errbuf, "%s is truncated or corrupt", filename);
+
+  ESL_ALLOC(db, sizeof(P7_SEQDB));
+  db->filename  = NULL;
+  db->abctype   = hdr.abctype;
+  db->nseq      = hdr.nseq;
+  db->nres      = hdr.nres;
+  db->idx       = NULL;
+  db->txt       = NULL;
+  db->next      = 0;
+  db->mem       = NULL;
+  db->memsize   = hdr.fsize;
+  db->is_mapped = FALSE;
+  if ((status = esl_strdup(filename, -1, &(db->filename))) != eslOK) goto ERROR;
+
+#ifdef HAVE_MMAP
+  db->mem = mmap(NULL, db->memsize, PROT_READ, MAP_SHARED, fileno(fp), 0);
+  if (db->mem == MAP_FAILED) { db->mem = NULL; ESL_XFAIL(eslESYS, errbuf, "failed to map %s into memory", filename); }
+  db->is_mapped = TRUE;
+#else
+  ESL_ALLOC(db->mem, db->memsize);
+  if (fseeko(fp, 0, SEEK_SET) != 0 || fread(db->mem, 1, db->memsize, fp) != db->memsize) ESL_XFAIL(eslESYS, errbuf, "failed to read %s", filename);
+#endif
+
+  db->idx = (const P7_SEQDB_ENTRY *) ((char *) db->mem + hdr.idxoff);
+  db->txt = (const char *)           ((char *) db->mem + hdr.txtoff);
+
+  fclose(fp);
+  *ret_db = db;
+  return eslOK;
+
+ ERROR:
+  if (fp) fclose(fp);
+  p7_seqdb_Close(db);
+  return status;
+}
+
+/* Function:  p7_seqdb_Close()
+ * Synopsis:  Close a pre-digitized sequence database.
+ *
+ * Purpose:   Unmap and free <db>. Views into it can't be used after
+ *            this.
+ */
+void
+p7_seqdb_Close(P7_SEQDB *db)
+{
+  if (db)
+    {
+#ifdef HAVE_MMAP
+      if (db->mem && db->is_mapped) munmap(db->mem, db->memsize);
+#endif
+      if (db->mem && ! db->is_mapped) free(db->mem);
+      if (db->filename) free(db->filename);
+      free(db);
+    }
+}
+/*---------------- end, opening and closing ---------------------*/
+
+
+
+/*****************************************************************
+ * 3. Reading sequences as views into the file.
+ *****************************************************************/
+
+/* Function:  p7_seqdb_CreateSeq()
+ * Synopsis:  Create an empty sequence view.
+ *
+ * Purpose:   Create an <ESL_SQ> for <p7_seqdb_Read()> to point into a
+ *            database of alphabet <abc>. It owns no memory besides
+ *            itself: don't <esl_sq_Reuse()> or <esl_sq_Destroy()> it;
+ *            free it with <p7_seqdb_DestroySeq()>.
+ *
+ * Returns:   the new view.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+ESL_SQ *
+p7_seqdb_CreateSeq(const ESL_ALPHABET *abc)
+{
+  ESL_SQ *sq = NULL;
+  int     status;
+
+  ESL_ALLOC(sq, sizeof(ESL_SQ));
+  seq_init(sq, abc);
+  return sq;
+
+ ERROR:
+  return NULL;
+}
+
+/* Function:  p7_seqdb_DestroySeq()
+ * Synopsis:  Free a sequence view.
+ */
+void
+p7_seqdb_DestroySeq(ESL_SQ *sq)
+{
+  if (sq) free(sq);
+}
+
+/* Function:  p7_seqdb_CreateBlock()
+ * Synopsis:  Create a block of sequence views.
+ *
+ * Purpose:   Create an <ESL_SQ_BLOCK> of room for <count> views, for
+ *            <p7_seqdb_ReadBlock()>. Like the views themselves, it
+ *            has to be freed with <p7_seqdb_DestroyBlock()>, and its
+ *            sequences can't be reused.
+ *
+ * Returns:   the new block.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+ESL_SQ_BLOCK *
+p7_seqdb_CreateBlock(int count, const ESL_ALPHABET *abc)
+{
+  ESL_SQ_BLOCK *block = NULL;
+  int           i;
+  int           status;
+
+  ESL_ALLOC(block, sizeof(ESL_SQ_BLOCK));
+  memset(block, 0, sizeof(ESL_SQ_BLOCK));
+  block->count        = 0;
+  block->first_seqidx = -1;
+  block->listSize     = count;
+  block->complete     = TRUE;
+
+  ESL_ALLOC(block->list, sizeof(ESL_SQ) * count);
+  for (i = 0; i < count; i++) seq_init(block->list + i, abc);
+  return block;
+
+ ERROR:
+  p7_seqdb_DestroyBlock(block);
+  return NULL;
+}
+
+/* Function:  p7_seqdb_DestroyBlock()
+ * Synopsis:  Free a block of sequence views.
+ */
+void
+p7_seqdb_DestroyBlock(ESL_SQ_BLOCK *block)
+{
+  if (block)
+    {
+      if (block->list) free(block->list);
+      free(block);
+    }
+}
+
+/* Function:  p7_seqdb_Read()
+ * Synopsis:  Read the next sequence of a database.
+ *
+ * Purpose:   Point the view <sq> at the next sequence of <db>. Its
+ *            <idx> is the sequence's index in the database.
+ *
+ * Returns:   <eslOK> on success; <eslEOF> if there are no more
+ *            sequences.
+ */
+int
+p7_seqdb_Read(P7_SEQDB *db, ESL_SQ *sq)
+{
+  if (db->next >= db->nseq) return eslEOF;
+  seq_view(db, db->next++, sq);
+  return eslOK;
+}
+
+/* Function:  p7_seqdb_ReadBlock()
+ * Synopsis:  Read the next block of sequences of a database.
+ *
+ * Purpose:   Point the views of <block> at the next sequences of
+ *            <db>: as many as it holds, or up to <max_sequences> if
+ *            that isn't -1. The counterpart of
+ *            <esl_sqio_ReadBlock()>, with no parsing at all.
+ *
+ * Returns:   <eslOK> on success; <eslEOF> if there are no more
+ *            sequences, and <block->count> is 0.
+ */
+int
+p7_seqdb_ReadBlock(P7_SEQDB *db, ESL_SQ_BLOCK *block, int max_sequences)
+{
+  int64_t n = ESL_MIN(block->listSize, db->nseq - db->next);
+  int     i;
+
+  if (max_sequences >= 0) n = ESL_MIN(n, max_sequences);
+
+  block->count        = n;
+  block->first_seqidx = db->next;
+  block->complete     = TRUE;
+  for (i = 0; i < n; i++)
+    seq_view(db, db->next++, block->list + i);
+  return (n > 0 ? eslOK : eslEOF);
+}
+
+/* Function:  p7_seqdb_Position()
+ * Synopsis:  Reposition a database to sequence <i>.
+ *
+ * Purpose:   Make sequence <i> (0..nseq-1) the next one read from
+ *            <db>; 0 rewinds it.
+ *
+ * Returns:   <eslOK> on success; <eslEINVAL> if <i> is out of range.
+ */
+int
+p7_seqdb_Position(P7_SEQDB *db, int64_t i)
+{
+  if (i < 0 || i > db->nseq) return eslEINVAL;
+  db->next = i;
+  return eslOK;
+}
+
+/* Function:  p7_seqdb_PositionByKey()
+ * Synopsis:  Reposition a database to a sequence by name.
+ *
+ * Purpose:   Make the first sequence named <key> the next one read
+ *            from <db>. There's no index of names, so this is a
+ *            linear scan, for the occasional --restrictdb_stkey.
+ *
+ * Returns:   <eslOK> on success; <eslENOTFOUND> if there's no such
+ *            sequence, and the position is unchanged.
+ */
+int
+p7_seqdb_PositionByKey(P7_SEQDB *db, const char *key)
+{
+  int64_t i;
+
+  for (i = 0; i < db->nseq; i++)
+    if (strcmp(db->txt + db->idx[i].name, key) == 0) { db->next = i; return eslOK; }
+  return eslENOTFOUND;
+}
+
+/* seq_init()
+ * Initialize a view that points at nothing yet.
+ */
+static void
+seq_init(ESL_SQ *sq, const ESL_ALPHABET *abc)
+{
+  memset(sq, 0, sizeof(ESL_SQ));
+  sq->abc  = abc;
+  sq->idx  = -1;
+  sq->roff = -1;
+  sq->hoff = -1;
+  sq->doff = -1;
+  sq->eoff = -1;
+}
+
+/* seq_view()
+ * Point <sq> at sequence <i> of <db>.
+ */
+static void
+seq_view(const P7_SEQDB *db, int64_t i, ESL_SQ *sq)
+{
+  const P7_SEQDB_ENTRY *e = db->idx + i;
+
+  sq->name   = (char *) db->txt + e->name;
+  sq->acc    = (char *) db->txt + e->acc;
+  sq->desc   = (char *) db->txt + e->desc;
+  sq->source = (char *) db->txt;
+  sq->dsq    = (ESL_DSQ *) ((char *) db->mem + e->doff);
+  sq->n      = e->L;
+  sq->start  = 1;
+  sq->end    = e->L;
+  sq->C      = 0;
+  sq->W      = e->L;
+  sq->L      = e->L;
+  sq->idx    = i;
+}
+/*------------------- end, reading views ------------------------*/
+
+
+
+/*****************************************************************
+ * 4. Unit tests.
+ *****************************************************************/
+#ifdef p7SEQDB_TESTDRIVE
+#include "esl_random.h"
+#include "esl_randomseq.h"
+
+/* utest_roundtrip()
+ *
+ * Write <N> random sequences of length 0..<L> to a FASTA file, press
+ * it into a database, and check that the database gives back the
+ * same sequences, names, accessions and descriptions, with aligned
+ * residues; then that repositioning works, and that the FASTA file
+ * itself isn't taken for a database.
+ */
+static void
+utest_roundtrip(ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, int N, int L)
+{
+  char          msg[]        = "seqdb roundtrip unit test failed";
+  char          seqfile[32]  = "p7seqdbXXXXXX";
+  char          dbfile[32]   = "p7seqdbXXXXXX";
+  char          errbuf[eslERRBUFSIZE];
+  FILE         *fp           = NULL;
+  ESL_SQFILE   *sqfp         = NULL;
+  P7_SEQDB     *db           = NULL;
+  ESL_SQ      **sq           = malloc(sizeof(ESL_SQ *) * N);
+  ESL_SQ_BLOCK *block        = p7_seqdb_CreateBlock(7, abc);
+  ESL_SQ       *view         = p7_seqdb_CreateSeq(abc);
+  float         fq[20];
+  char          buf[32];
+  int64_t       nseq, nres, totres = 0;
+  int           i, n;
+  int           status;
+
+  for (i = 0; i < abc->K; i++) fq[i] = 1.0 / (float) abc->K;
+
+  if (esl_tmpfile_named(seqfile, &fp) != eslOK) esl_fatal(msg);
+  for (i = 0; i < N; i++)
+    {
+      snprintf(buf, 32, "seq%d", i);
+      if ((sq[i] = esl_sq_CreateDigital(abc))                       == NULL)  esl_fatal(msg);
+      if (esl_sq_GrowTo(sq[i], L)                                   != eslOK) esl_fatal(msg);
+      sq[i]->n = esl_rnd_Roll(rng, L+1);
+      if (esl_rsq_xfIID(rng, fq, abc->K, sq[i]->n, sq[i]->dsq)      != eslOK) esl_fatal(msg);
+      if (esl_sq_SetName(sq[i], buf)                                != eslOK) esl_fatal(msg);
+      snprintf(buf, 32, "ACC%d", i);
+      if (i % 2 == 0 && esl_sq_SetAccession(sq[i], buf)             != eslOK) esl_fatal(msg);
+      snprintf(buf, 32, "description %d", i);
+      if (i % 3 == 0 && esl_sq_SetDesc(sq[i], buf)                  != eslOK) esl_fatal(msg);
+      if (esl_sqio_Write(fp, sq[i], eslSQFILE_FASTA, FALSE)         != eslOK) esl_fatal(msg);
+      totres += sq[i]->n;
+    }
+  fclose(fp);
+
+  if (esl_sqfile_OpenDigital(abc, seqfile, eslSQFILE_FASTA, NULL, &sqfp) != eslOK) esl_fatal(msg);
+  if (esl_tmpfile_named(dbfile, &fp)                                     != eslOK) esl_fatal(msg);
+  if (p7_seqdb_Write(sqfp, fp, &nseq, &nres, errbuf)                     != eslOK) esl_fatal("%s: %s", msg, errbuf);
+  if (nseq != N || nres != totres) esl_fatal(msg);
+  fclose(fp);
+  esl_sqfile_Close(sqfp);
+
+  if (p7_seqdb_Open(seqfile, &db, errbuf) != eslEFORMAT) esl_fatal(msg);
+  if (p7_seqdb_Open(dbfile,  &db, errbuf) != eslOK)      esl_fatal("%s: %s", msg, errbuf);
+  if (db->nseq != N || db->nres != totres || db->abctype != abc->type) esl_fatal(msg);
+
+  n = 0;
+  while ((status = p7_seqdb_ReadBlock(db, block, -1)) == eslOK)
+    {
+      if (block->count < 1 || block->count > 7 || block->first_seqidx != n) esl_fatal(msg);
+      for (i = 0; i < block->count; i++, n++)
+	{
+	  if (strcmp(block->list[i].name, sq[n]->name) != 0)                           esl_fatal(msg);
+	  if (strcmp(block->list[i].acc,  sq[n]->acc)  != 0)                           esl_fatal(msg);
+	  if (strcmp(block->list[i].desc, sq[n]->desc) != 0)                           esl_fatal(msg);
+	  if (block->list[i].n != sq[n]->n || block->list[i].idx != n)                 esl_fatal(msg);
+	  if (memcmp(block->list[i].dsq, sq[n]->dsq, sq[n]->n+2) != 0)                 esl_fatal(msg);
+	  if ((uintptr_t) (block->list[i].dsq + 1) % p7_SEQDB_ALIGN != 0)              esl_fatal(msg);
+	}
+    }
+  if (status != eslEOF || n != N) esl_fatal(msg);
+
+  /* reposition, by number and by name; and read one at a time */
+  if (p7_seqdb_Position(db, N+1)                  != eslEINVAL)    esl_fatal(msg);
+  if (p7_seqdb_PositionByKey(db, "nosuchseq")     != eslENOTFOUND) esl_fatal(msg);
+  if (p7_seqdb_Position(db, 0)                    != eslOK)        esl_fatal(msg);
+  for (n = 0; (status = p7_seqdb_Read(db, view)) == eslOK; n++)
+    if (strcmp(view->name, sq[n]->name) != 0) esl_fatal(msg);
+  if (status != eslEOF || n != N) esl_fatal(msg);
+
+  snprintf(buf, 32, "seq%d", N/2);
+  if (p7_seqdb_PositionByKey(db, buf)             != eslOK)        esl_fatal(msg);
+  if (p7_seqdb_ReadBlock(db, block, 1)            != eslOK)        esl_fatal(msg);
+  if (block->count != 1 || strcmp(block->list[0].name, buf) != 0)  esl_fatal(msg);
+
+  p7_seqdb_Close(db);
+  p7_seqdb_DestroySeq(view);
+  p7_seqdb_DestroyBlock(block);
+  for (i = 0; i < N; i++) esl_sq_Destroy(sq[i]);
+  free(sq);
+  remove(seqfile);
+  remove(dbfile);
+}
+#endif /*p7SEQDB_TESTDRIVE*/
+/*--------------------- end, unit tests -------------------------*/
+
+
+
+/*****************************************************************
+ * 5. Test driver.
+ *****************************************************************/
+#ifdef p7SEQDB_TESTDRIVE
+/*
+   gcc -g -Wall -I. -L. -I../easel -L../easel -Dp7SEQDB_TESTDRIVE -o p7_seqdb_utest p7_seqdb.c -lhmmer -leasel -lm
+   ./p7_seqdb_utest
+ */
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",           0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                  0 },
+  { "-L",        eslARG_INT,    "200", NULL, "n>0", NULL,  NULL, NULL, "maximum length of sampled sequences",            0 },
+  { "-N",        eslARG_INT,    "100", NULL, "n>0", NULL,  NULL, NULL, "number of sampled sequences",                    0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for pre-digitized sequence databases";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go  = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *abc = esl_alphabet_Create(eslAMINO);
+  int             L   = esl_opt_GetInteger(go, "-L");
+  int             N   = esl_opt_GetInteger(go, "-N");
+
+  utest_roundtrip(rng, abc, N, L);
+  utest_roundtrip(rng, abc, 1, L);
+
+  esl_alphabet_Destroy(abc);
+  esl_randomness_Destroy(rng);
+  esl_getopts_Destroy(go);
+  return eslOK;
+}
+#endif /*p7SEQDB_TESTDRIVE*/
+/*--------------------- end, test driver ------------------------*/
@@ -0,0 +1,75 @@
+/* P7_SEQDB: a pre-digitized, memory-mapped target sequence database.
+ */
+#ifndef P7_SEQDB_INCLUDED
+#define P7_SEQDB_INCLUDED
+
+#include "p7_config.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_sq.h"
+#include "esl_sqio.h"
+
+#define p7_SEQDB_ALIGN  16     /* dsq[1] of every sequence is aligned to this many bytes */
+
+/* The file starts with this header, followed by the residues, the
+ * index, and the text (names, accessions, descriptions). All integers
+ * are in the byte order of the machine that wrote the file.
+ */
+typedef struct {
+  uint32_t magic;              /* "hsq1" + 0x80808080, in native byte order */
+  uint32_t abctype;            /* alphabet type: eslAMINO, eslDNA...        */
+  uint64_t nseq;               /* number of sequences                       */
+  uint64_t nres;               /* total number of residues                  */
+  uint64_t idxoff;             /* offset of the index, idx[0..nseq-1]       */
+  uint64_t txtoff;             /* offset of the text                        */
+  uint64_t txtsize;            /* size of the text, in bytes                */
+  uint64_t fsize;              /* size of the whole file, in bytes          */
+  uint64_t reserved;
+} P7_SEQDB_HEADER;
+
+/* One index entry per sequence. */
+typedef struct {
+  uint64_t doff;               /* offset of dsq[0] in the file              */
+  int64_t  L;                  /* length of the sequence                    */
+  uint64_t name;               /* offsets of NUL-terminated strings in text */
+  uint64_t acc;
+  uint64_t desc;
+} P7_SEQDB_ENTRY;
+
+typedef struct {
+  char                 *filename;
+  int                   abctype;   /* alphabet type of the residues              */
+  int64_t               nseq;
+  int64_t               nres;
+
+  const P7_SEQDB_ENTRY *idx;       /* [0..nseq-1], in the mapped file            */
+  const char           *txt;       /* text, in the mapped file; txt[0] is '\0'   */
+  int64_t               next;      /* next sequence Read() or ReadBlock() gives  */
+
+  void                 *mem;       /* the whole file                             */
+  uint64_t              memsize;
+  int                   is_mapped; /* TRUE if <mem> is mmap()'ed, FALSE if read  */
+} P7_SEQDB;
+
+/* 1. Writing a database */
+extern int  p7_seqdb_Write(ESL_SQFILE *sqfp, FILE *ofp, int64_t *opt_nseq, int64_t *opt_nres, char *errbuf);
+
+/* 2. Opening and closing */
+extern int  p7_seqdb_Open (const char *filename, P7_SEQDB **ret_db, char *errbuf);
+extern void p7_seqdb_Close(P7_SEQDB *db);
+
+/* 3. Reading sequences as views into the file */
+extern ESL_SQ       *p7_seqdb_CreateSeq    (const ESL_ALPHABET *abc);
+extern void          p7_seqdb_DestroySeq   (ESL_SQ *sq);
+extern ESL_SQ_BLOCK *p7_seqdb_CreateBlock  (int count, const ESL_ALPHABET *abc);
+extern void          p7_seqdb_DestroyBlock (ESL_SQ_BLOCK *block);
+extern int           p7_seqdb_Read         (P7_SEQDB *db, ESL_SQ *sq);
+extern int           p7_seqdb_ReadBlock    (P7_SEQDB *db, ESL_SQ_BLOCK *block, int max_sequences);
+extern int           p7_seqdb_Position     (P7_SEQDB *db, int64_t i);
+extern int           p7_seqdb_PositionByKey(P7_SEQDB *db, const char *key);
+
+#endif /*P7_SEQDB_INCLUDED*/
@@ -0,0 +1,789 @@
+/* Parallel parsing of a target sequence database.
+ *
+ * In the threaded search programs one thread reads the target
+ * database with esl_sqio_ReadBlock(), and at high core counts parsing
+ * and digitizing the file can't keep the workers fed. A P7_SEQREADER
+ * splits the file into chunks at record boundaries, and several
+ * parser threads, each with its own open ESL_SQFILE, parse chunks
+ * into blocks of sequences. The consumer gets the sequences back in
+ * file order, block by block, with p7_seqreader_ReadBlock(), which
+ * works like esl_sqio_ReadBlock(); the output of a search doesn't
+ * depend on how many parsers there were.
+ *
+ * Chunk boundaries come from the file itself for FASTA (a '>' at the
+ * start of a line), or from the SSI index for other formats. A file
+ * that can't be split (compressed, standard input, or without an SSI
+ * index) can't be read this way, and the caller reads it the usual
+ * way.
+ *
+ * Parsers run at most 2 nreaders chunks ahead of the consumer, so the
+ * memory used is bounded by the chunk size, not by the file size.
+ *
+ * Contents:
+ *   1. P7_SEQREADER: opening a file and splitting it into chunks.
+ *   2. Parsing and reading a pass through the file.
+ *   3. Unit tests.
+ *   4. Test driver.
+ */
+#include "p7_config.h"
+
+#ifdef HMMER_THREADS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_sq.h"
+#include "esl_sqio.h"
+#include "esl_ssi.h"
+
+#include "hmmer.h"
+#include "p7_seqreader.h"
+
+static int   fasta_boundary(FILE *fp, off_t pos, off_t *ret_off);
+static int   ssi_boundaries(P7_SEQREADER *rdr, off_t fsize, int nchunks);
+static int   cmp_off(const void *a, const void *b);
+static void *parse_thread(void *arg);
+
+
+/*****************************************************************
+ * 1. P7_SEQREADER: opening a file and splitting it into chunks.
+ *****************************************************************/
+
+/* Function:  p7_seqreader_Open()
+ * Synopsis:  Prepare to parse a sequence file in parallel.
+ *
+ * Purpose:   Prepare to read the sequence file that <dbfp> has open,
+ *            with <nreaders> parser threads, in blocks of up to
+ *            <blocksize> sequences. The file is split into chunks
+ *            of about <chunksize> bytes (<p7_SEQREADER_CHUNKSIZE>,
+ *            if <chunksize> is 0), and into at least <4 nreaders>
+ *            chunks.
+ *
+ *            <dbfp> itself isn't used to read sequences; the parsers
+ *            open the file again, with its name, format, and
+ *            alphabet.
+ *
+ * Returns:   <eslOK> on success, and <*ret_rdr> is the new reader.
+ *
+ *            <eslEINCOMPAT> if the file can't be split: it's
+ *            compressed, or is standard input, or isn't FASTA and
+ *            has no SSI index. <*ret_rdr> is <NULL>; the caller
+ *            reads <dbfp> the usual way.
+ *
+ * Throws:    <eslEMEM> on allocation failure; <eslESYS> on a system
+ *            call or thread initialization failure.
+ */
+int
+p7_seqreader_Open(ESL_SQFILE *dbfp, int nreaders, int blocksize, off_t chunksize, P7_SEQREADER **ret_rdr)
+{
+  P7_SEQREADER *rdr   = NULL;
+  FILE         *fp    = NULL;
+  off_t         fsize;
+  off_t         b;
+  int           nchunks;
+  int           c;
+  int           n;
+  int           status;
+
+  *ret_rdr = NULL;
+  n = strlen(dbfp->filename);
+  if (strcmp(dbfp->filename, "-") == 0)                        return eslEINCOMPAT;
+  if (n > 3 && strcmp(dbfp->filename + n - 3, ".gz") == 0)     return eslEINCOMPAT;
+  if (dbfp->abc == NULL)                                       return eslEINCOMPAT;
+
+  ESL_ALLOC(rdr, sizeof(P7_SEQREADER));
+  rdr->seqfile   = NULL;
+  rdr->format    = dbfp->format;
+  rdr->abc       = dbfp->abc;
+  rdr->nreaders  = ESL_MAX(nreaders, 1);
+  rdr->blocksize = blocksize;
+  rdr->coff      = NULL;
+  rdr->nchunks   = 0;
+  rdr->chunk     = NULL;
+  rdr->tid       = NULL;
+  rdr->running   = FALSE;
+  rdr->pool      = NULL;
+  rdr->npool     = 0;
+  rdr->palloc    = 0;
+  rdr->errbuf[0] = '\0';
+
+  if ((status = esl_strdup(dbfp->filename, -1, &(rdr->seqfile))) != eslOK) goto ERROR;
+  if (pthread_mutex_init(&rdr->mutex, NULL) != 0) ESL_XEXCEPTION(eslESYS, "mutex init failed");
+  if (pthread_cond_init (&rdr->cond,  NULL) != 0) ESL_XEXCEPTION(eslESYS, "cond init failed");
+
+  if ((fp = fopen(rdr->seqfile, "r")) == NULL)     { status = eslEINCOMPAT; goto ERROR; }
+  if (fseeko(fp, 0, SEEK_END) != 0)                ESL_XEXCEPTION(eslESYS, "fseeko() failed");
+  if ((fsize = ftello(fp)) < 0)                    ESL_XEXCEPTION(eslESYS, "ftello() failed");
+
+  if (chunksize <= 0) chunksize = p7_SEQREADER_CHUNKSIZE;
+  nchunks = ESL_MAX(4 * rdr->nreaders, (fsize + chunksize - 1) / chunksize);
+  ESL_ALLOC(rdr->coff, sizeof(off_t) * (nchunks + 1));
+
+  if (rdr->format == eslSQFILE_FASTA)
+    {
+      rdr->coff[0] = 0;
+      rdr->nchunks = 1;
+      for (c = 1; c < nchunks; c++)
+	{
+	  if ((status = fasta_boundary(fp, fsize / nchunks * c, &b)) != eslOK) goto ERROR;
+	  if (b >= fsize) break;
+	  if (b > rdr->coff[rdr->nchunks-1]) rdr->coff[rdr->nchunks++] = b;
+	}
+      rdr->coff[rdr->nchunks] = fsize;
+    }
+  else if ((status = ssi_boundaries(rdr, fsize, nchunks)) != eslOK) goto ERROR;
+
+  fclose(fp);
+  fp = NULL;
+
+  ESL_ALLOC(rdr->chunk, sizeof(P7_SEQCHUNK) * rdr->nchunks);
+  for (c = 0; c < rdr->nchunks; c++)
+    {
+      rdr->chunk[c].blk    = NULL;
+      rdr->chunk[c].nblk   = 0;
+      rdr->chunk[c].balloc = 0;
+    }
+  ESL_ALLOC(rdr->tid, sizeof(pthread_t) * rdr->nreaders);
+
+  *ret_rdr = rdr;
+  return eslOK;
+
+ ERROR:
+  if (fp) fclose(fp);
+  p7_seqreader_Close(rdr);
+  return status;
+}
+
+/* Function:  p7_seqreader_Close()
+ * Synopsis:  Free a parallel sequence reader.
+ *
+ * Purpose:   Stop <rdr>'s parsers if they're running, and free it.
+ */
+void
+p7_seqreader_Close(P7_SEQREADER *rdr)
+{
+  int c, i;
+
+  if (rdr == NULL) return;
+
+  if (rdr->running) p7_seqreader_Stop(rdr);
+  if (rdr->chunk)
+    {
+      for (c = 0; c < rdr->nchunks; c++) free(rdr->chunk[c].blk);
+      free(rdr->chunk);
+    }
+  for (i = 0; i < rdr->npool; i++) esl_sq_DestroyBlock(rdr->pool[i]);
+  free(rdr->pool);
+  free(rdr->tid);
+  free(rdr->coff);
+  free(rdr->seqfile);
+  pthread_mutex_destroy(&rdr->mutex);
+  pthread_cond_destroy(&rdr->cond);
+  free(rdr);
+}
+
+/* fasta_boundary()
+ * Find the first record of FASTA file <fp> that starts at or after
+ * byte <pos>: the first '>' at or after <pos> that starts a line.
+ * Return its offset in <*ret_off>, or the file size if there is
+ * none.
+ */
+static int
+fasta_boundary(FILE *fp, off_t pos, off_t *ret_off)
+{
+  int   prev, c;
+  off_t off;
+
+  if (pos == 0) { *ret_off = 0; return eslOK; }
+
+  if (fseeko(fp, pos - 1, SEEK_SET) != 0) ESL_EXCEPTION(eslESYS, "fseeko() failed");
+  prev = getc(fp);
+  for (off = pos; (c = getc(fp)) != EOF; off++)
+    {
+      if (c == '>' && prev == '\n') break;
+      prev = c;
+    }
+  *ret_off = off;
+  return eslOK;
+}
+
+/* ssi_boundaries()
+ * Set <rdr>'s chunks from the file's SSI index: the record offsets
+ * of <nchunks> keys, evenly spaced in the index. The index is sorted
+ * by name, so these are a scatter of records through the file;
+ * sorted, they split it into chunks of roughly equal numbers of
+ * records. Returns <eslEINCOMPAT> if there's no usable index.
+ */
+static int
+ssi_boundaries(P7_SEQREADER *rdr, off_t fsize, int nchunks)
+{
+  ESL_SSI  *ssi     = NULL;
+  char     *ssifile = NULL;
+  uint16_t  fh;
+  off_t     roff;
+  int       c, n;
+  int       status;
+
+  if ((status = esl_sprintf(&ssifile, "%s.ssi", rdr->seqfile)) != eslOK) goto ERROR;
+  if (esl_ssi_Open(ssifile, &ssi) != eslOK || ssi->nfiles != 1 || ssi->nprimary == 0) { status = eslEINCOMPAT; goto ERROR; }
+
+  nchunks = ESL_MIN(nchunks, ssi->nprimary);
+  rdr->coff[0] = 0;
+  for (c = 1; c < nchunks; c++)
+    {
+      if ((status = esl_ssi_FindNumber(ssi, ssi->nprimary / nchunks * c, &fh, &roff, NULL, NULL, NULL)) != eslOK) { status = eslEINCOMPAT; goto ERROR; }
+      rdr->coff[c] = roff;
+    }
+  qsort(rdr->coff, nchunks, sizeof(off_t), cmp_off);
+
+  for (n = 1, c = 1; c < nchunks; c++)
+    if (rdr->coff[c] > rdr->coff[n-1] && rdr->coff[c] < fsize) rdr->coff[n++] = rdr->coff[c];
+  rdr->nchunks = n;
+  rdr->coff[n] = fsize;
+
+  esl_ssi_Close(ssi);
+  free(ssifile);
+  return eslOK;
+
+ ERROR:
+  if (ssi) esl_ssi_Close(ssi);
+  if (ssifile) free(ssifile);
+  return status;
+}
+
+static int
+cmp_off(const void *a, const void *b)
+{
+  off_t x = *(const off_t *) a;
+  off_t y = *(const off_t *) b;
+  return (x > y) - (x < y);
+}
+/*------------------- end, P7_SEQREADER -------------------------*/
+
+
+
+/*****************************************************************
+ * 2. Parsing and reading a pass through the file.
+ *****************************************************************/
+
+/* Function:  p7_seqreader_Start()
+ * Synopsis:  Start the parsers for a pass through the file.
+ *
+ * Purpose:   Start <rdr>'s parser threads at the beginning of the
+ *            file.
+ *
+ *            If <window> is -1, each parsed block holds whole
+ *            sequences, as <esl_sqio_ReadBlock(..., -1, ..., FALSE)>
+ *            would read them. Otherwise sequences are read in
+ *            windows of up to <window> residues, as
+ *            <esl_sqio_ReadBlock(..., window, ..., TRUE)> would, and
+ *            a sequence that continues into the next block carries
+ *            <overlap> residues of context over, the way nhmmer's
+ *            reader does it.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslESYS> if a thread can't be created.
+ */
+int
+p7_seqreader_Start(P7_SEQREADER *rdr, int window, int overlap)
+{
+  int c, i;
+
+  if (rdr->running) p7_seqreader_Stop(rdr);
+
+  for (c = 0; c < rdr->nchunks; c++)
+    {
+      rdr->chunk[c].nblk      = 0;
+      rdr->chunk[c].next      = 0;
+      rdr->chunk[c].pos       = 0;
+      rdr->chunk[c].done      = FALSE;
+      rdr->chunk[c].status    = eslOK;
+      rdr->chunk[c].errbuf[0] = '\0';
+    }
+  rdr->nextc     = 0;
+  rdr->curc      = 0;
+  rdr->window    = window;
+  rdr->overlap   = overlap;
+  rdr->abort     = FALSE;
+  rdr->errbuf[0] = '\0';
+
+  for (i = 0; i < rdr->nreaders; i++)
+    if (pthread_create(&(rdr->tid[i]), NULL, parse_thread, rdr) != 0)
+      {
+	rdr->nreaders = i;	/* don't wait for threads that don't exist */
+	p7_seqreader_Stop(rdr);
+	ESL_EXCEPTION(eslESYS, "failed to create parser thread");
+      }
+  rdr->running = TRUE;
+  return eslOK;
+}
+
+/* Function:  p7_seqreader_ReadBlock()
+ * Synopsis:  Get the next block of sequences, in file order.
+ *
+ * Purpose:   Fill <block> with the next sequences of the file, up to
+ *            <max_sequences> of them (or any number, if
+ *            <max_sequences> is -1), like <esl_sqio_ReadBlock()>
+ *            does. <block> must have been created for the same
+ *            alphabet. Its sequences are exchanged with parsed ones,
+ *            so they needn't be empty.
+ *
+ * Returns:   <eslOK> on success: <block->count> sequences (at least
+ *            one), and <block->complete> is FALSE if the last one is
+ *            a window that continues in the next block.
+ *
+ *            <eslEOF> at the end of the file.
+ *
+ *            <eslEFORMAT> or another error code if a parser failed
+ *            at this point of the file; <rdr->errbuf> has its
+ *            message.
+ *
+ * Throws:    <eslESYS> if the mutex or condition variable fails.
+ */
+int
+p7_seqreader_ReadBlock(P7_SEQREADER *rdr, ESL_SQ_BLOCK *block, int max_sequences)
+{
+  P7_SEQCHUNK  *ch;
+  ESL_SQ_BLOCK *src;
+  ESL_SQ        tmp;
+  int           n, i;
+  int           status;
+
+  if (pthread_mutex_lock(&rdr->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex lock failed");
+
+  block->count = 0;
+  for (;;)
+    {
+      if (rdr->curc == rdr->nchunks) { status = eslEOF; break; }
+      ch = &(rdr->chunk[rdr->curc]);
+
+      if (ch->next < ch->nblk)
+	{
+	  src = ch->blk[ch->next];
+	  n   = ESL_MIN(src->count - ch->pos, block->listSize);
+	  if (max_sequences >= 0) n = ESL_MIN(n, max_sequences);
+
+	  /* the parsers never touch a block once it's in a chunk */
+	  for (i = 0; i < n; i++)
+	    {
+	      tmp                       = block->list[i];
+	      block->list[i]            = src->list[ch->pos + i];
+	      src->list[ch->pos + i]    = tmp;
+	    }
+	  block->count    = n;
+	  block->complete = (ch->pos + n == src->count ? src->complete : TRUE);
+
+	  ch->pos += n;
+	  if (ch->pos == src->count)
+	    {
+	      rdr->pool[rdr->npool++] = src; /* pool has room for every block */
+	      ch->next++;
+	      ch->pos = 0;
+	    }
+	  status = eslOK;
+	  break;
+	}
+
+      if (ch->done)
+	{
+	  if (ch->status != eslOK)
+	    {
+	      strcpy(rdr->errbuf, ch->errbuf);
+	      status = ch->status;
+	      break;
+	    }
+	  rdr->curc++;
+	  if (pthread_cond_broadcast(&rdr->cond) != 0) ESL_EXCEPTION(eslESYS, "cond broadcast failed");
+	  continue;
+	}
+
+      if (pthread_cond_wait(&rdr->cond, &rdr->mutex) != 0) ESL_EXCEPTION(eslESYS, "cond wait failed");
+    }
+
+  if (pthread_mutex_unlock(&rdr->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex unlock failed");
+  return status;
+}
+
+/* Function:  p7_seqreader_Stop()
+ * Synopsis:  End a pass through the file.
+ *
+ * Purpose:   Stop <rdr>'s parsers, whether or not the consumer read
+ *            to the end of the file, and wait for them to exit.
+ *            Blocks they parsed but nobody read are kept for the
+ *            next pass.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslESYS> if the mutex or a thread join fails.
+ */
+int
+p7_seqreader_Stop(P7_SEQREADER *rdr)
+{
+  int c, b, i;
+
+  if (pthread_mutex_lock(&rdr->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex lock failed");
+  rdr->abort = TRUE;
+  pthread_cond_broadcast(&rdr->cond);
+  if (pthread_mutex_unlock(&rdr->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex unlock failed");
+
+  for (i = 0; i < rdr->nreaders; i++)
+    if (pthread_join(rdr->tid[i], NULL) != 0) ESL_EXCEPTION(eslESYS, "pthread_join() failed");
+
+  for (c = 0; c < rdr->nchunks; c++)
+    {
+      for (b = rdr->chunk[c].next; b < rdr->chunk[c].nblk; b++)
+	rdr->pool[rdr->npool++] = rdr->chunk[c].blk[b];
+      rdr->chunk[c].nblk = rdr->chunk[c].next = 0;
+    }
+  rdr->running = FALSE;
+  return eslOK;
+}
+
+
+/* get_block()
+ * An empty block for a parser: from the pool, or a new one. Makes
+ * sure the pool could take back every block there is. Caller holds
+ * the mutex.
+ */
+static ESL_SQ_BLOCK *
+get_block(P7_SEQREADER *rdr)
+{
+  ESL_SQ_BLOCK *blk;
+  int           status;
+
+  if (rdr->npool > 0) return rdr->pool[--rdr->npool];
+
+  ESL_REALLOC(rdr->pool, sizeof(ESL_SQ_BLOCK *) * (rdr->palloc + 1));
+  if ((blk = esl_sq_CreateDigitalBlock(rdr->blocksize, rdr->abc)) == NULL) return NULL;
+  rdr->palloc++;
+  return blk;
+
+ ERROR:
+  return NULL;
+}
+
+/* put_block()
+ * A parser is done with <blk>: add it to the end of chunk <c>, or
+ * back to the pool if it's empty.
+ */
+static int
+put_block(P7_SEQREADER *rdr, int c, ESL_SQ_BLOCK *blk)
+{
+  P7_SEQCHUNK *ch = &(rdr->chunk[c]);
+  int          status;
+
+  if (pthread_mutex_lock(&rdr->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex lock failed");
+  if (blk->count == 0)
+    rdr->pool[rdr->npool++] = blk;
+  else
+    {
+      if (ch->nblk == ch->balloc)
+	{
+	  ch->balloc = (ch->balloc == 0 ? 4 : ch->balloc * 2);
+	  ESL_REALLOC(ch->blk, sizeof(ESL_SQ_BLOCK *) * ch->balloc);
+	}
+      ch->blk[ch->nblk++] = blk;
+      pthread_cond_broadcast(&rdr->cond);
+    }
+  if (pthread_mutex_unlock(&rdr->mutex) != 0) ESL_EXCEPTION(eslESYS, "mutex unlock failed");
+  return eslOK;
+
+ ERROR:
+  pthread_mutex_unlock(&rdr->mutex);
+  return status;
+}
+
+/* parse_chunk()
+ * Parse chunk <c> with <sqfp> into blocks, and add them to the chunk
+ * as they fill. <tmpsq> is space for the window that carries over
+ * between blocks.
+ */
+static int
+parse_chunk(P7_SEQREADER *rdr, ESL_SQFILE *sqfp, ESL_SQ *tmpsq, int c)
+{
+  ESL_SQ_BLOCK *blk    = NULL;
+  ESL_SQ_BLOCK *nb     = NULL;
+  off_t         end    = rdr->coff[c+1];
+  int64_t       nres;
+  uint64_t      space;
+  int           done   = FALSE;
+  int           stop   = FALSE;  /* copy of rdr->abort, taken with the mutex */
+  int           i;
+  int           status;
+
+  if ((status = esl_sqfile_Position(sqfp, rdr->coff[c])) != eslOK) goto ERROR;
+
+  pthread_mutex_lock(&rdr->mutex);
+  blk = get_block(rdr);
+  pthread_mutex_unlock(&rdr->mutex);
+  if (blk == NULL) { status = eslEMEM; goto ERROR; }
+  blk->complete = TRUE;
+
+  while (! done)
+    {
+      if (stop) { status = eslOK; goto ERROR; }
+
+      if (rdr->window == -1)
+	{
+	  /* Whole sequences, up to a residue budget */
+	  blk->count = 0;
+	  nres       = 0;
+	  while (blk->count < blk->listSize && nres < p7_SEQREADER_MAXRESIDUES)
+	    {
+	      esl_sq_Reuse(blk->list + blk->count);
+	      status = esl_sqio_Read(sqfp, blk->list + blk->count);
+	      if      (status == eslEOF) { done = TRUE; break; }
+	      else if (status != eslOK)  goto ERROR;
+	      if (blk->list[blk->count].roff >= end) { done = TRUE; break; }
+	      nres += blk->list[blk->count].n;
+	      blk->count++;
+	    }
+	  blk->complete = TRUE;
+	  if ((status = put_block(rdr, c, blk)) != eslOK) goto ERROR;
+	  blk = NULL;
+	  if (done) break;
+
+	  pthread_mutex_lock(&rdr->mutex);
+	  blk  = get_block(rdr);
+	  stop = rdr->abort;
+	  pthread_mutex_unlock(&rdr->mutex);
+	  if (blk == NULL) { status = eslEMEM; goto ERROR; }
+	}
+      else
+	{
+	  /* Windows of long targets, as nhmmer reads them */
+	  status = esl_sqio_ReadBlock(sqfp, blk, rdr->window, -1, /*max_init_window=*/FALSE, TRUE);
+	  if      (status == eslEOF) { done = TRUE; blk->complete = TRUE; }
+	  else if (status != eslOK)  goto ERROR;
+
+	  /* anything from the next chunk's first record on isn't ours */
+	  for (i = 0; i < blk->count; i++)
+	    if (blk->list[i].roff >= end) { blk->count = i; blk->complete = TRUE; done = TRUE; break; }
+
+	  /* the last window's sequence continues: carry it into the next block */
+	  if (!done && !blk->complete) esl_sq_Copy(blk->list + (blk->count - 1), tmpsq);
+	  if (!done)
+	    {
+	      pthread_mutex_lock(&rdr->mutex);
+	      nb   = get_block(rdr);
+	      stop = rdr->abort;
+	      pthread_mutex_unlock(&rdr->mutex);
+	      if (nb == NULL) { status = eslEMEM; goto ERROR; }
+
+	      /* keep a reused block from growing without bound */
+	      for (space = 0, i = 0; i < nb->listSize; i++)
+		space += nb->list[i].nalloc + nb->list[i].aalloc + nb->list[i].dalloc + nb->list[i].srcalloc + nb->list[i].salloc;
+	      if (space > 20 * (uint64_t) rdr->window && esl_sq_BlockReallocSequences(nb) != eslOK) { status = eslEMEM; goto ERROR; }
+
+	      nb->complete = blk->complete;
+	      if (! blk->complete)
+		{
+		  esl_sq_Copy(tmpsq, nb->list);
+		  if (nb->list->n < rdr->overlap) { nb->list->C = nb->list->n; nb->count--; }
+		  else                              nb->list->C = rdr->overlap;
+		}
+	    }
+
+	  if ((status = put_block(rdr, c, blk)) != eslOK) goto ERROR;
+	  blk = nb;
+	  nb  = NULL;
+	}
+    }
+  return eslOK;
+
+ ERROR:
+  pthread_mutex_lock(&rdr->mutex);
+  if (blk) rdr->pool[rdr->npool++] = blk;
+  if (nb)  rdr->pool[rdr->npool++] = nb;
+  pthread_mutex_unlock(&rdr->mutex);
+  if (status != eslOK && status != eslEMEM)
+    snprintf(rdr->chunk[c].errbuf, eslERRBUFSIZE, "%s", esl_sqfile_GetErrorBuf(sqfp));
+  return status;
+}
+
+/* parse_thread()
+ * A parser: claim chunks in file order, no more than 2 nreaders
+ * ahead of the consumer, and parse them, until there are none left
+ * or the reader is stopped.
+ */
+static void *
+parse_thread(void *arg)
+{
+  P7_SEQREADER *rdr   = (P7_SEQREADER *) arg;
+  ESL_SQFILE   *sqfp  = NULL;
+  ESL_SQ       *tmpsq = NULL;
+  int           c;
+  int           status;
+
+  status = esl_sqfile_OpenDigital(rdr->abc, rdr->seqfile, rdr->format, p7_SEQDBENV, &sqfp);
+  if (status == eslOK && (tmpsq = esl_sq_CreateDigital(rdr->abc)) == NULL) status = eslEMEM;
+
+  pthread_mutex_lock(&rdr->mutex);
+  for (;;)
+    {
+      while (!rdr->abort && rdr->nextc < rdr->nchunks && rdr->nextc >= rdr->curc + 2 * rdr->nreaders)
+	pthread_cond_wait(&rdr->cond, &rdr->mutex);
+      if (rdr->abort || rdr->nextc == rdr->nchunks) break;
+      c = rdr->nextc++;
+      pthread_mutex_unlock(&rdr->mutex);
+
+      if (status == eslOK) status = parse_chunk(rdr, sqfp, tmpsq, c);
+      else snprintf(rdr->chunk[c].errbuf, eslERRBUFSIZE, "parser couldn't open %s", rdr->seqfile);
+
+      pthread_mutex_lock(&rdr->mutex);
+      rdr->chunk[c].status = status;
+      rdr->chunk[c].done   = TRUE;
+      pthread_cond_broadcast(&rdr->cond);
+    }
+  pthread_mutex_unlock(&rdr->mutex);
+
+  if (tmpsq) esl_sq_Destroy(tmpsq);
+  if (sqfp)  esl_sqfile_Close(sqfp);
+  return NULL;
+}
+/*----------------- end, parsing and reading --------------------*/
+
+
+
+/*****************************************************************
+ * 3. Unit tests.
+ *****************************************************************/
+#ifdef p7SEQREADER_TESTDRIVE
+#include "esl_random.h"
+#include "esl_randomseq.h"
+
+/* utest_order()
+ *
+ * Write <N> random sequences of length 0..<L> to a FASTA file, read
+ * them back with <nreaders> parsers and chunks of <chunksize> bytes,
+ * and check that they come back in file order, the same as a plain
+ * esl_sqio_Read() gives them. Then read them again, in blocks of at
+ * most 7, as a second pass does.
+ */
+static void
+utest_order(ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, int N, int L, int nreaders, off_t chunksize)
+{
+  char          msg[]       = "seqreader order unit test failed";
+  char          tmpfile[32] = "p7seqrdrXXXXXX";
+  FILE         *fp          = NULL;
+  ESL_SQFILE   *sqfp        = NULL;
+  ESL_SQ      **sq          = malloc(sizeof(ESL_SQ *) * N);
+  ESL_SQ_BLOCK *block       = esl_sq_CreateDigitalBlock(100, abc);
+  P7_SEQREADER *rdr         = NULL;
+  float         fq[20];
+  char          name[32];
+  int           pass, i, n;
+  int           status;
+
+  for (i = 0; i < abc->K; i++) fq[i] = 1.0 / (float) abc->K;
+
+  if (esl_tmpfile_named(tmpfile, &fp) != eslOK) esl_fatal(msg);
+  for (i = 0; i < N; i++)
+    {
+      snprintf(name, 32, "seq%d", i);
+      if ((sq[i] = esl_sq_CreateDigital(abc))                       == NULL)  esl_fatal(msg);
+      if (esl_sq_GrowTo(sq[i], L)                                   != eslOK) esl_fatal(msg);
+      sq[i]->n = esl_rnd_Roll(rng, L+1);
+      if (esl_rsq_xfIID(rng, fq, abc->K, sq[i]->n, sq[i]->dsq)      != eslOK) esl_fatal(msg);
+      if (esl_sq_SetName(sq[i], name)                               != eslOK) esl_fatal(msg);
+      if (esl_sqio_Write(fp, sq[i], eslSQFILE_FASTA, FALSE)         != eslOK) esl_fatal(msg);
+    }
+  fclose(fp);
+
+  if (esl_sqfile_OpenDigital(abc, tmpfile, eslSQFILE_FASTA, NULL, &sqfp) != eslOK) esl_fatal(msg);
+  if (p7_seqreader_Open(sqfp, nreaders, 100, chunksize, &rdr)            != eslOK) esl_fatal(msg);
+
+  for (pass = 0; pass < 2; pass++)
+    {
+      if (p7_seqreader_Start(rdr, -1, 0) != eslOK) esl_fatal(msg);
+      n = 0;
+      while ((status = p7_seqreader_ReadBlock(rdr, block, (pass == 0 ? -1 : 7))) == eslOK)
+	{
+	  if (block->count < 1 || (pass == 1 && block->count > 7)) esl_fatal(msg);
+	  for (i = 0; i < block->count; i++, n++)
+	    {
+	      if (n >= N)                                        esl_fatal(msg);
+	      if (strcmp(block->list[i].name, sq[n]->name) != 0) esl_fatal("%s: got %s, expected %s", msg, block->list[i].name, sq[n]->name);
+	      if (block->list[i].n != sq[n]->n)                  esl_fatal(msg);
+	      if (sq[n]->n > 0 && memcmp(block->list[i].dsq+1, sq[n]->dsq+1, sq[n]->n) != 0) esl_fatal(msg);
+	    }
+	}
+      if (status != eslEOF || n != N) esl_fatal(msg);
+      if (p7_seqreader_Stop(rdr) != eslOK) esl_fatal(msg);
+    }
+
+  /* stopping partway through a pass is fine too */
+  if (p7_seqreader_Start(rdr, -1, 0)             != eslOK) esl_fatal(msg);
+  if (p7_seqreader_ReadBlock(rdr, block, 1)      != eslOK) esl_fatal(msg);
+  if (strcmp(block->list[0].name, sq[0]->name)   != 0)     esl_fatal(msg);
+  if (p7_seqreader_Stop(rdr)                     != eslOK) esl_fatal(msg);
+
+  p7_seqreader_Close(rdr);
+  esl_sqfile_Close(sqfp);
+  esl_sq_DestroyBlock(block);
+  for (i = 0; i < N; i++) esl_sq_Destroy(sq[i]);
+  free(sq);
+  remove(tmpfile);
+}
+#endif /*p7SEQREADER_TESTDRIVE*/
+/*--------------------- end, unit tests -------------------------*/
+
+
+
+/*****************************************************************
+ * 4. Test driver.
+ *****************************************************************/
+#ifdef p7SEQREADER_TESTDRIVE
+/*
+   gcc -g -Wall -pthread -I. -L. -I../easel -L../easel -Dp7SEQREADER_TESTDRIVE -o p7_seqreader_utest p7_seqreader.c -lhmmer -leasel -lm
+   ./p7_seqreader_utest
+ */
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",           0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                  0 },
+  { "-L",        eslARG_INT,    "200", NULL, "n>0", NULL,  NULL, NULL, "maximum length of sampled sequences",            0 },
+  { "-N",        eslARG_INT,   "1000", NULL, "n>0", NULL,  NULL, NULL, "number of sampled sequences",                    0 },
+  { "-R",        eslARG_INT,      "3", NULL, "n>0", NULL,  NULL, NULL, "number of parser threads",                       0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for parallel sequence database parsing";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go  = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *abc = esl_alphabet_Create(eslAMINO);
+  int             L   = esl_opt_GetInteger(go, "-L");
+  int             N   = esl_opt_GetInteger(go, "-N");
+  int             R   = esl_opt_GetInteger(go, "-R");
+
+  utest_order(rng, abc, N, L, R, 1000);   /* many small chunks      */
+  utest_order(rng, abc, N, L, 1, 0);      /* one parser             */
+  utest_order(rng, abc, 3, L, R, 1000);   /* more chunks than seqs  */
+
+  esl_alphabet_Destroy(abc);
+  esl_randomness_Destroy(rng);
+  esl_getopts_Destroy(go);
+  return eslOK;
+}
+#endif /*p7SEQREADER_TESTDRIVE*/
+/*--------------------- end, test driver ------------------------*/
+
+#else  /*!HMMER_THREADS*/
+/* Parallel parsing needs threads; without them the test passes trivially. */
+#ifdef p7SEQREADER_TESTDRIVE
+int main(void) { return 0; }
+#endif
+#endif /*HMMER_THREADS*/
@@ -0,0 +1,68 @@
+/* Parallel parsing of a target sequence database.
+ */
+#ifndef P7_SEQREADER_INCLUDED
+#define P7_SEQREADER_INCLUDED
+
+#include "p7_config.h"
+
+#ifdef HMMER_THREADS
+#include <stdio.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_sq.h"
+#include "esl_sqio.h"
+
+#define p7_SEQREADER_CHUNKSIZE   (4 * 1024 * 1024)  /* default bytes per chunk         */
+#define p7_SEQREADER_MAXRESIDUES (1024 * 1024)      /* residues per parsed block, max  */
+
+/* The parsed blocks of one chunk of the file, in file order. */
+typedef struct {
+  ESL_SQ_BLOCK **blk;            /* parsed blocks [0..nblk-1]                 */
+  int            nblk;
+  int            balloc;
+  int            next;           /* next block the consumer takes from        */
+  int            pos;            /* next sequence in blk[next]                */
+  int            done;           /* TRUE once the parser is done with it      */
+  int            status;         /* eslOK, or the parser's error code         */
+  char           errbuf[eslERRBUFSIZE];
+} P7_SEQCHUNK;
+
+typedef struct {
+  char               *seqfile;   /* name of the sequence file                 */
+  int                 format;    /* its format                                */
+  const ESL_ALPHABET *abc;       /* digital alphabet                          */
+  int                 nreaders;  /* number of parser threads                  */
+  int                 blocksize; /* sequences per parsed block                */
+
+  off_t              *coff;      /* chunk c is bytes coff[c]..coff[c+1]-1     */
+  int                 nchunks;
+  P7_SEQCHUNK        *chunk;     /* [0..nchunks-1]                            */
+
+  /* State of one pass through the file */
+  pthread_t          *tid;       /* parser threads [0..nreaders-1]            */
+  int                 running;   /* TRUE between Start() and Stop()           */
+  pthread_mutex_t     mutex;     /* protects everything below                 */
+  pthread_cond_t      cond;      /* a chunk got a block or was consumed       */
+  int                 nextc;     /* next chunk a parser claims                */
+  int                 curc;      /* chunk the consumer is reading             */
+  int                 window;    /* window length for long targets, or -1     */
+  int                 overlap;   /* overlap of consecutive windows            */
+  int                 abort;     /* TRUE: parsers stop early                  */
+  ESL_SQ_BLOCK      **pool;      /* empty parsed blocks [0..npool-1]          */
+  int                 npool;
+  int                 palloc;
+
+  char                errbuf[eslERRBUFSIZE];
+} P7_SEQREADER;
+
+extern int  p7_seqreader_Open     (ESL_SQFILE *dbfp, int nreaders, int blocksize, off_t chunksize, P7_SEQREADER **ret_rdr);
+extern int  p7_seqreader_Start    (P7_SEQREADER *rdr, int window, int overlap);
+extern int  p7_seqreader_ReadBlock(P7_SEQREADER *rdr, ESL_SQ_BLOCK *block, int max_sequences);
+extern int  p7_seqreader_Stop     (P7_SEQREADER *rdr);
+extern void p7_seqreader_Close    (P7_SEQREADER *rdr);
+
+#endif /*HMMER_THREADS*/
+#endif /*P7_SEQREADER_INCLUDED*/
@@ -216,6 +216,99 @@ link_spsamples(const void *v1, const void *v2, const void *prm, int *ret_link)
   return eslOK;
 }
 
+/* sweep_clusters()
+ *
+ * Single linkage clustering of the seg pairs in <sp> by
+ * link_spsamples(), by sort and sweep, putting cluster numbers in
+ * <sp->assignment> and the number of clusters in <sp->nc>.
+ * 
+ * Esl_cluster_SingleLinkage() tests all pairs, which is quadratic in
+ * the number of seg pairs. But if <min_overlap> is > 0, two linked seg
+ * pairs overlap in the sequence, so with the seg pairs in order of
+ * start <i>, each only needs to be tested against those before it
+ * that haven't ended yet (the "active" ones); pairs already in the
+ * same cluster aren't tested at all. Clusters are kept in a
+ * union-find forest.
+ * 
+ * The clusters, and their numbering (in order of their first seg
+ * pair in <sp>), are the same as esl_cluster_SingleLinkage()'s.
+ * 
+ * Uses <sp->workspace> and <sp->epc>. Returns <eslOK> on success;
+ * throws <eslEMEM> on allocation failure.
+ */
+static int
+uf_find(int *parent, int h)
+{
+  while (parent[h] != h) { parent[h] = parent[parent[h]]; h = parent[h]; }
+  return h;
+}
+
+static int
+sweep_clusters(P7_SPENSEMBLE *sp, struct p7_linkparam_s *param)
+{
+  int *order  = sp->workspace;	       /* [0..n-1]: seg pairs in order of i; later, cluster # of each root */
+  int *parent = sp->workspace + sp->n; /* [0..n-1]: union-find forest        */
+  int *active = NULL;		       /* seg pairs that may overlap the next one */
+  int  nact   = 0;
+  int  imin, imax;
+  int  h, x, y, z, ra, rh;
+  int  do_link;
+  int  status;
+
+  sp->nc = 0;
+  if (sp->n == 0) return eslOK;
+  ESL_ALLOC(active, sizeof(int) * sp->n);
+
+  /* Counting sort of seg pairs by i; stable, so ties stay in order of h */
+  imin = imax = sp->sp[0].i;
+  for (h = 1; h < sp->n; h++) { imin = ESL_MIN(imin, sp->sp[h].i); imax = ESL_MAX(imax, sp->sp[h].i); }
+  if (imax-imin+2 > sp->epc_alloc) {
+    void *p;
+    ESL_RALLOC(sp->epc, p, sizeof(int) * (imax-imin+2));
+    sp->epc_alloc = imax-imin+2;
+  }
+  esl_vec_ISet(sp->epc, imax-imin+2, 0);
+  for (h = 0; h < sp->n; h++)         sp->epc[sp->sp[h].i-imin+1]++;
+  for (x = 1; x <= imax-imin+1; x++)  sp->epc[x] += sp->epc[x-1];
+  for (h = 0; h < sp->n; h++)         order[sp->epc[sp->sp[h].i-imin]++] = h;
+
+  for (h = 0; h < sp->n; h++) parent[h] = h;
+
+  for (x = 0; x < sp->n; x++)
+    {
+      h = order[x];
+      for (y = 0, z = 0; y < nact; y++)	/* drop seg pairs that end before h starts */
+	if (sp->sp[active[y]].j >= sp->sp[h].i) active[z++] = active[y];
+      nact = z;
+
+      for (y = 0; y < nact; y++)
+	{
+	  ra = uf_find(parent, active[y]);
+	  rh = uf_find(parent, h);
+	  if (ra == rh) continue;
+	  link_spsamples(&(sp->sp[active[y]]), &(sp->sp[h]), param, &do_link);
+	  if (do_link) parent[ra] = rh;
+	}
+      active[nact++] = h;
+    }
+
+  /* Number the clusters in order of their first seg pair */
+  for (h = 0; h < sp->n; h++) order[h] = -1;
+  for (h = 0; h < sp->n; h++)
+    {
+      rh = uf_find(parent, h);
+      if (order[rh] == -1) order[rh] = sp->nc++;
+      sp->assignment[h] = order[rh];
+    }
+
+  free(active);
+  return eslOK;
+
+ ERROR:
+  if (active) free(active);
+  return status;
+}
+
 /* cluster_orderer()
  * is the routine that gets passed to qsort() to sort
  * the significant clusters by order of occurrence on
@@ -240,7 +333,10 @@ cluster_orderer(const void *v1, const void *v2)
  *            identify significant clusters with high posterior probability;
  *            and define consensus endpoints for each significant cluster.
  *            
- *            Clustering is single-linkage. The linkage rule is
+ *            Clustering is single-linkage, by sort and sweep on
+ *            sequence start coordinates when <min_overlap> $> 0$ (see
+ *            <sweep_clusters()>), else by Easel's all-pairs
+ *            <esl_cluster_SingleLinkage()>. The linkage rule is
  *            controlled by the <min_overlap>, <of_smaller>, and
  *            <max_diagdiff> parameters. To be linked, two segments
  *            must overlap by a fraction $\geq$ <min_overlap>,
@@ -286,8 +382,8 @@ p7_spensemble_Cluster(P7_SPENSEMBLE *sp,
   int status;
   int c;
   int h;
-  int idx_of_last;
   int *ninc = NULL;
+  int *last = NULL;
   int cwindow_width;
   int epc_threshold;
   int imin, jmin, kmin, mmin;
@@ -300,26 +396,32 @@ p7_spensemble_Cluster(P7_SPENSEMBLE *sp,
   param.max_diagdiff  = max_diagdiff;
   param.min_posterior = min_posterior;
   param.min_endpointp = min_endpointp;
-  if ((status = esl_cluster_SingleLinkage(sp->sp, sp->n, sizeof(struct p7_spcoord_s), link_spsamples, (void *) &param,
-					  sp->workspace, sp->assignment, &(sp->nc))) != eslOK) goto ERROR;
+  if (min_overlap > 0.) 
+    {
+      if ((status = sweep_clusters(sp, &param)) != eslOK) goto ERROR;
+    }
+  else if ((status = esl_cluster_SingleLinkage(sp->sp, sp->n, sizeof(struct p7_spcoord_s), link_spsamples, (void *) &param,
+					       sp->workspace, sp->assignment, &(sp->nc))) != eslOK) goto ERROR;
+
+  ESL_ALLOC(ninc, sizeof(int) * (sp->nc+1)); /* +1: nc may be 0 */
+  ESL_ALLOC(last, sizeof(int) * (sp->nc+1));
 
-  ESL_ALLOC(ninc, sizeof(int) * sp->nc);
+  /* Calculate posterior probability of each cluster, in one pass.
+   * The extra wrinkle here is that this probability is w.r.t the number of sampled traces;
+   * but the clusters might contain more than one seg pair from a given trace.
+   * That's what the last[] logic is doing, avoiding double-counting.
+   */
+  esl_vec_ISet(ninc, sp->nc, 0);
+  esl_vec_ISet(last, sp->nc, -1);
+  for (h = 0; h < sp->n; h++) {
+    c = sp->assignment[h];
+    if (sp->sp[h].idx != last[c]) ninc[c]++;
+    last[c] = sp->sp[h].idx;
+  }
 
   /* Look at each cluster in turn; most will be too small to worry about. */
   for (c = 0; c < sp->nc; c++)
     {
-      /* Calculate posterior probability of each cluster. 
-       * The extra wrinkle here is that this probability is w.r.t the number of sampled traces;
-       * but the clusters might contain more than one seg pair from a given trace.
-       * That's what the idx_of_last logic is doing, avoiding double-counting.
-       */
-      idx_of_last = -1;
-      for (ninc[c] = 0, h = 0; h < sp->n; h++) {
-	if (sp->assignment[h] == c) {
-	  if (sp->sp[h].idx != idx_of_last) ninc[c]++;
-	  idx_of_last = sp->sp[h].idx;
-	}
-      }
       /* Reject low probability clusters: */
       if ((float) ninc[c] / (float) sp->nsamples < min_posterior) continue;
 
@@ -401,11 +503,13 @@ p7_spensemble_Cluster(P7_SPENSEMBLE *sp,
   qsort((void *) sp->sigc, sp->nsigc, sizeof(struct p7_spcoord_s), cluster_orderer);
 
   free(ninc);
+  free(last);
   *ret_nclusters = sp->nsigc;
   return eslOK;
 
  ERROR:
   if (ninc != NULL) free(ninc);
+  if (last != NULL) free(last);
   *ret_nclusters = 0;
   return status;
 }
@@ -456,6 +560,92 @@ p7_spensemble_Destroy(P7_SPENSEMBLE *sp)
 
 
 
+/*****************************************************************
+ * Unit tests and test driver.
+ *****************************************************************/
+#ifdef p7SPENSEMBLE_TESTDRIVE
+#include "esl_getopts.h"
+#include "esl_random.h"
+
+/* utest_sweep()
+ * 
+ * sweep_clusters() must give the same clusters, numbered the same
+ * way, as esl_cluster_SingleLinkage(), on an ensemble of <N> samples
+ * of jittered seg pairs around a few domains, some of them
+ * overlapping.
+ */
+static void
+utest_sweep(ESL_RANDOMNESS *r, int N, float min_overlap, int of_smaller)
+{
+  char                  msg[] = "spensemble sweep unit test failed";
+  P7_SPENSEMBLE        *sp    = p7_spensemble_Create(16, 16, 4); /* small, to exercise reallocation */
+  struct p7_linkparam_s param;
+  int                  *asg   = NULL;
+  int                  *work  = NULL;
+  int                   dom_i[4] = { 10, 60,  80, 300 };
+  int                   dom_k[4] = {  1,  1,  40,  20 };
+  int                   len[4]   = { 40, 45, 100,  30 };
+  int                   nc, nc2;
+  int                   t, d, h, i, k;
+
+  param.min_overlap   = min_overlap;
+  param.of_smaller    = of_smaller;
+  param.max_diagdiff  = 4;
+  param.min_posterior = 0.25;
+  param.min_endpointp = 0.02;
+
+  for (t = 0; t < N; t++)
+    for (d = 0; d < 4; d++)
+      if (esl_rnd_Roll(r, 3))
+	{
+	  i = dom_i[d] + esl_rnd_Roll(r, 11) - 5;
+	  k = dom_k[d] + esl_rnd_Roll(r, 5);
+	  if (p7_spensemble_Add(sp, t, i, i + len[d] - esl_rnd_Roll(r, 9), k, k + len[d] - esl_rnd_Roll(r, 9)) != eslOK) esl_fatal(msg);
+	}
+
+  if ((asg  = malloc(sizeof(int) * (sp->n+1)))   == NULL) esl_fatal(msg);
+  if ((work = malloc(sizeof(int) * (sp->n*2+1))) == NULL) esl_fatal(msg);
+  if (esl_cluster_SingleLinkage(sp->sp, sp->n, sizeof(struct p7_spcoord_s), link_spsamples, (void *) &param, work, asg, &nc) != eslOK) esl_fatal(msg);
+  if (sweep_clusters(sp, &param) != eslOK) esl_fatal(msg);
+  nc2 = sp->nc;
+
+  if (nc != nc2) esl_fatal("%s: %d clusters, expected %d", msg, nc2, nc);
+  for (h = 0; h < sp->n; h++)
+    if (sp->assignment[h] != asg[h]) esl_fatal("%s: seg pair %d in cluster %d, expected %d", msg, h, sp->assignment[h], asg[h]);
+
+  free(asg);
+  free(work);
+  p7_spensemble_Destroy(sp);
+}
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",             0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                    0 },
+  { "-N",        eslARG_INT,    "200", NULL, NULL,  NULL,  NULL, NULL, "number of sampled traces",                         0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "unit test driver for segment pair ensembles";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *r  = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  int             N  = esl_opt_GetInteger(go, "-N");
+
+  utest_sweep(r, N, 0.8, TRUE);
+  utest_sweep(r, N, 0.5, FALSE);
+  utest_sweep(r, 1,  0.8, TRUE);
+
+  esl_randomness_Destroy(r);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /*p7SPENSEMBLE_TESTDRIVE*/
+
+
 /*****************************************************************
  * Benchmark and example.
  *****************************************************************/
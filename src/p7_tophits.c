@@ -613,7 +613,10 @@ p7_tophits_Reuse(P7_TOPHITS *h)
       if (h->unsrt[i].desc != NULL) free(h->unsrt[i].desc);
       if (h->unsrt[i].dcl  != NULL) {
         for (j = 0; j < h->unsrt[i].ndom; j++)
-          if (h->unsrt[i].dcl[j].ad != NULL) p7_alidisplay_Destroy(h->unsrt[i].dcl[j].ad);
+        {
+          if (h->unsrt[i].dcl[j].ad  != NULL) p7_alidisplay_Destroy(h->unsrt[i].dcl[j].ad);
+          if (h->unsrt[i].dcl[j].atr != NULL) p7_alitrace_Destroy  (h->unsrt[i].dcl[j].atr);
+        }
         free(h->unsrt[i].dcl);
       }
     }
@@ -644,6 +647,7 @@ p7_tophits_Destroy(P7_TOPHITS *h)
       if (h->unsrt[i].dcl  != NULL) {
         for (j = 0; j < h->unsrt[i].ndom; j++) {
           if (h->unsrt[i].dcl[j].ad             != NULL) p7_alidisplay_Destroy(h->unsrt[i].dcl[j].ad);
+          if (h->unsrt[i].dcl[j].atr            != NULL) p7_alitrace_Destroy  (h->unsrt[i].dcl[j].atr);
 	  if (h->unsrt[i].dcl[j].scores_per_pos != NULL) free (h->unsrt[i].dcl->scores_per_pos);
 	}
         free(h->unsrt[i].dcl);
@@ -866,6 +870,11 @@ p7_tophits_RemoveDuplicates(P7_TOPHITS *th, int using_bit_cutoffs)
  *            applied in the pipeline. In this case all we're
  *            responsible for here is counting them (setting
  *            nreported, nincluded counters).
+ *
+ *            If <pli> is in top-N mode (<p7_pli_SetTopN()>), only the
+ *            first <pli->topn> reportable targets are reported (and
+ *            maybe included); this needs <th> to be sorted by
+ *            sortkey, as it is for output anyway.
  *            
  * Returns:   <eslOK> on success.
  */
@@ -873,6 +882,7 @@ int
 p7_tophits_Threshold(P7_TOPHITS *th, P7_PIPELINE *pli)
 {
   int h, d;    /* counters over sequence hits, domains in sequences */
+  int n;
   
   /* Flag reported, included targets (if we're using general thresholds) */
   if (! pli->use_bit_cutoffs) 
@@ -895,6 +905,20 @@ p7_tophits_Threshold(P7_TOPHITS *th, P7_PIPELINE *pli)
     }
   }
 
+  /* In top-N mode, unflag reported targets past the first N, and their domains */
+  if (pli->topn > 0)
+  {
+    for (n = 0, h = 0; h < th->N; h++)
+    {
+      if (! (th->hit[h]->flags & p7_IS_REPORTED)) continue;
+      if (n < pli->topn) { n++; continue; }
+
+      th->hit[h]->flags &= ~(p7_IS_REPORTED | p7_IS_INCLUDED);
+      for (d = 0; d < th->hit[h]->ndom; d++)
+        th->hit[h]->dcl[d].is_reported = th->hit[h]->dcl[d].is_included = FALSE;
+    }
+  }
+
   /* Count reported, included targets */
   th->nreported = 0;
   th->nincluded = 0;
@@ -946,6 +970,86 @@ p7_tophits_Threshold(P7_TOPHITS *th, P7_PIPELINE *pli)
 }
 
 
+/* Function:  p7_tophits_MakeDisplays()
+ * Synopsis:  Make the alignment displays a lazy pipeline deferred.
+ *
+ * Purpose:   A pipeline with <pli->do_lazy_ad> set keeps only a
+ *            compact <P7_ALITRACE> for each domain it defines, not
+ *            its <P7_ALIDISPLAY>, since most domains in a big search
+ *            are never shown. Now make the display, from profile
+ *            <om> (the query the hits in <th> were aligned to), for
+ *            each domain that output could use, and free all the
+ *            compact traces.
+ *
+ *            If <th> has been thresholded (<p7_tophits_Threshold()>),
+ *            pass <maybe_reported> as <FALSE>: displays are made for
+ *            the reported or included domains only. A caller holding
+ *            only part of the hits (an hmmpgmd worker, whose list the
+ *            master merges and thresholds) passes <TRUE>: then
+ *            displays are also made for every domain that would be
+ *            reported or included if its target were. <pli->Z> must
+ *            already be the final one. If <pli->domZ> is to be set
+ *            from the number of reported targets, the number in <th>
+ *            is used; it can't be more than the final one, so no
+ *            domain that the final thresholds report is missed.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_tophits_MakeDisplays(P7_TOPHITS *th, P7_PIPELINE *pli, const P7_OPROFILE *om, int maybe_reported)
+{
+  double     domZ  = pli->domZ;
+  uint64_t   t0    = p7_pli_Clock();
+  uint64_t   cells = 0;
+  P7_HIT    *hit;
+  P7_DOMAIN *dom;
+  int        h, d, n;
+  int        keep;
+  int        status;
+
+  if (maybe_reported && ! pli->use_bit_cutoffs && pli->domZ_setby == p7_ZSETBY_NTARGETS)
+    {
+      for (n = 0, h = 0; h < th->N; h++)
+	if (p7_pli_TargetReportable(pli, th->unsrt[h].score, th->unsrt[h].lnP)) n++;
+      pli->domZ = (double) n;
+    }
+
+  for (h = 0; h < th->N; h++)
+    {
+      hit = &(th->unsrt[h]);
+      for (d = 0; d < hit->ndom; d++)
+	{
+	  dom = &(hit->dcl[d]);
+	  if (dom->atr == NULL) continue;
+
+	  keep = (dom->is_reported || dom->is_included);
+	  if (! keep && maybe_reported && ! pli->use_bit_cutoffs)
+	    keep = p7_pli_TargetReportable(pli, hit->score, hit->lnP) &&
+	           (p7_pli_DomainReportable(pli, dom->bitscore, dom->lnP) || p7_pli_DomainIncludable(pli, dom->bitscore, dom->lnP));
+
+	  if (keep)
+	    {
+	      if ((dom->ad = p7_alitrace_Display(dom->atr, om, hit->name, hit->acc, hit->desc)) == NULL) { status = eslEMEM; goto ERROR; }
+	      cells += dom->ad->N;
+	    }
+	  p7_alitrace_Destroy(dom->atr);
+	  dom->atr = NULL;
+	}
+    }
+
+  pli->domZ = domZ;
+  pli->stage_ns   [p7_PLI_ALIDISPLAY] += p7_pli_Clock() - t0;
+  pli->stage_cells[p7_PLI_ALIDISPLAY] += cells;
+  return eslOK;
+
+ ERROR:
+  pli->domZ = domZ;
+  return status;
+}
+
+
 
 
 
@@ -25,15 +25,18 @@
 #ifdef HMMER_THREADS
 #include <unistd.h>
 #include "esl_threads.h"
-#include "esl_workqueue.h"
 #endif
 
 #include "hmmer.h"
+#include "p7_scheduler.h"
+#include "p7_seqdb.h"
+#include "p7_seqreader.h"
 
 typedef struct {
 #ifdef HMMER_THREADS
-  ESL_WORK_QUEUE   *queue;
+  P7_SCHEDULER     *sched;
 #endif
+  P7_SEQDB         *seqdb;       /* pre-digitized targets, or NULL */
   P7_BG            *bg;
   P7_PIPELINE      *pli;
   P7_TOPHITS       *th;
@@ -48,7 +51,7 @@ typedef struct {
 
 #if defined (HMMER_THREADS) && defined (HMMER_MPI)
 #define CPUOPTS     "--mpi"
-#define MPIOPTS     "--cpu"
+#define MPIOPTS     "--cpu,--rcpu"
 #else
 #define CPUOPTS     NULL
 #define MPIOPTS     NULL
@@ -63,6 +66,7 @@ static ESL_OPTIONS options[] = {
   { "--tblout",     eslARG_OUTFILE,      NULL, NULL, NULL,      NULL,  NULL,  NULL,              "save parseable table of per-sequence hits to file <f>",        2 },
   { "--domtblout",  eslARG_OUTFILE,      NULL, NULL, NULL,      NULL,  NULL,  NULL,              "save parseable table of per-domain hits to file <f>",          2 },
   { "--pfamtblout", eslARG_OUTFILE,      NULL, NULL, NULL,      NULL,  NULL,  NULL,              "save table of hits and domains to file, in Pfam format <f>",   2 },
+  { "--stagetblout",eslARG_OUTFILE,      NULL, NULL, NULL,      NULL,  NULL,  NULL,              "save table of time and work in each pipeline stage to file <f>", 2 },
   { "--acc",        eslARG_NONE,        FALSE, NULL, NULL,      NULL,  NULL,  NULL,              "prefer accessions over names in output",                       2 },
   { "--noali",      eslARG_NONE,        FALSE, NULL, NULL,      NULL,  NULL,  NULL,              "don't output alignments, so output is smaller",                2 },
   { "--notextw",    eslARG_NONE,         NULL, NULL, NULL,      NULL,  NULL, "--textw",          "unlimit ASCII text output line width",                         2 },
@@ -77,6 +81,7 @@ static ESL_OPTIONS options[] = {
   { "-T",           eslARG_REAL,        FALSE, NULL,  NULL,     NULL,  NULL,  REPOPTS,           "report sequences >= this score threshold in output",           4 },
   { "--domE",       eslARG_REAL,       "10.0", NULL, "x>0",     NULL,  NULL,  DOMREPOPTS,        "report domains <= this E-value threshold in output",           4 },
   { "--domT",       eslARG_REAL,        FALSE, NULL,  NULL,     NULL,  NULL,  DOMREPOPTS,        "report domains >= this score cutoff in output",                4 },
+  { "--topn",       eslARG_INT,         FALSE, NULL,  "n>0",    NULL,  NULL,  NULL,              "report only the best <n> sequences, skipping the rest early",  4 },
 /* Control of inclusion thresholds */
   { "--incE",       eslARG_REAL,       "0.01", NULL, "x>0",     NULL,  NULL,  INCOPTS,           "consider sequences <= this E-value threshold as significant",  5 },
   { "--incT",       eslARG_REAL,        FALSE, NULL,  NULL,     NULL,  NULL,  INCOPTS,           "consider sequences >= this score threshold as significant",    5 },
@@ -109,6 +114,7 @@ static ESL_OPTIONS options[] = {
   { "--tformat",    eslARG_STRING,      NULL, NULL, NULL,      NULL,  NULL,  NULL,              "assert target <seqdb> is in format <s>>: no autodetection",   12 },
 #ifdef HMMER_THREADS
   { "--cpu",        eslARG_INT,  p7_NCPU,"HMMER_NCPU", "n>=0",NULL,  NULL,  CPUOPTS,            "number of parallel CPU workers to use for multithreads",      12 },
+  { "--rcpu",       eslARG_INT,    "0",  NULL, "n>=0",  NULL,  NULL,  CPUOPTS,            "number of threads parsing <seqdb> (0: the master reads it)",  12 },
 #endif
 #ifdef HMMER_MPI
   { "--stall",      eslARG_NONE,   FALSE, NULL, NULL,      NULL,"--mpi", NULL,              "arrest after start: for debugging MPI under gdb",             12 },  
@@ -147,12 +153,12 @@ struct cfg_s {
 };
 
 static int  serial_master(ESL_GETOPTS *go, struct cfg_s *cfg);
-static int  serial_loop  (WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs);
+static int  serial_loop  (WORKER_INFO *info, ESL_SQFILE *dbfp, P7_SEQDB *seqdb, int n_targetseqs);
 
 #ifdef HMMER_THREADS
 #define BLOCK_SIZE 1000
 
-static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_targetseqs);
+static int  thread_loop(ESL_THREADS *obj, P7_SCHEDULER *sched, P7_SEQREADER *rdr, ESL_SQFILE *dbfp, P7_SEQDB *seqdb, int n_targetseqs);
 static void pipeline_thread(void *arg);
 #endif 
 
@@ -243,6 +249,7 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *qfile, char *dbfile)
   if (esl_opt_IsUsed(go, "--tblout")    && fprintf(ofp, "# per-seq hits tabular output:     %s\n",             esl_opt_GetString(go, "--tblout"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domtblout") && fprintf(ofp, "# per-dom hits tabular output:     %s\n",             esl_opt_GetString(go, "--domtblout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--pfamtblout")&& fprintf(ofp, "# pfam-style tabular hit output:   %s\n",             esl_opt_GetString(go, "--pfamtblout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--stagetblout")&& fprintf(ofp, "# pipeline stage table output:    %s\n",             esl_opt_GetString(go, "--stagetblout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--acc")       && fprintf(ofp, "# prefer accessions over names:    yes\n")                                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--noali")     && fprintf(ofp, "# show alignments in output:       no\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--notextw")   && fprintf(ofp, "# max ASCII text line length:      unlimited\n")                                            < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -255,6 +262,7 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *qfile, char *dbfile)
   if (esl_opt_IsUsed(go, "-T")          && fprintf(ofp, "# sequence reporting threshold:    score >= %g\n",    esl_opt_GetReal(go, "-T"))            < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domE")      && fprintf(ofp, "# domain reporting threshold:      E-value <= %g\n",  esl_opt_GetReal(go, "--domE"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domT")      && fprintf(ofp, "# domain reporting threshold:      score >= %g\n",    esl_opt_GetReal(go, "--domT"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--topn")      && fprintf(ofp, "# report only the best:            %d sequences\n",  esl_opt_GetInteger(go, "--topn"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incE")      && fprintf(ofp, "# sequence inclusion threshold:    E-value <= %g\n",  esl_opt_GetReal(go, "--incE"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incT")      && fprintf(ofp, "# sequence inclusion threshold:    score >= %g\n",    esl_opt_GetReal(go, "--incT"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incdomE")   && fprintf(ofp, "# domain inclusion threshold:      E-value <= %g\n",  esl_opt_GetReal(go, "--incdomE"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -289,6 +297,7 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *qfile, char *dbfile)
   if (esl_opt_IsUsed(go, "--tformat")   && fprintf(ofp, "# target <seqdb> format asserted:  %s\n",            esl_opt_GetString(go, "--tformat"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #ifdef HMMER_THREADS
   if (esl_opt_IsUsed(go, "--cpu")       && fprintf(ofp, "# number of worker threads:        %d\n",            esl_opt_GetInteger(go, "--cpu"))       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");  
+  if (esl_opt_IsUsed(go, "--rcpu")      && fprintf(ofp, "# number of parser threads:        %d\n",            esl_opt_GetInteger(go, "--rcpu"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #endif
 #ifdef HMMER_MPI
   if (esl_opt_IsUsed(go, "--mpi")       && fprintf(ofp, "# MPI:                             on\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -384,11 +393,13 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   FILE            *tblfp    = NULL;		  /* output stream for tabular per-seq (--tblout)     */
   FILE            *domtblfp = NULL;		  /* output stream for tabular per-seq (--domtblout)  */
   FILE            *pfamtblfp= NULL;              /* output stream for pfam tabular output (--pfamtblout)    */
+  FILE            *stagetblfp= NULL;             /* output stream for per-stage timing table (--stagetblout) */
   int              qformat  = eslSQFILE_UNKNOWN;  /* format of qfile                                  */
   ESL_SQFILE      *qfp      = NULL;		  /* open qfile                                       */
   ESL_SQ          *qsq      = NULL;               /* query sequence                                   */
   int              dbformat = eslSQFILE_UNKNOWN;  /* format of dbfile                                 */
   ESL_SQFILE      *dbfp     = NULL;               /* open dbfile                                      */
+  P7_SEQDB        *seqdb    = NULL;               /* ... or open pre-digitized dbfile                 */
   ESL_ALPHABET    *abc      = NULL;               /* sequence alphabet                                */
   P7_BG           *bg       = NULL;		  /* null model (copies made of this into threads)    */
   P7_BUILDER      *bld      = NULL;               /* HMM construction configuration                   */
@@ -406,8 +417,10 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #ifdef HMMER_THREADS
   ESL_SQ_BLOCK    *block    = NULL;
   ESL_THREADS     *threadObj= NULL;
-  ESL_WORK_QUEUE  *queue    = NULL;
+  P7_SCHEDULER    *sched    = NULL;
+  P7_SEQREADER    *rdr      = NULL;
 #endif
+  char             errbuf[eslERRBUFSIZE];
 
   /* Initializations */
   abc     = esl_alphabet_Create(eslAMINO);
@@ -453,16 +466,26 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (esl_opt_IsOn(go, "--tblout"))    { if ((tblfp    = fopen(esl_opt_GetString(go, "--tblout"),    "w")) == NULL)  p7_Fail("Failed to open tabular per-seq output file %s for writing\n", esl_opt_GetString(go, "--tblfp")); }
   if (esl_opt_IsOn(go, "--domtblout")) { if ((domtblfp = fopen(esl_opt_GetString(go, "--domtblout"), "w")) == NULL)  p7_Fail("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblfp")); }
   if (esl_opt_IsOn(go, "--pfamtblout")){ if ((pfamtblfp = fopen(esl_opt_GetString(go, "--pfamtblout"), "w")) == NULL)  esl_fatal("Failed to open pfam-style tabular output file %s for writing\n", esl_opt_GetString(go, "--pfamtblout")); }
+  if (esl_opt_IsOn(go, "--stagetblout")){ if ((stagetblfp = fopen(esl_opt_GetString(go, "--stagetblout"), "w")) == NULL)  esl_fatal("Failed to open pipeline stage table output file %s for writing\n", esl_opt_GetString(go, "--stagetblout")); }
 
-  /* Open the target sequence database for sequential access. */
-  status =  esl_sqfile_OpenDigital(abc, cfg->dbfile, dbformat, p7_SEQDBENV, &dbfp);
-  if      (status == eslENOTFOUND) p7_Fail("Failed to open target sequence database %s for reading\n",      cfg->dbfile);
-  else if (status == eslEFORMAT)   p7_Fail("Target sequence database file %s is empty or misformatted\n",   cfg->dbfile);
-  else if (status == eslEINVAL)    p7_Fail("Can't autodetect format of a stdin or .gz seqfile");
-  else if (status != eslOK)        p7_Fail("Unexpected error %d opening target sequence database file %s\n", status, cfg->dbfile);
+  /* Open the target sequence database: a makehmmerseqdb file, or else a sequence file for sequential access. */
+  if (dbformat == eslSQFILE_UNKNOWN && strcmp(cfg->dbfile, "-") != 0)
+    {
+      status = p7_seqdb_Open(cfg->dbfile, &seqdb, errbuf);
+      if      (status != eslOK && status != eslEFORMAT && status != eslENOTFOUND) p7_Fail("Failed to open binary target sequence database %s\n%s\n", cfg->dbfile, errbuf);
+      else if (status == eslOK && seqdb->abctype != abc->type)                   p7_Fail("Binary target sequence database %s isn't protein\n", cfg->dbfile);
+    }
 
+  if (seqdb == NULL)
+    {
+      status =  esl_sqfile_OpenDigital(abc, cfg->dbfile, dbformat, p7_SEQDBENV, &dbfp);
+      if      (status == eslENOTFOUND) p7_Fail("Failed to open target sequence database %s for reading\n",      cfg->dbfile);
+      else if (status == eslEFORMAT)   p7_Fail("Target sequence database file %s is empty or misformatted\n",   cfg->dbfile);
+      else if (status == eslEINVAL)    p7_Fail("Can't autodetect format of a stdin or .gz seqfile");
+      else if (status != eslOK)        p7_Fail("Unexpected error %d opening target sequence database file %s\n", status, cfg->dbfile);
+    }
 
-  if (esl_opt_IsUsed(go, "--restrictdb_stkey") || esl_opt_IsUsed(go, "--restrictdb_n")) {
+  if (dbfp != NULL && (esl_opt_IsUsed(go, "--restrictdb_stkey") || esl_opt_IsUsed(go, "--restrictdb_n"))) {
     if (esl_opt_IsUsed(go, "--ssifile"))
       esl_sqfile_OpenSSI(dbfp, esl_opt_GetString(go, "--ssifile"));
     else
@@ -484,7 +507,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (ncpus > 0)
     {
       threadObj = esl_threads_Create(&pipeline_thread);
-      queue = esl_workqueue_Create(ncpus * 2);
+      sched     = p7_scheduler_Create(ncpus);
     }
 #endif
 
@@ -500,26 +523,34 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       info[i].th    = NULL;
       info[i].om    = NULL;
       info[i].bg    = p7_bg_Clone(bg);
+      info[i].seqdb = seqdb;
 #ifdef HMMER_THREADS
-      info[i].queue = queue;
+      info[i].sched = sched;
 #endif
     }
 
 #ifdef HMMER_THREADS
   for (i = 0; i < ncpus * 2; ++i)
     {
-      block = esl_sq_CreateDigitalBlock(BLOCK_SIZE, abc);
+      block = (seqdb ? p7_seqdb_CreateBlock(BLOCK_SIZE, abc) : esl_sq_CreateDigitalBlock(BLOCK_SIZE, abc));
       if (block == NULL) 
 	{
 	  p7_Fail("Failed to allocate sequence block");
 	}
 
-      status = esl_workqueue_Init(queue, block);
+      status = p7_scheduler_Add(sched, block);
       if (status != eslOK) 
 	{
-	  p7_Fail("Failed to add block to work queue");
+	  p7_Fail("Failed to add block to scheduler");
 	}
     }
+
+  /* Parallel parsing of <seqdb>, if asked for and if the file can be split */
+  if (ncpus > 0 && dbfp != NULL && esl_opt_GetInteger(go, "--rcpu") > 0 && cfg->firstseq_key == NULL)
+    {
+      status = p7_seqreader_Open(dbfp, esl_opt_GetInteger(go, "--rcpu"), BLOCK_SIZE, 0, &rdr);
+      if (status != eslOK && status != eslEINCOMPAT) p7_Fail("Failed to set up parallel parsing of %s", cfg->dbfile);
+    }
 #endif
 
   /* Outer loop over sequence queries */
@@ -533,18 +564,28 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       esl_stopwatch_Start(w);
 
       /* seqfile may need to be rewound (multiquery mode) */
-      if (nquery > 1)
+      if (seqdb)
       {
-        if (! esl_sqfile_IsRewindable(dbfp)) p7_Fail("Target sequence file %s isn't rewindable; can't search it with multiple queries", cfg->dbfile);
-
-        if ( cfg->firstseq_key == NULL )
-          esl_sqfile_Position(dbfp, 0); //only re-set current position to 0 if we're not planning to set it in a moment
+        if (cfg->firstseq_key != NULL) sstatus = p7_seqdb_PositionByKey(seqdb, cfg->firstseq_key);
+        else                           sstatus = p7_seqdb_Position(seqdb, 0);
+        if (sstatus != eslOK)
+          p7_Fail("Failure setting restrictdb_stkey to %s\n", cfg->firstseq_key);
       }
+      else
+      {
+        if (nquery > 1)
+        {
+          if (! esl_sqfile_IsRewindable(dbfp)) p7_Fail("Target sequence file %s isn't rewindable; can't search it with multiple queries", cfg->dbfile);
 
-      if ( cfg->firstseq_key != NULL ) { //it's tempting to want to do this once and capture the offset position for future passes, but ncbi files make this non-trivial, so this keeps it general
-        sstatus = esl_sqfile_PositionByKey(dbfp, cfg->firstseq_key);
-        if (sstatus != eslOK)
-          p7_Fail("Failure setting restrictdb_stkey to %d\n", cfg->firstseq_key);
+          if ( cfg->firstseq_key == NULL )
+            esl_sqfile_Position(dbfp, 0); //only re-set current position to 0 if we're not planning to set it in a moment
+        }
+
+        if ( cfg->firstseq_key != NULL ) { //it's tempting to want to do this once and capture the offset position for future passes, but ncbi files make this non-trivial, so this keeps it general
+          sstatus = esl_sqfile_PositionByKey(dbfp, cfg->firstseq_key);
+          if (sstatus != eslOK)
+            p7_Fail("Failure setting restrictdb_stkey to %d\n", cfg->firstseq_key);
+        }
       }
 
 
@@ -562,6 +603,8 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
         info[i].th  = p7_tophits_Create();
         info[i].om  = p7_oprofile_Clone(om);
         info[i].pli = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
+        info[i].pli->do_lazy_ad = TRUE; /* alignment displays are made after thresholding */
+        if (esl_opt_IsOn(go, "--topn")) p7_pli_SetTopN(info[i].pli, esl_opt_GetInteger(go, "--topn"));
         p7_pli_NewModel(info[i].pli, info[i].om, info[i].bg);
 
 #ifdef HMMER_THREADS
@@ -570,23 +613,23 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       }
 
 #ifdef HMMER_THREADS
-      if (ncpus > 0) sstatus = thread_loop(threadObj, queue, dbfp, cfg->n_targetseq);
-      else           sstatus = serial_loop(info, dbfp, cfg->n_targetseq);
+      if (ncpus > 0) sstatus = thread_loop(threadObj, sched, rdr, dbfp, seqdb, cfg->n_targetseq);
+      else           sstatus = serial_loop(info, dbfp, seqdb, cfg->n_targetseq);
 #else
-      sstatus = serial_loop(info, dbfp, cfg->n_targetseq);
+      sstatus = serial_loop(info, dbfp, seqdb, cfg->n_targetseq);
 #endif
       switch(sstatus)
       {
       case eslEFORMAT:
         p7_Fail("Parse failed (sequence file %s):\n%s\n",
-            dbfp->filename, esl_sqfile_GetErrorBuf(dbfp));
+            cfg->dbfile, esl_sqfile_GetErrorBuf(dbfp));
         break;
       case eslEOF:
         /* do nothing */
         break;
       default:
         p7_Fail("Unexpected error %d reading sequence file %s",
-            sstatus, dbfp->filename);
+            sstatus, cfg->dbfile);
       }
 
 
@@ -604,12 +647,14 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       /* Print the results.  */
       p7_tophits_SortBySortkey(info->th);
       p7_tophits_Threshold(info->th, info->pli);
+      if (p7_tophits_MakeDisplays(info->th, info->pli, om, FALSE) != eslOK) p7_Fail("Failed to make alignment displays\n");
       p7_tophits_Targets(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
       p7_tophits_Domains(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   
       if (tblfp)     p7_tophits_TabularTargets(tblfp,    qsq->name, qsq->acc, info->th, info->pli, (nquery == 1));
       if (domtblfp)  p7_tophits_TabularDomains(domtblfp, qsq->name, qsq->acc, info->th, info->pli, (nquery == 1));
       if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, qsq->name, qsq->acc, info->th, info->pli);
+      if (stagetblfp) p7_pli_WriteStageTable(stagetblfp, qsq->name, info->pli, (nquery == 1));
 
       esl_stopwatch_Stop(w);
       p7_pli_Statistics(ofp, info->pli, w);
@@ -654,6 +699,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (tblfp)     p7_tophits_TabularTail(tblfp,    "phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (domtblfp)  p7_tophits_TabularTail(domtblfp, "phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (pfamtblfp) p7_tophits_TabularTail(pfamtblfp,"phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
+  if (stagetblfp) p7_tophits_TabularTail(stagetblfp,"phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (ofp)    { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
   /* Cleanup - prepare for successful exit
@@ -664,16 +710,21 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #ifdef HMMER_THREADS
   if (ncpus > 0)
     {
-      esl_workqueue_Reset(queue);
-      while (esl_workqueue_Remove(queue, (void **) &block) == eslOK)
-	esl_sq_DestroyBlock(block);
-      esl_workqueue_Destroy(queue);
+      p7_scheduler_Reset(sched);
+      while (p7_scheduler_Remove(sched, (void **) &block) == eslOK)
+	{
+	  if (seqdb) p7_seqdb_DestroyBlock(block);
+	  else       esl_sq_DestroyBlock(block);
+	}
+      p7_scheduler_Destroy(sched);
+      p7_seqreader_Close(rdr);
       esl_threads_Destroy(threadObj);
     }
 #endif
 
   free(info);
-  esl_sqfile_Close(dbfp);
+  if (dbfp) esl_sqfile_Close(dbfp);
+  p7_seqdb_Close(seqdb);
   esl_sqfile_Close(qfp);
   esl_stopwatch_Destroy(w);
   esl_sq_Destroy(qsq);
@@ -686,6 +737,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (tblfp    != NULL)   fclose(tblfp);
   if (domtblfp != NULL)   fclose(domtblfp);
   if (pfamtblfp)     fclose(pfamtblfp);
+  if (stagetblfp)    fclose(stagetblfp);
   return eslOK;
 
  ERROR:
@@ -870,6 +922,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   FILE            *tblfp    = NULL;		  /* output stream for tabular per-seq (--tblout)     */
   FILE            *domtblfp = NULL;		  /* output stream for tabular per-seq (--domtblout)  */
   FILE            *pfamtblfp= NULL;              /* output stream for pfam-style tabular output  (--pfamtblout) */
+  FILE            *stagetblfp= NULL;             /* output stream for per-stage timing table (--stagetblout) */
   int              qformat  = eslSQFILE_UNKNOWN;  /* format of qfile                                  */
   P7_BG           *bg       = NULL;	          /* null model                                      */
   ESL_SQFILE      *qfp      = NULL;		  /* open qfile                                       */
@@ -950,6 +1003,9 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     mpi_failure("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblfp"));
   if (esl_opt_IsOn(go, "--pfamtblout") && (pfamtblfp = fopen(esl_opt_GetString(go, "--pfamtblout"), "w")) == NULL)
     mpi_failure("Failed to open pfam-style tabular output file %s for writing\n", esl_opt_GetString(go, "--pfamtblout"));
+
+  if (esl_opt_IsOn(go, "--stagetblout") && (stagetblfp = fopen(esl_opt_GetString(go, "--stagetblout"), "w")) == NULL)
+    mpi_failure("Failed to open pipeline stage table output file %s for writing\n", esl_opt_GetString(go, "--stagetblout"));
     
   /* Open the target sequence database for sequential access. */
   status =  esl_sqfile_OpenDigital(abc, cfg->dbfile, dbformat, p7_SEQDBENV, &dbfp);
@@ -1022,6 +1078,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       /* Create processing pipeline and hit list */
       th  = p7_tophits_Create(); 
       pli = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
+      if (esl_opt_IsOn(go, "--topn")) p7_pli_SetTopN(pli, esl_opt_GetInteger(go, "--topn"));
       p7_pli_NewModel(pli, om, bg);
 
       /* Main loop: */
@@ -1123,6 +1180,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       if (tblfp)     p7_tophits_TabularTargets(tblfp,    qsq->name, qsq->acc, th, pli, (nquery == 1));
       if (domtblfp)  p7_tophits_TabularDomains(domtblfp, qsq->name, qsq->acc, th, pli, (nquery == 1));
       if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp,  qsq->name, qsq->acc, th, pli);
+      if (stagetblfp) p7_pli_WriteStageTable(stagetblfp, qsq->name, pli, (nquery == 1));
 
       esl_stopwatch_Stop(w);
       p7_pli_Statistics(ofp, pli, w);
@@ -1187,6 +1245,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (tblfp)    p7_tophits_TabularTail(tblfp,    "phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (domtblfp) p7_tophits_TabularTail(domtblfp, "phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (pfamtblfp)p7_tophits_TabularTail(pfamtblfp, "phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
+  if (stagetblfp)p7_tophits_TabularTail(stagetblfp, "phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (ofp)      { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
   /* Cleanup - prepare for successful exit
@@ -1209,6 +1268,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (tblfp    != NULL)   fclose(tblfp);
   if (domtblfp != NULL)   fclose(domtblfp);
   if (pfamtblfp)     fclose(pfamtblfp);
+  if (stagetblfp)    fclose(stagetblfp);
   return eslOK;
 
  ERROR:
@@ -1315,6 +1375,7 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
       /* Create processing pipeline and hit list */
       th  = p7_tophits_Create(); 
       pli = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
+      if (esl_opt_IsOn(go, "--topn")) p7_pli_SetTopN(pli, esl_opt_GetInteger(go, "--topn"));
       p7_pli_NewModel(pli, om, bg);
 
       /* receive a sequence block from the master */
@@ -1391,16 +1452,16 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
 
 
 static int
-serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs)
+serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, P7_SEQDB *seqdb, int n_targetseqs)
 {
   int      sstatus   = eslOK;
   ESL_SQ   *dbsq     = NULL;   /* one target sequence (digital)  */
   int seq_cnt = 0;
 
-  dbsq = esl_sq_CreateDigital(info->om->abc);
+  dbsq = (seqdb ? p7_seqdb_CreateSeq(info->om->abc) : esl_sq_CreateDigital(info->om->abc));
 
   /* Main loop: */
-  while ((n_targetseqs==-1 || seq_cnt<n_targetseqs) && (sstatus = esl_sqio_Read(dbfp, dbsq)) == eslOK)
+  while ((n_targetseqs==-1 || seq_cnt<n_targetseqs) && (sstatus = (seqdb ? p7_seqdb_Read(seqdb, dbsq) : esl_sqio_Read(dbfp, dbsq))) == eslOK)
     {
       p7_pli_NewSeq(info->pli, dbsq);
       p7_bg_SetLength(info->bg, dbsq->n);
@@ -1409,33 +1470,34 @@ serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs)
       p7_Pipeline(info->pli, info->om, info->bg, dbsq, NULL, info->th);
 
       seq_cnt++;
-      esl_sq_Reuse(dbsq);
+      if (! seqdb) esl_sq_Reuse(dbsq);
       p7_pipeline_Reuse(info->pli);
     }
 
   if (n_targetseqs!=-1 && seq_cnt==n_targetseqs)
     sstatus = eslEOF;
 
-  esl_sq_Destroy(dbsq);
+  if (seqdb) p7_seqdb_DestroySeq(dbsq);
+  else       esl_sq_Destroy(dbsq);
 
   return sstatus;
 }
 
 #ifdef HMMER_THREADS
 static int
-thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_targetseqs)
+thread_loop(ESL_THREADS *obj, P7_SCHEDULER *sched, P7_SEQREADER *rdr, ESL_SQFILE *dbfp, P7_SEQDB *seqdb, int n_targetseqs)
 {
   int  status  = eslOK;
   int  sstatus = eslOK;
-  int  eofCount = 0;
   ESL_SQ_BLOCK *block;
   void         *newBlock;
 
-  esl_workqueue_Reset(queue);
   esl_threads_WaitForStart(obj);
 
-  status = esl_workqueue_ReaderUpdate(queue, NULL, &newBlock);
-  if (status != eslOK) p7_Fail("Work queue reader failed");
+  if (rdr != NULL && p7_seqreader_Start(rdr, -1, 0) != eslOK) p7_Fail("Failed to start parser threads");
+
+  status = p7_scheduler_ReaderUpdate(sched, NULL, 0, &newBlock);
+  if (status != eslOK) p7_Fail("Scheduler reader failed");
       
   /* Main loop: */
   while (sstatus == eslOK)
@@ -1447,31 +1509,35 @@ thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_tar
         block->count = 0;
         sstatus = eslEOF;
       } else {
-        sstatus = esl_sqio_ReadBlock(dbfp, block, -1, n_targetseqs, /*max_init_window=*/FALSE, FALSE);
+        if      (seqdb) sstatus = p7_seqdb_ReadBlock(seqdb, block, n_targetseqs);
+        else if (rdr)   sstatus = p7_seqreader_ReadBlock(rdr, block, n_targetseqs);
+        else            sstatus = esl_sqio_ReadBlock(dbfp, block, -1, n_targetseqs, /*max_init_window=*/FALSE, FALSE);
         n_targetseqs -= block->count;
       }
 
-      if (sstatus == eslEOF)
-      {
-        if (eofCount < esl_threads_GetWorkerCount(obj)) sstatus = eslOK;
-        ++eofCount;
-      }
-	  
       if (sstatus == eslOK)
       {
-        status = esl_workqueue_ReaderUpdate(queue, block, &newBlock);
-        if (status != eslOK) p7_Fail("Work queue reader failed");
+        status = p7_scheduler_ReaderUpdate(sched, block, block->count, &newBlock);
+        if (status != eslOK) p7_Fail("Scheduler reader failed");
       }
     }
 
-  status = esl_workqueue_ReaderUpdate(queue, block, NULL);
-  if (status != eslOK) p7_Fail("Work queue reader failed");
+  status = p7_scheduler_ReaderUpdate(sched, block, block->count, NULL);
+  if (status != eslOK) p7_Fail("Scheduler reader failed");
+  status = p7_scheduler_ReaderFinish(sched);
+  if (status != eslOK) p7_Fail("Scheduler reader failed");
+
+  if (rdr != NULL)
+    {
+      if (sstatus == eslEFORMAT) p7_Fail("Parse failed (sequence file %s):\n%s\n", dbfp->filename, rdr->errbuf);
+      p7_seqreader_Stop(rdr);
+    }
 
   if (sstatus == eslEOF)
     {
       /* wait for all the threads to complete */
       esl_threads_WaitForFinish(obj);
-      esl_workqueue_Complete(queue);  
+      p7_scheduler_Reset(sched);
     }
 
   return sstatus;
@@ -1485,8 +1551,8 @@ pipeline_thread(void *arg)
   int workeridx;
   WORKER_INFO   *info;
   ESL_THREADS   *obj;
-  ESL_SQ_BLOCK  *block = NULL;
-  void          *newBlock;
+  ESL_SQ_BLOCK   *block;
+  P7_SCHED_RANGE  r;
   
   impl_Init();
 
@@ -1495,36 +1561,21 @@ pipeline_thread(void *arg)
 
   info = (WORKER_INFO *) esl_threads_GetData(obj, workeridx);
 
-  status = esl_workqueue_WorkerUpdate(info->queue, NULL, &newBlock);
-  if (status != eslOK) p7_Fail("Work queue worker failed");
-
-  /* loop until all blocks have been processed */
-  block = (ESL_SQ_BLOCK *) newBlock;
-  while (block->count > 0)
+  /* loop until all targets have been processed, a few at a time */
+  r.blk = NULL;
+  while ((status = p7_scheduler_WorkerUpdate(info->sched, workeridx, &r)) == eslOK)
     {
-      /* Main loop: */
-      for (i = 0; i < block->count; ++i)
-	{
-	  ESL_SQ *dbsq = block->list + i;
-
-	  p7_pli_NewSeq(info->pli, dbsq);
-	  p7_bg_SetLength(info->bg, dbsq->n);
-	  p7_oprofile_ReconfigLength(info->om, dbsq->n);
-	  
-	  p7_Pipeline(info->pli, info->om, info->bg, dbsq, NULL, info->th);
-	  
-	  esl_sq_Reuse(dbsq);
-	  p7_pipeline_Reuse(info->pli);
-	}
+      block = (ESL_SQ_BLOCK *) r.blk;
 
-      status = esl_workqueue_WorkerUpdate(info->queue, block, &newBlock);
-      if (status != eslOK) p7_Fail("Work queue worker failed");
+      /* The targets through the pipeline, a filter stage at a time */
+      status = p7_Pipeline_Block(info->pli, info->om, info->bg, block->list + r.lo, r.hi - r.lo, info->th);
+      if (status != eslOK && status != eslERANGE) p7_Fail("Search pipeline failed on a block of targets");
 
-      block = (ESL_SQ_BLOCK *) newBlock;
+      if (info->seqdb == NULL)	/* views into a P7_SEQDB own nothing to reuse */
+	for (i = r.lo; i < r.hi; ++i)
+	  esl_sq_Reuse(block->list + i);
     }
-
-  status = esl_workqueue_WorkerUpdate(info->queue, block, NULL);
-  if (status != eslOK) p7_Fail("Work queue worker failed");
+  if (status != eslEOD) p7_Fail("Scheduler worker failed");
 
   esl_threads_Finished(obj, workeridx);
   return;
@@ -0,0 +1,49 @@
+#! /bin/sh
+
+# Verify that hmmsearch --topn <n> reports the same <n> best hits as a
+# default run does, even though targets are pruned on their
+# uncorrected Forward score.
+#
+# Usage:
+#    ./i24-search-topn.sh <builddir> <srcdir> <tmpfile prefix>
+#
+# Example:
+#    ./i24-search-topn.sh .. .. foo
+#
+# -Z and --domZ are fixed, so that E-values don't depend on how many
+# targets end up reported.
+
+if test ! $# -eq 3; then 
+  echo "Usage: $0 <builddir> <srcdir> <tmpfile prefix>"
+  exit 1
+fi
+
+builddir=$1;
+srcdir=$2;
+tmppfx=$3;
+
+hmmsearch=$builddir/src/hmmsearch;                 if test ! -x $hmmsearch; then echo "FAIL: $hmmsearch not executable"; exit 1; fi
+hmmemit=$builddir/src/hmmemit;                     if test ! -x $hmmemit;   then echo "FAIL: $hmmemit not executable";   exit 1; fi
+shuffle=$builddir/easel/miniapps/esl-shuffle;      if test ! -x $shuffle;   then echo "FAIL: $shuffle not executable";   exit 1; fi
+hmmfile=$srcdir/testsuite/Caudal_act.hmm
+topn=5
+
+$hmmemit -p -N 20 --seed 42 $hmmfile          > $tmppfx.fa; if test $? -ne 0; then echo "FAIL: hmmemit failed";     exit 1; fi
+$shuffle -G --amino -N 50 -L 300 --seed 42   >> $tmppfx.fa; if test $? -ne 0; then echo "FAIL: esl-shuffle failed"; exit 1; fi
+
+$hmmsearch -Z 1000 --domZ 1000              --tblout $tmppfx.tbl1 $hmmfile $tmppfx.fa > /dev/null 2>&1; if test $? -ne 0; then echo "FAIL: crash"; exit 1; fi
+$hmmsearch -Z 1000 --domZ 1000 --topn $topn --tblout $tmppfx.tbl2 $hmmfile $tmppfx.fa > /dev/null 2>&1; if test $? -ne 0; then echo "FAIL: crash"; exit 1; fi
+
+grep -v "^#" $tmppfx.tbl1 | head -n $topn > $tmppfx.out1
+grep -v "^#" $tmppfx.tbl2                 > $tmppfx.out2
+
+n=`cat $tmppfx.out1 | wc -l`
+if test $n -ne $topn; then echo "FAIL: default run reported fewer than $topn hits"; exit 1; fi
+
+diff $tmppfx.out1 $tmppfx.out2 > /dev/null
+if test $? -ne 0; then echo "FAIL: --topn $topn hits differ from the top $topn of a default run"; exit 1; fi
+
+echo "ok"
+
+rm $tmppfx.fa $tmppfx.tbl1 $tmppfx.tbl2 $tmppfx.out1 $tmppfx.out2
+exit 0
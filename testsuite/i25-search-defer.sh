@@ -0,0 +1,50 @@
+#! /bin/sh
+
+# Verify that hmmsearch --defer, which defines domains in a second
+# pass only for reportable targets, gives the same per-target and
+# per-domain tables as a default run.
+#
+# Usage:
+#    ./i25-search-defer.sh <builddir> <srcdir> <tmpfile prefix>
+#
+# Example:
+#    ./i25-search-defer.sh .. .. foo
+#
+# The hmmemit seed of 35 gives a target that needs stochastic
+# clustering (see the run-to-run variation tests in testsuite.sqc).
+
+if test ! $# -eq 3; then 
+  echo "Usage: $0 <builddir> <srcdir> <tmpfile prefix>"
+  exit 1
+fi
+
+builddir=$1;
+srcdir=$2;
+tmppfx=$3;
+
+hmmsearch=$builddir/src/hmmsearch;                 if test ! -x $hmmsearch; then echo "FAIL: $hmmsearch not executable"; exit 1; fi
+hmmemit=$builddir/src/hmmemit;                     if test ! -x $hmmemit;   then echo "FAIL: $hmmemit not executable";   exit 1; fi
+shuffle=$builddir/easel/miniapps/esl-shuffle;      if test ! -x $shuffle;   then echo "FAIL: $shuffle not executable";   exit 1; fi
+hmmfile=$srcdir/testsuite/Caudal_act.hmm
+
+$hmmemit -p --seed 35 $hmmfile                > $tmppfx.fa; if test $? -ne 0; then echo "FAIL: hmmemit failed";     exit 1; fi
+$hmmemit -p -N 20 --seed 42 $hmmfile         >> $tmppfx.fa; if test $? -ne 0; then echo "FAIL: hmmemit failed";     exit 1; fi
+$shuffle -G --amino -N 50 -L 300 --seed 42   >> $tmppfx.fa; if test $? -ne 0; then echo "FAIL: esl-shuffle failed"; exit 1; fi
+
+$hmmsearch         --tblout $tmppfx.tbl1 --domtblout $tmppfx.dtbl1 $hmmfile $tmppfx.fa > /dev/null 2>&1; if test $? -ne 0; then echo "FAIL: crash"; exit 1; fi
+$hmmsearch --defer --tblout $tmppfx.tbl2 --domtblout $tmppfx.dtbl2 $hmmfile $tmppfx.fa > /dev/null 2>&1; if test $? -ne 0; then echo "FAIL: crash"; exit 1; fi
+
+grep -v "^#" $tmppfx.tbl1  > $tmppfx.out1
+grep -v "^#" $tmppfx.tbl2  > $tmppfx.out2
+diff $tmppfx.out1 $tmppfx.out2 > /dev/null
+if test $? -ne 0; then echo "FAIL: --defer --tblout differs from a default run"; exit 1; fi
+
+grep -v "^#" $tmppfx.dtbl1 > $tmppfx.out1
+grep -v "^#" $tmppfx.dtbl2 > $tmppfx.out2
+diff $tmppfx.out1 $tmppfx.out2 > /dev/null
+if test $? -ne 0; then echo "FAIL: --defer --domtblout differs from a default run"; exit 1; fi
+
+echo "ok"
+
+rm $tmppfx.fa $tmppfx.tbl1 $tmppfx.tbl2 $tmppfx.dtbl1 $tmppfx.dtbl2 $tmppfx.out1 $tmppfx.out2
+exit 0
@@ -0,0 +1,47 @@
+#! /bin/sh
+
+# Verify that hmmsearch --qbatch, which compares several queries to
+# each block of targets in one pass, gives the same results as
+# searching the queries one at a time.
+#
+# Usage:
+#    ./i26-search-qbatch.sh <builddir> <srcdir> <HMM database> <tmpfile prefix>
+#
+# Example:
+#    ../src/hmmbuild minifam.hmm minifam
+#    ./i26-search-qbatch.sh .. .. minifam.hmm foo
+#    rm minifam.hmm
+#
+# A batch of 2 leaves a partial batch at the end of a 5-model
+# <HMM database>. Comment lines, which carry the run times, are
+# not compared.
+
+if test ! $# -eq 4; then 
+  echo "Usage: $0 <builddir> <srcdir> <HMM database> <tmpfile prefix>"
+  exit 1
+fi
+
+builddir=$1;
+srcdir=$2;
+hmmfile=$3;
+tmppfx=$4;
+
+hmmsearch=$builddir/src/hmmsearch; if test ! -x $hmmsearch; then echo "FAIL: $hmmsearch not executable"; exit 1; fi
+                                   if test ! -r $hmmfile;   then echo "FAIL: $hmmfile not readable";     exit 1; fi
+
+cat $srcdir/tutorial/globins45.fa $srcdir/tutorial/HBB_HUMAN $srcdir/tutorial/7LESS_DROME > $tmppfx.fa
+
+$hmmsearch            --tblout $tmppfx.tbl1 --domtblout $tmppfx.dtbl1 $hmmfile $tmppfx.fa > $tmppfx.out1 2>&1; if test $? -ne 0; then echo "FAIL: crash"; exit 1; fi
+$hmmsearch --qbatch 2 --tblout $tmppfx.tbl2 --domtblout $tmppfx.dtbl2 $hmmfile $tmppfx.fa > $tmppfx.out2 2>&1; if test $? -ne 0; then echo "FAIL: crash"; exit 1; fi
+
+for sfx in out tbl dtbl; do
+  grep -v "^#" $tmppfx.${sfx}1 > $tmppfx.cmp1
+  grep -v "^#" $tmppfx.${sfx}2 > $tmppfx.cmp2
+  diff $tmppfx.cmp1 $tmppfx.cmp2 > /dev/null
+  if test $? -ne 0; then echo "FAIL: --qbatch $sfx output differs from one query at a time"; exit 1; fi
+done
+
+echo "ok"
+
+rm $tmppfx.fa $tmppfx.out1 $tmppfx.out2 $tmppfx.tbl1 $tmppfx.tbl2 $tmppfx.dtbl1 $tmppfx.dtbl2 $tmppfx.cmp1 $tmppfx.cmp2
+exit 0
@@ -0,0 +1,59 @@
+#! /bin/sh
+
+# Verify that hmmsearch --banded, which redoes the Forward/Backward
+# parse of a long target in row bands, finds the same hits and domain
+# envelopes as the full parse.
+#
+# Usage:
+#    ./i27-search-banded.sh <builddir> <srcdir> <tmpfile prefix>
+#
+# Example:
+#    ./i27-search-banded.sh .. .. foo
+#
+# Bands are only tried when M*L is at least 1e8, so the target is a
+# 400K random sequence with three emitted Pkinase domains (M=260) in
+# the middle. The bands may lose up to 1e-3 of the probability mass,
+# so columns that are sums of posteriors (the tblout "exp" column and
+# the domtblout "acc" column) aren't compared.
+
+if test ! $# -eq 3; then 
+  echo "Usage: $0 <builddir> <srcdir> <tmpfile prefix>"
+  exit 1
+fi
+
+builddir=$1;
+srcdir=$2;
+tmppfx=$3;
+
+hmmsearch=$builddir/src/hmmsearch;                 if test ! -x $hmmsearch; then echo "FAIL: $hmmsearch not executable"; exit 1; fi
+hmmemit=$builddir/src/hmmemit;                     if test ! -x $hmmemit;   then echo "FAIL: $hmmemit not executable";   exit 1; fi
+shuffle=$builddir/easel/miniapps/esl-shuffle;      if test ! -x $shuffle;   then echo "FAIL: $shuffle not executable";   exit 1; fi
+hmmfile=$srcdir/tutorial/Pkinase.hmm
+
+echo ">longtarget"                                              > $tmppfx.fa
+$shuffle -G --amino -N 1 -L 200000 --seed 1 | grep -v "^>"     >> $tmppfx.fa
+$hmmemit -p -N 3 --seed 42 $hmmfile         | grep -v "^>"     >> $tmppfx.fa
+$shuffle -G --amino -N 1 -L 200000 --seed 2 | grep -v "^>"     >> $tmppfx.fa
+
+$hmmsearch          --tblout $tmppfx.tbl1 --domtblout $tmppfx.dtbl1 $hmmfile $tmppfx.fa > $tmppfx.out1 2>&1; if test $? -ne 0; then echo "FAIL: crash"; exit 1; fi
+$hmmsearch --banded --tblout $tmppfx.tbl2 --domtblout $tmppfx.dtbl2 $hmmfile $tmppfx.fa > $tmppfx.out2 2>&1; if test $? -ne 0; then echo "FAIL: crash"; exit 1; fi
+
+nbanded=`grep "^Banded Fwd/Bck parses:" $tmppfx.out2 | awk '{print $4}'`
+if test "x$nbanded" = "x" || test $nbanded -eq 0; then echo "FAIL: the long target wasn't parsed in bands"; exit 1; fi
+
+grep -v "^#" $tmppfx.tbl1  | awk '{print $1, $3, $5, $6, $7, $8, $9, $10}' > $tmppfx.cmp1
+grep -v "^#" $tmppfx.tbl2  | awk '{print $1, $3, $5, $6, $7, $8, $9, $10}' > $tmppfx.cmp2
+n=`cat $tmppfx.cmp1 | wc -l`
+if test $n -eq 0; then echo "FAIL: no hits to compare"; exit 1; fi
+diff $tmppfx.cmp1 $tmppfx.cmp2 > /dev/null
+if test $? -ne 0; then echo "FAIL: --banded --tblout differs from the full parse"; exit 1; fi
+
+grep -v "^#" $tmppfx.dtbl1 | awk '{for (i = 1; i <= 21; i++) printf "%s ", $i; printf "\n"}' > $tmppfx.cmp1
+grep -v "^#" $tmppfx.dtbl2 | awk '{for (i = 1; i <= 21; i++) printf "%s ", $i; printf "\n"}' > $tmppfx.cmp2
+diff $tmppfx.cmp1 $tmppfx.cmp2 > /dev/null
+if test $? -ne 0; then echo "FAIL: --banded --domtblout differs from the full parse"; exit 1; fi
+
+echo "ok"
+
+rm $tmppfx.fa $tmppfx.out1 $tmppfx.out2 $tmppfx.tbl1 $tmppfx.tbl2 $tmppfx.dtbl1 $tmppfx.dtbl2 $tmppfx.cmp1 $tmppfx.cmp2
+exit 0
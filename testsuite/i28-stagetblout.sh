@@ -0,0 +1,67 @@
+#! /bin/sh
+
+# Verify the --stagetblout tables of hmmsearch and hmmscan: one row
+# per pipeline stage for each query, the MSV stage entered by every
+# target (search) or model (scan), and a tail that names the program,
+# the pipeline mode and the query and target files the right way
+# round.
+#
+# Usage:
+#    ./i28-stagetblout.sh <builddir> <srcdir> <HMM database> <tmpfile prefix>
+#
+# Example:
+#    ../src/hmmbuild minifam.hmm minifam
+#    ../src/hmmpress minifam.hmm
+#    ./i28-stagetblout.sh .. .. minifam.hmm foo
+#    rm minifam.hmm*
+#
+# The <HMM database> must be press'ed, for hmmscan to work on it, and
+# hold 5 models, like testsuite/minifam.
+
+if test ! $# -eq 4; then 
+  echo "Usage: $0 <builddir> <srcdir> <HMM database> <tmpfile prefix>"
+  exit 1
+fi
+
+builddir=$1;
+srcdir=$2;
+hmmfile=$3;
+tmppfx=$4;
+
+hmmsearch=$builddir/src/hmmsearch; if test ! -x $hmmsearch; then echo "FAIL: $hmmsearch not executable"; exit 1; fi
+hmmscan=$builddir/src/hmmscan;     if test ! -x $hmmscan;   then echo "FAIL: $hmmscan not executable";   exit 1; fi
+                                   if test ! -r $hmmfile;   then echo "FAIL: $hmmfile not readable";     exit 1; fi
+seqdb=$srcdir/tutorial/globins45.fa
+qseq=$srcdir/tutorial/HBB_HUMAN
+nstages=7
+
+# check_table <table> <nqueries> <MSV comparisons> <program> <mode> <query file> <target file>
+check_table () {
+  n=`grep -v "^#" $1 | wc -l`
+  if test $n -ne `expr $2 \* $nstages`; then echo "FAIL: $4 --stagetblout has $n rows, expected $2 x $nstages"; exit 1; fi
+
+  for stage in MSV bias Viterbi Forward Backward domaindef alidisplay; do
+    n=`grep -v "^#" $1 | awk -v s=$stage '$2 == s' | wc -l`
+    if test $n -ne $2; then echo "FAIL: $4 --stagetblout has $n $stage rows, expected $2"; exit 1; fi
+  done
+
+  n=`grep -v "^#" $1 | awk -v c=$3 '$2 == "MSV" && $3 != c' | wc -l`
+  if test $n -ne 0; then echo "FAIL: $4 --stagetblout MSV rows don't count $3 comparisons"; exit 1; fi
+
+  grep -q "^# Program: *$4\$"       $1; if test $? -ne 0; then echo "FAIL: $4 --stagetblout tail lacks the program name"; exit 1; fi
+  grep -q "^# Pipeline mode: *$5\$" $1; if test $? -ne 0; then echo "FAIL: $4 --stagetblout tail lacks pipeline mode $5"; exit 1; fi
+  grep -q "^# Query file: *$6\$"    $1; if test $? -ne 0; then echo "FAIL: $4 --stagetblout tail has the wrong query file"; exit 1; fi
+  grep -q "^# Target file: *$7\$"   $1; if test $? -ne 0; then echo "FAIL: $4 --stagetblout tail has the wrong target file"; exit 1; fi
+  grep -q "^# \[ok\]\$"             $1; if test $? -ne 0; then echo "FAIL: $4 --stagetblout tail is missing"; exit 1; fi
+}
+
+$hmmsearch --stagetblout $tmppfx.stbl $hmmfile $seqdb > /dev/null 2>&1; if test $? -ne 0; then echo "FAIL: hmmsearch crash"; exit 1; fi
+check_table $tmppfx.stbl 5 45 hmmsearch SEARCH $hmmfile $seqdb
+
+$hmmscan   --stagetblout $tmppfx.stbl $hmmfile $qseq  > /dev/null 2>&1; if test $? -ne 0; then echo "FAIL: hmmscan crash";   exit 1; fi
+check_table $tmppfx.stbl 1 5  hmmscan   SCAN   $qseq    $hmmfile
+
+echo "ok"
+
+rm $tmppfx.stbl
+exit 0
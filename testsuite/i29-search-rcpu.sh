@@ -0,0 +1,64 @@
+#! /bin/sh
+
+# Verify that hmmsearch --rcpu, which parses the target database in
+# parallel chunks, gives the same results as the master reading it:
+# on a FASTA file, split at '>' record starts, and on an EMBL file,
+# split at the record offsets of its SSI index.
+#
+# Usage:
+#    ./i29-search-rcpu.sh <builddir> <srcdir> <tmpfile prefix>
+#
+# Example:
+#    ./i29-search-rcpu.sh .. .. foo
+#
+# Needs a threaded build. Comment lines, which carry the options used
+# and the run times, are not compared.
+
+if test ! $# -eq 3; then 
+  echo "Usage: $0 <builddir> <srcdir> <tmpfile prefix>"
+  exit 1
+fi
+
+builddir=$1;
+srcdir=$2;
+tmppfx=$3;
+
+hmmsearch=$builddir/src/hmmsearch;                 if test ! -x $hmmsearch; then echo "FAIL: $hmmsearch not executable"; exit 1; fi
+sfetch=$builddir/easel/miniapps/esl-sfetch;        if test ! -x $sfetch;    then echo "FAIL: $sfetch not executable";    exit 1; fi
+hmmfile=$srcdir/tutorial/globins4.hmm
+fafile=$srcdir/tutorial/globins45.fa
+
+# check_rcpu <seqfile> <format>
+check_rcpu () {
+  $hmmsearch --cpu 2 --rcpu 0 --tformat $2 --tblout $tmppfx.tbl1 --domtblout $tmppfx.dtbl1 $hmmfile $1 > $tmppfx.out1 2>&1; if test $? -ne 0; then echo "FAIL: crash"; exit 1; fi
+  $hmmsearch --cpu 2 --rcpu 2 --tformat $2 --tblout $tmppfx.tbl2 --domtblout $tmppfx.dtbl2 $hmmfile $1 > $tmppfx.out2 2>&1; if test $? -ne 0; then echo "FAIL: crash"; exit 1; fi
+
+  n=`grep -v "^#" $tmppfx.tbl1 | wc -l`
+  if test $n -eq 0; then echo "FAIL: no hits in $2 file to compare"; exit 1; fi
+
+  for sfx in out tbl dtbl; do
+    grep -v "^#" $tmppfx.${sfx}1 > $tmppfx.cmp1
+    grep -v "^#" $tmppfx.${sfx}2 > $tmppfx.cmp2
+    diff $tmppfx.cmp1 $tmppfx.cmp2 > /dev/null
+    if test $? -ne 0; then echo "FAIL: --rcpu 2 $sfx output on $2 file differs from a serial read"; exit 1; fi
+  done
+}
+
+check_rcpu $fafile fasta
+
+# The same sequences in EMBL format, with an SSI index
+awk 'function put() { if (name != "") { printf "ID   %s   STANDARD;  PRT;  %d AA.\nSQ   SEQUENCE   %d AA;\n", name, length(seq), length(seq);
+                                         for (i = 1; i <= length(seq); i += 60) printf "     %s\n", substr(seq, i, 60);
+                                         printf "//\n"; } }
+     /^>/  { put(); name = substr($1, 2); seq = ""; next }
+           { seq = seq $1 }
+     END   { put() }' $fafile > $tmppfx.embl
+$sfetch --informat embl --index $tmppfx.embl > /dev/null 2>&1; if test $? -ne 0; then echo "FAIL: esl-sfetch --index failed"; exit 1; fi
+
+check_rcpu $tmppfx.embl embl
+
+echo "ok"
+
+rm $tmppfx.embl $tmppfx.embl.ssi
+rm $tmppfx.out1 $tmppfx.out2 $tmppfx.tbl1 $tmppfx.tbl2 $tmppfx.dtbl1 $tmppfx.dtbl2 $tmppfx.cmp1 $tmppfx.cmp2
+exit 0